@@ -0,0 +1,95 @@
+"""Experimental design over the simulated network of picoquicsim
+
+Runs the same experimental design as ED_benchmark.py, without Mininet: each
+transfer is simulated in virtual time by picoquicsim, so the results only
+depend on the parameters and can be reproduced on any host. The results are
+stored in the same sqlite schema as ED_benchmark.py.
+
+picoquicsim must be run from the root of the repository, as it loads the test
+certificates and the plugins from there.
+"""
+import argparse
+import json
+import os
+import sqlite3
+import subprocess
+from os import path
+
+from experimental_design import ParamsGenerator, load_wsp, flatten, int, float, str
+
+ROOT_DIR = path.dirname(path.dirname(path.abspath(__file__)))
+
+# The plugins loaded by both peers for each test
+TESTS = {
+    'quic': [],
+    'multipath': ['plugins/multipath/multipath_rr.plugin'],
+    'multipath_rtt': ['plugins/multipath/multipath_rtt.plugin'],
+    'multipath_ecf': ['plugins/multipath/multipath_ecf.plugin'],
+    'multipath_ecf_redundant': ['plugins/multipath/multipath_ecf_redundant.plugin'],
+    'fec': ['plugins/fec/fec_rlc_gf256_window.plugin'],
+    'datagram': ['plugins/datagram/datagram.plugin'],
+}
+
+
+def run_picoquicsim(binary, plugins, params, size, repetitions, seed):
+    """
+        Runs picoquicsim and returns its JSON output, as a dict
+    """
+    nb_interfaces = len(params['bw'])
+    cmd = [binary, '-n', '%d' % nb_interfaces, '-s', '%d' % size, '-R', '%d' % repetitions, '-x', '%d' % seed,
+           '-b', ','.join('%s' % x for x in params['bw']),
+           '-d', ','.join('%s' % x for x in params['delay_ms'])]
+    if 'loss' in params:
+        cmd += ['-l', ','.join('%s' % x for x in params['loss'])]
+    if 'queue_ms' in params:
+        cmd += ['-q', ','.join('%s' % x for x in params['queue_ms'])]
+    for plugin in plugins:
+        cmd += ['-P', plugin]
+    print(' '.join(cmd))
+    output = subprocess.check_output(cmd, cwd=ROOT_DIR)
+    return json.loads(output.decode())
+
+
+def experimental_design(ranges, file_sizes, tests, binary, repetitions, seed, database_name='results_sim.db'):
+    dir_path = path.dirname(path.abspath(__file__))
+    filename = os.path.join(dir_path, "wsp_owd_8")
+    nrows, ncols = 8, 139
+    matrix = load_wsp(filename, nrows, ncols)
+    gen = ParamsGenerator(ranges, matrix)
+
+    conn = sqlite3.connect(os.path.join(dir_path, database_name))
+    cursor = conn.cursor()
+    sql_create_table = gen.generate_sql_create_table(additional_values=[('test_name', str), ('elapsed_time', float), ('var_elapsed_time', float), ('file_size', int)])
+    cursor.execute(sql_create_table)
+    conn.commit()
+
+    for i, v in enumerate(gen.generate_all_values()):
+        print("experiment %d/%d" % (i, len(gen)))
+        for test_name in tests:
+            for size in file_sizes:
+                result = run_picoquicsim(binary, TESTS[test_name], v, size, repetitions, seed)
+                print("median = %fms, std_dev = %fms, %d failed" % (result['elapsed_time'], result['var_elapsed_time'], result['failed']))
+
+                values_list = flatten([v[k] for k in sorted(v.keys())]) + [test_name, result['elapsed_time'], result['var_elapsed_time'], size]
+                cursor.execute(gen.generate_sql_insert(values_list))
+                conn.commit()
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description='Runs the experimental design over the simulated network')
+    parser.add_argument('--binary', default=path.join(ROOT_DIR, 'picoquicsim'), help='path to picoquicsim')
+    parser.add_argument('--tests', nargs='+', default=sorted(TESTS.keys()), choices=sorted(TESTS.keys()))
+    parser.add_argument('--repetitions', type=int, default=9, help='transfers per experiment, with different seeds')
+    parser.add_argument('--seed', type=int, default=1, help='seed of the first transfer of each experiment')
+    parser.add_argument('--database', default='results_sim.db')
+    args = parser.parse_args()
+
+    # Two interfaces, so that the multipath plugin has something to aggregate
+    ranges = {
+        "bw": {"range": [5, 50], "type": int, "count": 2},  # Mbps
+        "delay_ms": {"range": [5, 100], "type": int, "count": 2},  # ms
+        "loss": {"range": [0.01, 2], "type": float, "count": 2},  # %
+    }
+
+    file_sizes = (1500, 10000, 50000, 1000000, 10000000)
+    experimental_design(ranges, file_sizes, args.tests, args.binary, args.repetitions, args.seed, args.database)
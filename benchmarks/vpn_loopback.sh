@@ -0,0 +1,46 @@
+#!/bin/sh
+# Measures the throughput of picoquicvpn between two network namespaces on the same host.
+# The QUIC connection runs over a veth pair, and iperf3 runs over the tun0/tun1 devices
+# created by the client and the server. Must be run as root from the build directory.
+#
+# Usage: vpn_loopback.sh [duration] [extra picoquicvpn options, e.g. -Q 4 -O]
+
+DURATION=${1:-10}
+[ $# -gt 0 ] && shift
+OPTIONS="$@"
+PLUGIN=plugins/datagram/datagram.plugin
+
+cleanup() {
+    kill $SERVER_PID $CLIENT_PID 2>/dev/null
+    ip netns del pquic_client 2>/dev/null
+    ip netns del pquic_server 2>/dev/null
+}
+trap cleanup EXIT
+
+ip netns add pquic_client
+ip netns add pquic_server
+ip link add veth_client netns pquic_client type veth peer name veth_server netns pquic_server
+ip -n pquic_client addr add 10.99.0.1/24 dev veth_client
+ip -n pquic_server addr add 10.99.0.2/24 dev veth_server
+ip -n pquic_client link set veth_client up
+ip -n pquic_server link set veth_server up
+
+ip -n pquic_client link set lo up
+ip -n pquic_server link set lo up
+
+# The tun devices are created by picoquicvpn itself, with the queues and flags given in the options
+ip netns exec pquic_server ./picoquicvpn -P $PLUGIN -p 4443 $OPTIONS > server.log 2>&1 &
+SERVER_PID=$!
+sleep 1
+ip netns exec pquic_client ./picoquicvpn -P $PLUGIN $OPTIONS 10.99.0.2 4443 > client.log 2>&1 &
+CLIENT_PID=$!
+sleep 2
+
+ip -n pquic_client addr add 10.100.0.1/24 dev tun0
+ip -n pquic_server addr add 10.100.0.2/24 dev tun1
+ip -n pquic_client link set tun0 up mtu 1200
+ip -n pquic_server link set tun1 up mtu 1200
+
+ip netns exec pquic_server iperf3 -s -1 -D
+sleep 1
+ip netns exec pquic_client iperf3 -c 10.100.0.2 -t $DURATION
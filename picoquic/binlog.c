@@ -0,0 +1,542 @@
+/*
+* Binary trace of the packets, see binlog.h
+*/
+#include <stdlib.h>
+#include <string.h>
+#include "picoquic_internal.h"
+#include "tls_api.h"
+#include "binlog.h"
+
+#define BINLOG_VARINT_MAX 10
+/* Sequence number and fixed fields of the largest record, without its byte strings */
+#define BINLOG_FIELDS_MAX (16 * BINLOG_VARINT_MAX + 2 * PICOQUIC_CONNECTION_ID_MAX_SIZE)
+/* Zeroes after the copy of a byte string, as the text log may read past the bytes it is given */
+#define BINLOG_DUMP_PADDING 64
+
+static uint8_t* binlog_varint(uint8_t* bytes, uint64_t v)
+{
+    while (v >= 0x80) {
+        *bytes++ = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    *bytes++ = (uint8_t)v;
+
+    return bytes;
+}
+
+static uint8_t* binlog_bytes(uint8_t* bytes, const uint8_t* data, size_t length)
+{
+    bytes = binlog_varint(bytes, length);
+    if (length > 0) {
+        memcpy(bytes, data, length);
+    }
+
+    return bytes + length;
+}
+
+/* Return codes may be negative */
+static uint64_t binlog_zigzag(int64_t v)
+{
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static int64_t binlog_unzigzag(uint64_t v)
+{
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+picoquic_binlog_t* picoquic_binlog_open(FILE* F)
+{
+    picoquic_binlog_t* binlog = (picoquic_binlog_t*)malloc(sizeof(picoquic_binlog_t));
+
+    if (binlog != NULL) {
+        uint8_t header[5];
+
+        memset(binlog, 0, offsetof(picoquic_binlog_t, buffer));
+        binlog->buffer.length = 0;
+        binlog->F = F;
+        memcpy(header, PICOQUIC_BINLOG_MAGIC, 4);
+        header[4] = PICOQUIC_BINLOG_VERSION;
+        if (fwrite(header, 1, sizeof(header), F) != sizeof(header)) {
+            free(binlog);
+            binlog = NULL;
+        }
+    }
+
+    return binlog;
+}
+
+static void binlog_write_buffer(picoquic_binlog_t* binlog, picoquic_binlog_buffer_t* buffer)
+{
+    if (buffer->length > 0) {
+        (void)fwrite(buffer->bytes, 1, buffer->length, binlog->F);
+        buffer->length = 0;
+        binlog->nb_writes++;
+    }
+}
+
+void picoquic_binlog_close(picoquic_binlog_t* binlog)
+{
+    if (binlog != NULL) {
+        binlog_write_buffer(binlog, &binlog->buffer);
+        fflush(binlog->F);
+        free(binlog);
+    }
+}
+
+int picoquic_set_binlog(picoquic_quic_t* quic, FILE* F)
+{
+    int ret = 0;
+
+    if (quic->binlog != NULL) {
+        picoquic_binlog_flush(quic);
+        picoquic_binlog_close(quic->binlog);
+        quic->binlog = NULL;
+    }
+
+    if (F != NULL) {
+        quic->binlog = picoquic_binlog_open(F);
+        if (quic->binlog == NULL) {
+            ret = PICOQUIC_ERROR_MEMORY;
+        }
+    }
+
+    return ret;
+}
+
+void picoquic_binlog_release_cnx(picoquic_cnx_t* cnx)
+{
+    if (cnx->binlog_buffer != NULL) {
+        if (cnx->quic->binlog != NULL) {
+            binlog_write_buffer(cnx->quic->binlog, cnx->binlog_buffer);
+        }
+        free(cnx->binlog_buffer);
+        cnx->binlog_buffer = NULL;
+    }
+}
+
+void picoquic_binlog_flush(picoquic_quic_t* quic)
+{
+    if (quic->binlog != NULL) {
+        for (picoquic_cnx_t* cnx = quic->cnx_list; cnx != NULL; cnx = cnx->next_in_table) {
+            if (cnx->binlog_buffer != NULL) {
+                binlog_write_buffer(quic->binlog, cnx->binlog_buffer);
+            }
+        }
+        binlog_write_buffer(quic->binlog, &quic->binlog->buffer);
+        fflush(quic->binlog->F);
+    }
+}
+
+static picoquic_binlog_buffer_t* binlog_get_buffer(picoquic_binlog_t* binlog, picoquic_cnx_t* cnx)
+{
+    if (cnx == NULL || cnx->quic->binlog != binlog) {
+        return &binlog->buffer;
+    }
+
+    if (cnx->binlog_buffer == NULL) {
+        cnx->binlog_buffer = (picoquic_binlog_buffer_t*)malloc(sizeof(picoquic_binlog_buffer_t));
+        if (cnx->binlog_buffer == NULL) {
+            return &binlog->buffer;
+        }
+        cnx->binlog_buffer->length = 0;
+    }
+
+    return cnx->binlog_buffer;
+}
+
+/* Makes room for a record of at most body_max bytes and returns where its fields start, after the sequence number */
+static uint8_t* binlog_record_start(picoquic_binlog_t* binlog, picoquic_binlog_buffer_t* buffer, size_t body_max)
+{
+    if (body_max > PICOQUIC_BINLOG_RECORD_MAX) {
+        binlog->nb_dropped++;
+        return NULL;
+    }
+
+    if (buffer->length + PICOQUIC_BINLOG_RECORD_HEADER_SIZE + body_max > PICOQUIC_BINLOG_BUFFER_SIZE) {
+        binlog_write_buffer(binlog, buffer);
+    }
+
+    return binlog_varint(buffer->bytes + buffer->length + PICOQUIC_BINLOG_RECORD_HEADER_SIZE, binlog->sequence++);
+}
+
+static void binlog_record_end(picoquic_binlog_t* binlog, picoquic_binlog_buffer_t* buffer,
+    picoquic_binlog_record_enum type, uint8_t* end)
+{
+    uint8_t* header = buffer->bytes + buffer->length;
+    size_t body_length = end - header - PICOQUIC_BINLOG_RECORD_HEADER_SIZE;
+
+    header[0] = (uint8_t)type;
+    header[1] = (uint8_t)(body_length >> 8);
+    header[2] = (uint8_t)body_length;
+    buffer->length += PICOQUIC_BINLOG_RECORD_HEADER_SIZE + body_length;
+    binlog->nb_records++;
+}
+
+void picoquic_binlog_segment(picoquic_binlog_t* binlog, picoquic_cnx_t* cnx,
+    int receiving, picoquic_packet_header* ph, uint8_t* bytes, size_t length, int ret)
+{
+    uint64_t log_cnxid64 = picoquic_log_segment_cnxid64(1, cnx, ph, ret);
+    uint8_t* data = NULL;
+    size_t data_length = 0;
+    picoquic_binlog_buffer_t* buffer;
+    uint8_t* p;
+
+    /* Only the bytes that picoquic_log_segment reads */
+    if (ret == 0) {
+        if (ph->ptype == picoquic_packet_version_negotiation || ph->ptype == picoquic_packet_retry) {
+            if (length > ph->offset) {
+                data = bytes + ph->offset;
+                data_length = length - ph->offset;
+            }
+        } else if (ph->ptype != picoquic_packet_error) {
+            data = bytes + ph->offset;
+            data_length = ph->payload_length;
+        }
+    }
+
+    buffer = binlog_get_buffer(binlog, cnx);
+    if ((p = binlog_record_start(binlog, buffer, BINLOG_FIELDS_MAX + data_length)) == NULL) {
+        return;
+    }
+    p = binlog_varint(p, log_cnxid64);
+    p = binlog_varint(p, receiving);
+    p = binlog_varint(p, binlog_zigzag(ret));
+    p = binlog_varint(p, ph->ptype);
+    p = binlog_varint(p, ph->spin);
+    p = binlog_varint(p, ph->vn);
+    p = binlog_bytes(p, ph->dest_cnx_id.id, ph->dest_cnx_id.id_len);
+    p = binlog_bytes(p, ph->srce_cnx_id.id, ph->srce_cnx_id.id_len);
+    p = binlog_varint(p, ph->pn);
+    p = binlog_varint(p, ph->pn64);
+    p = binlog_varint(p, ph->payload_length);
+    p = binlog_bytes(p, data, data_length);
+    binlog_record_end(binlog, buffer, picoquic_binlog_record_segment, p);
+}
+
+void picoquic_binlog_outgoing_segment(picoquic_binlog_t* binlog, picoquic_cnx_t* cnx,
+    uint8_t* bytes, uint64_t sequence_number, uint32_t length,
+    uint8_t* send_buffer, uint32_t send_length)
+{
+    picoquic_packet_header ph;
+    int ret = picoquic_log_outgoing_header(cnx, sequence_number, send_buffer, send_length, &ph);
+
+    picoquic_binlog_segment(binlog, cnx, 0, &ph, bytes, length, ret);
+}
+
+void picoquic_binlog_frames(picoquic_binlog_t* binlog, picoquic_cnx_t* cnx,
+    uint64_t cnx_id64, uint8_t* bytes, size_t length)
+{
+    picoquic_binlog_buffer_t* buffer = binlog_get_buffer(binlog, cnx);
+    uint8_t* p = binlog_record_start(binlog, buffer, BINLOG_FIELDS_MAX + length);
+
+    if (p != NULL) {
+        p = binlog_varint(p, cnx_id64);
+        p = binlog_bytes(p, bytes, length);
+        binlog_record_end(binlog, buffer, picoquic_binlog_record_frames, p);
+    }
+}
+
+void picoquic_binlog_congestion_state(picoquic_binlog_t* binlog, picoquic_cnx_t* cnx, uint64_t current_time)
+{
+    picoquic_log_cc_state_t cc_state;
+    picoquic_binlog_buffer_t* buffer = binlog_get_buffer(binlog, cnx);
+    uint8_t* p = binlog_record_start(binlog, buffer, BINLOG_FIELDS_MAX);
+
+    if (p != NULL) {
+        picoquic_log_get_cc_state(cnx, current_time, &cc_state);
+        p = binlog_varint(p, cc_state.cnx_id_64);
+        p = binlog_varint(p, cc_state.delta_t);
+        p = binlog_varint(p, cc_state.cwin);
+        p = binlog_varint(p, cc_state.bytes_in_transit);
+        p = binlog_varint(p, cc_state.nb_retransmission_total);
+        p = binlog_varint(p, cc_state.rtt_min);
+        p = binlog_varint(p, cc_state.smoothed_rtt);
+        p = binlog_varint(p, cc_state.rtt_variant);
+        p = binlog_varint(p, cc_state.max_ack_delay);
+        p = binlog_varint(p, cc_state.cnx_state);
+        binlog_record_end(binlog, buffer, picoquic_binlog_record_cc_state, p);
+    }
+}
+
+void picoquic_binlog_transport_extension(picoquic_binlog_t* binlog, picoquic_cnx_t* cnx, int log_cnxid)
+{
+    uint8_t* bytes = NULL;
+    size_t bytes_max = 0;
+    int ext_received_return = 0;
+    int client_mode = 1;
+    char const* sni = picoquic_tls_get_sni(cnx);
+    char const* alpn = picoquic_tls_get_negotiated_alpn(cnx);
+    size_t sni_length = (sni == NULL) ? 0 : strlen(sni);
+    size_t alpn_length = (alpn == NULL) ? 0 : strlen(alpn);
+    picoquic_binlog_buffer_t* buffer;
+    uint8_t* p;
+
+    picoquic_provide_received_transport_extensions(cnx,
+        &bytes, &bytes_max, &ext_received_return, &client_mode);
+
+    buffer = binlog_get_buffer(binlog, cnx);
+    if ((p = binlog_record_start(binlog, buffer, BINLOG_FIELDS_MAX + sni_length + alpn_length + bytes_max)) == NULL) {
+        return;
+    }
+    p = binlog_varint(p, log_cnxid != 0);
+    p = binlog_varint(p, picoquic_val64_connection_id(picoquic_get_logging_cnxid(cnx)));
+    p = binlog_varint(p, sni != NULL);
+    p = binlog_bytes(p, (const uint8_t*)sni, sni_length);
+    p = binlog_varint(p, alpn != NULL);
+    p = binlog_bytes(p, (const uint8_t*)alpn, alpn_length);
+    p = binlog_varint(p, client_mode);
+    p = binlog_varint(p, cnx->proposed_version);
+    p = binlog_varint(p, picoquic_supported_versions[cnx->version_index].version);
+    p = binlog_bytes(p, bytes, bytes_max);
+    binlog_record_end(binlog, buffer, picoquic_binlog_record_transport_extension, p);
+}
+
+/* Decoding */
+
+typedef struct st_binlog_record_t {
+    uint64_t sequence;
+    uint8_t type;
+    const uint8_t* fields; /* After the sequence number */
+    const uint8_t* end;
+} binlog_record_t;
+
+typedef struct st_binlog_reader_t {
+    const uint8_t* bytes;
+    const uint8_t* end;
+    int error;
+    uint8_t copy[PICOQUIC_BINLOG_RECORD_MAX + BINLOG_DUMP_PADDING];
+} binlog_reader_t;
+
+static uint64_t binlog_read_varint(binlog_reader_t* r)
+{
+    uint64_t v = 0;
+
+    for (int shift = 0; !r->error; shift += 7) {
+        if (r->bytes >= r->end || shift > 63) {
+            r->error = 1;
+        } else {
+            uint8_t b = *r->bytes++;
+            v |= ((uint64_t)(b & 0x7f)) << shift;
+            if ((b & 0x80) == 0) {
+                return v;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/* Returns the bytes in a zero padded copy, at the given offset of the copy buffer */
+static uint8_t* binlog_read_bytes(binlog_reader_t* r, size_t copy_offset, size_t* length)
+{
+    uint64_t l = binlog_read_varint(r);
+
+    if (r->error || l > (uint64_t)(r->end - r->bytes) || copy_offset + l + BINLOG_DUMP_PADDING > sizeof(r->copy)) {
+        r->error = 1;
+        *length = 0;
+        return r->copy;
+    }
+    memcpy(r->copy + copy_offset, r->bytes, (size_t)l);
+    memset(r->copy + copy_offset + l, 0, BINLOG_DUMP_PADDING);
+    r->bytes += l;
+    *length = (size_t)l;
+
+    return r->copy + copy_offset;
+}
+
+static void binlog_read_cnx_id(binlog_reader_t* r, picoquic_connection_id_t* cid)
+{
+    uint64_t l = binlog_read_varint(r);
+
+    if (r->error || l > PICOQUIC_CONNECTION_ID_MAX_SIZE || l > (uint64_t)(r->end - r->bytes)) {
+        r->error = 1;
+    } else {
+        memset(cid, 0, sizeof(picoquic_connection_id_t));
+        memcpy(cid->id, r->bytes, (size_t)l);
+        cid->id_len = (uint8_t)l;
+        r->bytes += l;
+    }
+}
+
+static int binlog_dump_record(binlog_reader_t* r, binlog_record_t* record, FILE* F)
+{
+    r->bytes = record->fields;
+    r->end = record->end;
+    r->error = 0;
+
+    switch (record->type) {
+    case picoquic_binlog_record_segment: {
+        picoquic_packet_header ph;
+        uint64_t log_cnxid64 = binlog_read_varint(r);
+        int receiving = (int)binlog_read_varint(r);
+        int ret = (int)binlog_unzigzag(binlog_read_varint(r));
+        size_t length = 0;
+        uint8_t* bytes;
+
+        memset(&ph, 0, sizeof(ph));
+        ph.ptype = (picoquic_packet_type_enum)binlog_read_varint(r);
+        ph.spin = (unsigned int)binlog_read_varint(r);
+        ph.vn = (uint32_t)binlog_read_varint(r);
+        binlog_read_cnx_id(r, &ph.dest_cnx_id);
+        binlog_read_cnx_id(r, &ph.srce_cnx_id);
+        ph.pn = (uint32_t)binlog_read_varint(r);
+        ph.pn64 = binlog_read_varint(r);
+        ph.payload_length = (uint16_t)binlog_read_varint(r);
+        bytes = binlog_read_bytes(r, 0, &length);
+        if (!r->error) {
+            picoquic_log_segment(F, log_cnxid64, receiving, &ph, bytes, length, ret);
+        }
+        break;
+    }
+    case picoquic_binlog_record_frames: {
+        uint64_t cnx_id64 = binlog_read_varint(r);
+        size_t length = 0;
+        uint8_t* bytes = binlog_read_bytes(r, 0, &length);
+
+        if (!r->error) {
+            picoquic_log_frames(F, cnx_id64, bytes, length);
+        }
+        break;
+    }
+    case picoquic_binlog_record_cc_state: {
+        picoquic_log_cc_state_t cc_state;
+
+        cc_state.cnx_id_64 = binlog_read_varint(r);
+        cc_state.delta_t = binlog_read_varint(r);
+        cc_state.cwin = binlog_read_varint(r);
+        cc_state.bytes_in_transit = binlog_read_varint(r);
+        cc_state.nb_retransmission_total = binlog_read_varint(r);
+        cc_state.rtt_min = binlog_read_varint(r);
+        cc_state.smoothed_rtt = binlog_read_varint(r);
+        cc_state.rtt_variant = binlog_read_varint(r);
+        cc_state.max_ack_delay = binlog_read_varint(r);
+        cc_state.cnx_state = binlog_read_varint(r);
+        if (!r->error) {
+            picoquic_log_cc_state(F, &cc_state);
+        }
+        break;
+    }
+    case picoquic_binlog_record_transport_extension: {
+        int log_cnxid = (int)binlog_read_varint(r);
+        uint64_t cnx_id_64 = binlog_read_varint(r);
+        int has_sni = (int)binlog_read_varint(r);
+        size_t sni_length = 0;
+        char* sni = (char*)binlog_read_bytes(r, 0, &sni_length);
+        int has_alpn = (int)binlog_read_varint(r);
+        size_t alpn_length = 0;
+        char* alpn = (char*)binlog_read_bytes(r, sni_length + 1, &alpn_length);
+        int client_mode = (int)binlog_read_varint(r);
+        uint32_t initial_version = (uint32_t)binlog_read_varint(r);
+        uint32_t final_version = (uint32_t)binlog_read_varint(r);
+        size_t bytes_max = 0;
+        uint8_t* bytes = binlog_read_bytes(r, sni_length + alpn_length + 2, &bytes_max);
+
+        if (!r->error) {
+            picoquic_log_transport_extension_values(F, log_cnxid, cnx_id_64, (has_sni) ? sni : NULL,
+                (has_alpn) ? alpn : NULL, bytes, bytes_max, client_mode, initial_version, final_version);
+        }
+        break;
+    }
+    default:
+        /* Records of a later version are skipped */
+        break;
+    }
+
+    return (r->error) ? -1 : 0;
+}
+
+static int binlog_record_compare(const void* a, const void* b)
+{
+    uint64_t sa = ((const binlog_record_t*)a)->sequence;
+    uint64_t sb = ((const binlog_record_t*)b)->sequence;
+
+    return (sa < sb) ? -1 : ((sa > sb) ? 1 : 0);
+}
+
+int picoquic_binlog_dump(FILE* F_bin, FILE* F_txt)
+{
+    int ret = 0;
+    uint8_t* trace = NULL;
+    size_t trace_length = 0;
+    size_t trace_size = 0;
+    binlog_record_t* records = NULL;
+    size_t nb_records = 0;
+    size_t records_size = 0;
+    binlog_reader_t* reader = (binlog_reader_t*)malloc(sizeof(binlog_reader_t));
+
+    /* The records of the connections are interleaved, they are sorted once all are read */
+    while (ret == 0 && reader != NULL) {
+        size_t nb_read;
+
+        if (trace_length == trace_size) {
+            uint8_t* new_trace = (uint8_t*)realloc(trace, (trace_size == 0) ? PICOQUIC_BINLOG_BUFFER_SIZE : 2 * trace_size);
+            if (new_trace == NULL) {
+                ret = -1;
+                break;
+            }
+            trace = new_trace;
+            trace_size = (trace_size == 0) ? PICOQUIC_BINLOG_BUFFER_SIZE : 2 * trace_size;
+        }
+        nb_read = fread(trace + trace_length, 1, trace_size - trace_length, F_bin);
+        if (nb_read == 0) {
+            break;
+        }
+        trace_length += nb_read;
+    }
+
+    if (reader == NULL || trace_length < 5 || memcmp(trace, PICOQUIC_BINLOG_MAGIC, 4) != 0 ||
+        trace[4] != PICOQUIC_BINLOG_VERSION) {
+        ret = -1;
+    }
+
+    for (size_t offset = 5; ret == 0 && offset < trace_length;) {
+        size_t body_length;
+
+        if (offset + PICOQUIC_BINLOG_RECORD_HEADER_SIZE > trace_length) {
+            ret = -1;
+            break;
+        }
+        body_length = ((size_t)trace[offset + 1] << 8) | trace[offset + 2];
+        if (offset + PICOQUIC_BINLOG_RECORD_HEADER_SIZE + body_length > trace_length) {
+            ret = -1;
+            break;
+        }
+        if (nb_records == records_size) {
+            binlog_record_t* new_records = (binlog_record_t*)realloc(records,
+                ((records_size == 0) ? 1024 : 2 * records_size) * sizeof(binlog_record_t));
+            if (new_records == NULL) {
+                ret = -1;
+                break;
+            }
+            records = new_records;
+            records_size = (records_size == 0) ? 1024 : 2 * records_size;
+        }
+        reader->bytes = trace + offset + PICOQUIC_BINLOG_RECORD_HEADER_SIZE;
+        reader->end = reader->bytes + body_length;
+        reader->error = 0;
+        records[nb_records].type = trace[offset];
+        records[nb_records].sequence = binlog_read_varint(reader);
+        records[nb_records].fields = reader->bytes;
+        records[nb_records].end = reader->end;
+        if (reader->error) {
+            ret = -1;
+        } else {
+            nb_records++;
+        }
+        offset += PICOQUIC_BINLOG_RECORD_HEADER_SIZE + body_length;
+    }
+
+    if (ret == 0) {
+        qsort(records, nb_records, sizeof(binlog_record_t), binlog_record_compare);
+        for (size_t i = 0; ret == 0 && i < nb_records; i++) {
+            ret = binlog_dump_record(reader, &records[i], F_txt);
+        }
+    }
+
+    free(records);
+    free(trace);
+    free(reader);
+
+    return ret;
+}
@@ -0,0 +1,96 @@
+/**
+ * \file binlog.h
+ * \brief Binary trace of the packets, rendered offline as the text log.
+ *
+ * The text log formats every packet header and frame with fprintf when the
+ * packet is sent or received. The binary trace instead copies the fields
+ * used by the text log and the packet payload in a buffer, and formatting
+ * only happens when the trace is dumped, with the same functions as the
+ * text log. The output of picoquic_binlog_dump is thus identical to the text
+ * log of the same packets.
+ *
+ * The trace starts with the 4 bytes PICOQUIC_BINLOG_MAGIC and a version byte.
+ * Each record has a fixed header of 3 bytes, the record type and the length
+ * of its body as a 16 bit big endian integer. The body starts with the
+ * sequence number of the record, followed by the fields of the record type.
+ * Integers are LEB128 varints and byte strings are a varint length followed
+ * by the bytes.
+ *
+ * The records of a connection are buffered in the connection and written in
+ * a single call when the buffer is full or when the connection is deleted.
+ * Records that do not belong to a connection are buffered in the trace
+ * itself. The buffers of different connections are written in any order, the
+ * dump sorts the records by sequence number.
+ */
+
+#ifndef PICOQUIC_BINLOG_H
+#define PICOQUIC_BINLOG_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "picoquic.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PICOQUIC_BINLOG_MAGIC "PQBT"
+#define PICOQUIC_BINLOG_VERSION 1
+#define PICOQUIC_BINLOG_BUFFER_SIZE 65536
+#define PICOQUIC_BINLOG_RECORD_HEADER_SIZE 3
+#define PICOQUIC_BINLOG_RECORD_MAX 65535 /* Largest body */
+
+typedef enum {
+    picoquic_binlog_record_segment = 1,
+    picoquic_binlog_record_frames = 2,
+    picoquic_binlog_record_cc_state = 3,
+    picoquic_binlog_record_transport_extension = 4
+} picoquic_binlog_record_enum;
+
+typedef struct st_picoquic_binlog_buffer_t {
+    size_t length;
+    uint8_t bytes[PICOQUIC_BINLOG_BUFFER_SIZE];
+} picoquic_binlog_buffer_t;
+
+typedef struct st_picoquic_binlog_t {
+    FILE* F;
+    uint64_t sequence;
+    uint64_t nb_records;
+    uint64_t nb_writes;
+    uint64_t nb_dropped; /* Records larger than PICOQUIC_BINLOG_RECORD_MAX */
+    picoquic_binlog_buffer_t buffer; /* Records without a connection */
+} picoquic_binlog_t;
+
+/* Writes the trace header to F, which stays owned by the caller */
+picoquic_binlog_t* picoquic_binlog_open(FILE* F);
+/* Writes the records without a connection and frees the trace */
+void picoquic_binlog_close(picoquic_binlog_t* binlog);
+
+/* Sets the binary trace of the context, replacing and closing the previous one.
+ * A NULL file disables it. */
+int picoquic_set_binlog(picoquic_quic_t* quic, FILE* F);
+/* Writes the records of the connection and frees its buffer */
+void picoquic_binlog_release_cnx(picoquic_cnx_t* cnx);
+/* Writes the records of all the connections and of the context */
+void picoquic_binlog_flush(picoquic_quic_t* quic);
+
+/* Same content as the functions of the text log, the connection may be NULL */
+void picoquic_binlog_segment(picoquic_binlog_t* binlog, picoquic_cnx_t* cnx,
+    int receiving, picoquic_packet_header* ph, uint8_t* bytes, size_t length, int ret);
+void picoquic_binlog_outgoing_segment(picoquic_binlog_t* binlog, picoquic_cnx_t* cnx,
+    uint8_t* bytes, uint64_t sequence_number, uint32_t length,
+    uint8_t* send_buffer, uint32_t send_length);
+void picoquic_binlog_frames(picoquic_binlog_t* binlog, picoquic_cnx_t* cnx,
+    uint64_t cnx_id64, uint8_t* bytes, size_t length);
+void picoquic_binlog_congestion_state(picoquic_binlog_t* binlog, picoquic_cnx_t* cnx, uint64_t current_time);
+void picoquic_binlog_transport_extension(picoquic_binlog_t* binlog, picoquic_cnx_t* cnx, int log_cnxid);
+
+/* Renders the trace read from F_bin as text in F_txt. Returns 0, or -1 if the trace is malformed. */
+int picoquic_binlog_dump(FILE* F_bin, FILE* F_txt);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PICOQUIC_BINLOG_H */
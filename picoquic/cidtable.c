@@ -0,0 +1,359 @@
+#include <stdlib.h>
+#include <string.h>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CID_TABLE_SSE2
+#endif
+#include "cidtable.h"
+
+#define CID_TABLE_GROUP_SIZE 16
+#define CID_TABLE_EMPTY 0x80
+#define CID_TABLE_DELETED 0xFE
+#define CID_TABLE_MIGRATE_GROUPS 4 /* Groups moved to the new array by each operation during a resize */
+
+typedef struct st_picoquic_cid_table_slot_t {
+    picoquic_connection_id_t cid;
+    void* value;
+} picoquic_cid_table_slot_t;
+
+/* Control bytes are either EMPTY, DELETED, or the 7 low bits of the hash for a full slot */
+typedef struct st_picoquic_cid_table_array_t {
+    uint8_t* ctrl;
+    picoquic_cid_table_slot_t* slots;
+    size_t nb_groups; /* Power of 2 */
+    size_t nb_full;
+    size_t nb_deleted;
+} picoquic_cid_table_array_t;
+
+struct st_picoquic_cid_table_t {
+    picoquic_cid_table_array_t current;
+    picoquic_cid_table_array_t previous; /* Being moved to current during a resize, ctrl is NULL otherwise */
+    size_t next_group_to_migrate;
+    uint64_t seed;
+};
+
+static uint64_t cid_table_hash(const picoquic_connection_id_t* cid, uint64_t seed)
+{
+    uint64_t h = seed ^ ((uint64_t)cid->id_len * 0x9E3779B97F4A7C15ull);
+
+    for (size_t i = 0; i < cid->id_len; i += 8) {
+        uint64_t w = 0;
+        size_t l = (cid->id_len - i < 8) ? cid->id_len - i : 8;
+        memcpy(&w, cid->id + i, l);
+        h = (h ^ w) * 0xBF58476D1CE4E5B9ull;
+        h ^= h >> 31;
+    }
+
+    return h;
+}
+
+static inline int cid_table_cid_equal(const picoquic_connection_id_t* cid1, const picoquic_connection_id_t* cid2)
+{
+    return cid1->id_len == cid2->id_len && memcmp(cid1->id, cid2->id, cid1->id_len) == 0;
+}
+
+/* Returns a bit mask of the slots of the group whose control byte is tag */
+static inline uint32_t cid_table_match(const uint8_t* ctrl, uint8_t tag)
+{
+#ifdef CID_TABLE_SSE2
+    __m128i group = _mm_loadu_si128((const __m128i*)ctrl);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)tag)));
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < CID_TABLE_GROUP_SIZE; i++) {
+        if (ctrl[i] == tag) {
+            mask |= 1u << i;
+        }
+    }
+    return mask;
+#endif
+}
+
+/* Returns a bit mask of the empty or deleted slots of the group */
+static inline uint32_t cid_table_match_free(const uint8_t* ctrl)
+{
+#ifdef CID_TABLE_SSE2
+    return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)ctrl));
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < CID_TABLE_GROUP_SIZE; i++) {
+        if (ctrl[i] & 0x80) {
+            mask |= 1u << i;
+        }
+    }
+    return mask;
+#endif
+}
+
+static inline int cid_table_first_bit(uint32_t mask)
+{
+#if defined(__GNUC__)
+    return __builtin_ctz(mask);
+#else
+    int i = 0;
+    while ((mask & 1) == 0) {
+        mask >>= 1;
+        i++;
+    }
+    return i;
+#endif
+}
+
+static int cid_table_array_init(picoquic_cid_table_array_t* array, size_t nb_groups)
+{
+    size_t nb_slots = nb_groups * CID_TABLE_GROUP_SIZE;
+
+    memset(array, 0, sizeof(picoquic_cid_table_array_t));
+    array->ctrl = (uint8_t*)malloc(nb_slots);
+    array->slots = (picoquic_cid_table_slot_t*)malloc(nb_slots * sizeof(picoquic_cid_table_slot_t));
+
+    if (array->ctrl == NULL || array->slots == NULL) {
+        free(array->ctrl);
+        free(array->slots);
+        array->ctrl = NULL;
+        array->slots = NULL;
+        return -1;
+    }
+
+    memset(array->ctrl, CID_TABLE_EMPTY, nb_slots);
+    array->nb_groups = nb_groups;
+    return 0;
+}
+
+static void cid_table_array_clear(picoquic_cid_table_array_t* array)
+{
+    free(array->ctrl);
+    free(array->slots);
+    memset(array, 0, sizeof(picoquic_cid_table_array_t));
+}
+
+/* Returns the index of the slot holding the connection ID, or -1 */
+static int64_t cid_table_array_find(picoquic_cid_table_array_t* array, const picoquic_connection_id_t* cid, uint64_t hash)
+{
+    size_t group_mask = array->nb_groups - 1;
+    size_t group = (size_t)(hash >> 7) & group_mask;
+    uint8_t tag = (uint8_t)(hash & 0x7F);
+
+    for (size_t probe = 0; probe < array->nb_groups; probe++) {
+        const uint8_t* ctrl = array->ctrl + group * CID_TABLE_GROUP_SIZE;
+        uint32_t mask = cid_table_match(ctrl, tag);
+
+        while (mask != 0) {
+            size_t index = group * CID_TABLE_GROUP_SIZE + cid_table_first_bit(mask);
+            if (cid_table_cid_equal(&array->slots[index].cid, cid)) {
+                return (int64_t)index;
+            }
+            mask &= mask - 1;
+        }
+
+        if (cid_table_match(ctrl, CID_TABLE_EMPTY) != 0) {
+            /* The entry would have been placed in this group */
+            break;
+        }
+
+        /* Triangular probing visits every group when their number is a power of 2 */
+        group = (group + probe + 1) & group_mask;
+    }
+
+    return -1;
+}
+
+/* Places an entry known to be absent in the first free slot of its probe sequence */
+static void cid_table_array_put(picoquic_cid_table_array_t* array, const picoquic_connection_id_t* cid, void* value, uint64_t hash)
+{
+    size_t group_mask = array->nb_groups - 1;
+    size_t group = (size_t)(hash >> 7) & group_mask;
+
+    for (size_t probe = 0; probe < array->nb_groups; probe++) {
+        uint8_t* ctrl = array->ctrl + group * CID_TABLE_GROUP_SIZE;
+        uint32_t mask = cid_table_match_free(ctrl);
+
+        if (mask != 0) {
+            int i = cid_table_first_bit(mask);
+            size_t index = group * CID_TABLE_GROUP_SIZE + i;
+
+            if (ctrl[i] == CID_TABLE_DELETED) {
+                array->nb_deleted--;
+            }
+            ctrl[i] = (uint8_t)(hash & 0x7F);
+            array->slots[index].cid = *cid;
+            array->slots[index].value = value;
+            array->nb_full++;
+            return;
+        }
+
+        group = (group + probe + 1) & group_mask;
+    }
+}
+
+static void cid_table_array_erase(picoquic_cid_table_array_t* array, size_t index)
+{
+    uint8_t* group_ctrl = array->ctrl + (index & ~((size_t)CID_TABLE_GROUP_SIZE - 1));
+
+    /* A group that still has an empty slot was never full, so no probe sequence goes past it */
+    if (cid_table_match(group_ctrl, CID_TABLE_EMPTY) != 0) {
+        array->ctrl[index] = CID_TABLE_EMPTY;
+    } else {
+        array->ctrl[index] = CID_TABLE_DELETED;
+        array->nb_deleted++;
+    }
+    array->nb_full--;
+}
+
+/* Moves up to nb_groups groups of the previous array to the current one */
+static void cid_table_migrate(picoquic_cid_table_t* table, size_t nb_groups)
+{
+    picoquic_cid_table_array_t* previous = &table->previous;
+
+    while (nb_groups > 0 && table->next_group_to_migrate < previous->nb_groups) {
+        size_t first = table->next_group_to_migrate * CID_TABLE_GROUP_SIZE;
+
+        for (size_t index = first; index < first + CID_TABLE_GROUP_SIZE; index++) {
+            if ((previous->ctrl[index] & 0x80) == 0) {
+                picoquic_cid_table_slot_t* slot = &previous->slots[index];
+                cid_table_array_put(&table->current, &slot->cid, slot->value, cid_table_hash(&slot->cid, table->seed));
+                /* Keep the probe sequences of the previous array valid until it is freed */
+                previous->ctrl[index] = CID_TABLE_DELETED;
+                previous->nb_full--;
+            }
+        }
+
+        table->next_group_to_migrate++;
+        nb_groups--;
+    }
+
+    if (table->next_group_to_migrate >= previous->nb_groups) {
+        cid_table_array_clear(previous);
+        table->next_group_to_migrate = 0;
+    }
+}
+
+/* Starts moving the entries to a new array, twice as large unless most slots are deleted ones */
+static int cid_table_start_resize(picoquic_cid_table_t* table)
+{
+    picoquic_cid_table_array_t next;
+    size_t capacity;
+    size_t nb_groups;
+
+    if (table->previous.ctrl != NULL) {
+        cid_table_migrate(table, table->previous.nb_groups);
+    }
+
+    capacity = table->current.nb_groups * CID_TABLE_GROUP_SIZE;
+    nb_groups = (table->current.nb_full * 2 < capacity) ? table->current.nb_groups : table->current.nb_groups * 2;
+
+    if (cid_table_array_init(&next, nb_groups) != 0) {
+        return -1;
+    }
+
+    table->previous = table->current;
+    table->current = next;
+    table->next_group_to_migrate = 0;
+    return 0;
+}
+
+picoquic_cid_table_t* picoquic_cid_table_create(size_t nb_entries, uint64_t seed)
+{
+    picoquic_cid_table_t* table = (picoquic_cid_table_t*)malloc(sizeof(picoquic_cid_table_t));
+    size_t nb_groups = 1;
+
+    /* Keep the table at most 7/8 full */
+    while (nb_groups * CID_TABLE_GROUP_SIZE * 7 < nb_entries * 8) {
+        nb_groups <<= 1;
+    }
+
+    if (table != NULL) {
+        memset(table, 0, sizeof(picoquic_cid_table_t));
+        table->seed = seed;
+        if (cid_table_array_init(&table->current, nb_groups) != 0) {
+            free(table);
+            table = NULL;
+        }
+    }
+
+    return table;
+}
+
+void picoquic_cid_table_free(picoquic_cid_table_t* table)
+{
+    if (table != NULL) {
+        cid_table_array_clear(&table->current);
+        cid_table_array_clear(&table->previous);
+        free(table);
+    }
+}
+
+int picoquic_cid_table_insert(picoquic_cid_table_t* table, const picoquic_connection_id_t* cid, void* value)
+{
+    uint64_t hash = cid_table_hash(cid, table->seed);
+    size_t capacity;
+
+    if (table->previous.ctrl != NULL) {
+        if (cid_table_array_find(&table->previous, cid, hash) >= 0) {
+            return -1;
+        }
+        cid_table_migrate(table, CID_TABLE_MIGRATE_GROUPS);
+    }
+
+    if (cid_table_array_find(&table->current, cid, hash) >= 0) {
+        return -1;
+    }
+
+    capacity = table->current.nb_groups * CID_TABLE_GROUP_SIZE;
+    if ((table->current.nb_full + table->current.nb_deleted + 1) * 8 > capacity * 7) {
+        if (cid_table_start_resize(table) != 0) {
+            return -1;
+        }
+    }
+
+    cid_table_array_put(&table->current, cid, value, hash);
+    return 0;
+}
+
+void* picoquic_cid_table_lookup(picoquic_cid_table_t* table, const picoquic_connection_id_t* cid)
+{
+    uint64_t hash = cid_table_hash(cid, table->seed);
+    int64_t index = cid_table_array_find(&table->current, cid, hash);
+
+    if (index >= 0) {
+        return table->current.slots[index].value;
+    }
+
+    if (table->previous.ctrl != NULL) {
+        index = cid_table_array_find(&table->previous, cid, hash);
+        if (index >= 0) {
+            return table->previous.slots[index].value;
+        }
+    }
+
+    return NULL;
+}
+
+void* picoquic_cid_table_remove(picoquic_cid_table_t* table, const picoquic_connection_id_t* cid)
+{
+    uint64_t hash = cid_table_hash(cid, table->seed);
+    void* value = NULL;
+    int64_t index = cid_table_array_find(&table->current, cid, hash);
+
+    if (index >= 0) {
+        value = table->current.slots[index].value;
+        cid_table_array_erase(&table->current, (size_t)index);
+    } else if (table->previous.ctrl != NULL) {
+        index = cid_table_array_find(&table->previous, cid, hash);
+        if (index >= 0) {
+            value = table->previous.slots[index].value;
+            cid_table_array_erase(&table->previous, (size_t)index);
+        }
+    }
+
+    if (table->previous.ctrl != NULL) {
+        cid_table_migrate(table, CID_TABLE_MIGRATE_GROUPS);
+    }
+
+    return value;
+}
+
+size_t picoquic_cid_table_count(picoquic_cid_table_t* table)
+{
+    return table->current.nb_full + table->previous.nb_full;
+}
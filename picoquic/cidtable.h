@@ -0,0 +1,73 @@
+/**
+ * \file cidtable.h
+ * \brief Open addressing index of the connections by connection ID.
+ *
+ * The connection IDs are stored inline in the table, next to the value, so
+ * that registering a connection ID does not allocate memory. Slots are
+ * organised in groups of 16, each slot having a control byte holding 7 bits
+ * of the hash. A lookup compares the 16 control bytes of a group at once
+ * (with SSE2 when available) and only compares the full connection IDs of the
+ * slots whose tag matches.
+ *
+ * When the table becomes too full, a table twice as large is allocated and the
+ * entries are moved a few groups at a time by the following operations, so
+ * that no single insertion pays for the whole rehash.
+ */
+
+#ifndef PICOQUIC_CIDTABLE_H
+#define PICOQUIC_CIDTABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "picoquic.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct st_picoquic_cid_table_t picoquic_cid_table_t;
+
+/**
+ * Creates a table sized for \p nb_entries connection IDs. The table grows
+ * past that number when needed. The \p seed is mixed in the hash of the
+ * connection IDs, so that peers cannot predict the slots of given IDs.
+ *
+ * \return The table, or NULL if the memory could not be allocated
+ */
+picoquic_cid_table_t* picoquic_cid_table_create(size_t nb_entries, uint64_t seed);
+
+/**
+ * Frees the table. The values are not freed.
+ */
+void picoquic_cid_table_free(picoquic_cid_table_t* table);
+
+/**
+ * Associates \p value to the connection ID.
+ *
+ * \return 0 on success, -1 if the connection ID is already present or if the
+ * table could not grow
+ */
+int picoquic_cid_table_insert(picoquic_cid_table_t* table, const picoquic_connection_id_t* cid, void* value);
+
+/**
+ * \return The value associated to the connection ID, or NULL if it is not present
+ */
+void* picoquic_cid_table_lookup(picoquic_cid_table_t* table, const picoquic_connection_id_t* cid);
+
+/**
+ * Removes the connection ID from the table.
+ *
+ * \return The value that was associated to it, or NULL if it was not present
+ */
+void* picoquic_cid_table_remove(picoquic_cid_table_t* table, const picoquic_connection_id_t* cid);
+
+/**
+ * \return The number of connection IDs in the table
+ */
+size_t picoquic_cid_table_count(picoquic_cid_table_t* table);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PICOQUIC_CIDTABLE_H */
@@ -1455,6 +1455,91 @@ protoop_arg_t parse_handshake_done_frame(picoquic_cnx_t* cnx) {
     return (protoop_arg_t) bytes + picoquic_varint_skip(bytes);
 }
 
+protoop_arg_t parse_ack_frequency_frame(picoquic_cnx_t* cnx)
+{
+    uint8_t* bytes = (uint8_t *) cnx->protoop_inputv[0];
+    const uint8_t* bytes_max = (const uint8_t *) cnx->protoop_inputv[1];
+
+    int ack_needed = 1;
+    int is_retransmittable = 1;
+    ack_frequency_frame_t *frame = malloc(sizeof(ack_frequency_frame_t));
+    if (!frame) {
+        printf("Failed to allocate memory for ack_frequency_frame_t\n");
+        protoop_save_outputs(cnx, frame, ack_needed, is_retransmittable);
+        return (protoop_arg_t) NULL;
+    }
+
+    if ((bytes = picoquic_frames_varint_decode(bytes + picoquic_varint_skip(bytes), bytes_max, &frame->sequence_number)) == NULL ||
+        (bytes = picoquic_frames_varint_decode(bytes, bytes_max, &frame->ack_eliciting_threshold)) == NULL ||
+        (bytes = picoquic_frames_varint_decode(bytes, bytes_max, &frame->request_max_ack_delay)) == NULL ||
+        (bytes = picoquic_frames_varint_decode(bytes, bytes_max, &frame->reordering_threshold)) == NULL)
+    {
+        picoquic_connection_error(cnx, PICOQUIC_TRANSPORT_FRAME_FORMAT_ERROR, picoquic_frame_type_ack_frequency);
+        free(frame);
+        frame = NULL;
+    }
+
+    protoop_save_outputs(cnx, frame, ack_needed, is_retransmittable);
+    return (protoop_arg_t) bytes;
+}
+
+/**
+ * See PROTOOP_PARAM_PROCESS_FRAME
+ *
+ * The new policy applies to the application packet context of the path on
+ * which the frame was received. Frames older than the last one applied are
+ * ignored, as they may have been reordered or retransmitted.
+ */
+protoop_arg_t process_ack_frequency_frame(picoquic_cnx_t* cnx)
+{
+    ack_frequency_frame_t* frame = (ack_frequency_frame_t *) cnx->protoop_inputv[0];
+    picoquic_path_t* path_x = (picoquic_path_t *) cnx->protoop_inputv[3];
+    picoquic_packet_context_t* pkt_ctx = &path_x->pkt_ctx[picoquic_packet_context_application];
+
+    if (cnx->local_parameters.min_ack_delay == 0 || frame->request_max_ack_delay < cnx->local_parameters.min_ack_delay) {
+        /* The peer cannot send this frame if we did not advertise min_ack_delay, nor ask for less than it */
+        picoquic_connection_error(cnx, PICOQUIC_TRANSPORT_PROTOCOL_VIOLATION, picoquic_frame_type_ack_frequency);
+        return 1;
+    }
+
+    if (frame->sequence_number >= pkt_ctx->ack_frequency_sequence) {
+        pkt_ctx->ack_frequency_sequence = frame->sequence_number + 1;
+        pkt_ctx->ack_eliciting_threshold = frame->ack_eliciting_threshold;
+        pkt_ctx->reordering_threshold = frame->reordering_threshold;
+        pkt_ctx->ack_frequency_max_delay = frame->request_max_ack_delay;
+        pkt_ctx->ack_delay_local = frame->request_max_ack_delay;
+    }
+
+    return 0;
+}
+
+protoop_arg_t parse_immediate_ack_frame(picoquic_cnx_t* cnx)
+{
+    uint8_t* bytes = (uint8_t *) cnx->protoop_inputv[0];
+
+    int ack_needed = 1;
+    int is_retransmittable = 0;
+    immediate_ack_frame_t *frame = malloc(sizeof(immediate_ack_frame_t));
+    if (!frame) {
+        printf("Failed to allocate memory for immediate_ack_frame_t\n");
+        protoop_save_outputs(cnx, frame, ack_needed, is_retransmittable);
+        return (protoop_arg_t) NULL;
+    }
+
+    protoop_save_outputs(cnx, frame, ack_needed, is_retransmittable);
+    return (protoop_arg_t) bytes + picoquic_varint_skip(bytes);
+}
+
+/**
+ * See PROTOOP_PARAM_PROCESS_FRAME
+ */
+protoop_arg_t process_immediate_ack_frame(picoquic_cnx_t* cnx)
+{
+    picoquic_path_t* path_x = (picoquic_path_t *) cnx->protoop_inputv[3];
+    path_x->pkt_ctx[picoquic_packet_context_application].immediate_ack_requested = 1;
+    return 0;
+}
+
 /**
  * See PROTOOP_PARAM_PROCESS_FRAME
  */
@@ -1635,6 +1720,89 @@ int picoquic_prepare_handshake_done_frame(picoquic_cnx_t* cnx, uint8_t* bytes, s
     return ret;
 }
 
+/**
+ * See PROTOOP_NOPARAM_PREPARE_ACK_FREQUENCY_FRAME
+ *
+ * Asks the peer to acknowledge every 1/PICOQUIC_ACK_FREQUENCY_PER_RTT of the
+ * congestion window, and at least PICOQUIC_ACK_FREQUENCY_PER_RTT times per RTT.
+ * A new frame is only sent once per RTT, when the policy changes noticeably.
+ */
+protoop_arg_t prepare_ack_frequency_frame(picoquic_cnx_t* cnx)
+{
+    picoquic_path_t* path_x = (picoquic_path_t *) cnx->protoop_inputv[0];
+    uint64_t current_time = (uint64_t) cnx->protoop_inputv[1];
+    uint8_t* bytes = (uint8_t *) cnx->protoop_inputv[2];
+    size_t bytes_max = (size_t) cnx->protoop_inputv[3];
+    size_t consumed = 0;
+
+    if (cnx->remote_parameters.min_ack_delay > 0 && path_x->send_mtu > 0) {
+        uint64_t threshold = path_x->cwin / ((uint64_t) path_x->send_mtu * PICOQUIC_ACK_FREQUENCY_PER_RTT);
+        uint64_t max_delay = path_x->smoothed_rtt / PICOQUIC_ACK_FREQUENCY_PER_RTT;
+        int should_send = 0;
+
+        if (threshold < 1) {
+            threshold = 1;
+        } else if (threshold > PICOQUIC_ACK_FREQUENCY_THRESHOLD_MAX) {
+            threshold = PICOQUIC_ACK_FREQUENCY_THRESHOLD_MAX;
+        }
+        if (max_delay < cnx->remote_parameters.min_ack_delay) {
+            max_delay = cnx->remote_parameters.min_ack_delay;
+        } else if (max_delay > PICOQUIC_ACK_DELAY_MAX) {
+            max_delay = PICOQUIC_ACK_DELAY_MAX;
+        }
+
+        if (path_x->ack_frequency_threshold_sent == 0) {
+            /* Nothing to ask as long as the default policy fits the window */
+            should_send = threshold > 1;
+        } else if (current_time >= path_x->ack_frequency_time_sent + path_x->smoothed_rtt) {
+            uint64_t delay_delta = (max_delay > path_x->ack_frequency_delay_sent) ?
+                max_delay - path_x->ack_frequency_delay_sent : path_x->ack_frequency_delay_sent - max_delay;
+            should_send = threshold != path_x->ack_frequency_threshold_sent ||
+                delay_delta > path_x->ack_frequency_delay_sent / 4;
+        }
+
+        if (should_send) {
+            size_t byte_index = 0;
+            size_t l_type = picoquic_varint_encode(bytes, bytes_max, picoquic_frame_type_ack_frequency);
+            size_t l_seq = (l_type > 0) ? picoquic_varint_encode(bytes + l_type, bytes_max - l_type, path_x->ack_frequency_sequence_sent) : 0;
+            byte_index = l_type + l_seq;
+            size_t l_thr = (l_seq > 0) ? picoquic_varint_encode(bytes + byte_index, bytes_max - byte_index, threshold) : 0;
+            byte_index += l_thr;
+            size_t l_delay = (l_thr > 0) ? picoquic_varint_encode(bytes + byte_index, bytes_max - byte_index, max_delay) : 0;
+            byte_index += l_delay;
+            /* Keep the default reordering threshold, out of order packets are acknowledged immediately */
+            size_t l_reorder = (l_delay > 0) ? picoquic_varint_encode(bytes + byte_index, bytes_max - byte_index, 1) : 0;
+            byte_index += l_reorder;
+
+            if (l_reorder > 0) {
+                consumed = byte_index;
+                path_x->ack_frequency_sequence_sent++;
+                path_x->ack_frequency_threshold_sent = threshold;
+                path_x->ack_frequency_delay_sent = max_delay;
+                path_x->ack_frequency_time_sent = current_time;
+            }
+        }
+    }
+
+    if (path_x->immediate_ack_to_send && consumed < bytes_max) {
+        bytes[consumed++] = picoquic_frame_type_immediate_ack;
+        path_x->immediate_ack_to_send = 0;
+    }
+
+    protoop_save_outputs(cnx, consumed);
+    return 0;
+}
+
+int picoquic_prepare_ack_frequency_frame(picoquic_cnx_t* cnx, picoquic_path_t* path_x, uint64_t current_time,
+    uint8_t* bytes, size_t bytes_max, size_t* consumed)
+{
+    protoop_arg_t outs[PROTOOPARGS_MAX];
+    int ret = (int) protoop_prepare_and_run_noparam(cnx, &PROTOOP_NOPARAM_PREPARE_ACK_FREQUENCY_FRAME, outs,
+        path_x, current_time, bytes, bytes_max);
+    *consumed = (size_t) outs[0];
+    return ret;
+}
+
 /*
  * ACK Frames
  */
@@ -1735,6 +1903,10 @@ protoop_arg_t check_spurious_retransmission(picoquic_cnx_t *cnx)
                     old_path->max_reorder_gap = max_reorder_gap;
                 }
 
+                /* The packet was declared lost too early, widen the reorder window of its path */
+                picoquic_update_reorder_window(old_path, pc,
+                    (max_spurious_rtt > old_path->smoothed_rtt) ? max_spurious_rtt - old_path->smoothed_rtt : 0);
+
                 if (cnx->congestion_alg != NULL ) {
                     picoquic_congestion_algorithm_notify_func(cnx, old_path, picoquic_congestion_notification_spurious_repeat,
                         0, 0, p->sequence_number, current_time);
@@ -1771,6 +1943,11 @@ protoop_arg_t update_ack_delay(picoquic_cnx_t* cnx) {
     picoquic_path_t* old_path = (picoquic_path_t *) cnx->protoop_inputv[1];
     int64_t rtt_estimate = (int64_t) cnx->protoop_inputv[2];
     bool first_estimate = (bool) cnx->protoop_inputv[3];
+    if (pkt_ctx->ack_frequency_max_delay != 0) {
+        /* The peer chose the delay with an ACK_FREQUENCY frame */
+        pkt_ctx->ack_delay_local = pkt_ctx->ack_frequency_max_delay;
+        return 0;
+    }
     pkt_ctx->ack_delay_local = old_path->rtt_min / 4;
     if (pkt_ctx->ack_delay_local < 1000) {
         pkt_ctx->ack_delay_local = 1000;
@@ -1868,6 +2045,7 @@ protoop_arg_t update_rtt(picoquic_cnx_t *cnx)
     if (largest > pkt_ctx->highest_acknowledged || pkt_ctx->first_sack_item.start_of_sack_range == (uint64_t)((int64_t)-1) ||
         pkt_ctx->highest_acknowledged == (uint64_t)((int64_t)-1)) { /* This last condition is for Multipath ! */
         pkt_ctx->highest_acknowledged = largest;
+        pkt_ctx->loss_timer_armed = 0;
         is_new_ack = 1;
 
         if (ack_delay < PICOQUIC_ACK_DELAY_MAX) {
@@ -1929,6 +2107,7 @@ protoop_arg_t update_rtt(picoquic_cnx_t *cnx)
                         old_path->retransmit_timer = old_path->smoothed_rtt + 4 * old_path->rtt_variant + old_path->max_ack_delay;
                     }
                     old_path->rtt_sample = rtt_estimate;
+                    picoquic_disarm_loss_timers(old_path);
 
                     if (PICOQUIC_MIN_RETRANSMIT_TIMER > old_path->retransmit_timer) {
                         old_path->retransmit_timer = PICOQUIC_MIN_RETRANSMIT_TIMER;
@@ -2244,8 +2423,47 @@ void picoquic_process_possible_ack_of_ack_frame(picoquic_cnx_t* cnx, picoquic_pa
         p);
 }
 
+/* Releases a packet acknowledged by the peer */
+static void picoquic_process_acked_packet(picoquic_cnx_t* cnx, picoquic_packet_context_enum pc, picoquic_packet_t* p,
+    uint64_t current_time)
+{
+    /* TODO: RTT Estimate */
+    picoquic_path_t * old_path = p->send_path;
+
+    old_path->delivered += p->length;
+    if (cnx->congestion_alg != NULL) {
+        picoquic_congestion_algorithm_notify_func(cnx, old_path,
+            picoquic_congestion_notification_acknowledgement,
+            0, p->length, 0, current_time);
+    }
+
+    /* If the packet contained an ACK frame, perform the ACK of ACK pruning logic */
+    picoquic_process_possible_ack_of_ack_frame(cnx, p);
+
+    /* If packet is larger than the current MTU, update the MTU */
+    if ((p->length + p->checksum_overhead) > old_path->send_mtu) {
+        old_path->send_mtu = (uint32_t)(p->length + p->checksum_overhead);
+        old_path->mtu_probe_sent = 0;
+    }
+
+    /* Any acknowledgement shows progress */
+    p->send_path->pkt_ctx[pc].nb_retransmit = 0;
+    p->send_path->pkt_ctx[pc].loss_timer_armed = 0;
+    p->send_path->pkt_ctx[pc].latest_progress_time = current_time;
+
+    if (p->has_handshake_done) {
+        cnx->handshake_done_acked = 1;
+    }
+
+    picoquic_dequeue_retransmit_packet(cnx, p, 1);
+}
+
 /**
  * See PROTOOP_NOPARAM_PROCESS_ACK_RANGE
+ *
+ * When the retransmit queue is indexed, only the sequence numbers of the range
+ * that overlap the queue are looked up, instead of walking the queue from
+ * \p ppacket. The output packet is the same in both cases.
  */
 protoop_arg_t process_ack_range(picoquic_cnx_t *cnx)
 {
@@ -2256,47 +2474,50 @@ protoop_arg_t process_ack_range(picoquic_cnx_t *cnx)
     uint64_t current_time = (uint64_t) cnx->protoop_inputv[4];
 
     picoquic_packet_t* p = ppacket;
+    picoquic_packet_context_t* pkt_ctx = (p != NULL) ? &p->send_path->pkt_ctx[pc] : NULL;
     int ret = 0;
-    /* Compare the range to the retransmit queue */
-    while (p != NULL && range > 0) {
-        if (p->sequence_number > highest) {
-            p = p->next_packet;
-        } else {
-            if (p->sequence_number == highest) {
-                /* TODO: RTT Estimate */
-                picoquic_packet_t* next = p->next_packet;
-                picoquic_path_t * old_path = p->send_path;
-
-                old_path->delivered += p->length;
-                if (cnx->congestion_alg != NULL) {
-                    picoquic_congestion_algorithm_notify_func(cnx, old_path,
-                        picoquic_congestion_notification_acknowledgement,
-                        0, p->length, 0, current_time);
-                }
-
-                /* If the packet contained an ACK frame, perform the ACK of ACK pruning logic */
-                picoquic_process_possible_ack_of_ack_frame(cnx, p);
-
-                /* If packet is larger than the current MTU, update the MTU */
-                if ((p->length + p->checksum_overhead) > old_path->send_mtu) {
-                    old_path->send_mtu = (uint32_t)(p->length + p->checksum_overhead);
-                    old_path->mtu_probe_sent = 0;
-                }
 
-                /* Any acknowledgement shows progress */
-                p->send_path->pkt_ctx[pc].nb_retransmit = 0;
-                p->send_path->pkt_ctx[pc].latest_progress_time = current_time;
+    if (pkt_ctx != NULL && pkt_ctx->retransmit_index != NULL && range > 0) {
+        uint64_t lowest = highest + 1 - range;
+        uint64_t newest = pkt_ctx->retransmit_newest->sequence_number;
+        uint64_t oldest = pkt_ctx->retransmit_oldest->sequence_number;
+        uint64_t top = (highest < newest) ? highest : newest;
+        uint64_t bottom = (lowest > oldest) ? lowest : oldest;
+        int nb_acked = 0;
+
+        p = NULL;
+        for (uint64_t sequence_number = top + 1; sequence_number > bottom; sequence_number--) {
+            picoquic_packet_t* acked = picoquic_retransmit_index_get(pkt_ctx, sequence_number - 1);
+            if (acked != NULL) {
+                /* The packet following the lowest acknowledged one is the first below the range */
+                p = acked->next_packet;
+                nb_acked++;
+                picoquic_process_acked_packet(cnx, pc, acked, current_time);
+            }
+        }
 
-                if (p->has_handshake_done) {
-                    cnx->handshake_done_acked = 1;
+        if (nb_acked == 0 && lowest > oldest && pkt_ctx->retransmit_newest != NULL) {
+            /* Nothing acknowledged, find the first queued packet below the range */
+            for (uint64_t sequence_number = ((lowest - 1 < newest) ? lowest - 1 : newest) + 1;
+                p == NULL && sequence_number > oldest; sequence_number--) {
+                p = picoquic_retransmit_index_get(pkt_ctx, sequence_number - 1);
+            }
+        }
+    } else {
+        /* Compare the range to the retransmit queue */
+        while (p != NULL && range > 0) {
+            if (p->sequence_number > highest) {
+                p = p->next_packet;
+            } else {
+                if (p->sequence_number == highest) {
+                    picoquic_packet_t* next = p->next_packet;
+                    picoquic_process_acked_packet(cnx, pc, p, current_time);
+                    p = next;
                 }
 
-                picoquic_dequeue_retransmit_packet(cnx, p, 1);
-                p = next;
+                range--;
+                highest--;
             }
-
-            range--;
-            highest--;
         }
     }
 
@@ -2691,6 +2912,8 @@ int picoquic_prepare_ack_frame_maybe_ecn(picoquic_cnx_t* cnx, uint64_t current_t
 
     if (ret == 0) {
         pkt_ctx->ack_needed = 0;
+        pkt_ctx->nb_ack_eliciting_received = 0;
+        pkt_ctx->immediate_ack_requested = 0;
     }
 
     return ret;
@@ -2769,7 +2992,8 @@ protoop_arg_t is_ack_needed(picoquic_cnx_t *cnx)
     picoquic_packet_context_t * pkt_ctx = &path_x->pkt_ctx[pc];
 
     if (pkt_ctx->ack_needed) {
-        if (pkt_ctx->highest_ack_sent + 2 <= pkt_ctx->first_sack_item.end_of_sack_range ||
+        if (pkt_ctx->immediate_ack_requested ||
+            pkt_ctx->nb_ack_eliciting_received > pkt_ctx->ack_eliciting_threshold ||
             pkt_ctx->highest_ack_time + pkt_ctx->ack_delay_local <= current_time) {
             ret = 1;
         }
@@ -4139,6 +4363,7 @@ int picoquic_decode_frames(picoquic_cnx_t* cnx, uint8_t* bytes,
     if (bytes != NULL && ack_needed != 0) {
         cnx->latest_progress_time = current_time;
         pkt_ctx->ack_needed = 1;
+        pkt_ctx->nb_ack_eliciting_received++;
     }
 
     return bytes != NULL ? 0 : PICOQUIC_ERROR_DETECTED;
@@ -4241,6 +4466,72 @@ int picoquic_skip_frame(picoquic_cnx_t *cnx, uint8_t* bytes, size_t bytes_max_si
     return ret;
 }
 
+int picoquic_source_symbol_runs(picoquic_cnx_t* cnx, uint8_t* bytes, size_t bytes_max,
+    picoquic_symbol_run_t* runs, int max_runs)
+{
+    int ret = 0;
+    int nb_runs = 0;
+    size_t byte_index = 0;
+
+    while (ret == 0 && byte_index < bytes_max) {
+        uint8_t first_byte = bytes[byte_index];
+        size_t consumed = 0;
+
+        if (first_byte == picoquic_frame_type_padding) {
+            do {
+                consumed++;
+            } while (byte_index + consumed < bytes_max && bytes[byte_index + consumed] == 0);
+        } else if (first_byte >= picoquic_frame_type_stream_range_min && first_byte <= picoquic_frame_type_stream_range_max) {
+            uint8_t* next_frame = picoquic_skip_stream_frame(bytes + byte_index, bytes + bytes_max);
+            if (next_frame == NULL) {
+                ret = -1;
+            } else {
+                consumed = next_frame - (bytes + byte_index);
+            }
+        } else {
+            int pure_ack = 0;
+            ret = picoquic_skip_frame(cnx, bytes + byte_index, bytes_max - byte_index, &consumed, &pure_ack);
+            if (consumed == 0) {
+                ret = -1;
+            }
+        }
+
+        if (ret == 0 && first_byte != picoquic_frame_type_padding && first_byte != picoquic_frame_type_ack &&
+            first_byte != picoquic_frame_type_crypto_hs) {
+            if (nb_runs > 0 && runs[nb_runs - 1].offset + runs[nb_runs - 1].length == byte_index) {
+                runs[nb_runs - 1].length += (uint16_t)consumed;
+            } else if (nb_runs < max_runs) {
+                runs[nb_runs].offset = (uint16_t)byte_index;
+                runs[nb_runs].length = (uint16_t)consumed;
+                nb_runs++;
+            } else {
+                ret = -1;
+            }
+        }
+        byte_index += consumed;
+    }
+
+    return (ret == 0) ? nb_runs : -1;
+}
+
+size_t picoquic_source_symbol_gather(picoquic_cnx_t* cnx, uint8_t* bytes, size_t bytes_max,
+    uint8_t* symbol, size_t symbol_max)
+{
+    picoquic_symbol_run_t runs[PICOQUIC_SYMBOL_RUNS_MAX];
+    int nb_runs = picoquic_source_symbol_runs(cnx, bytes, bytes_max, runs, PICOQUIC_SYMBOL_RUNS_MAX);
+    size_t length = 0;
+
+    for (int i = 0; i < nb_runs; i++) {
+        if (length + runs[i].length > symbol_max) {
+            return 0;
+        }
+        memcpy(symbol + length, bytes + runs[i].offset, runs[i].length);
+        length += runs[i].length;
+    }
+
+    return length;
+}
+
 int picoquic_decode_closing_frames(picoquic_cnx_t *cnx, uint8_t* bytes, size_t bytes_max, int* closing_received)
 {
     int ret = 0;
@@ -4306,6 +4597,8 @@ void frames_register_noparam_protoops(picoquic_cnx_t *cnx)
     register_param_protoop(cnx, &PROTOOP_PARAM_PARSE_FRAME, picoquic_frame_type_new_token, &parse_new_token_frame);
     register_param_protoop(cnx, &PROTOOP_PARAM_PARSE_FRAME, picoquic_frame_type_ack_ecn, &parse_ack_frame_maybe_ecn);
     register_param_protoop(cnx, &PROTOOP_PARAM_PARSE_FRAME, picoquic_frame_type_handshake_done, &parse_handshake_done_frame);
+    register_param_protoop(cnx, &PROTOOP_PARAM_PARSE_FRAME, picoquic_frame_type_ack_frequency, &parse_ack_frequency_frame);
+    register_param_protoop(cnx, &PROTOOP_PARAM_PARSE_FRAME, picoquic_frame_type_immediate_ack, &parse_immediate_ack_frame);
     register_param_protoop(cnx, &PROTOOP_PARAM_PARSE_FRAME, picoquic_frame_type_plugin_validate, &parse_plugin_validate_frame);
     register_param_protoop(cnx, &PROTOOP_PARAM_PARSE_FRAME, picoquic_frame_type_plugin, &parse_plugin_frame);
 
@@ -4335,6 +4628,8 @@ void frames_register_noparam_protoops(picoquic_cnx_t *cnx)
     register_param_protoop(cnx, &PROTOOP_PARAM_PROCESS_FRAME, picoquic_frame_type_new_token, &process_ignore_frame);
     register_param_protoop(cnx, &PROTOOP_PARAM_PROCESS_FRAME, picoquic_frame_type_ack_ecn, &process_ack_frame_maybe_ecn);
     register_param_protoop(cnx, &PROTOOP_PARAM_PROCESS_FRAME, picoquic_frame_type_handshake_done, &process_handshake_done_frame);
+    register_param_protoop(cnx, &PROTOOP_PARAM_PROCESS_FRAME, picoquic_frame_type_ack_frequency, &process_ack_frequency_frame);
+    register_param_protoop(cnx, &PROTOOP_PARAM_PROCESS_FRAME, picoquic_frame_type_immediate_ack, &process_immediate_ack_frame);
     register_param_protoop(cnx, &PROTOOP_PARAM_PROCESS_FRAME, picoquic_frame_type_plugin_validate, &process_plugin_validate_frame);
     register_param_protoop(cnx, &PROTOOP_PARAM_PROCESS_FRAME, picoquic_frame_type_plugin, &process_plugin_frame);
 
@@ -4354,6 +4649,7 @@ void frames_register_noparam_protoops(picoquic_cnx_t *cnx)
     register_noparam_protoop(cnx, &PROTOOP_NOPARAM_PREPARE_PATH_CHALLENGE_FRAME, &prepare_path_challenge_frame);
     register_noparam_protoop(cnx, &PROTOOP_NOPARAM_PREPARE_CRYPTO_HS_FRAME, &prepare_crypto_hs_frame);
     register_noparam_protoop(cnx, &PROTOOP_NOPARAM_PREPARE_HANDSHAKE_DONE_FRAME, &prepare_handshake_done_frame);
+    register_noparam_protoop(cnx, &PROTOOP_NOPARAM_PREPARE_ACK_FREQUENCY_FRAME, &prepare_ack_frequency_frame);
     register_noparam_protoop(cnx, &PROTOOP_NOPARAM_PREPARE_MISC_FRAME, &prepare_misc_frame);
     register_noparam_protoop(cnx, &PROTOOP_NOPARAM_PREPARE_MAX_DATA_FRAME, &prepare_max_data_frame);
     register_noparam_protoop(cnx, &PROTOOP_NOPARAM_PREPARE_FIRST_MISC_FRAME, &prepare_first_misc_frame);
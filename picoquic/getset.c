@@ -1,5 +1,6 @@
 #include "getset.h"
 #include "picoquic_internal.h"
+#include <stddef.h>
 
 static inline protoop_arg_t get_cnx_transport_parameter(picoquic_tp_t *t, uint16_t value) {
     switch (value) {
@@ -476,6 +477,118 @@ protoop_arg_t get_cnx_metadata(picoquic_cnx_t *cnx, int idx) {
     return out;
 }
 
+#define GETSET_FIELD(type, member, is_writable) { .offset = offsetof(type, member), .size = sizeof(((type *) 0)->member), .writable = is_writable }
+
+/* Keys whose get and set cases are a plain load and store, indexed by key. Keep them in sync with the switches. */
+static const getset_field_t cnx_fields[] = {
+    [AK_CNX_PROPOSED_VERSION] = GETSET_FIELD(picoquic_cnx_t, proposed_version, 1),
+    [AK_CNX_START_TIME] = GETSET_FIELD(picoquic_cnx_t, start_time, 1),
+    [AK_CNX_NEXT_WAKE_TIME] = GETSET_FIELD(picoquic_cnx_t, next_wake_time, 1),
+    [AK_CNX_LATEST_PROGRESS_TIME] = GETSET_FIELD(picoquic_cnx_t, latest_progress_time, 1),
+    [AK_CNX_DATA_SENT] = GETSET_FIELD(picoquic_cnx_t, data_sent, 1),
+    [AK_CNX_DATA_RECEIVED] = GETSET_FIELD(picoquic_cnx_t, data_received, 1),
+    [AK_CNX_MAXDATA_LOCAL] = GETSET_FIELD(picoquic_cnx_t, maxdata_local, 1),
+    [AK_CNX_MAXDATA_REMOTE] = GETSET_FIELD(picoquic_cnx_t, maxdata_remote, 1),
+    [AK_CNX_NB_PATHS] = GETSET_FIELD(picoquic_cnx_t, nb_paths, 1),
+};
+
+static const getset_field_t path_fields[] = {
+    [AK_PATH_CHALLENGE_TIME] = GETSET_FIELD(picoquic_path_t, challenge_time, 1),
+    [AK_PATH_CHALLENGE_REPEAT_COUNT] = GETSET_FIELD(picoquic_path_t, challenge_repeat_count, 1),
+    [AK_PATH_MAX_ACK_DELAY] = GETSET_FIELD(picoquic_path_t, max_ack_delay, 1),
+    [AK_PATH_SMOOTHED_RTT] = GETSET_FIELD(picoquic_path_t, smoothed_rtt, 1),
+    [AK_PATH_RTT_VARIANT] = GETSET_FIELD(picoquic_path_t, rtt_variant, 1),
+    [AK_PATH_RETRANSMIT_TIMER] = GETSET_FIELD(picoquic_path_t, retransmit_timer, 1),
+    [AK_PATH_RTT_MIN] = GETSET_FIELD(picoquic_path_t, rtt_min, 1),
+    [AK_PATH_SEND_MTU] = GETSET_FIELD(picoquic_path_t, send_mtu, 1),
+    [AK_PATH_CWIN] = GETSET_FIELD(picoquic_path_t, cwin, 1),
+    [AK_PATH_BYTES_IN_TRANSIT] = GETSET_FIELD(picoquic_path_t, bytes_in_transit, 1),
+    [AK_PATH_BANDWIDTH_ESTIMATE] = GETSET_FIELD(picoquic_path_t, bandwidth_estimate, 1),
+};
+
+const getset_field_t *getset_cnx_field(access_key_t ak)
+{
+    if (ak >= sizeof(cnx_fields) / sizeof(cnx_fields[0]) || cnx_fields[ak].size == 0) {
+        return NULL;
+    }
+    return &cnx_fields[ak];
+}
+
+const getset_field_t *getset_path_field(access_key_t ak)
+{
+    if (ak >= sizeof(path_fields) / sizeof(path_fields[0]) || path_fields[ak].size == 0) {
+        return NULL;
+    }
+    return &path_fields[ak];
+}
+
+protoop_arg_t getset_load_u32(const void *obj, uint64_t offset)
+{
+    return *(const uint32_t *) ((const uint8_t *) obj + offset);
+}
+
+protoop_arg_t getset_load_u64(const void *obj, uint64_t offset)
+{
+    return *(const uint64_t *) ((const uint8_t *) obj + offset);
+}
+
+void getset_store_u32(void *obj, uint64_t offset, uint16_t param, protoop_arg_t val)
+{
+    *(uint32_t *) ((uint8_t *) obj + offset) = (uint32_t) val;
+}
+
+void getset_store_u64(void *obj, uint64_t offset, uint16_t param, protoop_arg_t val)
+{
+    *(uint64_t *) ((uint8_t *) obj + offset) = (uint64_t) val;
+}
+
+protoop_arg_t getset_get_input(picoquic_cnx_t *cnx, access_key_t ak, uint16_t param)
+{
+    return (param < cnx->protoop_inputc) ? cnx->protoop_inputv[param] : get_cnx(cnx, ak, param);
+}
+
+void get_cnx_fields(picoquic_cnx_t *cnx, const access_key_t *keys, size_t nb_keys, protoop_arg_t *out)
+{
+    for (size_t i = 0; i < nb_keys; i++) {
+        const getset_field_t *field = getset_cnx_field(keys[i]);
+        out[i] = (field != NULL) ? getset_field_load(cnx, field) : get_cnx(cnx, keys[i], 0);
+    }
+}
+
+void set_cnx_fields(picoquic_cnx_t *cnx, const access_key_t *keys, size_t nb_keys, const protoop_arg_t *vals)
+{
+    for (size_t i = 0; i < nb_keys; i++) {
+        const getset_field_t *field = getset_cnx_field(keys[i]);
+        if (field != NULL && field->writable) {
+            getset_field_store(cnx, field, vals[i]);
+        } else {
+            set_cnx(cnx, keys[i], 0, vals[i]);
+        }
+    }
+}
+
+void get_path_fields(picoquic_path_t *path, const access_key_t *keys, size_t nb_keys, protoop_arg_t *out)
+{
+    for (size_t i = 0; i < nb_keys; i++) {
+        const getset_field_t *field = getset_path_field(keys[i]);
+        out[i] = (field != NULL) ? getset_field_load(path, field) : get_path(path, keys[i], 0);
+    }
+}
+
+void set_path_fields(picoquic_path_t *path, const access_key_t *keys, size_t nb_keys, const protoop_arg_t *vals)
+{
+    /* The RTT and the retransmit timer move the loss times */
+    picoquic_disarm_loss_timers(path);
+    for (size_t i = 0; i < nb_keys; i++) {
+        const getset_field_t *field = getset_path_field(keys[i]);
+        if (field != NULL && field->writable) {
+            getset_field_store(path, field, vals[i]);
+        } else {
+            set_path(path, keys[i], 0, vals[i]);
+        }
+    }
+}
+
 protoop_arg_t get_path(picoquic_path_t *path, access_key_t ak, uint16_t param)
 {
     switch(ak) {
@@ -563,6 +676,14 @@ protoop_arg_t get_path(picoquic_path_t *path, access_key_t ak, uint16_t param)
         return path->delivered_limited_index;
     case AK_PATH_RTT_SAMPLE:
         return path->rtt_sample;
+    case AK_PATH_ACK_FREQUENCY_THRESHOLD_SENT:
+        return path->ack_frequency_threshold_sent;
+    case AK_PATH_ACK_FREQUENCY_DELAY_SENT:
+        return path->ack_frequency_delay_sent;
+    case AK_PATH_IMMEDIATE_ACK_TO_SEND:
+        return path->immediate_ack_to_send;
+    case AK_PATH_BANDWIDTH_ESTIMATE:
+        return path->bandwidth_estimate;
     default:
         printf("ERROR: unknown path access key %u\n", ak);
         return 0;
@@ -571,6 +692,7 @@ protoop_arg_t get_path(picoquic_path_t *path, access_key_t ak, uint16_t param)
 
 void set_path(picoquic_path_t *path, access_key_t ak, uint16_t param, protoop_arg_t val)
 {
+    picoquic_disarm_loss_timers(path);
     switch(ak) {
     case AK_PATH_PEER_ADDR:
         printf("ERROR: setting the peer addr is not implemented!\n");
@@ -686,6 +808,18 @@ void set_path(picoquic_path_t *path, access_key_t ak, uint16_t param, protoop_ar
     case AK_PATH_RTT_SAMPLE:
         path->rtt_sample = val;
         break;
+    case AK_PATH_ACK_FREQUENCY_THRESHOLD_SENT:
+        printf("ERROR: setting the ack frequency threshold sent is not implemented!\n");
+        break;
+    case AK_PATH_ACK_FREQUENCY_DELAY_SENT:
+        printf("ERROR: setting the ack frequency delay sent is not implemented!\n");
+        break;
+    case AK_PATH_IMMEDIATE_ACK_TO_SEND:
+        path->immediate_ack_to_send = (val != 0);
+        break;
+    case AK_PATH_BANDWIDTH_ESTIMATE:
+        path->bandwidth_estimate = val;
+        break;
     default:
         printf("ERROR: unknown path access key %u\n", ak);
         break;
@@ -752,6 +886,14 @@ protoop_arg_t get_pkt_ctx(picoquic_packet_context_t *pkt_ctx, access_key_t ak)
         return pkt_ctx->ack_needed;
     case AK_PKTCTX_LATEST_PROGRESS_TIME:
         return pkt_ctx->latest_progress_time;
+    case AK_PKTCTX_ACK_ELICITING_THRESHOLD:
+        return pkt_ctx->ack_eliciting_threshold;
+    case AK_PKTCTX_ACK_FREQUENCY_MAX_DELAY:
+        return pkt_ctx->ack_frequency_max_delay;
+    case AK_PKTCTX_REORDERING_THRESHOLD:
+        return pkt_ctx->reordering_threshold;
+    case AK_PKTCTX_IMMEDIATE_ACK_REQUESTED:
+        return pkt_ctx->immediate_ack_requested;
     default:
         printf("ERROR: unknown pkt ctx access key %u\n", ak);
         return 0;
@@ -760,6 +902,7 @@ protoop_arg_t get_pkt_ctx(picoquic_packet_context_t *pkt_ctx, access_key_t ak)
 
 void set_pkt_ctx(picoquic_packet_context_t *pkt_ctx, access_key_t ak, protoop_arg_t val)
 {
+    pkt_ctx->loss_timer_armed = 0;
     switch(ak) {
     case AK_PKTCTX_SEND_SEQUENCE:
         pkt_ctx->send_sequence = val;
@@ -808,6 +951,18 @@ void set_pkt_ctx(picoquic_packet_context_t *pkt_ctx, access_key_t ak, protoop_ar
     case AK_PKTCTX_ACK_NEEDED:
         pkt_ctx->ack_needed = val;
         break;
+    case AK_PKTCTX_ACK_ELICITING_THRESHOLD:
+        pkt_ctx->ack_eliciting_threshold = val;
+        break;
+    case AK_PKTCTX_ACK_FREQUENCY_MAX_DELAY:
+        pkt_ctx->ack_frequency_max_delay = val;
+        break;
+    case AK_PKTCTX_REORDERING_THRESHOLD:
+        pkt_ctx->reordering_threshold = val;
+        break;
+    case AK_PKTCTX_IMMEDIATE_ACK_REQUESTED:
+        pkt_ctx->immediate_ack_requested = (val != 0);
+        break;
     default:
         printf("ERROR: unknown pkt ctx access key %u\n", ak);
         break;
@@ -950,6 +1105,13 @@ void set_pkt(picoquic_packet_t *pkt, access_key_t ak, protoop_arg_t val)
     }
 }
 
+void get_pkt_fields(picoquic_packet_t *pkt, const access_key_t *keys, size_t nb_keys, protoop_arg_t *out)
+{
+    for (size_t i = 0; i < nb_keys; i++) {
+        out[i] = get_pkt(pkt, keys[i]);
+    }
+}
+
 protoop_arg_t get_sack_item(picoquic_sack_item_t *sack_item, access_key_t ak)
 {
     switch(ak) {
@@ -284,6 +284,150 @@ protoop_arg_t get_preq(plugin_req_pid_t *preq, access_key_t ak);
  */
 void set_preq(plugin_req_pid_t *preq, access_key_t ak, protoop_arg_t val);
 
+/**
+ * Location of a field that is a plain struct member, i.e., whose access through
+ * the get/set functions is a single load or store without side effect.
+ */
+typedef struct getset_field {
+    uint16_t offset;   /** Offset of the field in its structure */
+    uint8_t size;      /** Size of the field, 1, 2, 4 or 8 bytes. Zero if the key is not a plain field */
+    uint8_t writable;  /** Whether the corresponding set function may store into the field */
+} getset_field_t;
+
+/**
+ * Get the location of the connection field with key \p ak
+ *
+ * This allows a pluglet loader to resolve a \p get_cnx or \p set_cnx call with
+ * a constant key once, at load time, into a direct access to the field.
+ *
+ * \param ak The key of the field
+ *
+ * \return The location of the field, or NULL if the key requires the \p get_cnx and \p set_cnx functions
+ */
+const getset_field_t *getset_cnx_field(access_key_t ak);
+
+/**
+ * Get the location of the path field with key \p ak
+ *
+ * \param ak The key of the field
+ *
+ * \return The location of the field, or NULL if the key requires the \p get_path and \p set_path functions
+ */
+const getset_field_t *getset_path_field(access_key_t ak);
+
+/**
+ * Accesses to the field at \p offset in \p obj, of 4 or 8 bytes
+ *
+ * A pluglet loader rewrites a \p get_cnx, \p set_cnx or \p get_path call with a
+ * constant key on such a field into a call to one of these functions, with the
+ * key replaced by the offset of the field. The call then behaves as the original
+ * one, without going through the switch on the key. The \p param of the original
+ * call is left in place and ignored, as by the plain fields.
+ */
+protoop_arg_t getset_load_u32(const void *obj, uint64_t offset);
+protoop_arg_t getset_load_u64(const void *obj, uint64_t offset);
+void getset_store_u32(void *obj, uint64_t offset, uint16_t param, protoop_arg_t val);
+void getset_store_u64(void *obj, uint64_t offset, uint16_t param, protoop_arg_t val);
+
+/**
+ * Behaves as get_cnx(cnx, AK_CNX_INPUT, param), which a pluglet loader rewrites into this
+ * call, without going through the switch on the key
+ */
+protoop_arg_t getset_get_input(picoquic_cnx_t *cnx, access_key_t ak, uint16_t param);
+
+/**
+ * Get several fields of the connection context \p cnx in a single call
+ *
+ * \param cnx The connection context
+ * \param keys The keys of the fields to get, accessed with a zero \p param
+ * \param nb_keys The number of keys
+ * \param out The values of the fields, in the order of \p keys
+ */
+void get_cnx_fields(picoquic_cnx_t *cnx, const access_key_t *keys, size_t nb_keys, protoop_arg_t *out);
+
+/**
+ * Set several fields of the connection context \p cnx in a single call
+ *
+ * \param cnx The connection context
+ * \param keys The keys of the fields to set, accessed with a zero \p param
+ * \param nb_keys The number of keys
+ * \param vals The values to set, in the order of \p keys
+ */
+void set_cnx_fields(picoquic_cnx_t *cnx, const access_key_t *keys, size_t nb_keys, const protoop_arg_t *vals);
+
+/**
+ * Get several fields of the path \p path in a single call
+ *
+ * \param path The path structure pointer
+ * \param keys The keys of the fields to get, accessed with a zero \p param
+ * \param nb_keys The number of keys
+ * \param out The values of the fields, in the order of \p keys
+ */
+void get_path_fields(picoquic_path_t *path, const access_key_t *keys, size_t nb_keys, protoop_arg_t *out);
+
+/**
+ * Set several fields of the path \p path in a single call
+ *
+ * \param path The path structure pointer
+ * \param keys The keys of the fields to set, accessed with a zero \p param
+ * \param nb_keys The number of keys
+ * \param vals The values to set, in the order of \p keys
+ */
+void set_path_fields(picoquic_path_t *path, const access_key_t *keys, size_t nb_keys, const protoop_arg_t *vals);
+
+/**
+ * Get several fields of the packet \p pkt in a single call
+ *
+ * \param pkt The packet pointer
+ * \param keys The keys of the fields to get
+ * \param nb_keys The number of keys
+ * \param out The values of the fields, in the order of \p keys
+ */
+void get_pkt_fields(picoquic_packet_t *pkt, const access_key_t *keys, size_t nb_keys, protoop_arg_t *out);
+
+/**
+ * Load the field located by \p field in the structure \p obj.
+ * Behaves as the get function of the corresponding key.
+ */
+static inline protoop_arg_t getset_field_load(const void *obj, const getset_field_t *field)
+{
+    const uint8_t *p = (const uint8_t *) obj + field->offset;
+    switch (field->size) {
+    case 1:
+        return *(const uint8_t *) p;
+    case 2:
+        return *(const uint16_t *) p;
+    case 4:
+        return *(const uint32_t *) p;
+    default:
+        return *(const uint64_t *) p;
+    }
+}
+
+/**
+ * Store \p val into the field located by \p field in the structure \p obj.
+ * Only stores the value: unlike set_path, it does not disarm the loss timers of a path.
+ * The caller checks that the field is writable.
+ */
+static inline void getset_field_store(void *obj, const getset_field_t *field, protoop_arg_t val)
+{
+    uint8_t *p = (uint8_t *) obj + field->offset;
+    switch (field->size) {
+    case 1:
+        *(uint8_t *) p = (uint8_t) val;
+        break;
+    case 2:
+        *(uint16_t *) p = (uint16_t) val;
+        break;
+    case 4:
+        *(uint32_t *) p = (uint32_t) val;
+        break;
+    default:
+        *(uint64_t *) p = (uint64_t) val;
+        break;
+    }
+}
+
 
 /**
  * @}
@@ -528,6 +672,14 @@ void set_preq(plugin_req_pid_t *preq, access_key_t ak, protoop_arg_t val);
 #define AK_PATH_PACING_PACKET_TIME_MICROSEC 0x25
 #define AK_PATH_RTT_SAMPLE 0x26
 #define AK_PATH_DELIVERED_PRIOR 0x27
+/** The ack-eliciting threshold last sent in an ACK_FREQUENCY frame, 0 if none was sent */
+#define AK_PATH_ACK_FREQUENCY_THRESHOLD_SENT 0x28
+/** The maximum ack delay last sent in an ACK_FREQUENCY frame, in microseconds */
+#define AK_PATH_ACK_FREQUENCY_DELAY_SENT 0x29
+/** Indicate if an IMMEDIATE_ACK frame should be sent on the path */
+#define AK_PATH_IMMEDIATE_ACK_TO_SEND 0x2a
+/** The delivery rate estimated from the acknowledgements, in bytes per second, 0 if not measured yet */
+#define AK_PATH_BANDWIDTH_ESTIMATE 0x2b
 /**
  * @}
  * 
@@ -572,6 +724,14 @@ void set_preq(plugin_req_pid_t *preq, access_key_t ak, protoop_arg_t val);
 #define AK_PKTCTX_LATEST_RETRANSMIT_CC_NOTIFICATION_TIME 0x0f
 /** The latest time at which progress was observed (e.g. an ack was received) */
 #define AK_PKTCTX_LATEST_PROGRESS_TIME 0x10
+/** The number of ack-eliciting packets that can be received before sending an ack, as asked by the peer */
+#define AK_PKTCTX_ACK_ELICITING_THRESHOLD 0x11
+/** The maximum ack delay asked by the peer, 0 if it did not send any ACK_FREQUENCY frame */
+#define AK_PKTCTX_ACK_FREQUENCY_MAX_DELAY 0x12
+/** The reordering threshold asked by the peer */
+#define AK_PKTCTX_REORDERING_THRESHOLD 0x13
+/** Indicate if the peer asked for an immediate ack */
+#define AK_PKTCTX_IMMEDIATE_ACK_REQUESTED 0x14
 
 /**
  * @}
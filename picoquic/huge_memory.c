@@ -0,0 +1,155 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "picoquic.h"
+#include "huge_memory.h"
+
+#define HUGE_ROUND_UP(l) (((l) + PICOQUIC_HUGE_PAGE_SIZE - 1) & ~((size_t) PICOQUIC_HUGE_PAGE_SIZE - 1))
+#define HUGE_PACKET_SLOT_SIZE ((sizeof(picoquic_packet_t) + 63) & ~((size_t) 63))
+
+/* Placed at the start of each mapping, the object follows on the next cache line */
+typedef struct st_huge_region_header_t {
+    struct st_huge_region_header_t* next_chunk;
+    size_t length;
+    int is_hugetlb;
+} huge_region_header_t;
+
+#define HUGE_HEADER_SIZE ((sizeof(huge_region_header_t) + 63) & ~((size_t) 63))
+
+struct st_picoquic_huge_memory_t {
+    picoquic_huge_memory_stats_t stats;
+    huge_region_header_t* packet_chunks;
+    picoquic_packet_t* free_packets; /* Linked with next_packet */
+};
+
+static huge_region_header_t* huge_map(picoquic_huge_memory_t* hm, size_t size)
+{
+    size_t length = HUGE_ROUND_UP(size + HUGE_HEADER_SIZE);
+    uint8_t* mem = MAP_FAILED;
+    int is_hugetlb = 0;
+
+#ifdef MAP_HUGETLB
+    mem = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (mem != MAP_FAILED) {
+        is_hugetlb = 1;
+    } else {
+        hm->stats.nb_hugetlb_failures++;
+    }
+#endif
+    if (mem == MAP_FAILED) {
+        /* Over-allocate to align the area, so that every 2MB of it can be a transparent huge page */
+        uint8_t* area = mmap(NULL, length + PICOQUIC_HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (area == MAP_FAILED) {
+            return NULL;
+        }
+        mem = (uint8_t*)HUGE_ROUND_UP((uintptr_t)area);
+        if (mem > area) {
+            munmap(area, mem - area);
+        }
+        if (area + PICOQUIC_HUGE_PAGE_SIZE > mem) {
+            munmap(mem + length, area + PICOQUIC_HUGE_PAGE_SIZE - mem);
+        }
+#ifdef MADV_HUGEPAGE
+        (void)madvise(mem, length, MADV_HUGEPAGE);
+#endif
+    }
+
+    huge_region_header_t* header = (huge_region_header_t*)mem;
+    header->next_chunk = NULL;
+    header->length = length;
+    header->is_hugetlb = is_hugetlb;
+
+    hm->stats.nb_regions++;
+    hm->stats.bytes_mapped += length;
+    if (is_hugetlb) {
+        hm->stats.bytes_hugetlb += length;
+    } else {
+        hm->stats.bytes_thp += length;
+    }
+
+    return header;
+}
+
+static void huge_unmap(picoquic_huge_memory_t* hm, huge_region_header_t* header)
+{
+    hm->stats.nb_regions--;
+    hm->stats.bytes_mapped -= header->length;
+    if (header->is_hugetlb) {
+        hm->stats.bytes_hugetlb -= header->length;
+    } else {
+        hm->stats.bytes_thp -= header->length;
+    }
+    munmap(header, header->length);
+}
+
+picoquic_huge_memory_t* picoquic_huge_memory_create()
+{
+    return (picoquic_huge_memory_t*)calloc(1, sizeof(picoquic_huge_memory_t));
+}
+
+void picoquic_huge_memory_free(picoquic_huge_memory_t* hm)
+{
+    if (hm != NULL) {
+        while (hm->packet_chunks != NULL) {
+            huge_region_header_t* chunk = hm->packet_chunks;
+            hm->packet_chunks = chunk->next_chunk;
+            huge_unmap(hm, chunk);
+        }
+        free(hm);
+    }
+}
+
+void* picoquic_huge_alloc(picoquic_huge_memory_t* hm, size_t size)
+{
+    huge_region_header_t* header = huge_map(hm, size);
+
+    return (header == NULL) ? NULL : (uint8_t*)header + HUGE_HEADER_SIZE;
+}
+
+void picoquic_huge_release(picoquic_huge_memory_t* hm, void* ptr)
+{
+    if (ptr != NULL) {
+        huge_unmap(hm, (huge_region_header_t*)((uint8_t*)ptr - HUGE_HEADER_SIZE));
+    }
+}
+
+picoquic_packet_t* picoquic_huge_packet_alloc(picoquic_huge_memory_t* hm)
+{
+    if (hm->free_packets == NULL) {
+        /* Carve a new chunk. Linking the slots touches all its pages from the calling thread. */
+        huge_region_header_t* chunk = huge_map(hm, PICOQUIC_HUGE_PAGE_SIZE - HUGE_HEADER_SIZE);
+        if (chunk == NULL) {
+            return NULL;
+        }
+        chunk->next_chunk = hm->packet_chunks;
+        hm->packet_chunks = chunk;
+        hm->stats.nb_packet_chunks++;
+
+        for (size_t offset = HUGE_HEADER_SIZE; offset + HUGE_PACKET_SLOT_SIZE <= chunk->length; offset += HUGE_PACKET_SLOT_SIZE) {
+            picoquic_packet_t* packet = (picoquic_packet_t*)((uint8_t*)chunk + offset);
+            packet->next_packet = hm->free_packets;
+            hm->free_packets = packet;
+            hm->stats.packets_free++;
+        }
+    }
+
+    picoquic_packet_t* packet = hm->free_packets;
+    hm->free_packets = packet->next_packet;
+    hm->stats.packets_free--;
+    hm->stats.packets_in_use++;
+
+    return packet;
+}
+
+void picoquic_huge_packet_release(picoquic_huge_memory_t* hm, picoquic_packet_t* packet)
+{
+    packet->next_packet = hm->free_packets;
+    hm->free_packets = packet;
+    hm->stats.packets_free++;
+    hm->stats.packets_in_use--;
+}
+
+const picoquic_huge_memory_stats_t* picoquic_huge_memory_stats(picoquic_huge_memory_t* hm)
+{
+    return &hm->stats;
+}
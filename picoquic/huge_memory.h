@@ -0,0 +1,63 @@
+/**
+ * \file huge_memory.h
+ * \brief Huge page backing for the plugin memories and the packets.
+ *
+ * Each plugin holds a PLUGIN_MEMORY region and every sent packet is a
+ * separate allocation, so a server with many connections touches a large
+ * number of small pages. When enabled on the QUIC context, the plugins are
+ * allocated in their own mapping of 2MB pages and the packets are carved
+ * from 2MB chunks kept in a free list.
+ *
+ * A mapping first asks for reserved huge pages (MAP_HUGETLB). When none are
+ * left, it falls back to an area aligned on the huge page size and advised
+ * for transparent huge pages, which the kernel backs when it can. The pages
+ * are placed by the first touch policy: the plugins and the packet chunks
+ * are initialized by the thread running the QUIC context, so they live on
+ * its NUMA node.
+ */
+
+#ifndef PICOQUIC_HUGE_MEMORY_H
+#define PICOQUIC_HUGE_MEMORY_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PICOQUIC_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+typedef struct st_picoquic_huge_memory_stats_t {
+    uint64_t nb_regions;          /* Live mappings, including the packet chunks */
+    uint64_t bytes_mapped;        /* Size of the live mappings */
+    uint64_t bytes_hugetlb;       /* Part of bytes_mapped backed by reserved huge pages */
+    uint64_t bytes_thp;           /* Part of bytes_mapped advised for transparent huge pages */
+    uint64_t nb_hugetlb_failures; /* Mappings for which no reserved huge page was available */
+    uint64_t nb_packet_chunks;
+    uint64_t packets_in_use;
+    uint64_t packets_free;
+} picoquic_huge_memory_stats_t;
+
+typedef struct st_picoquic_huge_memory_t picoquic_huge_memory_t;
+struct st_picoquic_packet_t;
+
+picoquic_huge_memory_t* picoquic_huge_memory_create();
+/* Unmaps the packet chunks. All the regions and the packets must have been released. */
+void picoquic_huge_memory_free(picoquic_huge_memory_t* hm);
+
+/* Returns a zeroed region of at least size bytes, or NULL */
+void* picoquic_huge_alloc(picoquic_huge_memory_t* hm, size_t size);
+void picoquic_huge_release(picoquic_huge_memory_t* hm, void* ptr);
+
+/* Returns an uninitialized packet, or NULL */
+struct st_picoquic_packet_t* picoquic_huge_packet_alloc(picoquic_huge_memory_t* hm);
+void picoquic_huge_packet_release(picoquic_huge_memory_t* hm, struct st_picoquic_packet_t* packet);
+
+const picoquic_huge_memory_stats_t* picoquic_huge_memory_stats(picoquic_huge_memory_t* hm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PICOQUIC_HUGE_MEMORY_H */
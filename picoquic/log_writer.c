@@ -0,0 +1,192 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* fopencookie */
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include "spsc_ring.h"
+#include "log_writer.h"
+
+struct st_picoquic_log_writer_t {
+    spsc_ring_t* ring;
+    FILE* F_sink;
+    FILE* F; /* Producer side */
+    picoquic_log_overload_enum overload;
+    uint32_t sample_rate;
+    uint32_t sample_count;
+    pthread_t thread;
+    int stopping;
+
+    picoquic_log_writer_stats_t stats;
+
+    uint8_t batch[PICOQUIC_LOG_WRITER_BATCH_MAX]; /* Writer thread */
+};
+
+#define LOG_WRITER_COUNT(writer, counter, n) __atomic_add_fetch(&(writer)->stats.counter, (n), __ATOMIC_RELAXED)
+
+static void log_writer_push(picoquic_log_writer_t* writer, const uint8_t* data, uint32_t length)
+{
+    LOG_WRITER_COUNT(writer, nb_records, 1);
+
+    if (writer->overload == picoquic_log_overload_sample) {
+        if (spsc_ring_get_used(writer->ring) > PICOQUIC_LOG_WRITER_RING_SIZE / 2) {
+            if (writer->sample_count++ % writer->sample_rate != 0) {
+                LOG_WRITER_COUNT(writer, nb_sampled_out, 1);
+                return;
+            }
+        } else {
+            writer->sample_count = 0;
+        }
+    }
+
+    if (spsc_ring_push(writer->ring, data, length) != 0) {
+        if (writer->overload == picoquic_log_overload_block) {
+            LOG_WRITER_COUNT(writer, nb_blocked, 1);
+            do {
+                usleep(PICOQUIC_LOG_WRITER_BLOCK_DELAY);
+            } while (spsc_ring_push(writer->ring, data, length) != 0);
+        } else {
+            LOG_WRITER_COUNT(writer, nb_dropped, 1);
+        }
+    }
+}
+
+/* Called by stdio each time a line is complete or the buffer is full */
+static ssize_t log_writer_cookie_write(void* cookie, const char* buf, size_t size)
+{
+    picoquic_log_writer_t* writer = (picoquic_log_writer_t*)cookie;
+    size_t offset = 0;
+
+    while (offset < size) {
+        size_t length = size - offset;
+        if (length > PICOQUIC_LOG_WRITER_RECORD_MAX) {
+            length = PICOQUIC_LOG_WRITER_RECORD_MAX;
+        }
+        log_writer_push(writer, (const uint8_t*)buf + offset, (uint32_t)length);
+        offset += length;
+    }
+
+    /* Lost records are counted, they are not reported as errors to stdio */
+    return (ssize_t)size;
+}
+
+static void log_writer_write_batch(picoquic_log_writer_t* writer, size_t length)
+{
+    if (length > 0) {
+        (void)fwrite(writer->batch, 1, length, writer->F_sink);
+        LOG_WRITER_COUNT(writer, nb_batches, 1);
+        LOG_WRITER_COUNT(writer, bytes_written, length);
+    }
+}
+
+/* Moves all the queued records to the sink. Returns the number of records. */
+static int log_writer_drain(picoquic_log_writer_t* writer)
+{
+    int nb_records = 0;
+    size_t length = 0;
+    uint32_t next_length;
+
+    while ((next_length = spsc_ring_peek_length(writer->ring)) > 0) {
+        if (length + next_length > sizeof(writer->batch)) {
+            log_writer_write_batch(writer, length);
+            length = 0;
+        }
+        length += spsc_ring_pop(writer->ring, writer->batch + length, (uint32_t)(sizeof(writer->batch) - length));
+        nb_records++;
+    }
+    log_writer_write_batch(writer, length);
+    if (nb_records > 0) {
+        fflush(writer->F_sink);
+    }
+
+    return nb_records;
+}
+
+static void* log_writer_thread(void* arg)
+{
+    picoquic_log_writer_t* writer = (picoquic_log_writer_t*)arg;
+    int fd = spsc_ring_get_eventfd(writer->ring);
+
+    for (;;) {
+        /* Read before draining, so that the records queued before the stop are written */
+        int stopping = __atomic_load_n(&writer->stopping, __ATOMIC_ACQUIRE);
+
+        spsc_ring_clear_event(writer->ring);
+        if (log_writer_drain(writer) == 0) {
+            if (stopping) {
+                break;
+            } else if (fd != -1) {
+                struct pollfd pfd;
+                pfd.fd = fd;
+                pfd.events = POLLIN;
+                pfd.revents = 0;
+                (void)poll(&pfd, 1, PICOQUIC_LOG_WRITER_POLL_DELAY);
+            } else {
+                usleep(PICOQUIC_LOG_WRITER_POLL_DELAY * 1000);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+picoquic_log_writer_t* picoquic_log_writer_create(FILE* F_sink, picoquic_log_overload_enum overload, uint32_t sample_rate)
+{
+    cookie_io_functions_t io_functions = { NULL, log_writer_cookie_write, NULL, NULL };
+    picoquic_log_writer_t* writer = (picoquic_log_writer_t*)calloc(1, sizeof(picoquic_log_writer_t));
+
+    if (writer == NULL || F_sink == NULL) {
+        free(writer);
+        return NULL;
+    }
+
+    writer->F_sink = F_sink;
+    writer->overload = overload;
+    writer->sample_rate = (sample_rate == 0) ? 1 : sample_rate;
+    writer->ring = spsc_ring_create(PICOQUIC_LOG_WRITER_RING_SIZE);
+    if (writer->ring != NULL) {
+        writer->F = fopencookie(writer, "w", io_functions);
+    }
+    if (writer->F == NULL || setvbuf(writer->F, NULL, _IOLBF, PICOQUIC_LOG_WRITER_RECORD_MAX) != 0 ||
+        pthread_create(&writer->thread, NULL, log_writer_thread, writer) != 0) {
+        if (writer->F != NULL) {
+            fclose(writer->F);
+        }
+        spsc_ring_free(writer->ring);
+        free(writer);
+        writer = NULL;
+    }
+
+    return writer;
+}
+
+void picoquic_log_writer_free(picoquic_log_writer_t* writer)
+{
+    if (writer != NULL) {
+        /* Closing the producer side pushes the last line */
+        fclose(writer->F);
+        __atomic_store_n(&writer->stopping, 1, __ATOMIC_RELEASE);
+        pthread_join(writer->thread, NULL);
+        spsc_ring_free(writer->ring);
+        free(writer);
+    }
+}
+
+FILE* picoquic_log_writer_get_file(picoquic_log_writer_t* writer)
+{
+    return writer->F;
+}
+
+void picoquic_log_writer_get_stats(picoquic_log_writer_t* writer, picoquic_log_writer_stats_t* stats)
+{
+    stats->nb_records = __atomic_load_n(&writer->stats.nb_records, __ATOMIC_RELAXED);
+    stats->nb_dropped = __atomic_load_n(&writer->stats.nb_dropped, __ATOMIC_RELAXED);
+    stats->nb_sampled_out = __atomic_load_n(&writer->stats.nb_sampled_out, __ATOMIC_RELAXED);
+    stats->nb_blocked = __atomic_load_n(&writer->stats.nb_blocked, __ATOMIC_RELAXED);
+    stats->nb_batches = __atomic_load_n(&writer->stats.nb_batches, __ATOMIC_RELAXED);
+    stats->bytes_written = __atomic_load_n(&writer->stats.bytes_written, __ATOMIC_RELAXED);
+}
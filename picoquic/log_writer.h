@@ -0,0 +1,85 @@
+/**
+ * \file log_writer.h
+ * \brief Background thread writing a log file out of the network loop.
+ *
+ * The text log and the binary trace write to a FILE with stdio, from the
+ * thread that processes the packets, so a slow disk stalls the network loop.
+ * A log writer instead provides a FILE whose writes are copied in a lock-free
+ * ring, and a dedicated thread drains the ring and writes the records to the
+ * sink in batches.
+ *
+ * The producer FILE is line buffered: each record is a line of the text log,
+ * or a buffer of PICOQUIC_LOG_WRITER_RECORD_MAX bytes of the binary trace.
+ * When the sink does not keep up and the ring fills up, the overload policy
+ * decides what happens to the new records:
+ *  - block: the producer waits until the writer thread makes room,
+ *  - drop: the records that do not fit in the ring are dropped,
+ *  - sample: once the ring is half full, only one record out of sample_rate
+ *    is kept, and the records that still do not fit are dropped.
+ *
+ * Only a single thread may write to the producer FILE.
+ */
+
+#ifndef PICOQUIC_LOG_WRITER_H
+#define PICOQUIC_LOG_WRITER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PICOQUIC_LOG_WRITER_RING_SIZE (1 << 22)
+#define PICOQUIC_LOG_WRITER_RECORD_MAX 4096
+#define PICOQUIC_LOG_WRITER_BATCH_MAX (1 << 16) /* Bytes written to the sink in a single call */
+#define PICOQUIC_LOG_WRITER_POLL_DELAY 10 /* Max time the writer thread sleeps, in milliseconds */
+#define PICOQUIC_LOG_WRITER_BLOCK_DELAY 100 /* Time a blocked producer waits before retrying, in microseconds */
+
+typedef enum {
+    picoquic_log_overload_block = 0,
+    picoquic_log_overload_drop,
+    picoquic_log_overload_sample
+} picoquic_log_overload_enum;
+
+typedef struct st_picoquic_log_writer_stats_t {
+    uint64_t nb_records;     /* Records written by the producer, including the lost ones */
+    uint64_t nb_dropped;     /* Records that did not fit in the ring */
+    uint64_t nb_sampled_out; /* Records skipped by the sample policy */
+    uint64_t nb_blocked;     /* Records for which the producer had to wait */
+    uint64_t nb_batches;     /* Writes to the sink */
+    uint64_t bytes_written;
+} picoquic_log_writer_stats_t;
+
+typedef struct st_picoquic_log_writer_t picoquic_log_writer_t;
+
+/**
+ * Starts a writer thread appending to \p F_sink, which stays owned by the
+ * caller. The sample rate is only used by the sample policy, 0 is read as 1.
+ *
+ * \return The writer, or NULL if the ring or the thread could not be created
+ */
+picoquic_log_writer_t* picoquic_log_writer_create(FILE* F_sink, picoquic_log_overload_enum overload, uint32_t sample_rate);
+
+/**
+ * Closes the producer FILE, waits until the thread has written all the
+ * queued records and flushed the sink, and frees the writer.
+ */
+void picoquic_log_writer_free(picoquic_log_writer_t* writer);
+
+/**
+ * Returns the FILE to write the logs to. It is closed by picoquic_log_writer_free.
+ */
+FILE* picoquic_log_writer_get_file(picoquic_log_writer_t* writer);
+
+/**
+ * Copies the counters of the writer. They can be read from any thread.
+ */
+void picoquic_log_writer_get_stats(picoquic_log_writer_t* writer, picoquic_log_writer_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PICOQUIC_LOG_WRITER_H */
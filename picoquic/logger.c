@@ -317,6 +317,12 @@ char const* picoquic_log_frame_names(uint64_t frame_type)
     case picoquic_frame_type_plugin_validate:
         frame_name = "plugin_validate";
         break;
+    case picoquic_frame_type_immediate_ack:
+        frame_name = "immediate_ack";
+        break;
+    case picoquic_frame_type_ack_frequency:
+        frame_name = "ack_frequency";
+        break;
     default:
         if (PICOQUIC_IN_RANGE(frame_type, picoquic_frame_type_stream_range_min, picoquic_frame_type_stream_range_max)) {
             frame_name = "stream";
@@ -1326,6 +1332,31 @@ size_t picoquic_log_datagram_frame(FILE* F, uint64_t cnx_id64, uint8_t* bytes, s
     return byte_index;
 }
 
+size_t picoquic_log_ack_frequency_frame(FILE* F, uint8_t* bytes, size_t bytes_max)
+{
+    size_t byte_index = picoquic_varint_skip(bytes);
+    uint64_t sequence_number = 0;
+    uint64_t threshold = 0;
+    uint64_t max_ack_delay = 0;
+    uint64_t reordering_threshold = 0;
+    size_t l_seq = picoquic_varint_decode(bytes + byte_index, bytes_max - byte_index, &sequence_number);
+    byte_index += l_seq;
+    size_t l_thr = (l_seq == 0) ? 0 : picoquic_varint_decode(bytes + byte_index, bytes_max - byte_index, &threshold);
+    byte_index += l_thr;
+    size_t l_del = (l_thr == 0) ? 0 : picoquic_varint_decode(bytes + byte_index, bytes_max - byte_index, &max_ack_delay);
+    byte_index += l_del;
+    size_t l_reo = (l_del == 0) ? 0 : picoquic_varint_decode(bytes + byte_index, bytes_max - byte_index, &reordering_threshold);
+    byte_index += l_reo;
+
+    if (l_reo == 0) {
+        fprintf(F, "    Malformed ACK_FREQUENCY\n");
+        return bytes_max;
+    }
+    fprintf(F, "    ACK_FREQUENCY (seq=%" PRIu64 ", threshold=%" PRIu64 ", max_ack_delay=%" PRIu64 ", reordering=%" PRIu64 ")\n",
+        sequence_number, threshold, max_ack_delay, reordering_threshold);
+    return byte_index;
+}
+
 size_t picoquic_log_sfpid_frame(FILE* F, uint64_t cnx_id64, uint8_t* bytes, size_t bytes_max) {
     fprintf(F, " \tSFPID FRAME: ID %u\n", be32toh(*((uint32_t *) (bytes+1))));
     return 5;
@@ -1433,6 +1464,10 @@ void picoquic_log_frames(FILE* F, uint64_t cnx_id64, uint8_t* bytes, size_t leng
             fprintf(F, "    HANDSHAKE_DONE\n");
             byte_index += 1;
             break;
+        case picoquic_frame_type_immediate_ack:
+            fprintf(F, "    IMMEDIATE_ACK\n");
+            byte_index += 1;
+            break;
         case 0x2c: /* DATAGRAM */
         case 0x2d:
         case 0x2e:
@@ -1466,10 +1501,13 @@ void picoquic_log_frames(FILE* F, uint64_t cnx_id64, uint8_t* bytes, size_t leng
         default: {
             /* Not implemented yet! */
             uint64_t frame_id64;
-            if (picoquic_varint_decode(bytes + byte_index, length - byte_index, &frame_id64) > 0) {
-                fprintf(F, "    Unknown frame, type: %" PRIu64 "\n", frame_id64);
-            } else {
+            if (picoquic_varint_decode(bytes + byte_index, length - byte_index, &frame_id64) == 0) {
                 fprintf(F, "    Truncated frame type\n");
+            } else if (frame_id64 == picoquic_frame_type_ack_frequency) {
+                byte_index += picoquic_log_ack_frequency_frame(F, bytes + byte_index, length - byte_index);
+                break;
+            } else {
+                fprintf(F, "    Unknown frame, type: %" PRIu64 "\n", frame_id64);
             }
             byte_index = length;
             break;
@@ -1478,15 +1516,10 @@ void picoquic_log_frames(FILE* F, uint64_t cnx_id64, uint8_t* bytes, size_t leng
     }
 }
 
-void picoquic_log_decrypted_segment(void* F_log, int log_cnxid, picoquic_cnx_t* cnx,
-    int receiving, picoquic_packet_header * ph, uint8_t* bytes, size_t length, int ret)
+/* Computes the connection ID prefix of the segment lines, zero when not logged */
+uint64_t picoquic_log_segment_cnxid64(int log_cnxid, picoquic_cnx_t* cnx, picoquic_packet_header* ph, int ret)
 {
     uint64_t log_cnxid64 = 0;
-    FILE * F = (FILE *)F_log;
-
-    if (F == NULL) {
-        return;
-    }
 
     if (log_cnxid != 0) {
         if (cnx == NULL) {
@@ -1504,6 +1537,13 @@ void picoquic_log_decrypted_segment(void* F_log, int log_cnxid, picoquic_cnx_t*
             log_cnxid64 = picoquic_val64_connection_id(picoquic_get_logging_cnxid(cnx));
         }
     }
+
+    return log_cnxid64;
+}
+
+void picoquic_log_segment(FILE* F, uint64_t log_cnxid64, int receiving, picoquic_packet_header* ph,
+    uint8_t* bytes, size_t length, int ret)
+{
     /* Header */
     picoquic_log_packet_header(F, log_cnxid64, ph, receiving);
 
@@ -1540,40 +1580,63 @@ void picoquic_log_decrypted_segment(void* F_log, int log_cnxid, picoquic_cnx_t*
     fprintf(F, "\n");
 }
 
-void picoquic_log_outgoing_segment(void* F_log, int log_cnxid, picoquic_cnx_t* cnx,
-    uint8_t * bytes,
-    uint64_t sequence_number,
-    uint32_t length,
-    uint8_t* send_buffer, uint32_t send_length)
+void picoquic_log_decrypted_segment(void* F_log, int log_cnxid, picoquic_cnx_t* cnx,
+    int receiving, picoquic_packet_header * ph, uint8_t* bytes, size_t length, int ret)
+{
+    FILE * F = (FILE *)F_log;
+
+    if (F == NULL) {
+        return;
+    }
+
+    picoquic_log_segment(F, picoquic_log_segment_cnxid64(log_cnxid, cnx, ph, ret), receiving, ph, bytes, length, ret);
+}
+
+/* Parses the header of a packet that was just encrypted, as it will be logged */
+int picoquic_log_outgoing_header(picoquic_cnx_t* cnx, uint64_t sequence_number,
+    uint8_t* send_buffer, uint32_t send_length, picoquic_packet_header* ph)
 {
     picoquic_cnx_t* pcnx = cnx;
-    picoquic_packet_header ph;
     uint32_t checksum_length = (cnx != NULL)? picoquic_get_checksum_length(cnx, 0):16;
     struct sockaddr_in default_addr;
     int ret;
 
-    if (F_log == NULL) {
-        return;
-    }
-
     memset(&default_addr, 0, sizeof(struct sockaddr_in));
     default_addr.sin_family = AF_INET;
 
     ret = picoquic_parse_packet_header((cnx == NULL) ? NULL : cnx->quic, send_buffer, send_length,
         ((cnx==NULL || cnx->path[0] == NULL)?(struct sockaddr *)&default_addr:
-        (struct sockaddr *)&cnx->path[0]->local_addr), &ph, &pcnx, 0);
+        (struct sockaddr *)&cnx->path[0]->local_addr), ph, &pcnx, 0);
 
-    ph.pn64 = sequence_number;
-    ph.pn = (uint32_t)ph.pn64;
-    ph.offset = ph.pn_offset + 4; /* todo: should provide the actual length */
-    ph.payload_length -= 4;
-    if (ph.payload_length > checksum_length) {
-        ph.payload_length -= (uint16_t)checksum_length;
+    ph->pn64 = sequence_number;
+    ph->pn = (uint32_t)ph->pn64;
+    ph->offset = ph->pn_offset + 4; /* todo: should provide the actual length */
+    ph->payload_length -= 4;
+    if (ph->payload_length > checksum_length) {
+        ph->payload_length -= (uint16_t)checksum_length;
     }
     else {
-        ph.payload_length = 0;
+        ph->payload_length = 0;
     }
 
+    return ret;
+}
+
+void picoquic_log_outgoing_segment(void* F_log, int log_cnxid, picoquic_cnx_t* cnx,
+    uint8_t * bytes,
+    uint64_t sequence_number,
+    uint32_t length,
+    uint8_t* send_buffer, uint32_t send_length)
+{
+    picoquic_packet_header ph;
+    int ret;
+
+    if (F_log == NULL) {
+        return;
+    }
+
+    ret = picoquic_log_outgoing_header(cnx, sequence_number, send_buffer, send_length, &ph);
+
     /* log the segment. */
     picoquic_log_decrypted_segment(F_log, log_cnxid, cnx, 0,
         &ph, bytes, length, ret);
@@ -1641,6 +1704,15 @@ void picoquic_log_transport_extension_content(FILE* F, int log_cnxid, uint64_t c
                             fprintf(F, "Malformed extension, only %d bytes available.\n", (int)(bytes_max - byte_index));
                             ret = -1;
                         }
+                        else if (extension_type == picoquic_tp_min_ack_delay) {
+                            uint64_t min_ack_delay = 0;
+                            if (picoquic_varint_decode(bytes + byte_index, (size_t) extension_length, &min_ack_delay) != extension_length) {
+                                fprintf(F, "Malformed min_ack_delay\n");
+                            } else {
+                                fprintf(F, "min_ack_delay: %" PRIu64 " us\n", min_ack_delay);
+                            }
+                            byte_index += (size_t) extension_length;
+                        }
                         else {
                             char *format_str = "%02x";
                             if (extension_type == picoquic_tp_supported_plugins || extension_type == picoquic_tp_plugins_to_inject) {
@@ -1689,20 +1761,12 @@ void picoquic_log_transport_extension_content(FILE* F, int log_cnxid, uint64_t c
     }
 }
 
-void picoquic_log_transport_extension(FILE* F, picoquic_cnx_t* cnx, int log_cnxid)
+void picoquic_log_transport_extension_values(FILE* F, int log_cnxid, uint64_t cnx_id_64,
+    char const* sni, char const* alpn, uint8_t* bytes, size_t bytes_max, int client_mode,
+    uint32_t initial_version, uint32_t final_version)
 {
-    if (!F)
-        return;
-
-    uint8_t* bytes = NULL;
-    size_t bytes_max = 0;
-    int ext_received_return = 0;
-    int client_mode = 1;
-    char const* sni = picoquic_tls_get_sni(cnx);
-    char const* alpn = picoquic_tls_get_negotiated_alpn(cnx);
-
     if (log_cnxid != 0) {
-        fprintf(F, "%" PRIx64 ": ", picoquic_val64_connection_id(picoquic_get_logging_cnxid(cnx)));
+        fprintf(F, "%" PRIx64 ": ", cnx_id_64);
     }
     if (sni == NULL) {
         fprintf(F, "SNI not received.\n");
@@ -1711,31 +1775,29 @@ void picoquic_log_transport_extension(FILE* F, picoquic_cnx_t* cnx, int log_cnxi
     }
 
     if (log_cnxid != 0) {
-        fprintf(F, "%" PRIx64 ": ", picoquic_val64_connection_id(picoquic_get_logging_cnxid(cnx)));
+        fprintf(F, "%" PRIx64 ": ", cnx_id_64);
     }
     if (alpn == NULL) {
         fprintf(F, "ALPN not received.\n");
     } else {
         fprintf(F, "Received ALPN: %s\n", alpn);
     }
-    picoquic_provide_received_transport_extensions(cnx,
-        &bytes, &bytes_max, &ext_received_return, &client_mode);
 
     if (bytes_max == 0) {
         if (log_cnxid != 0) {
-            fprintf(F, "%" PRIx64 ": ", picoquic_val64_connection_id(picoquic_get_logging_cnxid(cnx)));
+            fprintf(F, "%" PRIx64 ": ", cnx_id_64);
         }
         fprintf(F, "Did not receive transport parameter TLS extension.\n");
     }
     else {
         if (log_cnxid != 0) {
-            fprintf(F, "%" PRIx64 ": ", picoquic_val64_connection_id(picoquic_get_logging_cnxid(cnx)));
+            fprintf(F, "%" PRIx64 ": ", cnx_id_64);
         }
         fprintf(F, "Received transport parameter TLS extension (%d bytes):\n", (uint32_t)bytes_max);
 
         picoquic_log_transport_extension_content(F, log_cnxid,
-            picoquic_val64_connection_id(picoquic_get_logging_cnxid(cnx)), bytes, bytes_max, client_mode,
-            cnx->proposed_version, picoquic_supported_versions[cnx->version_index].version);
+            cnx_id_64, bytes, bytes_max, client_mode,
+            initial_version, final_version);
     }
 
     if (log_cnxid == 0) {
@@ -1743,21 +1805,62 @@ void picoquic_log_transport_extension(FILE* F, picoquic_cnx_t* cnx, int log_cnxi
     }
 }
 
+void picoquic_log_transport_extension(FILE* F, picoquic_cnx_t* cnx, int log_cnxid)
+{
+    if (!F)
+        return;
+
+    uint8_t* bytes = NULL;
+    size_t bytes_max = 0;
+    int ext_received_return = 0;
+    int client_mode = 1;
+
+    picoquic_provide_received_transport_extensions(cnx,
+        &bytes, &bytes_max, &ext_received_return, &client_mode);
+
+    picoquic_log_transport_extension_values(F, log_cnxid,
+        picoquic_val64_connection_id(picoquic_get_logging_cnxid(cnx)),
+        picoquic_tls_get_sni(cnx), picoquic_tls_get_negotiated_alpn(cnx), bytes, bytes_max, client_mode,
+        cnx->proposed_version, picoquic_supported_versions[cnx->version_index].version);
+}
+
+void picoquic_log_get_cc_state(picoquic_cnx_t* cnx, uint64_t current_time, picoquic_log_cc_state_t* cc_state)
+{
+    picoquic_path_t * path_x = cnx->path[0];
+
+    cc_state->cnx_id_64 = picoquic_val64_connection_id(picoquic_get_logging_cnxid(cnx));
+    cc_state->delta_t = current_time - cnx->start_time;
+    cc_state->cwin = path_x->cwin;
+    cc_state->bytes_in_transit = path_x->bytes_in_transit;
+    cc_state->nb_retransmission_total = cnx->nb_retransmission_total;
+    cc_state->rtt_min = path_x->rtt_min;
+    cc_state->smoothed_rtt = path_x->smoothed_rtt;
+    cc_state->rtt_variant = path_x->rtt_variant;
+    cc_state->max_ack_delay = path_x->max_ack_delay;
+    cc_state->cnx_state = cnx->cnx_state;
+}
+
+void picoquic_log_cc_state(FILE* F, picoquic_log_cc_state_t const* cc_state)
+{
+    fprintf(F, "%" PRIx64 ": ", cc_state->cnx_id_64);
+    picoquic_log_time(F, NULL, cc_state->delta_t, "T= ", ", ");
+    fprintf(F, "cwin: %d,", (int)cc_state->cwin);
+    fprintf(F, "flight: %d,", (int)cc_state->bytes_in_transit);
+    fprintf(F, "nb_ret: %d,", (int)cc_state->nb_retransmission_total);
+    fprintf(F, "rtt_min: %d,", (int)cc_state->rtt_min);
+    fprintf(F, "rtt: %d,", (int)cc_state->smoothed_rtt);
+    fprintf(F, "rtt_var: %d,", (int)cc_state->rtt_variant);
+    fprintf(F, "max_ack_delay: %d,", (int)cc_state->max_ack_delay);
+    fprintf(F, "state: %d\n", (int)cc_state->cnx_state);
+}
+
 void picoquic_log_congestion_state(FILE* F, picoquic_cnx_t* cnx, uint64_t current_time)
 {
     if (F != NULL) {
-        picoquic_path_t * path_x = cnx->path[0];
-
-        fprintf(F, "%" PRIx64 ": ", picoquic_val64_connection_id(picoquic_get_logging_cnxid(cnx)));
-        picoquic_log_time(F, cnx, current_time, "T= ", ", ");
-        fprintf(F, "cwin: %d,", (int)path_x->cwin);
-        fprintf(F, "flight: %d,", (int)path_x->bytes_in_transit);
-        fprintf(F, "nb_ret: %d,", (int)cnx->nb_retransmission_total);
-        fprintf(F, "rtt_min: %d,", (int)path_x->rtt_min);
-        fprintf(F, "rtt: %d,", (int)path_x->smoothed_rtt);
-        fprintf(F, "rtt_var: %d,", (int)path_x->rtt_variant);
-        fprintf(F, "max_ack_delay: %d,", (int)path_x->max_ack_delay);
-        fprintf(F, "state: %d\n", (int)cnx->cnx_state);
+        picoquic_log_cc_state_t cc_state;
+
+        picoquic_log_get_cc_state(cnx, current_time, &cc_state);
+        picoquic_log_cc_state(F, &cc_state);
     }
 }
 
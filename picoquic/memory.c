@@ -2,7 +2,12 @@
 #include "memcpy.h"
 
 #include <unistd.h>
+#ifndef _WINDOWS
+#include <sys/mman.h>
+#endif
 #include <michelfralloc/michelfralloc.h>
+#include "slab_memory.h"
+#include "huge_memory.h"
 #include "picoquic_internal.h"
 
 /* This implementation is mostly a translation from C++ to C of the
@@ -251,6 +256,52 @@ int destroy_dynamic_memory_management(protoop_plugin_t *p)
 
 
 
+void *malloc_slab(protoop_plugin_t *p, unsigned int size) {
+    return slab_malloc((slab_memory_t *) p->memory_manager.ctx, size);
+}
+
+void free_slab(protoop_plugin_t *p, void *ptr) {
+    slab_free((slab_memory_t *) p->memory_manager.ctx, ptr);
+}
+
+void *realloc_slab(protoop_plugin_t *p, void *ptr, unsigned int size) {
+    return slab_realloc((slab_memory_t *) p->memory_manager.ctx, ptr, size);
+}
+
+int init_slab_memory_management(protoop_plugin_t *p)
+{
+    p->memory_manager.my_malloc = malloc_slab;
+    p->memory_manager.my_free = free_slab;
+    p->memory_manager.my_realloc = realloc_slab;
+
+    slab_memory_t *slab = calloc(1, sizeof(slab_memory_t));
+    if (!slab) {
+        return -1;
+    }
+    if (slab_memory_init(slab, p->memory, PLUGIN_MEMORY) != 0) {
+        free(slab);
+        return -1;
+    }
+    p->memory_manager.ctx = slab;
+    return 0;
+}
+
+int destroy_slab_memory_management(protoop_plugin_t *p)
+{
+    slab_memory_t *slab = (slab_memory_t *) p->memory_manager.ctx;
+    if (!slab) {
+        fprintf(stderr, "cannot free NULL plugin slab memory manager context !\n");
+        return -1;
+    }
+    DBG_MEMORY_PRINTF("plugin %s: %" PRIu64 " allocs, %" PRIu64 " frees, %" PRIu64 " failed, peak %" PRIu64 " bytes",
+        p->name, slab->stats.nb_allocs, slab->stats.nb_frees, slab->stats.nb_failed_allocs, slab->stats.peak_bytes_in_use);
+    slab_memory_destroy(slab);
+    free(slab);
+    return 0;
+}
+
+
+
 int init_memory_management(protoop_plugin_t *p) {
     if (!p) {
         fprintf(stderr, "call to init_memory_management with a NULL plugin !\n");
@@ -264,6 +315,9 @@ int init_memory_management(protoop_plugin_t *p) {
         case plugin_memory_manager_dynamic:
             printf("create dynamic memory manager\n");
             return init_dynamic_memory_management(p);
+        case plugin_memory_manager_slab:
+            printf("create slab memory manager\n");
+            return init_slab_memory_management(p);
         default:
             fprintf(stderr, "unknown plugin memory manager %d !\n", p->params.plugin_memory_manager_type);
             return -1;
@@ -281,8 +335,26 @@ int destroy_memory_management(protoop_plugin_t *p) {
             return destroy_block_memory_management(p);
         case plugin_memory_manager_dynamic:
             return destroy_dynamic_memory_management(p);
+        case plugin_memory_manager_slab:
+            return destroy_slab_memory_management(p);
         default:
             fprintf(stderr, "unknown plugin memory manager %d !\n", p->params.plugin_memory_manager_type);
             return -1;
     }
 }
+
+/* The pluglets are compiled with the address of the memory, so it is kept mapped.
+ * The released pages read as zeros when touched again. */
+void release_memory_pages(protoop_plugin_t *p) {
+#ifndef _WINDOWS
+    uintptr_t page_size = (p->huge_memory) ? PICOQUIC_HUGE_PAGE_SIZE : (uintptr_t) sysconf(_SC_PAGESIZE);
+    uintptr_t start = ((uintptr_t) p->memory + page_size - 1) & ~(page_size - 1);
+    uintptr_t end = ((uintptr_t) p->memory + PLUGIN_MEMORY) & ~(page_size - 1);
+
+    if (end > start) {
+        (void) madvise((void *) start, end - start, MADV_DONTNEED);
+    }
+#else
+    (void) p;
+#endif
+}
@@ -15,6 +15,10 @@ int init_memory_management(protoop_plugin_t *p);
 
 int destroy_memory_management(protoop_plugin_t *p);
 
+/* Returns the pages of the plugin memory to the system, at the same addresses.
+ * The memory manager must be destroyed first. */
+void release_memory_pages(protoop_plugin_t *p);
+
 #ifndef MAX
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
 #endif
@@ -0,0 +1,281 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "picosocks.h"
+#include "spsc_ring.h"
+#include "metrics_exporter.h"
+
+#define METRICS_PADDED_LENGTH(l) (((l) + 7) & ~((size_t) 7))
+
+typedef enum {
+    metrics_sink_socket = 0,
+    metrics_sink_file
+} metrics_sink_t;
+
+struct st_picoquic_metrics_exporter_t {
+    spsc_ring_t* ring;
+    metrics_sink_t sink;
+
+    /* Socket sink */
+    int fd;
+    struct sockaddr_storage dest_addr;
+    socklen_t dest_addr_len;
+
+    /* File sink */
+    picoquic_metrics_file_header_t* file_header;
+    uint8_t* file_area;
+    size_t file_map_length;
+
+    /* Batch being filled */
+    uint32_t batch_length;
+    uint16_t batch_nb_records;
+    uint32_t batch_sequence;
+    uint64_t batch_start_time;
+
+    uint64_t nb_dropped;
+
+    uint8_t record[PICOQUIC_METRICS_BATCH_MAX];
+    uint8_t batch[PICOQUIC_METRICS_BATCH_MAX];
+};
+
+static int metrics_open_udp(picoquic_metrics_exporter_t* exporter, const char* spec)
+{
+    char host[256];
+    const char* port_sep = strrchr(spec, ':');
+    int addr_len = 0;
+    int is_name = 0;
+
+    if (port_sep == NULL || port_sep == spec || (size_t)(port_sep - spec) >= sizeof(host)) {
+        return -1;
+    }
+
+    /* Accept bracketed IPv6 addresses, e.g. udp:[::1]:55555 */
+    if (spec[0] == '[' && port_sep[-1] == ']') {
+        memcpy(host, spec + 1, port_sep - spec - 2);
+        host[port_sep - spec - 2] = 0;
+    } else {
+        memcpy(host, spec, port_sep - spec);
+        host[port_sep - spec] = 0;
+    }
+
+    if (picoquic_get_server_address(host, atoi(port_sep + 1), &exporter->dest_addr, &addr_len, &is_name) != 0) {
+        return -1;
+    }
+    exporter->dest_addr_len = (socklen_t) addr_len;
+    exporter->fd = socket(exporter->dest_addr.ss_family, SOCK_DGRAM, 0);
+    return (exporter->fd < 0) ? -1 : 0;
+}
+
+static int metrics_open_unix(picoquic_metrics_exporter_t* exporter, const char* path)
+{
+    struct sockaddr_un* addr = (struct sockaddr_un*) &exporter->dest_addr;
+
+    if (strlen(path) == 0 || strlen(path) >= sizeof(addr->sun_path)) {
+        return -1;
+    }
+
+    addr->sun_family = AF_UNIX;
+    strcpy(addr->sun_path, path);
+    exporter->dest_addr_len = (socklen_t) sizeof(struct sockaddr_un);
+    exporter->fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    return (exporter->fd < 0) ? -1 : 0;
+}
+
+static int metrics_open_file(picoquic_metrics_exporter_t* exporter, const char* path)
+{
+    size_t header_length = METRICS_PADDED_LENGTH(sizeof(picoquic_metrics_file_header_t));
+    size_t map_length = header_length + PICOQUIC_METRICS_FILE_SIZE;
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    void* map = MAP_FAILED;
+
+    if (fd < 0) {
+        return -1;
+    }
+
+    if (ftruncate(fd, (off_t) map_length) == 0) {
+        map = mmap(NULL, map_length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    /* The mapping stays valid once the file is closed */
+    close(fd);
+
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+
+    exporter->sink = metrics_sink_file;
+    exporter->file_header = (picoquic_metrics_file_header_t*) map;
+    exporter->file_area = ((uint8_t*) map) + header_length;
+    exporter->file_map_length = map_length;
+    exporter->file_header->magic = PICOQUIC_METRICS_FILE_MAGIC;
+    exporter->file_header->version = PICOQUIC_METRICS_VERSION;
+    exporter->file_header->header_length = (uint16_t) header_length;
+    exporter->file_header->capacity = PICOQUIC_METRICS_FILE_SIZE;
+    exporter->file_header->write_offset = 0;
+    return 0;
+}
+
+picoquic_metrics_exporter_t* picoquic_metrics_exporter_create(const char* destination)
+{
+    int ret = -1;
+    picoquic_metrics_exporter_t* exporter = (picoquic_metrics_exporter_t*) calloc(1, sizeof(picoquic_metrics_exporter_t));
+
+    if (exporter == NULL || destination == NULL) {
+        free(exporter);
+        return NULL;
+    }
+
+    exporter->fd = -1;
+    exporter->batch_length = sizeof(picoquic_metrics_batch_header_t);
+    exporter->ring = spsc_ring_create(PICOQUIC_METRICS_RING_SIZE);
+
+    if (exporter->ring != NULL) {
+        if (strncmp(destination, "udp:", 4) == 0) {
+            ret = metrics_open_udp(exporter, destination + 4);
+        } else if (strncmp(destination, "unix:", 5) == 0) {
+            ret = metrics_open_unix(exporter, destination + 5);
+        } else if (strncmp(destination, "file:", 5) == 0) {
+            ret = metrics_open_file(exporter, destination + 5);
+        }
+    }
+
+    if (ret != 0) {
+        picoquic_metrics_exporter_free(exporter);
+        exporter = NULL;
+    }
+
+    return exporter;
+}
+
+static int metrics_write_batch(picoquic_metrics_exporter_t* exporter)
+{
+    int ret = 0;
+    picoquic_metrics_batch_header_t* header = (picoquic_metrics_batch_header_t*) exporter->batch;
+
+    header->magic = PICOQUIC_METRICS_BATCH_MAGIC;
+    header->version = PICOQUIC_METRICS_VERSION;
+    header->nb_records = exporter->batch_nb_records;
+    header->length = exporter->batch_length;
+    header->sequence = exporter->batch_sequence++;
+
+    if (exporter->sink == metrics_sink_file) {
+        picoquic_metrics_file_header_t* file_header = exporter->file_header;
+        uint64_t offset = file_header->write_offset;
+        uint64_t pos = offset % file_header->capacity;
+
+        if (pos + exporter->batch_length > file_header->capacity) {
+            /* Mark the end of the area as unused and restart from its beginning */
+            if (file_header->capacity - pos >= sizeof(picoquic_metrics_batch_header_t)) {
+                picoquic_metrics_batch_header_t* wrap = (picoquic_metrics_batch_header_t*) (exporter->file_area + pos);
+                memset(wrap, 0, sizeof(picoquic_metrics_batch_header_t));
+                wrap->magic = PICOQUIC_METRICS_BATCH_MAGIC;
+                wrap->version = PICOQUIC_METRICS_VERSION;
+            }
+            offset += file_header->capacity - pos;
+            pos = 0;
+        }
+
+        memcpy(exporter->file_area + pos, exporter->batch, exporter->batch_length);
+        __atomic_store_n(&file_header->write_offset, offset + exporter->batch_length, __ATOMIC_RELEASE);
+    } else if (sendto(exporter->fd, exporter->batch, exporter->batch_length, 0,
+                   (struct sockaddr*) &exporter->dest_addr, exporter->dest_addr_len) != (ssize_t) exporter->batch_length) {
+        /* Most likely no collector is listening, the records are lost */
+        exporter->nb_dropped += exporter->batch_nb_records;
+        ret = -1;
+    }
+
+    exporter->batch_length = sizeof(picoquic_metrics_batch_header_t);
+    exporter->batch_nb_records = 0;
+    return ret;
+}
+
+void picoquic_metrics_exporter_free(picoquic_metrics_exporter_t* exporter)
+{
+    if (exporter != NULL) {
+        if (exporter->ring != NULL) {
+            if (exporter->fd >= 0 || exporter->file_header != NULL) {
+                (void) picoquic_metrics_exporter_flush(exporter, 0, 1);
+            }
+            spsc_ring_free(exporter->ring);
+        }
+        if (exporter->fd >= 0) {
+            close(exporter->fd);
+        }
+        if (exporter->file_header != NULL) {
+            munmap(exporter->file_header, exporter->file_map_length);
+        }
+        free(exporter);
+    }
+}
+
+int picoquic_metrics_exporter_push(picoquic_metrics_exporter_t* exporter, uint16_t type,
+    const uint8_t* data, size_t length, uint64_t current_time)
+{
+    picoquic_metrics_record_header_t* header = (picoquic_metrics_record_header_t*) exporter->record;
+
+    if (length > PICOQUIC_METRICS_RECORD_MAX) {
+        exporter->nb_dropped++;
+        return -1;
+    }
+
+    header->type = type;
+    header->length = (uint16_t) length;
+    header->reserved = 0;
+    header->timestamp = current_time;
+    memcpy(exporter->record + sizeof(picoquic_metrics_record_header_t), data, length);
+
+    if (spsc_ring_push(exporter->ring, exporter->record, (uint32_t)(sizeof(picoquic_metrics_record_header_t) + length)) != 0) {
+        exporter->nb_dropped++;
+        return -1;
+    }
+
+    return 0;
+}
+
+int picoquic_metrics_exporter_flush(picoquic_metrics_exporter_t* exporter, uint64_t current_time, int force)
+{
+    int nb_sent = 0;
+    int length;
+
+    while (spsc_ring_peek_length(exporter->ring) > 0) {
+        length = spsc_ring_pop(exporter->ring, exporter->batch + exporter->batch_length,
+            PICOQUIC_METRICS_BATCH_MAX - exporter->batch_length);
+        if (length < 0) {
+            if (exporter->batch_nb_records == 0) {
+                /* Cannot happen as long as the records are checked when pushed */
+                spsc_ring_skip(exporter->ring);
+                exporter->nb_dropped++;
+            } else {
+                (void) metrics_write_batch(exporter);
+                nb_sent++;
+            }
+            continue;
+        }
+
+        if (exporter->batch_nb_records == 0) {
+            exporter->batch_start_time = current_time;
+        }
+        exporter->batch_length += (uint32_t) length;
+        /* Keep the record headers aligned */
+        while (exporter->batch_length < PICOQUIC_METRICS_BATCH_MAX && (exporter->batch_length & 7) != 0) {
+            exporter->batch[exporter->batch_length++] = 0;
+        }
+        exporter->batch_nb_records++;
+    }
+
+    if (exporter->batch_nb_records > 0 &&
+        (force || current_time >= exporter->batch_start_time + PICOQUIC_METRICS_FLUSH_DELAY)) {
+        (void) metrics_write_batch(exporter);
+        nb_sent++;
+    }
+
+    return nb_sent;
+}
+
+uint64_t picoquic_metrics_exporter_get_dropped(picoquic_metrics_exporter_t* exporter)
+{
+    return exporter->nb_dropped;
+}
@@ -0,0 +1,112 @@
+/**
+ * \file metrics_exporter.h
+ * \brief Batched export of the metric records produced by the plugins.
+ *
+ * Plugins push metric records in a lock-free ring owned by the QUIC context
+ * instead of talking to the network themselves. The stack drains the ring
+ * when it prepares packets, packs the records in batches and writes each
+ * batch to the destination with a single system call. The destination is a
+ * UDP socket, a UNIX datagram socket or a memory-mapped file.
+ *
+ * A batch starts with a picoquic_metrics_batch_header_t, followed by
+ * nb_records records. Each record is a picoquic_metrics_record_header_t
+ * followed by length bytes, padded to 8 bytes. All the fields are in host
+ * byte order. The meaning of the record type and of its content is defined
+ * by the plugin producing it.
+ *
+ * A memory-mapped file starts with a picoquic_metrics_file_header_t and
+ * holds the batches in a circular area of capacity bytes. write_offset counts
+ * the bytes ever written in this area and is updated after each batch; the
+ * batch at write_offset is at position write_offset % capacity. A batch never
+ * wraps: when it does not fit before the end of the area, the remaining bytes
+ * start with a batch header of length 0, or are shorter than a batch header,
+ * and the batch is written at the start of the area.
+ */
+
+#ifndef PICOQUIC_METRICS_EXPORTER_H
+#define PICOQUIC_METRICS_EXPORTER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PICOQUIC_METRICS_DEFAULT_DESTINATION "udp:127.0.0.1:55555"
+#define PICOQUIC_METRICS_BATCH_MAGIC 0x424d5150 /* "PQMB" */
+#define PICOQUIC_METRICS_FILE_MAGIC 0x464d5150 /* "PQMF" */
+#define PICOQUIC_METRICS_VERSION 1
+#define PICOQUIC_METRICS_BATCH_MAX 16384
+#define PICOQUIC_METRICS_RECORD_MAX (PICOQUIC_METRICS_BATCH_MAX - sizeof(picoquic_metrics_batch_header_t) - sizeof(picoquic_metrics_record_header_t))
+#define PICOQUIC_METRICS_RING_SIZE (1 << 18)
+#define PICOQUIC_METRICS_FILE_SIZE (1 << 22)
+#define PICOQUIC_METRICS_FLUSH_DELAY 100000 /* Max time a record waits for its batch to fill, in microseconds */
+
+typedef struct st_picoquic_metrics_batch_header_t {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t nb_records;
+    uint32_t length; /* Including this header */
+    uint32_t sequence;
+} picoquic_metrics_batch_header_t;
+
+typedef struct st_picoquic_metrics_record_header_t {
+    uint16_t type;
+    uint16_t length; /* Excluding this header and the padding */
+    uint32_t reserved;
+    uint64_t timestamp; /* In microseconds, as given by the QUIC context */
+} picoquic_metrics_record_header_t;
+
+typedef struct st_picoquic_metrics_file_header_t {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_length;
+    uint64_t capacity;
+    uint64_t write_offset;
+} picoquic_metrics_file_header_t;
+
+typedef struct st_picoquic_metrics_exporter_t picoquic_metrics_exporter_t;
+
+/**
+ * Creates an exporter writing to \p destination, which is one of
+ * "udp:<address>:<port>", "unix:<path>" or "file:<path>".
+ *
+ * \return The exporter, or NULL if the destination is invalid or could not be opened
+ */
+picoquic_metrics_exporter_t* picoquic_metrics_exporter_create(const char* destination);
+
+/**
+ * Sends the pending records and frees the exporter.
+ */
+void picoquic_metrics_exporter_free(picoquic_metrics_exporter_t* exporter);
+
+/**
+ * Queues a record of \p length bytes. Producer side of the ring.
+ *
+ * \return 0 if the record was queued, -1 if it is too large or the ring is full
+ */
+int picoquic_metrics_exporter_push(picoquic_metrics_exporter_t* exporter, uint16_t type,
+    const uint8_t* data, size_t length, uint64_t current_time);
+
+/**
+ * Moves the queued records to the current batch, sending each batch that
+ * becomes full. The last batch is only sent if \p force is set or if its
+ * oldest record waited for PICOQUIC_METRICS_FLUSH_DELAY. Consumer side of
+ * the ring.
+ *
+ * \return The number of batches sent
+ */
+int picoquic_metrics_exporter_flush(picoquic_metrics_exporter_t* exporter, uint64_t current_time, int force);
+
+/**
+ * \return The number of records that were lost, either because the ring was
+ * full or because their batch could not be sent
+ */
+uint64_t picoquic_metrics_exporter_get_dropped(picoquic_metrics_exporter_t* exporter);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PICOQUIC_METRICS_EXPORTER_H */
@@ -0,0 +1,708 @@
+#include <stdlib.h>
+#include <string.h>
+#include <elf.h>
+#include "picoquic_internal.h"
+#include "getset.h"
+#include "native_pluglet.h"
+
+#ifndef EM_BPF
+#define EM_BPF 247
+#endif
+#define NATIVE_R_BPF_64_32 10 /* Relocation of the calls to the helpers */
+
+/* The part of eBPF the lowering accepts */
+#define EBPF_CLS_MASK 0x07
+#define EBPF_CLS_LD 0x00
+#define EBPF_CLS_LDX 0x01
+#define EBPF_CLS_ST 0x02
+#define EBPF_CLS_STX 0x03
+#define EBPF_CLS_ALU 0x04
+#define EBPF_CLS_JMP 0x05
+#define EBPF_CLS_JMP32 0x06
+#define EBPF_CLS_ALU64 0x07
+#define EBPF_SRC_REG 0x08
+#define EBPF_OP_MASK 0xf0
+#define EBPF_ALU_ADD 0x00
+#define EBPF_ALU_SUB 0x10
+#define EBPF_ALU_MUL 0x20
+#define EBPF_ALU_OR 0x40
+#define EBPF_ALU_AND 0x50
+#define EBPF_ALU_LSH 0x60
+#define EBPF_ALU_RSH 0x70
+#define EBPF_ALU_NEG 0x80
+#define EBPF_ALU_XOR 0xa0
+#define EBPF_ALU_MOV 0xb0
+#define EBPF_ALU_ARSH 0xc0
+#define EBPF_ALU_END 0xd0
+#define EBPF_OP_LDDW 0x18
+#define EBPF_OP_CALL 0x85
+#define EBPF_OP_EXIT 0x95
+#define EBPF_NB_REGS 11 /* r10 is the frame pointer */
+
+typedef enum {
+    native_step_alu = 0,
+    native_step_call,
+    native_step_load_field,
+    native_step_store_field,
+    native_step_store_path_field, /* As set_path, disarms the loss timers of the path */
+    native_step_load_input
+} native_step_enum;
+
+typedef struct st_native_inst_t {
+    uint8_t opcode;
+    uint8_t regs; /* dst in the low nibble, src in the high one */
+    int16_t offset;
+    int32_t imm;
+} native_inst_t;
+
+typedef uint64_t (*native_helper_t)(uint64_t r1, uint64_t r2, uint64_t r3, uint64_t r4, uint64_t r5);
+
+/* The text section of the object, with the relocations of its calls */
+typedef struct st_native_elf_t {
+    const uint8_t *text;
+    size_t text_len;
+    const Elf64_Rel *rels;
+    size_t nb_rels;
+    const Elf64_Sym *syms;
+    size_t nb_syms;
+    const char *strtab;
+    size_t strtab_len;
+    unsigned int symtab_idx;
+    unsigned int strtab_idx;
+} native_elf_t;
+
+/* What the lowering knows of a register */
+typedef struct st_native_reg_t {
+    int defined;
+    int is_const;
+    uint64_t value;
+} native_reg_t;
+
+static const Elf64_Shdr *native_elf_section(const uint8_t *elf, size_t elf_len, const Elf64_Ehdr *ehdr, unsigned int idx)
+{
+    if (idx >= ehdr->e_shnum) {
+        return NULL;
+    }
+
+    const Elf64_Shdr *shdr = (const Elf64_Shdr *) (elf + ehdr->e_shoff) + idx;
+
+    if (shdr->sh_type != SHT_NOBITS && (shdr->sh_offset > elf_len || shdr->sh_size > elf_len - shdr->sh_offset)) {
+        return NULL;
+    }
+
+    return shdr;
+}
+
+static int native_elf_parse(const uint8_t *elf, size_t elf_len, native_elf_t *parsed)
+{
+    const Elf64_Ehdr *ehdr = (const Elf64_Ehdr *) elf;
+    unsigned int text_idx = 0;
+
+    memset(parsed, 0, sizeof(native_elf_t));
+
+    if (elf_len < sizeof(Elf64_Ehdr) || memcmp(elf, ELFMAG, SELFMAG) != 0 ||
+        ehdr->e_ident[EI_CLASS] != ELFCLASS64 || ehdr->e_ident[EI_DATA] != ELFDATA2LSB ||
+        ehdr->e_machine != EM_BPF || ehdr->e_shentsize != sizeof(Elf64_Shdr) ||
+        ehdr->e_shoff > elf_len || ehdr->e_shnum > (elf_len - ehdr->e_shoff) / sizeof(Elf64_Shdr)) {
+        return -1;
+    }
+
+    /* The pluglet is the only code of the object */
+    for (unsigned int i = 0; i < ehdr->e_shnum; i++) {
+        const Elf64_Shdr *shdr = native_elf_section(elf, elf_len, ehdr, i);
+        if (shdr == NULL) {
+            return -1;
+        }
+        if (shdr->sh_type == SHT_PROGBITS && (shdr->sh_flags & SHF_EXECINSTR) != 0 && shdr->sh_size > 0) {
+            if (parsed->text != NULL) {
+                return -1;
+            }
+            parsed->text = elf + shdr->sh_offset;
+            parsed->text_len = shdr->sh_size;
+            text_idx = i;
+        }
+    }
+
+    if (parsed->text == NULL || parsed->text_len % sizeof(native_inst_t) != 0) {
+        return -1;
+    }
+
+    for (unsigned int i = 0; i < ehdr->e_shnum; i++) {
+        const Elf64_Shdr *shdr = native_elf_section(elf, elf_len, ehdr, i);
+        if (shdr->sh_type == SHT_REL && shdr->sh_info == text_idx) {
+            const Elf64_Shdr *symtab = native_elf_section(elf, elf_len, ehdr, shdr->sh_link);
+            const Elf64_Shdr *strtab = (symtab == NULL) ? NULL : native_elf_section(elf, elf_len, ehdr, symtab->sh_link);
+            if (parsed->rels != NULL || strtab == NULL || symtab->sh_type != SHT_SYMTAB || strtab->sh_type != SHT_STRTAB) {
+                return -1;
+            }
+            parsed->rels = (const Elf64_Rel *) (elf + shdr->sh_offset);
+            parsed->nb_rels = shdr->sh_size / sizeof(Elf64_Rel);
+            parsed->syms = (const Elf64_Sym *) (elf + symtab->sh_offset);
+            parsed->nb_syms = symtab->sh_size / sizeof(Elf64_Sym);
+            parsed->strtab = (const char *) (elf + strtab->sh_offset);
+            parsed->strtab_len = strtab->sh_size;
+            parsed->symtab_idx = shdr->sh_link;
+            parsed->strtab_idx = symtab->sh_link;
+        }
+    }
+
+    return 0;
+}
+
+/* Returns the name of the symbol the instruction at pc is relocated to, NULL if it is not relocated */
+static const char *native_elf_relocation(const native_elf_t *parsed, size_t pc, int *type)
+{
+    for (size_t i = 0; i < parsed->nb_rels; i++) {
+        if (parsed->rels[i].r_offset == pc * sizeof(native_inst_t)) {
+            size_t sym = ELF64_R_SYM(parsed->rels[i].r_info);
+            *type = (int) ELF64_R_TYPE(parsed->rels[i].r_info);
+            if (sym >= parsed->nb_syms || parsed->syms[sym].st_name >= parsed->strtab_len ||
+                memchr(parsed->strtab + parsed->syms[sym].st_name, 0, parsed->strtab_len - parsed->syms[sym].st_name) == NULL) {
+                return "";
+            }
+            return parsed->strtab + parsed->syms[sym].st_name;
+        }
+    }
+
+    return NULL;
+}
+
+static uint64_t native_pluglet_alu(uint8_t opcode, uint64_t dst, uint64_t src)
+{
+    int is_64 = (opcode & EBPF_CLS_MASK) == EBPF_CLS_ALU64;
+    int shift = (int) (src & (is_64 ? 63 : 31));
+
+    if (!is_64) {
+        dst = (uint32_t) dst;
+        src = (uint32_t) src;
+    }
+
+    switch (opcode & EBPF_OP_MASK) {
+    case EBPF_ALU_ADD:
+        dst += src;
+        break;
+    case EBPF_ALU_SUB:
+        dst -= src;
+        break;
+    case EBPF_ALU_MUL:
+        dst *= src;
+        break;
+    case EBPF_ALU_OR:
+        dst |= src;
+        break;
+    case EBPF_ALU_AND:
+        dst &= src;
+        break;
+    case EBPF_ALU_LSH:
+        dst <<= shift;
+        break;
+    case EBPF_ALU_RSH:
+        dst >>= shift;
+        break;
+    case EBPF_ALU_NEG:
+        dst = -dst;
+        break;
+    case EBPF_ALU_XOR:
+        dst ^= src;
+        break;
+    case EBPF_ALU_MOV:
+        dst = src;
+        break;
+    default: /* EBPF_ALU_ARSH */
+        dst = is_64 ? (uint64_t) ((int64_t) dst >> shift) : (uint64_t) ((int32_t) dst >> shift);
+        break;
+    }
+
+    return is_64 ? dst : (uint32_t) dst;
+}
+
+static int native_pluglet_is_alu(uint8_t opcode)
+{
+    uint8_t cls = opcode & EBPF_CLS_MASK;
+
+    if (cls != EBPF_CLS_ALU && cls != EBPF_CLS_ALU64) {
+        return 0;
+    }
+
+    switch (opcode & EBPF_OP_MASK) {
+    case EBPF_ALU_ADD:
+    case EBPF_ALU_SUB:
+    case EBPF_ALU_MUL:
+    case EBPF_ALU_OR:
+    case EBPF_ALU_AND:
+    case EBPF_ALU_LSH:
+    case EBPF_ALU_RSH:
+    case EBPF_ALU_XOR:
+    case EBPF_ALU_MOV:
+    case EBPF_ALU_ARSH:
+        return 1;
+    case EBPF_ALU_NEG:
+        return (opcode & EBPF_SRC_REG) == 0;
+    default:
+        /* The division and modulo by zero, and the byte swaps, are left to the VM */
+        return 0;
+    }
+}
+
+/* Resolves the getset calls with constant keys, returns 0 if the call stays a call */
+static int native_pluglet_resolve_call(void *fn, const native_reg_t *regs, native_pluglet_step_t *step)
+{
+    const getset_field_t *field = NULL;
+    int is_set = 0;
+
+    if (!regs[2].is_const || !regs[3].is_const) {
+        return 0;
+    }
+
+    if (fn == (void *) get_cnx && regs[2].value == AK_CNX_INPUT && regs[3].value < PROTOOPARGS_MAX) {
+        step->kind = native_step_load_input;
+        step->imm = (int64_t) regs[3].value;
+        return 1;
+    }
+
+    if (regs[3].value != 0) {
+        return 0;
+    }
+
+    if (fn == (void *) get_cnx || fn == (void *) set_cnx) {
+        field = getset_cnx_field((access_key_t) regs[2].value);
+        is_set = (fn == (void *) set_cnx);
+    } else if (fn == (void *) get_path || fn == (void *) set_path) {
+        field = getset_path_field((access_key_t) regs[2].value);
+        is_set = (fn == (void *) set_path);
+    }
+
+    if (field == NULL || (is_set && (!field->writable || !regs[4].defined))) {
+        return 0;
+    }
+
+    if (!is_set) {
+        step->kind = native_step_load_field;
+    } else {
+        step->kind = (fn == (void *) set_path) ? native_step_store_path_field : native_step_store_field;
+    }
+    step->target = field;
+
+    return 1;
+}
+
+native_pluglet_t *native_pluglet_lower(const void *elf, size_t elf_len, native_pluglet_lookup_t lookup)
+{
+    native_elf_t parsed;
+    native_pluglet_t native;
+    native_reg_t regs[EBPF_NB_REGS];
+    size_t nb_insts;
+    int has_side_effect = 0;
+
+    if (native_elf_parse((const uint8_t *) elf, elf_len, &parsed) != 0) {
+        return NULL;
+    }
+
+    memset(&native, 0, sizeof(native));
+    memset(regs, 0, sizeof(regs));
+    regs[1].defined = 1;
+    nb_insts = parsed.text_len / sizeof(native_inst_t);
+
+    for (size_t pc = 0; pc < nb_insts; pc++) {
+        native_inst_t inst;
+        native_pluglet_step_t *step = &native.steps[native.nb_steps];
+        int reloc_type = 0;
+        const char *reloc = native_elf_relocation(&parsed, pc, &reloc_type);
+        uint8_t dst;
+        uint8_t src;
+
+        memcpy(&inst, parsed.text + pc * sizeof(native_inst_t), sizeof(inst));
+        dst = inst.regs & 0x0f;
+        src = inst.regs >> 4;
+
+        if (native.nb_steps >= NATIVE_PLUGLET_MAX_STEPS || dst >= EBPF_NB_REGS - 1 || src >= EBPF_NB_REGS - 1) {
+            /* Using the stack is a memory access */
+            return NULL;
+        }
+
+        if (native_pluglet_is_alu(inst.opcode)) {
+            int src_is_reg = (inst.opcode & EBPF_SRC_REG) != 0;
+            int is_mov = (inst.opcode & EBPF_OP_MASK) == EBPF_ALU_MOV;
+            uint64_t src_value = src_is_reg ? regs[src].value : (uint64_t) (int64_t) inst.imm;
+
+            if (reloc != NULL || (src_is_reg && !regs[src].defined) || (!is_mov && !regs[dst].defined)) {
+                return NULL;
+            }
+            if ((!src_is_reg || regs[src].is_const) && (is_mov || regs[dst].is_const)) {
+                /* Folded into a constant */
+                regs[dst].value = native_pluglet_alu(inst.opcode, regs[dst].value, src_value);
+                regs[dst].is_const = 1;
+                step->opcode = EBPF_CLS_ALU64 | EBPF_ALU_MOV;
+                step->imm = (int64_t) regs[dst].value;
+            } else {
+                regs[dst].is_const = 0;
+                step->src = src_is_reg ? src : 0;
+                step->imm = src_is_reg ? 0 : inst.imm;
+                step->opcode = src_is_reg ? inst.opcode : inst.opcode & (uint8_t) ~EBPF_SRC_REG;
+            }
+            regs[dst].defined = 1;
+            step->kind = native_step_alu;
+            step->dst = dst;
+            native.nb_steps++;
+        } else if (inst.opcode == EBPF_OP_LDDW) {
+            native_inst_t next;
+            if (reloc != NULL || src != 0 || pc + 1 >= nb_insts) {
+                return NULL;
+            }
+            memcpy(&next, parsed.text + (pc + 1) * sizeof(native_inst_t), sizeof(next));
+            if (next.opcode != 0) {
+                return NULL;
+            }
+            regs[dst].defined = 1;
+            regs[dst].is_const = 1;
+            regs[dst].value = (uint64_t) (uint32_t) inst.imm | ((uint64_t) (uint32_t) next.imm << 32);
+            step->kind = native_step_alu;
+            step->opcode = EBPF_CLS_ALU64 | EBPF_ALU_MOV;
+            step->dst = dst;
+            step->imm = (int64_t) regs[dst].value;
+            native.nb_steps++;
+            pc++;
+        } else if (inst.opcode == EBPF_OP_CALL) {
+            void *fn;
+            if (reloc == NULL || reloc_type != NATIVE_R_BPF_64_32 || src != 0 || (fn = lookup(reloc)) == NULL) {
+                return NULL;
+            }
+            if (!native_pluglet_resolve_call(fn, regs, step)) {
+                step->kind = native_step_call;
+                step->target = fn;
+            }
+            has_side_effect = 1;
+            native.nb_steps++;
+            /* The arguments are clobbered */
+            for (int i = 1; i <= 5; i++) {
+                regs[i].defined = 0;
+                regs[i].is_const = 0;
+            }
+            regs[0].defined = 1;
+            regs[0].is_const = 0;
+        } else if (inst.opcode == EBPF_OP_EXIT && reloc == NULL && regs[0].defined && pc + 1 == nb_insts) {
+            native_pluglet_t *lowered = (native_pluglet_t *) malloc(sizeof(native_pluglet_t));
+            if (lowered != NULL) {
+                *lowered = native;
+                if (regs[0].is_const && !has_side_effect) {
+                    lowered->kind = native_pluglet_constant;
+                    lowered->constant = regs[0].value;
+                    lowered->nb_steps = 0;
+                } else {
+                    lowered->kind = native_pluglet_steps;
+                }
+            }
+            return lowered;
+        } else {
+            /* Jumps, memory accesses, and the unsupported operations */
+            return NULL;
+        }
+    }
+
+    return NULL;
+}
+
+uint64_t native_pluglet_run(const native_pluglet_t *native, void *arg)
+{
+    uint64_t regs[EBPF_NB_REGS - 1] = { 0 };
+
+    if (native->kind == native_pluglet_constant) {
+        return native->constant;
+    }
+
+    regs[1] = (uint64_t) arg;
+
+    for (int i = 0; i < native->nb_steps; i++) {
+        const native_pluglet_step_t *step = &native->steps[i];
+
+        switch (step->kind) {
+        case native_step_alu:
+            regs[step->dst] = native_pluglet_alu(step->opcode, regs[step->dst],
+                (step->opcode & EBPF_SRC_REG) ? regs[step->src] : (uint64_t) step->imm);
+            break;
+        case native_step_call:
+            regs[0] = ((native_helper_t) step->target)(regs[1], regs[2], regs[3], regs[4], regs[5]);
+            break;
+        case native_step_load_field:
+            regs[0] = getset_field_load((const void *) regs[1], (const getset_field_t *) step->target);
+            break;
+        case native_step_store_field:
+            getset_field_store((void *) regs[1], (const getset_field_t *) step->target, regs[4]);
+            break;
+        case native_step_store_path_field:
+            picoquic_disarm_loss_timers((picoquic_path_t *) regs[1]);
+            getset_field_store((void *) regs[1], (const getset_field_t *) step->target, regs[4]);
+            break;
+        default: { /* native_step_load_input */
+            picoquic_cnx_t *cnx = (picoquic_cnx_t *) regs[1];
+            regs[0] = (step->imm < cnx->protoop_inputc) ? cnx->protoop_inputv[step->imm] :
+                get_cnx(cnx, AK_CNX_INPUT, (uint16_t) step->imm);
+            break;
+        }
+        }
+    }
+
+    return regs[0];
+}
+
+#define NATIVE_INST_TARGET 0x01    /* A jump lands on the instruction */
+#define NATIVE_INST_LDDW_HIGH 0x02 /* Second half of a lddw */
+
+/* The registers an instruction reads and writes, returns -1 if it may leave the straight-line code */
+static int native_inst_regs(const native_inst_t *inst, uint16_t *read, uint16_t *written)
+{
+    uint8_t dst = inst->regs & 0x0f;
+    uint8_t src = inst->regs >> 4;
+    uint8_t op = inst->opcode & EBPF_OP_MASK;
+
+    *read = 0;
+    *written = 0;
+
+    switch (inst->opcode & EBPF_CLS_MASK) {
+    case EBPF_CLS_ALU:
+    case EBPF_CLS_ALU64:
+        *written = (uint16_t) (1 << dst);
+        if (op != EBPF_ALU_MOV) {
+            *read |= (uint16_t) (1 << dst);
+        }
+        if ((inst->opcode & EBPF_SRC_REG) != 0 && op != EBPF_ALU_NEG && op != EBPF_ALU_END) {
+            *read |= (uint16_t) (1 << src);
+        }
+        return 0;
+    case EBPF_CLS_LD:
+        if (inst->opcode != EBPF_OP_LDDW) {
+            return -1;
+        }
+        *written = (uint16_t) (1 << dst);
+        return 0;
+    case EBPF_CLS_LDX:
+        *read = (uint16_t) (1 << src);
+        *written = (uint16_t) (1 << dst);
+        return 0;
+    case EBPF_CLS_ST:
+        *read = (uint16_t) (1 << dst);
+        return 0;
+    case EBPF_CLS_STX:
+        *read = (uint16_t) ((1 << dst) | (1 << src));
+        return 0;
+    default:
+        /* Jumps, calls and exits */
+        return -1;
+    }
+}
+
+/* Finds the immediate moved into reg before the call at pc, on every path leading to it.
+ * Returns the index of the move, or nb_insts if the register is not such a constant or is read in between. */
+static size_t native_find_const_arg(const native_inst_t *insts, const uint8_t *flags, size_t nb_insts, size_t pc, int reg)
+{
+    if (flags[pc] & NATIVE_INST_TARGET) {
+        return nb_insts;
+    }
+
+    for (size_t i = pc; i-- > 0;) {
+        uint16_t read;
+        uint16_t written;
+
+        if (flags[i] & NATIVE_INST_LDDW_HIGH) {
+            continue;
+        }
+        if (native_inst_regs(&insts[i], &read, &written) != 0 || (read & (1 << reg)) != 0) {
+            return nb_insts;
+        }
+        if (written & (1 << reg)) {
+            int is_mov_imm = insts[i].opcode == (EBPF_CLS_ALU64 | EBPF_ALU_MOV) || insts[i].opcode == (EBPF_CLS_ALU | EBPF_ALU_MOV);
+            return is_mov_imm ? i : nb_insts;
+        }
+        if (flags[i] & NATIVE_INST_TARGET) {
+            return nb_insts;
+        }
+    }
+
+    return nb_insts;
+}
+
+/* The helpers the getset calls with a constant key are redirected to, with the offset of the field in r2 */
+typedef enum {
+    native_access_load_u32 = 0,
+    native_access_load_u64,
+    native_access_store_u32,
+    native_access_store_u64,
+    native_access_input, /* Keeps the key, the index of the input is in r3 */
+    native_access_none
+} native_access_enum;
+
+static const char *native_access_helpers[native_access_none] = {
+    "getset_load_u32", "getset_load_u64", "getset_store_u32", "getset_store_u64", "getset_get_input"
+};
+
+/* The helper a getset call with the constant key ak goes to, and the offset of the field it accesses */
+static native_access_enum native_resolve_access(void *fn, uint64_t ak, uint16_t *offset)
+{
+    const getset_field_t *field = NULL;
+    int is_set = 0;
+
+    if (fn == (void *) get_cnx && ak == AK_CNX_INPUT) {
+        return native_access_input;
+    }
+    if (ak > UINT16_MAX) {
+        return native_access_none;
+    }
+
+    /* The plain fields ignore the param of the call. set_path also disarms the loss timers, it stays. */
+    if (fn == (void *) get_cnx || fn == (void *) set_cnx) {
+        field = getset_cnx_field((access_key_t) ak);
+        is_set = (fn == (void *) set_cnx);
+    } else if (fn == (void *) get_path) {
+        field = getset_path_field((access_key_t) ak);
+    }
+
+    if (field == NULL || (is_set && !field->writable) || (field->size != 4 && field->size != 8)) {
+        return native_access_none;
+    }
+
+    *offset = field->offset;
+    if (is_set) {
+        return (field->size == 4) ? native_access_store_u32 : native_access_store_u64;
+    }
+    return (field->size == 4) ? native_access_load_u32 : native_access_load_u64;
+}
+
+void *native_pluglet_resolve_fields(const void *elf, size_t elf_len, native_pluglet_lookup_t lookup, size_t *resolved_len)
+{
+    const uint8_t *elf_bytes = (const uint8_t *) elf;
+    native_elf_t parsed;
+    native_inst_t *insts;
+    uint8_t *flags;
+    uint8_t *redirected; /* The access helper of each relocation, plus one, 0 if it is kept */
+    uint8_t *resolved = NULL;
+    size_t nb_insts;
+    size_t nb_resolved = 0;
+    Elf64_Word helper_syms[native_access_none];
+    size_t nb_helpers = 0;
+    size_t names_len = 0;
+    size_t syms_offset = (elf_len + 7) & ~(size_t) 7;
+    size_t syms_len;
+    size_t strtab_offset;
+
+    if (native_elf_parse(elf_bytes, elf_len, &parsed) != 0 || parsed.rels == NULL || parsed.nb_syms == 0) {
+        return NULL;
+    }
+
+    nb_insts = parsed.text_len / sizeof(native_inst_t);
+    insts = (native_inst_t *) malloc(parsed.text_len);
+    flags = (uint8_t *) calloc(nb_insts, 1);
+    redirected = (uint8_t *) calloc(parsed.nb_rels, 1);
+    if (insts == NULL || flags == NULL || redirected == NULL) {
+        free(insts);
+        free(flags);
+        free(redirected);
+        return NULL;
+    }
+    memcpy(insts, parsed.text, parsed.text_len);
+    memset(helper_syms, 0, sizeof(helper_syms));
+
+    /* Nothing before a jump target is known on every path leading to it */
+    for (size_t pc = 0; pc < nb_insts; pc++) {
+        uint8_t cls = insts[pc].opcode & EBPF_CLS_MASK;
+        if (insts[pc].opcode == EBPF_OP_LDDW && pc + 1 < nb_insts) {
+            flags[++pc] |= NATIVE_INST_LDDW_HIGH;
+        } else if ((cls == EBPF_CLS_JMP || cls == EBPF_CLS_JMP32) && insts[pc].opcode != EBPF_OP_CALL && insts[pc].opcode != EBPF_OP_EXIT) {
+            int64_t target = (int64_t) pc + 1 + insts[pc].offset;
+            if (target >= 0 && (uint64_t) target < nb_insts) {
+                flags[target] |= NATIVE_INST_TARGET;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < parsed.nb_rels; i++) {
+        size_t pc = parsed.rels[i].r_offset / sizeof(native_inst_t);
+        int reloc_type = 0;
+        const char *reloc;
+        void *fn;
+        size_t key_pc;
+        uint64_t ak;
+        uint16_t offset = 0;
+        native_access_enum access;
+
+        if (parsed.rels[i].r_offset % sizeof(native_inst_t) != 0 || pc >= nb_insts || insts[pc].opcode != EBPF_OP_CALL ||
+            (insts[pc].regs >> 4) != 0) {
+            continue;
+        }
+        reloc = native_elf_relocation(&parsed, pc, &reloc_type);
+        if (reloc == NULL || reloc_type != NATIVE_R_BPF_64_32 || (fn = lookup(reloc)) == NULL) {
+            continue;
+        }
+        key_pc = native_find_const_arg(insts, flags, nb_insts, pc, 2);
+        if (key_pc == nb_insts) {
+            continue;
+        }
+        ak = ((insts[key_pc].opcode & EBPF_CLS_MASK) == EBPF_CLS_ALU64) ?
+            (uint64_t) (int64_t) insts[key_pc].imm : (uint64_t) (uint32_t) insts[key_pc].imm;
+        access = native_resolve_access(fn, ak, &offset);
+        /* The VM may lack a slot for the helper */
+        if (access == native_access_none || lookup(native_access_helpers[access]) == NULL) {
+            continue;
+        }
+        if (access != native_access_input) {
+            /* The key becomes the offset, r2 is clobbered by the call and read by nothing else */
+            insts[key_pc].imm = offset;
+        }
+        if (helper_syms[access] == 0) {
+            helper_syms[access] = (Elf64_Word) (parsed.nb_syms + nb_helpers++);
+            names_len += strlen(native_access_helpers[access]) + 1;
+        }
+        redirected[i] = (uint8_t) (access + 1);
+        nb_resolved++;
+    }
+
+    /* The symbol and string tables move after the object, with the access helpers appended */
+    syms_len = (parsed.nb_syms + nb_helpers) * sizeof(Elf64_Sym);
+    strtab_offset = syms_offset + syms_len;
+    if (nb_resolved > 0) {
+        resolved = (uint8_t *) calloc(strtab_offset + parsed.strtab_len + names_len, 1);
+    }
+
+    if (resolved != NULL) {
+        const Elf64_Ehdr *ehdr = (const Elf64_Ehdr *) elf_bytes;
+        Elf64_Shdr *shdrs;
+        Elf64_Rel *rels;
+        size_t name_offset = parsed.strtab_len;
+
+        memcpy(resolved, elf_bytes, elf_len);
+        memcpy(resolved + (parsed.text - elf_bytes), insts, parsed.text_len);
+        memcpy(resolved + syms_offset, parsed.syms, parsed.nb_syms * sizeof(Elf64_Sym));
+        memcpy(resolved + strtab_offset, parsed.strtab, parsed.strtab_len);
+
+        for (int access = 0; access < native_access_none; access++) {
+            if (helper_syms[access] != 0) {
+                Elf64_Sym *helper = (Elf64_Sym *) (resolved + syms_offset) + helper_syms[access];
+                size_t name_len = strlen(native_access_helpers[access]) + 1;
+                memcpy(resolved + strtab_offset + name_offset, native_access_helpers[access], name_len);
+                helper->st_name = (Elf64_Word) name_offset;
+                helper->st_info = ELF64_ST_INFO(STB_GLOBAL, STT_NOTYPE);
+                helper->st_shndx = SHN_UNDEF;
+                name_offset += name_len;
+            }
+        }
+
+        shdrs = (Elf64_Shdr *) (resolved + ehdr->e_shoff);
+        shdrs[parsed.symtab_idx].sh_offset = syms_offset;
+        shdrs[parsed.symtab_idx].sh_size = syms_len;
+        shdrs[parsed.strtab_idx].sh_offset = strtab_offset;
+        shdrs[parsed.strtab_idx].sh_size = name_offset;
+
+        rels = (Elf64_Rel *) (resolved + ((const uint8_t *) parsed.rels - elf_bytes));
+        for (size_t i = 0; i < parsed.nb_rels; i++) {
+            if (redirected[i]) {
+                rels[i].r_info = ELF64_R_INFO(helper_syms[redirected[i] - 1], ELF64_R_TYPE(rels[i].r_info));
+            }
+        }
+        *resolved_len = strtab_offset + name_offset;
+    }
+
+    free(redirected);
+    free(flags);
+    free(insts);
+
+    return resolved;
+}
@@ -0,0 +1,78 @@
+/**
+ * \file native_pluglet.h
+ * \brief Pluglets simple enough to run without the eBPF VM.
+ *
+ * Many plugins replace a protocol operation by a few instructions: return a
+ * constant, or read an input and set a field. Running them in the VM costs
+ * far more than their body. When a pluglet is loaded, its bytecode is
+ * checked against a subset of eBPF whose effect can be reproduced natively:
+ * straight-line code, without jump, memory access or use of the stack, made
+ * of ALU operations on registers and constants, calls to the helpers, and a
+ * final exit. Such a pluglet is lowered either to its constant result, or to
+ * a list of steps that calls the helpers directly.
+ *
+ * The calls to get_cnx, get_path, set_cnx and set_path with a constant key
+ * and a zero parameter are resolved with the getset field descriptors, and
+ * get_cnx(cnx, AK_CNX_INPUT, i) reads the input directly. The other helpers
+ * are called with the same arguments as from the VM.
+ *
+ * The pluglets left to the VM, with branches or memory accesses, keep their
+ * calls, but those with a constant key are resolved in the same way before the
+ * VM loads them. A get_cnx, set_cnx or get_path call on a field of 4 or 8 bytes
+ * goes to a getset_load or getset_store helper, and the key moved into r2
+ * becomes the offset of the field. get_cnx(cnx, AK_CNX_INPUT, i) goes to
+ * getset_get_input.
+ */
+
+#ifndef PICOQUIC_NATIVE_PLUGLET_H
+#define PICOQUIC_NATIVE_PLUGLET_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NATIVE_PLUGLET_MAX_STEPS 32
+
+typedef enum {
+    native_pluglet_constant = 0, /* Returns a constant, without side effect */
+    native_pluglet_steps         /* Runs the steps */
+} native_pluglet_kind_enum;
+
+typedef struct st_native_pluglet_step_t {
+    uint8_t kind;
+    uint8_t opcode; /* eBPF opcode of the ALU steps */
+    uint8_t dst;
+    uint8_t src;
+    int64_t imm;
+    const void *target; /* Helper called, or field descriptor */
+} native_pluglet_step_t;
+
+typedef struct st_native_pluglet_t {
+    native_pluglet_kind_enum kind;
+    uint64_t constant;
+    int nb_steps;
+    native_pluglet_step_t steps[NATIVE_PLUGLET_MAX_STEPS];
+} native_pluglet_t;
+
+/* Returns the helper registered with that name, or NULL */
+typedef void *(*native_pluglet_lookup_t)(const char *name);
+
+/* Returns NULL if the ELF object is not a pluglet that can run natively */
+native_pluglet_t *native_pluglet_lower(const void *elf, size_t elf_len, native_pluglet_lookup_t lookup);
+
+/* Returns a copy of the ELF object whose getset calls with a constant key in r2, on every path leading
+ * to them, call the getset_load, getset_store and getset_get_input helpers instead, if lookup knows them.
+ * NULL if no call is resolved. */
+void *native_pluglet_resolve_fields(const void *elf, size_t elf_len, native_pluglet_lookup_t lookup, size_t *resolved_len);
+
+/* Behaves as the VM running the pluglet with arg in r1 */
+uint64_t native_pluglet_run(const native_pluglet_t *native, void *arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PICOQUIC_NATIVE_PLUGLET_H */
@@ -36,12 +36,18 @@
 #include "plugin.h"
 #include "memory.h"
 #include "logger.h"
+#include "probes.h"
 
 /*
  * The new packet header parsing is version dependent
  */
 
-int picoquic_parse_packet_header(
+/*
+ * The short header of the 1-RTT packets, which carry most of the traffic once the
+ * connections are established. The connection is found by its ID, and the previous
+ * lookup is remembered since consecutive packets are mostly for the same connection.
+ */
+static int picoquic_parse_short_packet_header(
     picoquic_quic_t* quic,
     uint8_t* bytes,
     uint32_t length,
@@ -52,6 +58,70 @@ int picoquic_parse_packet_header(
 {
     int ret = 0;
     uint8_t local_ctx_length = (quic == NULL) ? 0 : quic->local_ctx_length;
+    /* If this is a short header, it should be possible to retrieve the connection
+     * context. This depends on whether the quic context requires cnx_id or not.
+     */
+    uint8_t cnxid_length = (receiving == 0 && *pcnx != NULL) ? (*pcnx)->path[0]->remote_cnxid.id_len : local_ctx_length;
+    ph->pc = picoquic_packet_context_application;
+
+    if ((int)length >= 1 + cnxid_length) {
+        /* We can identify the connection by its ID */
+        ph->offset = (uint32_t)( 1 + picoquic_parse_connection_id(bytes + 1, cnxid_length, &ph->dest_cnx_id));
+        /* TODO: should consider using combination of CNX ID and ADDR_FROM */
+        if (*pcnx == NULL && quic != NULL) {
+            if (local_ctx_length > 0) {
+                *pcnx = picoquic_cnx_by_id_cached(quic, &ph->dest_cnx_id);
+            }
+            else {
+                *pcnx = picoquic_cnx_by_net(quic, addr_from);
+            }
+        }
+    } else {
+        ph->ptype = picoquic_packet_error;
+        ph->offset = length;
+        ph->payload_length = 0;
+        return ret;
+    }
+
+    if (*pcnx != NULL) {
+        ph->epoch = 3;
+        ph->version_index = (*pcnx)->version_index;
+        /* If the connection is identified, decode the short header per version ID */
+        switch (picoquic_supported_versions[ph->version_index].version_header_encoding) {
+        case picoquic_version_header_27:
+            ph->has_spin_bit = 1;
+            ph->ptype = picoquic_packet_1rtt_protected_phi0;
+            ph->spin = (bytes[0] >> 5) & 1;
+            ph->pn_offset = ph->offset;
+            ph->pn = 0;
+            ph->pnmask = 0;
+            break;
+        }
+
+        if (length < ph->offset) {
+            ret = -1;
+            ph->payload_length = 0;
+        } else {
+            ph->payload_length = (uint16_t)(length - ph->offset);
+        }
+    } else {
+        /* This may be a packet to a forgotten connection */
+        ph->payload_length = (uint16_t)((length > ph->offset)?length - ph->offset:0);
+    }
+
+    return ret;
+}
+
+int picoquic_parse_packet_header(
+    picoquic_quic_t* quic,
+    uint8_t* bytes,
+    uint32_t length,
+    struct sockaddr* addr_from,
+    picoquic_packet_header* ph,
+    picoquic_cnx_t** pcnx,
+    int receiving)
+{
+    int ret = 0;
 
     /* Initialize the PH structure to zero, but version index to -1 (error) */
     memset(ph, 0, sizeof(picoquic_packet_header));
@@ -238,95 +308,40 @@ int picoquic_parse_packet_header(
             }
         }
     } else {
-        /* If this is a short header, it should be possible to retrieve the connection
-         * context. This depends on whether the quic context requires cnx_id or not.
-         */
-         uint8_t cnxid_length = (receiving == 0 && *pcnx != NULL) ? (*pcnx)->path[0]->remote_cnxid.id_len : local_ctx_length;
-         ph->pc = picoquic_packet_context_application;
-
-         if ((int)length >= 1 + cnxid_length) {
-             /* We can identify the connection by its ID */
-             ph->offset = (uint32_t)( 1 + picoquic_parse_connection_id(bytes + 1, cnxid_length, &ph->dest_cnx_id));
-             /* TODO: should consider using combination of CNX ID and ADDR_FROM */
-             if (*pcnx == NULL && quic != NULL) {
-                 if (local_ctx_length > 0) {
-                     *pcnx = picoquic_cnx_by_id(quic, ph->dest_cnx_id);
-                 }
-                 else {
-                     *pcnx = picoquic_cnx_by_net(quic, addr_from);
-                 }
-             }
-         } else {
-             ph->ptype = picoquic_packet_error;
-             ph->offset = length;
-             ph->payload_length = 0;
-             return ret;
-         }
-
-         if (*pcnx != NULL) {
-             ph->epoch = 3;
-             ph->version_index = (*pcnx)->version_index;
-             /* If the connection is identified, decode the short header per version ID */
-             switch (picoquic_supported_versions[ph->version_index].version_header_encoding) {
-             case picoquic_version_header_27:
-                 ph->has_spin_bit = 1;
-                 ph->ptype = picoquic_packet_1rtt_protected_phi0;
-                 ph->spin = (bytes[0] >> 5) & 1;
-                 ph->pn_offset = ph->offset;
-                 ph->pn = 0;
-                 ph->pnmask = 0;
-                 break;
-             }
-
-             if (length < ph->offset) {
-                 ret = -1;
-                 ph->payload_length = 0;
-             } else {
-                 ph->payload_length = (uint16_t)(length - ph->offset);
-             }
-         } else {
-             /* This may be a packet to a forgotten connection */
-             ph->payload_length = (uint16_t)((length > ph->offset)?length - ph->offset:0);
-         }
+        ret = picoquic_parse_short_packet_header(quic, bytes, length, addr_from, ph, pcnx, receiving);
     }
 
     return ret;
 }
 
-/* The packet number logic */
+/* The packet number logic, without branches since the packets on both sides
+ * of the expected number are equally likely */
 uint64_t picoquic_get_packet_number64(uint64_t highest, uint64_t mask, uint32_t pn)
 {
     uint64_t expected = highest + 1;
     uint64_t not_mask_plus_one = (~mask) + 1;
     uint64_t pn64 = (expected & mask) | pn;
-
-    if (pn64 < expected) {
-        uint64_t delta1 = expected - pn64;
-        uint64_t delta2 = not_mask_plus_one - delta1;
-        if (delta2 < delta1) {
-            pn64 += not_mask_plus_one;
-        }
-    } else {
-        uint64_t delta1 = pn64 - expected;
-        uint64_t delta2 = not_mask_plus_one - delta1;
-
-        if (delta2 <= delta1 && (pn64 & mask) > 0) {
-            /* Out of sequence packet from previous roll */
-            pn64 -= not_mask_plus_one;
-        }
-    }
-
-    return pn64;
+    /* All ones if the number is before the expected one, zero otherwise */
+    uint64_t before = (uint64_t)0 - (uint64_t)(pn64 < expected);
+    uint64_t delta1 = ((expected - pn64) & before) | ((pn64 - expected) & ~before);
+    uint64_t delta2 = not_mask_plus_one - delta1;
+    /* Closer in the next roll, or out of sequence packet from previous roll */
+    uint64_t next_roll = before & ((uint64_t)0 - (uint64_t)(delta2 < delta1));
+    uint64_t previous_roll = ~before & ((uint64_t)0 - (uint64_t)((delta2 <= delta1) & ((pn64 & mask) != 0)));
+
+    return pn64 + (not_mask_plus_one & next_roll) - (not_mask_plus_one & previous_roll);
 }
 
 /*
  * Decrypt the incoming packet.
  * Apply packet number decryption. This may require updating the
- * sequence number and the offset
+ * sequence number and the offset. The header protection mask is
+ * computed here, unless it was already computed as hp_mask.
  */
 size_t  picoquic_decrypt_packet(picoquic_cnx_t* cnx,
     uint8_t* bytes, size_t packet_length, picoquic_packet_header* ph,
-    void * hp_enc, void* aead_context, int * already_received, picoquic_path_t* path_from)
+    void * hp_enc, void* aead_context, int * already_received, picoquic_path_t* path_from,
+    const uint8_t* hp_mask)
 {
     size_t decoded;
     size_t length = ph->offset + ph->payload_length; /* this may change after decrypting the PN */
@@ -361,24 +376,27 @@ size_t  picoquic_decrypt_packet(picoquic_cnx_t* cnx,
             uint8_t first_byte = bytes[0];
             uint8_t first_mask = ((first_byte & 0x80) == 0x80) ? 0x0F : 0x1F;
             uint8_t pn_l;
-            uint32_t pn_val = 0;
+            uint32_t pn_shift;
+            uint32_t pn_val;
 
-            picoquic_hp_encrypt(hp_enc, bytes + sample_offset, mask, mask, sizeof(mask));
+            if (hp_mask == NULL) {
+                picoquic_hp_encrypt(hp_enc, bytes + sample_offset, mask, mask, sizeof(mask));
+                hp_mask = mask;
+            }
             /* Decode the first byte */
-            first_byte ^= (mask[0] & first_mask);
+            first_byte ^= (hp_mask[0] & first_mask);
             pn_l = (first_byte & 3) + 1;
-            ph->pnmask = (0xFFFFFFFFFFFFFFFFull);
             bytes[0] = first_byte;
 
-            /* Packet encoding is 1 to 4 bytes */
-            for (uint8_t i = 1; i <= pn_l; i++) {
-                pn_val <<= 8;
-                bytes[ph->offset] ^= mask[i];
-                pn_val += bytes[ph->offset++];
-                ph->pnmask <<= 8;
-            }
+            /* Packet encoding is 1 to 4 bytes. The 4 bytes before the sample are unmasked
+             * at once, with the mask cut to the length of the packet number. */
+            pn_shift = 8 * (4 - pn_l);
+            pn_val = PICOPARSE_32(bytes + ph->offset) ^ ((PICOPARSE_32(hp_mask + 1) >> pn_shift) << pn_shift);
+            picoformat_32(bytes + ph->offset, pn_val);
+            ph->offset += pn_l;
 
-            ph->pn = pn_val;
+            ph->pn = pn_val >> pn_shift;
+            ph->pnmask = 0xFFFFFFFFFFFFFFFFull << (8 * pn_l);
             ph->payload_length -= pn_l;
             /* Only set the key phase byte if short header */
             if (ph->ptype == picoquic_packet_1rtt_protected_phi0) {
@@ -462,7 +480,8 @@ int picoquic_parse_header_and_decrypt(
     picoquic_packet_header* ph,
     picoquic_cnx_t** pcnx,
     uint32_t * consumed,
-    int * new_context_created)
+    int * new_context_created,
+    const picoquic_hp_mask_t* hp_mask)
 {
     /* Parse the clear text header. Ret == 0 means an incorrect packet that could not be parsed */
     int already_received = 0;
@@ -474,6 +493,10 @@ int picoquic_parse_header_and_decrypt(
         length = ph->offset + ph->payload_length;
         *consumed = length;
 
+        if (*pcnx != NULL && (*pcnx)->tls_pending && picoquic_tls_async_poll(*pcnx, current_time) != 0) {
+            /* The connection waits for the TLS pool, its keys are not ready yet */
+            return PICOQUIC_ERROR_TLS_PARKED;
+        }
 
         if (ph->ptype == picoquic_packet_initial) {
             if ((*pcnx == NULL || !(*pcnx)->client_mode)) {
@@ -502,7 +525,7 @@ int picoquic_parse_header_and_decrypt(
             case picoquic_packet_initial:
                 decoded_length = picoquic_decrypt_packet(*pcnx, bytes, packet_length, ph,
                     (*pcnx)->crypto_context[0].hp_dec,
-                    (*pcnx)->crypto_context[0].aead_decrypt, &already_received, path_from);
+                    (*pcnx)->crypto_context[0].aead_decrypt, &already_received, path_from, NULL);
                 length = ph->offset + ph->payload_length;
                 *consumed = length;
                 break;
@@ -516,20 +539,21 @@ int picoquic_parse_header_and_decrypt(
             case picoquic_packet_handshake:
                 decoded_length = picoquic_decrypt_packet(*pcnx, bytes, length, ph,
                     (*pcnx)->crypto_context[2].hp_dec,
-                    (*pcnx)->crypto_context[2].aead_decrypt, &already_received, path_from);
+                    (*pcnx)->crypto_context[2].aead_decrypt, &already_received, path_from, NULL);
                 break;
             case picoquic_packet_0rtt_protected:
                 decoded_length = picoquic_decrypt_packet(*pcnx, bytes, length, ph,
                     (*pcnx)->crypto_context[1].hp_dec,
-                    (*pcnx)->crypto_context[1].aead_decrypt, &already_received, path_from);
+                    (*pcnx)->crypto_context[1].aead_decrypt, &already_received, path_from, NULL);
                 break;
             case picoquic_packet_1rtt_protected_phi0:
             case picoquic_packet_1rtt_protected_phi1:
                 /* TODO : roll key based on PHI */
-                /* AEAD Decrypt, in place */
+                /* AEAD Decrypt, in place. The mask computed ahead is only used if the keys did not change since */
                 decoded_length = picoquic_decrypt_packet(*pcnx, bytes, length, ph,
                     (*pcnx)->crypto_context[3].hp_dec,
-                    (*pcnx)->crypto_context[3].aead_decrypt, &already_received, path_from);
+                    (*pcnx)->crypto_context[3].aead_decrypt, &already_received, path_from,
+                    (hp_mask != NULL && hp_mask->hp_ecb == (*pcnx)->crypto_context[3].hp_dec_ecb) ? hp_mask->mask : NULL);
                 break;
             default:
                 /* Packet type error. Log and ignore */
@@ -622,7 +646,7 @@ int picoquic_prepare_version_negotiation(
     picoquic_packet_header* ph)
 {
     int ret = -1;
-    picoquic_stateless_packet_t* sp = picoquic_create_stateless_packet(quic);
+    picoquic_stateless_packet_t* sp = picoquic_create_stateless_packet(quic, addr_from);
 
     if (sp != NULL) {
         uint8_t* bytes = sp->bytes;
@@ -680,7 +704,7 @@ void picoquic_process_unexpected_cnxid(
     if (length > PICOQUIC_RESET_PACKET_MIN_SIZE &&
         (ph->ptype == picoquic_packet_1rtt_protected_phi0 ||
             ph->ptype == picoquic_packet_1rtt_protected_phi1)) {
-        picoquic_stateless_packet_t* sp = picoquic_create_stateless_packet(quic);
+        picoquic_stateless_packet_t* sp = picoquic_create_stateless_packet(quic, addr_from);
         if (sp != NULL) {
             uint32_t pad_size = length - 17;
             uint8_t* bytes = sp->bytes;
@@ -725,7 +749,7 @@ void picoquic_queue_stateless_retry(picoquic_cnx_t* cnx,
     uint8_t * token,
     size_t token_length)
 {
-    picoquic_stateless_packet_t* sp = picoquic_create_stateless_packet(cnx->quic);
+    picoquic_stateless_packet_t* sp = picoquic_create_stateless_packet(cnx->quic, addr_from);
     size_t checksum_length = picoquic_get_checksum_length(cnx, 1);
 
     if (sp != NULL) {
@@ -1246,16 +1270,25 @@ int picoquic_incoming_segment(
     int if_index_to,
     uint64_t current_time,
     picoquic_connection_id_t * previous_dest_id,
-    int *new_context_created)
+    int *new_context_created,
+    const picoquic_hp_mask_t* hp_mask)
 {
     int ret = 0;
     picoquic_cnx_t* cnx = NULL;
     picoquic_packet_header ph;
     *new_context_created = 0;
 
+    PICOQUIC_PROBE3(segment_entry, quic, length, current_time);
+
     /* Parse the header and decrypt the packet */
     ret = picoquic_parse_header_and_decrypt(quic, bytes, length, packet_length, addr_from,
-        current_time, &ph, &cnx, consumed, new_context_created);
+        current_time, &ph, &cnx, consumed, new_context_created, hp_mask);
+
+    if (ret == PICOQUIC_ERROR_TLS_PARKED) {
+        /* The rest of the datagram is replayed once the TLS job of the connection is done */
+        (void)picoquic_tls_async_queue_datagram(cnx, bytes, length, addr_from, addr_to, if_index_to);
+        *consumed = length;
+    }
 
     if (*new_context_created) {
         /* We first insert all locally asked plugins */
@@ -1287,8 +1320,13 @@ int picoquic_incoming_segment(
         */
     }
 
-    /* Log the incoming packet */
-    picoquic_log_decrypted_segment(quic->F_log, 1, cnx, 1, &ph, bytes, (uint32_t)*consumed, ret);
+    /* Log the incoming packet, the kept ones are logged when replayed */
+    if (ret != PICOQUIC_ERROR_TLS_PARKED) {
+        picoquic_log_decrypted_segment(quic->F_log, 1, cnx, 1, &ph, bytes, (uint32_t)*consumed, ret);
+        if (quic->binlog != NULL) {
+            picoquic_binlog_segment(quic->binlog, cnx, 1, &ph, bytes, *consumed, ret);
+        }
+    }
 
     if (ret == 0) {
         if (cnx == NULL) {
@@ -1405,6 +1443,7 @@ int picoquic_incoming_segment(
             ret = picoquic_record_pn_received(cnx, path_x, ph.pc, ph.pn64, current_time);
         }
         if (cnx != NULL) {
+            cnx->latest_activity_time = current_time;
             picoquic_cnx_set_next_wake_time(cnx, current_time, 1);
         }
     } else if (ret == PICOQUIC_ERROR_DUPLICATE) {
@@ -1427,6 +1466,9 @@ int picoquic_incoming_segment(
             (cnx == NULL) ? -1 : cnx->client_mode, ph.ptype, ph.epoch, ph.pc, (int)ph.pn,
             length, ret);
         ret = -1;
+    } else if (ret == PICOQUIC_ERROR_TLS_PARKED) {
+        /* Kept, the rest of the datagram is not processed now */
+        ret = -1;
     } else if (ret == 1) {
         /* wonder what happened ! */
         DBG_PRINTF("Packet (%d) get ret=1, t: %d, e: %d, pc: %d, pn: %d, l: %d\n",
@@ -1441,10 +1483,13 @@ int picoquic_incoming_segment(
     if (cnx != NULL) LOG {
         POP_LOG_CTX(cnx);
     }
+
+    PICOQUIC_PROBE6(segment_exit, quic, cnx, ph.ptype, ph.pn64, *consumed, ret);
+
     return ret;
 }
 
-int picoquic_incoming_packet(
+static int picoquic_incoming_datagram(
     picoquic_quic_t* quic,
     uint8_t* bytes,
     uint32_t length,
@@ -1452,7 +1497,8 @@ int picoquic_incoming_packet(
     struct sockaddr* addr_to,
     int if_index_to,
     uint64_t current_time,
-    int* new_context_created)
+    int* new_context_created,
+    const picoquic_hp_mask_t* hp_mask)
 {
     uint32_t consumed_index = 0;
     int ret = 0;
@@ -1462,9 +1508,11 @@ int picoquic_incoming_packet(
     while (consumed_index < length) {
         uint32_t consumed = 0;
 
+        /* A short header packet is the only one of its datagram, the mask computed ahead is for the first */
         ret = picoquic_incoming_segment(quic, bytes + consumed_index,
             length - consumed_index, length,
-            &consumed, addr_from, addr_to, if_index_to, current_time, &previous_destid, new_context_created);
+            &consumed, addr_from, addr_to, if_index_to, current_time, &previous_destid, new_context_created,
+            (consumed_index == 0) ? hp_mask : NULL);
 
         if (ret == 0) {
             consumed_index += consumed;
@@ -1474,9 +1522,100 @@ int picoquic_incoming_packet(
         }
     }
 
+    if (quic->tls_pool != NULL) {
+        /* The client hellos of this datagram start together */
+        picoquic_tls_pool_submit(quic->tls_pool);
+    }
+
     return ret;
 }
 
+int picoquic_incoming_packet(
+    picoquic_quic_t* quic,
+    uint8_t* bytes,
+    uint32_t length,
+    struct sockaddr* addr_from,
+    struct sockaddr* addr_to,
+    int if_index_to,
+    uint64_t current_time,
+    int* new_context_created)
+{
+    return picoquic_incoming_datagram(quic, bytes, length, addr_from, addr_to, if_index_to,
+        current_time, new_context_created, NULL);
+}
+
+/* Returns the context computing the mask of a short header packet to an established connection, NULL if none */
+static void* picoquic_incoming_hp_ecb(picoquic_quic_t* quic, const picoquic_received_datagram_t* datagram)
+{
+    picoquic_connection_id_t cnx_id;
+    picoquic_cnx_t* cnx;
+    uint32_t sample_offset = 1 + quic->local_ctx_length + 4;
+
+    if ((datagram->bytes[0] & 0xC0) != 0x40 || quic->local_ctx_length == 0 ||
+        datagram->length < sample_offset + PICOQUIC_HP_SAMPLE_SIZE) {
+        return NULL;
+    }
+
+    (void)picoquic_parse_connection_id(datagram->bytes + 1, quic->local_ctx_length, &cnx_id);
+    cnx = picoquic_cnx_by_id_cached(quic, &cnx_id);
+    if (cnx == NULL || cnx->tls_pending || cnx->cnx_state < picoquic_state_client_ready ||
+        cnx->cnx_state >= picoquic_state_disconnected) {
+        return NULL;
+    }
+
+    return cnx->crypto_context[3].hp_dec_ecb;
+}
+
+int picoquic_incoming_packets(
+    picoquic_quic_t* quic,
+    picoquic_received_datagram_t* datagrams,
+    size_t nb_datagrams,
+    uint64_t current_time)
+{
+    uint8_t samples[PICOQUIC_INCOMING_BATCH_MAX][PICOQUIC_HP_SAMPLE_SIZE];
+    uint8_t masks[PICOQUIC_INCOMING_BATCH_MAX][PICOQUIC_HP_SAMPLE_SIZE];
+    void* hp_ecb[PICOQUIC_INCOMING_BATCH_MAX];
+    uint32_t sample_offset = 1 + quic->local_ctx_length + 4;
+
+    for (size_t first = 0; first < nb_datagrams; first += PICOQUIC_INCOMING_BATCH_MAX) {
+        size_t nb_batch = nb_datagrams - first;
+
+        if (nb_batch > PICOQUIC_INCOMING_BATCH_MAX) {
+            nb_batch = PICOQUIC_INCOMING_BATCH_MAX;
+        }
+
+        for (size_t i = 0; i < nb_batch; i++) {
+            hp_ecb[i] = picoquic_incoming_hp_ecb(quic, &datagrams[first + i]);
+            if (hp_ecb[i] != NULL) {
+                memcpy(samples[i], datagrams[first + i].bytes + sample_offset, PICOQUIC_HP_SAMPLE_SIZE);
+            }
+        }
+
+        /* One call computes the masks of each run of datagrams for the same connection */
+        for (size_t i = 0, next = 0; i < nb_batch; i = next) {
+            for (next = i + 1; next < nb_batch && hp_ecb[next] == hp_ecb[i]; next++);
+
+            if (hp_ecb[i] != NULL && picoquic_hp_mask_batch(hp_ecb[i], samples[i], masks[i], next - i) != 0) {
+                for (size_t j = i; j < next; j++) {
+                    hp_ecb[j] = NULL;
+                }
+            }
+        }
+
+        for (size_t i = 0; i < nb_batch; i++) {
+            picoquic_received_datagram_t* datagram = &datagrams[first + i];
+            picoquic_hp_mask_t hp_mask = { hp_ecb[i], masks[i] };
+
+            datagram->new_context_created = 0;
+            (void)picoquic_incoming_datagram(quic, datagram->bytes, datagram->length, datagram->addr_from,
+                datagram->addr_to, datagram->if_index_to, current_time, &datagram->new_context_created,
+                (hp_ecb[i] != NULL) ? &hp_mask : NULL);
+        }
+    }
+
+    return 0;
+}
+
 void packet_register_noparam_protoops(picoquic_cnx_t *cnx)
 {
     register_noparam_protoop(cnx, &PROTOOP_NOPARAM_INCOMING_ENCRYPTED, &incoming_encrypted);
@@ -27,6 +27,9 @@
 #include <inttypes.h>
 #include "protoop.h"
 #include "queue.h"
+#include "huge_memory.h"
+#include "log_writer.h"
+#include "tls_pool.h"
 #ifdef _WINDOWS
 #include <WS2tcpip.h>
 #include <Ws2def.h>
@@ -78,6 +81,7 @@ extern "C" {
 #define PICOQUIC_ERROR_STATELESS_RESET (PICOQUIC_ERROR_CLASS + 30)
 #define PICOQUIC_ERROR_CONNECTION_DELETED (PICOQUIC_ERROR_CLASS + 31)
 #define PICOQUIC_ERROR_CNXID_SEGMENT (PICOQUIC_ERROR_CLASS + 32)
+#define PICOQUIC_ERROR_TLS_PARKED (PICOQUIC_ERROR_CLASS + 33)
 #define PICOQUIC_ERROR_PROTOCOL_OPERATION_TOO_MANY_ARGUMENTS (PICOQUIC_ERROR_CLASS + 40)
 #define PICOQUIC_ERROR_PROTOCOL_OPERATION_UNEXEPECTED_ARGC (PICOQUIC_ERROR_CLASS + 41)
 #define PICOQUIC_ERROR_INVALID_PLUGIN_STREAM_ID (PICOQUIC_ERROR_CLASS + 42)
@@ -146,8 +150,10 @@ typedef enum {
     picoquic_frame_type_connection_close = 0x1c, // TODO merge
     picoquic_frame_type_application_close = 0x1d, // TODO merge
     picoquic_frame_type_handshake_done = 0x1e,
+    picoquic_frame_type_immediate_ack = 0x1f,
     picoquic_frame_type_plugin_validate = 0x30,
-    picoquic_frame_type_plugin = 0x31
+    picoquic_frame_type_plugin = 0x31,
+    picoquic_frame_type_ack_frequency = 0xaf
 } picoquic_frame_type_enum_t;
 
 /*
@@ -205,6 +211,7 @@ int picoquic_is_handshake_error(uint64_t error_code);
 
 typedef struct st_picoquic_stateless_packet_t {
     struct st_picoquic_stateless_packet_t* next_packet;
+    void* pool; /* Owning slot pool, or NULL if the packet was allocated on its own */
     struct sockaddr_storage addr_to;
     struct sockaddr_storage addr_local;
     unsigned long if_index_local;
@@ -244,7 +251,18 @@ typedef enum {
 } picoquic_packet_context_enum;
 
 typedef struct protoop_plugin protoop_plugin_t;
-typedef struct st_plugin_struct_metadata plugin_struct_metadata_t;
+
+#define STRUCT_METADATA_MAX 10
+#define STRUCT_METADATA_INLINE_SLOTS 2
+
+/* Metadata attached by the plugins to a packet, a path or a connection, indexed by the metadata slot
+ * of the plugin. The first slots are part of the structure. The others are in a block allocated when
+ * one of their plugins first sets a value, and grown up to the highest metadata slot used. */
+typedef struct st_plugin_struct_metadata {
+    uint64_t inline_slots[STRUCT_METADATA_INLINE_SLOTS][STRUCT_METADATA_MAX];
+    uint8_t nb_extra_slots;
+    uint64_t (*extra_slots)[STRUCT_METADATA_MAX]; /* From the slot STRUCT_METADATA_INLINE_SLOTS */
+} plugin_struct_metadata_t;
 
 /* This structure is used for sending booking purposes */
 typedef struct reserve_frame_slot {
@@ -306,7 +324,9 @@ typedef struct st_picoquic_packet_t {
 
     picoquic_packet_plugin_frame_t *plugin_frames; /* Track plugin bytes */
 
-    plugin_struct_metadata_t *metadata;
+    plugin_struct_metadata_t metadata;
+
+    struct st_picoquic_huge_memory_t *huge_memory; /* Pool of the packet, NULL if allocated with malloc */
 
     uint8_t bytes[PICOQUIC_MAX_PACKET_SIZE];
 } picoquic_packet_t;
@@ -464,6 +484,15 @@ typedef struct new_token_frame {
 
 typedef uint8_t hanshake_done_frame_t;
 
+typedef struct ack_frequency_frame {
+    uint64_t sequence_number;
+    uint64_t ack_eliciting_threshold;
+    uint64_t request_max_ack_delay;
+    uint64_t reordering_threshold;
+} ack_frequency_frame_t;
+
+typedef uint8_t immediate_ack_frame_t;
+
 typedef struct plugin_validate_frame {
     uint64_t pid_id;
     uint64_t pid_len;
@@ -504,6 +533,7 @@ typedef struct plugin_stat {
     param_id_t param;
     uint64_t count;
     uint64_t total_execution_time;
+    bool lowered; /* The pluglet runs natively, without the VM */
 } plugin_stat_t;
 #define PICOQUIC_STREAM_ID_TYPE_MASK 3
 #define PICOQUIC_STREAM_ID_CLIENT_INITIATED 0
@@ -708,8 +738,76 @@ int picoquic_queue_misc_frame(picoquic_cnx_t* cnx, const uint8_t* bytes, size_t
 /* Send and receive network packets */
 
 picoquic_stateless_packet_t* picoquic_dequeue_stateless_packet(picoquic_quic_t* quic);
+size_t picoquic_dequeue_stateless_packets(picoquic_quic_t* quic, picoquic_stateless_packet_t** sp, size_t sp_max);
 void picoquic_delete_stateless_packet(picoquic_stateless_packet_t* sp);
 
+/* Stateless packets are served from a fixed pool of slots. When the pool is
+ * exhausted, or when a source prefix exceeds its budget, the packet is dropped
+ * and counted. Setting the burst to zero disables the per prefix rate limit.
+ * Packets dequeued but not yet deleted remain valid after picoquic_free; the
+ * pool is released when the last of them is deleted. */
+void picoquic_set_stateless_rate_limit(picoquic_quic_t* quic, uint32_t burst, uint32_t packets_per_second);
+uint64_t picoquic_get_stateless_queued(picoquic_quic_t* quic);
+uint64_t picoquic_get_stateless_dropped_overflow(picoquic_quic_t* quic);
+uint64_t picoquic_get_stateless_dropped_rate_limited(picoquic_quic_t* quic);
+
+/* Metric records pushed by the plugins are batched and sent to a single
+ * destination, see metrics_exporter.h for the accepted formats. Unless set,
+ * the first record opens PICOQUIC_METRICS_DEFAULT_DESTINATION. Setting a NULL
+ * destination disables the export. */
+int picoquic_set_metrics_exporter(picoquic_quic_t* quic, const char* destination);
+int picoquic_export_metrics(picoquic_cnx_t* cnx, uint16_t type, const uint8_t* data, size_t length);
+
+/* Serves the plugin memories and the packets from huge pages, see huge_memory.h.
+ * It can only be changed while no plugin nor packet is allocated, i.e. before the
+ * first connection is created. The statistics are NULL when it is disabled. */
+int picoquic_set_huge_memory(picoquic_quic_t* quic, int enable);
+const picoquic_huge_memory_stats_t* picoquic_get_huge_memory_stats(picoquic_quic_t* quic);
+
+/* Writes the text log to F_sink from a background thread, see log_writer.h.
+ * The log FILE of the context is replaced by the producer side of the writer.
+ * Setting a NULL sink stops the writer and disables the log. The statistics
+ * return -1 when no writer is set. */
+int picoquic_set_async_log(picoquic_quic_t* quic, FILE* F_sink, picoquic_log_overload_enum overload, uint32_t sample_rate);
+int picoquic_get_async_log_stats(picoquic_quic_t* quic, picoquic_log_writer_stats_t* stats);
+
+/* Runs the processing of the client hellos received by a server in nb_threads
+ * worker threads, see tls_pool.h. 0 stops the pool, which fails with -1 while
+ * connections wait for it. */
+int picoquic_set_async_handshake(picoquic_quic_t* quic, int nb_threads);
+/* Returns a descriptor readable when a handshake is done, or -1 */
+int picoquic_get_async_handshake_fd(picoquic_quic_t* quic);
+int picoquic_get_async_handshake_stats(picoquic_quic_t* quic, picoquic_tls_pool_stats_t* stats);
+
+/* Connections without traffic for delay microseconds hibernate: their protocol
+ * operations and the structures that can be rebuilt are released, and rebuilt
+ * on the next packet or call to the connection. The connections with plugins
+ * keep their protocol operations, and the memory of the plugins which do not
+ * save their state when they hibernate, see plugin.h. 0, the default, disables it. */
+void picoquic_set_hibernation_delay(picoquic_quic_t* quic, uint64_t delay);
+int picoquic_is_hibernated(picoquic_cnx_t* cnx);
+int picoquic_get_nb_hibernated(picoquic_quic_t* quic);
+
+/* The source symbol of a packet protected by FEC is its payload without the ACK,
+ * padding and handshake crypto frames. The payload is described as runs of
+ * consecutive frames to keep, as offsets from its start. The padding and STREAM
+ * frames are skipped natively, the other frames go through the skip_frame
+ * protocol operation. Returns the number of runs, or -1 if the payload is
+ * malformed or needs more than max_runs runs. */
+#define PICOQUIC_SYMBOL_RUNS_MAX 32
+
+typedef struct st_picoquic_symbol_run_t {
+    uint16_t offset;
+    uint16_t length;
+} picoquic_symbol_run_t;
+
+int picoquic_source_symbol_runs(picoquic_cnx_t* cnx, uint8_t* bytes, size_t bytes_max,
+    picoquic_symbol_run_t* runs, int max_runs);
+/* Copies the runs of the payload in symbol. Returns the number of bytes copied,
+ * 0 if the payload cannot be described or if symbol_max is too small. */
+size_t picoquic_source_symbol_gather(picoquic_cnx_t* cnx, uint8_t* bytes, size_t bytes_max,
+    uint8_t* symbol, size_t symbol_max);
+
 int picoquic_incoming_packet(
     picoquic_quic_t* quic,
     uint8_t* bytes,
@@ -720,6 +818,27 @@ int picoquic_incoming_packet(
     uint64_t current_time,
     int* new_context_created);
 
+/* A datagram received with others, for instance with recvmmsg */
+typedef struct st_picoquic_received_datagram_t {
+    uint8_t* bytes;
+    uint32_t length;
+    struct sockaddr* addr_from;
+    struct sockaddr* addr_to;
+    int if_index_to;
+    int new_context_created; /* Set on return */
+} picoquic_received_datagram_t;
+
+#define PICOQUIC_INCOMING_BATCH_MAX 32
+
+/* Same as picoquic_incoming_packet on each datagram in order. The header protection of the
+ * short header packets is removed in batches, one cipher call for each run of datagrams
+ * to the same connection. */
+int picoquic_incoming_packets(
+    picoquic_quic_t* quic,
+    picoquic_received_datagram_t* datagrams,
+    size_t nb_datagrams,
+    uint64_t current_time);
+
 picoquic_packet_t* picoquic_create_packet(picoquic_cnx_t *cnx);
 
 void picoquic_destroy_packet(picoquic_packet_t *p);
@@ -849,6 +968,10 @@ picoquic_stream_head* picoquic_find_or_create_plugin_stream(picoquic_cnx_t* cnx,
 
 /* Utilities */
 int picoquic_getaddrs(struct sockaddr_storage *sas, uint32_t *if_indexes, int sas_length);
+/* Replaces the addresses of the host interfaces as seen by the plugins of a
+ * context, e.g. for simulations. A NULL or empty list restores the host ones. */
+int picoquic_set_local_addresses(picoquic_quic_t* quic, const struct sockaddr_storage* sas, const uint32_t* if_indexes, int nb_addrs);
+int picoquic_get_local_addresses(picoquic_cnx_t* cnx, struct sockaddr_storage* sas, uint32_t* if_indexes, int sas_length);
 int picoquic_compare_connection_id(picoquic_connection_id_t * cnx_id1, picoquic_connection_id_t * cnx_id2);
 uint8_t* picoquic_frames_varint_decode(uint8_t* bytes, const uint8_t* bytes_max, uint64_t* n64);
 
@@ -25,6 +25,9 @@
 #define PICOQUIC_INTERNAL_H
 
 #include "picohash.h"
+#include "cidtable.h"
+#include "binlog.h"
+#include "metrics_exporter.h"
 #include "picoquic.h"
 #include "picotlsapi.h"
 #include "util.h"
@@ -76,7 +79,12 @@ extern "C" {
 #define PICOQUIC_INITIAL_RETRANSMIT_TIMER 1000000 /* one second */
 #define PICOQUIC_MIN_RETRANSMIT_TIMER 50000 /* 50 ms */
 #define PICOQUIC_ACK_DELAY_MAX 25000 /* 25 ms */
+#define PICOQUIC_ACK_FREQUENCY_MIN_DELAY 1000 /* 1 ms, value to set in the min_ack_delay TP to enable ACK frequency */
+#define PICOQUIC_ACK_FREQUENCY_PER_RTT 4 /* Number of ACKs requested per RTT */
+#define PICOQUIC_ACK_FREQUENCY_THRESHOLD_MAX 32
+#define PICOQUIC_RETRANSMIT_INDEX_MIN_SIZE 256
 #define PICOQUIC_RACK_DELAY 10000 /* 10 ms */
+#define PICOQUIC_REORDER_WINDOW_DECAY 16 /* Losses without reordering before the reorder window is halved */
 
 #define PICOQUIC_BANDWIDTH_ESTIMATE_MAX 10000000000ull /* 10 GB per second */
 #define PICOQUIC_BANDWIDTH_TIME_INTERVAL_MIN 1000
@@ -159,6 +167,35 @@ int picoquic_load_tickets(picoquic_stored_ticket_t** pp_first_ticket,
 void picoquic_free_tickets(picoquic_stored_ticket_t** pp_first_ticket);
 
 
+/*
+ * Pool of stateless packet slots. The slots are allocated once, on the first
+ * stateless packet, and recycled through a free list. Pending packets are
+ * kept in a FIFO with a tail pointer, so queuing is O(1) even under floods.
+ * Each source prefix (/24 for IPv4, /48 for IPv6) is hashed into a bin with
+ * its own token bucket.
+ */
+#define PICOQUIC_STATELESS_POOL_SIZE 128
+#define PICOQUIC_STATELESS_RATE_BINS 256
+#define PICOQUIC_STATELESS_RATE_BURST 64
+#define PICOQUIC_STATELESS_RATE_PER_SECOND 1000
+
+typedef struct st_picoquic_stateless_rate_bin_t {
+    uint64_t last_refill_time;
+    uint32_t tokens;
+} picoquic_stateless_rate_bin_t;
+
+/*
+ * Slots still held by the application when the QUIC context is freed keep
+ * the pool alive; the last picoquic_delete_stateless_packet releases it.
+ */
+typedef struct st_picoquic_stateless_pool_t {
+    picoquic_stateless_packet_t* free_list;
+    uint32_t nb_in_use;
+    unsigned int is_orphan : 1;
+    picoquic_stateless_rate_bin_t rate_bins[PICOQUIC_STATELESS_RATE_BINS];
+    picoquic_stateless_packet_t slots[PICOQUIC_STATELESS_POOL_SIZE];
+} picoquic_stateless_pool_t;
+
 #define MAX_PLUGIN 64
 #define PROTOOPPLUGINNAME_MAX 100
 /**
@@ -214,6 +251,32 @@ typedef struct st_picoquic_quic_t {
     uint32_t flags;
 
     picoquic_stateless_packet_t* pending_stateless_packet;
+    picoquic_stateless_packet_t* pending_stateless_last;
+    picoquic_stateless_pool_t* stateless_pool;
+    uint32_t stateless_rate_burst;
+    uint32_t stateless_rate_per_second;
+    uint64_t nb_stateless_queued;
+    uint64_t nb_stateless_dropped_overflow;
+    uint64_t nb_stateless_dropped_rate_limited;
+
+    picoquic_metrics_exporter_t* metrics_exporter;
+    int metrics_export_disabled;
+
+    picoquic_huge_memory_t* huge_memory; /* NULL unless the huge page backing is enabled */
+
+    picoquic_binlog_t* binlog; /* NULL unless a binary trace is set */
+
+    picoquic_log_writer_t* log_writer; /* Owns F_log when the log is written asynchronously */
+
+    picoquic_tls_pool_t* tls_pool; /* NULL unless the handshakes run in a worker pool */
+    int nb_tls_parked; /* Connections waiting for the TLS pool */
+
+    uint64_t hibernation_delay; /* 0 unless the idle connections are hibernated */
+    int nb_hibernated;
+
+    struct sockaddr_storage* local_addrs;
+    uint32_t* local_addr_if_indexes;
+    int nb_local_addrs;
 
     picoquic_congestion_algorithm_t const* default_congestion_alg;
 
@@ -223,8 +286,11 @@ typedef struct st_picoquic_quic_t {
     struct st_picoquic_cnx_t* cnx_wake_first;
     struct st_picoquic_cnx_t* cnx_wake_last;
 
-    picohash_table* table_cnx_by_id;
+    picoquic_cid_table_t* table_cnx_by_id;
     picohash_table* table_cnx_by_net;
+    /* Last connection found by picoquic_cnx_by_id_cached, reset when it is deleted */
+    picoquic_connection_id_t last_cnx_id;
+    struct st_picoquic_cnx_t* last_cnx_by_id;
 
     cnx_id_cb_fn cnx_id_callback_fn;
     void* cnx_id_callback_ctx;
@@ -279,6 +345,7 @@ typedef enum {
     picoquic_tp_active_connection_id_limit = 0x0e, // TODO draft-27
     picoquic_tp_supported_plugins = 0x20,
     picoquic_tp_plugins_to_inject = 0x21,
+    picoquic_tp_min_ack_delay = 0x22,
 } picoquic_tp_enum;
 
 typedef struct st_picoquic_tp_preferred_address_t {
@@ -307,6 +374,7 @@ typedef struct st_picoquic_tp_t {
     uint64_t active_connection_id_limit;
     char* supported_plugins;
     char* plugins_to_inject;
+    uint64_t min_ack_delay; /* 0 when the ACK frequency extension is not supported */
 } picoquic_tp_t;
 
 /*
@@ -396,6 +464,7 @@ typedef struct st_picoquic_crypto_context_t {
     void* aead_decrypt;
     void* hp_enc; /* Used for PN encryption */
     void* hp_dec; /* Used for PN decryption */
+    void* hp_dec_ecb; /* Same key as hp_dec, computes the AES masks of several packets in one call */
 } picoquic_crypto_context_t;
 
 /* Per epoch sequence/packet context.
@@ -424,8 +493,27 @@ typedef struct st_picoquic_packet_context_t {
     picoquic_packet_t* retransmit_oldest;
     picoquic_packet_t* retransmitted_newest;
     picoquic_packet_t* retransmitted_oldest;
+    /* Packets of the retransmit queue, indexed by sequence number modulo retransmit_index_size.
+     * NULL if the index could not be allocated, the queue is then searched linearly. */
+    picoquic_packet_t** retransmit_index;
+    uint64_t retransmit_index_size; /* Power of 2, larger than the sequence number span of the queue */
+    uint64_t retransmit_index_retry; /* Packets to queue before trying again to build a missing index */
+
+    /* ACK frequency, as requested by the peer */
+    uint64_t ack_eliciting_threshold; /* Number of ack-eliciting packets that can be received before sending an ACK */
+    uint64_t nb_ack_eliciting_received; /* Ack-eliciting packets received since the last ACK */
+    uint64_t ack_frequency_sequence; /* Lowest sequence number of the next ACK_FREQUENCY frame to accept */
+    uint64_t ack_frequency_max_delay; /* 0 until an ACK_FREQUENCY frame is received */
+    uint64_t reordering_threshold;
+
+    /* Loss timer: earliest time at which a packet of the queue is lost, valid while armed */
+    uint64_t loss_time;
+    uint64_t reorder_window; /* Extra delay given to reordered packets, adapted to spurious retransmissions */
+    uint64_t nb_losses_since_reorder;
 
     unsigned int ack_needed : 1;
+    unsigned int immediate_ack_requested : 1;
+    unsigned int loss_timer_armed : 1;
 } picoquic_packet_context_t;
 
 /*
@@ -452,6 +540,13 @@ typedef struct st_picoquic_path_t {
     unsigned int challenge_response_to_send : 1;
     unsigned int ping_received : 1;
     unsigned int last_bw_estimate_path_limited : 1;
+    unsigned int immediate_ack_to_send : 1;
+
+    /* ACK frequency requested to the peer */
+    uint64_t ack_frequency_sequence_sent;
+    uint64_t ack_frequency_threshold_sent; /* 0 until an ACK_FREQUENCY frame is sent */
+    uint64_t ack_frequency_delay_sent;
+    uint64_t ack_frequency_time_sent;
 
     /* Time measurement */
     uint64_t max_ack_delay;
@@ -513,7 +608,7 @@ typedef struct st_picoquic_path_t {
     /* Sequence and retransmission state */
     picoquic_packet_context_t pkt_ctx[picoquic_nb_packet_context];
 
-    plugin_struct_metadata_t *metadata;
+    plugin_struct_metadata_t metadata;
 } picoquic_path_t;
 
 /* Typedef for plugins */
@@ -525,6 +620,7 @@ typedef char* plugin_id_t;
 typedef enum {
     plugin_memory_manager_fixed_blocks,
     plugin_memory_manager_dynamic,
+    plugin_memory_manager_slab,
 } plugin_memory_manager_type_t;
 
 typedef struct plugin_memory_manager {
@@ -553,6 +649,8 @@ typedef struct plugin_parameters {
     plugin_memory_manager_type_t plugin_memory_manager_type;
 } plugin_parameters_t;
 
+#define PLUGIN_RINGS_MAX 2
+
 typedef struct protoop_plugin {
     UT_hash_handle hh; /* Make the structure hashable */
     char name[PROTOOPPLUGINNAME_MAX];
@@ -561,18 +659,25 @@ typedef struct protoop_plugin {
     uint64_t bytes_in_flight; /* Number of bytes in flight due to generated frames */
     uint64_t bytes_total; /* Number of total bytes by generated frames, for monitoring */
     uint64_t frames_total; /* Number of total generated frames, for monitoring */
-    uint64_t hash;         /* Hash of the plugin name */
+    uint8_t metadata_slot; /* Index of the plugin metadata in the structures, assigned at insertion */
+    uint16_t nb_pluglets; /* Number of pluglets inserted by the plugin */
+    uint16_t nb_lowered; /* Number of them running natively, without the VM */
     plugin_parameters_t params;
+    struct st_spsc_ring_t *rings[PLUGIN_RINGS_MAX]; /* Message rings shared with the application, NULL until opened */
+    uint8_t *hibernation_state; /* Saved by the plugin while the connection hibernates, NULL otherwise */
+    uint32_t hibernation_state_length;
+    bool memory_released; /* The memory was returned to the system when the connection hibernated */
     /* With uBPF, we don't want the VM it corrupts the memory of another context.
      * Therefore, each plugin has its own memory space that should contain everything
      * needed for the given connection.
      */
     plugin_memory_manager_t memory_manager;
+    picoquic_huge_memory_t *huge_memory; /* Backing of this structure, NULL if allocated with calloc */
     char memory[PLUGIN_MEMORY]; /* Memory that can be used for malloc, free,... */
 } protoop_plugin_t;
 
 #define PROTOOPNAME_MAX 100
-#define STRUCT_METADATA_MAX 10
+#define PLUGIN_METADATA_SLOTS_MAX 32
 
 typedef protoop_arg_t (*protocol_operation)(picoquic_cnx_t *);
 
@@ -608,13 +713,6 @@ typedef struct st_protocol_operation_struct_t {
     UT_hash_handle hh; /* Make the structure hashable */
 } protocol_operation_struct_t;
 
-typedef struct st_plugin_struct_metadata {
-    uint64_t plugin_hash;   /* primary key (we will store the plugin hash inside, so we assume it won't collide) */
-    uint64_t metadata[STRUCT_METADATA_MAX];
-
-    UT_hash_handle hh; /* Make the structure hashable */
-} plugin_struct_metadata_t;
-
 /* Register functions */
 int register_noparam_protoop(picoquic_cnx_t* cnx, protoop_id_t *pid, protocol_operation op);
 int register_param_protoop(picoquic_cnx_t* cnx, protoop_id_t *pid, param_id_t param, protocol_operation op);
@@ -675,6 +773,7 @@ typedef struct st_picoquic_cnx_t {
     picoquic_state_enum cnx_state;
     picoquic_connection_id_t initial_cnxid;
     uint64_t start_time;
+    picoquic_binlog_buffer_t* binlog_buffer; /* Allocated on the first record of the binary trace */
     uint64_t application_error;
     uint64_t local_error;
     uint64_t remote_application_error;
@@ -685,6 +784,9 @@ typedef struct st_picoquic_cnx_t {
     unsigned int handshake_done : 1;
     unsigned int handshake_done_sent : 1;
     unsigned int handshake_done_acked : 1;
+    /* Set while the client hello is processed by the TLS pool. It is not part of
+     * the bit fields above, which the worker may write while the connection is parked. */
+    int tls_pending;
 
 
     /* Next time sending data is expected */
@@ -702,6 +804,7 @@ typedef struct st_picoquic_cnx_t {
 
     /* Liveness detection */
     uint64_t latest_progress_time; /* last local time at which the connection progressed */
+    uint64_t latest_activity_time; /* last local time at which a packet was received or sent */
 
     /* Statistics */
     uint32_t nb_path_challenge_sent;
@@ -758,6 +861,8 @@ typedef struct st_picoquic_cnx_t {
     /* Should we wake directly the stack due to a reserved frame? */
     uint8_t wake_now:1;
     uint8_t plugin_requested:1;
+    /* Idle, the structures that can be rebuilt are released until the next protocol operation */
+    uint8_t hibernated:1;
 
     /* List of plugins that should be requested on this connection */
     plugin_request_t pids_to_request;
@@ -770,7 +875,7 @@ typedef struct st_picoquic_cnx_t {
 
     protoop_plugin_t *plugins;
 
-    plugin_struct_metadata_t *metadata;
+    plugin_struct_metadata_t metadata;
 
     /* Due to uBPF constraints, all needed info must be contained in the context.
      * Furthermore, the arguments might have different types...
@@ -905,7 +1010,7 @@ static inline void protoop_save_outputs_helper(picoquic_cnx_t *cnx, unsigned int
 void picoquic_init_transport_parameters(picoquic_tp_t* tp, int client_mode);
 
 /* Handling of stateless packets */
-picoquic_stateless_packet_t* picoquic_create_stateless_packet(picoquic_quic_t* quic);
+picoquic_stateless_packet_t* picoquic_create_stateless_packet(picoquic_quic_t* quic, struct sockaddr* addr_peer);
 void picoquic_queue_stateless_packet(picoquic_quic_t* quic, picoquic_stateless_packet_t* sp);
 
 /* Registration of connection ID in server context */
@@ -913,8 +1018,18 @@ int picoquic_register_cnx_id(picoquic_quic_t* quic, picoquic_cnx_t* cnx, const p
 int picoquic_register_cnx_id_for_cnx(picoquic_cnx_t* cnx, const picoquic_connection_id_t* cnx_id);
 
 /* handling of retransmission queue */
+void picoquic_queue_for_retransmit(picoquic_cnx_t* cnx, picoquic_path_t * path_x, picoquic_packet_t* packet,
+    size_t length, uint64_t current_time);
 void picoquic_dequeue_retransmit_packet(picoquic_cnx_t* cnx, picoquic_packet_t* p, int should_free);
+picoquic_packet_t* picoquic_retransmit_index_get(picoquic_packet_context_t* pkt_ctx, uint64_t sequence_number);
+void picoquic_retransmit_index_free(picoquic_packet_context_t* pkt_ctx);
 void picoquic_dequeue_retransmitted_packet(picoquic_cnx_t* cnx, picoquic_packet_t* p);
+
+/* Loss timer */
+uint64_t picoquic_reorder_window(picoquic_path_t* path_x, picoquic_packet_context_enum pc);
+void picoquic_update_reorder_window(picoquic_path_t* path_x, picoquic_packet_context_enum pc, uint64_t reorder_delay);
+void picoquic_disarm_loss_timers(picoquic_path_t* path_x);
+uint64_t picoquic_get_loss_time(picoquic_cnx_t* cnx, picoquic_path_t* path_x, picoquic_packet_context_enum pc, uint64_t current_time);
 void picoquic_implicit_handshake_ack(picoquic_cnx_t* cnx, picoquic_path_t *path, picoquic_packet_context_enum pc, uint64_t current_time);
 
 /* Reset connection after receiving version negotiation */
@@ -935,6 +1050,7 @@ void picoquic_set_transport_parameters(picoquic_cnx_t * cnx, picoquic_tp_t * tp)
 
 /* Connection context retrieval functions */
 picoquic_cnx_t* picoquic_cnx_by_id(picoquic_quic_t* quic, picoquic_connection_id_t cnx_id);
+picoquic_cnx_t* picoquic_cnx_by_id_cached(picoquic_quic_t* quic, const picoquic_connection_id_t* cnx_id);
 picoquic_cnx_t* picoquic_cnx_by_net(picoquic_quic_t* quic, struct sockaddr* addr);
 
 /* Next time is used to order the list of available connections,
@@ -943,6 +1059,10 @@ void picoquic_reinsert_by_wake_time(picoquic_quic_t* quic, picoquic_cnx_t* cnx,
 
 void picoquic_cnx_set_next_wake_time(picoquic_cnx_t* cnx, uint64_t current_time, uint32_t last_pkt_length);
 
+/* Hibernation of the idle connections */
+void picoquic_hibernate_if_idle(picoquic_cnx_t* cnx, uint64_t current_time);
+void picoquic_wake_cnx(picoquic_cnx_t* cnx);
+
 void picoquic_create_random_cnx_id(picoquic_quic_t* quic, picoquic_connection_id_t * cnx_id, uint8_t id_length);
 void picoquic_create_random_cnx_id_for_cnx(picoquic_cnx_t* cnx, picoquic_connection_id_t *cnx_id, uint8_t id_length);
 
@@ -1037,10 +1157,16 @@ int picoquic_parse_ack_header(
 
 uint64_t picoquic_get_packet_number64(uint64_t highest, uint64_t mask, uint32_t pn);
 
+/* A header protection mask computed ahead, with the context used to compute it */
+typedef struct st_picoquic_hp_mask_t {
+    const void* hp_ecb;
+    const uint8_t* mask;
+} picoquic_hp_mask_t;
+
 size_t  picoquic_decrypt_packet(picoquic_cnx_t* cnx,
     uint8_t* bytes, size_t packet_length, picoquic_packet_header* ph,
     void * hp_enc, void* aead_context, int * already_received,
-    picoquic_path_t* path_from);
+    picoquic_path_t* path_from, const uint8_t* hp_mask);
 
 uint32_t picoquic_protect_packet(picoquic_cnx_t* cnx,
     picoquic_packet_type_enum ptype,
@@ -1067,7 +1193,8 @@ int picoquic_parse_header_and_decrypt(
     picoquic_packet_header* ph,
     picoquic_cnx_t** pcnx,
     uint32_t * consumed,
-    int * new_context_created);
+    int * new_context_created,
+    const picoquic_hp_mask_t* hp_mask);
 
 /* Handling of packet logging */
 void picoquic_log_decrypted_segment(void* F_log, int log_cnxid, picoquic_cnx_t* cnx,
@@ -1079,6 +1206,32 @@ void picoquic_log_outgoing_segment(void* F_log, int log_cnxid, picoquic_cnx_t* c
     uint32_t length,
     uint8_t* send_buffer, uint32_t send_length);
 
+/* Parts of the text log shared with the binary trace, see binlog.h */
+typedef struct st_picoquic_log_cc_state_t {
+    uint64_t cnx_id_64;
+    uint64_t delta_t; /* Since the start of the connection */
+    uint64_t cwin;
+    uint64_t bytes_in_transit;
+    uint64_t nb_retransmission_total;
+    uint64_t rtt_min;
+    uint64_t smoothed_rtt;
+    uint64_t rtt_variant;
+    uint64_t max_ack_delay;
+    uint64_t cnx_state;
+} picoquic_log_cc_state_t;
+
+uint64_t picoquic_log_segment_cnxid64(int log_cnxid, picoquic_cnx_t* cnx, picoquic_packet_header* ph, int ret);
+void picoquic_log_segment(FILE* F, uint64_t log_cnxid64, int receiving, picoquic_packet_header* ph,
+    uint8_t* bytes, size_t length, int ret);
+int picoquic_log_outgoing_header(picoquic_cnx_t* cnx, uint64_t sequence_number,
+    uint8_t* send_buffer, uint32_t send_length, picoquic_packet_header* ph);
+void picoquic_log_frames(FILE* F, uint64_t cnx_id64, uint8_t* bytes, size_t length);
+void picoquic_log_get_cc_state(picoquic_cnx_t* cnx, uint64_t current_time, picoquic_log_cc_state_t* cc_state);
+void picoquic_log_cc_state(FILE* F, picoquic_log_cc_state_t const* cc_state);
+void picoquic_log_transport_extension_values(FILE* F, int log_cnxid, uint64_t cnx_id_64,
+    char const* sni, char const* alpn, uint8_t* bytes, size_t bytes_max, int client_mode,
+    uint32_t initial_version, uint32_t final_version);
+
 void picoquic_log_packet_address(FILE* F, uint64_t log_cnxid64, picoquic_cnx_t* cnx,
     struct sockaddr* addr_peer, int receiving, size_t length, uint64_t current_time);
 
@@ -1143,6 +1296,8 @@ uint8_t* picoquic_decode_crypto_hs_frame(picoquic_cnx_t* cnx, uint8_t* bytes,
 int picoquic_prepare_crypto_hs_frame(picoquic_cnx_t* cnx, int epoch,
     uint8_t* bytes, size_t bytes_max, size_t* consumed);
 int picoquic_prepare_handshake_done_frame(picoquic_cnx_t *cnx, uint8_t* bytes, size_t bytes_max, size_t* consumed);
+int picoquic_prepare_ack_frequency_frame(picoquic_cnx_t *cnx, picoquic_path_t *path_x, uint64_t current_time,
+    uint8_t* bytes, size_t bytes_max, size_t* consumed);
 int picoquic_prepare_ack_frame(picoquic_cnx_t* cnx, uint64_t current_time,
     picoquic_packet_context_enum pc,
     uint8_t* bytes, size_t bytes_max, size_t* consumed);
@@ -19,6 +19,9 @@
 * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE /* sendmmsg */
+#endif
 #include <sys/stat.h>
 #include "picosocks.h"
 #include "util.h"
@@ -671,6 +674,125 @@ int picoquic_send_through_server_sockets(
     return sent;
 }
 
+#if defined(__linux__) && !defined(NS3)
+#define PICOQUIC_STATELESS_BATCH_MAX 64
+
+/* Format the source address control message of one batched datagram */
+static size_t picoquic_format_pktinfo(struct msghdr* msg, struct sockaddr* addr_from, unsigned long dest_if)
+{
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(msg);
+    size_t control_length = 0;
+
+    if (addr_from->sa_family == AF_INET) {
+        memset(cmsg, 0, CMSG_SPACE(sizeof(struct in_pktinfo)));
+        cmsg->cmsg_level = IPPROTO_IP;
+        cmsg->cmsg_type = IP_PKTINFO;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(struct in_pktinfo));
+        struct in_pktinfo* pktinfo = (struct in_pktinfo*)CMSG_DATA(cmsg);
+        pktinfo->ipi_addr.s_addr = ((struct sockaddr_in*)addr_from)->sin_addr.s_addr;
+        pktinfo->ipi_ifindex = dest_if;
+        control_length = CMSG_SPACE(sizeof(struct in_pktinfo));
+    } else if (addr_from->sa_family == AF_INET6) {
+        memset(cmsg, 0, CMSG_SPACE(sizeof(struct in6_pktinfo)));
+        cmsg->cmsg_level = IPPROTO_IPV6;
+        cmsg->cmsg_type = IPV6_PKTINFO;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(struct in6_pktinfo));
+        struct in6_pktinfo* pktinfo6 = (struct in6_pktinfo*)CMSG_DATA(cmsg);
+        memcpy(&pktinfo6->ipi6_addr, &((struct sockaddr_in6*)addr_from)->sin6_addr, sizeof(struct in6_addr));
+        pktinfo6->ipi6_ifindex = dest_if;
+        control_length = CMSG_SPACE(sizeof(struct in6_pktinfo));
+    }
+
+    return control_length;
+}
+
+/*
+ * The V4 and V6 sockets are distinct, so the batch is split per socket.
+ * Each sendmmsg call carries up to PICOQUIC_STATELESS_BATCH_MAX datagrams.
+ */
+int picoquic_send_stateless_through_server_sockets(
+    picoquic_server_sockets_t* sockets,
+    picoquic_stateless_packet_t** sp, int nb_sp)
+{
+    struct mmsghdr msgs[PICOQUIC_STATELESS_BATCH_MAX];
+    struct iovec iovs[PICOQUIC_STATELESS_BATCH_MAX];
+    char cmsg_buffers[PICOQUIC_STATELESS_BATCH_MAX][CMSG_SPACE(sizeof(struct in6_pktinfo))];
+    int nb_sent = 0;
+
+    for (int socket_index = 0; socket_index < PICOQUIC_NB_SERVER_SOCKETS; socket_index++) {
+        int sp_index = 0;
+
+        while (sp_index < nb_sp) {
+            unsigned int nb_msg = 0;
+
+            memset(msgs, 0, sizeof(msgs));
+            while (sp_index < nb_sp && nb_msg < PICOQUIC_STATELESS_BATCH_MAX) {
+                picoquic_stateless_packet_t* p = sp[sp_index++];
+                int p_socket_index = (p->addr_to.ss_family == AF_INET) ? 1 : 0;
+
+                if (p_socket_index != socket_index) {
+                    continue;
+                }
+
+                iovs[nb_msg].iov_base = p->bytes;
+                iovs[nb_msg].iov_len = p->length;
+                msgs[nb_msg].msg_hdr.msg_name = &p->addr_to;
+                msgs[nb_msg].msg_hdr.msg_namelen = (p->addr_to.ss_family == AF_INET) ? sizeof(struct sockaddr_in) : sizeof(struct sockaddr_in6);
+                msgs[nb_msg].msg_hdr.msg_iov = &iovs[nb_msg];
+                msgs[nb_msg].msg_hdr.msg_iovlen = 1;
+                msgs[nb_msg].msg_hdr.msg_control = cmsg_buffers[nb_msg];
+                msgs[nb_msg].msg_hdr.msg_controllen = sizeof(cmsg_buffers[nb_msg]);
+                msgs[nb_msg].msg_hdr.msg_controllen = picoquic_format_pktinfo(&msgs[nb_msg].msg_hdr,
+                    (struct sockaddr*)&p->addr_local, p->if_index_local);
+                if (msgs[nb_msg].msg_hdr.msg_controllen == 0) {
+                    msgs[nb_msg].msg_hdr.msg_control = NULL;
+                }
+                nb_msg++;
+            }
+
+            /* sendmmsg may stop early, e.g. when the socket buffer fills up;
+             * resume from the first unsent message until the kernel refuses. */
+            unsigned int msg_index = 0;
+
+            while (msg_index < nb_msg) {
+                int sent = sendmmsg(sockets->s_socket[socket_index], &msgs[msg_index], nb_msg - msg_index, 0);
+
+                if (sent <= 0) {
+                    DBG_PRINTF("Could not send stateless batch on UDP socket[%d]= %d!\n",
+                        socket_index, errno);
+                    break;
+                }
+                msg_index += (unsigned int)sent;
+                nb_sent += sent;
+            }
+        }
+    }
+
+    return nb_sent;
+}
+#else
+int picoquic_send_stateless_through_server_sockets(
+    picoquic_server_sockets_t* sockets,
+    picoquic_stateless_packet_t** sp, int nb_sp)
+{
+    int nb_sent = 0;
+
+    for (int i = 0; i < nb_sp; i++) {
+        if (picoquic_send_through_server_sockets(sockets,
+                (struct sockaddr*)&sp[i]->addr_to,
+                (sp[i]->addr_to.ss_family == AF_INET) ? sizeof(struct sockaddr_in) : sizeof(struct sockaddr_in6),
+                (struct sockaddr*)&sp[i]->addr_local,
+                (sp[i]->addr_local.ss_family == AF_INET) ? sizeof(struct sockaddr_in) : sizeof(struct sockaddr_in6),
+                sp[i]->if_index_local,
+                (const char*)sp[i]->bytes, (int)sp[i]->length) > 0) {
+            nb_sent++;
+        }
+    }
+
+    return nb_sent;
+}
+#endif
+
 int picoquic_get_server_address(const char* ip_address_text, int server_port,
     struct sockaddr_storage* server_address,
     int* server_addr_length,
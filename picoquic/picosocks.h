@@ -145,6 +145,11 @@ int picoquic_send_through_server_sockets(
     struct sockaddr* addr_from, socklen_t from_length, unsigned long from_if,
     const char* bytes, int length);
 
+/* Send a batch of stateless packets, using sendmmsg when the platform has it */
+int picoquic_send_stateless_through_server_sockets(
+    picoquic_server_sockets_t* sockets,
+    picoquic_stateless_packet_t** sp, int nb_sp);
+
 int picoquic_sendmsg(SOCKET_TYPE fd,
     struct sockaddr* addr_dest,
     socklen_t dest_length,
@@ -5,6 +5,9 @@
 #include <string.h>
 #include "memory.h"
 #include "picoquic_internal.h"
+#include "probes.h"
+#include "native_pluglet.h"
+#include "spsc_ring.h"
 
 #include <archive.h>
 #include <archive_entry.h>
@@ -60,6 +63,10 @@ int plugin_plug_elf_param_struct(protocol_operation_param_struct_t *popst, proto
     }
     /* Record the plugin pluglet comes from */
     new_pluglet->p = p;
+    p->nb_pluglets++;
+    if (new_pluglet->native) {
+        p->nb_lowered++;
+    }
 
     /* We cope with (nearly) all bad cases, so now insert */
     observer_node_t *new_node;
@@ -152,6 +159,9 @@ int plugin_plug_elf(picoquic_cnx_t *cnx, protoop_plugin_t *p, protoop_str_id_t p
     pid.id = pid_str;
     /* And compute its hash */
     pid.hash = hash_value_str(pid.id);
+    if (cnx->hibernated) {
+        picoquic_wake_cnx(cnx);
+    }
     HASH_FIND_PID(cnx->ops, &(pid.hash), post);
 
     /* Two cases: either it exists, or not */
@@ -177,6 +187,9 @@ int plugin_plug_elf(picoquic_cnx_t *cnx, protoop_plugin_t *p, protoop_str_id_t p
 
 int plugin_unplug(picoquic_cnx_t *cnx, protoop_str_id_t pid, param_id_t param, pluglet_type_enum pte) {
     protocol_operation_struct_t *post;
+    if (cnx->hibernated) {
+        picoquic_wake_cnx(cnx);
+    }
     HASH_FIND_STR(cnx->ops, pid, post);
 
     if (!post) {
@@ -365,6 +378,9 @@ int plugin_parse_parameter(char *param_token, plugin_parameters_t *params) {
     } else if (strcmp(param_token, "dynamic_memory") == 0) {
         params->plugin_memory_manager_type = plugin_memory_manager_dynamic;
         return 0;
+    } else if (strcmp(param_token, "slab_memory") == 0) {
+        params->plugin_memory_manager_type = plugin_memory_manager_slab;
+        return 0;
     }
     printf("Unrecognized plugin option: \"%s\"\n", param_token);
     return 1;
@@ -407,17 +423,183 @@ char* plugin_parse_first_plugin_line(char *first_line, plugin_parameters_t *para
     return plugin_name;
 }
 
-protoop_plugin_t* plugin_initialize(char *first_line) {
+int plugin_ring_open(picoquic_cnx_t *cnx, uint32_t capacity) {
+    protoop_plugin_t *p = cnx->current_plugin;
+    if (p == NULL) {
+        return -1;
+    }
+    for (int i = 0; i < PLUGIN_RINGS_MAX; i++) {
+        if (p->rings[i] == NULL && (p->rings[i] = spsc_ring_create(capacity)) == NULL) {
+            plugin_release_rings(p);
+            return -1;
+        }
+    }
+    return 0;
+}
 
-    protoop_plugin_t *p = calloc(1, sizeof(protoop_plugin_t));
+void plugin_ring_close(picoquic_cnx_t *cnx) {
+    if (cnx->current_plugin != NULL) {
+        plugin_release_rings(cnx->current_plugin);
+    }
+}
+
+/* True if the length bytes at data lie in the memory of the plugin */
+static bool plugin_memory_holds(protoop_plugin_t *p, const uint8_t *data, uint32_t length) {
+    const uint8_t *memory = (const uint8_t *) p->memory;
+    return data >= memory && length <= PLUGIN_MEMORY && data + length <= memory + PLUGIN_MEMORY;
+}
+
+static spsc_ring_t *plugin_current_ring(picoquic_cnx_t *cnx, int ring_id) {
+    if (cnx->current_plugin == NULL || ring_id < 0 || ring_id >= PLUGIN_RINGS_MAX) {
+        return NULL;
+    }
+    return cnx->current_plugin->rings[ring_id];
+}
+
+int plugin_ring_push(picoquic_cnx_t *cnx, int ring_id, const uint8_t *data, uint32_t length) {
+    spsc_ring_t *ring = plugin_current_ring(cnx, ring_id);
+    if (ring == NULL || !plugin_memory_holds(cnx->current_plugin, data, length)) {
+        return -1;
+    }
+    return spsc_ring_push(ring, data, length);
+}
+
+int plugin_ring_pop(picoquic_cnx_t *cnx, int ring_id, uint8_t *data, uint32_t max) {
+    spsc_ring_t *ring = plugin_current_ring(cnx, ring_id);
+    if (ring == NULL || !plugin_memory_holds(cnx->current_plugin, data, max)) {
+        return -1;
+    }
+    return spsc_ring_pop(ring, data, max);
+}
+
+void plugin_ring_skip(picoquic_cnx_t *cnx, int ring_id) {
+    spsc_ring_t *ring = plugin_current_ring(cnx, ring_id);
+    if (ring != NULL) {
+        spsc_ring_skip(ring);
+    }
+}
+
+void plugin_release_rings(protoop_plugin_t *p) {
+    for (int i = 0; i < PLUGIN_RINGS_MAX; i++) {
+        if (p->rings[i] != NULL) {
+            spsc_ring_free(p->rings[i]);
+            p->rings[i] = NULL;
+        }
+    }
+}
+
+spsc_ring_t *plugin_get_ring(picoquic_cnx_t *cnx, const char *plugin_name, int ring_id) {
+    protoop_plugin_t *p = NULL;
+    if (ring_id < 0 || ring_id >= PLUGIN_RINGS_MAX) {
+        return NULL;
+    }
+    HASH_FIND_STR(cnx->plugins, plugin_name, p);
+    return (p == NULL) ? NULL : p->rings[ring_id];
+}
+
+int plugin_save_hibernation_state(picoquic_cnx_t *cnx, const uint8_t *data, uint32_t length) {
+    protoop_plugin_t *p = cnx->current_plugin;
+    uint8_t *state;
+    if (p == NULL || (length > 0 && !plugin_memory_holds(p, data, length)) ||
+        (state = (uint8_t *) malloc(length > 0 ? length : 1)) == NULL) {
+        return -1;
+    }
+    if (length > 0) {
+        memcpy(state, data, length);
+    }
+    free(p->hibernation_state);
+    p->hibernation_state = state;
+    p->hibernation_state_length = length;
+    return 0;
+}
+
+int plugin_restore_hibernation_state(picoquic_cnx_t *cnx, uint8_t *data, uint32_t max) {
+    protoop_plugin_t *p = cnx->current_plugin;
+    if (p == NULL || p->hibernation_state == NULL || p->hibernation_state_length > max ||
+        (p->hibernation_state_length > 0 && !plugin_memory_holds(p, data, p->hibernation_state_length))) {
+        return -1;
+    }
+    if (p->hibernation_state_length > 0) {
+        memcpy(data, p->hibernation_state, p->hibernation_state_length);
+    }
+    return (int) p->hibernation_state_length;
+}
+
+static void plugin_clear_metadata(protoop_plugin_t *p, plugin_struct_metadata_t *metadata) {
+    if (p->metadata_slot < STRUCT_METADATA_INLINE_SLOTS) {
+        memset(metadata->inline_slots[p->metadata_slot], 0, sizeof(metadata->inline_slots[0]));
+    } else if (p->metadata_slot - STRUCT_METADATA_INLINE_SLOTS < metadata->nb_extra_slots) {
+        memset(metadata->extra_slots[p->metadata_slot - STRUCT_METADATA_INLINE_SLOTS], 0, sizeof(metadata->extra_slots[0]));
+    }
+}
+
+void plugin_hibernate_plugins(picoquic_cnx_t *cnx) {
+    protoop_plugin_t *p, *tmp_p;
+    HASH_ITER(hh, cnx->plugins, p, tmp_p) {
+        if (p->hibernation_state == NULL) {
+            continue;
+        }
+        /* The metadata of the plugin points in its memory, the packets are already released */
+        plugin_clear_metadata(p, &cnx->metadata);
+        for (int i = 0; i < cnx->nb_paths; i++) {
+            plugin_clear_metadata(p, &cnx->path[i]->metadata);
+        }
+        destroy_memory_management(p);
+        release_memory_pages(p);
+        p->memory_released = true;
+    }
+}
+
+void plugin_wake_plugins(picoquic_cnx_t *cnx) {
+    protoop_plugin_t *p, *tmp_p;
+    bool released = false;
+    HASH_ITER(hh, cnx->plugins, p, tmp_p) {
+        if (p->memory_released) {
+            init_memory_management(p);
+            p->memory_released = false;
+            released = true;
+        }
+    }
+    if (released) {
+        protoop_prepare_and_run_noparam(cnx, &PROTOOP_NOPARAM_WAKE, NULL, NULL);
+    }
+    plugin_drop_hibernation_states(cnx);
+}
+
+void plugin_drop_hibernation_states(picoquic_cnx_t *cnx) {
+    protoop_plugin_t *p, *tmp_p;
+    HASH_ITER(hh, cnx->plugins, p, tmp_p) {
+        free(p->hibernation_state);
+        p->hibernation_state = NULL;
+        p->hibernation_state_length = 0;
+    }
+}
+
+void plugin_release(protoop_plugin_t *p) {
+    if (p->huge_memory) {
+        picoquic_huge_release(p->huge_memory, p);
+    } else {
+        free(p);
+    }
+}
+
+protoop_plugin_t* plugin_initialize(picoquic_cnx_t *cnx, char *first_line) {
+
+    picoquic_huge_memory_t *huge_memory = (cnx->quic) ? cnx->quic->huge_memory : NULL;
+    protoop_plugin_t *p = (huge_memory) ? picoquic_huge_alloc(huge_memory, sizeof(protoop_plugin_t)) :
+        calloc(1, sizeof(protoop_plugin_t));
     if (!p) {
         printf("Cannot allocate memory for plugin!\n");
         return NULL;
     }
+    p->huge_memory = huge_memory;
+    for (int i = 0; i < PLUGIN_RINGS_MAX; i++) {
+        p->rings[i] = NULL;
+    }
     /* Part one: extract plugin id */
     char *plugin_id = plugin_parse_first_plugin_line(first_line, &p->params);
     if (!plugin_id) {
-        free(p);
+        plugin_release(p);
         return NULL;
     }
 
@@ -425,14 +607,14 @@ protoop_plugin_t* plugin_initialize(char *first_line) {
     p->block_queue_cc = queue_init();
     if (!p->block_queue_cc) {
         printf("Cannot allocate memory for sending queue congestion control!\n");
-        free(p);
+        plugin_release(p);
         return NULL;
     }
     p->block_queue_non_cc = queue_init();
     if (!p->block_queue_non_cc) {
         printf("Cannot allocate memory for sending queue non congestion control!\n");
         free(p->block_queue_cc);
-        free(p);
+        plugin_release(p);
         return NULL;
     }
     /* TODO make this value configurable */
@@ -623,7 +805,7 @@ int plugin_insert_plugin(picoquic_cnx_t *cnx, const char *plugin_fname) {
         return 1;
     }
 
-    protoop_plugin_t *p = plugin_initialize(line);
+    protoop_plugin_t *p = plugin_initialize(cnx, line);
     if (!p) {
         printf("Cannot extract plugin line in file %s\n", plugin_fname);
         fclose(file);
@@ -659,7 +841,14 @@ int plugin_insert_plugin(picoquic_cnx_t *cnx, const char *plugin_fname) {
         }
     }
 
+    if (ok && HASH_COUNT(cnx->plugins) >= PLUGIN_METADATA_SLOTS_MAX) {
+        printf("Cannot insert more than %d plugins\n", PLUGIN_METADATA_SLOTS_MAX);
+        ok = false;
+    }
+
     if (ok) {
+        /* Plugins are never removed from a connection, so their count gives a free slot */
+        p->metadata_slot = (uint8_t) HASH_COUNT(cnx->plugins);
         init_memory_management(p);
         HASH_ADD_STR(cnx->plugins, name, p);
     }
@@ -677,9 +866,9 @@ int plugin_insert_plugin(picoquic_cnx_t *cnx, const char *plugin_fname) {
 
     if (!ok) {
         LOG_EVENT(cnx, "PLUGINS", "PLUGIN_INSERTION_FAILED", "", "{\"filename\": \"%s\"}", plugin_fname);
-        free(p);
+        plugin_release(p);
     } else {
-        LOG_EVENT(cnx, "PLUGINS", "INSERTED_PLUGIN", "", "{\"filename\": \"%s\", \"plugin_name\": \"%s\"}", plugin_fname, p->name);
+        LOG_EVENT(cnx, "PLUGINS", "INSERTED_PLUGIN", "", "{\"filename\": \"%s\", \"plugin_name\": \"%s\", \"pluglets\": %d, \"lowered\": %d}", plugin_fname, p->name, p->nb_pluglets, p->nb_lowered);
     }
 
     free(preprocessed);
@@ -1074,47 +1263,18 @@ int plugin_process_plugin_data_exchange(picoquic_cnx_t *cnx, const char* plugin_
 }
 
 protoop_arg_t plugin_run_protoop_internal(picoquic_cnx_t *cnx, const protoop_params_t *pp) {
+    if (cnx->hibernated) {
+        /* Rebuild what the connection released when it hibernated */
+        picoquic_wake_cnx(cnx);
+    }
     if (pp->inputc > PROTOOPARGS_MAX) {
         printf("Too many arguments for protocol operation with id %s : %d > %d\n",
             pp->pid->id, pp->inputc, PROTOOPARGS_MAX);
         return PICOQUIC_ERROR_PROTOCOL_OPERATION_TOO_MANY_ARGUMENTS;
     }
 
-    char *error_msg = NULL;
+    PICOQUIC_PROBE3(protoop_entry, cnx, pp->pid->id, pp->param);
 
-    /* First save previous args, and update context with new ones
-     * Notice that we store ALL array of protoop_inputv and protoop_outputv.
-     * With this, even if the called pluglet tried to modify the input arguments,
-     * they will remain unchanged at caller side.
-     */
-    protoop_plugin_t *old_plugin = cnx->current_plugin;
-    protoop_plugin_t *replace_plugin = NULL;
-    bool suppress_replace_plugin = false;
-    protocol_operation_struct_t *old_protoop = cnx->current_protoop;
-    pluglet_type_enum old_anchor = cnx->current_anchor;
-    int caller_inputc = cnx->protoop_inputc;
-    int caller_outputc = cnx->protoop_outputc_callee;
-    uint64_t caller_inputv[caller_inputc];
-    uint64_t caller_outputv[caller_outputc];
-    memcpy(caller_inputv, cnx->protoop_inputv, sizeof(uint64_t) * caller_inputc);
-    memcpy(caller_outputv, cnx->protoop_outputv, sizeof(uint64_t) * caller_outputc);
-    memcpy(cnx->protoop_inputv, pp->inputv, sizeof(uint64_t) * pp->inputc);
-    cnx->protoop_inputc = pp->inputc;
-
-#ifdef DBG_PLUGIN_PRINTF
-    for (int i = 0; i < pp->inputc; i++) {
-        DBG_PLUGIN_PRINTF("Arg %d: 0x%" PRIx64, i, pp->inputv[i]);
-    }
-#endif
-
-    /* Also set protoop_outputv to 0, to prevent callee to see caller state */
-    /* No more needed with the API */
-    // memset(cnx->protoop_outputv, 0, sizeof(uint64_t) * PROTOOPARGS_MAX);
-    cnx->protoop_outputc_callee = 0;
-
-    DBG_PLUGIN_PRINTF("Running operation with id %s (param 0x%x) with %d inputs", pp->pid->id, pp->param, pp->inputc);
-
-    /* Either we have a pluglet, and we run it, or we stick to the default ops behaviour */
     protoop_arg_t status;
     protocol_operation_struct_t *post;
     if (pp->pid->hash == 0) {
@@ -1155,6 +1315,58 @@ protoop_arg_t plugin_run_protoop_internal(picoquic_cnx_t *cnx, const protoop_par
         exit(-1);
     }
 
+    /* A replace lowered to a constant, without observer, needs no call context */
+    pluglet_t *replace = popst->replace;
+    if (replace && replace->native && replace->native->kind == native_pluglet_constant && !popst->pre && !popst->post) {
+        replace->count++;
+        PICOQUIC_PROBE4(pluglet_entry, cnx, replace->p->name, post->name, pluglet_replace);
+#ifndef DEBUG_PLUGIN_EXECUTION_TIME
+        status = (protoop_arg_t) replace->native->constant;
+#else
+        uint64_t before = picoquic_current_time();
+        status = (protoop_arg_t) replace->native->constant;
+        replace->total_execution_time += picoquic_current_time() - before;
+#endif
+        PICOQUIC_PROBE5(pluglet_exit, cnx, replace->p->name, post->name, pluglet_replace, status);
+        cnx->previous_plugin_in_replace = replace->p;
+        PICOQUIC_PROBE4(protoop_exit, cnx, pp->pid->id, pp->param, status);
+        return status;
+    }
+
+    char *error_msg = NULL;
+
+    /* First save previous args, and update context with new ones
+     * Notice that we store ALL array of protoop_inputv and protoop_outputv.
+     * With this, even if the called pluglet tried to modify the input arguments,
+     * they will remain unchanged at caller side.
+     */
+    protoop_plugin_t *old_plugin = cnx->current_plugin;
+    protoop_plugin_t *replace_plugin = NULL;
+    bool suppress_replace_plugin = false;
+    protocol_operation_struct_t *old_protoop = cnx->current_protoop;
+    pluglet_type_enum old_anchor = cnx->current_anchor;
+    int caller_inputc = cnx->protoop_inputc;
+    int caller_outputc = cnx->protoop_outputc_callee;
+    uint64_t caller_inputv[caller_inputc];
+    uint64_t caller_outputv[caller_outputc];
+    memcpy(caller_inputv, cnx->protoop_inputv, sizeof(uint64_t) * caller_inputc);
+    memcpy(caller_outputv, cnx->protoop_outputv, sizeof(uint64_t) * caller_outputc);
+    memcpy(cnx->protoop_inputv, pp->inputv, sizeof(uint64_t) * pp->inputc);
+    cnx->protoop_inputc = pp->inputc;
+
+#ifdef DBG_PLUGIN_PRINTF
+    for (int i = 0; i < pp->inputc; i++) {
+        DBG_PLUGIN_PRINTF("Arg %d: 0x%" PRIx64, i, pp->inputv[i]);
+    }
+#endif
+
+    /* Also set protoop_outputv to 0, to prevent callee to see caller state */
+    /* No more needed with the API */
+    // memset(cnx->protoop_outputv, 0, sizeof(uint64_t) * PROTOOPARGS_MAX);
+    cnx->protoop_outputc_callee = 0;
+
+    DBG_PLUGIN_PRINTF("Running operation with id %s (param 0x%x) with %d inputs", pp->pid->id, pp->param, pp->inputc);
+
     /* Record the protocol operation on the call stack */
     popst->running = true;
     cnx->current_protoop = post;
@@ -1169,7 +1381,7 @@ protoop_arg_t plugin_run_protoop_internal(picoquic_cnx_t *cnx, const protoop_par
         tmp = tmp->next;
     }
 
-    /* The actual protocol operation */
+    /* The actual protocol operation: either we have a pluglet, and we run it, or we stick to the default ops behaviour */
     if (popst->replace) {
         DBG_PLUGIN_PRINTF("Running pluglet at proto op id %s", pp->pid->id);
         cnx->current_plugin = popst->replace->p;
@@ -1242,6 +1454,8 @@ protoop_arg_t plugin_run_protoop_internal(picoquic_cnx_t *cnx, const protoop_par
     cnx->current_protoop = old_protoop;
     cnx->current_anchor = old_anchor;
 
+    PICOQUIC_PROBE4(protoop_exit, cnx, pp->pid->id, pp->param, status);
+
     return status;
 }
 
@@ -1267,6 +1481,9 @@ bool plugin_pluglet_exists(picoquic_cnx_t *cnx, protoop_id_t *pid, param_id_t pa
     if (pid->hash == 0) {
         pid->hash = hash_value_str(pid->id);
     }
+    if (cnx->hibernated) {
+        picoquic_wake_cnx(cnx);
+    }
     HASH_FIND_PID(cnx->ops, &pid->hash, post);
     if (!post)
         return false;
@@ -1295,61 +1512,52 @@ bool plugin_pluglet_exists(picoquic_cnx_t *cnx, protoop_id_t *pid, param_id_t pa
 }
 
 
-int set_plugin_metadata(protoop_plugin_t *plugin, plugin_struct_metadata_t **metadata, int idx, uint64_t val) {
+int set_plugin_metadata(protoop_plugin_t *plugin, plugin_struct_metadata_t *metadata, int idx, uint64_t val) {
     if (!plugin) {
         printf("ERROR: set_plugin_metadata called with an undefined plugin\n");
         return -1;
     }
-    if (idx >= STRUCT_METADATA_MAX) {
+    if (idx < 0 || idx >= STRUCT_METADATA_MAX) {
         printf("ERROR: set_plugin_metadata called with an index out of bound\n");
         return -1;
     }
-    if (plugin->hash == 0) {
-        plugin->hash = hash_value_str(plugin->name);
+    if (plugin->metadata_slot < STRUCT_METADATA_INLINE_SLOTS) {
+        metadata->inline_slots[plugin->metadata_slot][idx] = val;
+        return 0;
     }
-    plugin_struct_metadata_t *md = NULL;
-    HASH_FIND_PLUGIN(*metadata, &(plugin->hash), md);
-    if (md == NULL) {
-        md = (plugin_struct_metadata_t *) calloc(1, sizeof(plugin_struct_metadata_t));
-        if (!md) {
+    uint8_t extra_slot = plugin->metadata_slot - STRUCT_METADATA_INLINE_SLOTS;
+    if (extra_slot >= metadata->nb_extra_slots) {
+        /* Grow the block up to the slot of the plugin, the new slots being zeroed */
+        uint64_t (*extra_slots)[STRUCT_METADATA_MAX] = realloc(metadata->extra_slots,
+            (extra_slot + 1) * sizeof(metadata->extra_slots[0]));
+        if (!extra_slots) {
             printf("ERROR: out of memory !\n");
             return -1;
         }
-        md->plugin_hash = plugin->hash;
-        HASH_ADD_PLUGIN(*metadata, plugin_hash, md);
+        memset(extra_slots[metadata->nb_extra_slots], 0, (extra_slot + 1 - metadata->nb_extra_slots) * sizeof(extra_slots[0]));
+        metadata->extra_slots = extra_slots;
+        metadata->nb_extra_slots = extra_slot + 1;
     }
-    md->metadata[idx] = val;
+    metadata->extra_slots[extra_slot][idx] = val;
     return 0;
 }
 
 // gets the metadata attached to a plugin
-// (creates the metadata structure if it is not already there)
-int get_plugin_metadata(protoop_plugin_t *plugin, plugin_struct_metadata_t **metadata, int idx, uint64_t *out) {
+int get_plugin_metadata(protoop_plugin_t *plugin, plugin_struct_metadata_t *metadata, int idx, uint64_t *out) {
     if (!plugin) {
-        printf("ERROR: set_plugin_metadata called with an undefined plugin\n");
+        printf("ERROR: get_plugin_metadata called with an undefined plugin\n");
         return -1;
     }
-    if (idx >= STRUCT_METADATA_MAX) {
-        printf("ERROR: set_plugin_metadata called with an index out of bound\n");
+    if (idx < 0 || idx >= STRUCT_METADATA_MAX) {
+        printf("ERROR: get_plugin_metadata called with an index out of bound\n");
         return -1;
     }
-    if (plugin->hash == 0) {
-        plugin->hash = hash_value_str(plugin->name);
-    }
-    plugin_struct_metadata_t *md = NULL;
-    // try to find the metadata
-    HASH_FIND_PLUGIN(*metadata, &(plugin->hash), md);
-    if (md == NULL) {
-        // the metadata were not already allocated, so create it
-        md = (plugin_struct_metadata_t *) calloc(1, sizeof(plugin_struct_metadata_t));
-        if (!md) {
-            printf("ERROR: out of memory !\n");
-            return -1;
-        }
-        md->plugin_hash = plugin->hash;
-        HASH_ADD_PLUGIN((*metadata), plugin_hash, md);
+    if (plugin->metadata_slot < STRUCT_METADATA_INLINE_SLOTS) {
+        *out = metadata->inline_slots[plugin->metadata_slot][idx];
+    } else {
+        uint8_t extra_slot = plugin->metadata_slot - STRUCT_METADATA_INLINE_SLOTS;
+        *out = (extra_slot < metadata->nb_extra_slots) ? metadata->extra_slots[extra_slot][idx] : 0;
     }
-    *out = md->metadata[idx];
     return 0;
 }
 
@@ -34,6 +34,11 @@ int plugin_unplug(picoquic_cnx_t *cnx, protoop_str_id_t pid, param_id_t param, p
  */
 int plugin_insert_plugin(picoquic_cnx_t *cnx, const char *plugin_fname);
 
+/**
+ * Frees the plugin structure, whether it comes from calloc or from the huge pages of the QUIC context
+ */
+void plugin_release(protoop_plugin_t *p);
+
 /**
  * Function taking a list of plugin file names with their associated plugin
  * IDs and insert them in the provided order.
@@ -98,23 +103,65 @@ protoop_arg_t plugin_run_protoop(picoquic_cnx_t *cnx, protoop_params_t *pp, char
 bool plugin_pluglet_exists(picoquic_cnx_t *cnx, protoop_id_t *pid, param_id_t param, pluglet_type_enum anchor);
 
 /**
- * This function sets metadata at `idx` to `val` from a plugin structure metadata hashmap stored at `metadata`
- * If the metadata are not present in the hashmap, it will be allocated and the values at indexes different thant `idx`
- * are set to zero by default
+ * This function sets metadata at `idx` to `val` in the slot of the plugin in the structure metadata `metadata`
+ * If the slot is neither inline nor present in the extra block, the block is (re)allocated and the values at
+ * indexes different than `idx` are set to zero by default
  * Returns 0 if no error, -1 if an error occurred
  */
-int set_plugin_metadata(protoop_plugin_t *plugin, plugin_struct_metadata_t **metadata, int idx, uint64_t val);
+int set_plugin_metadata(protoop_plugin_t *plugin, plugin_struct_metadata_t *metadata, int idx, uint64_t val);
 
 /**
- * This function sets out to the values of the plugin metadata at `idx` from a plugin structure metadata hashmap stored
- * in `metadata`. If the metadata are not present in the hashmap, it will be allocated and the values are set to zero
- * by default (*out will thus be set to 0)
+ * This function sets out to the values of the plugin metadata at `idx` from the structure metadata
+ * `metadata`. If the plugin did not set any metadata on the structure, *out is set to 0 without allocating
  * Returns 0 if no error, -1 if an error occurred
  */
-int get_plugin_metadata(protoop_plugin_t *plugin, plugin_struct_metadata_t **metadata, int idx, uint64_t *out);
+int get_plugin_metadata(protoop_plugin_t *plugin, plugin_struct_metadata_t *metadata, int idx, uint64_t *out);
 
 int get_errno();
 
+/**
+ * Message rings shared between a plugin and the application, see spsc_ring.h.
+ * The rings are owned by the plugin instance of the connection. Pluglets only
+ * name them by index, so they cannot reach the rings of another plugin, and
+ * the buffers given to plugin_ring_push and plugin_ring_pop must lie in the
+ * memory of the plugin.
+ * The push, pop and skip functions behave as their spsc_ring counterparts and
+ * return -1, resp. do nothing, if the ring is not open.
+ */
+#define PLUGIN_RING_TO_APP 0 /* Produced by the plugin, consumed by the application */
+#define PLUGIN_RING_FROM_APP 1 /* Produced by the application, consumed by the plugin */
+
+/* Opens the rings of the running plugin. Returns 0 if they are open. */
+int plugin_ring_open(picoquic_cnx_t *cnx, uint32_t capacity);
+/* Closes the rings of the running plugin */
+void plugin_ring_close(picoquic_cnx_t *cnx);
+int plugin_ring_push(picoquic_cnx_t *cnx, int ring_id, const uint8_t *data, uint32_t length);
+int plugin_ring_pop(picoquic_cnx_t *cnx, int ring_id, uint8_t *data, uint32_t max);
+void plugin_ring_skip(picoquic_cnx_t *cnx, int ring_id);
+/* Releases the rings of the plugin, when it is freed */
+void plugin_release_rings(protoop_plugin_t *p);
+/* Application side: returns the ring of the plugin named plugin_name, or NULL if not open */
+struct st_spsc_ring_t *plugin_get_ring(picoquic_cnx_t *cnx, const char *plugin_name, int ring_id);
+
+/**
+ * Hibernation of the plugins, see picoquic_set_hibernation_delay. A plugin observing
+ * the hibernate protocol operation may save an opaque state, lying in its memory, with
+ * plugin_save_hibernation_state. Once the connection hibernates, the memory of the
+ * plugin is released and its metadata cleared: nothing else may point in it. When the
+ * connection wakes up, its memory manager starts empty and the plugin gets the state
+ * back with plugin_restore_hibernation_state, from the wake protocol operation. The
+ * plugins which save nothing keep their memory.
+ */
+int plugin_save_hibernation_state(picoquic_cnx_t *cnx, const uint8_t *data, uint32_t length);
+/* Copies the saved state in data. Returns its length, or -1 if nothing is saved or it is larger than max. */
+int plugin_restore_hibernation_state(picoquic_cnx_t *cnx, uint8_t *data, uint32_t max);
+/* Releases the memory of the plugins which saved a state */
+void plugin_hibernate_plugins(picoquic_cnx_t *cnx);
+/* Rebuilds the memory of the released plugins and runs the wake protocol operation */
+void plugin_wake_plugins(picoquic_cnx_t *cnx);
+/* Frees the saved states, when the hibernation is prevented */
+void plugin_drop_hibernation_states(picoquic_cnx_t *cnx);
+
 #ifndef MAX
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
 #endif
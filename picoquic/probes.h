@@ -0,0 +1,52 @@
+/**
+ * \file probes.h
+ * \brief Static tracepoints on the protocol operations and the packet paths.
+ *
+ * When built with PICOQUIC_USDT (ENABLE_USDT=1 in the cmake environment), each
+ * probe is a USDT tracepoint of the "picoquic" provider, declared with
+ * <sys/sdt.h> (systemtap-sdt-dev). A tracepoint is a single nop in the code
+ * until a tracer such as bpftrace or perf attaches to it, but its arguments
+ * are evaluated on every pass, traced or not, to be left where the tracer
+ * reads them. The call sites thus pass values at hand: the pluglet probes cost
+ * the loads of the plugin and operation names on each pluglet run. Without
+ * PICOQUIC_USDT, the probes compile to nothing and their arguments are not
+ * evaluated.
+ *
+ * The probes and their arguments:
+ *  - protoop_entry(cnx, protoop_id, param)
+ *  - protoop_exit(cnx, protoop_id, param, status)
+ *  - pluglet_entry(cnx, plugin_name, protoop_name, anchor)
+ *  - pluglet_exit(cnx, plugin_name, protoop_name, anchor, status)
+ *  - segment_entry(quic, length, current_time)
+ *  - segment_exit(quic, cnx, packet_type, pn64, consumed, ret)
+ *  - prepare_packet_entry(cnx, current_time)
+ *  - prepare_packet_exit(cnx, send_length, ret)
+ *  - congestion_notify(cnx, path, notification, cwin_before, cwin_after)
+ *  - packet_lost(cnx, path, pc, sequence_number, length)
+ *
+ * The strings are NUL terminated and the anchor is a pluglet_type_enum.
+ * tools/usdt has bpftrace scripts using them.
+ */
+
+#ifndef PICOQUIC_PROBES_H
+#define PICOQUIC_PROBES_H
+
+#ifdef PICOQUIC_USDT
+#include <sys/sdt.h>
+
+#define PICOQUIC_PROBE2(name, a1, a2) DTRACE_PROBE2(picoquic, name, a1, a2)
+#define PICOQUIC_PROBE3(name, a1, a2, a3) DTRACE_PROBE3(picoquic, name, a1, a2, a3)
+#define PICOQUIC_PROBE4(name, a1, a2, a3, a4) DTRACE_PROBE4(picoquic, name, a1, a2, a3, a4)
+#define PICOQUIC_PROBE5(name, a1, a2, a3, a4, a5) DTRACE_PROBE5(picoquic, name, a1, a2, a3, a4, a5)
+#define PICOQUIC_PROBE6(name, a1, a2, a3, a4, a5, a6) DTRACE_PROBE6(picoquic, name, a1, a2, a3, a4, a5, a6)
+#else
+/* The arguments are not evaluated, but count as used */
+#define PICOQUIC_PROBE_ARG(a) (void)sizeof(a)
+#define PICOQUIC_PROBE2(name, a1, a2) do { PICOQUIC_PROBE_ARG(a1); PICOQUIC_PROBE_ARG(a2); } while (0)
+#define PICOQUIC_PROBE3(name, a1, a2, a3) do { PICOQUIC_PROBE2(name, a1, a2); PICOQUIC_PROBE_ARG(a3); } while (0)
+#define PICOQUIC_PROBE4(name, a1, a2, a3, a4) do { PICOQUIC_PROBE3(name, a1, a2, a3); PICOQUIC_PROBE_ARG(a4); } while (0)
+#define PICOQUIC_PROBE5(name, a1, a2, a3, a4, a5) do { PICOQUIC_PROBE4(name, a1, a2, a3, a4); PICOQUIC_PROBE_ARG(a5); } while (0)
+#define PICOQUIC_PROBE6(name, a1, a2, a3, a4, a5, a6) do { PICOQUIC_PROBE5(name, a1, a2, a3, a4, a5); PICOQUIC_PROBE_ARG(a6); } while (0)
+#endif
+
+#endif /* PICOQUIC_PROBES_H */
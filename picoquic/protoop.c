@@ -31,6 +31,7 @@ protoop_id_t PROTOOP_NOPARAM_SET_NEXT_WAKE_TIME = { .id = PROTOOPID_NOPARAM_SET_
 protoop_id_t PROTOOP_NOPARAM_HAS_CONGESTION_CONTROLLED_PLUGIN_FRAMEMS_TO_SEND = { .id = PROTOOPID_NOPARAM_HAS_CONGESTION_CONTROLLED_PLUGIN_FRAMEMS_TO_SEND };
 protoop_id_t PROTOOP_NOPARAM_RETRANSMIT_NEEDED = { .id = PROTOOPID_NOPARAM_RETRANSMIT_NEEDED };
 protoop_id_t PROTOOP_NOPARAM_RETRANSMIT_NEEDED_BY_PACKET = { .id = PROTOOPID_NOPARAM_RETRANSMIT_NEEDED_BY_PACKET };
+protoop_id_t PROTOOP_NOPARAM_ARM_LOSS_TIMER = { .id = PROTOOPID_NOPARAM_ARM_LOSS_TIMER };
 protoop_id_t PROTOOP_NOPARAM_PREDICT_PACKET_HEADER_LENGTH = { .id = PROTOOPID_NOPARAM_PREDICT_PACKET_HEADER_LENGTH };
 protoop_id_t PROTOOP_NOPARAM_GET_CHECKSUM_LENGTH = { .id = PROTOOPID_NOPARAM_GET_CHECKSUM_LENGTH };
 protoop_id_t PROTOOP_NOPARAM_DEQUEUE_RETRANSMIT_PACKET = { .id = PROTOOPID_NOPARAM_DEQUEUE_RETRANSMIT_PACKET };
@@ -43,6 +44,7 @@ protoop_id_t PROTOOP_NOPARAM_STREAM_BYTES_MAX = { .id = PROTOOPID_NOPARAM_STREAM
 protoop_id_t PROTOOP_NOPARAM_STREAM_ALWAYS_ENCODE_LENGTH = { .id = PROTOOPID_NOPARAM_STREAM_ALWAYS_ENCODE_LENGTH };
 protoop_id_t PROTOOP_NOPARAM_PREPARE_CRYPTO_HS_FRAME = { .id = PROTOOPID_NOPARAM_PREPARE_CRYPTO_HS_FRAME };
 protoop_id_t PROTOOP_NOPARAM_PREPARE_HANDSHAKE_DONE_FRAME = { .id = PROTOOPID_NOPARAM_PREPARE_HANDSHAKE_DONE_FRAME };
+protoop_id_t PROTOOP_NOPARAM_PREPARE_ACK_FREQUENCY_FRAME = { .id = PROTOOPID_NOPARAM_PREPARE_ACK_FREQUENCY_FRAME };
 protoop_id_t PROTOOP_NOPARAM_PREPARE_ACK_FRAME = { .id = PROTOOPID_NOPARAM_PREPARE_ACK_FRAME };
 protoop_id_t PROTOOP_NOPARAM_PREPARE_ACK_ECN_FRAME = { .id = PROTOOPID_NOPARAM_PREPARE_ACK_ECN_FRAME };
 protoop_id_t PROTOOP_NOPARAM_PREPARE_MAX_DATA_FRAME = { .id = PROTOOPID_NOPARAM_PREPARE_MAX_DATA_FRAME };
@@ -62,6 +64,8 @@ protoop_id_t PROTOOP_NOPARAM_HEADER_PREPARED = { .id = PROTOOPID_NOPARAM_HEADER_
 protoop_id_t PROTOOP_NOPARAM_FINALIZE_AND_PROTECT_PACKET = { .id = PROTOOPID_NOPARAM_FINALIZE_AND_PROTECT_PACKET };
 protoop_id_t PROTOOP_NOPARAM_PACKET_WAS_LOST = { .id = PROTOOPID_NOPARAM_PACKET_WAS_LOST };
 protoop_id_t PROTOOP_NOPARAM_CONNECTION_STATE_CHANGED = { .id = PROTOOPID_NOPARAM_CONNECTION_STATE_CHANGED };
+protoop_id_t PROTOOP_NOPARAM_HIBERNATE = { .id = PROTOOPID_NOPARAM_HIBERNATE };
+protoop_id_t PROTOOP_NOPARAM_WAKE = { .id = PROTOOPID_NOPARAM_WAKE };
 protoop_id_t PROTOOP_NOPARAM_STREAM_OPENED = { .id = PROTOOPID_NOPARAM_STREAM_OPENED };
 protoop_id_t PROTOOP_NOPARAM_PLUGIN_STREAM_OPENED = { .id = PROTOOPID_NOPARAM_PLUGIN_STREAM_OPENED };
 protoop_id_t PROTOOP_NOPARAM_STREAM_FLAGS_CHANGED = { .id = PROTOOPID_NOPARAM_STREAM_FLAGS_CHANGED };
@@ -407,6 +407,18 @@ extern protoop_id_t PROTOOP_NOPARAM_RETRANSMIT_NEEDED;
  */
 #define PROTOOPID_NOPARAM_RETRANSMIT_NEEDED_BY_PACKET "retransmit_needed_by_packet"
 extern protoop_id_t PROTOOP_NOPARAM_RETRANSMIT_NEEDED_BY_PACKET;
+/**
+ * Compute the earliest time at which a packet of a packet context of a path is declared lost,
+ * and cache it in the packet context. The cached value is used by set_next_wake_time until an
+ * ACK, a retransmission or a change of the queue or of the RTT invalidates it.
+ * \param[in] path_x \b picoquic_path_t* The path of the packet context
+ * \param[in] pc \b picoquic_packet_context_enum The packet context
+ * \param[in] current_time \b uint64_t The current time
+ *
+ * \return \b uint64_t The loss time, UINT64_MAX if no packet is in flight
+ */
+#define PROTOOPID_NOPARAM_ARM_LOSS_TIMER "arm_loss_timer"
+extern protoop_id_t PROTOOP_NOPARAM_ARM_LOSS_TIMER;
 /**
  * Predict the length of the packet header to send.
  * \param[in] packet_type \b picoquic_packet_type_enum The type of the packet
@@ -527,6 +539,20 @@ extern protoop_id_t PROTOOP_NOPARAM_PREPARE_CRYPTO_HS_FRAME;
  */
 #define PROTOOPID_NOPARAM_PREPARE_HANDSHAKE_DONE_FRAME "prepare_handshake_done"
 extern protoop_id_t PROTOOP_NOPARAM_PREPARE_HANDSHAKE_DONE_FRAME;
+
+/**
+ * Prepare the ACK_FREQUENCY and IMMEDIATE_ACK frames requested to the peer on the given path.
+ * The default behaviour asks for PICOQUIC_ACK_FREQUENCY_PER_RTT ACKs per RTT, based on the congestion window.
+ * \param[in] path_x \b picoquic_path_t* The path on which the frames will be sent
+ * \param[in] current_time \b uint64_t The current time
+ * \param[in] bytes \b uint8_t* Pointer to the buffer to write the frames
+ * \param[in] bytes_max \b size_t Max size that can be written
+ *
+ * \return \b int Error code, 0 means it's ok
+ * \param[out] consumed \b size_t Number of bytes written
+ */
+#define PROTOOPID_NOPARAM_PREPARE_ACK_FREQUENCY_FRAME "prepare_ack_frequency_frame"
+extern protoop_id_t PROTOOP_NOPARAM_PREPARE_ACK_FREQUENCY_FRAME;
 /**
  * Prepare a ACK frame.
  * \param[in] current_time \b uint64_t The current time
@@ -702,6 +728,31 @@ extern protoop_id_t PROTOOP_NOPARAM_PACKET_WAS_LOST;
 #define PROTOOPID_NOPARAM_CONNECTION_STATE_CHANGED "connection_state_changed"
 extern protoop_id_t PROTOOP_NOPARAM_CONNECTION_STATE_CHANGED;
 
+/**
+ * Called before an idle connection hibernates. The structures that can be rebuilt
+ * are then released until the next protocol operation runs on the connection; the
+ * table of protocol operations is only released when no plugin is attached.
+ * Observers can save the state of their plugin with plugin_save_hibernation_state,
+ * the memory of the plugin is then released, see plugin.h. A replacement returning
+ * a non-zero value prevents the hibernation.
+ *
+ * \param[in] current_time \b uint64_t The current time
+ *
+ * \return \b int 0 if the connection can hibernate
+ */
+#define PROTOOPID_NOPARAM_HIBERNATE "hibernate"
+extern protoop_id_t PROTOOP_NOPARAM_HIBERNATE;
+
+/**
+ * Called when a connection wakes up, if plugins saved their state when it hibernated.
+ * Their memory is empty again, observers get their state back with
+ * plugin_restore_hibernation_state.
+ *
+ * No parameters are given to this protoop.
+ */
+#define PROTOOPID_NOPARAM_WAKE "wake"
+extern protoop_id_t PROTOOP_NOPARAM_WAKE;
+
 /*
     MP: We may want to merge the two ops below into one a define a separate set of enums to describe the stream states
     as defined in the QUIC specs, e.g. https://tools.ietf.org/html/draft-ietf-quic-transport-15#section-9.2.
@@ -26,6 +26,7 @@
 #include <string.h>
 #include "plugin.h"
 #include "memory.h"
+#include "probes.h"
 #include <ifaddrs.h>
 #include <net/if.h>
 #ifndef _WINDOWS
@@ -52,23 +53,7 @@ typedef struct st_picoquic_net_id_t {
     struct st_picoquic_net_id_t* next_net_id;
 } picoquic_net_id;
 
-/* Hash and compare for CNX hash tables */
-static uint64_t picoquic_cnx_id_hash(void* key)
-{
-    picoquic_cnx_id* cid = (picoquic_cnx_id*)key;
-
-    /* TODO: should scramble the value for security and DOS protection */
-    return picoquic_val64_connection_id(cid->cnx_id);
-}
-
-static int picoquic_cnx_id_compare(void* key1, void* key2)
-{
-    picoquic_cnx_id* cid1 = (picoquic_cnx_id*)key1;
-    picoquic_cnx_id* cid2 = (picoquic_cnx_id*)key2;
-
-    return picoquic_compare_connection_id(&cid1->cnx_id, &cid2->cnx_id);
-}
-
+/* Hash and compare for the CNX by address hash table */
 static uint64_t picoquic_net_id_hash(void* key)
 {
     picoquic_net_id* net = (picoquic_net_id*)key;
@@ -159,6 +144,9 @@ const size_t picoquic_nb_supported_versions = sizeof(picoquic_supported_versions
 
 int picoquic_get_plugin_stats(picoquic_cnx_t *cnx, plugin_stat_t **statsptr, int nmemb) {
 
+    if (cnx->hibernated) {
+        picoquic_wake_cnx(cnx);
+    }
     protocol_operation_struct_t *ops = (cnx->ops);
     protocol_operation_struct_t *current_post, *tmp_protoop;
     protocol_operation_param_struct_t *current_popst, *tmp_popst;
@@ -193,6 +181,7 @@ int picoquic_get_plugin_stats(picoquic_cnx_t *cnx, plugin_stat_t **statsptr, int
                     stats[current_position].param = current_popst->param;
                     stats[current_position].count = current_popst->replace->count;
                     stats[current_position].total_execution_time = current_popst->replace->total_execution_time;
+                    stats[current_position].lowered = current_popst->replace->native != NULL;
                     current_position++;
                 }
 
@@ -213,6 +202,7 @@ int picoquic_get_plugin_stats(picoquic_cnx_t *cnx, plugin_stat_t **statsptr, int
                         stats[current_position].param = current_popst->param;
                         stats[current_position].count = cur->observer->count;
                         stats[current_position].total_execution_time = cur->observer->total_execution_time;
+                        stats[current_position].lowered = cur->observer->native != NULL;
                         cur = cur->next;
                         current_position++;
                     }
@@ -234,6 +224,7 @@ int picoquic_get_plugin_stats(picoquic_cnx_t *cnx, plugin_stat_t **statsptr, int
                         stats[current_position].param = current_popst->param;
                         stats[current_position].count = cur->observer->count;
                         stats[current_position].total_execution_time = cur->observer->total_execution_time;
+                        stats[current_position].lowered = cur->observer->native != NULL;
                         cur = cur->next;
                         current_position++;
                     }
@@ -255,6 +246,7 @@ int picoquic_get_plugin_stats(picoquic_cnx_t *cnx, plugin_stat_t **statsptr, int
                 stats[current_position].is_param = false;
                 stats[current_position].count = current_popst->replace->count;
                 stats[current_position].total_execution_time = current_popst->replace->total_execution_time;
+                stats[current_position].lowered = current_popst->replace->native != NULL;
                 current_position++;
             }
 
@@ -274,6 +266,7 @@ int picoquic_get_plugin_stats(picoquic_cnx_t *cnx, plugin_stat_t **statsptr, int
                     stats[current_position].is_param = false;
                     stats[current_position].count = cur->observer->count;
                     stats[current_position].total_execution_time = cur->observer->total_execution_time;
+                    stats[current_position].lowered = cur->observer->native != NULL;
                     cur = cur->next;
                     current_position++;
                 }
@@ -294,6 +287,7 @@ int picoquic_get_plugin_stats(picoquic_cnx_t *cnx, plugin_stat_t **statsptr, int
                     stats[current_position].is_param = false;
                     stats[current_position].count = cur->observer->count;
                     stats[current_position].total_execution_time = cur->observer->total_execution_time;
+                    stats[current_position].lowered = cur->observer->native != NULL;
                     cur = cur->next;
                     current_position++;
                 }
@@ -380,8 +374,10 @@ void picoquic_free_plugins(protoop_plugin_t *plugins)
         /* This remains safe to do this, as the memory of the frame context will be freed when cnx will */
         queue_free(current_p->block_queue_cc);
         queue_free(current_p->block_queue_non_cc);
+        plugin_release_rings(current_p);
+        free(current_p->hibernation_state);
         destroy_memory_management(current_p);
-        free(current_p);
+        plugin_release(current_p);
     }
 }
 
@@ -560,6 +556,8 @@ picoquic_quic_t* picoquic_create(uint32_t nb_connections,
         quic->cnx_id_callback_ctx = cnx_id_callback_ctx;
         quic->p_simulated_time = p_simulated_time;
         quic->local_ctx_length = 8; /* TODO: should be lower on clients-only implementation */
+        quic->stateless_rate_burst = PICOQUIC_STATELESS_RATE_BURST;
+        quic->stateless_rate_per_second = PICOQUIC_STATELESS_RATE_PER_SECOND;
 
         if (cnx_id_callback != NULL) {
             quic->flags |= picoquic_context_unconditional_cnx_id;
@@ -579,8 +577,7 @@ picoquic_quic_t* picoquic_create(uint32_t nb_connections,
     }
 
     if (ret == 0) {
-        quic->table_cnx_by_id = picohash_create(nb_connections * 4,
-            picoquic_cnx_id_hash, picoquic_cnx_id_compare);
+        quic->table_cnx_by_id = picoquic_cid_table_create(nb_connections * 4, picoquic_public_random_64());
 
         quic->table_cnx_by_net = picohash_create(nb_connections * 4,
             picoquic_net_id_hash, picoquic_net_id_compare);
@@ -657,7 +654,17 @@ void picoquic_free(picoquic_quic_t* quic)
         while (quic->pending_stateless_packet != NULL) {
             picoquic_stateless_packet_t* to_delete = quic->pending_stateless_packet;
             quic->pending_stateless_packet = to_delete->next_packet;
-            free(to_delete);
+            picoquic_delete_stateless_packet(to_delete);
+        }
+        quic->pending_stateless_last = NULL;
+
+        if (quic->stateless_pool != NULL) {
+            if (quic->stateless_pool->nb_in_use == 0) {
+                free(quic->stateless_pool);
+            } else {
+                quic->stateless_pool->is_orphan = 1;
+            }
+            quic->stateless_pool = NULL;
         }
 
         /* delete all the connection contexts */
@@ -665,10 +672,24 @@ void picoquic_free(picoquic_quic_t* quic)
             picoquic_delete_cnx(quic->cnx_list);
         }
 
+        /* No connection is parked anymore */
+        (void)picoquic_set_async_handshake(quic, 0);
+
         if (quic->table_cnx_by_id != NULL) {
-            picohash_delete(quic->table_cnx_by_id, 1);
+            picoquic_cid_table_free(quic->table_cnx_by_id);
         }
 
+        if (quic->metrics_exporter != NULL) {
+            picoquic_metrics_exporter_free(quic->metrics_exporter);
+            quic->metrics_exporter = NULL;
+        }
+
+        (void)picoquic_set_binlog(quic, NULL);
+
+        (void)picoquic_set_async_log(quic, NULL, picoquic_log_overload_block, 0);
+
+        (void) picoquic_set_local_addresses(quic, NULL, NULL, 0);
+
         if (quic->table_cnx_by_net != NULL) {
             picohash_delete(quic->table_cnx_by_net, 1);
         }
@@ -700,6 +721,12 @@ void picoquic_free(picoquic_quic_t* quic)
             queue_free(quic->cached_plugins_queue);
         }
 
+        /* After the connections and the cached plugins, which hold the huge pages */
+        if (quic->huge_memory != NULL) {
+            picoquic_huge_memory_free(quic->huge_memory);
+            quic->huge_memory = NULL;
+        }
+
         if (quic->supported_plugins.size > 0) {
             for (int i = 0; i < quic->supported_plugins.size; i++) {
                 free(quic->supported_plugins.elems[i].plugin_name);
@@ -732,29 +759,425 @@ void picoquic_set_cookie_mode(picoquic_quic_t* quic, int cookie_mode)
     }
 }
 
-picoquic_stateless_packet_t* picoquic_create_stateless_packet(picoquic_quic_t* quic)
+void picoquic_set_stateless_rate_limit(picoquic_quic_t* quic, uint32_t burst, uint32_t packets_per_second)
 {
-#ifdef _WINDOWS
-    UNREFERENCED_PARAMETER(quic);
-#endif
-    return (picoquic_stateless_packet_t*)malloc(sizeof(picoquic_stateless_packet_t));
+    quic->stateless_rate_burst = burst;
+    quic->stateless_rate_per_second = packets_per_second;
+
+    if (quic->stateless_pool != NULL) {
+        for (int i = 0; i < PICOQUIC_STATELESS_RATE_BINS; i++) {
+            quic->stateless_pool->rate_bins[i].last_refill_time = 0;
+            quic->stateless_pool->rate_bins[i].tokens = burst;
+        }
+    }
 }
 
-void picoquic_delete_stateless_packet(picoquic_stateless_packet_t* sp)
+uint64_t picoquic_get_stateless_queued(picoquic_quic_t* quic)
 {
-    free(sp);
+    return quic->nb_stateless_queued;
 }
 
-void picoquic_queue_stateless_packet(picoquic_quic_t* quic, picoquic_stateless_packet_t* sp)
+uint64_t picoquic_get_stateless_dropped_overflow(picoquic_quic_t* quic)
+{
+    return quic->nb_stateless_dropped_overflow;
+}
+
+uint64_t picoquic_get_stateless_dropped_rate_limited(picoquic_quic_t* quic)
+{
+    return quic->nb_stateless_dropped_rate_limited;
+}
+
+int picoquic_set_metrics_exporter(picoquic_quic_t* quic, const char* destination)
+{
+    int ret = 0;
+
+    if (quic->metrics_exporter != NULL) {
+        picoquic_metrics_exporter_free(quic->metrics_exporter);
+        quic->metrics_exporter = NULL;
+    }
+
+    quic->metrics_export_disabled = (destination == NULL);
+
+    if (destination != NULL) {
+        quic->metrics_exporter = picoquic_metrics_exporter_create(destination);
+        if (quic->metrics_exporter == NULL) {
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
+int picoquic_set_huge_memory(picoquic_quic_t* quic, int enable)
+{
+    int ret = 0;
+
+    if (quic->huge_memory != NULL) {
+        const picoquic_huge_memory_stats_t* stats = picoquic_huge_memory_stats(quic->huge_memory);
+        if (stats->packets_in_use > 0 || stats->nb_regions > stats->nb_packet_chunks) {
+            ret = -1;
+        } else if (!enable) {
+            picoquic_huge_memory_free(quic->huge_memory);
+            quic->huge_memory = NULL;
+        }
+    } else if (enable) {
+        quic->huge_memory = picoquic_huge_memory_create();
+        if (quic->huge_memory == NULL) {
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
+const picoquic_huge_memory_stats_t* picoquic_get_huge_memory_stats(picoquic_quic_t* quic)
+{
+    return (quic->huge_memory == NULL) ? NULL : picoquic_huge_memory_stats(quic->huge_memory);
+}
+
+int picoquic_set_async_log(picoquic_quic_t* quic, FILE* F_sink, picoquic_log_overload_enum overload, uint32_t sample_rate)
+{
+    int ret = 0;
+
+    if (quic->log_writer != NULL) {
+        if (quic->F_log == (void*)picoquic_log_writer_get_file(quic->log_writer)) {
+            quic->F_log = NULL;
+        }
+        picoquic_log_writer_free(quic->log_writer);
+        quic->log_writer = NULL;
+    }
+
+    if (F_sink != NULL) {
+        quic->log_writer = picoquic_log_writer_create(F_sink, overload, sample_rate);
+        if (quic->log_writer == NULL) {
+            ret = -1;
+        } else {
+            quic->F_log = (void*)picoquic_log_writer_get_file(quic->log_writer);
+        }
+    }
+
+    return ret;
+}
+
+int picoquic_get_async_log_stats(picoquic_quic_t* quic, picoquic_log_writer_stats_t* stats)
+{
+    if (quic->log_writer == NULL) {
+        return -1;
+    }
+    picoquic_log_writer_get_stats(quic->log_writer, stats);
+
+    return 0;
+}
+
+int picoquic_set_async_handshake(picoquic_quic_t* quic, int nb_threads)
+{
+    int ret = 0;
+
+    if (quic->nb_tls_parked > 0) {
+        ret = -1;
+    } else {
+        picoquic_tls_pool_free(quic->tls_pool);
+        quic->tls_pool = NULL;
+
+        if (nb_threads > 0 && (quic->tls_pool = picoquic_tls_pool_create(nb_threads)) == NULL) {
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
+int picoquic_get_async_handshake_fd(picoquic_quic_t* quic)
+{
+    return (quic->tls_pool == NULL) ? -1 : picoquic_tls_pool_get_eventfd(quic->tls_pool);
+}
+
+int picoquic_get_async_handshake_stats(picoquic_quic_t* quic, picoquic_tls_pool_stats_t* stats)
+{
+    if (quic->tls_pool == NULL) {
+        return -1;
+    }
+    picoquic_tls_pool_get_stats(quic->tls_pool, stats);
+
+    return 0;
+}
+
+void picoquic_set_hibernation_delay(picoquic_quic_t* quic, uint64_t delay)
+{
+    quic->hibernation_delay = delay;
+}
+
+int picoquic_is_hibernated(picoquic_cnx_t* cnx)
+{
+    return cnx->hibernated;
+}
+
+int picoquic_get_nb_hibernated(picoquic_quic_t* quic)
+{
+    return quic->nb_hibernated;
+}
+
+/* Nothing to send, to repeat or to acknowledge */
+static int picoquic_cnx_is_quiet(picoquic_cnx_t* cnx)
+{
+    if (cnx->tls_pending || cnx->first_misc_frame != NULL ||
+        queue_peek(cnx->reserved_frames) != NULL || queue_peek(cnx->retry_frames) != NULL) {
+        return 0;
+    }
+
+    for (int pc = 0; pc < picoquic_nb_packet_context; pc++) {
+        if (queue_peek(cnx->rtx_frames[pc]) != NULL) {
+            return 0;
+        }
+    }
+
+    for (int epoch = 0; epoch < PICOQUIC_NUMBER_OF_EPOCHS; epoch++) {
+        if (cnx->tls_stream[epoch].send_queue != NULL) {
+            return 0;
+        }
+    }
+
+    for (picoquic_stream_head* stream = cnx->first_stream; stream != NULL; stream = stream->next_stream) {
+        if (stream->send_queue != NULL) {
+            return 0;
+        }
+    }
+
+    for (picoquic_stream_head* stream = cnx->first_plugin_stream; stream != NULL; stream = stream->next_stream) {
+        if (stream->send_queue != NULL) {
+            return 0;
+        }
+    }
+
+    protoop_plugin_t *p, *tmp_p;
+    HASH_ITER(hh, cnx->plugins, p, tmp_p) {
+        if (queue_peek(p->block_queue_cc) != NULL || queue_peek(p->block_queue_non_cc) != NULL) {
+            return 0;
+        }
+    }
+
+    for (int i = 0; i < cnx->nb_paths; i++) {
+        for (int pc = 0; pc < picoquic_nb_packet_context; pc++) {
+            picoquic_packet_context_t* pkt_ctx = &cnx->path[i]->pkt_ctx[pc];
+
+            if (pkt_ctx->retransmit_newest != NULL || pkt_ctx->ack_needed) {
+                return 0;
+            }
+        }
+    }
+
+    return 1;
+}
+
+/*
+ * Hibernation of the idle connections.
+ *
+ * Once a connection is ready and quiet for the hibernation delay, the table
+ * of protocol operations, which every connection without plugin holds in the
+ * same version, is freed with the structures kept for late acknowledgements.
+ * The transport state stays in the connection context. Since every processing
+ * of the connection goes through a protocol operation, the table is rebuilt by
+ * plugin_run_protoop_internal on the next packet, timer or application call.
+ * The table of a connection with plugins is kept, but the memory of the plugins
+ * which saved their state in the hibernate operation is released, see plugin.h.
+ */
+void picoquic_hibernate_if_idle(picoquic_cnx_t* cnx, uint64_t current_time)
 {
-    picoquic_stateless_packet_t** pnext = &quic->pending_stateless_packet;
+    picoquic_quic_t* quic = cnx->quic;
 
-    while ((*pnext) != NULL) {
-        pnext = &(*pnext)->next_packet;
+    if (quic->hibernation_delay == 0 || cnx->hibernated ||
+        (cnx->cnx_state != picoquic_state_client_ready && cnx->cnx_state != picoquic_state_server_ready) ||
+        current_time < cnx->latest_activity_time + quic->hibernation_delay || !picoquic_cnx_is_quiet(cnx)) {
+        return;
     }
 
-    *pnext = sp;
+    if (protoop_prepare_and_run_noparam(cnx, &PROTOOP_NOPARAM_HIBERNATE, NULL, current_time) != 0) {
+        plugin_drop_hibernation_states(cnx);
+        return;
+    }
+
+    for (int i = 0; i < cnx->nb_paths; i++) {
+        for (int pc = 0; pc < picoquic_nb_packet_context; pc++) {
+            picoquic_packet_context_t* pkt_ctx = &cnx->path[i]->pkt_ctx[pc];
+
+            /* Too late to detect a spurious retransmission */
+            while (pkt_ctx->retransmitted_oldest != NULL) {
+                picoquic_dequeue_retransmitted_packet(cnx, pkt_ctx->retransmitted_oldest);
+            }
+            picoquic_retransmit_index_free(pkt_ctx);
+            pkt_ctx->retransmit_index_size = 0;
+            pkt_ctx->retransmit_index_retry = 0;
+        }
+    }
+
+    picoquic_binlog_release_cnx(cnx);
+
+    if (cnx->plugins == NULL) {
+        picoquic_free_protoops(cnx->ops);
+        cnx->ops = NULL;
+    } else {
+        plugin_hibernate_plugins(cnx);
+    }
+
+    cnx->hibernated = 1;
+    quic->nb_hibernated++;
+}
+
+void picoquic_wake_cnx(picoquic_cnx_t* cnx)
+{
+    cnx->hibernated = 0;
+    cnx->quic->nb_hibernated--;
+
+    if (cnx->ops == NULL) {
+        packet_register_noparam_protoops(cnx);
+        frames_register_noparam_protoops(cnx);
+        sender_register_noparam_protoops(cnx);
+        quicctx_register_noparam_protoops(cnx);
+    } else {
+        plugin_wake_plugins(cnx);
+    }
+}
+
+int picoquic_export_metrics(picoquic_cnx_t* cnx, uint16_t type, const uint8_t* data, size_t length)
+{
+    picoquic_quic_t* quic = cnx->quic;
+
+    if (quic->metrics_exporter == NULL) {
+        if (quic->metrics_export_disabled ||
+            picoquic_set_metrics_exporter(quic, PICOQUIC_METRICS_DEFAULT_DESTINATION) != 0) {
+            quic->metrics_export_disabled = 1;
+            return -1;
+        }
+    }
+
+    return picoquic_metrics_exporter_push(quic->metrics_exporter, type, data, length, picoquic_get_quic_time(quic));
+}
+
+static picoquic_stateless_pool_t* picoquic_stateless_pool_create(picoquic_quic_t* quic)
+{
+    picoquic_stateless_pool_t* pool = (picoquic_stateless_pool_t*)malloc(sizeof(picoquic_stateless_pool_t));
+
+    if (pool != NULL) {
+        pool->free_list = NULL;
+        pool->nb_in_use = 0;
+        pool->is_orphan = 0;
+        for (int i = PICOQUIC_STATELESS_POOL_SIZE - 1; i >= 0; i--) {
+            pool->slots[i].pool = pool;
+            pool->slots[i].next_packet = pool->free_list;
+            pool->free_list = &pool->slots[i];
+        }
+        for (int i = 0; i < PICOQUIC_STATELESS_RATE_BINS; i++) {
+            pool->rate_bins[i].last_refill_time = 0;
+            pool->rate_bins[i].tokens = quic->stateless_rate_burst;
+        }
+    }
+
+    return pool;
+}
+
+/*
+ * Token bucket per source prefix. The prefix is the /24 of IPv4 addresses
+ * and the /48 of IPv6 addresses, so that a spoofing host cannot escape the
+ * limit by varying the low order bits.
+ */
+static int picoquic_stateless_rate_check(picoquic_quic_t* quic, struct sockaddr* addr_peer, uint64_t current_time)
+{
+    picoquic_stateless_rate_bin_t* bin;
+    uint8_t prefix[7];
+    uint64_t h;
+
+    if (quic->stateless_rate_burst == 0 || addr_peer == NULL) {
+        return 1;
+    }
+
+    /* The family is part of the key, so that a /24 and a /48 sharing the
+     * same leading bytes do not drain each other's bucket. */
+    if (addr_peer->sa_family == AF_INET) {
+        prefix[0] = 4;
+        memcpy(prefix + 1, &((struct sockaddr_in*)addr_peer)->sin_addr, 3);
+        h = picohash_bytes(prefix, 4);
+    } else if (addr_peer->sa_family == AF_INET6) {
+        prefix[0] = 6;
+        memcpy(prefix + 1, &((struct sockaddr_in6*)addr_peer)->sin6_addr, 6);
+        h = picohash_bytes(prefix, 7);
+    } else {
+        return 1;
+    }
+
+    bin = &quic->stateless_pool->rate_bins[h % PICOQUIC_STATELESS_RATE_BINS];
+
+    if (current_time > bin->last_refill_time) {
+        uint64_t refill = ((current_time - bin->last_refill_time) * quic->stateless_rate_per_second) / 1000000;
+
+        if (refill > 0) {
+            uint64_t tokens = bin->tokens + refill;
+            bin->tokens = (tokens > quic->stateless_rate_burst) ? quic->stateless_rate_burst : (uint32_t)tokens;
+            bin->last_refill_time = current_time;
+        }
+    }
+
+    if (bin->tokens == 0) {
+        return 0;
+    }
+
+    bin->tokens--;
+    return 1;
+}
+
+picoquic_stateless_packet_t* picoquic_create_stateless_packet(picoquic_quic_t* quic, struct sockaddr* addr_peer)
+{
+    picoquic_stateless_packet_t* sp = NULL;
+
+    if (quic->stateless_pool == NULL) {
+        quic->stateless_pool = picoquic_stateless_pool_create(quic);
+        if (quic->stateless_pool == NULL) {
+            quic->nb_stateless_dropped_overflow++;
+            return NULL;
+        }
+    }
+
+    /* Check the pool first, so that an overflow does not consume the
+     * token of the source prefix. */
+    if (quic->stateless_pool->free_list == NULL) {
+        quic->nb_stateless_dropped_overflow++;
+    } else if (!picoquic_stateless_rate_check(quic, addr_peer, picoquic_get_quic_time(quic))) {
+        quic->nb_stateless_dropped_rate_limited++;
+    } else {
+        sp = quic->stateless_pool->free_list;
+        quic->stateless_pool->free_list = sp->next_packet;
+        quic->stateless_pool->nb_in_use++;
+        sp->next_packet = NULL;
+    }
+
+    return sp;
+}
+
+void picoquic_delete_stateless_packet(picoquic_stateless_packet_t* sp)
+{
+    if (sp->pool != NULL) {
+        picoquic_stateless_pool_t* pool = (picoquic_stateless_pool_t*)sp->pool;
+        sp->next_packet = pool->free_list;
+        pool->free_list = sp;
+        pool->nb_in_use--;
+        if (pool->is_orphan && pool->nb_in_use == 0) {
+            free(pool);
+        }
+    } else {
+        free(sp);
+    }
+}
+
+void picoquic_queue_stateless_packet(picoquic_quic_t* quic, picoquic_stateless_packet_t* sp)
+{
     sp->next_packet = NULL;
+
+    if (quic->pending_stateless_last == NULL) {
+        quic->pending_stateless_packet = sp;
+    } else {
+        quic->pending_stateless_last->next_packet = sp;
+    }
+    quic->pending_stateless_last = sp;
+    quic->nb_stateless_queued++;
 }
 
 picoquic_stateless_packet_t* picoquic_dequeue_stateless_packet(picoquic_quic_t* quic)
@@ -763,12 +1186,27 @@ picoquic_stateless_packet_t* picoquic_dequeue_stateless_packet(picoquic_quic_t*
 
     if (sp != NULL) {
         quic->pending_stateless_packet = sp->next_packet;
+        if (quic->pending_stateless_packet == NULL) {
+            quic->pending_stateless_last = NULL;
+        }
         sp->next_packet = NULL;
     }
 
     return sp;
 }
 
+/* Dequeue up to sp_max packets at once, e.g. to send them with a single sendmmsg */
+size_t picoquic_dequeue_stateless_packets(picoquic_quic_t* quic, picoquic_stateless_packet_t** sp, size_t sp_max)
+{
+    size_t nb_sp = 0;
+
+    while (nb_sp < sp_max && (sp[nb_sp] = picoquic_dequeue_stateless_packet(quic)) != NULL) {
+        nb_sp++;
+    }
+
+    return nb_sp;
+}
+
 /* Connection context creation and registration */
 int picoquic_register_cnx_id(picoquic_quic_t* quic, picoquic_cnx_t* cnx, const picoquic_connection_id_t* cnx_id)
 {
@@ -778,25 +1216,22 @@ int picoquic_register_cnx_id(picoquic_quic_t* quic, picoquic_cnx_t* cnx, const p
     if (key == NULL) {
         ret = -1;
     } else {
-        picohash_item* item;
         key->cnx_id = *cnx_id;
         key->cnx = cnx;
         key->next_cnx_id = NULL;
 
-        item = picohash_retrieve(quic->table_cnx_by_id, key);
-
-        if (item != NULL) {
-            ret = -1;
-        } else {
-            ret = picohash_insert(quic->table_cnx_by_id, key);
+        ret = picoquic_cid_table_insert(quic->table_cnx_by_id, cnx_id, cnx);
 
-            if (ret == 0) {
-                key->next_cnx_id = cnx->first_cnx_id;
-                cnx->first_cnx_id = key;
-            }
+        if (ret == 0) {
+            key->next_cnx_id = cnx->first_cnx_id;
+            cnx->first_cnx_id = key;
         }
     }
 
+    if (key != NULL && ret != 0) {
+        free(key);
+    }
+
     return ret;
 }
 
@@ -876,6 +1311,7 @@ void picoquic_init_transport_parameters(picoquic_tp_t* tp, int client_mode)
     tp->max_idle_timeout = PICOQUIC_MICROSEC_HANDSHAKE_MAX/1000;
     tp->max_packet_size = PICOQUIC_PRACTICAL_MAX_MTU;
     tp->ack_delay_exponent = 3;
+    tp->min_ack_delay = 0; /* ACK frequency is opt-in, see PICOQUIC_ACK_FREQUENCY_MIN_DELAY */
     tp->supported_plugins = NULL;
     tp->plugins_to_inject = NULL;
 }
@@ -1138,7 +1574,14 @@ int picoquic_create_path(picoquic_cnx_t* cnx, uint64_t start_time, struct sockad
                 path_x->pkt_ctx[pc].latest_time_acknowledged = start_time;
                 path_x->pkt_ctx[pc].latest_progress_time = start_time;
                 path_x->pkt_ctx[pc].ack_needed = 0;
+                path_x->pkt_ctx[pc].nb_ack_eliciting_received = 0;
                 path_x->pkt_ctx[pc].ack_delay_local = 10000;
+                path_x->pkt_ctx[pc].ack_eliciting_threshold = 1;
+                path_x->pkt_ctx[pc].reordering_threshold = 1;
+                path_x->pkt_ctx[pc].loss_time = UINT64_MAX;
+                path_x->pkt_ctx[pc].reorder_window = 0;
+                path_x->pkt_ctx[pc].nb_losses_since_reorder = 0;
+                path_x->pkt_ctx[pc].loss_timer_armed = 0;
             }
 
             /* And start the congestion algorithm */
@@ -1305,6 +1748,7 @@ picoquic_cnx_t* picoquic_create_cnx(picoquic_quic_t* quic,
             /* Moved packet context initialization into path creation */
 
             cnx->latest_progress_time = start_time;
+            cnx->latest_activity_time = start_time;
 
             for (int epoch = 0; epoch < PICOQUIC_NUMBER_OF_EPOCHS; epoch++) {
                 cnx->tls_stream[epoch].stream_id = 0;
@@ -1764,6 +2208,8 @@ void picoquic_reset_packet_context(picoquic_cnx_t* cnx,
         picoquic_dequeue_retransmit_packet(cnx, pkt_ctx->retransmit_newest, 1);
     }
 
+    picoquic_retransmit_index_free(pkt_ctx);
+
     while (pkt_ctx->retransmitted_newest != NULL) {
         picoquic_dequeue_retransmitted_packet(cnx, pkt_ctx->retransmitted_newest);
     }
@@ -1928,6 +2374,14 @@ void picoquic_delete_cnx(picoquic_cnx_t* cnx)
     picoquic_misc_frame_header_t* misc_frame;
 
     if (cnx != NULL) {
+        /* The worker of a parked connection must be done with it */
+        picoquic_tls_async_cancel(cnx);
+
+        /* The protocol operations are cached by the servers */
+        if (cnx->hibernated) {
+            picoquic_wake_cnx(cnx);
+        }
+
         if (cnx->cnx_state < picoquic_state_disconnected) {
             /* Give the application a chance to clean up its state */
             picoquic_set_cnx_state(cnx, picoquic_state_disconnected);
@@ -1936,6 +2390,8 @@ void picoquic_delete_cnx(picoquic_cnx_t* cnx)
             }
         }
 
+        picoquic_binlog_release_cnx(cnx);
+
         if (cnx->alpn != NULL) {
             free((void*)cnx->alpn);
             cnx->alpn = NULL;
@@ -1946,16 +2402,16 @@ void picoquic_delete_cnx(picoquic_cnx_t* cnx)
             cnx->sni = NULL;
         }
 
+        if (cnx->quic->last_cnx_by_id == cnx) {
+            cnx->quic->last_cnx_by_id = NULL;
+        }
+
         while (cnx->first_cnx_id != NULL) {
-            picohash_item* item;
             picoquic_cnx_id* cnx_id_key = cnx->first_cnx_id;
             cnx->first_cnx_id = cnx_id_key->next_cnx_id;
-            cnx_id_key->next_cnx_id = NULL;
 
-            item = picohash_retrieve(cnx->quic->table_cnx_by_id, cnx_id_key);
-            if (item != NULL) {
-                picohash_item_delete(cnx->quic->table_cnx_by_id, item, 1);
-            }
+            (void)picoquic_cid_table_remove(cnx->quic->table_cnx_by_id, &cnx_id_key->cnx_id);
+            free(cnx_id_key);
         }
 
         while (cnx->first_net_id != NULL) {
@@ -2018,13 +2474,7 @@ void picoquic_delete_cnx(picoquic_cnx_t* cnx)
                 }
 
                 /* Free the metadata */
-                if (cnx->path[i]->metadata) {
-                    plugin_struct_metadata_t *current_md, *tmp;
-                    HASH_ITER(hh, cnx->path[i]->metadata, current_md, tmp) {
-                        HASH_DEL(cnx->path[i]->metadata, current_md);
-                        free(current_md);
-                    }
-                }
+                free(cnx->path[i]->metadata.extra_slots);
                 free(cnx->path[i]);
                 cnx->path[i] = NULL;
             }
@@ -2071,13 +2521,8 @@ void picoquic_delete_cnx(picoquic_cnx_t* cnx)
         }
 
         /* Free the metadata */
-        if (cnx->metadata) {
-            plugin_struct_metadata_t *current_md, *tmp;
-            HASH_ITER(hh, cnx->metadata, current_md, tmp) {
-                HASH_DEL(cnx->metadata, current_md);
-                free(current_md);
-            }
-        }
+        free(cnx->metadata.extra_slots);
+        memset(&cnx->metadata, 0, sizeof(cnx->metadata));
 
         /* Free possibly allocated memory in pids to request */
         for (int i = 0; i < cnx->pids_to_request.size; i++) {
@@ -2123,19 +2568,24 @@ int picoquic_is_handshake_error(uint64_t error_code)
 /* Context retrieval functions */
 picoquic_cnx_t* picoquic_cnx_by_id(picoquic_quic_t* quic, picoquic_connection_id_t cnx_id)
 {
-    picoquic_cnx_t* ret = NULL;
-    picohash_item* item;
-    picoquic_cnx_id key;
-
-    memset(&key, 0, sizeof(key));
-    key.cnx_id = cnx_id;
+    return (picoquic_cnx_t*)picoquic_cid_table_lookup(quic->table_cnx_by_id, &cnx_id);
+}
 
-    item = picohash_retrieve(quic->table_cnx_by_id, &key);
+/* Consecutive short header packets are mostly for the same connection, whose lookup is kept */
+picoquic_cnx_t* picoquic_cnx_by_id_cached(picoquic_quic_t* quic, const picoquic_connection_id_t* cnx_id)
+{
+    picoquic_cnx_t* cnx = quic->last_cnx_by_id;
 
-    if (item != NULL) {
-        ret = ((picoquic_cnx_id*)item->key)->cnx;
+    if (cnx == NULL || quic->last_cnx_id.id_len != cnx_id->id_len ||
+        memcmp(quic->last_cnx_id.id, cnx_id->id, cnx_id->id_len) != 0) {
+        cnx = (picoquic_cnx_t*)picoquic_cid_table_lookup(quic->table_cnx_by_id, cnx_id);
+        if (cnx != NULL) {
+            quic->last_cnx_id = *cnx_id;
+            quic->last_cnx_by_id = cnx;
+        }
     }
-    return ret;
+
+    return cnx;
 }
 
 picoquic_cnx_t* picoquic_cnx_by_net(picoquic_quic_t* quic, struct sockaddr* addr)
@@ -2197,8 +2647,11 @@ protoop_arg_t congestion_algorithm_notify(picoquic_cnx_t *cnx)
     uint64_t current_time = (uint64_t) cnx->protoop_inputv[5];
 
     if (cnx->congestion_alg != NULL) {
+        uint64_t cwin_before = path_x->cwin;
+
         cnx->congestion_alg->alg_notify(path_x, notification, rtt_measurement,
             nb_bytes_acknowledged, lost_packet_number, current_time);
+        PICOQUIC_PROBE5(congestion_notify, cnx, path_x, notification, cwin_before, path_x->cwin);
     }
     return 0;
 }
@@ -2369,6 +2822,51 @@ int picoquic_getaddrs(struct sockaddr_storage *sas, uint32_t *if_indexes, int sa
     return count;
 }
 
+int picoquic_set_local_addresses(picoquic_quic_t* quic, const struct sockaddr_storage* sas, const uint32_t* if_indexes, int nb_addrs)
+{
+    free(quic->local_addrs);
+    free(quic->local_addr_if_indexes);
+    quic->local_addrs = NULL;
+    quic->local_addr_if_indexes = NULL;
+    quic->nb_local_addrs = 0;
+
+    if (sas != NULL && nb_addrs > 0) {
+        quic->local_addrs = (struct sockaddr_storage*) malloc(nb_addrs * sizeof(struct sockaddr_storage));
+        quic->local_addr_if_indexes = (uint32_t*) malloc(nb_addrs * sizeof(uint32_t));
+        if (quic->local_addrs == NULL || quic->local_addr_if_indexes == NULL) {
+            free(quic->local_addrs);
+            free(quic->local_addr_if_indexes);
+            quic->local_addrs = NULL;
+            quic->local_addr_if_indexes = NULL;
+            return PICOQUIC_ERROR_MEMORY;
+        }
+        memcpy(quic->local_addrs, sas, nb_addrs * sizeof(struct sockaddr_storage));
+        for (int i = 0; i < nb_addrs; i++) {
+            quic->local_addr_if_indexes[i] = (if_indexes != NULL) ? if_indexes[i] : (uint32_t) (i + 1);
+        }
+        quic->nb_local_addrs = nb_addrs;
+    }
+
+    return 0;
+}
+
+int picoquic_get_local_addresses(picoquic_cnx_t* cnx, struct sockaddr_storage* sas, uint32_t* if_indexes, int sas_length)
+{
+    picoquic_quic_t* quic = cnx->quic;
+    int count = 0;
+
+    if (quic->nb_local_addrs == 0) {
+        return picoquic_getaddrs(sas, if_indexes, sas_length);
+    }
+
+    for (; count < quic->nb_local_addrs && count < sas_length; count++) {
+        memcpy(&sas[count], &quic->local_addrs[count], sizeof(struct sockaddr_storage));
+        if_indexes[count] = quic->local_addr_if_indexes[count];
+    }
+
+    return count;
+}
+
 /**
  * See PROTOOP_NOPARAM_PRINTF
  */
@@ -2660,6 +3158,8 @@ bool picoquic_has_booked_plugin_frames(picoquic_cnx_t *cnx)
 void quicctx_register_noparam_protoops(picoquic_cnx_t *cnx)
 {
     register_noparam_protoop(cnx, &PROTOOP_NOPARAM_CONNECTION_STATE_CHANGED, &protoop_noop);
+    register_noparam_protoop(cnx, &PROTOOP_NOPARAM_HIBERNATE, &protoop_noop);
+    register_noparam_protoop(cnx, &PROTOOP_NOPARAM_WAKE, &protoop_noop);
     register_noparam_protoop(cnx, &PROTOOP_NOPARAM_CONGESTION_ALGORITHM_NOTIFY, &congestion_algorithm_notify);
     register_noparam_protoop(cnx, &PROTOOP_NOPARAM_CALLBACK_FUNCTION, &callback_function);
     register_noparam_protoop(cnx, &PROTOOP_NOPARAM_PRINTF, &protoop_printf);
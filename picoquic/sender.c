@@ -27,6 +27,7 @@
 #include "plugin.h"
 #include "memory.h"
 #include "logger.h"
+#include "probes.h"
 
 /*
  * Sending logic.
@@ -273,11 +274,14 @@ int picoquic_add_to_plugin_stream(picoquic_cnx_t* cnx, uint64_t pid_id,
 
 picoquic_packet_t* picoquic_create_packet(picoquic_cnx_t *cnx)
 {
-    picoquic_packet_t* packet = (picoquic_packet_t*)malloc(sizeof(picoquic_packet_t));
+    picoquic_huge_memory_t* huge_memory = (cnx != NULL && cnx->quic != NULL) ? cnx->quic->huge_memory : NULL;
+    picoquic_packet_t* packet = (huge_memory != NULL) ? picoquic_huge_packet_alloc(huge_memory) :
+        (picoquic_packet_t*)malloc(sizeof(picoquic_packet_t));
 
     if (packet != NULL) {
         memset(packet, 0, sizeof(picoquic_packet_t));
         packet->is_pure_ack = 1;
+        packet->huge_memory = huge_memory;
     }
 
     return packet;
@@ -285,16 +289,12 @@ picoquic_packet_t* picoquic_create_packet(picoquic_cnx_t *cnx)
 
 void picoquic_destroy_packet(picoquic_packet_t *p)
 {
-    if (p->metadata) {
-
-        plugin_struct_metadata_t *current_md, *tmp;
-
-        HASH_ITER(hh, p->metadata, current_md, tmp) {
-            HASH_DEL(p->metadata,current_md);  /* delete; users advances to next */
-            free(current_md);            /* optional- if you want to free  */
-        }
+    free(p->metadata.extra_slots);
+    if (p->huge_memory != NULL) {
+        picoquic_huge_packet_release(p->huge_memory, p);
+    } else {
+        free(p);
     }
-    free(p);
 }
 
 void picoquic_update_payload_length(
@@ -586,6 +586,11 @@ uint32_t picoquic_protect_packet(picoquic_cnx_t* cnx,
                                       bytes, sequence_number, length,
                                       send_buffer, send_length);
     }
+    if (cnx->quic->binlog != NULL) {
+        picoquic_binlog_outgoing_segment(cnx->quic->binlog, cnx,
+                                         bytes, sequence_number, length,
+                                         send_buffer, send_length);
+    }
 
     /* Next, encrypt the PN -- The sample is located after the pn_offset */
     sample_offset = /* header_length */ pn_offset + 4;
@@ -727,6 +732,107 @@ void picoquic_update_pacing_after_send(picoquic_path_t * path_x, uint64_t curren
 }
 
 
+/*
+ * Index of the retransmit queue by sequence number. Sequence numbers are
+ * queued in increasing order, so a ring of pointers larger than the span
+ * between the oldest and the newest queued packets never has collisions.
+ *
+ * When the index cannot be built, because the allocation failed or the queue
+ * is out of order, the queue is searched linearly and the next attempt waits
+ * for as many packets as the span of the queue, so that the rebuilds cost
+ * O(1) per queued packet.
+ */
+
+static void picoquic_retransmit_index_backoff(picoquic_packet_context_t* pkt_ctx)
+{
+    uint64_t newest = pkt_ctx->retransmit_newest->sequence_number;
+    uint64_t oldest = pkt_ctx->retransmit_oldest->sequence_number;
+    uint64_t span = (newest >= oldest) ? newest - oldest : pkt_ctx->retransmit_index_size;
+
+    picoquic_retransmit_index_free(pkt_ctx);
+    pkt_ctx->retransmit_index_retry = (span > PICOQUIC_RETRANSMIT_INDEX_MIN_SIZE) ? span : PICOQUIC_RETRANSMIT_INDEX_MIN_SIZE;
+}
+
+static void picoquic_retransmit_index_rebuild(picoquic_packet_context_t* pkt_ctx)
+{
+    uint64_t span = pkt_ctx->retransmit_newest->sequence_number - pkt_ctx->retransmit_oldest->sequence_number;
+    uint64_t size = (pkt_ctx->retransmit_index_size == 0) ? PICOQUIC_RETRANSMIT_INDEX_MIN_SIZE : pkt_ctx->retransmit_index_size;
+    picoquic_packet_t** index;
+
+    picoquic_retransmit_index_free(pkt_ctx);
+
+    if (pkt_ctx->retransmit_newest->sequence_number < pkt_ctx->retransmit_oldest->sequence_number) {
+        picoquic_retransmit_index_backoff(pkt_ctx);
+        return;
+    }
+
+    while (size <= span) {
+        size <<= 1;
+    }
+
+    index = (picoquic_packet_t**) calloc((size_t) size, sizeof(picoquic_packet_t*));
+    if (index == NULL) {
+        picoquic_retransmit_index_backoff(pkt_ctx);
+        return;
+    }
+
+    for (picoquic_packet_t* p = pkt_ctx->retransmit_newest; p != NULL; p = p->next_packet) {
+        if (p->next_packet != NULL && p->next_packet->sequence_number >= p->sequence_number) {
+            /* Still out of order */
+            free(index);
+            picoquic_retransmit_index_backoff(pkt_ctx);
+            return;
+        }
+        index[p->sequence_number & (size - 1)] = p;
+    }
+    pkt_ctx->retransmit_index = index;
+    pkt_ctx->retransmit_index_size = size;
+    pkt_ctx->retransmit_index_retry = 0;
+}
+
+static void picoquic_retransmit_index_add(picoquic_packet_context_t* pkt_ctx, picoquic_packet_t* packet)
+{
+    picoquic_packet_t* previous = packet->next_packet;
+
+    if (previous != NULL && previous->sequence_number >= packet->sequence_number) {
+        /* Out of order queuing, the index cannot be trusted anymore */
+        picoquic_retransmit_index_backoff(pkt_ctx);
+    } else if (pkt_ctx->retransmit_index == NULL && pkt_ctx->retransmit_index_retry > 0) {
+        pkt_ctx->retransmit_index_retry--;
+    } else if (pkt_ctx->retransmit_index == NULL ||
+        packet->sequence_number - pkt_ctx->retransmit_oldest->sequence_number >= pkt_ctx->retransmit_index_size) {
+        picoquic_retransmit_index_rebuild(pkt_ctx);
+    } else {
+        pkt_ctx->retransmit_index[packet->sequence_number & (pkt_ctx->retransmit_index_size - 1)] = packet;
+    }
+}
+
+static void picoquic_retransmit_index_remove(picoquic_packet_context_t* pkt_ctx, picoquic_packet_t* packet)
+{
+    if (pkt_ctx->retransmit_index != NULL) {
+        picoquic_packet_t** slot = &pkt_ctx->retransmit_index[packet->sequence_number & (pkt_ctx->retransmit_index_size - 1)];
+        if (*slot == packet) {
+            *slot = NULL;
+        }
+    }
+}
+
+/* Returns the queued packet with this sequence number, or NULL. The index must be present. */
+picoquic_packet_t* picoquic_retransmit_index_get(picoquic_packet_context_t* pkt_ctx, uint64_t sequence_number)
+{
+    picoquic_packet_t* packet = pkt_ctx->retransmit_index[sequence_number & (pkt_ctx->retransmit_index_size - 1)];
+
+    return (packet != NULL && packet->sequence_number == sequence_number) ? packet : NULL;
+}
+
+void picoquic_retransmit_index_free(picoquic_packet_context_t* pkt_ctx)
+{
+    if (pkt_ctx->retransmit_index != NULL) {
+        free(pkt_ctx->retransmit_index);
+        pkt_ctx->retransmit_index = NULL;
+    }
+}
+
 /*
  * Final steps in packet transmission: queue for retransmission, etc
  */
@@ -747,11 +853,13 @@ void picoquic_queue_for_retransmit(picoquic_cnx_t* cnx, picoquic_path_t * path_x
     if (path_x->pkt_ctx[pc].retransmit_newest == NULL) {
         packet->next_packet = NULL;
         path_x->pkt_ctx[pc].retransmit_oldest = packet;
+        path_x->pkt_ctx[pc].loss_timer_armed = 0;
     } else {
         packet->next_packet = path_x->pkt_ctx[pc].retransmit_newest;
         packet->next_packet->previous_packet = packet;
     }
     path_x->pkt_ctx[pc].retransmit_newest = packet;
+    picoquic_retransmit_index_add(&path_x->pkt_ctx[pc], packet);
 
     /* Update the pacing data */
     picoquic_update_pacing_after_send(path_x, current_time);
@@ -785,6 +893,8 @@ protoop_arg_t dequeue_retransmit_packet(picoquic_cnx_t *cnx)
     picoquic_packet_context_enum pc = p->pc;
     picoquic_path_t* send_path = p->send_path;
 
+    picoquic_retransmit_index_remove(&send_path->pkt_ctx[pc], p);
+
     if (p->previous_packet == NULL) {
         send_path->pkt_ctx[pc].retransmit_newest = p->next_packet;
     }
@@ -794,6 +904,7 @@ protoop_arg_t dequeue_retransmit_packet(picoquic_cnx_t *cnx)
 
     if (p->next_packet == NULL) {
         send_path->pkt_ctx[pc].retransmit_oldest = p->previous_packet;
+        send_path->pkt_ctx[pc].loss_timer_armed = 0;
     }
     else {
 #ifdef _DEBUG
@@ -824,6 +935,7 @@ protoop_arg_t dequeue_retransmit_packet(picoquic_cnx_t *cnx)
     }
     else {
         LOG_EVENT(cnx, "RECOVERY", "PACKET_LOSS", "DEQUEUE_RETRANSMIT_PACKET", "{\"path\": \"%p\", \"pc\": %d, \"pn\": %" PRIu64 "}", p->send_path, p->pc, p->sequence_number);
+        PICOQUIC_PROBE5(packet_lost, cnx, send_path, pc, p->sequence_number, p->length);
         protoop_prepare_and_run_noparam(cnx, &PROTOOP_NOPARAM_PACKET_WAS_LOST, NULL, p, send_path);
 
         p->next_packet = NULL;
@@ -1053,7 +1165,7 @@ protoop_arg_t retransmit_needed_by_packet(picoquic_cnx_t *cnx)
 
     if (delta_seq > 0) {
         /* By default, we use timer based RACK logic to absorb out of order deliveries */
-        retransmit_time = p->send_time + send_path->smoothed_rtt + (send_path->smoothed_rtt >> 3);
+        retransmit_time = p->send_time + send_path->smoothed_rtt + picoquic_reorder_window(send_path, pc);
         is_timer_based = 0;
 
         /* RACK logic fails when the smoothed RTT is too small, in which case we
@@ -1130,6 +1242,111 @@ static int picoquic_retransmit_needed_by_packet(picoquic_cnx_t* cnx,
     return should_retransmit;
 }
 
+/*
+ * Loss timer.
+ *
+ * A packet is declared lost one smoothed RTT plus a reorder window after it was sent,
+ * once a later packet was acknowledged, or after the retransmit timer otherwise.
+ * The reorder window starts at 1/8 of the RTT. Each spurious retransmission shows
+ * that the window was too short: it is doubled, or set to the observed reordering
+ * delay if larger, up to one RTT. After PICOQUIC_REORDER_WINDOW_DECAY losses without
+ * spurious retransmission, it is halved again.
+ *
+ * Only the oldest packet of a queue is considered for the wake time. Its loss time
+ * is computed by the arm_loss_timer protoop and cached in the packet context, so that
+ * set_next_wake_time does not call retransmit_needed_by_packet for every path and
+ * packet context on every packet. The cache is disarmed by every event that may move
+ * the loss time: the oldest packet leaving or entering the queue, a new acknowledgement,
+ * an RTT update, a retransmission timeout or a change of the reorder window.
+ */
+
+uint64_t picoquic_reorder_window(picoquic_path_t* path_x, picoquic_packet_context_enum pc)
+{
+    uint64_t reorder_window = path_x->pkt_ctx[pc].reorder_window;
+
+    if (reorder_window > path_x->smoothed_rtt) {
+        reorder_window = path_x->smoothed_rtt;
+    }
+    if (reorder_window < (path_x->smoothed_rtt >> 3)) {
+        reorder_window = path_x->smoothed_rtt >> 3;
+    }
+
+    return reorder_window;
+}
+
+void picoquic_update_reorder_window(picoquic_path_t* path_x, picoquic_packet_context_enum pc, uint64_t reorder_delay)
+{
+    picoquic_packet_context_t* pkt_ctx = &path_x->pkt_ctx[pc];
+    uint64_t reorder_window = 2 * picoquic_reorder_window(path_x, pc);
+
+    if (reorder_window < reorder_delay) {
+        reorder_window = reorder_delay;
+    }
+    if (reorder_window > path_x->smoothed_rtt) {
+        reorder_window = path_x->smoothed_rtt;
+    }
+    pkt_ctx->reorder_window = reorder_window;
+    pkt_ctx->nb_losses_since_reorder = 0;
+    pkt_ctx->loss_timer_armed = 0;
+}
+
+static void picoquic_reorder_window_loss(picoquic_path_t* path_x, picoquic_packet_context_enum pc)
+{
+    picoquic_packet_context_t* pkt_ctx = &path_x->pkt_ctx[pc];
+
+    if (++pkt_ctx->nb_losses_since_reorder >= PICOQUIC_REORDER_WINDOW_DECAY) {
+        pkt_ctx->reorder_window >>= 1;
+        pkt_ctx->nb_losses_since_reorder = 0;
+        pkt_ctx->loss_timer_armed = 0;
+    }
+}
+
+void picoquic_disarm_loss_timers(picoquic_path_t* path_x)
+{
+    for (picoquic_packet_context_enum pc = 0; pc < picoquic_nb_packet_context; pc++) {
+        path_x->pkt_ctx[pc].loss_timer_armed = 0;
+    }
+}
+
+/**
+ * See PROTOOP_NOPARAM_ARM_LOSS_TIMER
+ */
+protoop_arg_t arm_loss_timer(picoquic_cnx_t *cnx)
+{
+    picoquic_path_t* path_x = (picoquic_path_t*) cnx->protoop_inputv[0];
+    picoquic_packet_context_enum pc = (picoquic_packet_context_enum) cnx->protoop_inputv[1];
+    uint64_t current_time = (uint64_t) cnx->protoop_inputv[2];
+
+    picoquic_packet_context_t* pkt_ctx = &path_x->pkt_ctx[pc];
+    picoquic_packet_t* p = pkt_ctx->retransmit_oldest;
+    uint64_t loss_time = UINT64_MAX;
+    int stable = 1;
+
+    if (p != NULL) {
+        int timer_based = 0;
+
+        (void)picoquic_retransmit_needed_by_packet(cnx, p, current_time, &timer_based, NULL, &loss_time);
+        /* The loss time of a 0-RTT packet moves with the current time until the handshake completes,
+         * and a plugin computing it may use any state. */
+        stable = (p->ptype != picoquic_packet_0rtt_protected ||
+            (cnx->cnx_state >= picoquic_state_client_almost_ready && cnx->cnx_state <= picoquic_state_server_ready)) &&
+            !plugin_pluglet_exists(cnx, &PROTOOP_NOPARAM_RETRANSMIT_NEEDED_BY_PACKET, NO_PARAM, pluglet_replace);
+    }
+
+    pkt_ctx->loss_time = loss_time;
+    pkt_ctx->loss_timer_armed = stable;
+
+    return (protoop_arg_t) loss_time;
+}
+
+uint64_t picoquic_get_loss_time(picoquic_cnx_t* cnx, picoquic_path_t* path_x, picoquic_packet_context_enum pc, uint64_t current_time)
+{
+    if (path_x->pkt_ctx[pc].loss_timer_armed) {
+        return path_x->pkt_ctx[pc].loss_time;
+    }
+    return (uint64_t) protoop_prepare_and_run_noparam(cnx, &PROTOOP_NOPARAM_ARM_LOSS_TIMER, NULL, path_x, pc, current_time);
+}
+
 void register_plugin_in_pkt(picoquic_packet_t* packet, protoop_plugin_t* p, size_t frame_offset, uint64_t bytes, reserve_frame_slot_t *rfs)
 {
     picoquic_packet_plugin_frame_t* plugin_frame = malloc(sizeof(picoquic_packet_plugin_frame_t));
@@ -1379,6 +1596,9 @@ protoop_arg_t retransmit_needed(picoquic_cnx_t *cnx)
                 }
 
                 if (should_retransmit != 0) {
+                    if (!timer_based_retransmit) {
+                        picoquic_reorder_window_loss(orig_path, pc);
+                    }
                     packet->sequence_number = path_x->pkt_ctx[pc].send_sequence;
                     packet->send_path = path_x;
                     packet->pc = pc;
@@ -1549,6 +1769,7 @@ protoop_arg_t retransmit_needed(picoquic_cnx_t *cnx)
                                 orig_path->pkt_ctx[pc].latest_retransmit_time = current_time;
                                 if (current_time >= retrans_cc_notification_timer) {
                                     orig_path->pkt_ctx[pc].nb_retransmit++;
+                                    orig_path->pkt_ctx[pc].loss_timer_armed = 0;
                                 }
                             }
                         }
@@ -1882,7 +2103,6 @@ protoop_arg_t set_next_wake_time(picoquic_cnx_t *cnx)
     uint32_t last_pkt_length = (uint32_t) cnx->protoop_inputv[1];
     uint64_t next_time = cnx->latest_progress_time + PICOQUIC_MICROSEC_SILENCE_MAX * (2 - cnx->client_mode);
     picoquic_stream_head* stream = NULL;
-    int timer_based = 0;
     int blocked = 1;
     int pacing = 0;
     int ret = 0;
@@ -1913,9 +2133,7 @@ protoop_arg_t set_next_wake_time(picoquic_cnx_t *cnx)
         for (int i = 0; blocked != 0 && pacing == 0 && i < cnx->nb_paths; i++) {
             path_x = cnx->path[i];
             for (picoquic_packet_context_enum pc = 0; pc < picoquic_nb_packet_context; pc++) {
-                picoquic_packet_t* p = path_x->pkt_ctx[pc].retransmit_oldest;
-
-                if (p != NULL && ret == 0 && picoquic_retransmit_needed_by_packet(cnx, p, current_time, /* &ph,*/ &timer_based, NULL, NULL)) {
+                if (ret == 0 && picoquic_get_loss_time(cnx, path_x, pc, current_time) <= current_time) {
                     blocked = 0;
                 }
                 else if (picoquic_is_ack_needed(cnx, current_time, pc, path_x)) {
@@ -1949,8 +2167,9 @@ protoop_arg_t set_next_wake_time(picoquic_cnx_t *cnx)
     } else if (pacing == 0) {
         for (picoquic_packet_context_enum pc = 0; pc < picoquic_nb_packet_context; pc++) {
             for (int i = 0; i < cnx->nb_paths; i++) {
+                uint64_t loss_time;
+
                 path_x = cnx->path[i];
-                picoquic_packet_t* p = path_x->pkt_ctx[pc].retransmit_oldest;
                 /* Consider delayed ACK */
                 if (path_x->pkt_ctx[pc].ack_needed) {
                     uint64_t ack_time = path_x->pkt_ctx[pc].highest_ack_time + path_x->pkt_ctx[pc].ack_delay_local;
@@ -1960,13 +2179,9 @@ protoop_arg_t set_next_wake_time(picoquic_cnx_t *cnx)
                     }
                 }
 
-                if (p != NULL) {
-                    uint64_t retransmit_time = UINT64_MAX;
-                    char *retransmit_reason = NULL;
-                    picoquic_retransmit_needed_by_packet(cnx, p, current_time, &timer_based, &retransmit_reason, &retransmit_time);
-                    if (retransmit_time < next_time) {
-                        next_time = retransmit_time;
-                    }
+                loss_time = picoquic_get_loss_time(cnx, path_x, pc, current_time);
+                if (loss_time < next_time) {
+                    next_time = loss_time;
                 }
             }
             if (cnx->handshake_done && (cnx->client_mode || cnx->handshake_done_acked)) {
@@ -2003,8 +2218,23 @@ protoop_arg_t set_next_wake_time(picoquic_cnx_t *cnx)
 /* TODO: tie with per path scheduling */
 void picoquic_cnx_set_next_wake_time(picoquic_cnx_t* cnx, uint64_t current_time, uint32_t last_pkt_length)
 {
+    if (cnx->tls_pending) {
+        /* A parked connection only wakes up to check whether its handshake job is done */
+        picoquic_reinsert_by_wake_time(cnx->quic, cnx, current_time + PICOQUIC_TLS_POOL_POLL_DELAY);
+        return;
+    }
     protoop_prepare_and_run_noparam(cnx, &PROTOOP_NOPARAM_SET_NEXT_WAKE_TIME, NULL,
         current_time, last_pkt_length);
+
+    if (cnx->quic->hibernation_delay > 0 &&
+        (cnx->cnx_state == picoquic_state_client_ready || cnx->cnx_state == picoquic_state_server_ready)) {
+        /* Wake up when the connection may hibernate */
+        uint64_t hibernation_time = cnx->latest_activity_time + cnx->quic->hibernation_delay;
+
+        if (hibernation_time > current_time && hibernation_time < cnx->next_wake_time) {
+            picoquic_reinsert_by_wake_time(cnx->quic, cnx, hibernation_time);
+        }
+    }
 }
 
 /* Prepare the next packet to 0-RTT packet to send in the client initial
@@ -2745,6 +2975,7 @@ int picoquic_prepare_packet_closing(picoquic_cnx_t* cnx, picoquic_path_t ** path
                         length += (uint32_t)consumed;
                     }
                     path_x->pkt_ctx[pc].ack_needed = 0;
+                    path_x->pkt_ctx[pc].nb_ack_eliciting_received = 0;
                 }
                 next_time = current_time + delta_t;
                 if (next_time > exit_time) {
@@ -2815,6 +3046,7 @@ int picoquic_prepare_packet_closing(picoquic_cnx_t* cnx, picoquic_path_t ** path
             cnx->latest_progress_time = current_time;
             picoquic_reinsert_by_wake_time(cnx->quic, cnx, current_time + delta_t);
             path_x->pkt_ctx[pc].ack_needed = 0;
+            path_x->pkt_ctx[pc].nb_ack_eliciting_received = 0;
 
             if (cnx->callback_fn) {
                 (cnx->callback_fn)(cnx, 0, NULL, 0, picoquic_callback_close, cnx->callback_ctx);
@@ -3132,6 +3364,15 @@ protoop_arg_t schedule_frames_on_path(picoquic_cnx_t *cnx)
                             }
                         }
 
+                        if (ret == 0 && (cnx->remote_parameters.min_ack_delay > 0 || path_x->immediate_ack_to_send)) {
+                            ret = picoquic_prepare_ack_frequency_frame(cnx, path_x, current_time, bytes + length, send_buffer_min_max - checksum_overhead - length, &data_bytes);
+                            if (ret == 0 && data_bytes > 0) {
+                                length += (uint32_t) data_bytes;
+                                packet->is_pure_ack = 0;
+                                packet->is_congestion_controlled = 1;
+                            }
+                        }
+
                         /* if present, send path response. This ensures we send it on the right path */
                         if (path_x->challenge_response_to_send && send_buffer_min_max - checksum_overhead - length >= PICOQUIC_CHALLENGE_LENGTH + 1) {
                             /* This is not really clean, but it will work */
@@ -3557,6 +3798,19 @@ int picoquic_prepare_packet(picoquic_cnx_t* cnx,
 
     *send_length = 0;
 
+    PICOQUIC_PROBE2(prepare_packet_entry, cnx, current_time);
+
+    if (cnx->tls_pending && picoquic_tls_async_poll(cnx, current_time) != 0) {
+        picoquic_cnx_set_next_wake_time(cnx, current_time, 0);
+        PICOQUIC_PROBE3(prepare_packet_exit, cnx, 0, 0);
+        return 0;
+    }
+
+    /* Send the metric records pushed by the plugins since the last call */
+    if (cnx->quic->metrics_exporter != NULL) {
+        (void) picoquic_metrics_exporter_flush(cnx->quic->metrics_exporter, current_time, 0);
+    }
+
     while (ret == 0)
     {
         size_t available = send_buffer_max;
@@ -3622,6 +3876,14 @@ int picoquic_prepare_packet(picoquic_cnx_t* cnx,
         // TODO: Add another QUIC packet full of padding using the best encryption level available
     }
 
+    if (*send_length > 0) {
+        cnx->latest_activity_time = current_time;
+    } else if (ret == 0) {
+        picoquic_hibernate_if_idle(cnx, current_time);
+    }
+
+    PICOQUIC_PROBE3(prepare_packet_exit, cnx, *send_length, ret);
+
     return ret;
 }
 
@@ -3661,6 +3923,7 @@ void sender_register_noparam_protoops(picoquic_cnx_t *cnx)
 
     register_noparam_protoop(cnx, &PROTOOP_NOPARAM_RETRANSMIT_NEEDED, &retransmit_needed);
     register_noparam_protoop(cnx, &PROTOOP_NOPARAM_RETRANSMIT_NEEDED_BY_PACKET, &retransmit_needed_by_packet);
+    register_noparam_protoop(cnx, &PROTOOP_NOPARAM_ARM_LOSS_TIMER, &arm_loss_timer);
     register_noparam_protoop(cnx, &PROTOOP_NOPARAM_PREDICT_PACKET_HEADER_LENGTH, &predict_packet_header_length);
     register_noparam_protoop(cnx, &PROTOOP_NOPARAM_GET_CHECKSUM_LENGTH, &get_checksum_length);
     register_noparam_protoop(cnx, &PROTOOP_NOPARAM_DEQUEUE_RETRANSMIT_PACKET, &dequeue_retransmit_packet);
@@ -0,0 +1,365 @@
+#include "slab_memory.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Only the first and last pages of a span describe it, the other pages are inner pages */
+#define SLAB_PAGE_INNER 0
+#define SLAB_PAGE_FREE 1
+#define SLAB_PAGE_SMALL 2
+#define SLAB_PAGE_LARGE 3
+
+#define SLAB_ALIGNMENT 16
+#define SLAB_MAX_SLOTS (SLAB_PAGE_SIZE / SLAB_ALIGNMENT)
+
+struct slab_page {
+    uint32_t prev;        /* Links in a free span list or in a partial page list, page index plus one */
+    uint32_t next;
+    uint32_t span_pages;  /* Number of pages of the span, on its first and last pages */
+    uint32_t span_first;  /* First page of the span, on its last page */
+    uint32_t free_slot;   /* Small pages: offset of the first free slot plus one, 0 if none */
+    uint32_t bump;        /* Small pages: offset of the first slot never used */
+    uint16_t nb_used;     /* Small pages: number of slots in use */
+    uint8_t kind;
+    uint8_t size_class;
+    uint64_t used_slots[SLAB_MAX_SLOTS / 64]; /* Small pages: bit set for each slot in use */
+};
+
+static const uint32_t slab_class_sizes[SLAB_NB_SIZE_CLASSES] = {
+    16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048, 3072, 4096
+};
+
+/* Size class of each size, by steps of the alignment */
+static const uint8_t slab_size_to_class[SLAB_MAX_SMALL_SIZE / SLAB_ALIGNMENT + 1] = {
+    0, 0, 1, 2, 3, 4, 4, 5, 5, 6, 6, 6, 6, 7, 7, 7,
+    7, 8, 8, 8, 8, 8, 8, 8, 8, 9, 9, 9, 9, 9, 9, 9,
+    9, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+    10, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+    11, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12,
+    12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12,
+    12, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13,
+    13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13, 13,
+    13, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14,
+    14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14,
+    14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14,
+    14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14,
+    14, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+    15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+    15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+    15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+    15
+};
+
+static inline uint8_t *slab_page_addr(slab_memory_t *slab, uint32_t page)
+{
+    return slab->mem_start + (size_t) page * SLAB_PAGE_SIZE;
+}
+
+static inline int slab_slot_is_used(const slab_page_t *pg, uint32_t offset)
+{
+    uint32_t slot = offset / slab_class_sizes[pg->size_class];
+    return (pg->used_slots[slot / 64] >> (slot % 64)) & 1;
+}
+
+static inline void slab_slot_set_used(slab_page_t *pg, uint32_t offset, int used)
+{
+    uint32_t slot = offset / slab_class_sizes[pg->size_class];
+    if (used) {
+        pg->used_slots[slot / 64] |= ((uint64_t) 1) << (slot % 64);
+    } else {
+        pg->used_slots[slot / 64] &= ~(((uint64_t) 1) << (slot % 64));
+    }
+}
+
+static inline int slab_span_list(uint32_t nb_pages)
+{
+    return ((nb_pages < SLAB_NB_SPAN_LISTS) ? (int) nb_pages : SLAB_NB_SPAN_LISTS) - 1;
+}
+
+static void slab_list_push(slab_memory_t *slab, uint32_t *head, uint32_t page)
+{
+    slab_page_t *pg = &slab->pages[page];
+    pg->prev = 0;
+    pg->next = *head;
+    if (*head != 0) {
+        slab->pages[*head - 1].prev = page + 1;
+    }
+    *head = page + 1;
+}
+
+static void slab_list_remove(slab_memory_t *slab, uint32_t *head, uint32_t page)
+{
+    slab_page_t *pg = &slab->pages[page];
+    if (pg->prev != 0) {
+        slab->pages[pg->prev - 1].next = pg->next;
+    } else {
+        *head = pg->next;
+    }
+    if (pg->next != 0) {
+        slab->pages[pg->next - 1].prev = pg->prev;
+    }
+    pg->prev = 0;
+    pg->next = 0;
+}
+
+static void slab_set_span(slab_memory_t *slab, uint32_t first, uint32_t nb_pages, uint8_t kind)
+{
+    slab_page_t *last = &slab->pages[first + nb_pages - 1];
+    last->kind = (kind == SLAB_PAGE_FREE) ? SLAB_PAGE_FREE : SLAB_PAGE_INNER;
+    last->span_pages = nb_pages;
+    last->span_first = first;
+    slab->pages[first].kind = kind;
+    slab->pages[first].span_pages = nb_pages;
+}
+
+static int64_t slab_alloc_span(slab_memory_t *slab, uint32_t nb_pages)
+{
+    for (int list = slab_span_list(nb_pages); list < SLAB_NB_SPAN_LISTS; list++) {
+        uint32_t cur = slab->free_spans[list];
+        /* Only the last list holds spans of different lengths */
+        while (cur != 0 && slab->pages[cur - 1].span_pages < nb_pages) {
+            cur = slab->pages[cur - 1].next;
+        }
+        if (cur != 0) {
+            uint32_t first = cur - 1;
+            uint32_t span_pages = slab->pages[first].span_pages;
+            slab_list_remove(slab, &slab->free_spans[list], first);
+            if (span_pages > nb_pages) {
+                uint32_t rest = first + nb_pages;
+                slab_set_span(slab, rest, span_pages - nb_pages, SLAB_PAGE_FREE);
+                slab_list_push(slab, &slab->free_spans[slab_span_list(span_pages - nb_pages)], rest);
+            }
+            slab_set_span(slab, first, nb_pages, SLAB_PAGE_INNER);
+            slab->stats.free_pages -= nb_pages;
+            return first;
+        }
+    }
+    return -1;
+}
+
+static void slab_free_span(slab_memory_t *slab, uint32_t first)
+{
+    uint32_t nb_pages = slab->pages[first].span_pages;
+    uint32_t last = first + nb_pages - 1;
+
+    slab->stats.free_pages += nb_pages;
+    slab->pages[first].kind = SLAB_PAGE_INNER;
+    slab->pages[last].kind = SLAB_PAGE_INNER;
+    /* Merge with the free neighbours */
+    if (last + 1 < slab->nb_pages && slab->pages[last + 1].kind == SLAB_PAGE_FREE) {
+        uint32_t next_pages = slab->pages[last + 1].span_pages;
+        slab_list_remove(slab, &slab->free_spans[slab_span_list(next_pages)], last + 1);
+        slab->pages[last + 1].kind = SLAB_PAGE_INNER;
+        nb_pages += next_pages;
+        last += next_pages;
+    }
+    if (first > 0 && slab->pages[first - 1].kind == SLAB_PAGE_FREE) {
+        uint32_t prev_first = slab->pages[first - 1].span_first;
+        slab_list_remove(slab, &slab->free_spans[slab_span_list(slab->pages[prev_first].span_pages)], prev_first);
+        slab->pages[first - 1].kind = SLAB_PAGE_INNER;
+        nb_pages += first - prev_first;
+        first = prev_first;
+    }
+    slab_set_span(slab, first, nb_pages, SLAB_PAGE_FREE);
+    slab_list_push(slab, &slab->free_spans[slab_span_list(nb_pages)], first);
+}
+
+static inline int slab_page_has_room(slab_page_t *pg)
+{
+    return pg->free_slot != 0 || pg->bump + slab_class_sizes[pg->size_class] <= SLAB_PAGE_SIZE;
+}
+
+int slab_memory_init(slab_memory_t *slab, void *mem, size_t size)
+{
+    size_t align = (SLAB_ALIGNMENT - ((uintptr_t) mem % SLAB_ALIGNMENT)) % SLAB_ALIGNMENT;
+
+    memset(slab, 0, sizeof(slab_memory_t));
+    if (size < align + SLAB_PAGE_SIZE) {
+        return -1;
+    }
+    slab->mem_start = (uint8_t *) mem + align;
+    slab->nb_pages = (uint32_t) ((size - align) / SLAB_PAGE_SIZE);
+    slab->pages = (slab_page_t *) calloc(slab->nb_pages, sizeof(slab_page_t));
+    if (slab->pages == NULL) {
+        return -1;
+    }
+
+    slab_set_span(slab, 0, slab->nb_pages, SLAB_PAGE_FREE);
+    slab_list_push(slab, &slab->free_spans[slab_span_list(slab->nb_pages)], 0);
+    slab->stats.free_pages = slab->nb_pages;
+    return 0;
+}
+
+void slab_memory_destroy(slab_memory_t *slab)
+{
+    free(slab->pages);
+    slab->pages = NULL;
+}
+
+static void *slab_malloc_small(slab_memory_t *slab, uint8_t size_class)
+{
+    uint32_t *partial = &slab->partial_pages[size_class];
+    uint32_t slot_size = slab_class_sizes[size_class];
+    uint32_t page;
+    uint32_t offset;
+    slab_page_t *pg;
+
+    if (*partial == 0) {
+        int64_t new_page = slab_alloc_span(slab, 1);
+        if (new_page < 0) {
+            return NULL;
+        }
+        pg = &slab->pages[new_page];
+        pg->kind = SLAB_PAGE_SMALL;
+        pg->size_class = size_class;
+        pg->free_slot = 0;
+        pg->bump = 0;
+        pg->nb_used = 0;
+        memset(pg->used_slots, 0, sizeof(pg->used_slots));
+        slab_list_push(slab, partial, (uint32_t) new_page);
+        slab->stats.small_pages++;
+    }
+
+    page = *partial - 1;
+    pg = &slab->pages[page];
+    if (pg->free_slot != 0) {
+        uint32_t next;
+        offset = pg->free_slot - 1;
+        memcpy(&next, slab_page_addr(slab, page) + offset, sizeof(uint32_t));
+        /* The link is in the plugin memory, do not trust it */
+        if (next != 0 && (next - 1 >= pg->bump || (next - 1) % slot_size != 0 || slab_slot_is_used(pg, next - 1))) {
+            printf("MEMORY CORRUPTION: BAD FREE SLOT LINK 0x%x IN PAGE %u\n", next, page);
+            next = 0;
+        }
+        pg->free_slot = next;
+    } else {
+        offset = pg->bump;
+        pg->bump += slot_size;
+    }
+    pg->nb_used++;
+    slab_slot_set_used(pg, offset, 1);
+    if (!slab_page_has_room(pg)) {
+        slab_list_remove(slab, partial, page);
+    }
+    slab->stats.bytes_in_use += slot_size;
+    return slab_page_addr(slab, page) + offset;
+}
+
+void *slab_malloc(slab_memory_t *slab, size_t size)
+{
+    void *ptr;
+
+    if (size <= SLAB_MAX_SMALL_SIZE) {
+        ptr = slab_malloc_small(slab, slab_size_to_class[(size + SLAB_ALIGNMENT - 1) / SLAB_ALIGNMENT]);
+    } else {
+        size_t nb_pages = (size + SLAB_PAGE_SIZE - 1) / SLAB_PAGE_SIZE;
+        int64_t first = (nb_pages <= slab->nb_pages) ? slab_alloc_span(slab, (uint32_t) nb_pages) : -1;
+        ptr = NULL;
+        if (first >= 0) {
+            slab->pages[first].kind = SLAB_PAGE_LARGE;
+            slab->stats.large_pages += (uint32_t) nb_pages;
+            slab->stats.bytes_in_use += nb_pages * SLAB_PAGE_SIZE;
+            ptr = slab_page_addr(slab, (uint32_t) first);
+        }
+    }
+
+    if (ptr == NULL) {
+        slab->stats.nb_failed_allocs++;
+        return NULL;
+    }
+    slab->stats.nb_allocs++;
+    if (slab->stats.bytes_in_use > slab->stats.peak_bytes_in_use) {
+        slab->stats.peak_bytes_in_use = slab->stats.bytes_in_use;
+    }
+    return ptr;
+}
+
+size_t slab_usable_size(slab_memory_t *slab, void *ptr)
+{
+    uint8_t *p = (uint8_t *) ptr;
+    uint32_t page;
+    uint32_t offset;
+    slab_page_t *pg;
+
+    if (p < slab->mem_start || p >= slab->mem_start + (size_t) slab->nb_pages * SLAB_PAGE_SIZE) {
+        return 0;
+    }
+    page = (uint32_t) ((p - slab->mem_start) / SLAB_PAGE_SIZE);
+    offset = (uint32_t) ((p - slab->mem_start) % SLAB_PAGE_SIZE);
+    pg = &slab->pages[page];
+    if (pg->kind == SLAB_PAGE_SMALL) {
+        uint32_t slot_size = slab_class_sizes[pg->size_class];
+        return (offset < pg->bump && offset % slot_size == 0 && slab_slot_is_used(pg, offset)) ? slot_size : 0;
+    } else if (pg->kind == SLAB_PAGE_LARGE && offset == 0) {
+        return (size_t) pg->span_pages * SLAB_PAGE_SIZE;
+    }
+    return 0;
+}
+
+void slab_free(slab_memory_t *slab, void *ptr)
+{
+    size_t usable;
+    uint32_t page;
+    slab_page_t *pg;
+
+    if (ptr == NULL) {
+        return;
+    }
+    usable = slab_usable_size(slab, ptr);
+    if (usable == 0) {
+        printf("MEMORY CORRUPTION: FREEING MEMORY (%p) NOT ALLOCATED BY THE PLUGIN OR ALREADY FREED\n", ptr);
+        slab->stats.nb_bad_frees++;
+        return;
+    }
+    page = (uint32_t) (((uint8_t *) ptr - slab->mem_start) / SLAB_PAGE_SIZE);
+    pg = &slab->pages[page];
+    slab->stats.nb_frees++;
+    slab->stats.bytes_in_use -= usable;
+
+    if (pg->kind == SLAB_PAGE_LARGE) {
+        slab->stats.large_pages -= pg->span_pages;
+        slab_free_span(slab, page);
+    } else {
+        uint32_t *partial = &slab->partial_pages[pg->size_class];
+        int was_full = !slab_page_has_room(pg);
+        uint32_t offset = (uint32_t) ((uint8_t *) ptr - slab_page_addr(slab, page));
+
+        memcpy(ptr, &pg->free_slot, sizeof(uint32_t));
+        pg->free_slot = offset + 1;
+        pg->nb_used--;
+        slab_slot_set_used(pg, offset, 0);
+        if (was_full) {
+            slab_list_push(slab, partial, page);
+        } else if (pg->nb_used == 0 && (*partial != page + 1 || pg->next != 0)) {
+            /* Keep a single empty page per class, give the others back */
+            slab_list_remove(slab, partial, page);
+            slab->stats.small_pages--;
+            slab_free_span(slab, page);
+        }
+    }
+}
+
+void *slab_realloc(slab_memory_t *slab, void *ptr, size_t size)
+{
+    size_t usable;
+    void *new_ptr;
+
+    if (ptr == NULL) {
+        return slab_malloc(slab, size);
+    }
+    usable = slab_usable_size(slab, ptr);
+    if (usable == 0) {
+        printf("MEMORY CORRUPTION: REALLOCATING MEMORY (%p) NOT ALLOCATED BY THE PLUGIN\n", ptr);
+        return NULL;
+    }
+    if (size <= usable) {
+        return ptr;
+    }
+    new_ptr = slab_malloc(slab, size);
+    if (new_ptr != NULL) {
+        memcpy(new_ptr, ptr, usable);
+        slab_free(slab, ptr);
+    }
+    return new_ptr;
+}
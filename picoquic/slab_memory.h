@@ -0,0 +1,63 @@
+#ifndef SLAB_MEMORY_H
+#define SLAB_MEMORY_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Size class allocator working inside a fixed memory region, such as the
+ * memory of a plugin.
+ *
+ * The region is cut in pages. Small objects are served from pages dedicated
+ * to their size class, each page holding its own free list, and a size class
+ * keeps the list of its pages having free slots. Objects larger than the
+ * largest class get a span of contiguous pages, taken from free lists
+ * segregated by span length. Freed spans are merged with their free
+ * neighbours, and small pages are given back to the spans once empty.
+ * Allocation and release are done in constant time.
+ *
+ * All the bookkeeping lives outside the region, except the links of the
+ * free slots, which are checked before being followed. Each small page keeps
+ * a bitmap of its slots in use, so that double frees are detected.
+ */
+
+#define SLAB_PAGE_SIZE (16 * 1024)
+#define SLAB_NB_SIZE_CLASSES 16
+#define SLAB_MAX_SMALL_SIZE 4096
+#define SLAB_NB_SPAN_LISTS 32
+
+typedef struct slab_memory_stats {
+    uint64_t nb_allocs;        /* Successful allocations */
+    uint64_t nb_frees;
+    uint64_t nb_failed_allocs;
+    uint64_t nb_bad_frees;     /* Frees of pointers not allocated, or already freed */
+    uint64_t bytes_in_use;     /* Slot sizes of the live objects */
+    uint64_t peak_bytes_in_use;
+    uint32_t small_pages;      /* Pages holding small objects */
+    uint32_t large_pages;      /* Pages of the spans given to large objects */
+    uint32_t free_pages;
+} slab_memory_stats_t;
+
+typedef struct slab_page slab_page_t;
+
+typedef struct slab_memory {
+    uint8_t *mem_start;       /* First page, aligned on 16 bytes */
+    uint32_t nb_pages;
+    slab_page_t *pages;       /* Bookkeeping of each page */
+    uint32_t partial_pages[SLAB_NB_SIZE_CLASSES]; /* Per class, first page with free slots, plus one */
+    uint32_t free_spans[SLAB_NB_SPAN_LISTS];      /* Per span length, first free span, plus one */
+    slab_memory_stats_t stats;
+} slab_memory_t;
+
+/* Prepares the allocator for the region [mem, mem + size[. Returns 0 on success. */
+int slab_memory_init(slab_memory_t *slab, void *mem, size_t size);
+void slab_memory_destroy(slab_memory_t *slab);
+
+void *slab_malloc(slab_memory_t *slab, size_t size);
+void slab_free(slab_memory_t *slab, void *ptr);
+void *slab_realloc(slab_memory_t *slab, void *ptr, size_t size);
+
+/* Usable size of the object at ptr, 0 if ptr is not a live object of the region */
+size_t slab_usable_size(slab_memory_t *slab, void *ptr);
+
+#endif /* SLAB_MEMORY_H */
@@ -0,0 +1,180 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+#include "spsc_ring.h"
+
+#define SPSC_RING_WRAP 0xFFFFFFFFu
+#define SPSC_RING_HEADER_SIZE 8
+#define SPSC_RING_CACHE_LINE 64
+#define SPSC_RING_RECORD_SIZE(l) (SPSC_RING_HEADER_SIZE + (((l) + 7) & ~7u))
+
+/* The head and the tail are on separate cache lines, so that the producer
+ * and the consumer do not invalidate each other on every message. */
+struct st_spsc_ring_t {
+    uint64_t head; /* Written by the consumer */
+    uint8_t pad_head[SPSC_RING_CACHE_LINE - sizeof(uint64_t)];
+    uint64_t tail; /* Written by the producer */
+    uint8_t pad_tail[SPSC_RING_CACHE_LINE - sizeof(uint64_t)];
+    uint32_t capacity;
+    uint32_t mask;
+    int event_fd;
+    size_t map_length;
+    uint8_t *data;
+};
+
+spsc_ring_t *spsc_ring_create(uint32_t capacity)
+{
+    uint32_t c = 64;
+    while (c < capacity && c < 0x80000000u) {
+        c <<= 1;
+    }
+
+    size_t header_length = (sizeof(spsc_ring_t) + SPSC_RING_CACHE_LINE - 1) & ~((size_t) SPSC_RING_CACHE_LINE - 1);
+    size_t map_length = header_length + c;
+    void *map = mmap(NULL, map_length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+
+    spsc_ring_t *ring = (spsc_ring_t *) map;
+    memset(ring, 0, sizeof(spsc_ring_t));
+    ring->capacity = c;
+    ring->mask = c - 1;
+    ring->map_length = map_length;
+    ring->data = ((uint8_t *) map) + header_length;
+#ifdef __linux__
+    ring->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#else
+    ring->event_fd = -1;
+#endif
+    return ring;
+}
+
+void spsc_ring_free(spsc_ring_t *ring)
+{
+    if (ring != NULL) {
+        if (ring->event_fd != -1) {
+            close(ring->event_fd);
+        }
+        munmap(ring, ring->map_length);
+    }
+}
+
+int spsc_ring_push(spsc_ring_t *ring, const uint8_t *data, uint32_t length)
+{
+    uint64_t first_tail = ring->tail;
+    uint64_t tail = first_tail;
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    uint32_t record_size = SPSC_RING_RECORD_SIZE(length);
+    uint32_t pos = (uint32_t) (tail & ring->mask);
+    uint32_t contiguous = ring->capacity - pos;
+    uint32_t needed = (contiguous < record_size) ? record_size + contiguous : record_size;
+
+    if (length == SPSC_RING_WRAP || record_size > ring->capacity || tail - head + needed > ring->capacity) {
+        return -1;
+    }
+
+    if (contiguous < record_size) {
+        /* Not enough room before the end of the buffer, skip to the start */
+        *((uint32_t *) (ring->data + pos)) = SPSC_RING_WRAP;
+        tail += contiguous;
+        pos = 0;
+    }
+
+    *((uint32_t *) (ring->data + pos)) = length;
+    memcpy(ring->data + pos + SPSC_RING_HEADER_SIZE, data, length);
+    __atomic_store_n(&ring->tail, tail + record_size, __ATOMIC_SEQ_CST);
+
+    /* Only wake up the consumer if it had drained everything before this message */
+    if (ring->event_fd != -1 && __atomic_load_n(&ring->head, __ATOMIC_SEQ_CST) == first_tail) {
+        uint64_t one = 1;
+        ssize_t ret = write(ring->event_fd, &one, sizeof(one));
+        (void) ret;
+    }
+
+    return 0;
+}
+
+/* Returns the position of the oldest message, skipping the wrap marker */
+static inline uint32_t spsc_ring_head_position(spsc_ring_t *ring, uint64_t *head)
+{
+    uint32_t pos = (uint32_t) (*head & ring->mask);
+    if (*((uint32_t *) (ring->data + pos)) == SPSC_RING_WRAP) {
+        *head += ring->capacity - pos;
+        pos = 0;
+    }
+    return pos;
+}
+
+int spsc_ring_pop(spsc_ring_t *ring, uint8_t *data, uint32_t max)
+{
+    uint64_t head = ring->head;
+    uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_SEQ_CST);
+
+    if (head == tail) {
+        return 0;
+    }
+
+    uint32_t pos = spsc_ring_head_position(ring, &head);
+    uint32_t length = *((uint32_t *) (ring->data + pos));
+
+    if (length > max) {
+        __atomic_store_n(&ring->head, head, __ATOMIC_SEQ_CST);
+        return -1;
+    }
+
+    memcpy(data, ring->data + pos + SPSC_RING_HEADER_SIZE, length);
+    __atomic_store_n(&ring->head, head + SPSC_RING_RECORD_SIZE(length), __ATOMIC_SEQ_CST);
+    return (int) length;
+}
+
+void spsc_ring_skip(spsc_ring_t *ring)
+{
+    uint64_t head = ring->head;
+    uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+    if (head != tail) {
+        uint32_t pos = spsc_ring_head_position(ring, &head);
+        uint32_t length = *((uint32_t *) (ring->data + pos));
+        __atomic_store_n(&ring->head, head + SPSC_RING_RECORD_SIZE(length), __ATOMIC_SEQ_CST);
+    }
+}
+
+uint32_t spsc_ring_peek_length(spsc_ring_t *ring)
+{
+    uint64_t head = ring->head;
+    uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+    if (head == tail) {
+        return 0;
+    }
+
+    uint32_t pos = spsc_ring_head_position(ring, &head);
+    return *((uint32_t *) (ring->data + pos));
+}
+
+uint32_t spsc_ring_get_used(spsc_ring_t *ring)
+{
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+    return (uint32_t) (tail - head);
+}
+
+int spsc_ring_get_eventfd(spsc_ring_t *ring)
+{
+    return ring->event_fd;
+}
+
+void spsc_ring_clear_event(spsc_ring_t *ring)
+{
+    if (ring->event_fd != -1) {
+        uint64_t count;
+        ssize_t ret = read(ring->event_fd, &count, sizeof(count));
+        (void) ret;
+    }
+}
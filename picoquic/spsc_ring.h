@@ -0,0 +1,95 @@
+/**
+ * \file spsc_ring.h
+ * \brief A lock-free single producer, single consumer ring of messages.
+ *
+ * The ring lives in a shared memory mapping. Each message is stored as a
+ * 32-bit length followed by its bytes, padded to 8 bytes. The producer only
+ * writes the tail index, the consumer only writes the head index, so no lock
+ * is needed as long as each side stays on a single thread.
+ *
+ * On Linux, an eventfd is signalled when the ring goes from empty to non
+ * empty, so that a consumer can wait for messages with poll/select instead
+ * of spinning. Wake-ups are thus batched: a burst of messages costs a single
+ * write on the eventfd.
+ *
+ * \warning The data pointers passed to the push and pop functions are not
+ * kept by the ring, messages are copied.
+ */
+
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SPSC_RING_DEFAULT_CAPACITY (1 << 20) /* In bytes */
+
+typedef struct st_spsc_ring_t spsc_ring_t;
+
+/**
+ * Creates a new ring holding \p capacity bytes of messages. The capacity is
+ * rounded up to a power of two.
+ *
+ * \return The ring, or NULL if the mapping could not be created
+ */
+spsc_ring_t *spsc_ring_create(uint32_t capacity);
+
+/**
+ * Unmaps the ring and closes its eventfd.
+ */
+void spsc_ring_free(spsc_ring_t *ring);
+
+/**
+ * Copies a message in the ring. Producer side only.
+ *
+ * \return 0 if the message was queued, -1 if there was not enough room
+ */
+int spsc_ring_push(spsc_ring_t *ring, const uint8_t *data, uint32_t length);
+
+/**
+ * Copies the oldest message of the ring in \p data and removes it. Consumer
+ * side only.
+ *
+ * \return The length of the message, 0 if the ring is empty, or -1 if the
+ * message does not fit in \p max bytes. In the latter case the message is
+ * left in the ring.
+ */
+int spsc_ring_pop(spsc_ring_t *ring, uint8_t *data, uint32_t max);
+
+/**
+ * Removes the oldest message of the ring without copying it. Consumer side only.
+ */
+void spsc_ring_skip(spsc_ring_t *ring);
+
+/**
+ * Returns the length of the oldest message of the ring, or 0 if it is empty.
+ */
+uint32_t spsc_ring_peek_length(spsc_ring_t *ring);
+
+/**
+ * Returns the number of bytes taken by the queued messages, including their
+ * headers and padding. Either side.
+ */
+uint32_t spsc_ring_get_used(spsc_ring_t *ring);
+
+/**
+ * Returns the eventfd signalled when messages become available, or -1 if
+ * the platform has no eventfd.
+ */
+int spsc_ring_get_eventfd(spsc_ring_t *ring);
+
+/**
+ * Resets the eventfd counter. The consumer should call it before draining
+ * the ring, so that a message pushed during the drain triggers a new event.
+ */
+void spsc_ring_clear_event(spsc_ring_t *ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SPSC_RING_H */
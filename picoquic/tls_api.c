@@ -28,6 +28,7 @@
 #include "picotls/openssl.h"
 #include "picotls/minicrypto.h"
 #include "tls_api.h"
+#include <openssl/evp.h>
 #include <openssl/pem.h>
 #include <openssl/err.h>
 #include <openssl/engine.h>
@@ -57,6 +58,7 @@ typedef struct st_picoquic_tls_ctx_t {
     uint8_t ext_received[256];
     size_t ext_received_length;
     int ext_received_return;
+    struct st_picoquic_tls_async_job_t* async_job; /* Set while the connection is parked */
 } picoquic_tls_ctx_t;
 
 int picoquic_receive_transport_extensions(picoquic_cnx_t* cnx, int extension_mode,
@@ -299,9 +301,16 @@ void picoquic_tls_set_extensions(picoquic_cnx_t* cnx, picoquic_tls_ctx_t* tls_ct
     tls_ctx->handshake_properties.additional_extensions = tls_ctx->ext;
 }
 
+static int picoquic_tls_async_keep_extension(struct st_picoquic_tls_async_job_t* job, const uint8_t* bytes, size_t length);
+
 /*
  * The collected extensions call back is called by the stack upon
  * reception of a handshake message containing supported extensions.
+ * For a client hello processed by a worker of the TLS pool, the transport
+ * parameters are only kept: processing them runs protocol operations, and
+ * possibly the pluglets of the connection, which must stay in the packet
+ * loop. picoquic_tls_async_poll processes them once the job is done. The
+ * extensions of the server do not depend on them.
  */
 
 int picoquic_tls_collected_extensions_cb(ptls_t* tls, ptls_handshake_properties_t* properties,
@@ -318,9 +327,16 @@ int picoquic_tls_collected_extensions_cb(ptls_t* tls, ptls_handshake_properties_
     if (slots[0].type == PICOQUIC_TRANSPORT_PARAMETERS_TLS_EXTENSION && slots[1].type == 0xFFFF) {
         size_t copied_length = sizeof(ctx->ext_received);
 
-        /* Retrieve the transport parameters */
-        ret = picoquic_receive_transport_extensions(ctx->cnx, (ctx->client_mode) ? 1 : 0,
-            slots[0].data.base, slots[0].data.len, &consumed);
+        if (ctx->async_job != NULL) {
+            ret = picoquic_tls_async_keep_extension(ctx->async_job, slots[0].data.base, slots[0].data.len);
+            if (ret != 0) {
+                return ret;
+            }
+        } else {
+            /* Retrieve the transport parameters */
+            ret = picoquic_receive_transport_extensions(ctx->cnx, (ctx->client_mode) ? 1 : 0,
+                slots[0].data.base, slots[0].data.len, &consumed);
+        }
 
         /* Copy the extensions in the local context for further debugging */
         ctx->ext_received_length = slots[0].data.len;
@@ -426,6 +442,11 @@ int picoquic_server_encrypt_ticket_call_back(ptls_encrypt_ticket_t* encrypt_tick
     picoquic_quic_t** ppquic = (picoquic_quic_t**)(((char*)encrypt_ticket_ctx) + sizeof(ptls_encrypt_ticket_t));
     picoquic_quic_t* quic = *ppquic;
 
+    /* The ticket AEAD contexts are shared by the handshakes running in the TLS pool */
+    if (quic->tls_pool != NULL) {
+        picoquic_tls_pool_lock_shared(quic->tls_pool);
+    }
+
     if (is_encrypt != 0) {
         ptls_aead_context_t* aead_enc = (ptls_aead_context_t*)quic->aead_encrypt_ticket_ctx;
         /* Encoding*/
@@ -463,6 +484,10 @@ int picoquic_server_encrypt_ticket_call_back(ptls_encrypt_ticket_t* encrypt_tick
         }
     }
 
+    if (quic->tls_pool != NULL) {
+        picoquic_tls_pool_unlock_shared(quic->tls_pool);
+    }
+
     return ret;
 }
 
@@ -609,7 +634,42 @@ static int picoquic_set_aead_from_secret(void ** v_aead,ptls_cipher_suite_t * ci
     return ret;
 }
 
-static int picoquic_set_hp_enc_from_secret(void ** v_hp_enc, ptls_cipher_suite_t * cipher, int is_enc, const void *secret)
+/* With AES, the header protection mask is the first block of the CTR key stream, that is the
+ * encryption of the sample. An ECB context on the same key computes the masks of many packets
+ * in one call. There is no such context for ChaCha20, whose masks are computed one by one.
+ */
+static int picoquic_set_hp_ecb_from_key(void ** v_hp_ecb, const ptls_cipher_algorithm_t * ctr_cipher, const uint8_t * key)
+{
+    const EVP_CIPHER * ecb = NULL;
+    EVP_CIPHER_CTX * ctx = NULL;
+    int ret = 0;
+
+    if (*v_hp_ecb != NULL) {
+        EVP_CIPHER_CTX_free((EVP_CIPHER_CTX *)*v_hp_ecb);
+        *v_hp_ecb = NULL;
+    }
+
+    if (ctr_cipher == &ptls_openssl_aes128ctr) {
+        ecb = EVP_aes_128_ecb();
+    } else if (ctr_cipher == &ptls_openssl_aes256ctr) {
+        ecb = EVP_aes_256_ecb();
+    }
+
+    if (ecb != NULL) {
+        if ((ctx = EVP_CIPHER_CTX_new()) == NULL) {
+            ret = PTLS_ERROR_NO_MEMORY;
+        } else if (EVP_EncryptInit_ex(ctx, ecb, NULL, key, NULL) != 1 || EVP_CIPHER_CTX_set_padding(ctx, 0) != 1) {
+            EVP_CIPHER_CTX_free(ctx);
+            ret = PTLS_ERROR_LIBRARY;
+        } else {
+            *v_hp_ecb = ctx;
+        }
+    }
+
+    return ret;
+}
+
+static int picoquic_set_hp_enc_from_secret(void ** v_hp_enc, void ** v_hp_ecb, ptls_cipher_suite_t * cipher, int is_enc, const void *secret)
 {
     uint8_t pnekey[PTLS_MAX_SECRET_SIZE];
     int ret;
@@ -628,6 +688,8 @@ static int picoquic_set_hp_enc_from_secret(void ** v_hp_enc, ptls_cipher_suite_t
 #endif
         if ((*v_hp_enc = ptls_cipher_new(cipher->aead->ctr_cipher, is_enc, pnekey)) == NULL) {
             ret = PTLS_ERROR_NO_MEMORY;
+        } else if (v_hp_ecb != NULL) {
+            ret = picoquic_set_hp_ecb_from_key(v_hp_ecb, cipher->aead->ctr_cipher, pnekey);
         }
     }
     
@@ -644,13 +706,13 @@ static int picoquic_set_key_from_secret(picoquic_cnx_t* cnx, ptls_cipher_suite_t
         ret = picoquic_set_aead_from_secret(&ctx->aead_encrypt, cipher, is_enc, secret);
         
         if (ret == 0) {
-            ret = picoquic_set_hp_enc_from_secret(&ctx->hp_enc, cipher, is_enc, secret);
+            ret = picoquic_set_hp_enc_from_secret(&ctx->hp_enc, NULL, cipher, is_enc, secret);
         }
     } else {
         ret = picoquic_set_aead_from_secret(&ctx->aead_decrypt, cipher, is_enc, secret);
         
         if (ret == 0) {
-            ret = picoquic_set_hp_enc_from_secret(&ctx->hp_dec, cipher, is_enc, secret);
+            ret = picoquic_set_hp_enc_from_secret(&ctx->hp_dec, &ctx->hp_dec_ecb, cipher, is_enc, secret);
         }
     }
 
@@ -695,6 +757,8 @@ static int picoquic_update_traffic_key_callback(ptls_update_traffic_key_t * self
 #endif
 
     if (cnx->quic->F_tls_secrets) {
+        /* Keep the line whole when several handshakes run in the TLS pool */
+        flockfile(cnx->quic->F_tls_secrets);
         static const char *log_labels[2][4] = {
                 {NULL, "QUIC_CLIENT_EARLY_TRAFFIC_SECRET", "QUIC_CLIENT_HANDSHAKE_TRAFFIC_SECRET", "QUIC_CLIENT_TRAFFIC_SECRET_0"},
                 {NULL, NULL, "QUIC_SERVER_HANDSHAKE_TRAFFIC_SECRET", "QUIC_SERVER_TRAFFIC_SECRET_0"}};
@@ -709,6 +773,7 @@ static int picoquic_update_traffic_key_callback(ptls_update_traffic_key_t * self
             fprintf(cnx->quic->F_tls_secrets, "%02hhx", ((uint8_t *) secret)[i]);
         }
         fprintf(cnx->quic->F_tls_secrets, "\n");
+        funlockfile(cnx->quic->F_tls_secrets);
     }
     int ret = picoquic_set_key_from_secret(cnx, cipher, is_enc, epoch, secret);
 
@@ -836,6 +901,11 @@ void picoquic_crypto_context_free(picoquic_crypto_context_t * ctx)
         ptls_cipher_free((ptls_cipher_context_t *)ctx->hp_dec);
         ctx->hp_dec = NULL;
     }
+
+    if (ctx->hp_dec_ecb != NULL) {
+        EVP_CIPHER_CTX_free((EVP_CIPHER_CTX *)ctx->hp_dec_ecb);
+        ctx->hp_dec_ecb = NULL;
+    }
 }
 
 /* Definition of supported key exchange algorithms */
@@ -1354,7 +1424,7 @@ void * picoquic_hp_enc_create_for_test(const uint8_t * secret)
     ptls_cipher_suite_t cipher = { 0, &ptls_openssl_aes128gcm, &ptls_openssl_sha256 };
     void *v_hp_enc = NULL;
     
-    (void)picoquic_set_hp_enc_from_secret(&v_hp_enc, &cipher, 1, secret);
+    (void)picoquic_set_hp_enc_from_secret(&v_hp_enc, NULL, &cipher, 1, secret);
 
     return v_hp_enc;
 }
@@ -1370,6 +1440,15 @@ void picoquic_hp_encrypt(void *hp_enc, const void * iv, void *output, const void
     ptls_cipher_encrypt((ptls_cipher_context_t *) hp_enc, output, input, len);
 }
 
+int picoquic_hp_mask_batch(void *hp_ecb, const uint8_t *samples, uint8_t *masks, size_t nb_samples)
+{
+    int masks_length = 0;
+    int ret = EVP_EncryptUpdate((EVP_CIPHER_CTX *) hp_ecb, masks, &masks_length,
+        samples, (int)(nb_samples * PICOQUIC_HP_SAMPLE_SIZE));
+
+    return (ret == 1 && masks_length == (int)(nb_samples * PICOQUIC_HP_SAMPLE_SIZE)) ? 0 : -1;
+}
+
 /* Utility functions, so applications do not have to load picotls.h */
 
 void picoquic_aead_free(void* aead_context)
@@ -1506,12 +1585,344 @@ int picoquic_compare_cleartext_aead_contexts(picoquic_cnx_t* cnx1, picoquic_cnx_
  * should be sent at each epoch.
  */
 
+/* Queues the messages produced by TLS on the crypto streams of their epochs.
+ * Returns the result of the last queuing, or ret if nothing was produced. */
+static int picoquic_tls_push_output(picoquic_cnx_t* cnx, int ret, struct st_ptls_buffer_t* sendbuf,
+    size_t send_offset[PICOQUIC_NUMBER_OF_EPOCH_OFFSETS], int* data_pushed)
+{
+    for (int i = 0; i < PICOQUIC_NUMBER_OF_EPOCHS; i++) {
+        if (send_offset[i] < send_offset[i + 1]) {
+            *data_pushed = 1;
+            ret = picoquic_add_to_tls_stream(cnx,
+                sendbuf->base + send_offset[i], send_offset[i + 1] - send_offset[i], i);
+        }
+    }
+
+    return ret;
+}
+
+/* Updates the connection state once TLS has processed some data of the crypto streams */
+static int picoquic_tls_stream_processed(picoquic_cnx_t* cnx, int ret, int data_pushed)
+{
+    picoquic_tls_ctx_t* ctx = (picoquic_tls_ctx_t*)cnx->tls_ctx;
+
+    if (ret == 0) {
+        switch (cnx->cnx_state) {
+        case picoquic_state_client_retry_received:
+            /* This is not supposed to happen -- HRR should generate "error in progress" */
+            break;
+        case picoquic_state_client_init:
+        case picoquic_state_client_init_sent:
+        case picoquic_state_client_renegotiate:
+        case picoquic_state_client_init_resent:
+        case picoquic_state_client_handshake_start:
+        case picoquic_state_client_handshake_progress:
+            if (ptls_handshake_is_complete(ctx->tls)) {
+                if (cnx->remote_parameters_received == 0) {
+
+#ifdef _DEBUG
+                    DBG_PRINTF("%s", "Connection error - no transport parameter received.\n");
+#endif
+                    ret = picoquic_connection_error(cnx,
+                        PICOQUIC_TRANSPORT_PARAMETER_ERROR, 0);
+                }
+                else {
+                    if (cnx->crypto_context[3].aead_encrypt != NULL) {
+                        picoquic_set_cnx_state(cnx, picoquic_state_client_almost_ready);
+                    }
+                }
+            }
+            break;
+        case picoquic_state_server_init:
+        case picoquic_state_server_handshake:
+            /* If client authentication is activated, the client sends the certificates with its `Finished` packet.
+               The server does not send any further packets, so, we can switch into ready state here.
+            */
+            if (data_pushed == 0 && ((ptls_context_t*)cnx->quic->tls_master_ctx)->require_client_authentication == 1) {
+                picoquic_set_cnx_state(cnx, picoquic_state_server_ready);
+            }
+            else {
+                if (cnx->crypto_context[3].aead_encrypt != NULL) {
+                    picoquic_set_cnx_state(cnx, picoquic_state_server_almost_ready);
+                }
+            }
+            break;
+        case picoquic_state_client_almost_ready:
+        case picoquic_state_handshake_failure:
+        case picoquic_state_client_ready:
+        case picoquic_state_server_almost_ready:
+        case picoquic_state_server_ready:
+        case picoquic_state_disconnecting:
+        case picoquic_state_closing_received:
+        case picoquic_state_closing:
+        case picoquic_state_draining:
+        case picoquic_state_disconnected:
+            break;
+        default:
+            DBG_PRINTF("Unexpected connection state: %d\n", cnx->cnx_state);
+            break;
+        }
+    }
+    else if (ret == PTLS_ERROR_IN_PROGRESS && (cnx->cnx_state == picoquic_state_client_init || cnx->cnx_state == picoquic_state_client_init_sent || cnx->cnx_state == picoquic_state_client_init_resent)) {
+        /* Extract and install the client 0-RTT key */
+#ifdef _DEBUG
+        DBG_PRINTF("%s", "Handshake not yet complete.\n");
+#endif
+    }
+    else if (ret == PTLS_ERROR_IN_PROGRESS &&
+        (cnx->cnx_state == picoquic_state_server_init ||
+            cnx->cnx_state == picoquic_state_server_handshake))
+    {
+        if (ptls_handshake_is_complete(ctx->tls))
+        {
+            picoquic_set_cnx_state(cnx, picoquic_state_server_almost_ready);
+        }
+    }
+
+    if ((ret == 0 || ret == PTLS_ERROR_IN_PROGRESS || ret == PTLS_ERROR_STATELESS_RETRY)) {
+        ret = 0;
+    }
+    else {
+        uint64_t error_code = PICOQUIC_TLS_HANDSHAKE_FAILED;
+
+        if (PTLS_ERROR_GET_CLASS(ret) == PTLS_ERROR_CLASS_SELF_ALERT) {
+            error_code = PICOQUIC_TRANSPORT_CRYPTO_ERROR(ret);
+        }
+#ifdef _DEBUG
+        DBG_PRINTF("Handshake failed, ret = %x.\n", ret);
+#endif
+        (void)picoquic_connection_error(cnx, error_code, 0);
+        ret = 0;
+    }
+
+    return ret;
+}
+
+/*
+ * Asynchronous handshakes.
+ *
+ * When the QUIC context has a TLS pool, the client hello received by a server
+ * is not processed in the packet loop. The data of the first crypto stream is
+ * copied in a job, and the connection is parked until a worker has run
+ * ptls_handle_message. The datagrams received for a parked connection are
+ * kept in the job, and replayed once the result has been posted back by
+ * picoquic_tls_async_poll.
+ *
+ * The worker must not run protocol operations: they may call pluglets, whose
+ * memory allocator is shared by the packet loop. The transport parameters of
+ * the client are thus kept in the job as well, and only processed by
+ * picoquic_tls_async_poll.
+ */
+typedef struct st_picoquic_tls_async_datagram_t {
+    struct st_picoquic_tls_async_datagram_t* next;
+    struct sockaddr_storage addr_from;
+    struct sockaddr_storage addr_to;
+    int if_index_to;
+    uint32_t length;
+    uint8_t bytes[];
+} picoquic_tls_async_datagram_t;
+
+typedef struct st_picoquic_tls_async_job_t {
+    picoquic_tls_job_t job; /* Must be first */
+    picoquic_tls_ctx_t* ctx;
+    uint8_t* input;
+    size_t input_length;
+    struct st_ptls_buffer_t sendbuf;
+    size_t send_offset[PICOQUIC_NUMBER_OF_EPOCH_OFFSETS];
+    int ret;
+    uint8_t* ext_received; /* Transport parameters of the client, processed in the packet loop */
+    size_t ext_received_length;
+    int nb_datagrams;
+    picoquic_tls_async_datagram_t* first_datagram;
+    picoquic_tls_async_datagram_t* last_datagram;
+} picoquic_tls_async_job_t;
+
+static void picoquic_tls_async_run(picoquic_tls_job_t* job)
+{
+    picoquic_tls_async_job_t* async_job = (picoquic_tls_async_job_t*)job;
+
+    async_job->ret = ptls_handle_message(async_job->ctx->tls, &async_job->sendbuf, async_job->send_offset, 0,
+        async_job->input, async_job->input_length, &async_job->ctx->handshake_properties);
+}
+
+static void picoquic_tls_async_job_free(picoquic_tls_async_job_t* job)
+{
+    while (job->first_datagram != NULL) {
+        picoquic_tls_async_datagram_t* datagram = job->first_datagram;
+        job->first_datagram = datagram->next;
+        free(datagram);
+    }
+    ptls_buffer_dispose(&job->sendbuf);
+    free(job->ext_received);
+    free(job->input);
+    free(job);
+}
+
+static int picoquic_tls_async_keep_extension(picoquic_tls_async_job_t* job, const uint8_t* bytes, size_t length)
+{
+    if ((job->ext_received = (uint8_t*)malloc(length)) == NULL) {
+        return PTLS_ERROR_NO_MEMORY;
+    }
+    memcpy(job->ext_received, bytes, length);
+    job->ext_received_length = length;
+
+    return 0;
+}
+
+/* Moves the contiguous data of the first crypto stream to a job, and parks the connection */
+static int picoquic_tls_async_start(picoquic_cnx_t* cnx)
+{
+    picoquic_tls_ctx_t* ctx = (picoquic_tls_ctx_t*)cnx->tls_ctx;
+    picoquic_stream_head* stream = &cnx->tls_stream[0];
+    picoquic_stream_data* data = stream->stream_data;
+    picoquic_tls_async_job_t* job = (picoquic_tls_async_job_t*)calloc(1, sizeof(picoquic_tls_async_job_t));
+    size_t input_length = 0;
+
+    if (job == NULL) {
+        return PICOQUIC_ERROR_MEMORY;
+    }
+
+    for (picoquic_stream_data* next = data; next != NULL && next->offset <= stream->consumed_offset + input_length;
+        next = next->next_stream_data) {
+        input_length = (size_t)(next->offset + next->length - stream->consumed_offset);
+    }
+
+    if ((job->input = (uint8_t*)malloc(input_length)) == NULL) {
+        free(job);
+        return PICOQUIC_ERROR_MEMORY;
+    }
+
+    while (data != NULL && data->offset <= stream->consumed_offset) {
+        size_t start = (size_t)(stream->consumed_offset - data->offset);
+        size_t epoch_data = data->length - start;
+
+        memcpy(job->input + job->input_length, data->bytes + start, epoch_data);
+        job->input_length += epoch_data;
+        stream->consumed_offset += epoch_data;
+
+        free(data->bytes);
+        stream->stream_data = data->next_stream_data;
+        free(data);
+        data = stream->stream_data;
+    }
+
+    job->job.run = picoquic_tls_async_run;
+    job->ctx = ctx;
+    ptls_buffer_init(&job->sendbuf, "", 0);
+    ctx->async_job = job;
+    cnx->tls_pending = 1;
+    cnx->quic->nb_tls_parked++;
+    picoquic_tls_pool_stage(cnx->quic->tls_pool, &job->job);
+
+    return 0;
+}
+
+int picoquic_tls_async_poll(picoquic_cnx_t* cnx, uint64_t current_time)
+{
+    picoquic_tls_ctx_t* ctx = (picoquic_tls_ctx_t*)cnx->tls_ctx;
+    picoquic_tls_async_job_t* job = ctx->async_job;
+    picoquic_tls_async_datagram_t* datagram;
+    int data_pushed = 0;
+    int ret;
+
+    if (job == NULL) {
+        return 0;
+    } else if (!picoquic_tls_job_is_done(&job->job)) {
+        return 1;
+    }
+
+    ctx->async_job = NULL;
+    cnx->tls_pending = 0;
+    cnx->quic->nb_tls_parked--;
+
+    if (job->ext_received != NULL) {
+        size_t consumed = 0;
+        ctx->ext_received_return = picoquic_receive_transport_extensions(cnx, 0,
+            job->ext_received, job->ext_received_length, &consumed);
+    }
+
+    ret = job->ret;
+    if (ret == 0 || ret == PTLS_ERROR_IN_PROGRESS || ret == PTLS_ERROR_STATELESS_RETRY) {
+        ret = picoquic_tls_push_output(cnx, ret, &job->sendbuf, job->send_offset, &data_pushed);
+    }
+    (void)picoquic_tls_stream_processed(cnx, ret, data_pushed);
+    picoquic_cnx_set_next_wake_time(cnx, current_time, 1);
+
+    /* The replayed datagrams may park the connection again, detach them first */
+    datagram = job->first_datagram;
+    job->first_datagram = NULL;
+    picoquic_tls_async_job_free(job);
+
+    while (datagram != NULL) {
+        picoquic_tls_async_datagram_t* next = datagram->next;
+        int new_context_created = 0;
+
+        (void)picoquic_incoming_packet(cnx->quic, datagram->bytes, datagram->length,
+            (struct sockaddr*)&datagram->addr_from, (struct sockaddr*)&datagram->addr_to,
+            datagram->if_index_to, current_time, &new_context_created);
+        free(datagram);
+        datagram = next;
+    }
+
+    return 0;
+}
+
+int picoquic_tls_async_queue_datagram(picoquic_cnx_t* cnx, uint8_t* bytes, uint32_t length,
+    struct sockaddr* addr_from, struct sockaddr* addr_to, int if_index_to)
+{
+    picoquic_tls_async_job_t* job = ((picoquic_tls_ctx_t*)cnx->tls_ctx)->async_job;
+    picoquic_tls_async_datagram_t* datagram;
+
+    if (job == NULL || job->nb_datagrams >= PICOQUIC_TLS_ASYNC_MAX_DATAGRAMS ||
+        (datagram = (picoquic_tls_async_datagram_t*)malloc(sizeof(picoquic_tls_async_datagram_t) + length)) == NULL) {
+        /* The peer will repeat what was dropped */
+        return -1;
+    }
+
+    memset(datagram, 0, sizeof(picoquic_tls_async_datagram_t));
+    memcpy(&datagram->addr_from, addr_from,
+        (addr_from->sa_family == AF_INET) ? sizeof(struct sockaddr_in) : sizeof(struct sockaddr_in6));
+    memcpy(&datagram->addr_to, addr_to,
+        (addr_to->sa_family == AF_INET) ? sizeof(struct sockaddr_in) : sizeof(struct sockaddr_in6));
+    datagram->if_index_to = if_index_to;
+    datagram->length = length;
+    memcpy(datagram->bytes, bytes, length);
+
+    if (job->last_datagram == NULL) {
+        job->first_datagram = datagram;
+    } else {
+        job->last_datagram->next = datagram;
+    }
+    job->last_datagram = datagram;
+    job->nb_datagrams++;
+
+    return 0;
+}
+
+void picoquic_tls_async_cancel(picoquic_cnx_t* cnx)
+{
+    picoquic_tls_ctx_t* ctx = (picoquic_tls_ctx_t*)cnx->tls_ctx;
+
+    if (ctx != NULL && ctx->async_job != NULL) {
+        picoquic_tls_pool_cancel(cnx->quic->tls_pool, &ctx->async_job->job);
+        picoquic_tls_async_job_free(ctx->async_job);
+        ctx->async_job = NULL;
+        cnx->tls_pending = 0;
+        cnx->quic->nb_tls_parked--;
+    }
+}
+
 int picoquic_tls_stream_process(picoquic_cnx_t* cnx)
 {
     int ret = 0;
     picoquic_tls_ctx_t* ctx = (picoquic_tls_ctx_t*)cnx->tls_ctx;
     size_t next_epoch = 0;
 
+    if (ctx->async_job != NULL) {
+        /* The connection is parked, its data is processed when the job is done */
+        return 0;
+    }
+
     for (size_t epoch = 0; epoch < PICOQUIC_NUMBER_OF_EPOCHS && ret == 0; epoch++) {
         picoquic_stream_head* stream = &cnx->tls_stream[epoch];
         picoquic_stream_data* data = stream->stream_data;
@@ -1537,6 +1948,13 @@ int picoquic_tls_stream_process(picoquic_cnx_t* cnx)
             }
         }
 
+        if (epoch == 0 && cnx->quic->tls_pool != NULL && cnx->cnx_state == picoquic_state_server_init &&
+            data != NULL && data->offset <= stream->consumed_offset) {
+            /* The client hello costs the server a key exchange and a signature */
+            ret = picoquic_tls_async_start(cnx);
+            break;
+        }
+
         while ((ret == 0 || ret == PTLS_ERROR_IN_PROGRESS) &&
             data != NULL && data->offset <= stream->consumed_offset) {
             struct st_ptls_buffer_t sendbuf;
@@ -1557,13 +1975,7 @@ int picoquic_tls_stream_process(picoquic_cnx_t* cnx)
 #endif
             if ((ret == 0 || ret == PTLS_ERROR_IN_PROGRESS ||
                 ret == PTLS_ERROR_STATELESS_RETRY)) {
-                for (int i = 0; i < PICOQUIC_NUMBER_OF_EPOCHS; i++) {
-                    if (send_offset[i] < send_offset[i + 1]) {
-                        data_pushed = 1;
-                        ret = picoquic_add_to_tls_stream(cnx,
-                            sendbuf.base + send_offset[i], send_offset[i + 1] - send_offset[i], i);
-                    }
-                }
+                ret = picoquic_tls_push_output(cnx, ret, &sendbuf, send_offset, &data_pushed);
             }
 
             stream->consumed_offset += epoch_data;
@@ -1580,94 +1992,7 @@ int picoquic_tls_stream_process(picoquic_cnx_t* cnx)
         }
 
         if (processed > 0) {
-            if (ret == 0) {
-                switch (cnx->cnx_state) {
-                case picoquic_state_client_retry_received:
-                    /* This is not supposed to happen -- HRR should generate "error in progress" */
-                    break;
-                case picoquic_state_client_init:
-                case picoquic_state_client_init_sent:
-                case picoquic_state_client_renegotiate:
-                case picoquic_state_client_init_resent:
-                case picoquic_state_client_handshake_start:
-                case picoquic_state_client_handshake_progress:
-                    if (ptls_handshake_is_complete(ctx->tls)) {
-                        if (cnx->remote_parameters_received == 0) {
-
-#ifdef _DEBUG
-                            DBG_PRINTF("%s", "Connection error - no transport parameter received.\n");
-#endif
-                            ret = picoquic_connection_error(cnx,
-                                PICOQUIC_TRANSPORT_PARAMETER_ERROR, 0);
-                        }
-                        else {
-                            if (cnx->crypto_context[3].aead_encrypt != NULL) {
-                                picoquic_set_cnx_state(cnx, picoquic_state_client_almost_ready);
-                            }
-                        }
-                    }
-                    break;
-                case picoquic_state_server_init:
-                case picoquic_state_server_handshake:
-                    /* If client authentication is activated, the client sends the certificates with its `Finished` packet.
-                       The server does not send any further packets, so, we can switch into ready state here.
-                    */
-                    if (data_pushed == 0 && ((ptls_context_t*)cnx->quic->tls_master_ctx)->require_client_authentication == 1) {
-                        picoquic_set_cnx_state(cnx, picoquic_state_server_ready);
-                    }
-                    else {
-                        if (cnx->crypto_context[3].aead_encrypt != NULL) {
-                            picoquic_set_cnx_state(cnx, picoquic_state_server_almost_ready);
-                        }
-                    }
-                    break;
-                case picoquic_state_client_almost_ready:
-                case picoquic_state_handshake_failure:
-                case picoquic_state_client_ready:
-                case picoquic_state_server_almost_ready:
-                case picoquic_state_server_ready:
-                case picoquic_state_disconnecting:
-                case picoquic_state_closing_received:
-                case picoquic_state_closing:
-                case picoquic_state_draining:
-                case picoquic_state_disconnected:
-                    break;
-                default:
-                    DBG_PRINTF("Unexpected connection state: %d\n", cnx->cnx_state);
-                    break;
-                }
-            }
-            else if (ret == PTLS_ERROR_IN_PROGRESS && (cnx->cnx_state == picoquic_state_client_init || cnx->cnx_state == picoquic_state_client_init_sent || cnx->cnx_state == picoquic_state_client_init_resent)) {
-                /* Extract and install the client 0-RTT key */
-#ifdef _DEBUG
-                DBG_PRINTF("%s", "Handshake not yet complete.\n");
-#endif
-            }
-            else if (ret == PTLS_ERROR_IN_PROGRESS &&
-                (cnx->cnx_state == picoquic_state_server_init ||
-                    cnx->cnx_state == picoquic_state_server_handshake))
-            {
-                if (ptls_handshake_is_complete(ctx->tls))
-                {
-                    picoquic_set_cnx_state(cnx, picoquic_state_server_almost_ready);
-                }
-            }
-
-            if ((ret == 0 || ret == PTLS_ERROR_IN_PROGRESS || ret == PTLS_ERROR_STATELESS_RETRY)) {
-                ret = 0;
-            }
-            else {
-                uint64_t error_code = PICOQUIC_TLS_HANDSHAKE_FAILED;
-
-                if (PTLS_ERROR_GET_CLASS(ret) == PTLS_ERROR_CLASS_SELF_ALERT) {
-                    error_code = PICOQUIC_TRANSPORT_CRYPTO_ERROR(ret);
-                }
-#ifdef _DEBUG
-                DBG_PRINTF("Handshake failed, ret = %x.\n", ret);
-#endif
-                (void)picoquic_connection_error(cnx, error_code, 0);
-                ret = 0;
-            }
+            ret = picoquic_tls_stream_processed(cnx, ret, data_pushed);
         }
     }
 
@@ -46,6 +46,19 @@ void picoquic_tlscontext_remove_ticket(picoquic_cnx_t* cnx);
 
 int picoquic_tls_stream_process(picoquic_cnx_t* cnx);
 
+#define PICOQUIC_TLS_ASYNC_MAX_DATAGRAMS 16 /* Datagrams kept for a parked connection */
+
+/* Returns 1 while the connection waits for the TLS pool. Once the job is done,
+ * posts its result to the connection and replays the datagrams it received. */
+int picoquic_tls_async_poll(picoquic_cnx_t* cnx, uint64_t current_time);
+
+/* Keeps a datagram received for a parked connection, returns -1 if it is dropped */
+int picoquic_tls_async_queue_datagram(picoquic_cnx_t* cnx, uint8_t* bytes, uint32_t length,
+    struct sockaddr* addr_from, struct sockaddr* addr_to, int if_index_to);
+
+/* Drops the job of a parked connection, waiting for the worker if it already runs */
+void picoquic_tls_async_cancel(picoquic_cnx_t* cnx);
+
 int picoquic_initialize_tls_stream(picoquic_cnx_t* cnx);
 
 uint64_t picoquic_get_tls_time(picoquic_quic_t* quic);
@@ -72,6 +85,10 @@ size_t picoquic_hp_iv_size(void *hp_enc);
 
 void picoquic_hp_encrypt(void *hp_enc, const void *iv, void *output, const void *input, size_t len);
 
+/* The AES mask of a packet is the encryption of its 16 bytes sample, the masks are written in the same order */
+#define PICOQUIC_HP_SAMPLE_SIZE 16
+int picoquic_hp_mask_batch(void *hp_ecb, const uint8_t *samples, uint8_t *masks, size_t nb_samples);
+
 typedef const struct st_ptls_cipher_suite_t ptls_cipher_suite_t;
 
 int picoquic_setup_initial_master_secret(
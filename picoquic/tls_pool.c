@@ -0,0 +1,234 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+#include "tls_pool.h"
+
+struct st_picoquic_tls_pool_t {
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond; /* A job was queued or the pool stops */
+    pthread_cond_t done_cond; /* A job is done */
+    pthread_mutex_t shared_lock;
+    picoquic_tls_job_t* first_queued;
+    picoquic_tls_job_t* last_queued;
+    uint64_t nb_queued;
+    int stopping;
+    int event_fd;
+
+    /* Loop thread only */
+    picoquic_tls_job_t* first_staged;
+    picoquic_tls_job_t* last_staged;
+
+    picoquic_tls_pool_stats_t stats;
+
+    int nb_threads;
+    pthread_t threads[PICOQUIC_TLS_POOL_MAX_THREADS];
+};
+
+static void* tls_pool_worker(void* arg)
+{
+    picoquic_tls_pool_t* pool = (picoquic_tls_pool_t*)arg;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        picoquic_tls_job_t* job;
+
+        while (!pool->stopping && pool->first_queued == NULL) {
+            pthread_cond_wait(&pool->work_cond, &pool->lock);
+        }
+        if (pool->stopping) {
+            break;
+        }
+
+        job = pool->first_queued;
+        pool->first_queued = job->next;
+        if (pool->first_queued == NULL) {
+            pool->last_queued = NULL;
+        }
+        pool->nb_queued--;
+        job->next = NULL;
+        __atomic_store_n(&job->state, picoquic_tls_job_running, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&pool->lock);
+
+        job->run(job);
+
+        pthread_mutex_lock(&pool->lock);
+        __atomic_store_n(&job->state, picoquic_tls_job_done, __ATOMIC_RELEASE);
+        pool->stats.nb_done++;
+        pthread_cond_broadcast(&pool->done_cond);
+#ifdef __linux__
+        if (pool->event_fd != -1) {
+            uint64_t one = 1;
+            (void)write(pool->event_fd, &one, sizeof(one));
+        }
+#endif
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+picoquic_tls_pool_t* picoquic_tls_pool_create(int nb_threads)
+{
+    picoquic_tls_pool_t* pool = NULL;
+
+    if (nb_threads <= 0 || nb_threads > PICOQUIC_TLS_POOL_MAX_THREADS ||
+        (pool = (picoquic_tls_pool_t*)calloc(1, sizeof(picoquic_tls_pool_t))) == NULL) {
+        return NULL;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_mutex_init(&pool->shared_lock, NULL);
+    pthread_cond_init(&pool->work_cond, NULL);
+    pthread_cond_init(&pool->done_cond, NULL);
+#ifdef __linux__
+    pool->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#else
+    pool->event_fd = -1;
+#endif
+
+    while (pool->nb_threads < nb_threads) {
+        if (pthread_create(&pool->threads[pool->nb_threads], NULL, tls_pool_worker, pool) != 0) {
+            picoquic_tls_pool_free(pool);
+            return NULL;
+        }
+        pool->nb_threads++;
+    }
+
+    return pool;
+}
+
+void picoquic_tls_pool_free(picoquic_tls_pool_t* pool)
+{
+    if (pool != NULL) {
+        pthread_mutex_lock(&pool->lock);
+        pool->stopping = 1;
+        pthread_cond_broadcast(&pool->work_cond);
+        pthread_mutex_unlock(&pool->lock);
+
+        for (int i = 0; i < pool->nb_threads; i++) {
+            pthread_join(pool->threads[i], NULL);
+        }
+
+        if (pool->event_fd != -1) {
+            close(pool->event_fd);
+        }
+        pthread_cond_destroy(&pool->work_cond);
+        pthread_cond_destroy(&pool->done_cond);
+        pthread_mutex_destroy(&pool->shared_lock);
+        pthread_mutex_destroy(&pool->lock);
+        free(pool);
+    }
+}
+
+void picoquic_tls_pool_stage(picoquic_tls_pool_t* pool, picoquic_tls_job_t* job)
+{
+    job->next = NULL;
+    job->state = picoquic_tls_job_staged;
+    if (pool->last_staged == NULL) {
+        pool->first_staged = job;
+    } else {
+        pool->last_staged->next = job;
+    }
+    pool->last_staged = job;
+}
+
+void picoquic_tls_pool_submit(picoquic_tls_pool_t* pool)
+{
+    if (pool->first_staged != NULL) {
+        pthread_mutex_lock(&pool->lock);
+        for (picoquic_tls_job_t* job = pool->first_staged; job != NULL; job = job->next) {
+            __atomic_store_n(&job->state, picoquic_tls_job_queued, __ATOMIC_RELAXED);
+            pool->nb_queued++;
+            pool->stats.nb_jobs++;
+        }
+        if (pool->last_queued == NULL) {
+            pool->first_queued = pool->first_staged;
+        } else {
+            pool->last_queued->next = pool->first_staged;
+        }
+        pool->last_queued = pool->last_staged;
+        if (pool->nb_queued > pool->stats.max_queued) {
+            pool->stats.max_queued = pool->nb_queued;
+        }
+        pthread_cond_broadcast(&pool->work_cond);
+        pthread_mutex_unlock(&pool->lock);
+
+        pool->first_staged = NULL;
+        pool->last_staged = NULL;
+    }
+}
+
+int picoquic_tls_job_is_done(picoquic_tls_job_t* job)
+{
+    return __atomic_load_n(&job->state, __ATOMIC_ACQUIRE) == picoquic_tls_job_done;
+}
+
+/* Unlinks the job from a list, returns 1 if it was found */
+static int tls_pool_unlink(picoquic_tls_job_t** first, picoquic_tls_job_t** last, picoquic_tls_job_t* job)
+{
+    picoquic_tls_job_t* previous = NULL;
+
+    for (picoquic_tls_job_t* next = *first; next != NULL; previous = next, next = next->next) {
+        if (next == job) {
+            if (previous == NULL) {
+                *first = job->next;
+            } else {
+                previous->next = job->next;
+            }
+            if (*last == job) {
+                *last = previous;
+            }
+            job->next = NULL;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+void picoquic_tls_pool_cancel(picoquic_tls_pool_t* pool, picoquic_tls_job_t* job)
+{
+    pthread_mutex_lock(&pool->lock);
+    if (job->state == picoquic_tls_job_staged) {
+        (void)tls_pool_unlink(&pool->first_staged, &pool->last_staged, job);
+        pool->stats.nb_cancelled++;
+    } else {
+        if (job->state == picoquic_tls_job_queued) {
+            if (tls_pool_unlink(&pool->first_queued, &pool->last_queued, job)) {
+                pool->nb_queued--;
+            }
+            pool->stats.nb_cancelled++;
+        } else {
+            while (job->state != picoquic_tls_job_done) {
+                pthread_cond_wait(&pool->done_cond, &pool->lock);
+            }
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void picoquic_tls_pool_lock_shared(picoquic_tls_pool_t* pool)
+{
+    pthread_mutex_lock(&pool->shared_lock);
+}
+
+void picoquic_tls_pool_unlock_shared(picoquic_tls_pool_t* pool)
+{
+    pthread_mutex_unlock(&pool->shared_lock);
+}
+
+int picoquic_tls_pool_get_eventfd(picoquic_tls_pool_t* pool)
+{
+    return pool->event_fd;
+}
+
+void picoquic_tls_pool_get_stats(picoquic_tls_pool_t* pool, picoquic_tls_pool_stats_t* stats)
+{
+    pthread_mutex_lock(&pool->lock);
+    *stats = pool->stats;
+    pthread_mutex_unlock(&pool->lock);
+}
@@ -0,0 +1,85 @@
+/**
+ * \file tls_pool.h
+ * \brief Worker threads running the TLS handshakes out of the packet loop.
+ *
+ * Processing a client hello costs a key exchange and a signature, which take
+ * far longer than processing a packet. When a server handles it in the
+ * packet loop, a burst of new connections delays the packets of all the
+ * established ones. With a pool, the packet loop stages a job per client
+ * hello, and the jobs staged while processing a datagram are handed to the
+ * worker threads at once. Until its job is done, the connection is parked:
+ * the packet loop does not touch it, except to check whether the job is done.
+ *
+ * The pool does not know what a job does. The loop thread owns the jobs: it
+ * allocates them, and frees them once they are done or cancelled.
+ *
+ * On Linux, the pool signals an eventfd each time a job is done, so that a
+ * loop waiting in select or poll can wake up as soon as a result is ready.
+ */
+
+#ifndef PICOQUIC_TLS_POOL_H
+#define PICOQUIC_TLS_POOL_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PICOQUIC_TLS_POOL_MAX_THREADS 64
+#define PICOQUIC_TLS_POOL_POLL_DELAY 1000 /* Time between checks of a parked connection, in microseconds */
+
+typedef enum {
+    picoquic_tls_job_staged = 0,
+    picoquic_tls_job_queued,
+    picoquic_tls_job_running,
+    picoquic_tls_job_done
+} picoquic_tls_job_state_enum;
+
+typedef struct st_picoquic_tls_job_t {
+    struct st_picoquic_tls_job_t* next;
+    void (*run)(struct st_picoquic_tls_job_t* job); /* Called on a worker thread */
+    int state;
+} picoquic_tls_job_t;
+
+typedef struct st_picoquic_tls_pool_stats_t {
+    uint64_t nb_jobs;      /* Jobs handed to the workers */
+    uint64_t nb_done;
+    uint64_t nb_cancelled; /* Jobs cancelled before they ran */
+    uint64_t max_queued;   /* Largest number of jobs waiting for a worker */
+} picoquic_tls_pool_stats_t;
+
+typedef struct st_picoquic_tls_pool_t picoquic_tls_pool_t;
+
+/* Starts nb_threads workers, at most PICOQUIC_TLS_POOL_MAX_THREADS. Returns NULL on failure. */
+picoquic_tls_pool_t* picoquic_tls_pool_create(int nb_threads);
+
+/* Stops the workers after their current job. The jobs that did not run are left as they are. */
+void picoquic_tls_pool_free(picoquic_tls_pool_t* pool);
+
+/* Adds a job to the staged jobs, which only the loop thread sees */
+void picoquic_tls_pool_stage(picoquic_tls_pool_t* pool, picoquic_tls_job_t* job);
+
+/* Hands all the staged jobs to the workers */
+void picoquic_tls_pool_submit(picoquic_tls_pool_t* pool);
+
+/* Once it returns 1, the worker does not access the job anymore */
+int picoquic_tls_job_is_done(picoquic_tls_job_t* job);
+
+/* Removes a job that did not start, or waits until a running job is done */
+void picoquic_tls_pool_cancel(picoquic_tls_pool_t* pool, picoquic_tls_job_t* job);
+
+/* Serializes the jobs accessing a state shared by all the connections */
+void picoquic_tls_pool_lock_shared(picoquic_tls_pool_t* pool);
+void picoquic_tls_pool_unlock_shared(picoquic_tls_pool_t* pool);
+
+/* Returns -1 if the platform has no eventfd. Reading the counter is left to the caller. */
+int picoquic_tls_pool_get_eventfd(picoquic_tls_pool_t* pool);
+
+void picoquic_tls_pool_get_stats(picoquic_tls_pool_t* pool, picoquic_tls_pool_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PICOQUIC_TLS_POOL_H */
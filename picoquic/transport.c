@@ -237,6 +237,9 @@ int picoquic_prepare_transport_extensions(picoquic_cnx_t* cnx, int extension_mod
     if (cnx->local_parameters.max_packet_size >= 1200) {
         param_size += (1 + 1 + 2);
     }
+    if (cnx->local_parameters.min_ack_delay > 0) {
+        param_size += (1 + 1 + picoquic_varint_len(cnx->local_parameters.min_ack_delay));
+    }
 
     size_t supported_plugins_len = picoquic_get_supported_plugins_transport_parameter(cnx);
     if (supported_plugins_len > 0) {
@@ -311,6 +314,12 @@ int picoquic_prepare_transport_extensions(picoquic_cnx_t* cnx, int extension_mod
                                            cnx->local_parameters.initial_max_stream_data_uni);
         }
 
+        if (cnx->local_parameters.min_ack_delay > 0) {
+            byte_index += tp_varint_encode(bytes + byte_index, bytes_max - byte_index,
+                                           picoquic_tp_min_ack_delay,
+                                           cnx->local_parameters.min_ack_delay);
+        }
+
         if (supported_plugins_len > 0) {
             byte_index += tp_data_encode(bytes + byte_index, bytes_max - byte_index,
                                          picoquic_tp_supported_plugins,
@@ -372,6 +381,7 @@ int picoquic_receive_transport_extensions(picoquic_cnx_t* cnx, int extension_mod
                         case picoquic_tp_max_idle_timeout:
                         case picoquic_tp_max_ack_delay:
                         case picoquic_tp_active_connection_id_limit:
+                        case picoquic_tp_min_ack_delay:
                            if (extension_length != 1 && extension_length != 2 && extension_length != 4 && extension_length != 8) {
                                ret = picoquic_connection_error(cnx, PICOQUIC_TRANSPORT_PARAMETER_ERROR, 0);
                                break;
@@ -479,6 +489,12 @@ int picoquic_receive_transport_extensions(picoquic_cnx_t* cnx, int extension_mod
                             ret = picoquic_connection_error(cnx, PICOQUIC_TRANSPORT_PARAMETER_ERROR, 0);
                         }
                         break;
+                    case picoquic_tp_min_ack_delay:
+                        byte_index += picoquic_varint_decode(bytes + byte_index, bytes_max - byte_index, &cnx->remote_parameters.min_ack_delay);
+                        if (cnx->remote_parameters.min_ack_delay > cnx->remote_parameters.max_ack_delay * 1000) {
+                            ret = picoquic_connection_error(cnx, PICOQUIC_TRANSPORT_PARAMETER_ERROR, 0);
+                        }
+                        break;
                     case picoquic_tp_supported_plugins:
                         if (extension_length > 0) {
                             cnx->remote_parameters.supported_plugins = malloc(sizeof(char) * extension_length);
@@ -23,6 +23,9 @@
 #include "picoquic_logger.h"
 #include "red_black_tree.h"
 #include "cc_common.h"
+#include "picoquic_internal.h"
+#include "probes.h"
+#include "native_pluglet.h"
 
 #if defined(NS3)
 #define JIT false
@@ -36,149 +39,221 @@ void picoquic_memory_bound_error(uint64_t val, uint64_t mem_ptr, uint64_t stack_
     printf("Out of bound access with val 0x%" PRIx64 ", start of mem is 0x%" PRIx64 ", top of stack is 0x%" PRIx64 "\n", val, mem_ptr, stack_ptr);
 }
 
-static void
-register_functions(struct ubpf_vm *vm) {
-    /* We only have 64 values ... (so far) */
-    unsigned int current_idx = 0;
+/* The functions the pluglets can call, registered in this order */
+static const struct {
+    const char *name;
+    void *fn;
+} pluglet_helpers[] = {
     /* specific API related */
-    ubpf_register(vm, current_idx++, "plugin_run_protoop", plugin_run_protoop);
-    ubpf_register(vm, current_idx++, "reserve_frames", reserve_frames);
-    ubpf_register(vm, current_idx++, "get_cnx", get_cnx);
-    ubpf_register(vm, current_idx++, "set_cnx", set_cnx);
-    ubpf_register(vm, current_idx++, "get_cnx_metadata", get_cnx_metadata);
-    ubpf_register(vm, current_idx++, "set_cnx_metadata", set_cnx_metadata);
-    ubpf_register(vm, current_idx++, "get_path", get_path);
-    ubpf_register(vm, current_idx++, "set_path", set_path);
-    ubpf_register(vm, current_idx++, "get_path_metadata", get_path_metadata);
-    ubpf_register(vm, current_idx++, "set_path_metadata", set_path_metadata);
-    ubpf_register(vm, current_idx++, "get_pkt_ctx", get_pkt_ctx);
-    ubpf_register(vm, current_idx++, "set_pkt_ctx", set_pkt_ctx);
-    ubpf_register(vm, current_idx++, "get_pkt", get_pkt);
-    ubpf_register(vm, current_idx++, "set_pkt", set_pkt);
-    ubpf_register(vm, current_idx++, "get_pkt_metadata", get_pkt_metadata);
-    ubpf_register(vm, current_idx++, "set_pkt_metadata", set_pkt_metadata);
-    ubpf_register(vm, current_idx++, "get_sack_item", get_sack_item);
-    ubpf_register(vm, current_idx++, "set_sack_item", set_sack_item);
-    ubpf_register(vm, current_idx++, "get_cnxid", get_cnxid);
-    ubpf_register(vm, current_idx++, "set_cnxid", set_cnxid);
-    ubpf_register(vm, current_idx++, "get_stream_head", get_stream_head);
-    ubpf_register(vm, current_idx++, "set_stream_head", set_stream_head);
-    ubpf_register(vm, current_idx++, "get_stream_data", get_stream_data);
-    ubpf_register(vm, current_idx++, "get_crypto_context", get_crypto_context);
-    ubpf_register(vm, current_idx++, "set_crypto_context", set_crypto_context);
-    ubpf_register(vm, current_idx++, "get_ph", get_ph);
-    ubpf_register(vm, current_idx++, "set_ph", set_ph);
-    ubpf_register(vm, current_idx++, "cancel_head_reservation", cancel_head_reservation);
+    { "plugin_run_protoop", plugin_run_protoop },
+    { "reserve_frames", reserve_frames },
+    { "get_cnx", get_cnx },
+    { "set_cnx", set_cnx },
+    { "get_cnx_metadata", get_cnx_metadata },
+    { "set_cnx_metadata", set_cnx_metadata },
+    { "get_cnx_fields", get_cnx_fields },
+    { "set_cnx_fields", set_cnx_fields },
+    { "get_path", get_path },
+    { "set_path", set_path },
+    { "get_path_metadata", get_path_metadata },
+    { "set_path_metadata", set_path_metadata },
+    { "get_path_fields", get_path_fields },
+    { "set_path_fields", set_path_fields },
+    { "get_pkt_ctx", get_pkt_ctx },
+    { "set_pkt_ctx", set_pkt_ctx },
+    { "get_pkt", get_pkt },
+    { "set_pkt", set_pkt },
+    { "get_pkt_metadata", get_pkt_metadata },
+    { "set_pkt_metadata", set_pkt_metadata },
+    { "get_pkt_fields", get_pkt_fields },
+    { "get_sack_item", get_sack_item },
+    { "set_sack_item", set_sack_item },
+    { "get_cnxid", get_cnxid },
+    { "set_cnxid", set_cnxid },
+    { "get_stream_head", get_stream_head },
+    { "set_stream_head", set_stream_head },
+    { "get_stream_data", get_stream_data },
+    { "get_crypto_context", get_crypto_context },
+    { "set_crypto_context", set_crypto_context },
+    { "get_ph", get_ph },
+    { "set_ph", set_ph },
+    { "cancel_head_reservation", cancel_head_reservation },
     /* specific to picoquic, how to remove this dependency ? */
-    ubpf_register(vm, current_idx++, "picoquic_reinsert_cnx_by_wake_time", picoquic_reinsert_cnx_by_wake_time);
-    ubpf_register(vm, current_idx++, "picoquic_current_time", picoquic_current_time);
+    { "picoquic_reinsert_cnx_by_wake_time", picoquic_reinsert_cnx_by_wake_time },
+    { "picoquic_current_time", picoquic_current_time },
     /* for memory */
-    ubpf_register(vm, current_idx++, "my_malloc", my_malloc);
-    ubpf_register(vm, current_idx++, "my_free", my_free);
-    ubpf_register(vm, current_idx++, "my_realloc", my_realloc);
-    ubpf_register(vm, current_idx++, "my_memcpy", my_memcpy);
-    ubpf_register(vm, current_idx++, "my_memset", my_memset);
+    { "my_malloc", my_malloc },
+    { "my_free", my_free },
+    { "my_realloc", my_realloc },
+    { "my_memcpy", my_memcpy },
+    { "my_memset", my_memset },
 
-    ubpf_register(vm, current_idx++, "clock_gettime", clock_gettime);
+    { "clock_gettime", clock_gettime },
 
     /* Network with linux */
-    ubpf_register(vm, current_idx++, "getsockopt", getsockopt);
-    ubpf_register(vm, current_idx++, "setsockopt", setsockopt);
-    ubpf_register(vm, current_idx++, "socket", socket);
-    ubpf_register(vm, current_idx++, "connect", connect);
-    ubpf_register(vm, current_idx++, "send", send);
-    ubpf_register(vm, current_idx++, "inet_aton", inet_aton);
-    ubpf_register(vm, current_idx++, "socketpair", socketpair);
-    ubpf_register(vm, current_idx++, "write", write);
-    ubpf_register(vm, current_idx++, "close", close);
-    ubpf_register(vm, current_idx++, "get_errno", get_errno);
-
-    ubpf_register(vm, current_idx++, "my_htons", my_htons);
-    ubpf_register(vm, current_idx++, "my_ntohs", my_ntohs);
-
-    ubpf_register(vm, current_idx++, "strncmp", strncmp);
-    ubpf_register(vm, current_idx++, "strlen", strlen);
+    { "getsockopt", getsockopt },
+    { "setsockopt", setsockopt },
+    { "socket", socket },
+    { "connect", connect },
+    { "send", send },
+    { "inet_aton", inet_aton },
+    { "socketpair", socketpair },
+    { "write", write },
+    { "close", close },
+    { "get_errno", get_errno },
+
+    { "my_htons", my_htons },
+    { "my_ntohs", my_ntohs },
+
+    { "strncmp", strncmp },
+    { "strlen", strlen },
 
     // logging func
 
-    ubpf_register(vm, current_idx++, "picoquic_has_booked_plugin_frames", picoquic_has_booked_plugin_frames);
+    { "picoquic_has_booked_plugin_frames", picoquic_has_booked_plugin_frames },
 
     /* Specific QUIC functions */
-    ubpf_register(vm, current_idx++, "picoquic_decode_frames_without_current_time", picoquic_decode_frames_without_current_time);
-    ubpf_register(vm, current_idx++, "picoquic_varint_decode", picoquic_varint_decode);
-    ubpf_register(vm, current_idx++, "picoquic_varint_encode", picoquic_varint_encode);
-    ubpf_register(vm, current_idx++, "picoquic_varint_skip", picoquic_varint_skip);
-    ubpf_register(vm, current_idx++, "picoquic_create_random_cnx_id_for_cnx", picoquic_create_random_cnx_id_for_cnx);
-    ubpf_register(vm, current_idx++, "picoquic_create_cnxid_reset_secret_for_cnx", picoquic_create_cnxid_reset_secret_for_cnx);
-    ubpf_register(vm, current_idx++, "picoquic_register_cnx_id_for_cnx", picoquic_register_cnx_id_for_cnx);
-    ubpf_register(vm, current_idx++, "picoquic_create_path", picoquic_create_path);
-    ubpf_register(vm, current_idx++, "picoquic_getaddrs", picoquic_getaddrs);
-    ubpf_register(vm, current_idx++, "picoquic_compare_connection_id", picoquic_compare_connection_id);
-
-    ubpf_register(vm, current_idx++, "picoquic_compare_addr", picoquic_compare_addr);
-    ubpf_register(vm, current_idx++, "picoquic_parse_stream_header", picoquic_parse_stream_header);
-    ubpf_register(vm, current_idx++, "picoquic_find_stream", picoquic_find_stream);
-    ubpf_register(vm, current_idx++, "picoquic_set_cnx_state", picoquic_set_cnx_state);
-    ubpf_register(vm, current_idx++, "picoquic_frames_varint_decode", picoquic_frames_varint_decode);
-    ubpf_register(vm, current_idx++, "picoquic_record_pn_received", picoquic_record_pn_received);
-    ubpf_register(vm, current_idx++, "picoquic_cc_get_sequence_number", picoquic_cc_get_sequence_number);
-    ubpf_register(vm, current_idx++, "picoquic_cc_was_cwin_blocked", picoquic_cc_was_cwin_blocked);
-    ubpf_register(vm, current_idx++, "picoquic_is_sending_authorized_by_pacing", picoquic_is_sending_authorized_by_pacing);
-    ubpf_register(vm, current_idx++, "picoquic_update_pacing_data", picoquic_update_pacing_data);
-
-    ubpf_register(vm, current_idx++, "queue_peek", queue_peek);
+    { "picoquic_decode_frames_without_current_time", picoquic_decode_frames_without_current_time },
+    { "picoquic_varint_decode", picoquic_varint_decode },
+    { "picoquic_varint_encode", picoquic_varint_encode },
+    { "picoquic_varint_skip", picoquic_varint_skip },
+    { "picoquic_create_random_cnx_id_for_cnx", picoquic_create_random_cnx_id_for_cnx },
+    { "picoquic_create_cnxid_reset_secret_for_cnx", picoquic_create_cnxid_reset_secret_for_cnx },
+    { "picoquic_register_cnx_id_for_cnx", picoquic_register_cnx_id_for_cnx },
+    { "picoquic_create_path", picoquic_create_path },
+    { "picoquic_getaddrs", picoquic_getaddrs },
+    { "picoquic_get_local_addresses", picoquic_get_local_addresses },
+    { "picoquic_compare_connection_id", picoquic_compare_connection_id },
+
+    { "picoquic_compare_addr", picoquic_compare_addr },
+    { "picoquic_parse_stream_header", picoquic_parse_stream_header },
+    { "picoquic_find_stream", picoquic_find_stream },
+    { "picoquic_set_cnx_state", picoquic_set_cnx_state },
+    { "picoquic_frames_varint_decode", picoquic_frames_varint_decode },
+    { "picoquic_record_pn_received", picoquic_record_pn_received },
+    { "picoquic_cc_get_sequence_number", picoquic_cc_get_sequence_number },
+    { "picoquic_cc_was_cwin_blocked", picoquic_cc_was_cwin_blocked },
+    { "picoquic_is_sending_authorized_by_pacing", picoquic_is_sending_authorized_by_pacing },
+    { "picoquic_update_pacing_data", picoquic_update_pacing_data },
+
+    { "queue_peek", queue_peek },
     /* FIXME remove this function */
-    ubpf_register(vm, current_idx++, "picoquic_frame_fair_reserve", picoquic_frame_fair_reserve);
-    ubpf_register(vm, current_idx++, "plugin_pluglet_exists", plugin_pluglet_exists);
-
-    ubpf_register(vm, current_idx++, "inet_ntop", inet_ntop);
-    ubpf_register(vm, current_idx++, "strerror", strerror);
-    ubpf_register(vm, current_idx++, "memcmp", memcmp);
-    ubpf_register(vm, current_idx++, "my_malloc_dbg", my_malloc_dbg);
-    ubpf_register(vm, current_idx++, "my_malloc_ex", my_malloc);
-    ubpf_register(vm, current_idx++, "my_free_dbg", my_free_dbg);
-    ubpf_register(vm, current_idx++, "my_memcpy_dbg", my_memcpy_dbg);
-    ubpf_register(vm, current_idx++, "my_memset_dbg", my_memset_dbg);
-
-    ubpf_register(vm, current_idx++, "dprintf", dprintf);
-    ubpf_register(vm, current_idx++, "snprintf", snprintf);
-    ubpf_register(vm, current_idx++, "lseek", lseek);
-    ubpf_register(vm, current_idx++, "ftruncate", ftruncate);
-    ubpf_register(vm, current_idx++, "strlen", strlen);
-    ubpf_register(vm, current_idx++, "snprintf_bytes", snprintf_bytes);
-    ubpf_register(vm, current_idx++, "strncpy", strncpy);
-    ubpf_register(vm, current_idx++, "inet_ntop", inet_ntop);
-    ubpf_register(vm, current_idx++, "get_preq", get_preq);
-    ubpf_register(vm, current_idx++, "set_preq", set_preq);
-
-    ubpf_register(vm, current_idx++, "bind", bind);
-    ubpf_register(vm, current_idx++, "recv", recv);
-
-    ubpf_register(vm, current_idx++, "strcmp", strncmp);
+    { "picoquic_frame_fair_reserve", picoquic_frame_fair_reserve },
+    { "plugin_pluglet_exists", plugin_pluglet_exists },
+
+    { "inet_ntop", inet_ntop },
+    { "strerror", strerror },
+    { "memcmp", memcmp },
+    { "my_malloc_dbg", my_malloc_dbg },
+    { "my_malloc_ex", my_malloc },
+    { "my_free_dbg", my_free_dbg },
+    { "my_memcpy_dbg", my_memcpy_dbg },
+    { "my_memset_dbg", my_memset_dbg },
+
+    { "dprintf", dprintf },
+    { "snprintf", snprintf },
+    { "lseek", lseek },
+    { "ftruncate", ftruncate },
+    { "strlen", strlen },
+    { "snprintf_bytes", snprintf_bytes },
+    { "strncpy", strncpy },
+    { "get_preq", get_preq },
+    { "set_preq", set_preq },
+
+    { "bind", bind },
+    { "recv", recv },
+
+    { "strcmp", strncmp },
 
     /* red black tree */
-    ubpf_register(vm, current_idx++, "rbt_init", rbt_init);
-    ubpf_register(vm, current_idx++, "rbt_is_empty", rbt_is_empty);
-    ubpf_register(vm, current_idx++, "rbt_size", rbt_size);
-    ubpf_register(vm, current_idx++, "rbt_put", rbt_put);
-    ubpf_register(vm, current_idx++, "rbt_get", rbt_get);
-    ubpf_register(vm, current_idx++, "rbt_contains", rbt_contains);
-    ubpf_register(vm, current_idx++, "rbt_min_val", rbt_min_val);
-    ubpf_register(vm, current_idx++, "rbt_min_key", rbt_min_key);
-    ubpf_register(vm, current_idx++, "rbt_min", rbt_min);
-    ubpf_register(vm, current_idx++, "rbt_max_key", rbt_max_key);
-    ubpf_register(vm, current_idx++, "rbt_max_val", rbt_max_val);
-    ubpf_register(vm, current_idx++, "rbt_ceiling_val", rbt_ceiling_val);
-    ubpf_register(vm, current_idx++, "rbt_ceiling_key", rbt_ceiling_key);
-    ubpf_register(vm, current_idx++, "rbt_ceiling", rbt_ceiling);
-    ubpf_register(vm, current_idx++, "rbt_delete", rbt_delete);
-    ubpf_register(vm, current_idx++, "rbt_delete_min", rbt_delete_min);
-    ubpf_register(vm, current_idx++, "rbt_delete_max", rbt_delete_max);
-    ubpf_register(vm, current_idx++, "rbt_delete_and_get_min", rbt_delete_and_get_min);
-    ubpf_register(vm, current_idx++, "rbt_delete_and_get_max", rbt_delete_and_get_max);
+    { "rbt_init", rbt_init },
+    { "rbt_is_empty", rbt_is_empty },
+    { "rbt_size", rbt_size },
+    { "rbt_put", rbt_put },
+    { "rbt_get", rbt_get },
+    { "rbt_contains", rbt_contains },
+    { "rbt_min_val", rbt_min_val },
+    { "rbt_min_key", rbt_min_key },
+    { "rbt_min", rbt_min },
+    { "rbt_max_key", rbt_max_key },
+    { "rbt_max_val", rbt_max_val },
+    { "rbt_ceiling_val", rbt_ceiling_val },
+    { "rbt_ceiling_key", rbt_ceiling_key },
+    { "rbt_ceiling", rbt_ceiling },
+    { "rbt_delete", rbt_delete },
+    { "rbt_delete_min", rbt_delete_min },
+    { "rbt_delete_max", rbt_delete_max },
+    { "rbt_delete_and_get_min", rbt_delete_and_get_min },
+    { "rbt_delete_and_get_max", rbt_delete_and_get_max },
+
+    /* message rings of the plugin */
+    { "plugin_ring_open", plugin_ring_open },
+    { "plugin_ring_close", plugin_ring_close },
+    { "plugin_ring_push", plugin_ring_push },
+    { "plugin_ring_pop", plugin_ring_pop },
+    { "plugin_ring_skip", plugin_ring_skip },
+
+    /* hibernation of the connection */
+    { "plugin_save_hibernation_state", plugin_save_hibernation_state },
+    { "plugin_restore_hibernation_state", plugin_restore_hibernation_state },
+
+    /* metrics export */
+    { "picoquic_export_metrics", picoquic_export_metrics },
+
+    /* FEC source symbols */
+    { "picoquic_source_symbol_gather", picoquic_source_symbol_gather },
+
+    /* getset calls with a constant key, rewritten by load_elf. Last, as only used if the VM has slots for them */
+    { "getset_load_u32", getset_load_u32 },
+    { "getset_load_u64", getset_load_u64 },
+    { "getset_store_u32", getset_store_u32 },
+    { "getset_store_u64", getset_store_u64 },
+    { "getset_get_input", getset_get_input },
+};
+#define NB_PLUGLET_HELPERS (sizeof(pluglet_helpers) / sizeof(pluglet_helpers[0]))
+
+#define MEMORY_BOUND_ERROR_IDX 0x7f
+
+/* Whether the VM has a slot for each helper, the same for all the VMs */
+static bool pluglet_helper_registered[NB_PLUGLET_HELPERS];
+static bool pluglet_helpers_checked = false;
+
+static void
+register_functions(struct ubpf_vm *vm) {
+    for (unsigned int idx = 0; idx < NB_PLUGLET_HELPERS; idx++) {
+        /* The helpers after the reserved value come after it */
+        unsigned int vm_idx = (idx < MEMORY_BOUND_ERROR_IDX) ? idx : idx + 1;
+        pluglet_helper_registered[idx] = ubpf_register(vm, vm_idx, pluglet_helpers[idx].name, pluglet_helpers[idx].fn) >= 0;
+        if (!pluglet_helper_registered[idx] && !pluglet_helpers_checked) {
+            fprintf(stderr, "Failed to register %s, the VM has too few helper slots\n", pluglet_helpers[idx].name);
+        }
+    }
+    pluglet_helpers_checked = true;
 
     /* This value is reserved. DO NOT OVERRIDE IT! */
-    ubpf_register(vm, 0x7f, "picoquic_memory_bound_error", picoquic_memory_bound_error);
+    ubpf_register(vm, MEMORY_BOUND_ERROR_IDX, "picoquic_memory_bound_error", picoquic_memory_bound_error);
+}
+
+/* Resolves the calls of the pluglets run natively, as the VM does */
+static void *
+lookup_function(const char *name) {
+    for (unsigned int idx = 0; idx < NB_PLUGLET_HELPERS; idx++) {
+        if (strcmp(pluglet_helpers[idx].name, name) == 0) {
+            return pluglet_helpers[idx].fn;
+        }
+    }
+    return NULL;
+}
+
+/* Resolves the calls of the pluglets rewritten before the VM loads them, to the helpers it registered */
+static void *
+lookup_registered_function(const char *name) {
+    for (unsigned int idx = 0; idx < NB_PLUGLET_HELPERS; idx++) {
+        if (strcmp(pluglet_helpers[idx].name, name) == 0) {
+            return pluglet_helper_registered[idx] ? pluglet_helpers[idx].fn : NULL;
+        }
+    }
+    return NULL;
 }
 
 static void *readfile(const char *path, size_t maxlen, size_t *len)
@@ -243,7 +318,13 @@ pluglet_t *load_elf(void *code, size_t code_len, uint64_t memory_ptr, uint32_t m
 
     char *errmsg;
     int rv;
-    if (elf) {
+    /* The getset calls with a constant key access their field directly */
+    size_t resolved_len = 0;
+    void *resolved = elf ? native_pluglet_resolve_fields(code, code_len, lookup_registered_function, &resolved_len) : NULL;
+    if (resolved) {
+        rv = ubpf_load_elf(pluglet->vm, resolved, resolved_len, &errmsg, memory_ptr, memory_size);
+        free(resolved);
+    } else if (elf) {
         rv = ubpf_load_elf(pluglet->vm, code, code_len, &errmsg, memory_ptr, memory_size);
     } else {
         rv = ubpf_load(pluglet->vm, code, code_len, &errmsg, memory_ptr, memory_size);
@@ -272,6 +353,10 @@ pluglet_t *load_elf(void *code, size_t code_len, uint64_t memory_ptr, uint32_t m
 
     free(errmsg);
 
+    if (elf) {
+        pluglet->native = native_pluglet_lower(code, code_len, lookup_function);
+    }
+
     return pluglet;
 }
 
@@ -292,11 +377,19 @@ int release_elf(pluglet_t *pluglet) {
         ubpf_destroy(pluglet->vm);
         pluglet->vm = NULL;
         pluglet->fn = 0;
+        free(pluglet->native);
         free(pluglet);
     }
     return 0;
 }
 
+static inline uint64_t run_pluglet(pluglet_t *pluglet, void *arg, void *mem, size_t mem_len, char **error_msg) {
+    if (pluglet->native != NULL) {
+        return native_pluglet_run(pluglet->native, arg);
+    }
+    return _exec_loaded_code(pluglet, arg, mem, mem_len, error_msg, JIT);
+}
+
 uint64_t exec_loaded_code(pluglet_t *pluglet, void *arg, void *mem, size_t mem_len, char **error_msg) {
     if (pluglet->vm == NULL) {
         return -1;
@@ -307,12 +400,17 @@ uint64_t exec_loaded_code(pluglet_t *pluglet, void *arg, void *mem, size_t mem_l
 
     /* printf("0x%"PRIx64"\n", ret); */
     pluglet->count++;
+    /* The pluglets run on the connection, which holds the operation and the anchor */
+    PICOQUIC_PROBE4(pluglet_entry, arg, pluglet->p->name, ((picoquic_cnx_t *) arg)->current_protoop->name,
+        ((picoquic_cnx_t *) arg)->current_anchor);
 #ifndef DEBUG_PLUGIN_EXECUTION_TIME
-    return _exec_loaded_code(pluglet, arg, mem, mem_len, error_msg, JIT);
+    uint64_t err = run_pluglet(pluglet, arg, mem, mem_len, error_msg);
 #else
     uint64_t before = picoquic_current_time();
-    uint64_t err = _exec_loaded_code(pluglet, arg, mem, mem_len, error_msg, JIT);
+    uint64_t err = run_pluglet(pluglet, arg, mem, mem_len, error_msg);
     pluglet->total_execution_time += picoquic_current_time() - before;
-    return err;
 #endif
+    PICOQUIC_PROBE5(pluglet_exit, arg, pluglet->p->name, ((picoquic_cnx_t *) arg)->current_protoop->name,
+        ((picoquic_cnx_t *) arg)->current_anchor, err);
+    return err;
 }
@@ -98,6 +98,7 @@ typedef struct pluglet {
 	protoop_plugin_t *p;
 	uint64_t count;
 	uint64_t total_execution_time;
+	struct st_native_pluglet_t *native; /* Set when the pluglet runs without the VM */
 } pluglet_t;
 
 pluglet_t *load_elf(void *code, size_t code_len, uint64_t memory_ptr, uint32_t memory_size);
@@ -42,8 +42,15 @@ typedef enum {
 
 static const picoquic_test_def_t test_table[] = {
     { "picohash", picohash_test },
+    { "cid_table", cid_table_test },
+    { "metrics_exporter", metrics_exporter_test },
+    { "getset_fields", getset_fields_test },
+    { "getset_metadata", getset_metadata_test },
+    { "slab_memory", slab_memory_test },
+    { "huge_memory", huge_memory_test },
     { "splay", splay_test },
     { "cnxcreation", cnxcreation_test },
+    { "stateless_pool", stateless_pool_test },
     { "parseheader", parseheadertest },
     { "pn2pn64", pn2pn64test },
     { "intformat", intformattest },
@@ -52,14 +59,22 @@ static const picoquic_test_def_t test_table[] = {
     { "varint", varint_test },
     { "sack", sacktest },
     { "skip_frames", skip_frame_test },
+    { "source_symbol", source_symbol_test },
     { "parse_frames", parse_frame_test },
     { "logger", logger_test },
+    { "binlog", binlog_test },
+    { "log_writer", log_writer_test },
     { "TlsStreamFrame", TlsStreamFrameTest },
     { "StreamZeroFrame", StreamZeroFrameTest },
     { "sendack", sendacktest },
     { "ackrange", ackrange_test },
     { "ack_of_ack", ack_of_ack_test },
+    { "ack_range_index", ack_range_index_test },
     { "sim_link", sim_link_test },
+    { "sim_benchmark", sim_benchmark_test },
+    { "sim_benchmark_multipath", sim_benchmark_multipath_test },
+    { "sim_benchmark_fec", sim_benchmark_fec_test },
+    { "sim_loss_timer", sim_loss_timer_test },
     { "clear_text_aead", cleartext_aead_test },
     { "pn_ctr", pn_ctr_test },
     { "cleartext_hp_enc", cleartext_hp_enc_test },
@@ -87,6 +102,11 @@ static const picoquic_test_def_t test_table[] = {
     { "tls_api_very_long_max", tls_api_very_long_max_test },
     { "tls_api_very_long_with_err", tls_api_very_long_with_err_test },
     { "tls_api_very_long_congestion", tls_api_very_long_congestion_test },
+    { "tls_pool", tls_pool_test },
+    { "hibernation", hibernation_test },
+    { "native_pluglet", native_pluglet_test },
+    { "native_pluglet_resolve", native_pluglet_resolve_test },
+    { "short_header", short_header_test },
     { "http0dot9", http0dot9_test },
     { "retry", tls_api_retry_test },
     { "two_connections", tls_api_two_connections_test },
@@ -111,6 +131,7 @@ static const picoquic_test_def_t test_table[] = {
     { "set_verify_certificate_callback_test", set_verify_certificate_callback_test },
     { "virtual_time" , virtual_time_test },
     { "different_params", tls_different_params_test },
+    { "ack_frequency", ack_frequency_test },
 #if 0
     { "wrong_tls_version", wrong_tls_version_test },
 #endif
@@ -131,6 +152,10 @@ static const picoquic_test_def_t test_table[] = {
     { "fuzz", fuzz_test },
     { "datagram_test", datagram_test },
     { "microbench_plugin_run_test", microbench_plugin_run_test },
+    { "cid_table_bench", cid_table_bench },
+    { "slab_memory_bench", slab_memory_bench },
+    { "hibernation_bench", hibernation_bench },
+    { "short_header_bench", short_header_bench },
     { "split_stream_frame_test", split_stream_frame_test}
 };
 
@@ -0,0 +1,56 @@
+/*
+* Renders a binary trace written with picoquic_set_binlog as the text log.
+*
+* Usage: picoquic_tracedump trace.bin [log.txt]
+*/
+
+#include <stdio.h>
+#include "picoquic_internal.h"
+#include "binlog.h"
+
+static FILE* tracedump_open(const char* name, const char* mode)
+{
+    FILE* F = NULL;
+
+#ifdef _WINDOWS
+    if (fopen_s(&F, name, mode) != 0) {
+        F = NULL;
+    }
+#else
+    F = fopen(name, mode);
+#endif
+
+    return F;
+}
+
+int main(int argc, char** argv)
+{
+    int ret = 0;
+    FILE* F_bin = NULL;
+    FILE* F_txt = stdout;
+
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "Usage: %s trace.bin [log.txt]\n", argv[0]);
+        return 1;
+    }
+
+    if ((F_bin = tracedump_open(argv[1], "rb")) == NULL) {
+        fprintf(stderr, "Cannot open %s\n", argv[1]);
+        ret = 1;
+    } else if (argc == 3 && (F_txt = tracedump_open(argv[2], "w")) == NULL) {
+        fprintf(stderr, "Cannot open %s\n", argv[2]);
+        ret = 1;
+    } else if (picoquic_binlog_dump(F_bin, F_txt) != 0) {
+        fprintf(stderr, "Malformed trace %s\n", argv[1]);
+        ret = 1;
+    }
+
+    if (F_bin != NULL) {
+        fclose(F_bin);
+    }
+    if (F_txt != NULL && F_txt != stdout) {
+        fclose(F_txt);
+    }
+
+    return ret;
+}
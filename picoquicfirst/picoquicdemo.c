@@ -112,6 +112,7 @@ static const char* bad_request_message = "<html><head><title>Bad Request</title>
 #include "../picoquic/picosocks.h"
 #include "../picoquic/util.h"
 #include "../picoquic/plugin.h"
+#include "../picoquic/binlog.h"
 
 static const char* response_buffer = NULL;
 static size_t response_length = 0;
@@ -249,7 +250,7 @@ static void write_stats(picoquic_cnx_t *cnx, char *filename) {
                 snprintf(buf, size-1, "%s (param 0x%hx)", str, stats[i].param);
                 strncpy(str, buf, size-1);
             }
-            snprintf(buf, size-1, "%s (%s)", str, stats[i].pluglet_name);
+            snprintf(buf, size-1, "%s (%s%s)", str, stats[i].pluglet_name, stats[i].lowered ? ", native" : "");
             strncpy(str, buf, size-1);
             snprintf(buf, size-1, "%s: %" PRIu64 " calls", str, stats[i].count);
             strncpy(str, buf, size-1);
@@ -462,7 +463,7 @@ int quic_server(const char* server_name, int server_port,
     int just_once, int do_hrr, cnx_id_cb_fn cnx_id_callback,
     void* cnx_id_callback_ctx, uint8_t reset_seed[PICOQUIC_RESET_SECRET_SIZE],
     int mtu_max, const char** local_plugin_fnames, int local_plugins,
-    const char** both_plugin_fnames, int both_plugins, FILE *F_log, FILE *F_tls_secrets, char *qlog_filename, char *stats_filename, bool preload_plugins)
+    const char** both_plugin_fnames, int both_plugins, FILE *F_log, FILE *F_tls_secrets, FILE* F_binlog, char *qlog_filename, char *stats_filename, bool preload_plugins)
 {
     /* Start: start the QUIC process with cert and key files */
     int ret = 0;
@@ -480,7 +481,8 @@ int quic_server(const char* server_name, int server_port,
     uint8_t buffer[1536];
     uint8_t send_buffer[1536];
     size_t send_length = 0;
-    picoquic_stateless_packet_t* sp;
+    picoquic_stateless_packet_t* sp[64];
+    size_t nb_sp;
     int64_t delay_max = 10000000;
     int new_context_created = 0;
     int qlog_fd = -1;
@@ -515,6 +517,9 @@ int quic_server(const char* server_name, int server_port,
             /* TODO: add log level, to reduce size in "normal" cases */
             PICOQUIC_SET_LOG(qserver, F_log);
             PICOQUIC_SET_TLS_SECRETS_LOG(qserver, F_tls_secrets);
+            if (F_binlog != NULL && picoquic_set_binlog(qserver, F_binlog) != 0) {
+                fprintf(stderr, "Could not start the binary trace\n");
+            }
 
             /* As we currently do not modify plugins to inject yet, we can store it in the quic structure */
             if (ret == 0 && (ret = picoquic_set_plugins_to_inject(qserver, both_plugin_fnames, both_plugins)) != 0) {
@@ -556,6 +561,9 @@ int quic_server(const char* server_name, int server_port,
 
         if (just_once != 0 && delta_t > 10000 && cnx_server != NULL) {
             picoquic_log_congestion_state(F_log, cnx_server, picoquic_current_time());
+            if (qserver->binlog != NULL) {
+                picoquic_binlog_congestion_state(qserver->binlog, cnx_server, picoquic_current_time());
+            }
         }
 
         bytes_recv = picoquic_select(server_sockets.s_socket, PICOQUIC_NB_SERVER_SOCKETS,
@@ -613,25 +621,24 @@ int quic_server(const char* server_name, int server_port,
                     print_address((struct sockaddr*)&client_from, "Client address:",
                         picoquic_get_logging_cnxid(cnx_server));
                     picoquic_log_transport_extension(stdout, cnx_server, 1);
+                    if (qserver->binlog != NULL) {
+                        picoquic_binlog_transport_extension(qserver->binlog, cnx_server, 1);
+                    }
                 }
             }
             if (ret == 0) {
                 uint64_t loop_time = picoquic_current_time();
 
-                while ((sp = picoquic_dequeue_stateless_packet(qserver)) != NULL) {
-                    (void) picoquic_send_through_server_sockets(&server_sockets,
-                        (struct sockaddr*)&sp->addr_to,
-                        (sp->addr_to.ss_family == AF_INET) ? sizeof(struct sockaddr_in) : sizeof(struct sockaddr_in6),
-                        (struct sockaddr*)&sp->addr_local,
-                        (sp->addr_local.ss_family == AF_INET) ? sizeof(struct sockaddr_in) : sizeof(struct sockaddr_in6),
-                        sp->if_index_local,
-                        (const char*)sp->bytes, (int)sp->length);
+                while ((nb_sp = picoquic_dequeue_stateless_packets(qserver, sp, sizeof(sp) / sizeof(sp[0]))) > 0) {
+                    (void) picoquic_send_stateless_through_server_sockets(&server_sockets, sp, (int)nb_sp);
 
                     /* TODO: log stateless packet */
 
                     fflush(stdout);
 
-                    picoquic_delete_stateless_packet(sp);
+                    for (size_t i = 0; i < nb_sp; i++) {
+                        picoquic_delete_stateless_packet(sp[i]);
+                    }
                 }
 
                 while (ret == 0 && (cnx_next = picoquic_get_earliest_cnx_to_wake(qserver, loop_time)) != NULL) {
@@ -957,7 +964,7 @@ static void first_client_callback(picoquic_cnx_t* cnx,
 
 int quic_client(const char* ip_address_text, int server_port, const char * sni, 
     const char * root_crt,
-    uint32_t proposed_version, int force_zero_share, int mtu_max, FILE* F_log, FILE* F_tls_secrets,
+    uint32_t proposed_version, int force_zero_share, int mtu_max, FILE* F_log, FILE* F_tls_secrets, FILE* F_binlog,
     const char** local_plugin_fnames, int local_plugins,
     int get_size, int only_stream_4, char *qlog_filename, char *plugin_store_path, char *stats_filename)
 {
@@ -1054,6 +1061,9 @@ int quic_client(const char* ip_address_text, int server_port, const char * sni,
 
             PICOQUIC_SET_LOG(qclient, F_log);
             PICOQUIC_SET_TLS_SECRETS_LOG(qclient, F_tls_secrets);
+            if (F_binlog != NULL && picoquic_set_binlog(qclient, F_binlog) != 0) {
+                fprintf(stderr, "Could not start the binary trace\n");
+            }
 
             if (sni == NULL) {
                 /* Standard verifier would crash */
@@ -1238,6 +1248,9 @@ int quic_client(const char* ip_address_text, int server_port, const char * sni,
                 if (ret == 0 && picoquic_get_cnx_state(cnx_client) == picoquic_state_client_ready) {
                     if (established == 0) {
                         picoquic_log_transport_extension(F_log, cnx_client, 0);
+                        if (qclient->binlog != NULL) {
+                            picoquic_binlog_transport_extension(qclient->binlog, cnx_client, 0);
+                        }
                         printf("Connection established. Version = %x, I-CID: %" PRIx64 "\n",
                             picoquic_supported_versions[cnx_client->version_index].version,
                             picoquic_val64_connection_id(picoquic_get_logging_cnxid(cnx_client)));
@@ -1445,6 +1458,7 @@ void usage()
     fprintf(stderr, "  -v version            Version proposed by client, e.g. -v ff00000a\n");
     fprintf(stderr, "  -z                    Set TLS zero share behavior on client, to force HRR.\n");
     fprintf(stderr, "  -l file               Log file\n");
+    fprintf(stderr, "  -b file               Binary trace file, rendered as the log by picoquic_tracedump\n");
     fprintf(stderr, "  -m mtu_max            Largest mtu value that can be tried for discovery\n");
     fprintf(stderr, "  -q output.qlog        qlog output file\n");
     fprintf(stderr, "  -S filename           if set, write plugin statistics in the specified file (- for stdout)\n");
@@ -1485,6 +1499,7 @@ int main(int argc, char** argv)
     const char* server_key_file = default_server_key_file;
     const char* log_file = NULL;
     const char* tls_secrets_file = NULL;
+    const char* binlog_file = NULL;
     const char * sni = NULL;
     const char * local_plugin_fnames[PICOQUIC_DEMO_MAX_PLUGIN_FILES];
     const char * both_plugin_fnames[PICOQUIC_DEMO_MAX_PLUGIN_FILES];
@@ -1523,7 +1538,7 @@ int main(int argc, char** argv)
 
     /* Get the parameters */
     int opt;
-    while ((opt = getopt(argc, argv, "c:k:P:C:Q:G:p:v:L14rhzRX:S:i:s:l:m:n:t:q:")) != -1) {
+    while ((opt = getopt(argc, argv, "c:k:P:C:Q:G:p:v:L14rhzRX:S:i:s:l:b:m:n:t:q:")) != -1) {
         switch (opt) {
         case 'c':
             server_cert_file = optarg;
@@ -1600,6 +1615,9 @@ int main(int argc, char** argv)
         case 'l':
             log_file = optarg;
             break;
+        case 'b':
+            binlog_file = optarg;
+            break;
         case 'X':
             tls_secrets_file = optarg;
             break;
@@ -1689,6 +1707,22 @@ int main(int argc, char** argv)
     }
 
 
+    FILE* F_binlog = NULL;
+
+    if (binlog_file != NULL) {
+#ifdef _WINDOWS
+        if (fopen_s(&F_binlog, binlog_file, "wb") != 0) {
+                F_binlog = NULL;
+            }
+#else
+        F_binlog = fopen(binlog_file, "wb");
+#endif
+        if (F_binlog == NULL) {
+            fprintf(stderr, "Could not open the binary trace file <%s>\n", binlog_file);
+        }
+    }
+
+
     if (!F_log && (!log_file || strcmp(log_file, "/dev/null") != 0)) {
         F_log = stdout;
     }
@@ -1712,11 +1746,14 @@ int main(int argc, char** argv)
             (cnx_id_mask_is_set == 0) ? NULL : cnx_id_callback,
             (cnx_id_mask_is_set == 0) ? NULL : (void*)&cnx_id_cbdata,
             (uint8_t*)reset_seed, mtu_max, local_plugin_fnames, local_plugins,
-            both_plugin_fnames, both_plugins, F_log, F_tls_secrets, qlog_filename, stats_filename, preload_plugins);
+            both_plugin_fnames, both_plugins, F_log, F_tls_secrets, F_binlog, qlog_filename, stats_filename, preload_plugins);
         printf("Server exit with code = %d\n", ret);
         if (F_tls_secrets != NULL && F_tls_secrets != stdout) {
             fclose(F_tls_secrets);
         }
+        if (F_binlog != NULL) {
+            fclose(F_binlog);
+        }
     } else {
         if (F_log != NULL) {
             debug_printf_push_stream(F_log);
@@ -1730,7 +1767,7 @@ int main(int argc, char** argv)
         if (local_plugins > 0) {
             fprintf(stderr, "WARNING: direct plugin insertion at client might interfere with remote plugin injection...\n");
         }
-        ret = quic_client(server_name, server_port, sni, root_trust_file, proposed_version, force_zero_share, mtu_max, F_log, F_tls_secrets, local_plugin_fnames, local_plugins, get_size, only_stream_4, qlog_filename, plugin_store_path, stats_filename);
+        ret = quic_client(server_name, server_port, sni, root_trust_file, proposed_version, force_zero_share, mtu_max, F_log, F_tls_secrets, F_binlog, local_plugin_fnames, local_plugins, get_size, only_stream_4, qlog_filename, plugin_store_path, stats_filename);
 
         printf("Client exit with code = %d\n", ret);
 
@@ -1740,5 +1777,8 @@ int main(int argc, char** argv)
         if (F_tls_secrets != NULL && F_tls_secrets != stdout) {
             fclose(F_tls_secrets);
         }
+        if (F_binlog != NULL) {
+            fclose(F_binlog);
+        }
     }
 }
@@ -0,0 +1,271 @@
+/*
+ * Runs a file transfer over the simulated topology of the test harness, with
+ * a given set of plugins, and prints the completion time as a JSON object.
+ * As the network is simulated in virtual time, the results only depend on
+ * the parameters and on the random seed, which makes this driver suitable for
+ * the experimental designs of the benchmarks directory without Mininet.
+ *
+ * The test certificates are found relative to the current directory, the
+ * driver must be started from the root of the repository.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WINDOWS
+#include "getopt.h"
+#endif
+#include "picoquic_internal.h"
+#include "picoquictest_internal.h"
+
+#define PICOQUICSIM_MAX_PLUGIN_FILES 64
+#define PICOQUICSIM_MAX_SCHEDULE 64
+#define PICOQUICSIM_MAX_REPETITIONS 1024
+
+void usage()
+{
+    fprintf(stderr, "PicoQUIC simulated network benchmark\n");
+    fprintf(stderr, "Usage: picoquicsim <options>\n");
+    fprintf(stderr, "  Lists are comma separated and give one value per interface.\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -P file               plugin file, loaded by both peers. Can be used several times.\n");
+    fprintf(stderr, "  -n nb                 number of interfaces of the client (default: 1, max: %d)\n", PICOQUICTEST_SIM_MAX_INTERFACES);
+    fprintf(stderr, "  -b mbps,...           bandwidth of each interface in Mbps (default: 10)\n");
+    fprintf(stderr, "  -d ms,...             one-way delay of each interface in ms (default: 10)\n");
+    fprintf(stderr, "  -q ms,...             max queuing delay of each interface in ms (default: none)\n");
+    fprintf(stderr, "  -l pct,...            random loss of each interface in %%\n");
+    fprintf(stderr, "  -G i:pgb:pbg:lg:lb    Gilbert-Elliott loss on interface i: transition probabilities\n");
+    fprintf(stderr, "                        good to bad and bad to good, loss probabilities in each state\n");
+    fprintf(stderr, "  -r i:prob:ms          reorder packets of interface i with the probability prob,\n");
+    fprintf(stderr, "                        by delaying them of ms\n");
+    fprintf(stderr, "  -C i:t:mbps:ms        from t ms, interface i has the given bandwidth and delay.\n");
+    fprintf(stderr, "                        Can be used several times.\n");
+    fprintf(stderr, "  -A i:t                at t ms, the NAT of interface i changes the client port.\n");
+    fprintf(stderr, "                        Can be used several times.\n");
+    fprintf(stderr, "  -s bytes              size of the transferred file (default: 1000000)\n");
+    fprintf(stderr, "  -R nb                 number of repetitions, each with a different seed (default: 1)\n");
+    fprintf(stderr, "  -x seed               random seed of the first repetition (default: 1)\n");
+    fprintf(stderr, "  -T s                  max simulated time of a transfer in seconds (default: 300)\n");
+    fprintf(stderr, "  -h                    This help message\n");
+    exit(1);
+}
+
+static int parse_list(const char* arg, double* values, int max_values)
+{
+    int nb = 0;
+    char* end = NULL;
+
+    while (nb < max_values) {
+        values[nb++] = strtod(arg, &end);
+        if (end == arg || (*end != ',' && *end != 0)) {
+            return -1;
+        }
+        if (*end == 0) {
+            break;
+        }
+        arg = end + 1;
+    }
+
+    return (*end == 0) ? nb : -1;
+}
+
+/* Parses "i:v1:v2:..." into the interface index and nb_values values */
+static int parse_interface_values(const char* arg, double* values, int nb_values)
+{
+    char* end = NULL;
+    long interface_index = strtol(arg, &end, 10);
+
+    for (int i = 0; i < nb_values; i++) {
+        if (*end != ':') {
+            return -1;
+        }
+        arg = end + 1;
+        values[i] = strtod(arg, &end);
+        if (end == arg) {
+            return -1;
+        }
+    }
+
+    return (*end == 0 && interface_index >= 0 && interface_index < PICOQUICTEST_SIM_MAX_INTERFACES) ? (int)interface_index : -1;
+}
+
+static int compare_times(const void* a, const void* b)
+{
+    uint64_t ta = *(const uint64_t*)a;
+    uint64_t tb = *(const uint64_t*)b;
+
+    return (ta < tb) ? -1 : ((ta > tb) ? 1 : 0);
+}
+
+int main(int argc, char** argv)
+{
+    picoquictest_sim_benchmark_config_t config;
+    const char* plugin_fnames[PICOQUICSIM_MAX_PLUGIN_FILES];
+    picoquictest_sim_link_schedule_t schedule[PICOQUICTEST_SIM_MAX_INTERFACES][PICOQUICSIM_MAX_SCHEDULE];
+    double values[PICOQUICTEST_SIM_MAX_INTERFACES];
+    uint64_t times[PICOQUICSIM_MAX_REPETITIONS];
+    int nb_values;
+    int interface_index;
+    int repetitions = 1;
+    int nb_success = 0;
+    uint64_t first_seed = 1;
+    int opt;
+
+    memset(&config, 0, sizeof(config));
+    config.nb_interfaces = 1;
+    config.plugin_fnames = plugin_fnames;
+    config.file_size = 1000000;
+    for (int i = 0; i < PICOQUICTEST_SIM_MAX_INTERFACES; i++) {
+        config.links[i].data_rate_in_gps = 0.01;
+        config.links[i].microsec_latency = 10000;
+        config.links[i].schedule = schedule[i];
+    }
+
+    while ((opt = getopt(argc, argv, "P:n:b:d:q:l:G:r:C:A:s:R:x:T:h")) != -1) {
+        switch (opt) {
+        case 'P':
+            if (config.nb_plugins >= PICOQUICSIM_MAX_PLUGIN_FILES) {
+                fprintf(stderr, "Too many plugins\n");
+                usage();
+            }
+            plugin_fnames[config.nb_plugins++] = optarg;
+            break;
+        case 'n':
+            config.nb_interfaces = atoi(optarg);
+            if (config.nb_interfaces <= 0 || config.nb_interfaces > PICOQUICTEST_SIM_MAX_INTERFACES) {
+                fprintf(stderr, "Invalid number of interfaces: %s\n", optarg);
+                usage();
+            }
+            break;
+        case 'b':
+        case 'd':
+        case 'q':
+        case 'l':
+            if ((nb_values = parse_list(optarg, values, PICOQUICTEST_SIM_MAX_INTERFACES)) <= 0) {
+                fprintf(stderr, "Invalid list: %s\n", optarg);
+                usage();
+            }
+            for (int i = 0; i < nb_values; i++) {
+                if (opt == 'b') {
+                    config.links[i].data_rate_in_gps = values[i] / 1000.0;
+                } else if (opt == 'd') {
+                    config.links[i].microsec_latency = (uint64_t)(values[i] * 1000.0);
+                } else if (opt == 'q') {
+                    config.links[i].queue_delay_max = (uint64_t)(values[i] * 1000.0);
+                } else {
+                    config.links[i].ge_loss_good = values[i] / 100.0;
+                }
+            }
+            break;
+        case 'G':
+            if ((interface_index = parse_interface_values(optarg, values, 4)) < 0) {
+                fprintf(stderr, "Invalid Gilbert-Elliott parameters: %s\n", optarg);
+                usage();
+            }
+            config.links[interface_index].ge_p_good_to_bad = values[0];
+            config.links[interface_index].ge_p_bad_to_good = values[1];
+            config.links[interface_index].ge_loss_good = values[2];
+            config.links[interface_index].ge_loss_bad = values[3];
+            break;
+        case 'r':
+            if ((interface_index = parse_interface_values(optarg, values, 2)) < 0) {
+                fprintf(stderr, "Invalid reordering parameters: %s\n", optarg);
+                usage();
+            }
+            config.links[interface_index].reorder_probability = values[0];
+            config.links[interface_index].reorder_delay = (uint64_t)(values[1] * 1000.0);
+            break;
+        case 'C':
+            if ((interface_index = parse_interface_values(optarg, values, 3)) < 0 ||
+                config.links[interface_index].nb_schedule >= PICOQUICSIM_MAX_SCHEDULE) {
+                fprintf(stderr, "Invalid schedule entry: %s\n", optarg);
+                usage();
+            } else {
+                picoquictest_sim_link_schedule_t* entry = &schedule[interface_index][config.links[interface_index].nb_schedule];
+                entry->start_time = (uint64_t)(values[0] * 1000.0);
+                entry->data_rate_in_gps = values[1] / 1000.0;
+                entry->microsec_latency = (uint64_t)(values[2] * 1000.0);
+                if (config.links[interface_index].nb_schedule > 0 && entry->start_time < entry[-1].start_time) {
+                    fprintf(stderr, "Schedule entries must be given in time order: %s\n", optarg);
+                    usage();
+                }
+                config.links[interface_index].nb_schedule++;
+            }
+            break;
+        case 'A':
+            if ((interface_index = parse_interface_values(optarg, values, 1)) < 0 ||
+                config.nb_address_changes >= PICOQUICTEST_SIM_MAX_ADDRESS_CHANGES) {
+                fprintf(stderr, "Invalid address change: %s\n", optarg);
+                usage();
+            }
+            config.address_changes[config.nb_address_changes].interface_index = interface_index;
+            config.address_changes[config.nb_address_changes].change_time = (uint64_t)(values[0] * 1000.0);
+            config.nb_address_changes++;
+            break;
+        case 's':
+            config.file_size = (size_t)strtoull(optarg, NULL, 10);
+            break;
+        case 'R':
+            repetitions = atoi(optarg);
+            if (repetitions <= 0 || repetitions > PICOQUICSIM_MAX_REPETITIONS) {
+                fprintf(stderr, "Invalid number of repetitions: %s\n", optarg);
+                usage();
+            }
+            break;
+        case 'x':
+            first_seed = strtoull(optarg, NULL, 0);
+            break;
+        case 'T':
+            config.max_time = strtoull(optarg, NULL, 10) * 1000000ull;
+            break;
+        case 'h':
+        default:
+            usage();
+            break;
+        }
+    }
+
+    for (size_t i = 0; i < config.nb_address_changes; i++) {
+        if (config.address_changes[i].interface_index >= config.nb_interfaces) {
+            fprintf(stderr, "Address change on unknown interface %d\n", config.address_changes[i].interface_index);
+            usage();
+        }
+    }
+
+    for (int r = 0; r < repetitions; r++) {
+        uint64_t completion_time = 0;
+
+        config.random_seed = first_seed + r;
+        if (picoquictest_sim_benchmark_run(&config, &completion_time) == 0) {
+            times[nb_success++] = completion_time;
+        }
+    }
+
+    if (nb_success > 0) {
+        double median;
+        double mean = 0;
+        double deviation = 0;
+
+        qsort(times, nb_success, sizeof(uint64_t), compare_times);
+        median = times[nb_success / 2] / 1000.0;
+        for (int i = 0; i < nb_success; i++) {
+            mean += times[i] / 1000.0;
+        }
+        mean /= nb_success;
+        for (int i = 0; i < nb_success; i++) {
+            double d = times[i] / 1000.0 - mean;
+            deviation += (d < 0) ? -d : d;
+        }
+        deviation /= nb_success;
+
+        printf("{\"elapsed_time\": %.3f, \"var_elapsed_time\": %.3f, \"file_size\": %zu, \"runs\": %d, \"failed\": %d}\n",
+            median, deviation, config.file_size, repetitions, repetitions - nb_success);
+    } else {
+        printf("{\"elapsed_time\": 0, \"var_elapsed_time\": 0, \"file_size\": %zu, \"runs\": %d, \"failed\": %d}\n",
+            config.file_size, repetitions, repetitions);
+    }
+
+    return (nb_success > 0) ? 0 : 1;
+}
@@ -82,8 +82,10 @@ static const char* default_server_key_file = "..\\certs\\key.pem";
 #include <memory.h>
 #include <fcntl.h>
 #include <linux/if_tun.h>
+#include <linux/virtio_net.h>
 #include <net/if.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
 
 #ifndef SOCKET_TYPE
 #define SOCKET_TYPE int
@@ -117,10 +119,15 @@ static const char* ticket_store_filename = "demo_ticket_store.bin";
 #include "../picoquic/picosocks.h"
 #include "../picoquic/util.h"
 #include "../picoquic/plugin.h"
+#include "../picoquic/spsc_ring.h"
 
 static protoop_id_t get_max_message_size = { .id = "get_max_message_size" };
 static protoop_id_t send_message = { .id = "send_message" };
 static protoop_id_t get_message_socket = { .id = "get_message_socket" };
+static protoop_id_t get_message_rings = { .id = "get_message_rings" };
+static protoop_id_t send_messages = { .id = "send_messages" };
+
+#define DATAGRAM_PLUGIN_NAME "be.mpiraux.datagram"
 
 #define SEC_TO_MILLIS (1000000)
 
@@ -159,36 +166,168 @@ static char* strip_endofline(char* buf, size_t bufmax, char const* line)
     return buf;
 }
 
-int tun_open(char *devname) {
+#define TUN_MAX_QUEUES 8
+#define TUN_BATCH_SIZE 64
+#define TUN_MAX_PACKET 65535
+
+typedef struct st_tun_device_t {
+    int fds[TUN_MAX_QUEUES];
+    int nb_queues;
+    int vnet_hdr; /* Each packet is preceded by a struct virtio_net_hdr */
+} tun_device_t;
+
+static int tun_nb_queues = 1;
+static int tun_vnet_hdr = 0;
+
+int tun_open(tun_device_t *tun, char *devname) {
     struct ifreq ifr;
-    int fd;
 
-    if ((fd = open("/dev/net/tun", O_RDWR)) == -1) {
-        perror("open /dev/net/tun");
-        exit(1);
+    tun->nb_queues = 0;
+    tun->vnet_hdr = tun_vnet_hdr;
+    for (int i = 0; i < tun_nb_queues && i < TUN_MAX_QUEUES; i++) {
+        int fd;
+        if ((fd = open("/dev/net/tun", O_RDWR | O_NONBLOCK)) == -1) {
+            perror("open /dev/net/tun");
+            exit(1);
+        }
+        memset(&ifr, 0, sizeof(ifr));
+        ifr.ifr_flags = IFF_TUN | IFF_NO_PI;
+        if (tun_nb_queues > 1) {
+            ifr.ifr_flags |= IFF_MULTI_QUEUE;
+        }
+        if (tun->vnet_hdr) {
+            ifr.ifr_flags |= IFF_VNET_HDR;
+        }
+        strncpy(ifr.ifr_name, devname, IFNAMSIZ);
+
+        if (ioctl(fd, TUNSETIFF, (void *) &ifr) == -1) {
+            perror("ioctl TUNSETIFF");
+            close(fd);
+            break;
+        }
+        tun->fds[tun->nb_queues++] = fd;
+    }
+    return tun->nb_queues > 0 ? 0 : -1;
+}
+
+int tun_is_queue(tun_device_t *tun, int fd) {
+    for (int i = 0; i < tun->nb_queues; i++) {
+        if (tun->fds[i] == fd) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Reads the next packet available on any queue of the tun device, without blocking */
+static int tun_read_next(tun_device_t *tun, int *queue, uint8_t *buffer, size_t buffer_max) {
+    for (int i = 0; i < tun->nb_queues; i++) {
+        int bytes_recv = (int) read(tun->fds[*queue], buffer, buffer_max);
+        if (bytes_recv > 0) {
+            return bytes_recv;
+        }
+        *queue = (*queue + 1) % tun->nb_queues;
     }
-    memset(&ifr, 0, sizeof(ifr));
-    ifr.ifr_flags = IFF_TUN | IFF_NO_PI;
-    strncpy(ifr.ifr_name, devname, IFNAMSIZ);
-
-    if (ioctl(fd, TUNSETIFF, (void *) &ifr) == -1) {
-        perror("ioctl TUNSETIFF");
-        close(fd);
-        return -1;
+    return 0;
+}
+
+static int tun_write(tun_device_t *tun, const uint8_t *buffer, size_t length) {
+    if (tun->vnet_hdr) {
+        /* The payload was authenticated by QUIC, let the kernel skip the checksum verification */
+        struct virtio_net_hdr hdr;
+        struct iovec iov[2];
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.flags = VIRTIO_NET_HDR_F_DATA_VALID;
+        hdr.gso_type = VIRTIO_NET_HDR_GSO_NONE;
+        iov[0].iov_base = &hdr;
+        iov[0].iov_len = sizeof(hdr);
+        iov[1].iov_base = (void *) buffer;
+        iov[1].iov_len = length;
+        return (int) writev(tun->fds[0], iov, 2) - (int) sizeof(hdr);
     }
-    return fd;
+    return (int) write(tun->fds[0], buffer, length);
+}
+
+/* Returns the ring on which the datagram plugin pushes the received messages, or NULL if it uses the message socket */
+static spsc_ring_t *get_to_app_ring(picoquic_cnx_t *cnx) {
+    (void) protoop_prepare_and_run_extern_noparam(cnx, &get_message_rings, NULL, NULL);
+    return plugin_get_ring(cnx, DATAGRAM_PLUGIN_NAME, PLUGIN_RING_TO_APP);
 }
 
-void handle_tun_read(picoquic_cnx_t *cnx, int tun, const uint8_t *buffer, int bytes_recv) {
-    printf("Received %d bytes on the tun interface\n", bytes_recv);
+/* Adds the eventfd of the ring of received messages to the sockets to select, returns it or -1 */
+static int add_ring_event(picoquic_cnx_t *cnx, SOCKET_TYPE *sockets, int *nb_sockets) {
+    spsc_ring_t *to_app = (cnx != NULL) ? get_to_app_ring(cnx) : NULL;
+    int ring_fd = (to_app != NULL) ? spsc_ring_get_eventfd(to_app) : -1;
+    if (ring_fd != -1) {
+        sockets[(*nb_sockets)++] = ring_fd;
+    }
+    return ring_fd;
+}
+
+/* Sends the packet read by the select and all the packets queued on the tun device since, up to TUN_BATCH_SIZE */
+void handle_tun_read(picoquic_cnx_t *cnx, tun_device_t *tun, uint8_t *buffer, int bytes_recv) {
+    static uint8_t packet[TUN_MAX_PACKET];
+    size_t header_length = tun->vnet_hdr ? sizeof(struct virtio_net_hdr) : 0;
     uint32_t max_message_size = (uint32_t) protoop_prepare_and_run_extern_noparam(cnx, &get_max_message_size, NULL, NULL);
-    if (bytes_recv > max_message_size) {
-        fprintf(stdout, "%d-byte long message received is bigger than max payload size %d, dropping it\n", bytes_recv, max_message_size);
+    spsc_ring_t *from_app = (get_to_app_ring(cnx) != NULL) ? plugin_get_ring(cnx, DATAGRAM_PLUGIN_NAME, PLUGIN_RING_FROM_APP) : NULL;
+    int nb_packets = 0;
+    int nb_dropped = 0;
+    int queue = 0;
+    protoop_arg_t pret = 0;
+
+    while (bytes_recv > 0 && nb_packets < TUN_BATCH_SIZE) {
+        uint8_t *payload = buffer + header_length;
+        int length = bytes_recv - (int) header_length;
+        nb_packets++;
+        if (length <= 0 || length > max_message_size) {
+            nb_dropped++;
+        } else if (from_app != NULL) {
+            if (spsc_ring_push(from_app, payload, (uint32_t) length) != 0) {
+                nb_dropped++;
+            }
+        } else if (protoop_prepare_and_run_extern_noparam(cnx, &send_message, NULL, payload, length) != 0) {
+            nb_dropped++;
+        }
+        buffer = packet;
+        bytes_recv = tun_read_next(tun, &queue, packet, sizeof(packet));
+    }
+
+    if (from_app != NULL) {
+        pret = protoop_prepare_and_run_extern_noparam(cnx, &send_messages, NULL, NULL);
+    }
+    if (nb_dropped > 0 || pret != 0) {
+        fprintf(stdout, "Unable to send %d messages out of %d\n", nb_dropped + (int) pret, nb_packets);
+    }
+}
+
+/* Writes on the tun interface all the messages received by the connection.
+ * With the rings, it is called when their eventfd is selected. */
+void handle_received_messages(picoquic_cnx_t *cnx, tun_device_t *tun) {
+    spsc_ring_t *to_app = get_to_app_ring(cnx);
+    static uint8_t buffer[TUN_MAX_PACKET];
+    int len;
+
+    if (to_app != NULL) {
+        spsc_ring_clear_event(to_app);
+        while ((len = spsc_ring_pop(to_app, buffer, sizeof(buffer))) != 0) {
+            if (len < 0) {
+                spsc_ring_skip(to_app);
+            } else if (tun_write(tun, buffer, (size_t) len) != len) {
+                printf("Error when writing to the tunnel: %s\n", strerror(errno));
+            }
+        }
         return;
     }
-    protoop_arg_t pret = protoop_prepare_and_run_extern_noparam(cnx, &send_message, NULL, buffer, bytes_recv);
-    if (pret != 0) {
-        fprintf(stdout, "Unable to send message\n");
+
+    int message_socket = (int) protoop_prepare_and_run_extern_noparam(cnx, &get_message_socket, 0, NULL);
+    ssize_t mret = 1;
+    while(mret > 0) {
+        mret = recv(message_socket, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (mret > 0) {
+            (void) tun_write(tun, buffer, (size_t) mret);
+        } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            printf("Error when reading the message socket: %s\n", strerror(errno));
+        }
     }
 }
 
@@ -412,21 +551,25 @@ int quic_server(const char* server_name, int server_port,
         }
     }
 
-    int tun_fd = tun_open("tun1");
-    if (tun_fd == -1) {
+    tun_device_t tun;
+    if (tun_open(&tun, "tun1") == -1) {
         printf("Failed to open tun1\n");
         exit(-1);
     }
-    SOCKET_TYPE sockets[3];
+    SOCKET_TYPE sockets[3 + TUN_MAX_QUEUES];
     sockets[0] = server_sockets.s_socket[0];
     sockets[1] = server_sockets.s_socket[1];
-    sockets[2] = tun_fd;
+    for (int i = 0; i < tun.nb_queues; i++) {
+        sockets[2 + i] = tun.fds[i];
+    }
 
     /* Wait for packets */
     while (ret == 0 && (just_once == 0 || cnx_server == NULL || picoquic_get_cnx_state(cnx_server) != picoquic_state_disconnected)) {
         int64_t delta_t = picoquic_get_next_wake_delay(qserver, current_time, delay_max);
         uint64_t time_before = current_time;
         int bytes_recv;
+        int nb_sockets = 2 + tun.nb_queues;
+        int ring_fd = add_ring_event(cnx_server, sockets, &nb_sockets);
 
         from_length = to_length = sizeof(struct sockaddr_storage);
         if_index_to = 0;
@@ -435,7 +578,7 @@ int quic_server(const char* server_name, int server_port,
             picoquic_log_congestion_state(stdout, cnx_server, current_time);
         }
 
-        bytes_recv = picoquic_select(sockets, 3,
+        bytes_recv = picoquic_select(sockets, nb_sockets,
                                      &addr_from, &from_length,
                                      &addr_to, &to_length, &if_index_to,
                                      buffer, sizeof(buffer),
@@ -457,7 +600,9 @@ int quic_server(const char* server_name, int server_port,
             ret = -1;
         } else {
             if (bytes_recv > 0) {
-                if (qserver->rcv_socket != tun_fd) {
+                if (ring_fd != -1 && qserver->rcv_socket == ring_fd) {
+                    handle_received_messages(cnx_server, &tun);
+                } else if (!tun_is_queue(&tun, qserver->rcv_socket)) {
                     /* Submit the packet to the server */
                     ret = picoquic_incoming_packet(qserver, buffer,
                                                    (size_t) bytes_recv, (struct sockaddr *) &addr_from,
@@ -497,7 +642,7 @@ int quic_server(const char* server_name, int server_port,
                         picoquic_log_transport_extension(stdout, cnx_server, 1);
                     }
                 } else if (cnx_server != NULL && cnx_server->cnx_state >= picoquic_state_server_almost_ready) {
-                    handle_tun_read(cnx_server, tun_fd, buffer, bytes_recv);
+                    handle_tun_read(cnx_server, &tun, buffer, bytes_recv);
                 }
             }
             if (ret == 0) {
@@ -521,18 +666,8 @@ int quic_server(const char* server_name, int server_port,
 
 
                 while (ret == 0 && (cnx_next = picoquic_get_earliest_cnx_to_wake(qserver, loop_time)) != NULL) {
-                    int message_socket = (int) protoop_prepare_and_run_extern_noparam(cnx_next, &get_message_socket, 0, NULL);
-                    char buffer[65535];
-                    ssize_t mret = 1;
-                    while(mret > 0) {
-                        mret = recv(message_socket, buffer, sizeof(buffer), MSG_DONTWAIT);
-                        if (mret > 0) {
-                            printf("Received %" PRIu64 " bytes as message\n", mret);
-                            ssize_t tret = write(tun_fd, buffer, (size_t) mret);
-                            printf("Write %" PRIu64 " bytes to the tunnel\n", tret);
-                        } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
-                            printf("Error when reading the message socket: %s\n", strerror(errno));
-                        }
+                    if (cnx_next != cnx_server || ring_fd == -1) {
+                        handle_received_messages(cnx_next, &tun);
                     }
 
 
@@ -873,34 +1008,40 @@ int quic_client(const char* ip_address_text, int server_port, const char * sni,
         }
     }
 
-    int tun_fd = tun_open("tun0");
-    if (tun_fd == -1) {
+    tun_device_t tun;
+    if (tun_open(&tun, "tun0") == -1) {
         printf("Failed to open tun0\n");
         exit(-1);
     }
-    SOCKET_TYPE sockets[2];
+    SOCKET_TYPE sockets[2 + TUN_MAX_QUEUES];
     sockets[0] = fd;
-    sockets[1] = tun_fd;
+    for (int i = 0; i < tun.nb_queues; i++) {
+        sockets[1 + i] = tun.fds[i];
+    }
 
     /* Wait for packets */
     while (ret == 0 && picoquic_get_cnx_state(cnx_client) != picoquic_state_disconnected) {
         int bytes_recv;
+        int nb_sockets = 1 + tun.nb_queues;
+        int ring_fd = add_ring_event(cnx_client, sockets, &nb_sockets);
+        int is_ring_event;
 
         from_length = to_length = sizeof(struct sockaddr_storage);
 
-        bytes_recv = picoquic_select(sockets, 2, &packet_from, &from_length,
+        bytes_recv = picoquic_select(sockets, nb_sockets, &packet_from, &from_length,
                                      &packet_to, &to_length, &if_index_to,
                                      buffer, sizeof(buffer),
                                      delta_t,
                                      &current_time,
                                      qclient);
+        is_ring_event = bytes_recv > 0 && ring_fd != -1 && qclient->rcv_socket == ring_fd;
 
-        if (bytes_recv != 0) {
+        if (bytes_recv != 0 && !is_ring_event) {
             if (F_log != NULL) {
                 fprintf(F_log, "Select returns %d, from length %u\n", bytes_recv, from_length);
             }
 
-            if (bytes_recv > 0 && qclient->rcv_socket != tun_fd && F_log != NULL)
+            if (bytes_recv > 0 && !tun_is_queue(&tun, qclient->rcv_socket) && F_log != NULL)
             {
                 picoquic_log_packet_address(F_log,
                                             picoquic_val64_connection_id(picoquic_get_logging_cnxid(cnx_client)),
@@ -911,8 +1052,11 @@ int quic_client(const char* ip_address_text, int server_port, const char * sni,
         if (bytes_recv < 0) {
             ret = -1;
         } else {
-            if (bytes_recv > 0) {
-                if (qclient->rcv_socket != tun_fd) {
+            if (is_ring_event) {
+                handle_received_messages(cnx_client, &tun);
+                delta_t = 0;
+            } else if (bytes_recv > 0) {
+                if (!tun_is_queue(&tun, qclient->rcv_socket)) {
                     /* Submit the packet to the client */
                     ret = picoquic_incoming_packet(qclient, buffer,
                                                    (size_t) bytes_recv, (struct sockaddr *) &packet_from,
@@ -938,24 +1082,14 @@ int quic_client(const char* ip_address_text, int server_port, const char * sni,
                         picoquic_log_error_packet(F_log, buffer, (size_t) bytes_recv, ret);
                     }
                 } else {
-                    handle_tun_read(cnx_client, tun_fd, buffer, bytes_recv);
+                    handle_tun_read(cnx_client, &tun, buffer, bytes_recv);
                 }
 
                 delta_t = 0;
             }
 
-            int message_socket = (int) protoop_prepare_and_run_extern_noparam(cnx_client, &get_message_socket, 0, NULL);
-            char buffer[65535];
-            ssize_t mret = 1;
-            while(mret > 0) {
-                mret = recv(message_socket, buffer, sizeof(buffer), MSG_DONTWAIT);
-                if (mret > 0) {
-                    printf("Received %" PRIu64 " bytes as message\n", mret);
-                    ssize_t tret = write(tun_fd, buffer, (size_t) mret);
-                    printf("Write %" PRIu64 " bytes to the tunnel\n", tret);
-                } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
-                    printf("Error when reading the message socket: %s\n", strerror(errno));
-                }
+            if (ring_fd == -1) {
+                handle_received_messages(cnx_client, &tun);
             }
 
             /* In normal circumstances, the code waits until all packets in the receive
@@ -1095,6 +1229,8 @@ void usage()
     fprintf(stderr, "  -l file               Log file\n");
     fprintf(stderr, "  -m mtu_max            Largest mtu value that can be tried for discovery\n");
     fprintf(stderr, "  -q output.qlog        qlog output file\n");
+    fprintf(stderr, "  -Q nb_queues          Number of queues opened on the tun device (default: 1, max: %d)\n", TUN_MAX_QUEUES);
+    fprintf(stderr, "  -O                    Use the virtio header on the tun device to skip checksum verification\n");
     fprintf(stderr, "  -h                    This help message\n");
     exit(1);
 }
@@ -1130,6 +1266,8 @@ int main(int argc, char** argv)
     get_max_message_size.hash = hash_value_str(get_max_message_size.id);
     send_message.hash = hash_value_str(send_message.id);
     get_message_socket.hash = hash_value_str(get_message_socket.id);
+    get_message_rings.hash = hash_value_str(get_message_rings.id);
+    send_messages.hash = hash_value_str(send_messages.id);
 
     const char* server_name = default_server_name;
     const char* server_cert_file = default_server_cert_file;
@@ -1166,7 +1304,7 @@ int main(int argc, char** argv)
 
     /* Get the parameters */
     int opt;
-    while ((opt = getopt(argc, argv, "c:k:p:v:1rhzi:s:l:m:n:t:P:q:")) != -1) {
+    while ((opt = getopt(argc, argv, "c:k:p:v:1rhzi:s:l:m:n:t:P:q:Q:O")) != -1) {
         switch (opt) {
             case 'c':
                 server_cert_file = optarg;
@@ -1247,6 +1385,16 @@ int main(int argc, char** argv)
             case 'q':
                 qlog_filename = optarg;
                 break;
+            case 'Q':
+                tun_nb_queues = atoi(optarg);
+                if (tun_nb_queues <= 0 || tun_nb_queues > TUN_MAX_QUEUES) {
+                    fprintf(stderr, "Invalid number of tun queues: %s\n", optarg);
+                    usage();
+                }
+                break;
+            case 'O':
+                tun_vnet_hdr = 1;
+                break;
             case 'h':
                 usage();
                 break;
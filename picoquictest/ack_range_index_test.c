@@ -0,0 +1,159 @@
+#include "../picoquic/picoquic_internal.h"
+#include "memory.h"
+#include <stdlib.h>
+
+/*
+ * The retransmit queue is indexed by sequence number, so that ACK ranges are
+ * resolved without walking the whole queue. Queue a large number of packets,
+ * acknowledge a few ranges, and check that exactly the right packets remain
+ * and that the output packet of each range is the first one below it.
+ */
+
+#define ACK_RANGE_INDEX_NB_PACKETS 1000
+
+typedef struct st_test_ack_range_index_t {
+    uint64_t highest;
+    uint64_t range;
+    int64_t next_expected; /* -1 if no packet is expected below the range */
+} test_ack_range_index_t;
+
+static const test_ack_range_index_t test_ack_range_index_list[] = {
+    { 999, 100, 899 },
+    { 799, 300, 499 },
+    { 950, 20, 899 }, /* Already acknowledged, nothing to release */
+    { 10, 11, -1 },
+    { 2000, 50, 899 } /* Above the queue */
+};
+
+static int ack_range_index_is_acked(uint64_t sequence_number)
+{
+    return sequence_number <= 10 || (sequence_number >= 500 && sequence_number <= 799) || sequence_number >= 900;
+}
+
+static int ack_range_index_queue(picoquic_cnx_t* cnx, picoquic_path_t* path_x, uint64_t sequence_number)
+{
+    picoquic_packet_t* packet = picoquic_create_packet(cnx);
+
+    if (packet == NULL) {
+        return -1;
+    }
+    packet->sequence_number = sequence_number;
+    packet->send_path = path_x;
+    packet->pc = picoquic_packet_context_application;
+    picoquic_queue_for_retransmit(cnx, path_x, packet, 0, 0);
+    return 0;
+}
+
+int ack_range_index_test()
+{
+    int ret = 0;
+    picoquic_cnx_t cnx;
+    picoquic_path_t* path_x = (picoquic_path_t*)calloc(1, sizeof(picoquic_path_t));
+    picoquic_packet_context_t* pkt_ctx = NULL;
+    picoquic_packet_context_enum pc = picoquic_packet_context_application;
+    uint64_t nb_remaining = 0;
+
+    memset(&cnx, 0, sizeof(picoquic_cnx_t));
+    register_protocol_operations(&cnx);
+
+    if (path_x == NULL) {
+        ret = -1;
+    } else {
+        pkt_ctx = &path_x->pkt_ctx[pc];
+    }
+
+    for (uint64_t i = 0; ret == 0 && i < ACK_RANGE_INDEX_NB_PACKETS; i++) {
+        ret = ack_range_index_queue(&cnx, path_x, i);
+    }
+
+    if (ret == 0 && (pkt_ctx->retransmit_index == NULL || pkt_ctx->retransmit_index_size < ACK_RANGE_INDEX_NB_PACKETS)) {
+        DBG_PRINTF("%s", "Retransmit queue is not indexed\n");
+        ret = -1;
+    }
+
+    for (size_t i = 0; ret == 0 && i < sizeof(test_ack_range_index_list) / sizeof(test_ack_range_index_t); i++) {
+        protoop_arg_t outs[PROTOOPARGS_MAX];
+        picoquic_packet_t* next;
+
+        protoop_prepare_and_run_noparam(&cnx, &PROTOOP_NOPARAM_PROCESS_ACK_RANGE, outs,
+            pc, test_ack_range_index_list[i].highest, test_ack_range_index_list[i].range, pkt_ctx->retransmit_newest, 0);
+        next = (picoquic_packet_t*)outs[0];
+
+        if (test_ack_range_index_list[i].next_expected < 0) {
+            ret = (next == NULL) ? 0 : -1;
+        } else {
+            ret = (next != NULL && next->sequence_number == (uint64_t)test_ack_range_index_list[i].next_expected) ? 0 : -1;
+        }
+
+        if (ret != 0) {
+            DBG_PRINTF("Unexpected next packet after range %d\n", (int)i);
+        }
+    }
+
+    for (picoquic_packet_t* p = (pkt_ctx != NULL) ? pkt_ctx->retransmit_newest : NULL; ret == 0 && p != NULL; p = p->next_packet) {
+        nb_remaining++;
+        if (ack_range_index_is_acked(p->sequence_number) || picoquic_retransmit_index_get(pkt_ctx, p->sequence_number) != p) {
+            DBG_PRINTF("Packet %d should not be in the queue\n", (int)p->sequence_number);
+            ret = -1;
+        }
+    }
+
+    if (ret == 0 && nb_remaining != 589) {
+        DBG_PRINTF("Expected 589 packets in the queue, got %d\n", (int)nb_remaining);
+        ret = -1;
+    }
+
+    /* An out of order packet drops the index, which is not rebuilt on every
+     * queued packet but once the queue has grown by its span */
+    if (ret == 0) {
+        uint64_t sequence_number = ACK_RANGE_INDEX_NB_PACKETS;
+        uint64_t nb_queued = 0;
+
+        ret = ack_range_index_queue(&cnx, path_x, 0);
+        if (ret == 0 && (pkt_ctx->retransmit_index != NULL || pkt_ctx->retransmit_index_retry < PICOQUIC_RETRANSMIT_INDEX_MIN_SIZE)) {
+            DBG_PRINTF("%s", "Out of order packet should drop the index and back off\n");
+            ret = -1;
+        }
+
+        while (ret == 0 && pkt_ctx->retransmit_index == NULL && nb_queued <= 2 * ACK_RANGE_INDEX_NB_PACKETS) {
+            ret = ack_range_index_queue(&cnx, path_x, sequence_number++);
+            nb_queued++;
+        }
+
+        /* The out of order packet is still queued, so the index stays off */
+        if (ret == 0 && pkt_ctx->retransmit_index != NULL) {
+            DBG_PRINTF("%s", "Index rebuilt on an out of order queue\n");
+            ret = -1;
+        }
+
+        /* Once it is acknowledged, the next attempt succeeds */
+        if (ret == 0) {
+            protoop_arg_t outs[PROTOOPARGS_MAX];
+            uint64_t retry = pkt_ctx->retransmit_index_retry;
+
+            protoop_prepare_and_run_noparam(&cnx, &PROTOOP_NOPARAM_PROCESS_ACK_RANGE, outs,
+                pc, (uint64_t)0, (uint64_t)1, pkt_ctx->retransmit_newest, 0);
+            for (uint64_t i = 0; ret == 0 && i < retry; i++) {
+                ret = ack_range_index_queue(&cnx, path_x, sequence_number++);
+                if (ret == 0 && pkt_ctx->retransmit_index != NULL) {
+                    DBG_PRINTF("Index rebuilt after %d packets, expected %d\n", (int)(i + 1), (int)retry + 1);
+                    ret = -1;
+                }
+            }
+            if (ret == 0) {
+                ret = ack_range_index_queue(&cnx, path_x, sequence_number++);
+            }
+            if (ret == 0 && pkt_ctx->retransmit_index == NULL) {
+                DBG_PRINTF("%s", "Index not rebuilt after the back off\n");
+                ret = -1;
+            }
+        }
+    }
+
+    if (path_x != NULL) {
+        picoquic_reset_packet_context(&cnx, pc, path_x);
+        free(path_x);
+    }
+
+    return ret;
+}
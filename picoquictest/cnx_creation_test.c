@@ -203,3 +203,142 @@ int cnxcreation_test()
 
     return ret;
 }
+
+/*
+ * Stateless packet pool test
+ * - Fill the pool, verify that overflow is dropped and counted.
+ * - Verify that packets are dequeued in FIFO order, in batches.
+ * - Verify that deleted packets return to the pool.
+ * - Verify that a single source prefix is rate limited, and that
+ *   the budget is refilled as time passes.
+ */
+
+int stateless_pool_test()
+{
+    int ret = 0;
+    uint64_t simulated_time = 0;
+    picoquic_quic_t* quic = NULL;
+    picoquic_stateless_packet_t* sp[PICOQUIC_STATELESS_POOL_SIZE];
+    struct sockaddr_in addr;
+    size_t nb_sp = 0;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    ((uint8_t*)&addr.sin_addr)[0] = 192;
+    ((uint8_t*)&addr.sin_addr)[1] = 0;
+    ((uint8_t*)&addr.sin_addr)[2] = 2;
+    ((uint8_t*)&addr.sin_addr)[3] = 1;
+
+    quic = picoquic_create(8, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, simulated_time, &simulated_time, NULL, NULL, 0, NULL);
+    if (quic == NULL) {
+        ret = -1;
+    }
+
+    /* Fill the pool without rate limit, then overflow it */
+    if (ret == 0) {
+        picoquic_set_stateless_rate_limit(quic, 0, 0);
+
+        for (int i = 0; ret == 0 && i < PICOQUIC_STATELESS_POOL_SIZE; i++) {
+            picoquic_stateless_packet_t* p = picoquic_create_stateless_packet(quic, (struct sockaddr*)&addr);
+            if (p == NULL) {
+                ret = -1;
+            } else {
+                p->length = i;
+                picoquic_queue_stateless_packet(quic, p);
+            }
+        }
+
+        if (ret == 0 && (picoquic_create_stateless_packet(quic, (struct sockaddr*)&addr) != NULL ||
+            picoquic_get_stateless_dropped_overflow(quic) != 1 ||
+            picoquic_get_stateless_queued(quic) != PICOQUIC_STATELESS_POOL_SIZE)) {
+            ret = -1;
+        }
+    }
+
+    /* Drain in batches, check the order, and recycle */
+    if (ret == 0) {
+        size_t expected = 0;
+
+        while (ret == 0 && (nb_sp = picoquic_dequeue_stateless_packets(quic, sp, 16)) > 0) {
+            for (size_t i = 0; i < nb_sp; i++) {
+                if (sp[i]->length != expected++) {
+                    ret = -1;
+                }
+                picoquic_delete_stateless_packet(sp[i]);
+            }
+        }
+
+        if (ret == 0 && (expected != PICOQUIC_STATELESS_POOL_SIZE || picoquic_dequeue_stateless_packet(quic) != NULL)) {
+            ret = -1;
+        }
+    }
+
+    /* Rate limit a single prefix */
+    if (ret == 0) {
+        picoquic_set_stateless_rate_limit(quic, 4, 1000);
+
+        for (int i = 0; i < 5; i++) {
+            ((uint8_t*)&addr.sin_addr)[3] = (uint8_t)(i + 1);
+            sp[i] = picoquic_create_stateless_packet(quic, (struct sockaddr*)&addr);
+            if ((i < 4 && sp[i] == NULL) || (i == 4 && sp[i] != NULL)) {
+                ret = -1;
+            }
+        }
+
+        for (int i = 0; i < 4; i++) {
+            if (sp[i] != NULL) {
+                picoquic_delete_stateless_packet(sp[i]);
+            }
+        }
+
+        if (ret == 0 && picoquic_get_stateless_dropped_rate_limited(quic) != 1) {
+            ret = -1;
+        }
+    }
+
+    /* After 2 ms, two more packets are allowed */
+    if (ret == 0) {
+        simulated_time += 2000;
+
+        for (int i = 0; i < 3; i++) {
+            sp[i] = picoquic_create_stateless_packet(quic, (struct sockaddr*)&addr);
+            if ((i < 2 && sp[i] == NULL) || (i == 2 && sp[i] != NULL)) {
+                ret = -1;
+            }
+        }
+
+        for (int i = 0; i < 2; i++) {
+            if (sp[i] != NULL) {
+                picoquic_delete_stateless_packet(sp[i]);
+            }
+        }
+
+        if (ret == 0 && picoquic_get_stateless_dropped_rate_limited(quic) != 2) {
+            ret = -1;
+        }
+    }
+
+    /* A packet held by the application stays valid after the context is freed */
+    if (ret == 0) {
+        picoquic_stateless_packet_t* held;
+
+        picoquic_set_stateless_rate_limit(quic, 0, 0);
+        held = picoquic_create_stateless_packet(quic, (struct sockaddr*)&addr);
+        picoquic_free(quic);
+        quic = NULL;
+
+        if (held == NULL) {
+            ret = -1;
+        } else {
+            memset(held->bytes, 0, sizeof(held->bytes));
+            held->length = 0;
+            picoquic_delete_stateless_packet(held);
+        }
+    }
+
+    if (quic != NULL) {
+        picoquic_free(quic);
+    }
+
+    return ret;
+}
@@ -2,6 +2,7 @@
 #include "plugin.h"
 #include "memory.h"
 #include "util.h"
+#include "spsc_ring.h"
 
 #include "../plugins/datagram/bpf.h"
 
@@ -170,6 +171,130 @@ static int datagram_write_test() {
     return ret;
 }
 
+static int datagram_ring_test()
+{
+    int ret = 0;
+    uint8_t message[1500];
+    uint8_t received[1500];
+    spsc_ring_t *ring = spsc_ring_create(4096);
+
+    if (ring == NULL) {
+        DBG_PRINTF("%s", "Unable to create the ring\n");
+        return -1;
+    }
+
+    /* Fill the ring several times so that messages wrap around its end */
+    for (uint32_t i = 0; ret == 0 && i < 1000; i++) {
+        uint32_t length = 4 + (i * 37) % (sizeof(message) - 4);
+        int nb_queued = 0;
+        memcpy(message, &i, sizeof(i));
+        while (spsc_ring_push(ring, message, length) == 0) {
+            nb_queued++;
+        }
+        if (nb_queued == 0) {
+            DBG_PRINTF("Unable to push message %d of %d bytes\n", i, length);
+            ret = -1;
+        }
+        for (int j = 0; ret == 0 && j < nb_queued; j++) {
+            uint32_t value;
+            if (spsc_ring_peek_length(ring) != length) {
+                DBG_PRINTF("Peeked length %d, expected %d\n", spsc_ring_peek_length(ring), length);
+                ret = -1;
+            } else if (spsc_ring_pop(ring, received, sizeof(received)) != (int) length) {
+                DBG_PRINTF("Unable to pop message %d\n", i);
+                ret = -1;
+            } else {
+                memcpy(&value, received, sizeof(value));
+                if (value != i) {
+                    DBG_PRINTF("Popped message %d, expected %d\n", value, i);
+                    ret = -1;
+                }
+            }
+        }
+        if (ret == 0 && spsc_ring_pop(ring, received, sizeof(received)) != 0) {
+            DBG_PRINTF("%s", "The ring should be empty\n");
+            ret = -1;
+        }
+    }
+
+    /* A message too large for the buffer is left in the ring until skipped */
+    if (ret == 0 && (spsc_ring_push(ring, message, 100) != 0 || spsc_ring_pop(ring, received, 10) != -1 ||
+        spsc_ring_peek_length(ring) != 100)) {
+        DBG_PRINTF("%s", "Too large message should be left in the ring\n");
+        ret = -1;
+    }
+    if (ret == 0) {
+        spsc_ring_skip(ring);
+        if (spsc_ring_peek_length(ring) != 0) {
+            DBG_PRINTF("%s", "Skipped message should be removed\n");
+            ret = -1;
+        }
+    }
+
+    spsc_ring_free(ring);
+    return ret;
+}
+
+/* The pluglets reach only the rings of their plugin, and push or pop only in its memory */
+static int datagram_plugin_ring_test()
+{
+    int ret = 0;
+    picoquic_cnx_t cnx = { 0 };
+    protoop_plugin_t *p = calloc(1, sizeof(protoop_plugin_t));
+    uint8_t outside[16];
+    uint8_t *inside;
+    spsc_ring_t *ring;
+
+    if (p == NULL) {
+        return -1;
+    }
+    strncpy(p->name, "be.mpiraux.datagram", PROTOOPPLUGINNAME_MAX);
+    HASH_ADD_STR(cnx.plugins, name, p);
+    cnx.current_plugin = p;
+    inside = (uint8_t *) &p->memory[PLUGIN_MEMORY - sizeof(outside)];
+    memcpy(inside, "abc", 3);
+
+    if (plugin_ring_push(&cnx, PLUGIN_RING_TO_APP, inside, 1) != -1 ||
+        plugin_get_ring(&cnx, "be.mpiraux.datagram", PLUGIN_RING_TO_APP) != NULL) {
+        DBG_PRINTF("%s", "The rings should not be open\n");
+        ret = -1;
+    } else if (plugin_ring_open(&cnx, 4096) != 0) {
+        DBG_PRINTF("%s", "Unable to open the rings\n");
+        ret = -1;
+    } else if (plugin_ring_push(&cnx, PLUGIN_RING_TO_APP, (uint8_t *) "abc", 3) != -1 ||
+        plugin_ring_push(&cnx, PLUGIN_RING_TO_APP, inside, sizeof(outside) + 1) != -1) {
+        DBG_PRINTF("%s", "A push from outside the plugin memory should fail\n");
+        ret = -1;
+    } else if (plugin_ring_push(&cnx, PLUGIN_RING_TO_APP, inside, 3) != 0 ||
+        (ring = plugin_get_ring(&cnx, "be.mpiraux.datagram", PLUGIN_RING_TO_APP)) == NULL ||
+        spsc_ring_pop(ring, outside, sizeof(outside)) != 3 || memcmp(outside, "abc", 3) != 0) {
+        DBG_PRINTF("%s", "The application should receive the message pushed by the plugin\n");
+        ret = -1;
+    } else if ((ring = plugin_get_ring(&cnx, "be.mpiraux.datagram", PLUGIN_RING_FROM_APP)) == NULL ||
+        spsc_ring_push(ring, (uint8_t *) "defg", 4) != 0) {
+        DBG_PRINTF("%s", "Unable to push on the ring of the application\n");
+        ret = -1;
+    } else if (plugin_ring_pop(&cnx, PLUGIN_RING_FROM_APP, outside, sizeof(outside)) != -1 ||
+        plugin_ring_pop(&cnx, PLUGIN_RING_FROM_APP, inside, sizeof(outside) + 1) != -1 ||
+        plugin_ring_pop(&cnx, PLUGIN_RINGS_MAX, inside, sizeof(outside)) != -1) {
+        DBG_PRINTF("%s", "A pop outside the plugin memory or ring should fail\n");
+        ret = -1;
+    } else if (plugin_ring_pop(&cnx, PLUGIN_RING_FROM_APP, inside, sizeof(outside)) != 4 || memcmp(inside, "defg", 4) != 0) {
+        DBG_PRINTF("%s", "The plugin should receive the message pushed by the application\n");
+        ret = -1;
+    }
+
+    plugin_ring_close(&cnx);
+    if (ret == 0 && plugin_get_ring(&cnx, "be.mpiraux.datagram", PLUGIN_RING_FROM_APP) != NULL) {
+        DBG_PRINTF("%s", "The rings should be closed\n");
+        ret = -1;
+    }
+
+    HASH_DEL(cnx.plugins, p);
+    free(p);
+    return ret;
+}
+
 int datagram_test() {
     int ret = datagram_parse_test();
     if (ret) {
@@ -181,5 +306,15 @@ int datagram_test() {
         DBG_PRINTF("datagram_write test failed\n");
         return ret;
     }
+    ret = datagram_ring_test();
+    if (ret) {
+        DBG_PRINTF("datagram_ring test failed\n");
+        return ret;
+    }
+    ret = datagram_plugin_ring_test();
+    if (ret) {
+        DBG_PRINTF("datagram_plugin_ring test failed\n");
+        return ret;
+    }
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,153 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "picoquic_internal.h"
+#include "getset.h"
+
+/* The keys are below 0x40 for both structures */
+#define GETSET_TEST_MAX_KEY 0x40
+
+/* Checks that the direct accesses through the field locations match the get and set functions */
+int getset_fields_test()
+{
+    int ret = 0;
+    int nb_fields = 0;
+    picoquic_cnx_t *cnx = (picoquic_cnx_t *) calloc(1, sizeof(picoquic_cnx_t));
+    picoquic_path_t *path = (picoquic_path_t *) calloc(1, sizeof(picoquic_path_t));
+
+    if (cnx == NULL || path == NULL) {
+        DBG_PRINTF("%s", "Cannot allocate the structures\n");
+        ret = -1;
+    }
+
+    for (access_key_t ak = 0; ret == 0 && ak < GETSET_TEST_MAX_KEY; ak++) {
+        const getset_field_t *field = getset_cnx_field(ak);
+        /* A value that fits all field sizes, distinct for each key */
+        protoop_arg_t val = 0x40 + ak;
+
+        if (field == NULL) {
+            continue;
+        }
+        nb_fields++;
+        getset_field_store(cnx, field, val);
+        if (get_cnx(cnx, ak, 0) != val) {
+            DBG_PRINTF("Direct store of cnx key 0x%x is not seen by get_cnx\n", ak);
+            ret = -1;
+        }
+        set_cnx(cnx, ak, 0, val + 1);
+        if (getset_field_load(cnx, field) != val + 1) {
+            DBG_PRINTF("set_cnx of key 0x%x is not seen by a direct load\n", ak);
+            ret = -1;
+        }
+    }
+
+    for (access_key_t ak = 0; ret == 0 && ak < GETSET_TEST_MAX_KEY; ak++) {
+        const getset_field_t *field = getset_path_field(ak);
+        protoop_arg_t val = 0x40 + ak;
+
+        if (field == NULL) {
+            continue;
+        }
+        nb_fields++;
+        getset_field_store(path, field, val);
+        if (get_path(path, ak, 0) != val) {
+            DBG_PRINTF("Direct store of path key 0x%x is not seen by get_path\n", ak);
+            ret = -1;
+        }
+        set_path(path, ak, 0, val + 1);
+        if (getset_field_load(path, field) != val + 1) {
+            DBG_PRINTF("set_path of key 0x%x is not seen by a direct load\n", ak);
+            ret = -1;
+        }
+    }
+
+    /* Keys that are not plain fields must go through the functions */
+    if (ret == 0 && (nb_fields == 0 || getset_cnx_field(AK_CNX_INPUT) != NULL ||
+        getset_cnx_field(AK_CNX_STATE) != NULL || getset_path_field(AK_PATH_PEER_ADDR) != NULL)) {
+        DBG_PRINTF("%s", "Unexpected set of plain fields\n");
+        ret = -1;
+    }
+
+    /* The vectored accessors mix plain fields and keys handled by the functions */
+    if (ret == 0) {
+        access_key_t keys[3] = { AK_PATH_CWIN, AK_PATH_CHALLENGE_VERIFIED, AK_PATH_SEND_MTU };
+        protoop_arg_t vals[3] = { 12345, 1, 1252 };
+        protoop_arg_t out[3] = { 0 };
+
+        set_path_fields(path, keys, 3, vals);
+        get_path_fields(path, keys, 3, out);
+        for (int i = 0; i < 3; i++) {
+            if (out[i] != vals[i] || get_path(path, keys[i], 0) != vals[i]) {
+                DBG_PRINTF("Vectored access to path key 0x%x failed\n", keys[i]);
+                ret = -1;
+            }
+        }
+    }
+
+    free(cnx);
+    free(path);
+
+    return ret;
+}
+
+/* Checks that the metadata of two plugins on a packet are kept apart in their slots, the first
+ * slots being in the packet itself */
+int getset_metadata_test()
+{
+    int ret = 0;
+    picoquic_cnx_t *cnx = (picoquic_cnx_t *) calloc(1, sizeof(picoquic_cnx_t));
+    picoquic_packet_t *pkt = picoquic_create_packet(cnx);
+    protoop_plugin_t *plugins = (protoop_plugin_t *) calloc(2, sizeof(protoop_plugin_t));
+
+    if (cnx == NULL || pkt == NULL || plugins == NULL) {
+        DBG_PRINTF("%s", "Cannot allocate the structures\n");
+        free(cnx);
+        free(plugins);
+        if (pkt != NULL) {
+            picoquic_destroy_packet(pkt);
+        }
+        return -1;
+    }
+    /* An inline slot does not allocate */
+    plugins[0].metadata_slot = 1;
+    cnx->current_plugin = &plugins[0];
+    set_pkt_metadata(cnx, pkt, 0, 1);
+    if (pkt->metadata.extra_slots != NULL || get_pkt_metadata(cnx, pkt, 0) != 1) {
+        DBG_PRINTF("%s", "Setting an inline slot allocated the extra block\n");
+        ret = -1;
+    }
+
+    /* The higher slot is used first, the extra block must grow to it */
+    plugins[0].metadata_slot = STRUCT_METADATA_INLINE_SLOTS + 1;
+    plugins[1].metadata_slot = 0;
+
+    for (int i = 0; ret == 0 && i < 2; i++) {
+        cnx->current_plugin = &plugins[i];
+        if (get_pkt_metadata(cnx, pkt, 0) != 0) {
+            DBG_PRINTF("Unset metadata of slot %d is not zero\n", plugins[i].metadata_slot);
+            ret = -1;
+        }
+        for (int idx = 0; idx < STRUCT_METADATA_MAX; idx++) {
+            set_pkt_metadata(cnx, pkt, idx, (i + 1) * 100 + idx);
+        }
+    }
+    if (ret == 0 && (pkt->metadata.extra_slots == NULL || pkt->metadata.nb_extra_slots != 2)) {
+        DBG_PRINTF("%s", "Unexpected size of the extra metadata block\n");
+        ret = -1;
+    }
+    for (int i = 0; ret == 0 && i < 2; i++) {
+        cnx->current_plugin = &plugins[i];
+        for (int idx = 0; idx < STRUCT_METADATA_MAX; idx++) {
+            if (get_pkt_metadata(cnx, pkt, idx) != (protoop_arg_t) ((i + 1) * 100 + idx)) {
+                DBG_PRINTF("Metadata %d of slot %d was overwritten\n", idx, plugins[i].metadata_slot);
+                ret = -1;
+            }
+        }
+    }
+
+    picoquic_destroy_packet(pkt);
+    free(plugins);
+    free(cnx);
+
+    return ret;
+}
@@ -23,7 +23,15 @@
 #ifdef _WINDOWS
 #include <malloc.h>
 #endif
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#ifndef _WINDOWS
+#include <sys/time.h>
+#endif
 #include "../picoquic/picohash.h"
+#include "../picoquic/cidtable.h"
+#include "../picoquic/util.h"
 
 struct hashtestkey {
     uint64_t x;
@@ -135,3 +143,190 @@ int picohash_test()
 
     return ret;
 }
+
+/*
+ * Connection ID table. Fill a table created much too small, so that it goes
+ * through several incremental resizes, while removing part of the entries.
+ */
+
+#define CID_TABLE_TEST_NB 5000
+
+static void cid_table_test_cid(picoquic_connection_id_t* cid, uint64_t x)
+{
+    memset(cid, 0, sizeof(picoquic_connection_id_t));
+    cid->id_len = (uint8_t)(4 + x % 15);
+    for (uint8_t i = 0; i < cid->id_len; i++) {
+        cid->id[i] = (uint8_t)((x >> (8 * (i % 8))) + i);
+    }
+}
+
+int cid_table_test()
+{
+    int ret = 0;
+    picoquic_connection_id_t cid;
+    picoquic_cid_table_t* t = picoquic_cid_table_create(4, 0x0123456789ABCDEFull);
+
+    if (t == NULL) {
+        ret = -1;
+    }
+
+    for (uint64_t i = 1; ret == 0 && i <= CID_TABLE_TEST_NB; i++) {
+        cid_table_test_cid(&cid, i);
+        ret = picoquic_cid_table_insert(t, &cid, (void*)(uintptr_t)i);
+
+        /* Remove every third entry while the table is growing */
+        if (ret == 0 && i % 3 == 0) {
+            cid_table_test_cid(&cid, i - 1);
+            ret = (picoquic_cid_table_remove(t, &cid) == (void*)(uintptr_t)(i - 1)) ? 0 : -1;
+        }
+    }
+
+    /* Duplicates are refused */
+    for (uint64_t i = 1; ret == 0 && i <= CID_TABLE_TEST_NB; i += 3) {
+        cid_table_test_cid(&cid, i);
+        ret = (picoquic_cid_table_insert(t, &cid, NULL) != 0) ? 0 : -1;
+    }
+
+    for (uint64_t i = 1; ret == 0 && i <= CID_TABLE_TEST_NB + 100; i++) {
+        void* expected = (i > CID_TABLE_TEST_NB || (i % 3 == 2 && i < CID_TABLE_TEST_NB)) ? NULL : (void*)(uintptr_t)i;
+        cid_table_test_cid(&cid, i);
+        if (picoquic_cid_table_lookup(t, &cid) != expected) {
+            DBG_PRINTF("Unexpected lookup result for entry %d\n", (int)i);
+            ret = -1;
+        }
+    }
+
+    if (ret == 0 && picoquic_cid_table_count(t) != CID_TABLE_TEST_NB - CID_TABLE_TEST_NB / 3) {
+        DBG_PRINTF("Unexpected count %d\n", (int)picoquic_cid_table_count(t));
+        ret = -1;
+    }
+
+    /* Empty the table, then check that it can be refilled */
+    for (uint64_t i = 1; ret == 0 && i <= CID_TABLE_TEST_NB; i++) {
+        cid_table_test_cid(&cid, i);
+        (void)picoquic_cid_table_remove(t, &cid);
+    }
+
+    if (ret == 0 && picoquic_cid_table_count(t) != 0) {
+        ret = -1;
+    }
+
+    for (uint64_t i = 1; ret == 0 && i <= CID_TABLE_TEST_NB; i++) {
+        cid_table_test_cid(&cid, i);
+        ret = picoquic_cid_table_insert(t, &cid, (void*)(uintptr_t)i);
+        if (ret == 0 && picoquic_cid_table_lookup(t, &cid) != (void*)(uintptr_t)i) {
+            ret = -1;
+        }
+    }
+
+    if (t != NULL) {
+        picoquic_cid_table_free(t);
+    }
+
+    return ret;
+}
+
+/*
+ * Lookup benchmark: the picohash table sized for a quarter of the connection
+ * IDs, as happens when nb_connections is underestimated, versus the
+ * connection ID table. Prints the time per lookup, never fails on timing.
+ */
+
+#define CID_TABLE_BENCH_NB 100000
+#define CID_TABLE_BENCH_ROUNDS 20
+
+typedef struct st_cid_bench_key_t {
+    picoquic_connection_id_t cid;
+} cid_bench_key_t;
+
+static uint64_t cid_bench_hash(void* key)
+{
+    return picoquic_val64_connection_id(((cid_bench_key_t*)key)->cid);
+}
+
+static int cid_bench_compare(void* key1, void* key2)
+{
+    return picoquic_compare_connection_id(&((cid_bench_key_t*)key1)->cid, &((cid_bench_key_t*)key2)->cid);
+}
+
+static uint64_t cid_bench_elapsed(struct timeval* start, struct timeval* end)
+{
+    return (end->tv_sec - start->tv_sec) * 1000000ull + (end->tv_usec - start->tv_usec);
+}
+
+int cid_table_bench()
+{
+    int ret = 0;
+    uint64_t nb_found = 0;
+    struct timeval tv_start;
+    struct timeval tv_end;
+    picoquic_connection_id_t* cids = (picoquic_connection_id_t*)malloc(CID_TABLE_BENCH_NB * sizeof(picoquic_connection_id_t));
+    picohash_table* h = picohash_create(CID_TABLE_BENCH_NB / 4, cid_bench_hash, cid_bench_compare);
+    picoquic_cid_table_t* t = picoquic_cid_table_create(CID_TABLE_BENCH_NB / 16, 0x0123456789ABCDEFull);
+
+    if (cids == NULL || h == NULL || t == NULL) {
+        ret = -1;
+    }
+
+    for (size_t i = 0; ret == 0 && i < CID_TABLE_BENCH_NB; i++) {
+        cid_bench_key_t* key = (cid_bench_key_t*)malloc(sizeof(cid_bench_key_t));
+
+        cids[i].id_len = 8;
+        for (int j = 0; j < 8; j++) {
+            cids[i].id[j] = (uint8_t)(rand() & 0xFF);
+        }
+
+        if (key == NULL) {
+            ret = -1;
+        } else {
+            key->cid = cids[i];
+            if (picohash_insert(h, key) != 0) {
+                free(key);
+                ret = -1;
+            } else if (picoquic_cid_table_insert(t, &cids[i], key) != 0) {
+                /* Random duplicate, keep it out of both benchmarks */
+                cids[i].id_len = 0;
+            }
+        }
+    }
+
+    if (ret == 0) {
+        cid_bench_key_t key;
+        memset(&key, 0, sizeof(key));
+
+        gettimeofday(&tv_start, NULL);
+        for (int r = 0; r < CID_TABLE_BENCH_ROUNDS; r++) {
+            for (size_t i = 0; i < CID_TABLE_BENCH_NB; i++) {
+                key.cid = cids[i];
+                nb_found += (picohash_retrieve(h, &key) != NULL);
+            }
+        }
+        gettimeofday(&tv_end, NULL);
+        fprintf(stderr, "picohash: %" PRIu64 " us for %d lookups\n", cid_bench_elapsed(&tv_start, &tv_end),
+            CID_TABLE_BENCH_ROUNDS * CID_TABLE_BENCH_NB);
+
+        gettimeofday(&tv_start, NULL);
+        for (int r = 0; r < CID_TABLE_BENCH_ROUNDS; r++) {
+            for (size_t i = 0; i < CID_TABLE_BENCH_NB; i++) {
+                nb_found += (picoquic_cid_table_lookup(t, &cids[i]) != NULL);
+            }
+        }
+        gettimeofday(&tv_end, NULL);
+        fprintf(stderr, "cid table: %" PRIu64 " us for %d lookups\n", cid_bench_elapsed(&tv_start, &tv_end),
+            CID_TABLE_BENCH_ROUNDS * CID_TABLE_BENCH_NB);
+
+        if (nb_found == 0) {
+            ret = -1;
+        }
+    }
+
+    if (t != NULL) {
+        picoquic_cid_table_free(t);
+    }
+    if (h != NULL) {
+        picohash_delete(h, 1);
+    }
+    free(cids);
+
+    return ret;
+}
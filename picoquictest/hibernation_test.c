@@ -0,0 +1,450 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <malloc.h>
+#include "picoquic_internal.h"
+#include "plugin.h"
+#include "memory.h"
+#include "picoquictest_internal.h"
+
+#define HIBERNATION_TEST_DELAY 1000000
+#define HIBERNATION_TEST_MAX_ROUNDS 100000
+#define HIBERNATION_TEST_MAX_CNX 100
+#define HIBERNATION_TEST_DATA_LENGTH 4096
+
+/*
+ * Clients and a server exchanging their packets directly. Like a real packet
+ * loop, each round only prepares the connections whose wake time is reached,
+ * so that the idle connections are left alone and can hibernate.
+ */
+typedef struct st_hibernation_test_ctx_t {
+    picoquic_quic_t* qserver;
+    picoquic_quic_t* qclient;
+    int nb_clients;
+    picoquic_cnx_t* cnx_client[HIBERNATION_TEST_MAX_CNX];
+    struct sockaddr_in client_addr[HIBERNATION_TEST_MAX_CNX];
+    struct sockaddr_in server_addr;
+    uint64_t simulated_time;
+    uint64_t nb_bytes_received;
+    int fin_received;
+} hibernation_test_ctx_t;
+
+static void hibernation_test_callback(picoquic_cnx_t* cnx,
+    uint64_t stream_id, uint8_t* bytes, size_t length,
+    picoquic_call_back_event_t fin_or_event, void* callback_ctx)
+{
+    hibernation_test_ctx_t* ctx = (hibernation_test_ctx_t*)callback_ctx;
+
+    if (ctx != NULL && (fin_or_event == picoquic_callback_no_event || fin_or_event == picoquic_callback_stream_fin)) {
+        ctx->nb_bytes_received += length;
+        ctx->fin_received |= (fin_or_event == picoquic_callback_stream_fin);
+    }
+}
+
+static void hibernation_test_addr(struct sockaddr_in* addr, uint32_t host, uint16_t port)
+{
+    memset(addr, 0, sizeof(struct sockaddr_in));
+    addr->sin_family = AF_INET;
+#ifdef _WINDOWS
+    addr->sin_addr.S_un.S_addr = host;
+#else
+    addr->sin_addr.s_addr = host;
+#endif
+    addr->sin_port = port;
+}
+
+static struct sockaddr* hibernation_test_client_addr(hibernation_test_ctx_t* ctx, picoquic_cnx_t* cnx)
+{
+    for (int i = 0; i < ctx->nb_clients; i++) {
+        if (ctx->cnx_client[i] == cnx) {
+            return (struct sockaddr*)&ctx->client_addr[i];
+        }
+    }
+
+    return NULL;
+}
+
+/* Prepares the packets of the connections due, returns 1 if something was sent */
+static int hibernation_test_wake(hibernation_test_ctx_t* ctx, picoquic_quic_t* quic)
+{
+    int was_active = 0;
+    uint8_t bytes[PICOQUIC_MAX_PACKET_SIZE];
+    picoquic_cnx_t* cnx;
+
+    for (int i = 0; i < 4 * HIBERNATION_TEST_MAX_CNX &&
+        (cnx = picoquic_get_earliest_cnx_to_wake(quic, ctx->simulated_time)) != NULL; i++) {
+        size_t length = 0;
+        picoquic_path_t* path = NULL;
+        int new_context_created = 0;
+
+        if (picoquic_prepare_packet(cnx, ctx->simulated_time, bytes, sizeof(bytes), &length, &path) != 0 || length == 0) {
+            continue;
+        }
+        was_active = 1;
+        if (quic == ctx->qclient) {
+            (void)picoquic_incoming_packet(ctx->qserver, bytes, (uint32_t)length,
+                hibernation_test_client_addr(ctx, cnx), (struct sockaddr*)&ctx->server_addr, 0,
+                ctx->simulated_time, &new_context_created);
+        } else {
+            (void)picoquic_incoming_packet(ctx->qclient, bytes, (uint32_t)length,
+                (struct sockaddr*)&ctx->server_addr, (struct sockaddr*)&path->peer_addr, 0,
+                ctx->simulated_time, &new_context_created);
+        }
+    }
+
+    return was_active;
+}
+
+/* Exchanges the packets, or moves the time to the next wake up when there are none */
+static void hibernation_test_round(hibernation_test_ctx_t* ctx)
+{
+    int was_active = hibernation_test_wake(ctx, ctx->qclient);
+
+    was_active |= hibernation_test_wake(ctx, ctx->qserver);
+
+    if (!was_active) {
+        uint64_t next_time = UINT64_MAX;
+        picoquic_cnx_t* cnx;
+
+        if ((cnx = picoquic_get_earliest_cnx_to_wake(ctx->qclient, 0)) != NULL) {
+            next_time = cnx->next_wake_time;
+        }
+        if ((cnx = picoquic_get_earliest_cnx_to_wake(ctx->qserver, 0)) != NULL && cnx->next_wake_time < next_time) {
+            next_time = cnx->next_wake_time;
+        }
+        ctx->simulated_time = (next_time > ctx->simulated_time && next_time != UINT64_MAX) ?
+            next_time : ctx->simulated_time + 1000;
+    }
+}
+
+static int hibernation_test_connected(hibernation_test_ctx_t* ctx)
+{
+    int nb_server_ready = 0;
+
+    for (int i = 0; i < ctx->nb_clients; i++) {
+        if (picoquic_get_cnx_state(ctx->cnx_client[i]) != picoquic_state_client_ready) {
+            return 0;
+        }
+    }
+    for (picoquic_cnx_t* cnx = picoquic_get_first_cnx(ctx->qserver); cnx != NULL; cnx = picoquic_get_next_cnx(cnx)) {
+        nb_server_ready += (picoquic_get_cnx_state(cnx) == picoquic_state_server_ready);
+    }
+
+    return nb_server_ready >= ctx->nb_clients;
+}
+
+static int hibernation_test_all_hibernated(hibernation_test_ctx_t* ctx)
+{
+    return picoquic_get_nb_hibernated(ctx->qclient) == ctx->nb_clients &&
+        picoquic_get_nb_hibernated(ctx->qserver) == ctx->nb_clients;
+}
+
+/* Runs rounds until the condition holds, for at most max_delay of simulated time */
+static int hibernation_test_run_until(hibernation_test_ctx_t* ctx,
+    int (*condition)(hibernation_test_ctx_t* ctx), uint64_t max_delay)
+{
+    uint64_t max_time = ctx->simulated_time + max_delay;
+
+    for (int round = 0; round < HIBERNATION_TEST_MAX_ROUNDS && ctx->simulated_time <= max_time; round++) {
+        if (condition(ctx)) {
+            return 0;
+        }
+        hibernation_test_round(ctx);
+    }
+
+    return -1;
+}
+
+/* If plugin_fname is not NULL, the plugin is attached to every connection on both sides */
+static int hibernation_test_start(hibernation_test_ctx_t* ctx, int nb_clients, const char* plugin_fname)
+{
+    int ret = 0;
+
+    memset(ctx, 0, sizeof(hibernation_test_ctx_t));
+    ctx->nb_clients = nb_clients;
+    hibernation_test_addr(&ctx->server_addr, 0x0A000001, 4321);
+    for (int i = 0; i < nb_clients; i++) {
+        hibernation_test_addr(&ctx->client_addr[i], 0x0A000002, (uint16_t)(1234 + i));
+    }
+
+    ctx->qclient = picoquic_create(nb_clients, NULL, NULL, PICOQUIC_TEST_CERT_STORE, NULL,
+        hibernation_test_callback, NULL, NULL, NULL, NULL, ctx->simulated_time, &ctx->simulated_time, NULL, NULL, 0, NULL);
+    ctx->qserver = picoquic_create(nb_clients, PICOQUIC_TEST_SERVER_CERT, PICOQUIC_TEST_SERVER_KEY,
+        PICOQUIC_TEST_CERT_STORE, PICOQUIC_TEST_ALPN, hibernation_test_callback, ctx, NULL, NULL, NULL,
+        ctx->simulated_time, &ctx->simulated_time, NULL, NULL, 0, NULL);
+
+    if (ctx->qclient == NULL || ctx->qserver == NULL) {
+        ret = -1;
+    } else if (plugin_fname != NULL) {
+        ret = picoquic_set_local_plugins(ctx->qserver, &plugin_fname, 1);
+    }
+
+    for (int i = 0; ret == 0 && i < nb_clients; i++) {
+        ctx->cnx_client[i] = picoquic_create_cnx(ctx->qclient, picoquic_null_connection_id, picoquic_null_connection_id,
+            (struct sockaddr*)&ctx->server_addr, ctx->simulated_time, 0, PICOQUIC_TEST_SNI, PICOQUIC_TEST_ALPN, 1);
+        if (ctx->cnx_client[i] == NULL) {
+            ret = -1;
+        } else if (plugin_fname != NULL) {
+            ret = plugin_insert_plugins_from_fnames(ctx->cnx_client[i], 1, (char**)&plugin_fname);
+        }
+        if (ret == 0) {
+            ret = picoquic_start_client_cnx(ctx->cnx_client[i]);
+        }
+    }
+
+    if (ret == 0) {
+        ret = hibernation_test_run_until(ctx, hibernation_test_connected, PICOQUIC_MICROSEC_HANDSHAKE_MAX);
+    }
+
+    return ret;
+}
+
+static void hibernation_test_delete(hibernation_test_ctx_t* ctx)
+{
+    if (ctx->qclient != NULL) {
+        picoquic_free(ctx->qclient);
+    }
+    if (ctx->qserver != NULL) {
+        picoquic_free(ctx->qserver);
+    }
+}
+
+static void hibernation_test_set_delay(hibernation_test_ctx_t* ctx, uint64_t delay)
+{
+    picoquic_set_hibernation_delay(ctx->qclient, delay);
+    picoquic_set_hibernation_delay(ctx->qserver, delay);
+}
+
+/* The idle connections hibernate, and data sent afterwards wakes both sides */
+/* What a plugin observing the hibernate operation does: its state is saved, then its
+ * memory and metadata are released until the connection wakes up */
+static int hibernation_plugin_state_test()
+{
+    int ret = 0;
+    hibernation_test_ctx_t ctx;
+    picoquic_cnx_t* cnx = NULL;
+    protoop_plugin_t* p = calloc(1, sizeof(protoop_plugin_t));
+    const uint8_t state[] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+    uint8_t data[HIBERNATION_TEST_DATA_LENGTH];
+    uint8_t* saved = NULL;
+    uint8_t* restored;
+    uint64_t metadata = 0;
+
+    memset(&ctx, 0, sizeof(ctx));
+    memset(data, 0x5A, sizeof(data));
+    if (p == NULL) {
+        return -1;
+    }
+    strncpy(p->name, "test.hibernation", PROTOOPPLUGINNAME_MAX);
+    p->params.plugin_memory_manager_type = plugin_memory_manager_slab;
+    p->block_queue_cc = queue_init();
+    p->block_queue_non_cc = queue_init();
+    restored = (uint8_t*)&p->memory[PLUGIN_MEMORY / 2];
+    *restored = 0xFF;
+
+    if (p->block_queue_cc == NULL || p->block_queue_non_cc == NULL || init_memory_management(p) != 0) {
+        ret = -1;
+    } else if (hibernation_test_start(&ctx, 1, NULL) != 0) {
+        DBG_PRINTF("%s", "Cannot establish the connection\n");
+        ret = -1;
+    } else {
+        cnx = ctx.cnx_client[0];
+        HASH_ADD_STR(cnx->plugins, name, p);
+        cnx->current_plugin = p;
+        if ((saved = (uint8_t*)my_malloc(cnx, sizeof(state))) == NULL) {
+            ret = -1;
+        } else {
+            memcpy(saved, state, sizeof(state));
+            if (set_plugin_metadata(p, &cnx->metadata, 0, (uint64_t)saved) != 0 ||
+                plugin_save_hibernation_state(cnx, state, sizeof(state)) != -1 ||
+                plugin_save_hibernation_state(cnx, saved, sizeof(state)) != 0) {
+                DBG_PRINTF("%s", "Only a state in the plugin memory can be saved\n");
+                ret = -1;
+            }
+        }
+        cnx->current_plugin = NULL;
+    }
+
+    if (ret == 0) {
+        hibernation_test_set_delay(&ctx, HIBERNATION_TEST_DELAY);
+        if (hibernation_test_run_until(&ctx, hibernation_test_all_hibernated, 5 * HIBERNATION_TEST_DELAY) != 0) {
+            DBG_PRINTF("%s", "The connection with a plugin did not hibernate\n");
+            ret = -1;
+        } else if (!p->memory_released || cnx->ops == NULL ||
+            get_plugin_metadata(p, &cnx->metadata, 0, &metadata) != 0 || metadata != 0) {
+            DBG_PRINTF("%s", "The memory of the plugin was not released\n");
+            ret = -1;
+        }
+#ifndef _WINDOWS
+        else if (*restored != 0) {
+            DBG_PRINTF("%s", "The pages of the plugin memory were kept\n");
+            ret = -1;
+        }
+#endif
+    }
+
+    if (ret == 0) {
+        cnx->current_plugin = p;
+        if (plugin_restore_hibernation_state(cnx, restored, sizeof(state) - 1) != -1 ||
+            plugin_restore_hibernation_state(cnx, data, sizeof(state)) != -1 ||
+            plugin_restore_hibernation_state(cnx, restored, sizeof(state)) != (int)sizeof(state) ||
+            memcmp(restored, state, sizeof(state)) != 0) {
+            DBG_PRINTF("%s", "The state of the plugin was not restored\n");
+            ret = -1;
+        }
+        cnx->current_plugin = NULL;
+    }
+
+    if (ret == 0) {
+        if (picoquic_add_to_stream(cnx, 4, data, sizeof(data), 1) != 0 || picoquic_is_hibernated(cnx) ||
+            p->memory_released || p->hibernation_state != NULL) {
+            DBG_PRINTF("%s", "The plugin did not wake up with the connection\n");
+            ret = -1;
+        } else {
+            cnx->current_plugin = p;
+            if ((saved = (uint8_t*)my_malloc(cnx, sizeof(state))) == NULL) {
+                DBG_PRINTF("%s", "The memory of the plugin was not rebuilt\n");
+                ret = -1;
+            }
+            cnx->current_plugin = NULL;
+        }
+    }
+
+    if (cnx != NULL) {
+        HASH_DEL(cnx->plugins, p);
+    }
+    hibernation_test_delete(&ctx);
+    destroy_memory_management(p);
+    if (p->block_queue_cc != NULL) {
+        queue_free(p->block_queue_cc);
+    }
+    if (p->block_queue_non_cc != NULL) {
+        queue_free(p->block_queue_non_cc);
+    }
+    free(p);
+
+    return ret;
+}
+
+int hibernation_test()
+{
+    int ret = 0;
+    hibernation_test_ctx_t ctx;
+    picoquic_cnx_t* cnx_server = NULL;
+    uint8_t data[HIBERNATION_TEST_DATA_LENGTH];
+
+    memset(data, 0x5A, sizeof(data));
+
+    if (hibernation_test_start(&ctx, 1, NULL) != 0) {
+        DBG_PRINTF("%s", "Cannot establish the connection\n");
+        ret = -1;
+    } else {
+        cnx_server = picoquic_get_first_cnx(ctx.qserver);
+        hibernation_test_set_delay(&ctx, HIBERNATION_TEST_DELAY);
+
+        if (hibernation_test_run_until(&ctx, hibernation_test_all_hibernated, 5 * HIBERNATION_TEST_DELAY) != 0) {
+            DBG_PRINTF("%s", "The idle connections did not hibernate\n");
+            ret = -1;
+        } else if (!picoquic_is_hibernated(ctx.cnx_client[0]) || !picoquic_is_hibernated(cnx_server) ||
+            ctx.cnx_client[0]->ops != NULL || cnx_server->ops != NULL) {
+            DBG_PRINTF("%s", "The protocol operations of the hibernated connections were kept\n");
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        /* The application wakes the client, its packets wake the server */
+        if (picoquic_add_to_stream(ctx.cnx_client[0], 4, data, sizeof(data), 1) != 0 ||
+            picoquic_is_hibernated(ctx.cnx_client[0]) || ctx.cnx_client[0]->ops == NULL) {
+            DBG_PRINTF("%s", "The application call did not wake the client\n");
+            ret = -1;
+        } else {
+            for (int round = 0; round < HIBERNATION_TEST_MAX_ROUNDS && !ctx.fin_received; round++) {
+                hibernation_test_round(&ctx);
+            }
+            if (!ctx.fin_received || ctx.nb_bytes_received != sizeof(data)) {
+                DBG_PRINTF("Received %d bytes after the hibernation, fin %d\n", (int)ctx.nb_bytes_received, ctx.fin_received);
+                ret = -1;
+            } else if (picoquic_get_nb_hibernated(ctx.qserver) != 0 || cnx_server->ops == NULL) {
+                DBG_PRINTF("%s", "The packets did not wake the server\n");
+                ret = -1;
+            }
+        }
+    }
+
+    if (ret == 0 && (hibernation_test_run_until(&ctx, hibernation_test_all_hibernated, 5 * HIBERNATION_TEST_DELAY) != 0 ||
+        picoquic_get_cnx_state(ctx.cnx_client[0]) != picoquic_state_client_ready ||
+        picoquic_get_cnx_state(cnx_server) != picoquic_state_server_ready)) {
+        DBG_PRINTF("%s", "The connections did not hibernate again\n");
+        ret = -1;
+    }
+
+    hibernation_test_delete(&ctx);
+
+    if (ret == 0) {
+        ret = hibernation_plugin_state_test();
+    }
+
+    return ret;
+}
+
+/* mallinfo2 only exists since glibc 2.33, the int counters of mallinfo are enough for this bench */
+#ifdef __GLIBC_PREREQ
+#if __GLIBC_PREREQ(2, 33)
+#define HIBERNATION_BENCH_MALLINFO2
+#endif
+#endif
+
+static size_t hibernation_bench_heap()
+{
+#ifdef HIBERNATION_BENCH_MALLINFO2
+    struct mallinfo2 info = mallinfo2();
+#else
+    struct mallinfo info = mallinfo();
+#endif
+
+    return (size_t)info.uordblks;
+}
+
+/* Heap used per connection, client and server sides, active and hibernated. The protocol operations
+ * of the connections having plugins are kept while they hibernate, they save much less. The no_pacing
+ * plugin saves an empty state, its memory is released, but it is mapped out of the heap and not counted. */
+int hibernation_bench()
+{
+    int ret = 0;
+    static const char* plugin_fnames[] = { NULL, "plugins/no_pacing/no_pacing.plugin" };
+
+    for (size_t i = 0; ret == 0 && i < sizeof(plugin_fnames) / sizeof(plugin_fnames[0]); i++) {
+        hibernation_test_ctx_t ctx;
+        size_t heap_empty = hibernation_bench_heap();
+        size_t heap_active = 0;
+        size_t heap_hibernated = 0;
+
+        if (hibernation_test_start(&ctx, HIBERNATION_TEST_MAX_CNX, plugin_fnames[i]) != 0) {
+            DBG_PRINTF("%s", "Cannot establish the connections\n");
+            ret = -1;
+        } else {
+            heap_active = hibernation_bench_heap() - heap_empty;
+            hibernation_test_set_delay(&ctx, HIBERNATION_TEST_DELAY);
+
+            if (hibernation_test_run_until(&ctx, hibernation_test_all_hibernated, 5 * HIBERNATION_TEST_DELAY) != 0) {
+                DBG_PRINTF("%s", "The idle connections did not hibernate\n");
+                ret = -1;
+            } else {
+                heap_hibernated = hibernation_bench_heap() - heap_empty;
+
+                printf("%d connections %s, %d bytes per connection active, %d hibernated\n", HIBERNATION_TEST_MAX_CNX,
+                    (plugin_fnames[i] == NULL) ? "without plugin" : plugin_fnames[i],
+                    (int)(heap_active / HIBERNATION_TEST_MAX_CNX), (int)(heap_hibernated / HIBERNATION_TEST_MAX_CNX));
+                if (heap_hibernated > heap_active || (plugin_fnames[i] == NULL && heap_hibernated == heap_active)) {
+                    DBG_PRINTF("%s", "The hibernation did not save memory\n");
+                    ret = -1;
+                }
+            }
+        }
+
+        hibernation_test_delete(&ctx);
+    }
+
+    return ret;
+}
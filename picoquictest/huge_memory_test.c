@@ -0,0 +1,148 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "picoquic_internal.h"
+#include "huge_memory.h"
+
+/* More packets than a single chunk holds */
+#define HUGE_TEST_NB_PACKETS 2000
+
+static int huge_memory_regions_test()
+{
+    int ret = 0;
+    picoquic_huge_memory_t* hm = picoquic_huge_memory_create();
+    picoquic_packet_t** packets = (picoquic_packet_t**)calloc(HUGE_TEST_NB_PACKETS, sizeof(picoquic_packet_t*));
+    uint8_t* region = NULL;
+    const picoquic_huge_memory_stats_t* stats;
+
+    if (hm == NULL || packets == NULL) {
+        DBG_PRINTF("%s", "Cannot create the huge memory\n");
+        picoquic_huge_memory_free(hm);
+        free(packets);
+        return -1;
+    }
+    stats = picoquic_huge_memory_stats(hm);
+
+    /* A plugin sized region is zeroed and covered by huge pages */
+    region = (uint8_t*)picoquic_huge_alloc(hm, sizeof(protoop_plugin_t));
+    if (region == NULL || ((uintptr_t)region % 64) != 0) {
+        DBG_PRINTF("%s", "Cannot allocate an aligned region\n");
+        ret = -1;
+    } else if (region[0] != 0 || region[sizeof(protoop_plugin_t) - 1] != 0) {
+        DBG_PRINTF("%s", "The region is not zeroed\n");
+        ret = -1;
+    } else if (stats->nb_regions != 1 || stats->bytes_mapped < sizeof(protoop_plugin_t) ||
+        stats->bytes_mapped % PICOQUIC_HUGE_PAGE_SIZE != 0 || stats->bytes_hugetlb + stats->bytes_thp != stats->bytes_mapped) {
+        DBG_PRINTF("%s", "Unexpected statistics for the region\n");
+        ret = -1;
+    } else {
+        memset(region, 0xaa, sizeof(protoop_plugin_t));
+    }
+    picoquic_huge_release(hm, region);
+    if (ret == 0 && (stats->nb_regions != 0 || stats->bytes_mapped != 0)) {
+        DBG_PRINTF("%s", "The region was not unmapped\n");
+        ret = -1;
+    }
+
+    /* Packets take new chunks when needed, and are reused once released */
+    for (int i = 0; ret == 0 && i < HUGE_TEST_NB_PACKETS; i++) {
+        packets[i] = picoquic_huge_packet_alloc(hm);
+        if (packets[i] == NULL) {
+            DBG_PRINTF("Cannot allocate packet %d\n", i);
+            ret = -1;
+        } else {
+            memset(packets[i], (uint8_t)i, sizeof(picoquic_packet_t));
+        }
+    }
+    for (int i = 0; ret == 0 && i < HUGE_TEST_NB_PACKETS; i++) {
+        if (packets[i]->bytes[0] != (uint8_t)i || packets[i]->bytes[PICOQUIC_MAX_PACKET_SIZE - 1] != (uint8_t)i) {
+            DBG_PRINTF("Packet %d was overwritten\n", i);
+            ret = -1;
+        }
+    }
+    if (ret == 0 && (stats->nb_packet_chunks < 2 || stats->packets_in_use != HUGE_TEST_NB_PACKETS)) {
+        DBG_PRINTF("%s", "Unexpected statistics for the packets\n");
+        ret = -1;
+    }
+    for (int i = 0; i < HUGE_TEST_NB_PACKETS; i++) {
+        if (packets[i] != NULL) {
+            picoquic_huge_packet_release(hm, packets[i]);
+        }
+    }
+    if (ret == 0) {
+        uint64_t nb_chunks = stats->nb_packet_chunks;
+        picoquic_packet_t* packet = picoquic_huge_packet_alloc(hm);
+
+        if (packet == NULL || stats->nb_packet_chunks != nb_chunks || stats->packets_in_use != 1) {
+            DBG_PRINTF("%s", "A released packet was not reused\n");
+            ret = -1;
+        }
+        if (packet != NULL) {
+            picoquic_huge_packet_release(hm, packet);
+        }
+    }
+
+    picoquic_huge_memory_free(hm);
+    free(packets);
+
+    return ret;
+}
+
+/* The packets of a connection come from the huge pages of its context */
+static int huge_memory_quic_test()
+{
+    int ret = 0;
+    struct sockaddr_in test_addr;
+    picoquic_cnx_t* cnx = NULL;
+    picoquic_packet_t* packet = NULL;
+    picoquic_quic_t* quic = picoquic_create(8, NULL, NULL, NULL, NULL, NULL, NULL,
+        NULL, NULL, NULL, 0, NULL, NULL, NULL, 0, NULL);
+
+    if (quic == NULL || picoquic_get_huge_memory_stats(quic) != NULL || picoquic_set_huge_memory(quic, 1) != 0) {
+        DBG_PRINTF("%s", "Cannot enable the huge memory\n");
+        ret = -1;
+    }
+
+    if (ret == 0) {
+        memset(&test_addr, 0, sizeof(struct sockaddr_in));
+        test_addr.sin_family = AF_INET;
+        test_addr.sin_port = 12345;
+        cnx = picoquic_create_cnx(quic, picoquic_null_connection_id, picoquic_null_connection_id,
+            (struct sockaddr*)&test_addr, 0, 0, NULL, NULL, 1);
+        packet = (cnx == NULL) ? NULL : picoquic_create_packet(cnx);
+        if (packet == NULL || packet->huge_memory != quic->huge_memory || !packet->is_pure_ack) {
+            DBG_PRINTF("%s", "The packet does not come from the huge memory\n");
+            ret = -1;
+        } else if (picoquic_get_huge_memory_stats(quic)->packets_in_use != 1 || picoquic_set_huge_memory(quic, 0) == 0) {
+            DBG_PRINTF("%s", "The huge memory was disabled while a packet is in use\n");
+            ret = -1;
+        }
+    }
+
+    if (packet != NULL) {
+        picoquic_destroy_packet(packet);
+    }
+    if (ret == 0 && picoquic_get_huge_memory_stats(quic)->packets_in_use != 0) {
+        DBG_PRINTF("%s", "The packet was not released to the huge memory\n");
+        ret = -1;
+    }
+    if (cnx != NULL) {
+        picoquic_delete_cnx(cnx);
+    }
+    if (quic != NULL) {
+        picoquic_free(quic);
+    }
+
+    return ret;
+}
+
+int huge_memory_test()
+{
+    int ret = huge_memory_regions_test();
+
+    if (ret == 0) {
+        ret = huge_memory_quic_test();
+    }
+
+    return ret;
+}
@@ -0,0 +1,184 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* fopencookie */
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include "picoquic_internal.h"
+#include "log_writer.h"
+
+#define LOG_WRITER_TEST_LINE_LENGTH 100
+/* Twice the ring, so that a stalled sink makes it overflow */
+#define LOG_WRITER_TEST_NB_LINES (2 * PICOQUIC_LOG_WRITER_RING_SIZE / LOG_WRITER_TEST_LINE_LENGTH)
+
+/* A sink that checks the lines it receives, and is slow or stalled */
+typedef struct st_log_writer_test_sink_t {
+    int delay; /* In microseconds, per write */
+    int stalled; /* Writes wait until it is cleared */
+    int error;
+    uint64_t nb_lines;
+    int64_t last_line;
+} log_writer_test_sink_t;
+
+static ssize_t log_writer_test_sink_write(void* cookie, const char* buf, size_t size)
+{
+    log_writer_test_sink_t* sink = (log_writer_test_sink_t*)cookie;
+
+    while (__atomic_load_n(&sink->stalled, __ATOMIC_ACQUIRE)) {
+        usleep(1000);
+    }
+    if (sink->delay > 0) {
+        usleep(sink->delay);
+    }
+
+    /* stdio may split the batches, but the test lines only come whole from the writer */
+    for (size_t offset = 0; offset + LOG_WRITER_TEST_LINE_LENGTH <= size; offset += LOG_WRITER_TEST_LINE_LENGTH) {
+        int64_t line = atoll(buf + offset + 5);
+        if (memcmp(buf + offset, "line ", 5) != 0 || buf[offset + LOG_WRITER_TEST_LINE_LENGTH - 1] != '\n' ||
+            line <= sink->last_line) {
+            sink->error = 1;
+        }
+        sink->last_line = line;
+        sink->nb_lines++;
+    }
+    if (size % LOG_WRITER_TEST_LINE_LENGTH != 0) {
+        sink->error = 1;
+    }
+
+    return (ssize_t)size;
+}
+
+static FILE* log_writer_test_sink_open(log_writer_test_sink_t* sink, int delay, int stalled)
+{
+    cookie_io_functions_t io_functions = { NULL, log_writer_test_sink_write, NULL, NULL };
+    FILE* F = NULL;
+
+    memset(sink, 0, sizeof(log_writer_test_sink_t));
+    sink->delay = delay;
+    sink->stalled = stalled;
+    sink->last_line = -1;
+    F = fopencookie(sink, "w", io_functions);
+    if (F != NULL) {
+        /* Each batch of the writer reaches the sink in a single write */
+        setvbuf(F, NULL, _IONBF, 0);
+    }
+
+    return F;
+}
+
+static void log_writer_test_lines(FILE* F)
+{
+    for (int i = 0; i < LOG_WRITER_TEST_NB_LINES; i++) {
+        fprintf(F, "line %08d %*s\n", i, LOG_WRITER_TEST_LINE_LENGTH - 15, "x");
+    }
+}
+
+static int log_writer_policy_test(picoquic_log_overload_enum overload, uint32_t sample_rate, int delay, int stalled)
+{
+    int ret = 0;
+    log_writer_test_sink_t sink;
+    FILE* F_sink = log_writer_test_sink_open(&sink, delay, stalled);
+    picoquic_log_writer_t* writer = (F_sink == NULL) ? NULL : picoquic_log_writer_create(F_sink, overload, sample_rate);
+    picoquic_log_writer_stats_t stats;
+
+    if (writer == NULL) {
+        DBG_PRINTF("%s", "Cannot create the log writer\n");
+        ret = -1;
+    } else {
+        log_writer_test_lines(picoquic_log_writer_get_file(writer));
+        picoquic_log_writer_get_stats(writer, &stats);
+        __atomic_store_n(&sink.stalled, 0, __ATOMIC_RELEASE);
+        picoquic_log_writer_free(writer);
+
+        if (sink.error) {
+            DBG_PRINTF("Policy %d, the sink received corrupted or reordered lines\n", overload);
+            ret = -1;
+        } else if (stats.nb_records != LOG_WRITER_TEST_NB_LINES ||
+            sink.nb_lines != stats.nb_records - stats.nb_dropped - stats.nb_sampled_out) {
+            DBG_PRINTF("Policy %d, %d lines written, %d received, %d dropped, %d sampled out\n", overload,
+                (int)stats.nb_records, (int)sink.nb_lines, (int)stats.nb_dropped, (int)stats.nb_sampled_out);
+            ret = -1;
+        } else {
+            switch (overload) {
+            case picoquic_log_overload_block:
+                ret = (stats.nb_blocked > 0 && stats.nb_dropped == 0 && stats.nb_sampled_out == 0) ? 0 : -1;
+                break;
+            case picoquic_log_overload_drop:
+                ret = (stats.nb_blocked == 0 && stats.nb_dropped > 0 && stats.nb_sampled_out == 0) ? 0 : -1;
+                break;
+            default:
+                ret = (stats.nb_blocked == 0 && stats.nb_sampled_out > 0) ? 0 : -1;
+                break;
+            }
+            if (ret != 0) {
+                DBG_PRINTF("Policy %d, unexpected counters %d blocked, %d dropped, %d sampled out\n", overload,
+                    (int)stats.nb_blocked, (int)stats.nb_dropped, (int)stats.nb_sampled_out);
+            }
+        }
+    }
+
+    if (F_sink != NULL) {
+        fclose(F_sink);
+    }
+
+    return ret;
+}
+
+/* The log of a QUIC context goes through its writer until the context is freed */
+static int log_writer_quic_test()
+{
+    int ret = 0;
+    log_writer_test_sink_t sink;
+    picoquic_log_writer_stats_t stats;
+    FILE* F_sink = log_writer_test_sink_open(&sink, 1000, 0);
+    picoquic_quic_t* quic = picoquic_create(8, NULL, NULL, NULL, NULL, NULL, NULL,
+        NULL, NULL, NULL, 0, NULL, NULL, NULL, 0, NULL);
+
+    if (F_sink == NULL || quic == NULL || picoquic_get_async_log_stats(quic, &stats) == 0 ||
+        picoquic_set_async_log(quic, F_sink, picoquic_log_overload_block, 0) != 0 || quic->F_log == NULL) {
+        DBG_PRINTF("%s", "Cannot set the asynchronous log\n");
+        ret = -1;
+    } else {
+        for (int i = 0; i < 10; i++) {
+            fprintf((FILE*)quic->F_log, "line %08d %*s\n", i, LOG_WRITER_TEST_LINE_LENGTH - 15, "x");
+        }
+        if (picoquic_get_async_log_stats(quic, &stats) != 0 || stats.nb_records != 10) {
+            DBG_PRINTF("%s", "Unexpected statistics\n");
+            ret = -1;
+        }
+    }
+
+    if (quic != NULL) {
+        picoquic_free(quic);
+    }
+    if (ret == 0 && (sink.error || sink.nb_lines != 10)) {
+        DBG_PRINTF("%s", "The log was not written when the context was freed\n");
+        ret = -1;
+    }
+    if (F_sink != NULL) {
+        fclose(F_sink);
+    }
+
+    return ret;
+}
+
+int log_writer_test()
+{
+    /* A slow sink blocks the producer, stalled sinks make it drop or sample */
+    int ret = log_writer_policy_test(picoquic_log_overload_block, 0, 2000, 0);
+
+    if (ret == 0) {
+        ret = log_writer_policy_test(picoquic_log_overload_drop, 0, 0, 1);
+    }
+
+    if (ret == 0) {
+        ret = log_writer_policy_test(picoquic_log_overload_sample, 4, 0, 1);
+    }
+
+    if (ret == 0) {
+        ret = log_writer_quic_test();
+    }
+
+    return ret;
+}
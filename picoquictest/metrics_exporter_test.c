@@ -0,0 +1,221 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "picoquic_internal.h"
+#include "metrics_exporter.h"
+
+#define METRICS_TEST_NB_RECORDS 200
+#define METRICS_TEST_SOCKET "metrics_exporter_test.sock"
+#define METRICS_TEST_FILE "metrics_exporter_test.bin"
+
+/* Record i holds i + 1 bytes of value i, so that records of all sizes and alignments are exported */
+static int metrics_test_push(picoquic_metrics_exporter_t* exporter, int first, int last)
+{
+    uint8_t data[METRICS_TEST_NB_RECORDS];
+
+    for (int i = first; i < last; i++) {
+        memset(data, i, (size_t)(i + 1));
+        if (picoquic_metrics_exporter_push(exporter, (uint16_t)(i & 3), data, (size_t)(i + 1), 1000 + i) != 0) {
+            DBG_PRINTF("Could not push record %d\n", i);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* Checks the records of a batch and returns the number of the next expected one, or -1 */
+static int metrics_test_check_batch(const uint8_t* batch, size_t length, int next_record)
+{
+    picoquic_metrics_batch_header_t header;
+    size_t offset = sizeof(picoquic_metrics_batch_header_t);
+
+    memcpy(&header, batch, sizeof(header));
+    if (header.magic != PICOQUIC_METRICS_BATCH_MAGIC || header.version != PICOQUIC_METRICS_VERSION ||
+        header.length != length || header.nb_records == 0) {
+        DBG_PRINTF("Invalid batch header, length %d\n", (int)header.length);
+        return -1;
+    }
+
+    for (int i = 0; i < header.nb_records; i++, next_record++) {
+        picoquic_metrics_record_header_t record;
+
+        if (offset + sizeof(record) > length) {
+            DBG_PRINTF("Record %d past the end of the batch\n", next_record);
+            return -1;
+        }
+        memcpy(&record, batch + offset, sizeof(record));
+        offset += sizeof(record);
+        if (record.type != (next_record & 3) || record.length != next_record + 1 ||
+            record.timestamp != (uint64_t)(1000 + next_record) || offset + record.length > length) {
+            DBG_PRINTF("Invalid header for record %d\n", next_record);
+            return -1;
+        }
+        for (int j = 0; j < record.length; j++) {
+            if (batch[offset + j] != (uint8_t)next_record) {
+                DBG_PRINTF("Invalid content for record %d\n", next_record);
+                return -1;
+            }
+        }
+        offset += (record.length + 7) & ~7;
+    }
+
+    return next_record;
+}
+
+static int metrics_exporter_socket_test()
+{
+    int ret = 0;
+    int next_record = 0;
+    int nb_batches = 0;
+    uint8_t buffer[PICOQUIC_METRICS_BATCH_MAX];
+    struct sockaddr_un addr;
+    picoquic_metrics_exporter_t* exporter = NULL;
+    int fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, METRICS_TEST_SOCKET);
+    unlink(METRICS_TEST_SOCKET);
+
+    if (fd < 0 || bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        DBG_PRINTF("%s", "Cannot bind the collector socket\n");
+        ret = -1;
+    } else if ((exporter = picoquic_metrics_exporter_create("unix:" METRICS_TEST_SOCKET)) == NULL) {
+        DBG_PRINTF("%s", "Cannot create the exporter\n");
+        ret = -1;
+    }
+
+    /* Nothing is sent before the batch is full or old enough */
+    if (ret == 0) {
+        ret = metrics_test_push(exporter, 0, 10);
+    }
+    if (ret == 0 && picoquic_metrics_exporter_flush(exporter, 0, 0) != 0) {
+        DBG_PRINTF("%s", "A partial batch was sent too early\n");
+        ret = -1;
+    }
+    if (ret == 0) {
+        ret = metrics_test_push(exporter, 10, METRICS_TEST_NB_RECORDS);
+    }
+    if (ret == 0) {
+        /* The records fill a batch, the remaining ones are sent once they waited long enough */
+        nb_batches = picoquic_metrics_exporter_flush(exporter, PICOQUIC_METRICS_FLUSH_DELAY - 1, 0);
+        if (nb_batches != 1) {
+            DBG_PRINTF("Expected a full batch, got %d\n", nb_batches);
+            ret = -1;
+        } else if (picoquic_metrics_exporter_flush(exporter, 2 * PICOQUIC_METRICS_FLUSH_DELAY - 2, 0) != 0 ||
+            picoquic_metrics_exporter_flush(exporter, 2 * PICOQUIC_METRICS_FLUSH_DELAY - 1, 0) != 1) {
+            DBG_PRINTF("%s", "The last batch was not sent after the flush delay\n");
+            ret = -1;
+        } else {
+            nb_batches++;
+        }
+    }
+
+    for (int i = 0; ret == 0 && i < nb_batches; i++) {
+        ssize_t length = recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (length <= 0) {
+            DBG_PRINTF("Batch %d was not received\n", i);
+            ret = -1;
+        } else if ((next_record = metrics_test_check_batch(buffer, (size_t)length, next_record)) < 0) {
+            ret = -1;
+        }
+    }
+
+    if (ret == 0 && (next_record != METRICS_TEST_NB_RECORDS || picoquic_metrics_exporter_get_dropped(exporter) != 0)) {
+        DBG_PRINTF("Received %d records, %d dropped\n", next_record, (int)picoquic_metrics_exporter_get_dropped(exporter));
+        ret = -1;
+    }
+
+    picoquic_metrics_exporter_free(exporter);
+    if (fd >= 0) {
+        close(fd);
+    }
+    unlink(METRICS_TEST_SOCKET);
+
+    return ret;
+}
+
+static int metrics_exporter_file_test()
+{
+    int ret = 0;
+    int next_record = 0;
+    int fd = -1;
+    picoquic_metrics_file_header_t header;
+    uint8_t* map = MAP_FAILED;
+    size_t map_length = 0;
+    picoquic_metrics_exporter_t* exporter = picoquic_metrics_exporter_create("file:" METRICS_TEST_FILE);
+
+    if (exporter == NULL) {
+        DBG_PRINTF("%s", "Cannot create the exporter\n");
+        ret = -1;
+    } else {
+        ret = metrics_test_push(exporter, 0, METRICS_TEST_NB_RECORDS);
+        if (ret == 0 && picoquic_metrics_exporter_flush(exporter, 0, 1) <= 0) {
+            DBG_PRINTF("%s", "Forced flush did not write any batch\n");
+            ret = -1;
+        }
+    }
+
+    /* Read the file as a collector would, while the exporter still has it mapped */
+    if (ret == 0 && (fd = open(METRICS_TEST_FILE, O_RDONLY)) < 0) {
+        ret = -1;
+    }
+    if (ret == 0 && read(fd, &header, sizeof(header)) != sizeof(header)) {
+        ret = -1;
+    }
+    if (ret == 0 && (header.magic != PICOQUIC_METRICS_FILE_MAGIC || header.capacity != PICOQUIC_METRICS_FILE_SIZE)) {
+        DBG_PRINTF("%s", "Invalid file header\n");
+        ret = -1;
+    }
+    if (ret == 0) {
+        map_length = header.header_length + header.capacity;
+        map = (uint8_t*)mmap(NULL, map_length, PROT_READ, MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED) {
+            ret = -1;
+        }
+    }
+    if (ret == 0) {
+        uint64_t offset = 0;
+        while (ret == 0 && offset < header.write_offset) {
+            picoquic_metrics_batch_header_t batch;
+            memcpy(&batch, map + header.header_length + offset, sizeof(batch));
+            next_record = metrics_test_check_batch(map + header.header_length + offset, batch.length, next_record);
+            if (next_record < 0) {
+                ret = -1;
+            } else {
+                offset += batch.length;
+            }
+        }
+        if (ret == 0 && (offset != header.write_offset || next_record != METRICS_TEST_NB_RECORDS)) {
+            DBG_PRINTF("Read %d records up to offset %d\n", next_record, (int)offset);
+            ret = -1;
+        }
+    }
+
+    if (map != MAP_FAILED) {
+        munmap(map, map_length);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    picoquic_metrics_exporter_free(exporter);
+    unlink(METRICS_TEST_FILE);
+
+    return ret;
+}
+
+int metrics_exporter_test()
+{
+    int ret = metrics_exporter_socket_test();
+
+    if (ret == 0) {
+        ret = metrics_exporter_file_test();
+    }
+
+    return ret;
+}
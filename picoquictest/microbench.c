@@ -35,6 +35,66 @@ uint64_t get_set_api_cnx_fields_loop(picoquic_cnx_t *cnx) {
     return sum;
 }
 
+/* What a pluglet calling get_cnx/set_cnx with constant keys becomes once the keys are resolved at load time */
+uint64_t get_set_specialized_cnx_fields_loop(picoquic_cnx_t *cnx) {
+    uint64_t sum = 0;
+    const getset_field_t *start_time = getset_cnx_field(AK_CNX_START_TIME);
+    const getset_field_t *latest_progress_time = getset_cnx_field(AK_CNX_LATEST_PROGRESS_TIME);
+    for (uint64_t i = 0; i < 500000000; i++) {
+        sum += getset_field_load(cnx, start_time);
+        sum += getset_field_load(cnx, latest_progress_time);
+        getset_field_store(cnx, start_time, 2 * sum + 3 * i);
+        getset_field_store(cnx, latest_progress_time, 3 * sum / 4 + i);
+    }
+    return sum;
+}
+
+/* What the VM runs once load_elf resolved the constant keys: still helper calls, at the offsets of the fields */
+uint64_t get_set_resolved_cnx_fields_loop(picoquic_cnx_t *cnx) {
+    uint64_t sum = 0;
+    for (uint64_t i = 0; i < 500000000; i++) {
+        sum += getset_load_u64(cnx, offsetof(picoquic_cnx_t, start_time));
+        sum += getset_load_u64(cnx, offsetof(picoquic_cnx_t, latest_progress_time));
+        getset_store_u64(cnx, offsetof(picoquic_cnx_t, start_time), 0, 2 * sum + 3 * i);
+        getset_store_u64(cnx, offsetof(picoquic_cnx_t, latest_progress_time), 0, 3 * sum / 4 + i);
+    }
+    return sum;
+}
+
+/* The path fields read by a multipath scheduler for each path, one call per field or one call for all */
+#define MICROBENCH_PATH_FIELDS_ITERATIONS 50000000
+
+static const access_key_t microbench_path_keys[] = {
+    AK_PATH_CHALLENGE_VERIFIED, AK_PATH_CHALLENGE_TIME, AK_PATH_RETRANSMIT_TIMER, AK_PATH_CHALLENGE_REPEAT_COUNT,
+    AK_PATH_CWIN, AK_PATH_BYTES_IN_TRANSIT, AK_PATH_PING_RECEIVED, AK_PATH_NB_PKT_SENT, AK_PATH_SEND_MTU,
+    AK_PATH_BANDWIDTH_ESTIMATE
+};
+#define MICROBENCH_NB_PATH_KEYS (sizeof(microbench_path_keys) / sizeof(microbench_path_keys[0]))
+
+uint64_t get_path_fields_single_loop(picoquic_path_t *path) {
+    uint64_t sum = 0;
+    for (uint64_t i = 0; i < MICROBENCH_PATH_FIELDS_ITERATIONS; i++) {
+        for (size_t k = 0; k < MICROBENCH_NB_PATH_KEYS; k++) {
+            sum += get_path(path, microbench_path_keys[k], 0);
+        }
+        path->cwin = sum;
+    }
+    return sum;
+}
+
+uint64_t get_path_fields_vectored_loop(picoquic_path_t *path) {
+    uint64_t sum = 0;
+    protoop_arg_t fields[MICROBENCH_NB_PATH_KEYS];
+    for (uint64_t i = 0; i < MICROBENCH_PATH_FIELDS_ITERATIONS; i++) {
+        get_path_fields(path, microbench_path_keys, MICROBENCH_NB_PATH_KEYS, fields);
+        for (size_t k = 0; k < MICROBENCH_NB_PATH_KEYS; k++) {
+            sum += fields[k];
+        }
+        path->cwin = sum;
+    }
+    return sum;
+}
+
 #define SIMPLE_FOR_LOOP ((protoop_id_t) { .id = "simple_for_loop", .hash = hash_value_str("simple_for_loop") })
 #define GET_SET_CNX_FIELDS_LOOP ((protoop_id_t) { .id = "get_set_cnx_fields_loop", .hash = hash_value_str("get_set_cnx_fields_loop") })
 
@@ -103,6 +163,56 @@ int microbench_plugin_run_test() {
     uint64_t gs_api_native = (tv_gs_api_end.tv_sec - tv_gs_api_start.tv_sec) * 1000000 + (tv_gs_api_end.tv_usec - tv_gs_api_start.tv_usec);
     fprintf(stderr, "Native API gs: %" PRIu64 " us, sum is %" PRIu64 "\n", gs_api_native, sum);
 
+    struct timeval tv_gs_spec_start;
+    struct timeval tv_gs_spec_end;
+
+    cnx.start_time = 0;
+    cnx.latest_progress_time = 0;
+
+    sum = 0;
+    gettimeofday(&tv_gs_spec_start, NULL);
+    sum += get_set_specialized_cnx_fields_loop(&cnx);
+    gettimeofday(&tv_gs_spec_end, NULL);
+
+    uint64_t gs_spec_native = (tv_gs_spec_end.tv_sec - tv_gs_spec_start.tv_sec) * 1000000 + (tv_gs_spec_end.tv_usec - tv_gs_spec_start.tv_usec);
+    fprintf(stderr, "Native specialized gs: %" PRIu64 " us, sum is %" PRIu64 "\n", gs_spec_native, sum);
+
+    struct timeval tv_gs_res_start;
+    struct timeval tv_gs_res_end;
+
+    cnx.start_time = 0;
+    cnx.latest_progress_time = 0;
+
+    sum = 0;
+    gettimeofday(&tv_gs_res_start, NULL);
+    sum += get_set_resolved_cnx_fields_loop(&cnx);
+    gettimeofday(&tv_gs_res_end, NULL);
+
+    uint64_t gs_res_native = (tv_gs_res_end.tv_sec - tv_gs_res_start.tv_sec) * 1000000 + (tv_gs_res_end.tv_usec - tv_gs_res_start.tv_usec);
+    fprintf(stderr, "Native resolved gs: %" PRIu64 " us, sum is %" PRIu64 "\n", gs_res_native, sum);
+
+    picoquic_path_t path = { 0 };
+    path.send_mtu = PICOQUIC_INITIAL_MTU_IPV4;
+    struct timeval tv_pf_start;
+    struct timeval tv_pf_end;
+
+    gettimeofday(&tv_pf_start, NULL);
+    sum = get_path_fields_single_loop(&path);
+    gettimeofday(&tv_pf_end, NULL);
+
+    uint64_t pf_single = (tv_pf_end.tv_sec - tv_pf_start.tv_sec) * 1000000 + (tv_pf_end.tv_usec - tv_pf_start.tv_usec);
+    fprintf(stderr, "Native %d get_path calls: %" PRIu64 " us, sum is %" PRIu64 "\n", (int) MICROBENCH_NB_PATH_KEYS, pf_single, sum);
+
+    path.cwin = 0;
+    path.send_mtu = PICOQUIC_INITIAL_MTU_IPV4;
+    gettimeofday(&tv_pf_start, NULL);
+    sum = get_path_fields_vectored_loop(&path);
+    gettimeofday(&tv_pf_end, NULL);
+
+    uint64_t pf_vectored = (tv_pf_end.tv_sec - tv_pf_start.tv_sec) * 1000000 + (tv_pf_end.tv_usec - tv_pf_start.tv_usec);
+    fprintf(stderr, "Native get_path_fields call: %" PRIu64 " us, sum is %" PRIu64 ", %" PRIu64 " ns saved per call site\n",
+        pf_vectored, sum, (pf_single > pf_vectored) ? (pf_single - pf_vectored) * 1000 / MICROBENCH_PATH_FIELDS_ITERATIONS : 0);
+
     ret = plugin_insert_plugin(&cnx, "plugins/microbench/microbench.plugin");
     if (ret) {
         fprintf(stderr, "Failed to insert microbench plugin!\n");
@@ -0,0 +1,382 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <elf.h>
+#include "picoquic_internal.h"
+#include "getset.h"
+#include "native_pluglet.h"
+
+#ifndef EM_BPF
+#define EM_BPF 247
+#endif
+
+#define NATIVE_TEST_MAX_INSTS 16
+#define NATIVE_TEST_ELF_MAX 2048
+
+typedef struct st_native_test_inst_t {
+    uint8_t opcode;
+    uint8_t regs;
+    int16_t offset;
+    int32_t imm;
+    const char *helper; /* Symbol the instruction is relocated to, if any */
+} native_test_inst_t;
+
+typedef struct st_native_test_case_t {
+    const char *name;
+    int lowered; /* Expected to run without the VM */
+    int nb_insts;
+    native_test_inst_t insts[NATIVE_TEST_MAX_INSTS];
+} native_test_case_t;
+
+#define NATIVE_TEST_REGS(dst, src) (uint8_t) ((dst) | ((src) << 4))
+#define NATIVE_TEST_MOV64_IMM(dst, imm) { 0xb7, NATIVE_TEST_REGS(dst, 0), 0, imm, NULL }
+#define NATIVE_TEST_MOV32_IMM(dst, imm) { 0xb4, NATIVE_TEST_REGS(dst, 0), 0, imm, NULL }
+#define NATIVE_TEST_MOV64_REG(dst, src) { 0xbf, NATIVE_TEST_REGS(dst, src), 0, 0, NULL }
+#define NATIVE_TEST_ADD64_IMM(dst, imm) { 0x07, NATIVE_TEST_REGS(dst, 0), 0, imm, NULL }
+#define NATIVE_TEST_MUL64_IMM(dst, imm) { 0x27, NATIVE_TEST_REGS(dst, 0), 0, imm, NULL }
+#define NATIVE_TEST_DIV64_IMM(dst, imm) { 0x37, NATIVE_TEST_REGS(dst, 0), 0, imm, NULL }
+#define NATIVE_TEST_LDDW(dst, imm_lo, imm_hi) { 0x18, NATIVE_TEST_REGS(dst, 0), 0, imm_lo, NULL }, { 0, 0, 0, imm_hi, NULL }
+#define NATIVE_TEST_LDXDW(dst, src, off) { 0x79, NATIVE_TEST_REGS(dst, src), off, 0, NULL }
+#define NATIVE_TEST_JA(off) { 0x05, 0, off, 0, NULL }
+#define NATIVE_TEST_CALL(helper) { 0x85, 0, 0, -1, helper }
+#define NATIVE_TEST_EXIT { 0x95, 0, 0, 0, NULL }
+
+/* A helper only known by the test lookup */
+static uint64_t native_test_add(uint64_t r1, uint64_t r2, uint64_t r3, uint64_t r4, uint64_t r5)
+{
+    (void) r1;
+    (void) r4;
+    (void) r5;
+    return r2 + r3;
+}
+
+static void *native_test_lookup(const char *name)
+{
+    if (strcmp(name, "get_cnx") == 0) {
+        return (void *) get_cnx;
+    } else if (strcmp(name, "set_cnx") == 0) {
+        return (void *) set_cnx;
+    } else if (strcmp(name, "get_path") == 0) {
+        return (void *) get_path;
+    } else if (strcmp(name, "set_path") == 0) {
+        return (void *) set_path;
+    } else if (strcmp(name, "getset_load_u64") == 0) {
+        return (void *) getset_load_u64;
+    } else if (strcmp(name, "getset_store_u64") == 0) {
+        return (void *) getset_store_u64;
+    } else if (strcmp(name, "getset_get_input") == 0) {
+        return (void *) getset_get_input;
+    } else if (strcmp(name, "native_test_add") == 0) {
+        return (void *) native_test_add;
+    }
+    return NULL;
+}
+
+/* Writes an eBPF object holding the instructions, as clang does for a pluglet, and returns its length */
+static size_t native_test_elf(uint64_t *buffer, const native_test_case_t *tc)
+{
+    uint8_t *elf = (uint8_t *) buffer;
+    Elf64_Ehdr *ehdr = (Elf64_Ehdr *) elf;
+    size_t text_off = sizeof(Elf64_Ehdr);
+    size_t rel_off = text_off + 8 * tc->nb_insts;
+    size_t nb_rels = 0;
+    size_t sym_off;
+    size_t str_off;
+    size_t str_len = 1;
+    size_t shdr_off;
+    Elf64_Shdr *shdrs;
+
+    memset(elf, 0, NATIVE_TEST_ELF_MAX);
+    for (int i = 0; i < tc->nb_insts; i++) {
+        const native_test_inst_t *inst = &tc->insts[i];
+        uint8_t *p = elf + text_off + 8 * i;
+        p[0] = inst->opcode;
+        p[1] = inst->regs;
+        memcpy(p + 2, &inst->offset, sizeof(inst->offset));
+        memcpy(p + 4, &inst->imm, sizeof(inst->imm));
+        if (inst->helper != NULL) {
+            nb_rels++;
+        }
+    }
+
+    /* One symbol and one relocation for each call */
+    sym_off = rel_off + nb_rels * sizeof(Elf64_Rel);
+    str_off = sym_off + (nb_rels + 1) * sizeof(Elf64_Sym);
+    nb_rels = 0;
+    for (int i = 0; i < tc->nb_insts; i++) {
+        if (tc->insts[i].helper != NULL) {
+            Elf64_Rel *rel = (Elf64_Rel *) (elf + rel_off) + nb_rels;
+            Elf64_Sym *sym = (Elf64_Sym *) (elf + sym_off) + nb_rels + 1;
+            nb_rels++;
+            rel->r_offset = 8 * i;
+            rel->r_info = ELF64_R_INFO(nb_rels, 10);
+            sym->st_name = (Elf64_Word) str_len;
+            sym->st_info = ELF64_ST_INFO(STB_GLOBAL, STT_NOTYPE);
+            strcpy((char *) elf + str_off + str_len, tc->insts[i].helper);
+            str_len += strlen(tc->insts[i].helper) + 1;
+        }
+    }
+    shdr_off = (str_off + str_len + 7) & ~(size_t) 7;
+    shdrs = (Elf64_Shdr *) (elf + shdr_off);
+
+    memcpy(ehdr->e_ident, ELFMAG, SELFMAG);
+    ehdr->e_ident[EI_CLASS] = ELFCLASS64;
+    ehdr->e_ident[EI_DATA] = ELFDATA2LSB;
+    ehdr->e_ident[EI_VERSION] = EV_CURRENT;
+    ehdr->e_type = ET_REL;
+    ehdr->e_machine = EM_BPF;
+    ehdr->e_version = EV_CURRENT;
+    ehdr->e_ehsize = sizeof(Elf64_Ehdr);
+    ehdr->e_shentsize = sizeof(Elf64_Shdr);
+    ehdr->e_shoff = shdr_off;
+    ehdr->e_shnum = 5;
+    /* 1: .text, 2: .rel.text, 3: .symtab, 4: .strtab */
+    shdrs[1].sh_type = SHT_PROGBITS;
+    shdrs[1].sh_flags = SHF_ALLOC | SHF_EXECINSTR;
+    shdrs[1].sh_offset = text_off;
+    shdrs[1].sh_size = 8 * tc->nb_insts;
+    shdrs[2].sh_type = SHT_REL;
+    shdrs[2].sh_offset = rel_off;
+    shdrs[2].sh_size = nb_rels * sizeof(Elf64_Rel);
+    shdrs[2].sh_link = 3;
+    shdrs[2].sh_info = 1;
+    shdrs[3].sh_type = SHT_SYMTAB;
+    shdrs[3].sh_offset = sym_off;
+    shdrs[3].sh_size = (nb_rels + 1) * sizeof(Elf64_Sym);
+    shdrs[3].sh_link = 4;
+    shdrs[4].sh_type = SHT_STRTAB;
+    shdrs[4].sh_offset = str_off;
+    shdrs[4].sh_size = str_len;
+
+    return shdr_off + 5 * sizeof(Elf64_Shdr);
+}
+
+static const native_test_case_t native_test_cases[] = {
+    { "return constant", 1, 2, { NATIVE_TEST_MOV64_IMM(0, 7), NATIVE_TEST_EXIT } },
+    { "fold constant", 1, 3, { NATIVE_TEST_MOV64_IMM(0, 6), NATIVE_TEST_MUL64_IMM(0, 7), NATIVE_TEST_EXIT } },
+    { "fold 32 bits", 1, 2, { NATIVE_TEST_MOV32_IMM(0, -1), NATIVE_TEST_EXIT } },
+    { "return argument", 1, 3, { NATIVE_TEST_MOV64_REG(0, 1), NATIVE_TEST_ADD64_IMM(0, 8), NATIVE_TEST_EXIT } },
+    { "disable congestion control", 1, 11, {
+        NATIVE_TEST_MOV64_IMM(2, 0), NATIVE_TEST_MOV64_IMM(3, 0), NATIVE_TEST_MOV64_REG(6, 1),
+        NATIVE_TEST_CALL("get_cnx"),
+        NATIVE_TEST_MOV64_REG(1, 0), NATIVE_TEST_MOV64_IMM(2, AK_PATH_CWIN), NATIVE_TEST_MOV64_IMM(3, 0),
+        NATIVE_TEST_MOV64_IMM(4, -1), NATIVE_TEST_CALL("set_path"), NATIVE_TEST_MOV64_IMM(0, 0), NATIVE_TEST_EXIT } },
+    { "set smoothed rtt", 1, 11, {
+        NATIVE_TEST_MOV64_IMM(2, 0), NATIVE_TEST_MOV64_IMM(3, 0), NATIVE_TEST_MOV64_REG(6, 1),
+        NATIVE_TEST_CALL("get_cnx"),
+        NATIVE_TEST_MOV64_REG(1, 0), NATIVE_TEST_MOV64_IMM(2, AK_PATH_SMOOTHED_RTT), NATIVE_TEST_MOV64_IMM(3, 0),
+        NATIVE_TEST_MOV64_IMM(4, 25000), NATIVE_TEST_CALL("set_path"), NATIVE_TEST_MOV64_IMM(0, 0), NATIVE_TEST_EXIT } },
+    { "call helper", 1, 5, {
+        NATIVE_TEST_MOV64_IMM(2, 5), NATIVE_TEST_MOV64_IMM(3, 7), NATIVE_TEST_CALL("native_test_add"),
+        NATIVE_TEST_ADD64_IMM(0, 1), NATIVE_TEST_EXIT } },
+    { "relocated lddw", 0, 3, { { 0x18, 0, 0, 0, "native_test_add" }, { 0, 0, 0, 0, NULL }, NATIVE_TEST_EXIT } },
+    { "jump", 0, 3, { NATIVE_TEST_MOV64_IMM(0, 1), NATIVE_TEST_JA(0), NATIVE_TEST_EXIT } },
+    { "memory load", 0, 2, { NATIVE_TEST_LDXDW(0, 1, 0), NATIVE_TEST_EXIT } },
+    { "stack", 0, 2, { NATIVE_TEST_MOV64_REG(0, 10), NATIVE_TEST_EXIT } },
+    { "division", 0, 3, { NATIVE_TEST_MOV64_IMM(0, 6), NATIVE_TEST_DIV64_IMM(0, 2), NATIVE_TEST_EXIT } },
+    { "unrelocated call", 0, 2, { { 0x85, 0, 0, 1, NULL }, NATIVE_TEST_EXIT } },
+    { "unknown helper", 0, 2, { NATIVE_TEST_CALL("native_test_unknown"), NATIVE_TEST_EXIT } },
+    { "undefined result", 0, 1, { NATIVE_TEST_EXIT } },
+    { "code after exit", 0, 3, { NATIVE_TEST_MOV64_IMM(0, 1), NATIVE_TEST_EXIT, NATIVE_TEST_EXIT } }
+};
+
+#define NB_NATIVE_TEST_CASES (sizeof(native_test_cases) / sizeof(native_test_cases[0]))
+
+/* Checks which pluglets are lowered, and that the lowered ones behave as in the VM */
+int native_pluglet_test()
+{
+    int ret = 0;
+    uint64_t buffer[NATIVE_TEST_ELF_MAX / sizeof(uint64_t)];
+    native_pluglet_t *lowered[NB_NATIVE_TEST_CASES];
+    picoquic_cnx_t *cnx = (picoquic_cnx_t *) calloc(1, sizeof(picoquic_cnx_t));
+    picoquic_path_t *path = (picoquic_path_t *) calloc(1, sizeof(picoquic_path_t));
+
+    memset(lowered, 0, sizeof(lowered));
+    if (cnx == NULL || path == NULL) {
+        DBG_PRINTF("%s", "Cannot allocate the structures\n");
+        ret = -1;
+    }
+
+    for (size_t i = 0; ret == 0 && i < NB_NATIVE_TEST_CASES; i++) {
+        size_t elf_len = native_test_elf(buffer, &native_test_cases[i]);
+        lowered[i] = native_pluglet_lower(buffer, elf_len, native_test_lookup);
+        if ((lowered[i] != NULL) != native_test_cases[i].lowered) {
+            DBG_PRINTF("Pluglet \"%s\" is %s lowered\n", native_test_cases[i].name, lowered[i] ? "wrongly" : "not");
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        /* A truncated object is not read past its end */
+        size_t elf_len = native_test_elf(buffer, &native_test_cases[0]);
+        if (native_pluglet_lower(buffer, elf_len - sizeof(Elf64_Shdr), native_test_lookup) != NULL) {
+            DBG_PRINTF("%s", "Truncated object is lowered\n");
+            ret = -1;
+        }
+    }
+
+    if (ret == 0 && (lowered[0]->kind != native_pluglet_constant || native_pluglet_run(lowered[0], cnx) != 7 ||
+        lowered[1]->kind != native_pluglet_constant || lowered[1]->constant != 42 ||
+        lowered[2]->kind != native_pluglet_constant || lowered[2]->constant != 0xffffffff)) {
+        DBG_PRINTF("%s", "Constant pluglets are not folded\n");
+        ret = -1;
+    }
+
+    if (ret == 0 && (lowered[3]->kind != native_pluglet_steps || native_pluglet_run(lowered[3], cnx) != (uint64_t) cnx + 8)) {
+        DBG_PRINTF("%s", "Pluglet returning its argument differs\n");
+        ret = -1;
+    }
+
+    if (ret == 0) {
+        /* The input and the window are accessed directly */
+        cnx->protoop_inputc = 1;
+        cnx->protoop_inputv[0] = (protoop_arg_t) path;
+        path->cwin = 1500;
+        if (lowered[4]->kind != native_pluglet_steps || native_pluglet_run(lowered[4], cnx) != 0 || path->cwin != UINT64_MAX) {
+            DBG_PRINTF("Disabling congestion control sets the window to %" PRIu64 "\n", path->cwin);
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        /* As set_path, a lowered store disarms the loss timers computed from the former RTT */
+        path->pkt_ctx[picoquic_packet_context_application].loss_timer_armed = 1;
+        if (lowered[5]->kind != native_pluglet_steps || native_pluglet_run(lowered[5], cnx) != 0 || path->smoothed_rtt != 25000 ||
+            path->pkt_ctx[picoquic_packet_context_application].loss_timer_armed) {
+            DBG_PRINTF("Setting the smoothed RTT gives %" PRIu64 ", loss timer armed %d\n", path->smoothed_rtt,
+                path->pkt_ctx[picoquic_packet_context_application].loss_timer_armed);
+            ret = -1;
+        }
+    }
+
+    if (ret == 0 && native_pluglet_run(lowered[6], cnx) != 13) {
+        DBG_PRINTF("%s", "Helper call returns a wrong value\n");
+        ret = -1;
+    }
+
+    for (size_t i = 0; i < NB_NATIVE_TEST_CASES; i++) {
+        free(lowered[i]);
+    }
+    free(path);
+    free(cnx);
+
+    return ret;
+}
+
+/* The lowered field is whether the getset calls with a constant key are resolved */
+static const native_test_case_t native_resolve_cases[] = {
+    { "copy smoothed rtt", 1, 13, {
+        NATIVE_TEST_MOV64_REG(6, 1), NATIVE_TEST_MOV64_IMM(2, AK_CNX_INPUT), NATIVE_TEST_MOV64_IMM(3, 0),
+        NATIVE_TEST_CALL("get_cnx"),
+        NATIVE_TEST_MOV64_REG(1, 0), NATIVE_TEST_MOV32_IMM(2, AK_PATH_SMOOTHED_RTT), NATIVE_TEST_CALL("get_path"),
+        NATIVE_TEST_MOV64_REG(1, 6), NATIVE_TEST_MOV64_REG(4, 0), NATIVE_TEST_MOV64_IMM(2, AK_CNX_DATA_SENT),
+        NATIVE_TEST_CALL("set_cnx"), NATIVE_TEST_MOV64_IMM(0, 0), NATIVE_TEST_EXIT } },
+    { "field after a jump", 1, 10, {
+        NATIVE_TEST_MOV64_IMM(2, AK_CNX_INPUT), NATIVE_TEST_MOV64_IMM(3, 0), NATIVE_TEST_CALL("get_cnx"),
+        NATIVE_TEST_JA(1), NATIVE_TEST_EXIT,
+        NATIVE_TEST_MOV64_REG(1, 0), NATIVE_TEST_MOV64_IMM(2, AK_PATH_CWIN), NATIVE_TEST_LDXDW(5, 1, 0),
+        NATIVE_TEST_CALL("get_path"), NATIVE_TEST_EXIT } },
+    { "key before a jump target", 0, 4, {
+        NATIVE_TEST_MOV64_IMM(2, AK_PATH_CWIN), NATIVE_TEST_JA(0), NATIVE_TEST_CALL("get_path"), NATIVE_TEST_EXIT } },
+    { "key read before the call", 0, 4, {
+        NATIVE_TEST_MOV64_IMM(2, AK_CNX_START_TIME), NATIVE_TEST_MOV64_REG(4, 2), NATIVE_TEST_CALL("set_cnx"),
+        NATIVE_TEST_EXIT } },
+    { "set_path disarming the timers", 0, 4, {
+        NATIVE_TEST_MOV64_IMM(2, AK_PATH_SMOOTHED_RTT), NATIVE_TEST_MOV64_IMM(4, 25000), NATIVE_TEST_CALL("set_path"),
+        NATIVE_TEST_EXIT } },
+    { "field of one byte", 0, 3, {
+        NATIVE_TEST_MOV64_IMM(2, AK_PATH_CHALLENGE_REPEAT_COUNT), NATIVE_TEST_CALL("get_path"), NATIVE_TEST_EXIT } },
+    { "key not a plain field", 0, 3, {
+        NATIVE_TEST_MOV64_IMM(2, AK_CNX_PATH), NATIVE_TEST_CALL("get_cnx"), NATIVE_TEST_EXIT } },
+    { "key not constant", 0, 3, {
+        NATIVE_TEST_LDXDW(2, 1, 0), NATIVE_TEST_CALL("get_cnx"), NATIVE_TEST_EXIT } }
+};
+
+#define NB_NATIVE_RESOLVE_CASES (sizeof(native_resolve_cases) / sizeof(native_resolve_cases[0]))
+
+/* The symbol the instruction at pc of the object is relocated to, "" if there is none */
+static const char *native_test_relocation(const uint8_t *elf, size_t pc)
+{
+    const Elf64_Shdr *shdrs = (const Elf64_Shdr *) (elf + ((const Elf64_Ehdr *) elf)->e_shoff);
+    const Elf64_Rel *rels = (const Elf64_Rel *) (elf + shdrs[2].sh_offset);
+    const Elf64_Sym *syms = (const Elf64_Sym *) (elf + shdrs[3].sh_offset);
+
+    for (size_t i = 0; i < shdrs[2].sh_size / sizeof(Elf64_Rel); i++) {
+        if (rels[i].r_offset == 8 * pc) {
+            return (const char *) elf + shdrs[4].sh_offset + syms[ELF64_R_SYM(rels[i].r_info)].st_name;
+        }
+    }
+    return "";
+}
+
+static int32_t native_test_imm(const uint8_t *elf, size_t pc)
+{
+    const Elf64_Shdr *shdrs = (const Elf64_Shdr *) (elf + ((const Elf64_Ehdr *) elf)->e_shoff);
+    int32_t imm;
+
+    memcpy(&imm, elf + shdrs[1].sh_offset + 8 * pc + 4, sizeof(imm));
+    return imm;
+}
+
+/* Checks which getset calls are resolved before the VM loads the pluglet, and that they access the same fields */
+int native_pluglet_resolve_test()
+{
+    int ret = 0;
+    uint64_t buffer[NATIVE_TEST_ELF_MAX / sizeof(uint64_t)];
+    uint8_t *resolved[NB_NATIVE_RESOLVE_CASES];
+    size_t resolved_len[NB_NATIVE_RESOLVE_CASES];
+    picoquic_cnx_t *cnx = (picoquic_cnx_t *) calloc(1, sizeof(picoquic_cnx_t));
+    picoquic_path_t *path = (picoquic_path_t *) calloc(1, sizeof(picoquic_path_t));
+
+    memset(resolved, 0, sizeof(resolved));
+    if (cnx == NULL || path == NULL) {
+        DBG_PRINTF("%s", "Cannot allocate the structures\n");
+        ret = -1;
+    }
+
+    for (size_t i = 0; ret == 0 && i < NB_NATIVE_RESOLVE_CASES; i++) {
+        size_t elf_len = native_test_elf(buffer, &native_resolve_cases[i]);
+        resolved[i] = (uint8_t *) native_pluglet_resolve_fields(buffer, elf_len, native_test_lookup, &resolved_len[i]);
+        if ((resolved[i] != NULL) != native_resolve_cases[i].lowered) {
+            DBG_PRINTF("Calls of \"%s\" are %s resolved\n", native_resolve_cases[i].name, resolved[i] ? "wrongly" : "not");
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        /* The rewritten object still parses, and runs as the original one */
+        native_pluglet_t *lowered = native_pluglet_lower(resolved[0], resolved_len[0], native_test_lookup);
+
+        cnx->protoop_inputc = 1;
+        cnx->protoop_inputv[0] = (protoop_arg_t) path;
+        path->smoothed_rtt = 25000;
+        if (strcmp(native_test_relocation(resolved[0], 3), "getset_get_input") != 0 ||
+            strcmp(native_test_relocation(resolved[0], 6), "getset_load_u64") != 0 ||
+            strcmp(native_test_relocation(resolved[0], 10), "getset_store_u64") != 0 ||
+            lowered == NULL || native_pluglet_run(lowered, cnx) != 0 || cnx->data_sent != 25000) {
+            DBG_PRINTF("Resolved copy of the smoothed RTT gives %" PRIu64 "\n", cnx->data_sent);
+            ret = -1;
+        }
+        free(lowered);
+    }
+
+    if (ret == 0) {
+        /* The calls on both sides of the jump read the input and the window */
+        path->cwin = 1500;
+        if (strcmp(native_test_relocation(resolved[1], 2), "getset_get_input") != 0 ||
+            strcmp(native_test_relocation(resolved[1], 8), "getset_load_u64") != 0 ||
+            getset_get_input(cnx, (access_key_t) native_test_imm(resolved[1], 0), 0) != (protoop_arg_t) path ||
+            getset_load_u64(path, (uint64_t) native_test_imm(resolved[1], 6)) != 1500) {
+            DBG_PRINTF("%s", "Resolved calls after a jump do not read the fields\n");
+            ret = -1;
+        }
+    }
+
+    for (size_t i = 0; i < NB_NATIVE_RESOLVE_CASES; i++) {
+        free(resolved[i]);
+    }
+    free(path);
+    free(cnx);
+
+    return ret;
+}
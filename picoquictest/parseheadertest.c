@@ -425,7 +425,7 @@ int test_packet_decrypt_one(
         send_buffer, (uint32_t)send_length, (uint32_t)packet_length,
         addr_from,
         current_time, &received_ph, &server_cnx,
-        &consumed, &new_context_created);
+        &consumed, &new_context_created, NULL);
 
     /* verify that decryption matches original value */
     if (decoding_return != expected_return) {
@@ -32,7 +32,16 @@ extern uint64_t picoquic_stress_test_duration; /* In microseconds; defaults to 2
 
 /* List of test functions */
 int picohash_test();
+int cid_table_test();
+int cid_table_bench();
+int metrics_exporter_test();
+int getset_fields_test();
+int getset_metadata_test();
+int slab_memory_test();
+int huge_memory_test();
+int slab_memory_bench();
 int cnxcreation_test();
+int stateless_pool_test();
 int parseheadertest();
 int pn2pn64test();
 int intformattest();
@@ -59,6 +68,10 @@ int tls_api_q2_and_r2_stream_test();
 int tls_api_server_reset_test();
 int tls_api_bad_server_reset_test();
 int sim_link_test();
+int sim_benchmark_test();
+int sim_benchmark_multipath_test();
+int sim_benchmark_fec_test();
+int sim_loss_timer_test();
 int tls_api_very_long_stream_test();
 int tls_api_very_long_max_test();
 int tls_api_very_long_with_err_test();
@@ -67,6 +80,7 @@ int http0dot9_test();
 int tls_api_retry_test();
 int ackrange_test();
 int ack_of_ack_test();
+int ack_range_index_test();
 int tls_api_two_connections_test();
 int cleartext_aead_test();
 int tls_api_multiple_versions_test();
@@ -74,9 +88,12 @@ int varint_test();
 int tls_api_client_losses_test();
 int tls_api_server_losses_test();
 int skip_frame_test();
+int source_symbol_test();
 int ping_pong_test();
 int keep_alive_test();
 int logger_test();
+int binlog_test();
+int log_writer_test();
 int socket_test();
 int ticket_store_test();
 int session_resume_test();
@@ -99,6 +116,14 @@ int bad_certificate_test();
 int set_verify_certificate_callback_test();
 int virtual_time_test();
 int tls_different_params_test();
+int tls_pool_test();
+int hibernation_test();
+int hibernation_bench();
+int native_pluglet_test();
+int native_pluglet_resolve_test();
+int short_header_test();
+int short_header_bench();
+int ack_frequency_test();
 #if 0
 int wrong_tls_version_test();
 #endif
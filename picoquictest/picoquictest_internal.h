@@ -72,6 +72,35 @@ typedef struct st_picoquictest_sim_packet_t {
     uint8_t bytes[PICOQUIC_MAX_PACKET_SIZE];
 } picoquictest_sim_packet_t;
 
+/* A schedule entry changes the rate and the latency of a link from start_time on */
+typedef struct st_picoquictest_sim_link_schedule_t {
+    uint64_t start_time;
+    double data_rate_in_gps;
+    uint64_t microsec_latency;
+} picoquictest_sim_link_schedule_t;
+
+/* Optional behaviours of a link. All the random draws use the link's own
+ * random context, so that a simulation with a given seed is reproducible.
+ * Gilbert-Elliott loss: before each packet, the link moves from the good to
+ * the bad state with probability ge_p_good_to_bad, and back with probability
+ * ge_p_bad_to_good. The packet is then lost with probability ge_loss_good or
+ * ge_loss_bad depending on the state.
+ * Reordering: a packet is held for reorder_delay more microseconds with
+ * probability reorder_probability, letting the next packets overtake it. */
+typedef struct st_picoquictest_sim_link_config_t {
+    double data_rate_in_gps;
+    uint64_t microsec_latency;
+    uint64_t queue_delay_max;
+    double ge_p_good_to_bad;
+    double ge_p_bad_to_good;
+    double ge_loss_good;
+    double ge_loss_bad;
+    double reorder_probability;
+    uint64_t reorder_delay;
+    const picoquictest_sim_link_schedule_t* schedule;
+    size_t nb_schedule;
+} picoquictest_sim_link_config_t;
+
 typedef struct st_picoquictest_sim_link_t {
     uint64_t next_send_time;
     uint64_t queue_time;
@@ -81,8 +110,20 @@ typedef struct st_picoquictest_sim_link_t {
     uint64_t* loss_mask;
     uint64_t packets_dropped;
     uint64_t packets_sent;
+    uint64_t packets_reordered;
     picoquictest_sim_packet_t* first_packet;
     picoquictest_sim_packet_t* last_packet;
+    const picoquictest_sim_link_schedule_t* schedule;
+    size_t nb_schedule;
+    size_t next_schedule;
+    double ge_p_good_to_bad;
+    double ge_p_bad_to_good;
+    double ge_loss_good;
+    double ge_loss_bad;
+    int ge_bad_state;
+    double reorder_probability;
+    uint64_t reorder_delay;
+    uint64_t random_context;
 } picoquictest_sim_link_t;
 
 picoquictest_sim_link_t* picoquictest_sim_link_create(double data_rate_in_gps,
@@ -100,6 +141,79 @@ picoquictest_sim_packet_t* picoquictest_sim_link_dequeue(picoquictest_sim_link_t
 void picoquictest_sim_link_submit(picoquictest_sim_link_t* link, picoquictest_sim_packet_t* packet,
     uint64_t current_time);
 
+void picoquictest_sim_link_configure(picoquictest_sim_link_t* link, const picoquictest_sim_link_config_t* config,
+    uint64_t random_seed);
+
+/* Virtual time topology made of several interfaces between a client and a
+ * server. Each interface has a client address, a link in each direction and
+ * the server address. Packets are routed on the interface of the client
+ * address they are sent from or sent to. The topology behaves as a NAT: an
+ * address change gives a new public port to the client address of an
+ * interface, and the packets sent to the former public address are dropped. */
+
+#define PICOQUICTEST_SIM_MAX_INTERFACES 8
+#define PICOQUICTEST_SIM_MAX_ADDRESS_CHANGES 16
+
+typedef struct st_picoquictest_sim_interface_t {
+    struct sockaddr_in client_addr;
+    struct sockaddr_in public_addr;
+    struct sockaddr_in server_addr;
+    picoquictest_sim_link_t* c_to_s_link;
+    picoquictest_sim_link_t* s_to_c_link;
+} picoquictest_sim_interface_t;
+
+typedef struct st_picoquictest_sim_address_change_t {
+    uint64_t change_time;
+    int interface_index;
+} picoquictest_sim_address_change_t;
+
+typedef struct st_picoquictest_sim_topology_t {
+    int nb_interfaces;
+    picoquictest_sim_interface_t interfaces[PICOQUICTEST_SIM_MAX_INTERFACES];
+    size_t nb_address_changes;
+    size_t next_address_change;
+    picoquictest_sim_address_change_t address_changes[PICOQUICTEST_SIM_MAX_ADDRESS_CHANGES];
+    uint64_t packets_unroutable;
+} picoquictest_sim_topology_t;
+
+picoquictest_sim_topology_t* picoquictest_sim_topology_create(int nb_interfaces,
+    const picoquictest_sim_link_config_t* configs, uint64_t random_seed, uint64_t current_time);
+
+void picoquictest_sim_topology_delete(picoquictest_sim_topology_t* topology);
+
+/* Address changes must be added in chronological order */
+int picoquictest_sim_topology_add_address_change(picoquictest_sim_topology_t* topology,
+    int interface_index, uint64_t change_time);
+
+/* The packet is consumed, even when it cannot be routed */
+int picoquictest_sim_topology_submit(picoquictest_sim_topology_t* topology, picoquictest_sim_packet_t* packet,
+    int from_client, uint64_t current_time);
+
+uint64_t picoquictest_sim_topology_next_arrival(picoquictest_sim_topology_t* topology, uint64_t current_time);
+
+picoquictest_sim_packet_t* picoquictest_sim_topology_dequeue(picoquictest_sim_topology_t* topology,
+    uint64_t current_time, int* to_client);
+
+/* Transfer of a file from the server to the client over a simulated topology,
+ * with a given set of plugins loaded on both sides. */
+
+typedef struct st_picoquictest_sim_benchmark_config_t {
+    int nb_interfaces;
+    picoquictest_sim_link_config_t links[PICOQUICTEST_SIM_MAX_INTERFACES];
+    size_t nb_address_changes;
+    picoquictest_sim_address_change_t address_changes[PICOQUICTEST_SIM_MAX_ADDRESS_CHANGES];
+    const char** plugin_fnames;
+    int nb_plugins;
+    size_t file_size;
+    uint64_t random_seed;
+    uint64_t max_time;
+    /* Optional, called on every connection after each round. A non zero return fails the run. */
+    int (*check_fn)(picoquic_cnx_t* cnx, uint64_t current_time, void* check_ctx);
+    void* check_ctx;
+} picoquictest_sim_benchmark_config_t;
+
+int picoquictest_sim_benchmark_run(const picoquictest_sim_benchmark_config_t* config, uint64_t* completion_time);
+
 int test_one_hp_enc_pair(uint8_t * seqnum, size_t seqnum_len, void * pn_enc, void * pn_dec, uint8_t * sample);
 
 int picoquic_test_compare_files(char const* fname1, char const* fname2);
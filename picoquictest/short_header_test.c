@@ -0,0 +1,313 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "picoquic_internal.h"
+#include "picoquictest_internal.h"
+#include "tls_api.h"
+
+#define SHORT_HEADER_TEST_MAX_ROUNDS 100000
+#define SHORT_HEADER_TEST_DATA_LENGTH 100000
+#define SHORT_HEADER_BENCH_ROUNDS 200
+#define SHORT_HEADER_BENCH_DATAGRAMS (2 * PICOQUIC_INCOMING_BATCH_MAX)
+
+/*
+ * A client sending data to a server. The datagrams of the client can be captured,
+ * instead of delivered at once, to give them to the server together.
+ */
+typedef struct st_short_header_test_ctx_t {
+    picoquic_quic_t* qserver;
+    picoquic_quic_t* qclient;
+    picoquic_cnx_t* cnx_client;
+    struct sockaddr_in client_addr;
+    struct sockaddr_in server_addr;
+    uint64_t simulated_time;
+    uint64_t nb_bytes_received;
+    int fin_received;
+    int nb_captured;
+    uint8_t captured[SHORT_HEADER_BENCH_DATAGRAMS][PICOQUIC_MAX_PACKET_SIZE];
+    picoquic_received_datagram_t datagrams[SHORT_HEADER_BENCH_DATAGRAMS];
+} short_header_test_ctx_t;
+
+static void short_header_test_callback(picoquic_cnx_t* cnx,
+    uint64_t stream_id, uint8_t* bytes, size_t length,
+    picoquic_call_back_event_t fin_or_event, void* callback_ctx)
+{
+    short_header_test_ctx_t* ctx = (short_header_test_ctx_t*)callback_ctx;
+
+    if (ctx != NULL && (fin_or_event == picoquic_callback_no_event || fin_or_event == picoquic_callback_stream_fin)) {
+        ctx->nb_bytes_received += length;
+        ctx->fin_received |= (fin_or_event == picoquic_callback_stream_fin);
+    }
+}
+
+static void short_header_test_addr(struct sockaddr_in* addr, uint32_t host, uint16_t port)
+{
+    memset(addr, 0, sizeof(struct sockaddr_in));
+    addr->sin_family = AF_INET;
+#ifdef _WINDOWS
+    addr->sin_addr.S_un.S_addr = host;
+#else
+    addr->sin_addr.s_addr = host;
+#endif
+    addr->sin_port = port;
+}
+
+/* Delivers the packets of one side to the other, returns 1 if something was sent */
+static int short_header_test_exchange(short_header_test_ctx_t* ctx, picoquic_cnx_t* cnx)
+{
+    int was_active = 0;
+    uint8_t bytes[PICOQUIC_MAX_PACKET_SIZE];
+    size_t length = 0;
+    picoquic_path_t* path = NULL;
+    int new_context_created = 0;
+
+    while (picoquic_prepare_packet(cnx, ctx->simulated_time, bytes, sizeof(bytes), &length, &path) == 0 && length > 0) {
+        was_active = 1;
+        if (cnx == ctx->cnx_client) {
+            (void)picoquic_incoming_packet(ctx->qserver, bytes, (uint32_t)length,
+                (struct sockaddr*)&ctx->client_addr, (struct sockaddr*)&ctx->server_addr, 0,
+                ctx->simulated_time, &new_context_created);
+        } else {
+            (void)picoquic_incoming_packet(ctx->qclient, bytes, (uint32_t)length,
+                (struct sockaddr*)&ctx->server_addr, (struct sockaddr*)&ctx->client_addr, 0,
+                ctx->simulated_time, &new_context_created);
+        }
+    }
+
+    return was_active;
+}
+
+/* Exchanges the packets of both sides, or moves the time to the next wake up when there are none */
+static void short_header_test_round(short_header_test_ctx_t* ctx)
+{
+    picoquic_cnx_t* cnx_server = picoquic_get_first_cnx(ctx->qserver);
+    int was_active = short_header_test_exchange(ctx, ctx->cnx_client);
+
+    if (cnx_server != NULL) {
+        was_active |= short_header_test_exchange(ctx, cnx_server);
+    }
+
+    if (!was_active) {
+        uint64_t next_time = ctx->cnx_client->next_wake_time;
+
+        if (cnx_server != NULL && cnx_server->next_wake_time < next_time) {
+            next_time = cnx_server->next_wake_time;
+        }
+        ctx->simulated_time = (next_time > ctx->simulated_time && next_time != UINT64_MAX) ?
+            next_time : ctx->simulated_time + 1000;
+    }
+}
+
+/* Keeps the short header datagrams of the client, the others are delivered */
+static int short_header_test_capture(short_header_test_ctx_t* ctx, int max_datagrams)
+{
+    size_t length = 0;
+    picoquic_path_t* path = NULL;
+    int new_context_created = 0;
+
+    ctx->nb_captured = 0;
+    while (ctx->nb_captured < max_datagrams &&
+        picoquic_prepare_packet(ctx->cnx_client, ctx->simulated_time, ctx->captured[ctx->nb_captured],
+            PICOQUIC_MAX_PACKET_SIZE, &length, &path) == 0 && length > 0) {
+        if ((ctx->captured[ctx->nb_captured][0] & 0x80) != 0) {
+            (void)picoquic_incoming_packet(ctx->qserver, ctx->captured[ctx->nb_captured], (uint32_t)length,
+                (struct sockaddr*)&ctx->client_addr, (struct sockaddr*)&ctx->server_addr, 0,
+                ctx->simulated_time, &new_context_created);
+            continue;
+        }
+        ctx->datagrams[ctx->nb_captured].bytes = ctx->captured[ctx->nb_captured];
+        ctx->datagrams[ctx->nb_captured].length = (uint32_t)length;
+        ctx->datagrams[ctx->nb_captured].addr_from = (struct sockaddr*)&ctx->client_addr;
+        ctx->datagrams[ctx->nb_captured].addr_to = (struct sockaddr*)&ctx->server_addr;
+        ctx->datagrams[ctx->nb_captured].if_index_to = 0;
+        ctx->nb_captured++;
+    }
+
+    return ctx->nb_captured;
+}
+
+static int short_header_test_start(short_header_test_ctx_t* ctx)
+{
+    int ret = 0;
+
+    memset(ctx, 0, sizeof(short_header_test_ctx_t));
+    short_header_test_addr(&ctx->server_addr, 0x0A000001, 4321);
+    short_header_test_addr(&ctx->client_addr, 0x0A000002, 1234);
+
+    ctx->qclient = picoquic_create(1, NULL, NULL, PICOQUIC_TEST_CERT_STORE, NULL,
+        short_header_test_callback, NULL, NULL, NULL, NULL, ctx->simulated_time, &ctx->simulated_time, NULL, NULL, 0, NULL);
+    ctx->qserver = picoquic_create(1, PICOQUIC_TEST_SERVER_CERT, PICOQUIC_TEST_SERVER_KEY,
+        PICOQUIC_TEST_CERT_STORE, PICOQUIC_TEST_ALPN, short_header_test_callback, ctx, NULL, NULL, NULL,
+        ctx->simulated_time, &ctx->simulated_time, NULL, NULL, 0, NULL);
+
+    if (ctx->qclient == NULL || ctx->qserver == NULL) {
+        ret = -1;
+    } else {
+        ctx->cnx_client = picoquic_create_cnx(ctx->qclient, picoquic_null_connection_id, picoquic_null_connection_id,
+            (struct sockaddr*)&ctx->server_addr, ctx->simulated_time, 0, PICOQUIC_TEST_SNI, PICOQUIC_TEST_ALPN, 1);
+        ret = (ctx->cnx_client == NULL) ? -1 : picoquic_start_client_cnx(ctx->cnx_client);
+    }
+
+    for (int round = 0; ret == 0 && round < SHORT_HEADER_TEST_MAX_ROUNDS; round++) {
+        picoquic_cnx_t* cnx_server = picoquic_get_first_cnx(ctx->qserver);
+
+        if (picoquic_get_cnx_state(ctx->cnx_client) == picoquic_state_client_ready &&
+            cnx_server != NULL && picoquic_get_cnx_state(cnx_server) == picoquic_state_server_ready) {
+            return 0;
+        }
+        short_header_test_round(ctx);
+    }
+
+    return -1;
+}
+
+static void short_header_test_delete(short_header_test_ctx_t* ctx)
+{
+    if (ctx->qclient != NULL) {
+        picoquic_free(ctx->qclient);
+    }
+    if (ctx->qserver != NULL) {
+        picoquic_free(ctx->qserver);
+    }
+}
+
+/* The masks computed in batch are those of the packets, and the batched datagrams deliver the data */
+int short_header_test()
+{
+    int ret = 0;
+    short_header_test_ctx_t* ctx = (short_header_test_ctx_t*)malloc(sizeof(short_header_test_ctx_t));
+    uint8_t* data = (uint8_t*)malloc(SHORT_HEADER_TEST_DATA_LENGTH);
+    picoquic_cnx_t* cnx_server = NULL;
+
+    if (ctx == NULL || data == NULL) {
+        DBG_PRINTF("%s", "Cannot allocate the test context\n");
+        ret = -1;
+    } else if (short_header_test_start(ctx) != 0) {
+        DBG_PRINTF("%s", "Cannot establish the connection\n");
+        ret = -1;
+    } else {
+        uint8_t sample[PICOQUIC_HP_SAMPLE_SIZE];
+        uint8_t mask_batch[PICOQUIC_HP_SAMPLE_SIZE];
+        uint8_t mask[5] = { 0, 0, 0, 0, 0 };
+
+        cnx_server = picoquic_get_first_cnx(ctx->qserver);
+        for (int i = 0; i < PICOQUIC_HP_SAMPLE_SIZE; i++) {
+            sample[i] = (uint8_t)(17 * i + 3);
+        }
+        picoquic_hp_encrypt(cnx_server->crypto_context[3].hp_dec, sample, mask, mask, sizeof(mask));
+        if (cnx_server->crypto_context[3].hp_dec_ecb == NULL ||
+            picoquic_hp_mask_batch(cnx_server->crypto_context[3].hp_dec_ecb, sample, mask_batch, 1) != 0 ||
+            memcmp(mask, mask_batch, sizeof(mask)) != 0) {
+            DBG_PRINTF("%s", "The batch mask differs from the packet mask\n");
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        memset(data, 0x5A, SHORT_HEADER_TEST_DATA_LENGTH);
+        if (picoquic_add_to_stream(ctx->cnx_client, 4, data, SHORT_HEADER_TEST_DATA_LENGTH, 1) != 0) {
+            ret = -1;
+        }
+        for (int round = 0; ret == 0 && round < SHORT_HEADER_TEST_MAX_ROUNDS && !ctx->fin_received; round++) {
+            if (short_header_test_capture(ctx, PICOQUIC_INCOMING_BATCH_MAX + 3) > 0) {
+                (void)picoquic_incoming_packets(ctx->qserver, ctx->datagrams, ctx->nb_captured, ctx->simulated_time);
+            }
+            short_header_test_round(ctx);
+        }
+        if (!ctx->fin_received || ctx->nb_bytes_received != SHORT_HEADER_TEST_DATA_LENGTH) {
+            DBG_PRINTF("Received %d bytes in batches, fin %d\n", (int)ctx->nb_bytes_received, ctx->fin_received);
+            ret = -1;
+        } else if (ctx->qserver->last_cnx_by_id != cnx_server) {
+            DBG_PRINTF("%s", "The connection of the short headers is not cached\n");
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        picoquic_delete_cnx(cnx_server);
+        if (ctx->qserver->last_cnx_by_id != NULL) {
+            DBG_PRINTF("%s", "The deleted connection is still cached\n");
+            ret = -1;
+        }
+    }
+
+    if (ctx != NULL) {
+        short_header_test_delete(ctx);
+        free(ctx);
+    }
+    free(data);
+
+    return ret;
+}
+
+/* Receive time of the short header datagrams, one by one and in batches */
+int short_header_bench()
+{
+    int ret = 0;
+    short_header_test_ctx_t* ctx = (short_header_test_ctx_t*)malloc(sizeof(short_header_test_ctx_t));
+    uint8_t* data = (uint8_t*)malloc(SHORT_HEADER_BENCH_DATAGRAMS * PICOQUIC_MAX_PACKET_SIZE);
+    uint64_t time_single = 0;
+    uint64_t time_batch = 0;
+    int nb_single = 0;
+    int nb_batch = 0;
+
+    if (ctx == NULL || data == NULL) {
+        DBG_PRINTF("%s", "Cannot allocate the test context\n");
+        ret = -1;
+    } else if (short_header_test_start(ctx) != 0) {
+        DBG_PRINTF("%s", "Cannot establish the connection\n");
+        ret = -1;
+    } else {
+        memset(data, 0x5A, SHORT_HEADER_BENCH_DATAGRAMS * PICOQUIC_MAX_PACKET_SIZE);
+    }
+
+    for (int round = 0; ret == 0 && round < SHORT_HEADER_BENCH_ROUNDS; round++) {
+        int half;
+        int new_context_created = 0;
+        uint64_t start;
+
+        /* Only the receive side is measured, the window does not limit what the client sends */
+        ctx->cnx_client->path[0]->cwin = UINT32_MAX;
+        if (picoquic_add_to_stream(ctx->cnx_client, 4, data, SHORT_HEADER_BENCH_DATAGRAMS * PICOQUIC_MAX_PACKET_SIZE, 0) != 0) {
+            ret = -1;
+            break;
+        }
+        half = short_header_test_capture(ctx, SHORT_HEADER_BENCH_DATAGRAMS) / 2;
+
+        start = picoquic_current_time();
+        for (int i = 0; i < half; i++) {
+            (void)picoquic_incoming_packet(ctx->qserver, ctx->datagrams[i].bytes, ctx->datagrams[i].length,
+                ctx->datagrams[i].addr_from, ctx->datagrams[i].addr_to, 0, ctx->simulated_time, &new_context_created);
+        }
+        time_single += picoquic_current_time() - start;
+        nb_single += half;
+
+        start = picoquic_current_time();
+        (void)picoquic_incoming_packets(ctx->qserver, ctx->datagrams + half, ctx->nb_captured - half, ctx->simulated_time);
+        time_batch += picoquic_current_time() - start;
+        nb_batch += ctx->nb_captured - half;
+
+        /* Acknowledge what was received and consume the stream */
+        for (int i = 0; i < 10; i++) {
+            short_header_test_round(ctx);
+        }
+    }
+
+    if (ret == 0) {
+        if (nb_single == 0 || nb_batch == 0) {
+            DBG_PRINTF("%s", "No short header datagram was sent\n");
+            ret = -1;
+        } else {
+            printf("Short header datagrams: %d received one by one in %.1f ns each, %d in batches in %.1f ns each\n",
+                nb_single, (1000.0 * time_single) / nb_single, nb_batch, (1000.0 * time_batch) / nb_batch);
+        }
+    }
+
+    if (ctx != NULL) {
+        short_header_test_delete(ctx);
+        free(ctx);
+    }
+    free(data);
+
+    return ret;
+}
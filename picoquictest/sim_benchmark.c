@@ -0,0 +1,553 @@
+/*
+ * Transfer of a file over a simulated topology, in virtual time.
+ *
+ * The client sends a request on stream 4, the server answers with
+ * file_size bytes and the transfer completes when the client receives the
+ * FIN of the answer. Both sides load the same plugins. Their local addresses
+ * are the ones of the topology, so that the multipath plugin announces and
+ * uses the simulated interfaces. As the time is simulated, a run only
+ * depends on the configuration and on the random seed.
+ */
+
+#include "../picoquic/picoquic_internal.h"
+#include "../picoquic/plugin.h"
+#include "picoquictest_internal.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SIM_BENCHMARK_STREAM 4
+#define SIM_BENCHMARK_DEFAULT_MAX_TIME 300000000ull /* 5 minutes of virtual time */
+#define SIM_BENCHMARK_MAX_PACKETS_PER_ROUND 64
+
+typedef struct st_sim_benchmark_ctx_t {
+    const picoquictest_sim_benchmark_config_t* config;
+    uint64_t simulated_time;
+    uint8_t* file;
+    size_t nb_received;
+    int done;
+    int error;
+    uint64_t completion_time;
+} sim_benchmark_ctx_t;
+
+static void sim_benchmark_server_callback(picoquic_cnx_t* cnx,
+    uint64_t stream_id, uint8_t* bytes, size_t length,
+    picoquic_call_back_event_t fin_or_event, void* callback_ctx)
+{
+    sim_benchmark_ctx_t* ctx = (sim_benchmark_ctx_t*)callback_ctx;
+
+    if (stream_id == SIM_BENCHMARK_STREAM && fin_or_event == picoquic_callback_stream_fin) {
+        if (picoquic_add_to_stream(cnx, stream_id, ctx->file, ctx->config->file_size, 1) != 0) {
+            ctx->error = 1;
+        }
+    }
+}
+
+static void sim_benchmark_client_callback(picoquic_cnx_t* cnx,
+    uint64_t stream_id, uint8_t* bytes, size_t length,
+    picoquic_call_back_event_t fin_or_event, void* callback_ctx)
+{
+    sim_benchmark_ctx_t* ctx = (sim_benchmark_ctx_t*)callback_ctx;
+
+    if (fin_or_event == picoquic_callback_close || fin_or_event == picoquic_callback_application_close ||
+        fin_or_event == picoquic_callback_stateless_reset) {
+        if (!ctx->done) {
+            ctx->error = 1;
+        }
+    } else if (stream_id == SIM_BENCHMARK_STREAM) {
+        ctx->nb_received += length;
+        if (fin_or_event == picoquic_callback_stream_fin) {
+            ctx->done = 1;
+            ctx->completion_time = ctx->simulated_time;
+            if (ctx->nb_received != ctx->config->file_size) {
+                ctx->error = 1;
+            }
+        } else if (fin_or_event == picoquic_callback_stream_reset) {
+            ctx->error = 1;
+        }
+    }
+}
+
+/* Queues all the packets that the connection can send now. The source and
+ * destination are taken from the path, the client side falls back to the
+ * first interface when the path has no local address yet. */
+static int sim_benchmark_prepare(picoquictest_sim_topology_t* topology, picoquic_cnx_t* cnx,
+    uint64_t current_time, int* was_active)
+{
+    int ret = 0;
+
+    for (int i = 0; ret == 0 && i < SIM_BENCHMARK_MAX_PACKETS_PER_ROUND; i++) {
+        picoquic_path_t* path = NULL;
+        picoquictest_sim_packet_t* packet = picoquictest_sim_link_create_packet();
+
+        if (packet == NULL) {
+            return PICOQUIC_ERROR_MEMORY;
+        }
+
+        ret = picoquic_prepare_packet(cnx, current_time, packet->bytes, PICOQUIC_MAX_PACKET_SIZE, &packet->length, &path);
+
+        if (ret != 0 || packet->length == 0 || path == NULL) {
+            free(packet);
+            break;
+        }
+
+        if (path->local_addr_len > 0) {
+            memcpy(&packet->addr_from, &path->local_addr, path->local_addr_len);
+        } else if (cnx->client_mode) {
+            memcpy(&packet->addr_from, &topology->interfaces[0].client_addr, sizeof(struct sockaddr_in));
+        } else {
+            memcpy(&packet->addr_from, &topology->interfaces[0].server_addr, sizeof(struct sockaddr_in));
+        }
+        memcpy(&packet->addr_to, &path->peer_addr, (path->peer_addr_len > 0) ? path->peer_addr_len : sizeof(struct sockaddr_in));
+
+        (void)picoquictest_sim_topology_submit(topology, packet, cnx->client_mode, current_time);
+        *was_active = 1;
+    }
+
+    return ret;
+}
+
+static uint64_t sim_benchmark_next_wake_time(picoquic_quic_t* quic, uint64_t next_time)
+{
+    for (picoquic_cnx_t* cnx = quic->cnx_list; cnx != NULL; cnx = cnx->next_in_table) {
+        if (cnx->cnx_state != picoquic_state_disconnected && cnx->next_wake_time < next_time) {
+            next_time = cnx->next_wake_time;
+        }
+    }
+
+    return next_time;
+}
+
+static int sim_benchmark_loop(sim_benchmark_ctx_t* ctx, picoquictest_sim_topology_t* topology,
+    picoquic_quic_t* qclient, picoquic_quic_t* qserver, uint64_t max_time)
+{
+    int ret = 0;
+
+    while (ret == 0 && !ctx->done && !ctx->error && ctx->simulated_time < max_time) {
+        int was_active = 0;
+        int to_client = 0;
+        int new_context_created = 0;
+        picoquictest_sim_packet_t* packet;
+        uint64_t next_time;
+
+        /* Deliver the packets that arrived */
+        while (ret == 0 && (packet = picoquictest_sim_topology_dequeue(topology, ctx->simulated_time, &to_client)) != NULL) {
+            ret = picoquic_incoming_packet((to_client) ? qclient : qserver, packet->bytes, (uint32_t)packet->length,
+                (struct sockaddr*)&packet->addr_from, (struct sockaddr*)&packet->addr_to, 0,
+                ctx->simulated_time, &new_context_created);
+            free(packet);
+            was_active = 1;
+        }
+
+        /* Let every connection send what it can */
+        for (picoquic_quic_t* quic = qclient; ret == 0 && quic != NULL; quic = (quic == qclient) ? qserver : NULL) {
+            picoquic_stateless_packet_t* sp;
+
+            while ((sp = picoquic_dequeue_stateless_packet(quic)) != NULL) {
+                packet = picoquictest_sim_link_create_packet();
+                if (packet != NULL) {
+                    memcpy(&packet->addr_from, &sp->addr_local, sizeof(struct sockaddr_storage));
+                    memcpy(&packet->addr_to, &sp->addr_to, sizeof(struct sockaddr_storage));
+                    memcpy(packet->bytes, sp->bytes, sp->length);
+                    packet->length = sp->length;
+                    (void)picoquictest_sim_topology_submit(topology, packet, quic == qclient, ctx->simulated_time);
+                }
+                picoquic_delete_stateless_packet(sp);
+            }
+
+            for (picoquic_cnx_t* cnx = quic->cnx_list; ret == 0 && cnx != NULL; cnx = cnx->next_in_table) {
+                if (cnx->cnx_state != picoquic_state_disconnected && cnx->next_wake_time <= ctx->simulated_time) {
+                    ret = sim_benchmark_prepare(topology, cnx, ctx->simulated_time, &was_active);
+                }
+                if (ret == 0 && ctx->config->check_fn != NULL) {
+                    ret = ctx->config->check_fn(cnx, ctx->simulated_time, ctx->config->check_ctx);
+                }
+            }
+        }
+
+        /* Move to the next event */
+        next_time = sim_benchmark_next_wake_time(qclient, max_time);
+        next_time = sim_benchmark_next_wake_time(qserver, next_time);
+        next_time = picoquictest_sim_topology_next_arrival(topology, next_time);
+
+        if (next_time > ctx->simulated_time) {
+            ctx->simulated_time = next_time;
+        } else if (!was_active) {
+            ctx->simulated_time++;
+        }
+    }
+
+    return ret;
+}
+
+int picoquictest_sim_benchmark_run(const picoquictest_sim_benchmark_config_t* config, uint64_t* completion_time)
+{
+    int ret = 0;
+    sim_benchmark_ctx_t ctx;
+    picoquictest_sim_topology_t* topology = NULL;
+    picoquic_quic_t* qclient = NULL;
+    picoquic_quic_t* qserver = NULL;
+    picoquic_cnx_t* cnx_client = NULL;
+    struct sockaddr_storage client_addrs[PICOQUICTEST_SIM_MAX_INTERFACES];
+    struct sockaddr_storage server_addr;
+    uint8_t request[] = { 'G', 'E', 'T', ' ', '/', '\r', '\n' };
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.config = config;
+    *completion_time = 0;
+
+    topology = picoquictest_sim_topology_create(config->nb_interfaces, config->links, config->random_seed, 0);
+    ctx.file = (uint8_t*)malloc(config->file_size > 0 ? config->file_size : 1);
+
+    if (topology == NULL || ctx.file == NULL) {
+        ret = PICOQUIC_ERROR_MEMORY;
+    } else {
+        uint64_t random_context = config->random_seed;
+
+        for (size_t i = 0; i < config->file_size; i++) {
+            ctx.file[i] = (uint8_t)picoquic_test_random(&random_context);
+        }
+
+        for (size_t i = 0; ret == 0 && i < config->nb_address_changes; i++) {
+            ret = picoquictest_sim_topology_add_address_change(topology,
+                config->address_changes[i].interface_index, config->address_changes[i].change_time);
+        }
+
+        memset(client_addrs, 0, sizeof(client_addrs));
+        for (int i = 0; i < config->nb_interfaces; i++) {
+            memcpy(&client_addrs[i], &topology->interfaces[i].client_addr, sizeof(struct sockaddr_in));
+        }
+        memset(&server_addr, 0, sizeof(server_addr));
+        memcpy(&server_addr, &topology->interfaces[0].server_addr, sizeof(struct sockaddr_in));
+    }
+
+    if (ret == 0) {
+        qclient = picoquic_create(8, NULL, NULL, PICOQUIC_TEST_CERT_STORE, NULL, sim_benchmark_client_callback,
+            &ctx, NULL, NULL, NULL, ctx.simulated_time, &ctx.simulated_time, NULL, NULL, 0, NULL);
+        qserver = picoquic_create(8, PICOQUIC_TEST_SERVER_CERT, PICOQUIC_TEST_SERVER_KEY, PICOQUIC_TEST_CERT_STORE,
+            PICOQUIC_TEST_ALPN, sim_benchmark_server_callback, &ctx, NULL, NULL, NULL,
+            ctx.simulated_time, &ctx.simulated_time, NULL, NULL, 0, NULL);
+
+        if (qclient == NULL || qserver == NULL) {
+            ret = -1;
+        } else {
+            ret = picoquic_set_local_addresses(qclient, client_addrs, NULL, config->nb_interfaces);
+            if (ret == 0) {
+                ret = picoquic_set_local_addresses(qserver, &server_addr, NULL, 1);
+            }
+            if (ret == 0 && config->nb_plugins > 0) {
+                ret = picoquic_set_local_plugins(qserver, config->plugin_fnames, config->nb_plugins);
+            }
+        }
+    }
+
+    if (ret == 0) {
+        cnx_client = picoquic_create_cnx(qclient, picoquic_null_connection_id, picoquic_null_connection_id,
+            (struct sockaddr*)&server_addr, ctx.simulated_time, 0, PICOQUIC_TEST_SNI, PICOQUIC_TEST_ALPN, 1);
+
+        if (cnx_client == NULL) {
+            ret = -1;
+        } else {
+            if (config->nb_plugins > 0) {
+                ret = plugin_insert_plugins_from_fnames(cnx_client, (uint8_t)config->nb_plugins, (char**)config->plugin_fnames);
+            }
+            if (ret == 0) {
+                ret = picoquic_start_client_cnx(cnx_client);
+            }
+            if (ret == 0) {
+                ret = picoquic_add_to_stream(cnx_client, SIM_BENCHMARK_STREAM, request, sizeof(request), 1);
+            }
+        }
+    }
+
+    if (ret == 0) {
+        ret = sim_benchmark_loop(&ctx, topology, qclient, qserver,
+            (config->max_time > 0) ? config->max_time : SIM_BENCHMARK_DEFAULT_MAX_TIME);
+    }
+
+    if (ret == 0) {
+        if (ctx.done && !ctx.error) {
+            *completion_time = ctx.completion_time;
+        } else {
+            ret = -1;
+        }
+    }
+
+    if (qclient != NULL) {
+        picoquic_free(qclient);
+    }
+    if (qserver != NULL) {
+        picoquic_free(qserver);
+    }
+    if (topology != NULL) {
+        picoquictest_sim_topology_delete(topology);
+    }
+    free(ctx.file);
+
+    return ret;
+}
+
+/* Plain transfers, without plugins, over a single link and over two lossy
+ * links with reordering and a NAT rebinding. Runs must be reproducible. */
+int sim_benchmark_test()
+{
+    int ret = 0;
+    uint64_t completion_time = 0;
+    uint64_t completion_time_again = 0;
+    picoquictest_sim_benchmark_config_t config;
+
+    memset(&config, 0, sizeof(config));
+    config.nb_interfaces = 1;
+    config.links[0].data_rate_in_gps = 0.01;
+    config.links[0].microsec_latency = 10000;
+    config.file_size = 100000;
+    config.random_seed = 1;
+
+    ret = picoquictest_sim_benchmark_run(&config, &completion_time);
+    /* At 10 Mbps, the file takes at least 80 ms to transmit */
+    if (ret == 0 && (completion_time < 80000 || completion_time > 2000000)) {
+        DBG_PRINTF("Unexpected completion time on a single link: %d\n", (int)completion_time);
+        ret = -1;
+    }
+
+    if (ret == 0) {
+        config.nb_interfaces = 2;
+        config.links[0].ge_p_good_to_bad = 0.01;
+        config.links[0].ge_p_bad_to_good = 0.5;
+        config.links[0].ge_loss_bad = 0.5;
+        config.links[0].reorder_probability = 0.02;
+        config.links[0].reorder_delay = 5000;
+        config.links[1] = config.links[0];
+        config.links[1].microsec_latency = 30000;
+        config.nb_address_changes = 1;
+        config.address_changes[0].interface_index = 0;
+        config.address_changes[0].change_time = 100000;
+
+        ret = picoquictest_sim_benchmark_run(&config, &completion_time);
+        if (ret == 0) {
+            ret = picoquictest_sim_benchmark_run(&config, &completion_time_again);
+        }
+        if (ret == 0 && completion_time != completion_time_again) {
+            DBG_PRINTF("Runs with the same seed completed at %d and %d\n", (int)completion_time, (int)completion_time_again);
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
+/* Transfers over a fast path and a slow, lossy one with each multipath
+ * scheduler, as a Wi-Fi and LTE client would. The completion times are
+ * printed next to the round robin one; no ordering of the schedulers is
+ * asserted until it has been measured on this topology. */
+int sim_benchmark_multipath_test()
+{
+    int ret = 0;
+    static const char* schedulers[] = {
+        "plugins/multipath/multipath_rr.plugin",
+        "plugins/multipath/multipath_rtt.plugin",
+        "plugins/multipath/multipath_ecf.plugin",
+        "plugins/multipath/multipath_ecf_redundant.plugin"
+    };
+    picoquictest_sim_benchmark_config_t config;
+    uint64_t rr_completion_time = 0;
+
+    memset(&config, 0, sizeof(config));
+    config.nb_interfaces = 2;
+    config.links[0].data_rate_in_gps = 0.02;
+    config.links[0].microsec_latency = 10000;
+    config.links[1].data_rate_in_gps = 0.005;
+    config.links[1].microsec_latency = 40000;
+    config.links[1].ge_p_good_to_bad = 0.01;
+    config.links[1].ge_p_bad_to_good = 0.3;
+    config.links[1].ge_loss_bad = 0.3;
+    config.file_size = 1000000;
+    config.random_seed = 1;
+    config.nb_plugins = 1;
+
+    for (size_t i = 0; ret == 0 && i < sizeof(schedulers) / sizeof(schedulers[0]); i++) {
+        uint64_t completion_time = 0;
+
+        config.plugin_fnames = &schedulers[i];
+        ret = picoquictest_sim_benchmark_run(&config, &completion_time);
+        if (ret != 0) {
+            DBG_PRINTF("Transfer failed with %s\n", schedulers[i]);
+        } else if (completion_time < 320000) {
+            /* At 25 Mbps, both links together, the file takes at least 320 ms */
+            DBG_PRINTF("Completion time %d us with %s is below the capacity of the links\n",
+                (int)completion_time, schedulers[i]);
+            ret = -1;
+        } else {
+            DBG_PRINTF("Transfer completed in %d us with %s, %d us with round robin\n",
+                (int)completion_time, schedulers[i], (int)((i == 0) ? completion_time : rr_completion_time));
+        }
+
+        if (i == 0) {
+            rr_completion_time = completion_time;
+        }
+    }
+
+    return ret;
+}
+
+typedef struct st_sim_fec_buffers_check_t {
+    uint64_t nb_allocs;
+    uint64_t nb_allocs_avoided;
+} sim_fec_buffers_check_t;
+
+/* Keeps the largest counters of the FEC sender pools, which only the server uses */
+static int sim_fec_buffers_check(picoquic_cnx_t* cnx, uint64_t current_time, void* check_ctx)
+{
+    static protoop_id_t get_fec_buffers_stats = { .id = "get_fec_buffers_stats" };
+    sim_fec_buffers_check_t* check = (sim_fec_buffers_check_t*)check_ctx;
+    protoop_arg_t outs[2] = { 0, 0 };
+
+    (void)current_time;
+    if (cnx->plugins != NULL) {
+        (void)protoop_prepare_and_run_extern_noparam(cnx, &get_fec_buffers_stats, outs, NULL);
+        if (outs[0] > check->nb_allocs) {
+            check->nb_allocs = outs[0];
+        }
+        if (outs[1] > check->nb_allocs_avoided) {
+            check->nb_allocs_avoided = outs[1];
+        }
+    }
+
+    return 0;
+}
+
+/* Long transfers with the FEC plugins over a lossy link. Every generation
+ * recycles the FEC block, the repair symbols and the FEC frames of the
+ * previous ones, so the transfer must complete, the runs must stay
+ * reproducible across the pools, and most objects must come from them. */
+int sim_benchmark_fec_test()
+{
+    int ret = 0;
+    static const char* fec_plugins[] = {
+        "plugins/fec/fec.plugin",
+        "plugins/fec/fec_rlc_gf256_window.plugin"
+    };
+    picoquictest_sim_benchmark_config_t config;
+    sim_fec_buffers_check_t check;
+
+    memset(&config, 0, sizeof(config));
+    config.nb_interfaces = 1;
+    config.links[0].data_rate_in_gps = 0.01;
+    config.links[0].microsec_latency = 20000;
+    config.links[0].ge_p_good_to_bad = 0.02;
+    config.links[0].ge_p_bad_to_good = 0.3;
+    config.links[0].ge_loss_bad = 0.4;
+    config.file_size = 2000000;
+    config.random_seed = 1;
+    config.nb_plugins = 1;
+    config.check_fn = sim_fec_buffers_check;
+    config.check_ctx = &check;
+
+    for (size_t i = 0; ret == 0 && i < sizeof(fec_plugins) / sizeof(fec_plugins[0]); i++) {
+        uint64_t completion_time = 0;
+        uint64_t completion_time_again = 0;
+
+        memset(&check, 0, sizeof(check));
+        config.plugin_fnames = &fec_plugins[i];
+        ret = picoquictest_sim_benchmark_run(&config, &completion_time);
+        if (ret == 0) {
+            ret = picoquictest_sim_benchmark_run(&config, &completion_time_again);
+        }
+        if (ret != 0) {
+            DBG_PRINTF("Transfer failed with %s\n", fec_plugins[i]);
+        } else if (completion_time != completion_time_again) {
+            DBG_PRINTF("Runs with %s completed at %d and %d\n", fec_plugins[i], (int)completion_time, (int)completion_time_again);
+            ret = -1;
+        } else if (check.nb_allocs_avoided <= check.nb_allocs) {
+            DBG_PRINTF("With %s, %d FEC objects were allocated and only %d taken from the pools\n", fec_plugins[i],
+                (int)check.nb_allocs, (int)check.nb_allocs_avoided);
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
+typedef struct st_sim_loss_timer_check_t {
+    uint64_t nb_checks;
+    uint64_t nb_armed;
+    uint64_t max_reorder_window; /* In 1/8 of the smoothed RTT */
+} sim_loss_timer_check_t;
+
+/* An armed loss timer must hold the loss time that retransmit_needed_by_packet
+ * computes now for the oldest packet of the queue */
+static int sim_loss_timer_check(picoquic_cnx_t* cnx, uint64_t current_time, void* check_ctx)
+{
+    sim_loss_timer_check_t* check = (sim_loss_timer_check_t*)check_ctx;
+
+    for (int i = 0; i < cnx->nb_paths; i++) {
+        picoquic_path_t* path_x = cnx->path[i];
+
+        for (picoquic_packet_context_enum pc = 0; pc < picoquic_nb_packet_context; pc++) {
+            picoquic_packet_context_t* pkt_ctx = &path_x->pkt_ctx[pc];
+            uint64_t loss_time = UINT64_MAX;
+
+            if (path_x->smoothed_rtt > 0 &&
+                8 * picoquic_reorder_window(path_x, pc) / path_x->smoothed_rtt > check->max_reorder_window) {
+                check->max_reorder_window = 8 * picoquic_reorder_window(path_x, pc) / path_x->smoothed_rtt;
+            }
+
+            check->nb_checks++;
+            if (!pkt_ctx->loss_timer_armed) {
+                continue;
+            }
+            check->nb_armed++;
+
+            if (pkt_ctx->retransmit_oldest != NULL) {
+                protoop_arg_t outs[PROTOOPARGS_MAX];
+                (void)protoop_prepare_and_run_noparam(cnx, &PROTOOP_NOPARAM_RETRANSMIT_NEEDED_BY_PACKET, outs,
+                    pkt_ctx->retransmit_oldest, current_time, 0);
+                loss_time = (uint64_t)outs[2];
+            }
+
+            if (loss_time != pkt_ctx->loss_time) {
+                DBG_PRINTF("Stale loss timer at %d, path %d, pc %d, %d instead of %d\n", (int)current_time, i, pc,
+                    (int)pkt_ctx->loss_time, (int)loss_time);
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/* Transfer over a link that delays a few packets by more than the default
+ * reorder window of 1/8 of the RTT. The spurious retransmissions must widen the
+ * reorder window, and the cached loss timers must never be stale. */
+int sim_loss_timer_test()
+{
+    int ret = 0;
+    uint64_t completion_time = 0;
+    sim_loss_timer_check_t check;
+    picoquictest_sim_benchmark_config_t config;
+
+    memset(&check, 0, sizeof(check));
+    memset(&config, 0, sizeof(config));
+    config.nb_interfaces = 1;
+    config.links[0].data_rate_in_gps = 0.01;
+    config.links[0].microsec_latency = 20000;
+    config.links[0].reorder_probability = 0.02;
+    config.links[0].reorder_delay = 15000;
+    config.file_size = 1000000;
+    config.random_seed = 1;
+    config.check_fn = sim_loss_timer_check;
+    config.check_ctx = &check;
+
+    ret = picoquictest_sim_benchmark_run(&config, &completion_time);
+
+    if (ret != 0) {
+        DBG_PRINTF("%s", "Transfer failed over the reordering link\n");
+    } else if (check.nb_armed == 0 || check.nb_armed == check.nb_checks) {
+        DBG_PRINTF("Loss timers armed in %d out of %d checks\n", (int)check.nb_armed, (int)check.nb_checks);
+        ret = -1;
+    } else if (check.max_reorder_window <= 1) {
+        DBG_PRINTF("%s", "The reorder window did not adapt to the reordering\n");
+        ret = -1;
+    }
+
+    return ret;
+}
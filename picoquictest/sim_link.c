@@ -27,34 +27,67 @@
  * pattern is a 64 bit bit mask.
  * Submit packet of length L at time t. The packet is queued to the link.
  * Get packet out of link at time T + L + Queue.
+ * The rate and latency can follow a schedule, and the link can add
+ * Gilbert-Elliott losses and reordering, see picoquictest_sim_link_configure.
+ * Several links are assembled in a topology of client interfaces, see
+ * picoquictest_sim_topology_create.
  */
 
 #include "../picoquic/picoquic_internal.h"
 #include "picoquictest_internal.h"
 #include <stdlib.h>
+#include <string.h>
+
+#define SIM_LINK_DEFAULT_SEED 0xdeadbeefcafef00dull
+
+static uint64_t picoquictest_sim_link_picosec_per_byte(double data_rate_in_gps)
+{
+    double pico_d = (data_rate_in_gps <= 0) ? 0 : (8000.0 / data_rate_in_gps);
+    pico_d *= (1.024 * 1.024); /* account for binary units */
+    return (uint64_t)pico_d;
+}
 
 picoquictest_sim_link_t* picoquictest_sim_link_create(double data_rate_in_gps,
     uint64_t microsec_latency, uint64_t* loss_mask, uint64_t queue_delay_max, uint64_t current_time)
 {
     picoquictest_sim_link_t* link = (picoquictest_sim_link_t*)malloc(sizeof(picoquictest_sim_link_t));
     if (link != 0) {
-        double pico_d = (data_rate_in_gps <= 0) ? 0 : (8000.0 / data_rate_in_gps);
-        pico_d *= (1.024 * 1.024); /* account for binary units */
+        memset(link, 0, sizeof(picoquictest_sim_link_t));
         link->next_send_time = current_time;
         link->queue_time = current_time;
         link->queue_delay_max = queue_delay_max;
-        link->picosec_per_byte = pico_d; 
+        link->picosec_per_byte = picoquictest_sim_link_picosec_per_byte(data_rate_in_gps);
         link->microsec_latency = microsec_latency;
         link->packets_dropped = 0;
         link->packets_sent = 0;
         link->first_packet = NULL;
         link->last_packet = NULL;
         link->loss_mask = loss_mask;
+        link->random_context = SIM_LINK_DEFAULT_SEED;
     }
 
     return link;
 }
 
+void picoquictest_sim_link_configure(picoquictest_sim_link_t* link, const picoquictest_sim_link_config_t* config,
+    uint64_t random_seed)
+{
+    link->picosec_per_byte = picoquictest_sim_link_picosec_per_byte(config->data_rate_in_gps);
+    link->microsec_latency = config->microsec_latency;
+    link->queue_delay_max = config->queue_delay_max;
+    link->ge_p_good_to_bad = config->ge_p_good_to_bad;
+    link->ge_p_bad_to_good = config->ge_p_bad_to_good;
+    link->ge_loss_good = config->ge_loss_good;
+    link->ge_loss_bad = config->ge_loss_bad;
+    link->ge_bad_state = 0;
+    link->reorder_probability = config->reorder_probability;
+    link->reorder_delay = config->reorder_delay;
+    link->schedule = config->schedule;
+    link->nb_schedule = config->nb_schedule;
+    link->next_schedule = 0;
+    link->random_context = random_seed;
+}
+
 void picoquictest_sim_link_delete(picoquictest_sim_link_t* link)
 {
     picoquictest_sim_packet_t* packet;
@@ -108,6 +141,57 @@ picoquictest_sim_packet_t* picoquictest_sim_link_dequeue(picoquictest_sim_link_t
     return packet;
 }
 
+/* Returns a number uniformly drawn in [0, 1[ */
+static double picoquictest_sim_link_draw(picoquictest_sim_link_t* link)
+{
+    return (double)(picoquic_test_random(&link->random_context) >> 11) / (double)(1ull << 53);
+}
+
+static int picoquictest_sim_link_test_gilbert_elliott(picoquictest_sim_link_t* link)
+{
+    if (link->ge_bad_state) {
+        if (picoquictest_sim_link_draw(link) < link->ge_p_bad_to_good) {
+            link->ge_bad_state = 0;
+        }
+    } else if (link->ge_p_good_to_bad > 0 && picoquictest_sim_link_draw(link) < link->ge_p_good_to_bad) {
+        link->ge_bad_state = 1;
+    }
+
+    return picoquictest_sim_link_draw(link) < ((link->ge_bad_state) ? link->ge_loss_bad : link->ge_loss_good);
+}
+
+static void picoquictest_sim_link_apply_schedule(picoquictest_sim_link_t* link, uint64_t current_time)
+{
+    while (link->next_schedule < link->nb_schedule && link->schedule[link->next_schedule].start_time <= current_time) {
+        link->picosec_per_byte = picoquictest_sim_link_picosec_per_byte(link->schedule[link->next_schedule].data_rate_in_gps);
+        link->microsec_latency = link->schedule[link->next_schedule].microsec_latency;
+        link->next_schedule++;
+    }
+}
+
+/* Keeps the queue sorted by arrival time. Packets usually arrive in order,
+ * so the common case appends at the tail. */
+static void picoquictest_sim_link_insert(picoquictest_sim_link_t* link, picoquictest_sim_packet_t* packet)
+{
+    if (link->last_packet == NULL) {
+        link->first_packet = packet;
+        link->last_packet = packet;
+        packet->next_packet = NULL;
+    } else if (link->last_packet->arrival_time <= packet->arrival_time) {
+        link->last_packet->next_packet = packet;
+        link->last_packet = packet;
+        packet->next_packet = NULL;
+    } else {
+        picoquictest_sim_packet_t** pprevious = &link->first_packet;
+
+        while ((*pprevious)->arrival_time <= packet->arrival_time) {
+            pprevious = &(*pprevious)->next_packet;
+        }
+        packet->next_packet = *pprevious;
+        *pprevious = packet;
+    }
+}
+
 static int picoquictest_sim_link_testloss(uint64_t* loss_mask)
 {
     uint64_t loss_bit = 0;
@@ -127,8 +211,13 @@ static int picoquictest_sim_link_testloss(uint64_t* loss_mask)
 void picoquictest_sim_link_submit(picoquictest_sim_link_t* link, picoquictest_sim_packet_t* packet,
     uint64_t current_time)
 {
-    uint64_t queue_delay = (current_time > link->queue_time) ? 0 : link->queue_time - current_time;
-    uint64_t transmit_time = ((link->picosec_per_byte * packet->length) >> 20);
+    uint64_t queue_delay;
+    uint64_t transmit_time;
+
+    picoquictest_sim_link_apply_schedule(link, current_time);
+
+    queue_delay = (current_time > link->queue_time) ? 0 : link->queue_time - current_time;
+    transmit_time = ((link->picosec_per_byte * packet->length) >> 20);
     if (transmit_time <= 0)
         transmit_time = 1;
 
@@ -136,19 +225,18 @@ void picoquictest_sim_link_submit(picoquictest_sim_link_t* link, picoquictest_si
 
         link->queue_time = current_time + queue_delay + transmit_time;
 
-        if (picoquictest_sim_link_testloss(link->loss_mask) != 0) {
+        if (picoquictest_sim_link_testloss(link->loss_mask) != 0 ||
+            ((link->ge_p_good_to_bad > 0 || link->ge_loss_good > 0) && picoquictest_sim_link_test_gilbert_elliott(link))) {
             link->packets_dropped++;
             free(packet);
         } else {
             link->packets_sent++;
-            if (link->last_packet == NULL) {
-                link->first_packet = packet;
-            } else {
-                link->last_packet->next_packet = packet;
-            }
-            link->last_packet = packet;
-            packet->next_packet = NULL;
             packet->arrival_time = link->queue_time + link->microsec_latency;
+            if (link->reorder_probability > 0 && picoquictest_sim_link_draw(link) < link->reorder_probability) {
+                packet->arrival_time += link->reorder_delay;
+                link->packets_reordered++;
+            }
+            picoquictest_sim_link_insert(link, packet);
         }
     } else {
         /* simulate congestion loss on queue full */
@@ -157,6 +245,175 @@ void picoquictest_sim_link_submit(picoquictest_sim_link_t* link, picoquictest_si
     }
 }
 
+picoquictest_sim_topology_t* picoquictest_sim_topology_create(int nb_interfaces,
+    const picoquictest_sim_link_config_t* configs, uint64_t random_seed, uint64_t current_time)
+{
+    picoquictest_sim_topology_t* topology = NULL;
+
+    if (nb_interfaces > 0 && nb_interfaces <= PICOQUICTEST_SIM_MAX_INTERFACES) {
+        topology = (picoquictest_sim_topology_t*)malloc(sizeof(picoquictest_sim_topology_t));
+    }
+
+    if (topology != NULL) {
+        memset(topology, 0, sizeof(picoquictest_sim_topology_t));
+        topology->nb_interfaces = nb_interfaces;
+
+        for (int i = 0; i < nb_interfaces; i++) {
+            picoquictest_sim_interface_t* itf = &topology->interfaces[i];
+
+            /* Client at 192.168.<i>.2, server at 172.16.0.1, outside of the 10/8 prefix that plugins may filter */
+            itf->client_addr.sin_family = AF_INET;
+            itf->client_addr.sin_addr.s_addr = htonl(0xC0A80002 | ((uint32_t)i << 8));
+            itf->client_addr.sin_port = htons(1234);
+            itf->public_addr = itf->client_addr;
+            itf->server_addr.sin_family = AF_INET;
+            itf->server_addr.sin_addr.s_addr = htonl(0xAC100001);
+            itf->server_addr.sin_port = htons(4433);
+
+            itf->c_to_s_link = picoquictest_sim_link_create(0.01, 10000, NULL, 0, current_time);
+            itf->s_to_c_link = picoquictest_sim_link_create(0.01, 10000, NULL, 0, current_time);
+
+            if (itf->c_to_s_link == NULL || itf->s_to_c_link == NULL) {
+                picoquictest_sim_topology_delete(topology);
+                topology = NULL;
+                break;
+            }
+
+            if (configs != NULL) {
+                picoquictest_sim_link_configure(itf->c_to_s_link, &configs[i], random_seed + 2 * i);
+                picoquictest_sim_link_configure(itf->s_to_c_link, &configs[i], random_seed + 2 * i + 1);
+            }
+        }
+    }
+
+    return topology;
+}
+
+void picoquictest_sim_topology_delete(picoquictest_sim_topology_t* topology)
+{
+    for (int i = 0; i < topology->nb_interfaces; i++) {
+        if (topology->interfaces[i].c_to_s_link != NULL) {
+            picoquictest_sim_link_delete(topology->interfaces[i].c_to_s_link);
+        }
+        if (topology->interfaces[i].s_to_c_link != NULL) {
+            picoquictest_sim_link_delete(topology->interfaces[i].s_to_c_link);
+        }
+    }
+
+    free(topology);
+}
+
+int picoquictest_sim_topology_add_address_change(picoquictest_sim_topology_t* topology,
+    int interface_index, uint64_t change_time)
+{
+    int ret = 0;
+
+    if (interface_index < 0 || interface_index >= topology->nb_interfaces ||
+        topology->nb_address_changes >= PICOQUICTEST_SIM_MAX_ADDRESS_CHANGES ||
+        (topology->nb_address_changes > 0 &&
+            topology->address_changes[topology->nb_address_changes - 1].change_time > change_time)) {
+        ret = -1;
+    } else {
+        topology->address_changes[topology->nb_address_changes].change_time = change_time;
+        topology->address_changes[topology->nb_address_changes].interface_index = interface_index;
+        topology->nb_address_changes++;
+    }
+
+    return ret;
+}
+
+static void picoquictest_sim_topology_apply_address_changes(picoquictest_sim_topology_t* topology, uint64_t current_time)
+{
+    while (topology->next_address_change < topology->nb_address_changes &&
+        topology->address_changes[topology->next_address_change].change_time <= current_time) {
+        picoquictest_sim_interface_t* itf = &topology->interfaces[topology->address_changes[topology->next_address_change].interface_index];
+        itf->public_addr.sin_port = htons((uint16_t)(ntohs(itf->public_addr.sin_port) + 1));
+        topology->next_address_change++;
+    }
+}
+
+int picoquictest_sim_topology_submit(picoquictest_sim_topology_t* topology, picoquictest_sim_packet_t* packet,
+    int from_client, uint64_t current_time)
+{
+    picoquictest_sim_interface_t* itf = NULL;
+
+    picoquictest_sim_topology_apply_address_changes(topology, current_time);
+
+    if (from_client) {
+        struct sockaddr_in* from = (struct sockaddr_in*)&packet->addr_from;
+
+        /* A client that does not choose its source address sends on the first interface */
+        if (from->sin_family != AF_INET || from->sin_addr.s_addr == 0) {
+            itf = &topology->interfaces[0];
+        } else {
+            for (int i = 0; i < topology->nb_interfaces; i++) {
+                if (topology->interfaces[i].client_addr.sin_addr.s_addr == from->sin_addr.s_addr) {
+                    itf = &topology->interfaces[i];
+                    break;
+                }
+            }
+        }
+
+        if (itf != NULL) {
+            memcpy(&packet->addr_from, &itf->public_addr, sizeof(struct sockaddr_in));
+            picoquictest_sim_link_submit(itf->c_to_s_link, packet, current_time);
+        }
+    } else {
+        for (int i = 0; i < topology->nb_interfaces; i++) {
+            if (picoquic_compare_addr((struct sockaddr*)&topology->interfaces[i].public_addr,
+                    (struct sockaddr*)&packet->addr_to) == 0) {
+                itf = &topology->interfaces[i];
+                break;
+            }
+        }
+
+        if (itf != NULL) {
+            memcpy(&packet->addr_to, &itf->client_addr, sizeof(struct sockaddr_in));
+            picoquictest_sim_link_submit(itf->s_to_c_link, packet, current_time);
+        }
+    }
+
+    if (itf == NULL) {
+        topology->packets_unroutable++;
+        free(packet);
+    }
+
+    return (itf == NULL) ? -1 : 0;
+}
+
+uint64_t picoquictest_sim_topology_next_arrival(picoquictest_sim_topology_t* topology, uint64_t current_time)
+{
+    for (int i = 0; i < topology->nb_interfaces; i++) {
+        current_time = picoquictest_sim_link_next_arrival(topology->interfaces[i].c_to_s_link, current_time);
+        current_time = picoquictest_sim_link_next_arrival(topology->interfaces[i].s_to_c_link, current_time);
+    }
+
+    return current_time;
+}
+
+picoquictest_sim_packet_t* picoquictest_sim_topology_dequeue(picoquictest_sim_topology_t* topology,
+    uint64_t current_time, int* to_client)
+{
+    picoquictest_sim_link_t* best_link = NULL;
+    uint64_t best_arrival = current_time;
+
+    for (int i = 0; i < topology->nb_interfaces; i++) {
+        picoquictest_sim_link_t* links[2] = { topology->interfaces[i].s_to_c_link, topology->interfaces[i].c_to_s_link };
+
+        for (int j = 0; j < 2; j++) {
+            if (links[j]->first_packet != NULL && links[j]->first_packet->arrival_time <= best_arrival) {
+                if (best_link == NULL || links[j]->first_packet->arrival_time < best_arrival) {
+                    best_link = links[j];
+                    best_arrival = links[j]->first_packet->arrival_time;
+                    *to_client = (j == 0);
+                }
+            }
+        }
+    }
+
+    return (best_link == NULL) ? NULL : picoquictest_sim_link_dequeue(best_link, current_time);
+}
+
 int sim_link_one_test(uint64_t* loss_mask, uint64_t queue_delay_max, uint64_t nb_losses)
 {
     int ret = 0;
@@ -211,6 +468,225 @@ int sim_link_one_test(uint64_t* loss_mask, uint64_t queue_delay_max, uint64_t nb
     return ret;
 }
 
+/* Sends nb_packets numbered packets every 250 us, then checks that they come out in arrival order.
+ * Returns the number of packets received, counting those that overtook an earlier one. */
+static int sim_link_config_one_test(const picoquictest_sim_link_config_t* config, uint64_t seed,
+    uint64_t nb_packets, uint64_t* nb_received, uint64_t* nb_overtaking, uint64_t* last_arrival)
+{
+    int ret = 0;
+    uint64_t current_time = 0;
+    uint64_t highest_received = 0;
+    picoquictest_sim_link_t* link = picoquictest_sim_link_create(0, 0, NULL, 0, current_time);
+
+    *nb_received = 0;
+    *nb_overtaking = 0;
+    *last_arrival = 0;
+
+    if (link == NULL) {
+        return -1;
+    }
+
+    picoquictest_sim_link_configure(link, config, seed);
+
+    for (uint64_t i = 0; ret == 0 && i < nb_packets; i++) {
+        picoquictest_sim_packet_t* packet = picoquictest_sim_link_create_packet();
+
+        if (packet == NULL) {
+            ret = -1;
+        } else {
+            packet->length = 100;
+            memcpy(packet->bytes, &i, sizeof(i));
+            picoquictest_sim_link_submit(link, packet, current_time);
+            current_time += 250;
+        }
+    }
+
+    while (ret == 0) {
+        picoquictest_sim_packet_t* packet = picoquictest_sim_link_dequeue(link, (uint64_t)((int64_t)-1));
+        uint64_t number;
+
+        if (packet == NULL) {
+            break;
+        }
+
+        memcpy(&number, packet->bytes, sizeof(number));
+        if (packet->arrival_time < *last_arrival) {
+            DBG_PRINTF("Packet %d dequeued out of arrival order\n", (int)number);
+            ret = -1;
+        }
+        if (*nb_received > 0 && number < highest_received) {
+            (*nb_overtaking)++;
+        }
+        if (number > highest_received) {
+            highest_received = number;
+        }
+        *last_arrival = packet->arrival_time;
+        (*nb_received)++;
+        free(packet);
+    }
+
+    if (ret == 0 && *nb_received + link->packets_dropped != nb_packets) {
+        ret = -1;
+    }
+
+    picoquictest_sim_link_delete(link);
+
+    return ret;
+}
+
+static int sim_link_config_test()
+{
+    int ret = 0;
+    uint64_t nb_received, nb_received_again, nb_overtaking, last_arrival;
+    const uint64_t nb_packets = 10000;
+    picoquictest_sim_link_config_t config;
+    picoquictest_sim_link_schedule_t schedule[] = { { 1000000, 0, 50000 } };
+
+    /* Gilbert-Elliott: about 1 packet in 30 is lost, in bursts of about 3 packets */
+    memset(&config, 0, sizeof(config));
+    config.ge_p_good_to_bad = 0.01;
+    config.ge_p_bad_to_good = 0.3;
+    config.ge_loss_bad = 1.0;
+    ret = sim_link_config_one_test(&config, 1, nb_packets, &nb_received, &nb_overtaking, &last_arrival);
+    if (ret == 0 && (nb_packets - nb_received < nb_packets / 50 || nb_packets - nb_received > nb_packets / 20)) {
+        DBG_PRINTF("Unexpected number of losses: %d\n", (int)(nb_packets - nb_received));
+        ret = -1;
+    }
+    /* The same seed gives the same losses */
+    if (ret == 0) {
+        ret = sim_link_config_one_test(&config, 1, nb_packets, &nb_received_again, &nb_overtaking, &last_arrival);
+        if (ret == 0 && nb_received_again != nb_received) {
+            DBG_PRINTF("%s", "Losses differ between runs with the same seed\n");
+            ret = -1;
+        }
+    }
+
+    /* Reordering: held packets are overtaken by the next ones */
+    if (ret == 0) {
+        memset(&config, 0, sizeof(config));
+        config.reorder_probability = 0.1;
+        config.reorder_delay = 1000;
+        ret = sim_link_config_one_test(&config, 2, nb_packets, &nb_received, &nb_overtaking, &last_arrival);
+        if (ret == 0 && (nb_received != nb_packets || nb_overtaking < nb_packets / 20 || nb_overtaking > nb_packets / 5)) {
+            DBG_PRINTF("Unexpected reordering: %d packets overtaking\n", (int)nb_overtaking);
+            ret = -1;
+        }
+    }
+
+    /* Schedule: the latency goes from 10 to 50 ms after 1 second */
+    if (ret == 0) {
+        memset(&config, 0, sizeof(config));
+        config.microsec_latency = 10000;
+        config.schedule = schedule;
+        config.nb_schedule = 1;
+        ret = sim_link_config_one_test(&config, 3, nb_packets, &nb_received, &nb_overtaking, &last_arrival);
+        if (ret == 0 && (nb_received != nb_packets || last_arrival != (nb_packets - 1) * 250 + 1 + 50000)) {
+            DBG_PRINTF("Unexpected last arrival with a schedule: %d\n", (int)last_arrival);
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
+static void sim_topology_set_addr(struct sockaddr_storage* addr, const struct sockaddr_in* value)
+{
+    memset(addr, 0, sizeof(struct sockaddr_storage));
+    memcpy(addr, value, sizeof(struct sockaddr_in));
+}
+
+/* Sends a packet and returns the one that comes out of the topology, or NULL */
+static picoquictest_sim_packet_t* sim_topology_send(picoquictest_sim_topology_t* topology,
+    const struct sockaddr_in* from, const struct sockaddr_in* to, int from_client,
+    uint64_t* current_time, int* to_client)
+{
+    picoquictest_sim_packet_t* packet = picoquictest_sim_link_create_packet();
+
+    if (packet != NULL) {
+        packet->length = 100;
+        sim_topology_set_addr(&packet->addr_from, from);
+        sim_topology_set_addr(&packet->addr_to, to);
+        (void)picoquictest_sim_topology_submit(topology, packet, from_client, *current_time);
+        *current_time = picoquictest_sim_topology_next_arrival(topology, *current_time + 1000000);
+        packet = picoquictest_sim_topology_dequeue(topology, *current_time, to_client);
+    }
+
+    return packet;
+}
+
+static int sim_topology_test()
+{
+    int ret = 0;
+    int to_client = 0;
+    uint64_t current_time = 0;
+    struct sockaddr_in public_addr;
+    picoquictest_sim_packet_t* packet = NULL;
+    picoquictest_sim_link_config_t configs[2];
+    picoquictest_sim_topology_t* topology;
+
+    memset(configs, 0, sizeof(configs));
+    configs[0].microsec_latency = 10000;
+    configs[1].microsec_latency = 30000;
+    topology = picoquictest_sim_topology_create(2, configs, 0, current_time);
+
+    if (topology == NULL || picoquictest_sim_topology_add_address_change(topology, 1, 500000) != 0) {
+        ret = -1;
+    }
+
+    /* Packets from the second interface use its links */
+    if (ret == 0) {
+        packet = sim_topology_send(topology, &topology->interfaces[1].client_addr, &topology->interfaces[1].server_addr,
+            1, &current_time, &to_client);
+        if (packet == NULL || to_client || current_time != 30001 ||
+            picoquic_compare_addr((struct sockaddr*)&packet->addr_from, (struct sockaddr*)&topology->interfaces[1].client_addr) != 0) {
+            DBG_PRINTF("%s", "Client packet not routed on the second interface\n");
+            ret = -1;
+        }
+        free(packet);
+    }
+
+    /* After the address change, the server sees a new port and the former one is unreachable */
+    if (ret == 0) {
+        current_time = 600000;
+        packet = sim_topology_send(topology, &topology->interfaces[1].client_addr, &topology->interfaces[1].server_addr,
+            1, &current_time, &to_client);
+        if (packet == NULL || ((struct sockaddr_in*)&packet->addr_from)->sin_port == topology->interfaces[1].client_addr.sin_port) {
+            DBG_PRINTF("%s", "The public address did not change\n");
+            ret = -1;
+        } else {
+            memcpy(&public_addr, &packet->addr_from, sizeof(struct sockaddr_in));
+        }
+        free(packet);
+    }
+
+    if (ret == 0) {
+        packet = sim_topology_send(topology, &topology->interfaces[1].server_addr, &topology->interfaces[1].client_addr,
+            0, &current_time, &to_client);
+        if (packet != NULL || topology->packets_unroutable != 1) {
+            DBG_PRINTF("%s", "Packet to the former address was delivered\n");
+            ret = -1;
+        }
+        free(packet);
+    }
+
+    if (ret == 0) {
+        packet = sim_topology_send(topology, &topology->interfaces[1].server_addr, &public_addr,
+            0, &current_time, &to_client);
+        if (packet == NULL || !to_client ||
+            picoquic_compare_addr((struct sockaddr*)&packet->addr_to, (struct sockaddr*)&topology->interfaces[1].client_addr) != 0) {
+            DBG_PRINTF("%s", "Packet to the new address was not translated\n");
+            ret = -1;
+        }
+        free(packet);
+    }
+
+    if (topology != NULL) {
+        picoquictest_sim_topology_delete(topology);
+    }
+
+    return ret;
+}
+
 int sim_link_test()
 {
     int ret = 0;
@@ -230,5 +706,13 @@ int sim_link_test()
         ret = sim_link_one_test(&loss_mask, 0, 2);
     }
 
+    if (ret == 0) {
+        ret = sim_link_config_test();
+    }
+
+    if (ret == 0) {
+        ret = sim_topology_test();
+    }
+
     return ret;
 }
@@ -36,26 +36,26 @@ static uint8_t test_frame_type_padding[] = { 0, 0, 0 };
 static uint8_t test_frame_type_reset_stream[] = {
     picoquic_frame_type_reset_stream,
     17,
-    0, 1,
+    1,
     1
 };
 
 static uint8_t test_type_connection_close[] = {
     picoquic_frame_type_connection_close,
-    0xcf, 0xff, 0x00,
+    0x80, 0x00, 0xcf, 0xff, 0x00,
     9,
     '1', '2', '3', '4', '5', '6', '7', '8', '9'
 };
 
 static uint8_t test_type_application_close[] = {
     picoquic_frame_type_application_close,
-    0, 0,
+    0,
     0
 };
 
 static uint8_t test_type_application_close_reason[] = {
     picoquic_frame_type_application_close,
-    4, 4,
+    0x44, 0x04,
     4,
     't', 'e', 's', 't'
 };
@@ -100,7 +100,7 @@ static uint8_t test_frame_type_new_connection_id[] = {
 static uint8_t test_frame_type_stop_sending[] = {
     picoquic_frame_type_stop_sending,
     17,
-    0x40, 0
+    0x80, 0, 0x40, 0
 };
 
 static uint8_t test_frame_type_path_challenge[] = {
@@ -378,6 +378,90 @@ int skip_frame_test()
 }
 
 
+/* Reference source symbol: copy the frames one at a time, as the FEC plugin did */
+static size_t source_symbol_reference(picoquic_cnx_t * cnx, uint8_t * bytes, size_t bytes_max, uint8_t * symbol)
+{
+    size_t byte_index = 0;
+    size_t length = 0;
+
+    while (byte_index < bytes_max) {
+        size_t consumed = 0;
+        int pure_ack = 0;
+        uint8_t first_byte = bytes[byte_index];
+
+        if (picoquic_skip_frame(cnx, bytes + byte_index, bytes_max - byte_index, &consumed, &pure_ack) != 0) {
+            break;
+        }
+        if (first_byte != picoquic_frame_type_ack && first_byte != picoquic_frame_type_padding &&
+            first_byte != picoquic_frame_type_crypto_hs) {
+            memcpy(symbol + length, bytes + byte_index, consumed);
+            length += consumed;
+        }
+        byte_index += consumed;
+    }
+
+    return length;
+}
+
+int source_symbol_test()
+{
+    int ret = 0;
+    uint8_t buffer[PICOQUIC_MAX_PACKET_SIZE];
+    uint8_t symbol[PICOQUIC_MAX_PACKET_SIZE];
+    uint8_t expected[PICOQUIC_MAX_PACKET_SIZE];
+    uint64_t random_context = 0x5EED5EED;
+    picoquic_symbol_run_t runs[PICOQUIC_SYMBOL_RUNS_MAX];
+    size_t byte_index = 0;
+
+    picoquic_cnx_t cnx = { 0 };
+    register_protocol_operations(&cnx);
+
+    /* ACK, STREAM, MAX_DATA, padding, PING, crypto: the kept frames form two runs */
+    memcpy(buffer, test_frame_type_ack, sizeof(test_frame_type_ack));
+    byte_index += sizeof(test_frame_type_ack);
+    memcpy(buffer + byte_index, test_frame_type_stream_range_max, sizeof(test_frame_type_stream_range_max));
+    byte_index += sizeof(test_frame_type_stream_range_max);
+    memcpy(buffer + byte_index, test_frame_type_max_data, sizeof(test_frame_type_max_data));
+    byte_index += sizeof(test_frame_type_max_data);
+    memcpy(buffer + byte_index, test_frame_type_padding, sizeof(test_frame_type_padding));
+    byte_index += sizeof(test_frame_type_padding);
+    memcpy(buffer + byte_index, test_frame_type_ping, sizeof(test_frame_type_ping));
+    byte_index += sizeof(test_frame_type_ping);
+    memcpy(buffer + byte_index, test_frame_type_crypto_hs, sizeof(test_frame_type_crypto_hs));
+    byte_index += sizeof(test_frame_type_crypto_hs);
+
+    if (picoquic_source_symbol_runs(&cnx, buffer, byte_index, runs, PICOQUIC_SYMBOL_RUNS_MAX) != 2 ||
+        runs[0].offset != sizeof(test_frame_type_ack) ||
+        runs[0].length != sizeof(test_frame_type_stream_range_max) + sizeof(test_frame_type_max_data) ||
+        runs[1].length != sizeof(test_frame_type_ping)) {
+        DBG_PRINTF("%s", "Unexpected runs for the reference packet\n");
+        ret = -1;
+    } else if (picoquic_source_symbol_runs(&cnx, buffer, byte_index, runs, 1) != -1 ||
+        picoquic_source_symbol_gather(&cnx, buffer, byte_index, symbol, runs[0].length) != 0) {
+        DBG_PRINTF("%s", "The limits on the runs or on the symbol size are not enforced\n");
+        ret = -1;
+    }
+
+    /* Random packets give the same symbols as copying each frame */
+    for (size_t i = 0; ret == 0 && i < 100; i++) {
+        size_t bytes_max = format_random_packet(buffer, sizeof(buffer), &random_context);
+        size_t expected_length = source_symbol_reference(&cnx, buffer, bytes_max, expected);
+        size_t length = picoquic_source_symbol_gather(&cnx, buffer, bytes_max, symbol, sizeof(symbol));
+
+        if (picoquic_source_symbol_runs(&cnx, buffer, bytes_max, runs, PICOQUIC_SYMBOL_RUNS_MAX) < 0) {
+            /* More runs than supported, nothing is gathered */
+            expected_length = 0;
+        }
+        if (length != expected_length || memcmp(symbol, expected, length) != 0) {
+            DBG_PRINTF("Source symbol of packet %d differs, %d bytes instead of %d\n",
+                (int)i, (int)length, (int)expected_length);
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
 int parse_frame_test()
 {
     int ret = 0;
@@ -671,3 +755,201 @@ int logger_test()
 
     return ret;
 }
+
+static char const* binlog_test_bin = "binlog_test.bin";
+static char const* binlog_test_dump = "binlog_test.txt";
+static char const* binlog_test_text = "binlog_text.txt";
+
+static FILE* binlog_test_open(char const* fname, char const* mode)
+{
+    FILE* F = NULL;
+
+#ifdef _WINDOWS
+    if (fopen_s(&F, fname, mode) != 0) {
+        F = NULL;
+    }
+#else
+    F = fopen(fname, mode);
+#endif
+    if (F == NULL) {
+        DBG_PRINTF("Cannot open file %s\n", fname);
+    }
+
+    return F;
+}
+
+static int binlog_test_dump_file()
+{
+    int ret = -1;
+    FILE* F_bin = binlog_test_open(binlog_test_bin, "rb");
+    FILE* F_txt = binlog_test_open(binlog_test_dump, "w");
+
+    if (F_bin != NULL && F_txt != NULL) {
+        ret = picoquic_binlog_dump(F_bin, F_txt);
+        if (ret != 0) {
+            DBG_PRINTF("%s", "Cannot dump the binary trace\n");
+        }
+    }
+    if (F_bin != NULL) {
+        fclose(F_bin);
+    }
+    if (F_txt != NULL) {
+        fclose(F_txt);
+    }
+
+    return ret;
+}
+
+/* The frames of the skip test, dumped from the binary trace, are the same as in the reference text log */
+static int binlog_frames_test()
+{
+    int ret = 0;
+    FILE* F = binlog_test_open(binlog_test_bin, "wb");
+    picoquic_binlog_t* binlog = (F == NULL) ? NULL : picoquic_binlog_open(F);
+
+    if (binlog == NULL) {
+        ret = -1;
+    } else {
+        for (size_t i = 0; i < nb_test_skip_list; i++) {
+            picoquic_binlog_frames(binlog, NULL, 0, test_skip_list[i].val, test_skip_list[i].len);
+        }
+        if (binlog->nb_records != nb_test_skip_list || binlog->nb_dropped != 0) {
+            DBG_PRINTF("%s", "Unexpected number of records\n");
+            ret = -1;
+        }
+    }
+    if (binlog != NULL) {
+        picoquic_binlog_close(binlog);
+    }
+    if (F != NULL) {
+        fclose(F);
+    }
+
+    if (ret == 0) {
+        ret = binlog_test_dump_file();
+    }
+    if (ret == 0) {
+        ret = picoquic_test_compare_files(binlog_test_dump, log_test_ref);
+    }
+
+    return ret;
+}
+
+static size_t binlog_test_payload(uint8_t* bytes, size_t bytes_max)
+{
+    size_t length = 0;
+
+    for (size_t i = 0; i < nb_test_skip_list && length + test_skip_list[i].len <= bytes_max; i++) {
+        memcpy(bytes + length, test_skip_list[i].val, test_skip_list[i].len);
+        length += test_skip_list[i].len;
+    }
+
+    return length;
+}
+
+/* Segments and congestion states of a connection and of stateless packets, interleaved */
+static int binlog_segments_test()
+{
+    int ret = 0;
+    struct sockaddr_in test_addr;
+    uint8_t bytes[PICOQUIC_MAX_PACKET_SIZE];
+    picoquic_packet_header ph;
+    picoquic_cnx_t* cnx = NULL;
+    picoquic_quic_t* quic = NULL;
+    FILE* F_bin = binlog_test_open(binlog_test_bin, "wb");
+    FILE* F_txt = binlog_test_open(binlog_test_text, "w");
+    size_t payload_length;
+    uint64_t current_time = 1000000;
+
+    if (F_bin == NULL || F_txt == NULL) {
+        ret = -1;
+    } else {
+        quic = picoquic_create(8, NULL, NULL, NULL, NULL, NULL, NULL,
+            NULL, NULL, NULL, 0, NULL, NULL, NULL, 0, NULL);
+        if (quic == NULL || picoquic_set_binlog(quic, F_bin) != 0) {
+            DBG_PRINTF("%s", "Cannot set the binary trace\n");
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        memset(&test_addr, 0, sizeof(struct sockaddr_in));
+        test_addr.sin_family = AF_INET;
+        test_addr.sin_port = 12345;
+        cnx = picoquic_create_cnx(quic, picoquic_null_connection_id, picoquic_null_connection_id,
+            (struct sockaddr*)&test_addr, current_time, 0, NULL, NULL, 1);
+        if (cnx == NULL) {
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        memset(bytes, 0, sizeof(bytes));
+        memset(&ph, 0, sizeof(ph));
+        payload_length = binlog_test_payload(bytes + 9, sizeof(bytes) - 9);
+
+        /* Short header of the connection */
+        ph.ptype = picoquic_packet_1rtt_protected_phi0;
+        ph.dest_cnx_id = cnx->path[0]->remote_cnxid;
+        ph.pn = 0x1234;
+        ph.pn64 = 0x1234;
+        ph.offset = 9;
+        ph.payload_length = (uint16_t)payload_length;
+        picoquic_log_decrypted_segment(F_txt, 1, cnx, 1, &ph, bytes, ph.offset + payload_length, 0);
+        picoquic_binlog_segment(quic->binlog, cnx, 1, &ph, bytes, ph.offset + payload_length, 0);
+
+        /* Long header without connection */
+        ph.ptype = picoquic_packet_initial;
+        ph.vn = PICOQUIC_INTERNAL_TEST_VERSION_1;
+        ph.srce_cnx_id = cnx->path[0]->local_cnxid;
+        ph.spin = 1;
+        picoquic_log_decrypted_segment(F_txt, 1, NULL, 0, &ph, bytes, ph.offset + payload_length, 0);
+        picoquic_binlog_segment(quic->binlog, NULL, 0, &ph, bytes, ph.offset + payload_length, 0);
+
+        picoquic_log_congestion_state(F_txt, cnx, current_time + 12345);
+        picoquic_binlog_congestion_state(quic->binlog, cnx, current_time + 12345);
+
+        /* Decryption error */
+        picoquic_log_decrypted_segment(F_txt, 1, NULL, 1, &ph, bytes, ph.offset + payload_length, PICOQUIC_ERROR_AEAD_CHECK);
+        picoquic_binlog_segment(quic->binlog, NULL, 1, &ph, bytes, ph.offset + payload_length, PICOQUIC_ERROR_AEAD_CHECK);
+
+        /* Version negotiation, the versions follow the header */
+        ph.ptype = picoquic_packet_version_negotiation;
+        ph.vn = 0;
+        picoformat_32(bytes + ph.offset, PICOQUIC_INTERNAL_TEST_VERSION_1);
+        picoformat_32(bytes + ph.offset + 4, 0x0a1a2a3a);
+        picoquic_log_decrypted_segment(F_txt, 1, NULL, 1, &ph, bytes, ph.offset + 8, 0);
+        picoquic_binlog_segment(quic->binlog, NULL, 1, &ph, bytes, ph.offset + 8, 0);
+    }
+
+    /* Deleting the connection writes its records, freeing the context closes the trace */
+    if (quic != NULL) {
+        picoquic_free(quic);
+    }
+    if (F_bin != NULL) {
+        fclose(F_bin);
+    }
+    if (F_txt != NULL) {
+        fclose(F_txt);
+    }
+
+    if (ret == 0) {
+        ret = binlog_test_dump_file();
+    }
+    if (ret == 0) {
+        ret = picoquic_test_compare_files(binlog_test_dump, binlog_test_text);
+    }
+
+    return ret;
+}
+
+int binlog_test()
+{
+    int ret = binlog_frames_test();
+
+    if (ret == 0) {
+        ret = binlog_segments_test();
+    }
+
+    return ret;
+}
@@ -0,0 +1,233 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "picoquic_internal.h"
+#include "memory.h"
+#include "slab_memory.h"
+
+#define SLAB_TEST_REGION_SIZE (16 * 1024 * 1024)
+#define SLAB_TEST_NB_OBJECTS 2000
+
+typedef struct {
+    uint8_t *ptr;
+    size_t size;
+} slab_test_object_t;
+
+static uint64_t slab_test_random(uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static int slab_test_check(slab_test_object_t *obj, uint8_t pattern)
+{
+    for (size_t i = 0; i < obj->size; i++) {
+        if (obj->ptr[i] != pattern) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int slab_memory_test()
+{
+    int ret = 0;
+    uint64_t random_state = 0xdeadbeef;
+    uint8_t *region = malloc(SLAB_TEST_REGION_SIZE);
+    slab_test_object_t *objects = calloc(SLAB_TEST_NB_OBJECTS, sizeof(slab_test_object_t));
+    slab_memory_t slab;
+
+    /* Use an unaligned region */
+    if (region == NULL || objects == NULL || slab_memory_init(&slab, region + 3, SLAB_TEST_REGION_SIZE - 3) != 0) {
+        DBG_PRINTF("%s", "Cannot initialize the allocator\n");
+        free(region);
+        free(objects);
+        return -1;
+    }
+
+    /* Freed spans are merged with their free neighbours, in any order */
+    for (int i = 0; i < 3; i++) {
+        objects[i].ptr = slab_malloc(&slab, 2 * SLAB_PAGE_SIZE);
+    }
+    slab_free(&slab, objects[0].ptr);
+    slab_free(&slab, objects[2].ptr);
+    slab_free(&slab, objects[1].ptr);
+    objects[0].ptr = slab_malloc(&slab, (size_t) slab.stats.free_pages * SLAB_PAGE_SIZE);
+    if (objects[0].ptr == NULL || slab.stats.free_pages != 0) {
+        DBG_PRINTF("%s", "The free spans were not merged\n");
+        ret = -1;
+    } else if (slab_malloc(&slab, 1) != NULL || slab.stats.nb_failed_allocs != 1) {
+        DBG_PRINTF("%s", "Allocation succeeded in a full region\n");
+        ret = -1;
+    }
+    slab_free(&slab, objects[0].ptr);
+    memset(objects, 0, 3 * sizeof(slab_test_object_t));
+
+    /* Mix of small and large objects, each filled with its own pattern */
+    for (int i = 0; ret == 0 && i < SLAB_TEST_NB_OBJECTS; i++) {
+        objects[i].size = (i % 50 == 0) ? 4097 + slab_test_random(&random_state) % 40000 : 1 + slab_test_random(&random_state) % SLAB_MAX_SMALL_SIZE;
+        objects[i].ptr = slab_malloc(&slab, objects[i].size);
+        if (objects[i].ptr == NULL || ((uintptr_t) objects[i].ptr % 16) != 0 || slab_usable_size(&slab, objects[i].ptr) < objects[i].size) {
+            DBG_PRINTF("Allocation %d of %zu bytes failed\n", i, objects[i].size);
+            ret = -1;
+        } else {
+            memset(objects[i].ptr, (uint8_t) i, objects[i].size);
+        }
+    }
+
+    /* Free half of them in a random order, then check that no object was overwritten */
+    for (int i = 0; ret == 0 && i < SLAB_TEST_NB_OBJECTS / 2; i++) {
+        int j = (int) (slab_test_random(&random_state) % SLAB_TEST_NB_OBJECTS);
+        if (objects[j].ptr != NULL) {
+            slab_free(&slab, objects[j].ptr);
+            objects[j].ptr = NULL;
+        }
+    }
+    for (int i = 0; ret == 0 && i < SLAB_TEST_NB_OBJECTS; i++) {
+        if (objects[i].ptr != NULL && slab_test_check(&objects[i], (uint8_t) i) != 0) {
+            DBG_PRINTF("Object %d was overwritten\n", i);
+            ret = -1;
+        }
+    }
+
+    /* A pointer inside an object is not freed */
+    for (int i = 0; ret == 0 && i < SLAB_TEST_NB_OBJECTS; i++) {
+        if (objects[i].ptr != NULL && objects[i].size > 16) {
+            uint64_t nb_frees = slab.stats.nb_frees;
+            slab_free(&slab, objects[i].ptr + 16);
+            if (slab.stats.nb_frees != nb_frees || slab_test_check(&objects[i], (uint8_t) i) != 0) {
+                DBG_PRINTF("%s", "Freeing an inner pointer was accepted\n");
+                ret = -1;
+            }
+            break;
+        }
+    }
+
+    /* Growing an object keeps its content */
+    for (int i = 0; ret == 0 && i < SLAB_TEST_NB_OBJECTS; i++) {
+        if (objects[i].ptr != NULL) {
+            objects[i].ptr = slab_realloc(&slab, objects[i].ptr, objects[i].size + SLAB_MAX_SMALL_SIZE);
+            if (objects[i].ptr == NULL || slab_test_check(&objects[i], (uint8_t) i) != 0) {
+                DBG_PRINTF("%s", "Realloc lost the content\n");
+                ret = -1;
+                break;
+            }
+            objects[i].size += SLAB_MAX_SMALL_SIZE;
+            memset(objects[i].ptr, (uint8_t) i, objects[i].size);
+            break;
+        }
+    }
+
+    /* A double free is refused, and the slot is not handed out twice */
+    if (ret == 0) {
+        uint8_t *first = slab_malloc(&slab, 40);
+        uint8_t *second = slab_malloc(&slab, 40);
+        uint64_t nb_frees = slab.stats.nb_frees;
+        uint64_t nb_bad_frees = slab.stats.nb_bad_frees;
+        uint8_t *again[2];
+
+        slab_free(&slab, first);
+        slab_free(&slab, first);
+        again[0] = slab_malloc(&slab, 40);
+        again[1] = slab_malloc(&slab, 40);
+        if (first == NULL || second == NULL || slab.stats.nb_frees != nb_frees + 1 ||
+            slab.stats.nb_bad_frees != nb_bad_frees + 1 || again[0] == NULL || again[0] == again[1] ||
+            again[0] == second || again[1] == second) {
+            DBG_PRINTF("%s", "Double free was accepted\n");
+            ret = -1;
+        }
+        slab_free(&slab, second);
+        slab_free(&slab, again[0]);
+        slab_free(&slab, again[1]);
+    }
+
+    /* Once everything is freed, the spans are merged back */
+    for (int i = 0; i < SLAB_TEST_NB_OBJECTS; i++) {
+        if (objects[i].ptr != NULL) {
+            slab_free(&slab, objects[i].ptr);
+            objects[i].ptr = NULL;
+        }
+    }
+    if (ret == 0 && (slab.stats.bytes_in_use != 0 || slab.stats.large_pages != 0 ||
+        slab.stats.small_pages > SLAB_NB_SIZE_CLASSES || slab.stats.nb_allocs != slab.stats.nb_frees)) {
+        DBG_PRINTF("%s", "Unexpected statistics after freeing everything\n");
+        ret = -1;
+    }
+    slab_memory_destroy(&slab);
+    free(objects);
+    free(region);
+
+    return ret;
+}
+
+/* Allocation pattern of the FEC plugins: small structures along with a repair symbol, released in order */
+#define SLAB_BENCH_ITERATIONS 2000000
+#define SLAB_BENCH_WINDOW 64
+#define SLAB_BENCH_OBJECTS 4
+
+static int slab_bench_manager(plugin_memory_manager_type_t type, const char *name)
+{
+    static const unsigned int sizes[SLAB_BENCH_OBJECTS] = { 24, 48, 120, 1400 };
+    void *window[SLAB_BENCH_WINDOW][SLAB_BENCH_OBJECTS];
+    protoop_plugin_t *p = calloc(1, sizeof(protoop_plugin_t));
+    int ret = 0;
+
+    if (p == NULL) {
+        return -1;
+    }
+    strcpy(p->name, name);
+    p->params.plugin_memory_manager_type = type;
+    if (init_memory_management(p) != 0) {
+        free(p);
+        return -1;
+    }
+
+    memset(window, 0, sizeof(window));
+    uint64_t start = picoquic_current_time();
+    for (int i = 0; ret == 0 && i < SLAB_BENCH_ITERATIONS; i++) {
+        void **slot = window[i % SLAB_BENCH_WINDOW];
+        for (int j = 0; j < SLAB_BENCH_OBJECTS; j++) {
+            if (slot[j] != NULL) {
+                p->memory_manager.my_free(p, slot[j]);
+            }
+            slot[j] = p->memory_manager.my_malloc(p, sizes[j]);
+            if (slot[j] == NULL) {
+                ret = -1;
+                break;
+            }
+        }
+    }
+    uint64_t duration = picoquic_current_time() - start;
+
+    for (int i = 0; i < SLAB_BENCH_WINDOW; i++) {
+        for (int j = 0; j < SLAB_BENCH_OBJECTS; j++) {
+            if (window[i][j] != NULL) {
+                p->memory_manager.my_free(p, window[i][j]);
+            }
+        }
+    }
+    destroy_memory_management(p);
+    free(p);
+
+    if (ret == 0) {
+        printf("%s memory manager: %" PRIu64 " us for %d malloc/free pairs (%" PRIu64 " ns each)\n", name, duration,
+            SLAB_BENCH_ITERATIONS * SLAB_BENCH_OBJECTS, duration * 1000 / (SLAB_BENCH_ITERATIONS * SLAB_BENCH_OBJECTS));
+    } else {
+        printf("%s memory manager: allocation failed\n", name);
+    }
+    return ret;
+}
+
+int slab_memory_bench()
+{
+    int ret = slab_bench_manager(plugin_memory_manager_fixed_blocks, "fixed_blocks");
+    if (ret == 0) {
+        ret = slab_bench_manager(plugin_memory_manager_dynamic, "dynamic");
+    }
+    if (ret == 0) {
+        ret = slab_bench_manager(plugin_memory_manager_slab, "slab");
+    }
+    return ret;
+}
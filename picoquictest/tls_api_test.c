@@ -2901,6 +2901,105 @@ int tls_different_params_test()
     return tls_api_one_scenario_test(test_scenario_very_long, sizeof(test_scenario_very_long), 0, 0, 0, 0, 3510000, &test_parameters);
 }
 
+/*
+ * Testing the ACK frequency extension. The server sends one megabyte; when the
+ * client advertises min_ack_delay, the server asks it to acknowledge less often
+ * and the client sends fewer packets.
+ */
+
+static int ack_frequency_one_test(uint64_t min_ack_delay, uint64_t* nb_client_packets, uint64_t* threshold_sent)
+{
+    uint64_t simulated_time = 0;
+    uint64_t loss_mask = 0;
+    picoquic_tp_t client_parameters;
+    picoquic_test_tls_api_ctx_t* test_ctx = NULL;
+    int ret = tls_api_init_ctx(&test_ctx, PICOQUIC_INTERNAL_TEST_VERSION_1,
+        PICOQUIC_TEST_SNI, PICOQUIC_TEST_ALPN, &simulated_time, NULL, 0, 1, 0);
+
+    if (ret != 0) {
+        DBG_PRINTF("%s", "Could not create the QUIC test contexts\n");
+    }
+
+    if (ret == 0) {
+        memset(&client_parameters, 0, sizeof(picoquic_tp_t));
+        picoquic_init_transport_parameters(&client_parameters, 1);
+        client_parameters.min_ack_delay = min_ack_delay;
+        picoquic_set_transport_parameters(test_ctx->cnx_client, &client_parameters);
+        ret = picoquic_start_client_cnx(test_ctx->cnx_client);
+    }
+
+    if (ret == 0) {
+        ret = tls_api_connection_loop(test_ctx, &loss_mask, 0, &simulated_time);
+    }
+
+    if (ret == 0) {
+        ret = test_api_init_send_recv_scenario(test_ctx, test_scenario_very_long, sizeof(test_scenario_very_long));
+    }
+
+    if (ret == 0) {
+        ret = tls_api_data_sending_loop(test_ctx, &loss_mask, &simulated_time, 0);
+    }
+
+    if (ret == 0) {
+        if (test_ctx->server_callback.error_detected || test_ctx->client_callback.error_detected ||
+            test_ctx->test_stream[0].r_recv_nb != test_ctx->test_stream[0].r_len) {
+            DBG_PRINTF("%s", "Data not received correctly\n");
+            ret = -1;
+        } else {
+            *nb_client_packets = test_ctx->cnx_client->path[0]->pkt_ctx[picoquic_packet_context_application].send_sequence;
+            *threshold_sent = test_ctx->cnx_server->path[0]->ack_frequency_threshold_sent;
+        }
+    }
+
+    if (test_ctx != NULL) {
+        tls_api_delete_ctx(test_ctx);
+        test_ctx = NULL;
+    }
+
+    return ret;
+}
+
+int ack_frequency_test()
+{
+    uint64_t nb_packets_default = 0;
+    uint64_t nb_packets_frequency = 0;
+    uint64_t threshold_default = 0;
+    uint64_t threshold_frequency = 0;
+    picoquic_tp_t default_parameters;
+    int ret;
+
+    /* The extension is opt-in */
+    picoquic_init_transport_parameters(&default_parameters, 1);
+    if (default_parameters.min_ack_delay != 0) {
+        DBG_PRINTF("%s", "min_ack_delay should not be advertised by default\n");
+        return -1;
+    }
+
+    ret = ack_frequency_one_test(0, &nb_packets_default, &threshold_default);
+
+    if (ret == 0) {
+        ret = ack_frequency_one_test(PICOQUIC_ACK_FREQUENCY_MIN_DELAY, &nb_packets_frequency, &threshold_frequency);
+    }
+
+    if (ret == 0 && threshold_default != 0) {
+        DBG_PRINTF("%s", "ACK_FREQUENCY sent although the client did not advertise min_ack_delay\n");
+        ret = -1;
+    }
+
+    if (ret == 0 && threshold_frequency <= 1) {
+        DBG_PRINTF("ACK_FREQUENCY threshold is %" PRIu64 "\n", threshold_frequency);
+        ret = -1;
+    }
+
+    if (ret == 0 && nb_packets_frequency >= nb_packets_default) {
+        DBG_PRINTF("Client sent %" PRIu64 " packets with ACK_FREQUENCY, %" PRIu64 " without\n",
+            nb_packets_frequency, nb_packets_default);
+        ret = -1;
+    }
+
+    return ret;
+}
+
 int set_certificate_and_key_test()
 {
     uint64_t simulated_time = 0;
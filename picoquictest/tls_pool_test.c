@@ -0,0 +1,378 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "picoquic_internal.h"
+#include "picoquictest_internal.h"
+#include "tls_pool.h"
+
+#define TLS_POOL_TEST_NB_JOBS 16
+#define TLS_POOL_TEST_NB_FLOOD 32
+#define TLS_POOL_TEST_MAX_ROUNDS 100000
+
+typedef struct st_tls_pool_test_job_t {
+    picoquic_tls_job_t job;
+    int* blocked; /* The job waits until it is cleared */
+    int nb_runs;
+} tls_pool_test_job_t;
+
+static void tls_pool_test_run(picoquic_tls_job_t* job)
+{
+    tls_pool_test_job_t* test_job = (tls_pool_test_job_t*)job;
+
+    while (test_job->blocked != NULL && __atomic_load_n(test_job->blocked, __ATOMIC_ACQUIRE)) {
+        usleep(100);
+    }
+    test_job->nb_runs++;
+}
+
+static int tls_pool_test_wait(tls_pool_test_job_t* jobs, int nb_jobs)
+{
+    for (int i = 0; i < 10000; i++) {
+        int nb_done = 0;
+        for (int j = 0; j < nb_jobs; j++) {
+            nb_done += picoquic_tls_job_is_done(&jobs[j].job);
+        }
+        if (nb_done == nb_jobs) {
+            return 0;
+        }
+        usleep(1000);
+    }
+
+    return -1;
+}
+
+/* All the submitted jobs run once, the cancelled ones never run */
+static int tls_pool_jobs_test()
+{
+    int ret = 0;
+    int blocked = 1;
+    tls_pool_test_job_t jobs[TLS_POOL_TEST_NB_JOBS];
+    picoquic_tls_pool_stats_t stats;
+    picoquic_tls_pool_t* pool = picoquic_tls_pool_create(2);
+
+    memset(jobs, 0, sizeof(jobs));
+    for (int i = 0; i < TLS_POOL_TEST_NB_JOBS; i++) {
+        jobs[i].job.run = tls_pool_test_run;
+    }
+
+    if (pool == NULL) {
+        DBG_PRINTF("%s", "Cannot create the pool\n");
+        ret = -1;
+    } else {
+        for (int i = 0; i < TLS_POOL_TEST_NB_JOBS; i++) {
+            picoquic_tls_pool_stage(pool, &jobs[i].job);
+        }
+        picoquic_tls_pool_submit(pool);
+
+        if (tls_pool_test_wait(jobs, TLS_POOL_TEST_NB_JOBS) != 0) {
+            DBG_PRINTF("%s", "The jobs did not complete\n");
+            ret = -1;
+        } else {
+            picoquic_tls_pool_get_stats(pool, &stats);
+            for (int i = 0; ret == 0 && i < TLS_POOL_TEST_NB_JOBS; i++) {
+                if (jobs[i].nb_runs != 1) {
+                    DBG_PRINTF("Job %d ran %d times\n", i, jobs[i].nb_runs);
+                    ret = -1;
+                }
+            }
+            if (ret == 0 && (stats.nb_jobs != TLS_POOL_TEST_NB_JOBS || stats.nb_done != TLS_POOL_TEST_NB_JOBS ||
+                stats.nb_cancelled != 0 || stats.max_queued != TLS_POOL_TEST_NB_JOBS)) {
+                DBG_PRINTF("Unexpected statistics, %d jobs, %d done, %d cancelled, %d queued\n", (int)stats.nb_jobs,
+                    (int)stats.nb_done, (int)stats.nb_cancelled, (int)stats.max_queued);
+                ret = -1;
+            }
+        }
+        picoquic_tls_pool_free(pool);
+    }
+
+    /* A single worker, held by the first job: the second one stays queued, the third staged */
+    if (ret == 0 && (pool = picoquic_tls_pool_create(1)) == NULL) {
+        DBG_PRINTF("%s", "Cannot create the pool\n");
+        ret = -1;
+    } else if (ret == 0) {
+        memset(jobs, 0, sizeof(jobs));
+        for (int i = 0; i < 3; i++) {
+            jobs[i].job.run = tls_pool_test_run;
+        }
+        jobs[0].blocked = &blocked;
+        picoquic_tls_pool_stage(pool, &jobs[0].job);
+        picoquic_tls_pool_submit(pool);
+        for (int i = 0; i < 10000 && __atomic_load_n(&jobs[0].job.state, __ATOMIC_RELAXED) != picoquic_tls_job_running; i++) {
+            usleep(100);
+        }
+        picoquic_tls_pool_stage(pool, &jobs[1].job);
+        picoquic_tls_pool_submit(pool);
+        picoquic_tls_pool_stage(pool, &jobs[2].job);
+
+        picoquic_tls_pool_cancel(pool, &jobs[2].job);
+        picoquic_tls_pool_cancel(pool, &jobs[1].job);
+        picoquic_tls_pool_submit(pool);
+        __atomic_store_n(&blocked, 0, __ATOMIC_RELEASE);
+        /* Waits for the running job */
+        picoquic_tls_pool_cancel(pool, &jobs[0].job);
+        picoquic_tls_pool_get_stats(pool, &stats);
+
+        if (!picoquic_tls_job_is_done(&jobs[0].job) || jobs[0].nb_runs != 1 || jobs[1].nb_runs != 0 || jobs[2].nb_runs != 0) {
+            DBG_PRINTF("%s", "The cancelled jobs ran, or the running one did not complete\n");
+            ret = -1;
+        } else if (stats.nb_jobs != 2 || stats.nb_done != 1 || stats.nb_cancelled != 2) {
+            DBG_PRINTF("Unexpected statistics, %d jobs, %d done, %d cancelled\n", (int)stats.nb_jobs,
+                (int)stats.nb_done, (int)stats.nb_cancelled);
+            ret = -1;
+        }
+        picoquic_tls_pool_free(pool);
+    }
+
+    return ret;
+}
+
+/*
+ * A server receives the Initial packets of many new clients, followed by a
+ * packet of an established connection. The time the packet loop spends before
+ * reaching that packet is the delay the handshakes add to the RTT of the
+ * established connection.
+ */
+typedef struct st_tls_pool_flood_ctx_t {
+    picoquic_quic_t* qserver;
+    picoquic_quic_t* qclient;
+    picoquic_cnx_t* cnx_client[TLS_POOL_TEST_NB_FLOOD + 1]; /* The first one is established */
+    struct sockaddr_in client_addr[TLS_POOL_TEST_NB_FLOOD + 1];
+    struct sockaddr_in server_addr;
+    uint64_t simulated_time;
+} tls_pool_flood_ctx_t;
+
+static void tls_pool_test_callback(picoquic_cnx_t* cnx,
+    uint64_t stream_id, uint8_t* bytes, size_t length,
+    picoquic_call_back_event_t fin_or_event, void* callback_ctx)
+{
+}
+
+static void tls_pool_test_addr(struct sockaddr_in* addr, uint32_t host, uint16_t port)
+{
+    memset(addr, 0, sizeof(struct sockaddr_in));
+    addr->sin_family = AF_INET;
+#ifdef _WINDOWS
+    addr->sin_addr.S_un.S_addr = host;
+#else
+    addr->sin_addr.s_addr = host;
+#endif
+    addr->sin_port = port;
+}
+
+static uint64_t tls_pool_test_thread_time()
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+
+    return ((uint64_t)ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* Sends a packet of a client to the server, returns its length */
+static size_t tls_pool_flood_client_send(tls_pool_flood_ctx_t* ctx, int i)
+{
+    uint8_t bytes[PICOQUIC_MAX_PACKET_SIZE];
+    size_t length = 0;
+    picoquic_path_t* path = NULL;
+    int new_context_created = 0;
+
+    if (ctx->cnx_client[i] != NULL && picoquic_prepare_packet(ctx->cnx_client[i], ctx->simulated_time,
+        bytes, sizeof(bytes), &length, &path) == 0 && length > 0) {
+        (void)picoquic_incoming_packet(ctx->qserver, bytes, (uint32_t)length,
+            (struct sockaddr*)&ctx->client_addr[i], (struct sockaddr*)&ctx->server_addr, 0,
+            ctx->simulated_time, &new_context_created);
+    }
+
+    return length;
+}
+
+/* Exchanges the packets of all the connections, returns 1 if something was sent */
+static int tls_pool_flood_round(tls_pool_flood_ctx_t* ctx)
+{
+    int was_active = 0;
+    uint8_t bytes[PICOQUIC_MAX_PACKET_SIZE];
+    picoquic_stateless_packet_t* sp;
+
+    for (int i = 0; i <= TLS_POOL_TEST_NB_FLOOD; i++) {
+        while (tls_pool_flood_client_send(ctx, i) > 0) {
+            was_active = 1;
+        }
+    }
+
+    while ((sp = picoquic_dequeue_stateless_packet(ctx->qserver)) != NULL) {
+        picoquic_delete_stateless_packet(sp);
+    }
+
+    for (picoquic_cnx_t* cnx = picoquic_get_first_cnx(ctx->qserver); cnx != NULL; cnx = picoquic_get_next_cnx(cnx)) {
+        size_t length = 0;
+        picoquic_path_t* path = NULL;
+        int new_context_created = 0;
+
+        while (picoquic_prepare_packet(cnx, ctx->simulated_time, bytes, sizeof(bytes), &length, &path) == 0 && length > 0) {
+            (void)picoquic_incoming_packet(ctx->qclient, bytes, (uint32_t)length,
+                (struct sockaddr*)&ctx->server_addr, (struct sockaddr*)&path->peer_addr, 0,
+                ctx->simulated_time, &new_context_created);
+            was_active = 1;
+        }
+    }
+
+    return was_active;
+}
+
+static int tls_pool_flood_connected(tls_pool_flood_ctx_t* ctx, int nb_clients)
+{
+    int nb_server_ready = 0;
+
+    for (int i = 0; i < nb_clients; i++) {
+        if (ctx->cnx_client[i] == NULL || picoquic_get_cnx_state(ctx->cnx_client[i]) != picoquic_state_client_ready) {
+            return 0;
+        }
+    }
+    for (picoquic_cnx_t* cnx = picoquic_get_first_cnx(ctx->qserver); cnx != NULL; cnx = picoquic_get_next_cnx(cnx)) {
+        nb_server_ready += (picoquic_get_cnx_state(cnx) == picoquic_state_server_ready);
+    }
+
+    return nb_server_ready >= nb_clients;
+}
+
+static int tls_pool_flood_connect(tls_pool_flood_ctx_t* ctx, int nb_clients)
+{
+    for (int round = 0; round < TLS_POOL_TEST_MAX_ROUNDS; round++) {
+        if (tls_pool_flood_connected(ctx, nb_clients)) {
+            return 0;
+        }
+        if (!tls_pool_flood_round(ctx) && ctx->qserver->nb_tls_parked > 0) {
+            /* Let the workers run */
+            usleep(100);
+        }
+        ctx->simulated_time += 1000;
+    }
+
+    return -1;
+}
+
+static int tls_pool_flood_create_client(tls_pool_flood_ctx_t* ctx, int i)
+{
+    ctx->cnx_client[i] = picoquic_create_cnx(ctx->qclient, picoquic_null_connection_id, picoquic_null_connection_id,
+        (struct sockaddr*)&ctx->server_addr, ctx->simulated_time, 0, PICOQUIC_TEST_SNI, PICOQUIC_TEST_ALPN, 1);
+
+    return (ctx->cnx_client[i] == NULL) ? -1 : picoquic_start_client_cnx(ctx->cnx_client[i]);
+}
+
+static int tls_pool_flood_one(int nb_threads, uint64_t* loop_time)
+{
+    int ret = 0;
+    tls_pool_flood_ctx_t ctx;
+    picoquic_tls_pool_stats_t stats;
+    uint64_t start_time;
+
+    memset(&ctx, 0, sizeof(ctx));
+    tls_pool_test_addr(&ctx.server_addr, 0x0A000001, 4321);
+    for (int i = 0; i <= TLS_POOL_TEST_NB_FLOOD; i++) {
+        tls_pool_test_addr(&ctx.client_addr[i], 0x0A000002, (uint16_t)(1234 + i));
+    }
+
+    ctx.qclient = picoquic_create(TLS_POOL_TEST_NB_FLOOD + 1, NULL, NULL, PICOQUIC_TEST_CERT_STORE, NULL,
+        tls_pool_test_callback, NULL, NULL, NULL, NULL, ctx.simulated_time, &ctx.simulated_time, NULL, NULL, 0, NULL);
+    ctx.qserver = picoquic_create(TLS_POOL_TEST_NB_FLOOD + 1, PICOQUIC_TEST_SERVER_CERT, PICOQUIC_TEST_SERVER_KEY,
+        PICOQUIC_TEST_CERT_STORE, PICOQUIC_TEST_ALPN, tls_pool_test_callback, NULL, NULL, NULL, NULL,
+        ctx.simulated_time, &ctx.simulated_time, NULL, NULL, 0, NULL);
+
+    if (ctx.qclient == NULL || ctx.qserver == NULL || picoquic_set_async_handshake(ctx.qserver, nb_threads) != 0 ||
+        tls_pool_flood_create_client(&ctx, 0) != 0 || tls_pool_flood_connect(&ctx, 1) != 0) {
+        DBG_PRINTF("%s", "Cannot establish the first connection\n");
+        ret = -1;
+    }
+
+    for (int i = 1; ret == 0 && i <= TLS_POOL_TEST_NB_FLOOD; i++) {
+        ret = tls_pool_flood_create_client(&ctx, i);
+    }
+
+    if (ret == 0) {
+        uint8_t data[8] = { 0 };
+        uint8_t initials[TLS_POOL_TEST_NB_FLOOD][PICOQUIC_MAX_PACKET_SIZE];
+        size_t initial_length[TLS_POOL_TEST_NB_FLOOD];
+
+        for (int i = 0; i < TLS_POOL_TEST_NB_FLOOD; i++) {
+            picoquic_path_t* path = NULL;
+            if (picoquic_prepare_packet(ctx.cnx_client[i + 1], ctx.simulated_time, initials[i],
+                PICOQUIC_MAX_PACKET_SIZE, &initial_length[i], &path) != 0 || initial_length[i] == 0) {
+                DBG_PRINTF("Cannot prepare the Initial of client %d\n", i + 1);
+                ret = -1;
+                break;
+            }
+        }
+
+        if (ret == 0) {
+            ret = picoquic_add_to_stream(ctx.cnx_client[0], 4, data, sizeof(data), 0);
+        }
+
+        if (ret == 0) {
+            start_time = tls_pool_test_thread_time();
+            for (int i = 0; i < TLS_POOL_TEST_NB_FLOOD; i++) {
+                int new_context_created = 0;
+                (void)picoquic_incoming_packet(ctx.qserver, initials[i], (uint32_t)initial_length[i],
+                    (struct sockaddr*)&ctx.client_addr[i + 1], (struct sockaddr*)&ctx.server_addr, 0,
+                    ctx.simulated_time, &new_context_created);
+            }
+            if (tls_pool_flood_client_send(&ctx, 0) == 0) {
+                DBG_PRINTF("%s", "The established connection did not send its data\n");
+                ret = -1;
+            }
+            *loop_time = tls_pool_test_thread_time() - start_time;
+        }
+    }
+
+    if (ret == 0 && tls_pool_flood_connect(&ctx, TLS_POOL_TEST_NB_FLOOD + 1) != 0) {
+        DBG_PRINTF("%d threads, the handshakes did not complete\n", nb_threads);
+        ret = -1;
+    }
+
+    if (ret == 0 && nb_threads > 0) {
+        if (picoquic_get_async_handshake_stats(ctx.qserver, &stats) != 0 ||
+            stats.nb_done < TLS_POOL_TEST_NB_FLOOD + 1 || ctx.qserver->nb_tls_parked != 0) {
+            DBG_PRINTF("%s", "The handshakes did not run in the pool\n");
+            ret = -1;
+        }
+    }
+
+    if (ctx.qclient != NULL) {
+        picoquic_free(ctx.qclient);
+    }
+    if (ctx.qserver != NULL) {
+        picoquic_free(ctx.qserver);
+    }
+
+    return ret;
+}
+
+static int tls_pool_flood_test()
+{
+    uint64_t sync_time = 0;
+    uint64_t async_time = 0;
+    int ret = tls_pool_flood_one(0, &sync_time);
+
+    if (ret == 0) {
+        ret = tls_pool_flood_one(2, &async_time);
+    }
+
+    if (ret == 0 && async_time * 4 > sync_time) {
+        DBG_PRINTF("The flood delays the established connection by %dus, %dus without the pool\n",
+            (int)async_time, (int)sync_time);
+        ret = -1;
+    }
+
+    return ret;
+}
+
+int tls_pool_test()
+{
+    int ret = tls_pool_jobs_test();
+
+    if (ret == 0) {
+        ret = tls_pool_flood_test();
+    }
+
+    return ret;
+}
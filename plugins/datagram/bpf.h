@@ -18,6 +18,9 @@
 #define SEND_BUFFER 900000
 #define RECV_BUFFER 500000
 
+#define MESSAGE_RING_SIZE (1 << 20)
+#define MAX_RING_MESSAGE 2048
+
 #ifdef DATAGRAM_CONGESTION_CONTROLLED
 #define DCC true
 #else
@@ -38,6 +41,8 @@ typedef struct st_received_datagram_t {
 
 typedef struct st_datagram_memory_t {
     int socket_fds[2];  // TODO: When to free this socket ?
+    uint8_t *ring_buffer;  /* When set, received datagrams are pushed on the rings of the plugin instead of the socket.
+                            * Holds one message popped from the PLUGIN_RING_FROM_APP ring. */
     uint64_t next_datagram_id;
     uint64_t expected_datagram_id;
     received_datagram_t *datagram_buffer;
@@ -107,8 +112,21 @@ static __attribute__((always_inline)) uint64_t get_max_rtt_difference(picoquic_c
 }
 
 static __attribute__((always_inline)) protoop_arg_t send_datagram_to_application(datagram_memory_t *m, picoquic_cnx_t *cnx, datagram_frame_t *frame) {
-    ssize_t ret = write(m->socket_fds[PLUGIN_SOCKET], frame->datagram_data_ptr, frame->length);
-    PROTOOP_PRINTF(cnx, "Wrote %d bytes to the message socket\n", ret);
+    ssize_t ret;
+    if (m->ring_buffer != NULL) {
+        /* The ring only takes data lying in the plugin memory, the frame may point in the packet */
+        uint8_t *data = (uint8_t *) my_malloc(cnx, (unsigned int) (frame->length > 0 ? frame->length : 1));
+        ret = -1;
+        if (data != NULL) {
+            my_memcpy(data, frame->datagram_data_ptr, frame->length);
+            ret = plugin_ring_push(cnx, PLUGIN_RING_TO_APP, data, (uint32_t) frame->length) == 0 ? (ssize_t) frame->length : -1;
+            my_free(cnx, data);
+        }
+        PROTOOP_PRINTF(cnx, "Pushed %d bytes to the message ring\n", ret);
+    } else {
+        ret = write(m->socket_fds[PLUGIN_SOCKET], frame->datagram_data_ptr, frame->length);
+        PROTOOP_PRINTF(cnx, "Wrote %d bytes to the message socket\n", ret);
+    }
     //picoquic_reinsert_cnx_by_wake_time(cnx, picoquic_current_time());
     reserve_frame_slot_t *slot = my_malloc(cnx, sizeof(reserve_frame_slot_t));
     my_memset(slot, 0, sizeof(reserve_frame_slot_t));
@@ -220,4 +238,65 @@ static __attribute__((always_inline)) void *my_malloc_on_sending_buffer(datagram
         p = my_malloc(cnx, size);
     }
     return p;
-}
\ No newline at end of file
+}
+
+static __attribute__((always_inline)) protoop_arg_t queue_datagram(datagram_memory_t *m, picoquic_cnx_t *cnx, char *payload, int len)
+{
+    uint64_t datagram_id = 0;
+    uint32_t max_path_mtu = get_max_datagram_size(cnx);
+    if (len > max_path_mtu) {
+        PROTOOP_PRINTF(cnx, "Unable to send %d-byte long message, max known payload transmission unit is %d bytes\n", len, max_path_mtu);
+        return 1;
+    }
+
+    reserve_frame_slot_t *slot = (reserve_frame_slot_t *) my_malloc_on_sending_buffer(m, cnx, sizeof(reserve_frame_slot_t));
+    if (slot == NULL) {
+        //PROTOOP_PRINTF(cnx, "Unable to allocate frame slot!\n");
+        return 1;
+    }
+    my_memset(slot, 0, sizeof(reserve_frame_slot_t));
+#ifdef DATAGRAM_WITH_ID
+    datagram_id = ++m->next_datagram_id;
+    slot->frame_type = FT_DATAGRAM | FT_DATAGRAM_ID | FT_DATAGRAM_LEN;
+    slot->nb_bytes = 1 + varint_len(datagram_id) + varint_len(len) + len;  // Unfortunately we are always forced to account for the length field
+#else
+    slot->frame_type = FT_DATAGRAM | FT_DATAGRAM_LEN;
+    slot->nb_bytes = 1 + varint_len(len) + len;  // Unfortunately we are always forced to account for the length field
+#endif
+    slot->is_congestion_controlled = DCC;
+
+    datagram_frame_t* frame = my_malloc_on_sending_buffer(m, cnx, sizeof(datagram_frame_t));
+    if (frame == NULL) {
+        //PROTOOP_PRINTF(cnx, "Unable to allocate frame structure!\n");
+        my_free(cnx, slot);
+        return 1;
+    }
+    frame->datagram_data_ptr = my_malloc_on_sending_buffer(m, cnx, (unsigned int) len);
+    if (frame->datagram_data_ptr == NULL) {
+        //PROTOOP_PRINTF(cnx, "Unable to allocate frame slot!\n");
+        my_free(cnx, frame);
+        my_free(cnx, slot);
+        return 1;
+    }
+
+    frame->length = (uint64_t) len;
+    while (m->send_buffer + frame->length > SEND_BUFFER) {
+        free_head_datagram_reserved(m, cnx);
+    }
+
+    frame->datagram_id = datagram_id;
+    my_memcpy(frame->datagram_data_ptr, payload, (size_t) len);
+    slot->frame_ctx = frame;
+
+    size_t reserved_size = reserve_frames(cnx, 1, slot);
+    if (reserved_size < slot->nb_bytes) {
+        //PROTOOP_PRINTF(cnx, "Unable to reserve frame slot\n");
+        my_free(cnx, frame->datagram_data_ptr);
+        my_free(cnx, frame);
+        my_free(cnx, slot);
+        return 1;
+    }
+    m->send_buffer += frame->length;
+    PROTOOP_PRINTF(cnx, "Send buffer size %d\n", m->send_buffer);
+    return 0;
+}
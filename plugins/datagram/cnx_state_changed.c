@@ -15,6 +15,11 @@ protoop_arg_t state_changed(picoquic_cnx_t *cnx)
             close(m->socket_fds[APP_SOCKET]);
             m->socket_fds[APP_SOCKET] = -1;
         }
+        if (m->ring_buffer != NULL) {
+            plugin_ring_close(cnx);
+            my_free(cnx, m->ring_buffer);
+            m->ring_buffer = NULL;
+        }
     }
     return 0;
 }
\ No newline at end of file
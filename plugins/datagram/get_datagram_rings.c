@@ -0,0 +1,24 @@
+#include "../helpers.h"
+#include "bpf.h"
+
+/**
+ * Opens the message rings of the plugin, that the application gets with plugin_get_ring.
+ * Returns 0 if they are open, -1 otherwise.
+ * Once called, received datagrams are no longer written on the message socket.
+ */
+protoop_arg_t get_datagram_rings(picoquic_cnx_t* cnx)
+{
+    datagram_memory_t *m = get_datagram_memory(cnx);
+    if (m->ring_buffer == NULL) {
+        m->ring_buffer = (uint8_t *) my_malloc(cnx, MAX_RING_MESSAGE);
+        if (m->ring_buffer == NULL || plugin_ring_open(cnx, MESSAGE_RING_SIZE) != 0) {
+            PROTOOP_PRINTF(cnx, "Failed to allocate message rings!\n");
+            if (m->ring_buffer != NULL) {
+                my_free(cnx, m->ring_buffer);
+                m->ring_buffer = NULL;
+            }
+            return (protoop_arg_t) -1;
+        }
+    }
+    return 0;
+}
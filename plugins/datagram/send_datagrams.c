@@ -0,0 +1,26 @@
+#include "../helpers.h"
+#include "bpf.h"
+
+/**
+ * Queues all the datagrams pushed by the application on the PLUGIN_RING_FROM_APP ring.
+ * Returns the number of datagrams that could not be queued.
+ */
+protoop_arg_t send_datagrams(picoquic_cnx_t* cnx)
+{
+    datagram_memory_t *m = get_datagram_memory(cnx);
+    protoop_arg_t nb_failed = 0;
+    int len;
+    if (m->ring_buffer == NULL) {
+        return 0;
+    }
+    while ((len = plugin_ring_pop(cnx, PLUGIN_RING_FROM_APP, m->ring_buffer, MAX_RING_MESSAGE)) != 0) {
+        if (len < 0) {
+            /* Cannot be sent as a datagram anyway, skip it */
+            plugin_ring_skip(cnx, PLUGIN_RING_FROM_APP);
+            nb_failed++;
+        } else if (queue_datagram(m, cnx, (char *) m->ring_buffer, len) != 0) {
+            nb_failed++;
+        }
+    }
+    return nb_failed;
+}
@@ -265,7 +265,7 @@ static __attribute__((always_inline)) void free_repair_symbol(picoquic_cnx_t *cn
     my_free(cnx, s);
 }
 
-static __attribute__((always_inline)) void free_fec_block(picoquic_cnx_t *cnx, fec_block_t *b, bool keep_repair_symbols) {
+static __attribute__((always_inline)) void free_fec_block_symbols(picoquic_cnx_t *cnx, fec_block_t *b, bool keep_repair_symbols) {
     int i = 0;
     for (i = 0 ; i < MAX_SYMBOLS_PER_FEC_BLOCK && b->current_source_symbols > 0; i++) {
         if (b->source_symbols[i]) {
@@ -285,6 +285,10 @@ static __attribute__((always_inline)) void free_fec_block(picoquic_cnx_t *cnx, f
             }
         }
     }
+}
+
+static __attribute__((always_inline)) void free_fec_block(picoquic_cnx_t *cnx, fec_block_t *b, bool keep_repair_symbols) {
+    free_fec_block_symbols(cnx, b, keep_repair_symbols);
     my_free(cnx, b);
 }
 
@@ -306,4 +310,153 @@ static __attribute__((always_inline)) bool add_source_symbol_to_fec_block(source
     }
     return false;
 }
+#define FEC_BUFFER_POOL_MAX 32
+// payload of the FEC frames reserved by the sender frameworks
+#define FEC_FRAME_PAYLOAD_SIZE (PICOQUIC_MAX_PACKET_SIZE - (1 + sizeof(fec_frame_header_t)))
+// largest symbol built from a packet payload, see schedule_frames_on_path
+#define FEC_POOLED_SYMBOL_SIZE (PICOQUIC_MAX_PACKET_SIZE + 1 + sizeof(uint64_t))
+
+// Free objects of a single kind, kept for reuse instead of being returned to the plugin memory
+typedef struct {
+    void *objects[FEC_BUFFER_POOL_MAX];
+    uint8_t nb_objects;
+    uint8_t capacity;
+} fec_buffer_pool_t;
+
+// The sender allocates a FEC block, repair symbols, FEC frames and frame slots for every generation and
+// releases them once the frames are written. They are recycled here, up to what one generation needs.
+typedef struct {
+    fec_buffer_pool_t frames;           // fec_frame_t, with a FEC_FRAME_PAYLOAD_SIZE payload
+    fec_buffer_pool_t slots;            // reserve_frame_slot_t
+    fec_buffer_pool_t blocks;           // fec_block_t
+    fec_buffer_pool_t repair_symbols;   // repair_symbol_t, with a FEC_POOLED_SYMBOL_SIZE payload
+    uint64_t nb_allocs;                 // objects taken from the plugin memory
+    uint64_t nb_allocs_avoided;         // objects taken from a pool instead
+} fec_buffers_t;
+
+// n repair and source symbols per generation, of which k are source symbols. Called each time the controller
+// gives the parameters of a new generation: the pools keep what it needs, the objects beyond are freed
+static __attribute__((always_inline)) void size_fec_buffers(picoquic_cnx_t *cnx, fec_buffers_t *b, uint8_t n, uint8_t k) {
+    uint8_t nrs = (n > k) ? n - k : 0;
+    if (nrs > FEC_BUFFER_POOL_MAX) nrs = FEC_BUFFER_POOL_MAX;
+    // without repair symbol, no block is protected and none is worth keeping
+    b->blocks.capacity = (nrs > 0) ? 1 : 0;
+    while (b->blocks.nb_objects > b->blocks.capacity) {
+        my_free(cnx, b->blocks.objects[--b->blocks.nb_objects]);
+    }
+    if (nrs == b->repair_symbols.capacity)
+        return;
+    b->frames.capacity = nrs;
+    b->slots.capacity = nrs;
+    b->repair_symbols.capacity = nrs;
+    while (b->frames.nb_objects > nrs) {
+        fec_frame_t *ff = (fec_frame_t *) b->frames.objects[--b->frames.nb_objects];
+        my_free(cnx, ff->data);
+        my_free(cnx, ff);
+    }
+    while (b->slots.nb_objects > nrs) {
+        my_free(cnx, b->slots.objects[--b->slots.nb_objects]);
+    }
+    while (b->repair_symbols.nb_objects > nrs) {
+        free_repair_symbol(cnx, (repair_symbol_t *) b->repair_symbols.objects[--b->repair_symbols.nb_objects]);
+    }
+}
+
+static __attribute__((always_inline)) void *fec_pool_get(fec_buffers_t *b, fec_buffer_pool_t *pool) {
+    if (pool->nb_objects == 0) {
+        b->nb_allocs++;
+        return NULL;
+    }
+    b->nb_allocs_avoided++;
+    return pool->objects[--pool->nb_objects];
+}
+
+// returns false if the pool is full, the object must then be freed
+static __attribute__((always_inline)) bool fec_pool_put(fec_buffer_pool_t *pool, void *object) {
+    if (pool->nb_objects >= pool->capacity)
+        return false;
+    pool->objects[pool->nb_objects++] = object;
+    return true;
+}
+
+static __attribute__((always_inline)) fec_frame_t *get_pooled_fec_frame(picoquic_cnx_t *cnx, fec_buffers_t *b) {
+    fec_frame_t *ff = (fec_frame_t *) fec_pool_get(b, &b->frames);
+    if (ff)
+        return ff;
+    ff = (fec_frame_t *) my_malloc(cnx, sizeof(fec_frame_t));
+    if (!ff)
+        return NULL;
+    ff->data = (uint8_t *) my_malloc(cnx, FEC_FRAME_PAYLOAD_SIZE);
+    if (!ff->data) {
+        my_free(cnx, ff);
+        return NULL;
+    }
+    return ff;
+}
+
+static __attribute__((always_inline)) void release_pooled_fec_frame(picoquic_cnx_t *cnx, fec_buffers_t *b, fec_frame_t *ff) {
+    if (!fec_pool_put(&b->frames, ff)) {
+        my_free(cnx, ff->data);
+        my_free(cnx, ff);
+    }
+}
+
+static __attribute__((always_inline)) reserve_frame_slot_t *get_pooled_frame_slot(picoquic_cnx_t *cnx, fec_buffers_t *b) {
+    reserve_frame_slot_t *slot = (reserve_frame_slot_t *) fec_pool_get(b, &b->slots);
+    if (!slot) {
+        slot = (reserve_frame_slot_t *) my_malloc(cnx, sizeof(reserve_frame_slot_t));
+        if (!slot)
+            return NULL;
+    }
+    my_memset(slot, 0, sizeof(reserve_frame_slot_t));
+    return slot;
+}
+
+static __attribute__((always_inline)) void release_pooled_frame_slot(picoquic_cnx_t *cnx, fec_buffers_t *b, reserve_frame_slot_t *slot) {
+    if (!fec_pool_put(&b->slots, slot))
+        my_free(cnx, slot);
+}
+
+static __attribute__((always_inline)) fec_block_t *get_pooled_fec_block(picoquic_cnx_t *cnx, fec_buffers_t *b, uint32_t fbn) {
+    fec_block_t *fb = (fec_block_t *) fec_pool_get(b, &b->blocks);
+    if (!fb)
+        return malloc_fec_block(cnx, fbn);
+    my_memset(fb, 0, sizeof(fec_block_t));
+    fb->fec_block_number = fbn;
+    return fb;
+}
+
+// only releases the block, not its symbols
+static __attribute__((always_inline)) void release_pooled_fec_block(picoquic_cnx_t *cnx, fec_buffers_t *b, fec_block_t *fb) {
+    if (!fec_pool_put(&b->blocks, fb))
+        my_free(cnx, fb);
+}
+
+static __attribute__((always_inline)) repair_symbol_t *get_pooled_repair_symbol(picoquic_cnx_t *cnx, fec_buffers_t *b, repair_fpid_t repair_fpid,
+                                                    uint16_t size) {
+    if (size > FEC_POOLED_SYMBOL_SIZE)
+        return malloc_repair_symbol(cnx, repair_fpid, size);
+    repair_symbol_t *s = (repair_symbol_t *) fec_pool_get(b, &b->repair_symbols);
+    if (!s) {
+        s = (repair_symbol_t *) my_malloc(cnx, sizeof(repair_symbol_t));
+        if (!s)
+            return NULL;
+        s->data = (uint8_t *) my_malloc(cnx, FEC_POOLED_SYMBOL_SIZE);
+        if (!s->data) {
+            my_free(cnx, s);
+            return NULL;
+        }
+    }
+    my_memset(s->data, 0, size);
+    s->repair_fec_payload_id = repair_fpid;
+    s->data_length = size;
+    return s;
+}
+
+// the symbol must come from get_pooled_repair_symbol: malloc_repair_symbol only allocates data_length bytes,
+// and such a buffer must never enter the pool, whose symbols are handed out for up to FEC_POOLED_SYMBOL_SIZE bytes
+static __attribute__((always_inline)) void release_pooled_repair_symbol(picoquic_cnx_t *cnx, fec_buffers_t *b, repair_symbol_t *s) {
+    if (s->data_length > FEC_POOLED_SYMBOL_SIZE || !fec_pool_put(&b->repair_symbols, s))
+        free_repair_symbol(cnx, s);
+}
 #endif
\ No newline at end of file
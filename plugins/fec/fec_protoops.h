@@ -38,8 +38,22 @@ typedef struct {
     uint8_t *written_sfpid_frame;            // set by write_sfpid_frame to the address of the sfpid frame written in the packet, used to undo a packet protection
     fec_block_t *fec_blocks[MAX_FEC_BLOCKS]; // ring buffer
     recovered_packets_buffer_t recovered_packets;
+    fec_buffers_t buffers;                   // recycled sender objects
 } bpf_state;
 
+static __attribute__((always_inline)) int get_redundancy_parameters(picoquic_cnx_t *cnx, fec_redundancy_controller_t controller, bool flush, uint8_t *n, uint8_t *k){
+    protoop_arg_t out[2];
+    protoop_arg_t args[2] = {(protoop_arg_t) controller, flush};
+    int ret = (int) run_noparam(cnx, "get_redundancy_parameters", 2, args, out);
+    if (ret) {
+        PROTOOP_PRINTF(cnx, "ERROR WHEN GETTING REDUNDANCY PARAMETERS\n");
+        return -1;
+    }
+    if (n) *n = (uint8_t) out[0];
+    if (k) *k = (uint8_t) out[1];
+    return 0;
+}
+
 static __attribute__((always_inline)) bpf_state *initialize_bpf_state(picoquic_cnx_t *cnx)
 {
     bpf_state *state = (bpf_state *) my_malloc(cnx, sizeof(bpf_state));
@@ -61,6 +75,10 @@ static __attribute__((always_inline)) bpf_state *initialize_bpf_state(picoquic_c
         my_free(cnx, state);
         return NULL;
     }
+    uint8_t n = 0, k = 0;
+    if (!get_redundancy_parameters(cnx, state->controller, false, &n, &k)) {
+        size_fec_buffers(cnx, &state->buffers, n, k);
+    }
     state->scheme_receiver = (fec_scheme_t) schemes[0];
     state->scheme_sender = (fec_scheme_t) schemes[1];
     protoop_arg_t args[3];
@@ -89,6 +107,15 @@ static __attribute__((always_inline)) bpf_state *get_bpf_state(picoquic_cnx_t *c
     return state_ptr;
 }
 
+// get_redundancy_parameters for a new generation, the sender pools follow the parameters given by the controller
+static __attribute__((always_inline)) int get_generation_parameters(picoquic_cnx_t *cnx, fec_redundancy_controller_t controller, bool flush, uint8_t *n, uint8_t *k){
+    int ret = get_redundancy_parameters(cnx, controller, flush, n, k);
+    if (!ret) {
+        size_fec_buffers(cnx, &get_bpf_state(cnx)->buffers, *n, *k);
+    }
+    return ret;
+}
+
 static __attribute__((always_inline)) int helper_write_source_fpid_frame(picoquic_cnx_t *cnx, source_fpid_frame_t *f, uint8_t *bytes, size_t bytes_max, size_t *consumed) {
     if (bytes_max <  (1 + sizeof(source_fpid_t)))
         return PICOQUIC_ERROR_FRAME_BUFFER_TOO_SMALL;
@@ -105,19 +132,6 @@ static __attribute__((always_inline)) void remove_and_free_fec_block_at(picoquic
     state->fec_blocks[where % MAX_FEC_BLOCKS] = NULL;
 }
 
-static __attribute__((always_inline)) int get_redundancy_parameters(picoquic_cnx_t *cnx, fec_redundancy_controller_t controller, bool flush, uint8_t *n, uint8_t *k){
-    protoop_arg_t out[2];
-    protoop_arg_t args[2] = {(protoop_arg_t) controller, flush};
-    int ret = (int) run_noparam(cnx, "get_redundancy_parameters", 2, args, out);
-    if (ret) {
-        PROTOOP_PRINTF(cnx, "ERROR WHEN GETTING REDUNDANCY PARAMETERS\n");
-        return -1;
-    }
-    if (n) *n = (uint8_t) out[0];
-    if (k) *k = (uint8_t) out[1];
-    return 0;
-}
-
 
 static __attribute__((always_inline)) void enqueue_recovered_packet_to_buffer(recovered_packets_buffer_t *b, uint64_t packet) {
     b->packet_numbers[(b->start + b->size) % MAX_RECOVERED_PACKETS_IN_BUFFER] = packet;
@@ -184,13 +198,11 @@ static __attribute__((always_inline)) void maybe_notify_recovered_packets_to_cc(
 }
 
 // protects the packet and writes the source_fpid
-static __attribute__((always_inline)) int protect_packet(picoquic_cnx_t *cnx, source_fpid_t *source_fpid, uint8_t *data, uint16_t length){
+// the source symbol is given to the framework, or freed if an error occurs
+static __attribute__((always_inline)) int protect_packet_source_symbol(picoquic_cnx_t *cnx, source_fpid_t *source_fpid, source_symbol_t *ss){
     bpf_state *state = get_bpf_state(cnx);
 
-    source_symbol_t *ss = malloc_source_symbol_with_data(cnx, *source_fpid, data, length);
-    if (!ss)
-        return PICOQUIC_ERROR_MEMORY;
-    PROTOOP_PRINTF(cnx, "PROTECT PACKET OF SIZE %u\n", (unsigned long) length);
+    PROTOOP_PRINTF(cnx, "PROTECT PACKET OF SIZE %u\n", (unsigned long) ss->data_length);
     // protect_source_symbol lets the underlying sender-side FEC Framework protect the source symbol
     // the SFPID of the SS is set by protect_source_symbol
     protoop_arg_t params[2];
@@ -208,6 +220,13 @@ static __attribute__((always_inline)) int protect_packet(picoquic_cnx_t *cnx, so
     return 0;
 }
 
+static __attribute__((always_inline)) int protect_packet(picoquic_cnx_t *cnx, source_fpid_t *source_fpid, uint8_t *data, uint16_t length){
+    source_symbol_t *ss = malloc_source_symbol_with_data(cnx, *source_fpid, data, length);
+    if (!ss)
+        return PICOQUIC_ERROR_MEMORY;
+    return protect_packet_source_symbol(cnx, source_fpid, ss);
+}
+
 static __attribute__((always_inline)) bool should_send_recovered_frames(picoquic_cnx_t *cnx, recovered_packets_t *rp) {
     return (bool) run_noparam(cnx, "should_send_recovered_frames", 1, (protoop_arg_t *) &rp, NULL);
 }
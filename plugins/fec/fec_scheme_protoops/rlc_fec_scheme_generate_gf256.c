@@ -1,5 +1,5 @@
 #include <picoquic.h>
-#include "../fec.h"
+#include "../fec_protoops.h"
 #include "../gf256/swif_symbol.c"
 #include "../../helpers.h"
 #include "../prng/tinymt32.c"
@@ -46,6 +46,7 @@ protoop_arg_t fec_generate_repair_symbols(picoquic_cnx_t *cnx)
 
 
     uint8_t i, j;
+    fec_buffers_t *buffers = &get_bpf_state(cnx)->buffers;
     uint8_t *coefs = my_malloc(cnx, fec_block->total_source_symbols*sizeof(uint8_t));
     uint8_t **knowns = my_malloc(cnx, fec_block->total_source_symbols*sizeof(uint8_t));
     for (i = 0 ; i < fec_block->total_source_symbols ; i++) {
@@ -59,7 +60,7 @@ protoop_arg_t fec_generate_repair_symbols(picoquic_cnx_t *cnx)
         rfpid.fec_block_number = fec_block->fec_block_number;
         rfpid.symbol_number = i;
         get_coefs(cnx, &prng, rfpid.source_fpid.raw, fec_block->total_source_symbols, coefs);
-        repair_symbol_t *rs = malloc_repair_symbol(cnx, rfpid, max_length);
+        repair_symbol_t *rs = get_pooled_repair_symbol(cnx, buffers, rfpid, max_length);
         for (j = 0 ; j < fec_block->total_source_symbols ; j++) {
 //            PROTOOP_PRINTF(cnx, "ADD coef = %d, data = %p, rs[8] = 0x%x, symbol2 = %p, tab = %p\n", coefs[j], (protoop_arg_t) rs->data, rs->data[8], (protoop_arg_t) knowns[j], (protoop_arg_t) mul);
 
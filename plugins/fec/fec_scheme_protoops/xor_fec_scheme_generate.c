@@ -60,7 +60,7 @@ protoop_arg_t fec_generate_repair_symbols(picoquic_cnx_t *cnx)
     repair_fpid_t rfpid;
     rfpid.raw = 0;
     rfpid.fec_block_number = fec_block->fec_block_number;
-    repair_symbol_t *rs = malloc_repair_symbol(cnx, rfpid, max_length);
+    repair_symbol_t *rs = get_pooled_repair_symbol(cnx, &get_bpf_state(cnx)->buffers, rfpid, max_length);
 
 
     int i = 0;
@@ -57,7 +57,7 @@ static __attribute__((always_inline)) bool has_repair_symbol_at_index(block_fec_
 }
 
 static __attribute__((always_inline)) void remove_item_at_index(picoquic_cnx_t *cnx, block_fec_framework_t *bff, int idx) {
-    free_repair_symbol(cnx, bff->repair_symbols_queue[idx].repair_symbol);
+    release_pooled_repair_symbol(cnx, &get_bpf_state(cnx)->buffers, bff->repair_symbols_queue[idx].repair_symbol);
     bff->repair_symbols_queue[idx].repair_symbol = NULL;
     bff->repair_symbols_queue[idx].nss = 0;
     bff->repair_symbols_queue[idx].nrs = 0;
@@ -136,25 +136,24 @@ static __attribute__((always_inline)) size_t get_repair_payload_from_queue(picoq
 
 //TODO: currently unprovable
 static __attribute__((always_inline)) int reserve_fec_frames(picoquic_cnx_t *cnx, block_fec_framework_t *bff, size_t size_max) {
-    if (size_max <= sizeof(fec_frame_header_t))
+    if (size_max <= sizeof(fec_frame_header_t) || size_max - (1 + sizeof(fec_frame_header_t)) > FEC_FRAME_PAYLOAD_SIZE)
         return -1;
+    fec_buffers_t *buffers = &get_bpf_state(cnx)->buffers;
     while (bff->repair_symbols_queue_length != 0) {
-        // FIXME: bourrin
-        fec_frame_t *ff = my_malloc(cnx, sizeof(fec_frame_t));
+        fec_frame_t *ff = get_pooled_fec_frame(cnx, buffers);
         if (!ff)
             return PICOQUIC_ERROR_MEMORY;
-        uint8_t *bytes = my_malloc(cnx, (unsigned int) (size_max - (1 + sizeof(fec_frame_header_t))));
-        if (!bytes)
-            return PICOQUIC_ERROR_MEMORY;
         // copy the frame payload
-        size_t payload_size = get_repair_payload_from_queue(cnx, bff, size_max - sizeof(fec_frame_header_t) - 1, &ff->header, bytes);
-        if (!payload_size)
+        size_t payload_size = get_repair_payload_from_queue(cnx, bff, size_max - sizeof(fec_frame_header_t) - 1, &ff->header, ff->data);
+        if (!payload_size) {
+            release_pooled_fec_frame(cnx, buffers, ff);
             return PICOQUIC_ERROR_FRAME_BUFFER_TOO_SMALL;
-        ff->data = bytes;
-        reserve_frame_slot_t *slot = (reserve_frame_slot_t *) my_malloc(cnx, sizeof(reserve_frame_slot_t));
-        if (!slot)
+        }
+        reserve_frame_slot_t *slot = get_pooled_frame_slot(cnx, buffers);
+        if (!slot) {
+            release_pooled_fec_frame(cnx, buffers, ff);
             return PICOQUIC_ERROR_MEMORY;
-        my_memset(slot, 0, sizeof(reserve_frame_slot_t));
+        }
         slot->frame_type = FEC_TYPE;
         slot->nb_bytes = 1 + sizeof(fec_frame_header_t) + payload_size;
         slot->frame_ctx = ff;
@@ -163,9 +162,8 @@ static __attribute__((always_inline)) int reserve_fec_frames(picoquic_cnx_t *cnx
         size_t reserved_size = reserve_frames(cnx, 1, slot);
         if (reserved_size < slot->nb_bytes) {
             PROTOOP_PRINTF(cnx, "Unable to reserve frame slot\n");
-            my_free(cnx, ff->data);
-            my_free(cnx, ff);
-            my_free(cnx, slot);
+            release_pooled_fec_frame(cnx, buffers, ff);
+            release_pooled_frame_slot(cnx, buffers, slot);
             return 1;
         }
     }
@@ -180,7 +178,7 @@ static __attribute__((always_inline)) int generate_and_queue_repair_symbols(pico
 
     uint8_t n = 0;
     uint8_t k = 0;
-    get_redundancy_parameters(cnx, bff->controller, flush, &n, &k);
+    get_generation_parameters(cnx, bff->controller, flush, &n, &k);
     bff->current_block->total_source_symbols = bff->current_block->current_source_symbols;
     bff->current_block->total_repair_symbols = n - k;
 
@@ -205,14 +203,16 @@ static __attribute__((always_inline)) int generate_and_queue_repair_symbols(pico
 static __attribute__((always_inline)) int sent_block(picoquic_cnx_t *cnx, block_fec_framework_t *ff, fec_block_t *fb) {
     if (fb != ff->current_block) free_fec_block(cnx, fb, false);
     else {
-        free_fec_block(cnx, ff->current_block, true);
+        fec_buffers_t *buffers = &get_bpf_state(cnx)->buffers;
+        free_fec_block_symbols(cnx, ff->current_block, true);
+        release_pooled_fec_block(cnx, buffers, ff->current_block);
         ff->current_block_number++;
-        ff->current_block = malloc_fec_block(cnx, ff->current_block_number);
+        ff->current_block = get_pooled_fec_block(cnx, buffers, ff->current_block_number);
         if (!ff->current_block)
             return -1;
         uint8_t n = 0;
         uint8_t k = 0;
-        get_redundancy_parameters(cnx, ff->controller, false, &n, &k);
+        get_generation_parameters(cnx, ff->controller, false, &n, &k);
         ff->current_block->total_source_symbols = k;
         ff->current_block->total_repair_symbols = n - k;
     }
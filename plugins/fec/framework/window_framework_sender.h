@@ -66,7 +66,7 @@ static __attribute__((always_inline)) bool has_repair_symbol_at_index(window_fec
 }
 
 static __attribute__((always_inline)) void remove_item_at_index(picoquic_cnx_t *cnx, window_fec_framework_t *wff, int idx) {
-    free_repair_symbol(cnx, wff->repair_symbols_queue[idx].repair_symbol);
+    release_pooled_repair_symbol(cnx, &get_bpf_state(cnx)->buffers, wff->repair_symbols_queue[idx].repair_symbol);
     wff->repair_symbols_queue[idx].repair_symbol = NULL;
     wff->repair_symbols_queue[idx].nss = 0;
     wff->repair_symbols_queue[idx].nrs = 0;
@@ -146,25 +146,24 @@ static __attribute__((always_inline)) size_t get_repair_payload_from_queue(picoq
 
 //TODO: currently unprovable
 static __attribute__((always_inline)) int reserve_fec_frames(picoquic_cnx_t *cnx, window_fec_framework_t *wff, size_t size_max) {
-    if (size_max <= sizeof(fec_frame_header_t))
+    if (size_max <= sizeof(fec_frame_header_t) || size_max - (1 + sizeof(fec_frame_header_t)) > FEC_FRAME_PAYLOAD_SIZE)
         return -1;
+    fec_buffers_t *buffers = &get_bpf_state(cnx)->buffers;
     while (wff->repair_symbols_queue_length != 0) {
-        // FIXME: bourrin
-        fec_frame_t *ff = my_malloc(cnx, sizeof(fec_frame_t));
+        fec_frame_t *ff = get_pooled_fec_frame(cnx, buffers);
         if (!ff)
             return PICOQUIC_ERROR_MEMORY;
-        uint8_t *bytes = my_malloc(cnx, (unsigned int) (size_max - (1 + sizeof(fec_frame_header_t))));
-        if (!bytes)
-            return PICOQUIC_ERROR_MEMORY;
         // copy the frame payload
-        size_t payload_size = get_repair_payload_from_queue(cnx, wff, size_max - sizeof(fec_frame_header_t) - 1, &ff->header, bytes);
-        if (!payload_size)
+        size_t payload_size = get_repair_payload_from_queue(cnx, wff, size_max - sizeof(fec_frame_header_t) - 1, &ff->header, ff->data);
+        if (!payload_size) {
+            release_pooled_fec_frame(cnx, buffers, ff);
             return PICOQUIC_ERROR_FRAME_BUFFER_TOO_SMALL;
-        ff->data = bytes;
-        reserve_frame_slot_t *slot = (reserve_frame_slot_t *) my_malloc(cnx, sizeof(reserve_frame_slot_t));
-        if (!slot)
+        }
+        reserve_frame_slot_t *slot = get_pooled_frame_slot(cnx, buffers);
+        if (!slot) {
+            release_pooled_fec_frame(cnx, buffers, ff);
             return PICOQUIC_ERROR_MEMORY;
-        my_memset(slot, 0, sizeof(reserve_frame_slot_t));
+        }
         slot->frame_type = FEC_TYPE;
         slot->nb_bytes = 1 + sizeof(fec_frame_header_t) + payload_size;
         slot->frame_ctx = ff;
@@ -173,9 +172,8 @@ static __attribute__((always_inline)) int reserve_fec_frames(picoquic_cnx_t *cnx
         size_t reserved_size = reserve_frames(cnx, 1, slot);
         if (reserved_size < slot->nb_bytes) {
             PROTOOP_PRINTF(cnx, "Unable to reserve frame slot\n");
-            my_free(cnx, ff->data);
-            my_free(cnx, ff);
-            my_free(cnx, slot);
+            release_pooled_fec_frame(cnx, buffers, ff);
+            release_pooled_frame_slot(cnx, buffers, slot);
             return 1;
         }
     }
@@ -212,7 +210,8 @@ static __attribute__((always_inline)) int generate_and_queue_repair_symbols(pico
 
     // build the block to generate the symbols
 
-    fec_block_t *fb = malloc_fec_block(cnx, 0);
+    fec_buffers_t *buffers = &get_bpf_state(cnx)->buffers;
+    fec_block_t *fb = get_pooled_fec_block(cnx, buffers, 0);
     if (!fb)
         return PICOQUIC_ERROR_MEMORY;
 
@@ -225,7 +224,7 @@ static __attribute__((always_inline)) int generate_and_queue_repair_symbols(pico
     if (should_send_rs) {
         ret = (int) run_noparam(cnx, "window_select_symbols_to_protect", 3, args, outs);
         if (ret) {
-            my_free(cnx, fb);
+            release_pooled_fec_block(cnx, buffers, fb);
             PROTOOP_PRINTF(cnx, "ERROR WHEN SELECTING THE SYMBOLS TO PROTECT\n");
             return ret;
         }
@@ -255,7 +254,7 @@ static __attribute__((always_inline)) int generate_and_queue_repair_symbols(pico
     }
 
 
-    my_free(cnx, fb);
+    release_pooled_fec_block(cnx, buffers, fb);
     return ret;
 }
 
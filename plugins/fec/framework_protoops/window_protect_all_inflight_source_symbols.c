@@ -19,7 +19,7 @@ protoop_arg_t window_select_symbols_to_protect(picoquic_cnx_t *cnx)
 
     uint8_t n = 0;
     uint8_t k = 0;
-    get_redundancy_parameters(cnx, wff->controller, flush, &n, &k);
+    get_generation_parameters(cnx, wff->controller, flush, &n, &k);
     fb->total_repair_symbols = MIN(n-k, fb->total_source_symbols);
 
     return 0;
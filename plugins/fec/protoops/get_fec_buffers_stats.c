@@ -0,0 +1,13 @@
+#include "../fec_protoops.h"
+
+/**
+ * Outputs the number of sender objects taken from the plugin memory (0) and from the pools (1).
+ * Both are 0 until the FEC state is created, this does not create it.
+ */
+protoop_arg_t get_fec_buffers_stats(picoquic_cnx_t *cnx)
+{
+    bpf_state *state = (bpf_state *) get_cnx_metadata(cnx, FEC_OPAQUE_ID);
+    set_cnx(cnx, AK_CNX_OUTPUT, 0, state ? state->buffers.nb_allocs : 0);
+    set_cnx(cnx, AK_CNX_OUTPUT, 1, state ? state->buffers.nb_allocs_avoided : 0);
+    return 0;
+}
@@ -7,6 +7,6 @@ protoop_arg_t notify_fec_frame(picoquic_cnx_t *cnx)
     reserve_frame_slot_t *rfs = (reserve_frame_slot_t *) get_cnx(cnx, AK_CNX_INPUT, 0);
     /* Commented out, can be used if needed */
     /* int received = (int) get_cnx(cnx, AK_CNX_INPUT, 1); */
-    my_free(cnx, rfs);
+    release_pooled_frame_slot(cnx, &get_bpf_state(cnx)->buffers, rfs);
     return 0;
 }
\ No newline at end of file
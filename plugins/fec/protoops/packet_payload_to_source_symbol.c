@@ -16,22 +16,7 @@ protoop_arg_t packet_payload_to_source_symbol(picoquic_cnx_t *cnx)
     }
     encode_u64(sequence_number, buffer + 1);
     buffer[0] = FEC_MAGIC_NUMBER;
-    uint32_t offset_in_symbol = 0;
-    uint32_t offset_in_packet_payload = 0;
-    size_t consumed = 0;
-    int pure_ack = 0;
-    uint8_t first_byte = 0;
-
-    while(offset_in_packet_payload < payload_length) {
-        my_memcpy(&first_byte, bytes_protected + offset_in_packet_payload, 1);
-        bool to_ignore = first_byte == picoquic_frame_type_ack || first_byte == picoquic_frame_type_padding || first_byte == picoquic_frame_type_crypto_hs;
-        helper_skip_frame(cnx, bytes_protected + offset_in_packet_payload, payload_length - offset_in_packet_payload, &consumed, &pure_ack);
-        if (!to_ignore) {
-            my_memcpy(buffer + 1 + sizeof(uint64_t) + offset_in_symbol, bytes_protected + offset_in_packet_payload, consumed);
-            offset_in_symbol += consumed;
-        }
-        offset_in_packet_payload += consumed;
-    }
-    PROTOOP_PRINTF(cnx, "SKIPPED %d BYTES IN SOURCE SYMBOL, SYMBOL SIZE = %d\n", offset_in_packet_payload - offset_in_symbol, 1 + sizeof(uint64_t) + offset_in_symbol);
-    return 1 + sizeof(uint64_t) + offset_in_symbol;
-}
\ No newline at end of file
+    // the frames to protect are found and copied by the core, with one copy per run of consecutive frames
+    size_t frames_length = picoquic_source_symbol_gather(cnx, bytes_protected, payload_length, buffer + 1 + sizeof(uint64_t), payload_length);
+    return 1 + sizeof(uint64_t) + frames_length;
+}
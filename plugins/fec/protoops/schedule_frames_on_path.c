@@ -34,14 +34,15 @@ protoop_arg_t schedule_frames_on_path(picoquic_cnx_t *cnx)
 
     if (state->current_sfpid_frame && (packet_type == picoquic_packet_1rtt_protected_phi0 || packet_type == picoquic_packet_1rtt_protected_phi1)){
         PROTOOP_PRINTF(cnx, "TRY TO PROTECT, LENGTH  %d, OFFSET = %d, retrans = %d\n", length, header_length, retransmit_p != NULL);
-        uint8_t *payload_with_pn = my_malloc(cnx, length - header_length + 1 + sizeof(uint64_t));
-        // copy the packet payload without the header and put it 8 bytes after the start of the buffer
-
-
+        // the symbol is built in its final buffer, without an intermediate copy of the payload
+        source_symbol_t *ss = malloc_source_symbol(cnx, state->current_sfpid_frame->source_fpid, length - header_length + 1 + sizeof(uint64_t));
+        if (!ss) {
+            return PICOQUIC_ERROR_MEMORY;
+        }
 
         protoop_arg_t args[4];
         args[0] = (protoop_arg_t) data + header_length;
-        args[1] = (protoop_arg_t) payload_with_pn;
+        args[1] = (protoop_arg_t) ss->data;
         args[2] = length - header_length;
         args[3] = get_pkt(packet, AK_PKT_SEQUENCE_NUMBER);
         uint32_t symbol_length = (uint32_t) run_noparam(cnx, "packet_payload_to_source_symbol", 4, args, NULL);
@@ -52,15 +53,15 @@ protoop_arg_t schedule_frames_on_path(picoquic_cnx_t *cnx)
             my_memset(state->written_sfpid_frame, 0, 1 + sizeof(source_fpid_frame_t));
             my_free(cnx, state->current_sfpid_frame);
             state->current_sfpid_frame = NULL;
+            free_source_symbol(cnx, ss);
         } else {
-            int err = protect_packet(cnx, &state->current_sfpid_frame->source_fpid, payload_with_pn, symbol_length);
+            ss->data_length = symbol_length;
+            int err = protect_packet_source_symbol(cnx, &state->current_sfpid_frame->source_fpid, ss);
             if (err){
                 PROTOOP_PRINTF(cnx, "ERROR WHILE PROTECTING\n");
                 return (protoop_arg_t) err;
             }
         }
-
-        my_free(cnx, payload_with_pn);
     }
     if (state->current_sfpid_frame) {
         my_free(cnx, state->current_sfpid_frame);
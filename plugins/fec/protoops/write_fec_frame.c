@@ -18,7 +18,7 @@ protoop_arg_t write_fec_frame(picoquic_cnx_t *cnx) {
         // TODO: re-reserve the frame
         set_cnx(cnx, AK_CNX_OUTPUT, 0, (protoop_arg_t) 0);
         set_cnx(cnx, AK_CNX_OUTPUT, 1, (protoop_arg_t) 0);
-        my_free(cnx, ff->data);
+        release_pooled_fec_frame(cnx, &state->buffers, ff);
         PROTOOP_PRINTF(cnx, "DONT WRITE FEC FRAME: ALREADY CONTAINS SFPID FRAME\n");
         return 0;
 
@@ -34,10 +34,9 @@ protoop_arg_t write_fec_frame(picoquic_cnx_t *cnx) {
     my_free(cnx, header_buffer);
     // copy the frame payload
     my_memcpy(bytes + 1 + sizeof(fec_frame_header_t), ff->data, bytes_max - (bytes + 1 + sizeof(fec_frame_header_t)));
-    my_free(cnx, ff->data);
     set_cnx(cnx, AK_CNX_OUTPUT, 0, (protoop_arg_t) (1 + sizeof(fec_frame_header_t) + ff->header.data_length));
     set_cnx(cnx, AK_CNX_OUTPUT, 1, (protoop_arg_t) 0);
-    my_free(cnx, ff);
     PROTOOP_PRINTF(cnx, "WRITTEN FRAME OF LEN %u, TOTAL %u BYTES\n", ff->header.data_length, (1 + sizeof(fec_frame_header_t) + ff->header.data_length));
+    release_pooled_fec_frame(cnx, &state->buffers, ff);
     return 0;
 }
\ No newline at end of file
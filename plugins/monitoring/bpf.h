@@ -24,6 +24,10 @@
 #define FLOW_STATE_BROKEN 5
 #define FLOW_STATE_UNREACHABLE 6
 
+/* Types of the records given to the metrics exporter of the host */
+#define MONITORING_RECORD_CONNECTION 1 /* The metrics of all the paths of a connection */
+#define MONITORING_RECORD_PATH_FLOW 2 /* The connection metrics and the metrics of one path */
+
 typedef struct {
     /* sum in bytes */
     uint64_t data_sent;
@@ -236,12 +240,6 @@ static __attribute__((always_inline)) void complete_path(monitoring_path_metrics
 }
 
 static __attribute__((always_inline)) void dump_metrics(picoquic_cnx_t *cnx, monitoring_conn_metrics *metrics) {
-    struct sockaddr_in si;
-    memset(&si, 0, sizeof(struct sockaddr_in));
-    si.sin_family = AF_INET;
-    si.sin_port = my_htons(55555);
-    inet_aton("127.0.0.1", &si.sin_addr);
-
     int n_paths = metrics->n_established_paths + 1;
     size_t len_path_metrics = sizeof(long) + 2 * (sizeof(int) + sizeof(struct sockaddr_storage)) + sizeof(monitoring_metrics);
 
@@ -259,23 +257,12 @@ static __attribute__((always_inline)) void dump_metrics(picoquic_cnx_t *cnx, mon
         path = path->next;
     }
 
-    int udp_socket = socket(AF_INET, SOCK_DGRAM, 0);
-    connect(udp_socket, (struct sockaddr *) &si, sizeof(struct sockaddr_in));
-    ssize_t sent = send(udp_socket, buf, copied, 0);
-    if (sent > 0) {
-        //PROTOOP_PRINTF(cnx, "Metrics dumped\n");
-    }
+    picoquic_export_metrics(cnx, MONITORING_RECORD_CONNECTION, (uint8_t *) buf, copied);
     my_free(cnx, buf);
 }
 
 
 static __attribute__((always_inline)) void send_path_metrics_to_exporter(picoquic_cnx_t *cnx, monitoring_path_metrics *path_metrics, uint8_t flow_start_reason, uint8_t flow_end_reason) {
-    struct sockaddr_in si;
-    memset(&si, 0, sizeof(struct sockaddr_in));
-    si.sin_family = AF_INET;
-    si.sin_port = my_htons(55555);
-    inet_aton("127.0.0.1", &si.sin_addr);
-
     monitoring_conn_metrics *metrics = get_monitoring_metrics(cnx);
     size_t len_path_metrics = sizeof(long) + 2 * (sizeof(int) + sizeof(struct sockaddr_storage)) + sizeof(monitoring_metrics) + sizeof(monitoring_quic_metrics) + unknown_tps_length(metrics);
     len_path_metrics += 2; // Accounts for flow states
@@ -304,11 +291,8 @@ static __attribute__((always_inline)) void send_path_metrics_to_exporter(picoqui
     copied += 2;
     copied += (size_t) copy_path(buf + copied, path_metrics);
 
-    int udp_socket = socket(AF_INET, SOCK_DGRAM, 0);
-    connect(udp_socket, (struct sockaddr *) &si, sizeof(struct sockaddr_in));
-    ssize_t sent = send(udp_socket, buf, copied, 0);
-    if (sent < copied) {
-        PROTOOP_PRINTF(cnx, "Unable to send path metrics\n");
+    if (picoquic_export_metrics(cnx, MONITORING_RECORD_PATH_FLOW, (uint8_t *) buf, copied) != 0) {
+        PROTOOP_PRINTF(cnx, "Unable to export path metrics\n");
     }
     my_free(cnx, buf);
 }
\ No newline at end of file
@@ -1,9 +1,30 @@
+import argparse
 import ctypes
+import mmap
+import os
 import socket
 import struct
+import time
 
 PATH_LENGTH = 64
 
+# Batched format written by the metrics exporter of picoquic, see picoquic/metrics_exporter.h
+BATCH_MAGIC = 0x424d5150
+FILE_MAGIC = 0x464d5150
+BATCH_HEADER = struct.Struct('=IHHII')  # magic, version, nb_records, length, sequence
+RECORD_HEADER = struct.Struct('=HHIQ')  # type, length, reserved, timestamp
+FILE_HEADER = struct.Struct('=IHHQQ')  # magic, version, header_length, capacity, write_offset
+
+# Record types of the monitoring plugin, see plugins/monitoring/bpf.h
+RECORD_CONNECTION = 1
+RECORD_PATH_FLOW = 2
+
+PATH_METRICS = ('data_sent', 'data_recv', 'data_lost', 'data_ooo', 'data_dupl',
+                'pkt_sent', 'pkt_pure_ack_sent', 'pkt_recv', 'pkt_lost', 'pkt_ooo', 'pkt_dupl',
+                'frt_fired', 'ert_fired', 'rto_fired', 'tlp_fired',
+                'mean_rtt', 'rtt_variance', 'ack_delay', 'max_ack_delay')
+QUIC_METRICS = ('streams_opened', 'streams_closed', 'max_recv_buf', 'peer_max_recv_buf', 'app_data_sent')
+
 
 def ctypes_repr(self):
     return self.__class__.__name__ + '(' + ', '.join('%s=%s' % (f[0], getattr(self, f[0])) for f in self._fields_) + ')'
@@ -18,7 +39,7 @@ class sockaddr_in(ctypes.Structure):
         ('sin_zero', ctypes.c_uint8 * (16 - 4 - 2- 2)), # padding
     )
     def __str__(self):
-        return '%s:%d' % (socket.inet_ntop(self.sin_family, ''.join(map(chr, self.sin_addr))), socket.ntohs(self.sin_port))
+        return '%s:%d' % (socket.inet_ntop(self.sin_family, bytes(self.sin_addr)), socket.ntohs(self.sin_port))
 
 
 class sockaddr_in6(ctypes.Structure):
@@ -31,7 +52,7 @@ class sockaddr_in6(ctypes.Structure):
         ('sin6_scope_id', ctypes.c_uint32)
     )
     def __str__(self):
-        return '[%s]:%d' % (socket.inet_ntop(self.sin6_family, ''.join(map(chr, self.sin6_addr))), socket.ntohs(self.sin6_port))
+        return '[%s]:%d' % (socket.inet_ntop(self.sin6_family, bytes(self.sin6_addr)), socket.ntohs(self.sin6_port))
 
 
 class StructReader:
@@ -56,47 +77,134 @@ class StructReader:
         return len(self.b[self.i:])
 
 
-if __name__ == "__main__":
-    s = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
-    s.bind(("127.0.0.1", 55555))
+def read_address(buf):
+    addr_len = buf.read('I')
+    if not addr_len:
+        return None
+    family = buf.read('H', peek=True)
+    addr = sockaddr_in() if family == socket.AF_INET else sockaddr_in6()
+    ctypes.memmove(ctypes.byref(addr), buf.next(addr_len), min(addr_len, ctypes.sizeof(addr)))
+    return addr
+
+
+def read_path(buf):
+    path = {'time_elapsed': buf.read('Q')}
+
+    path['icid'] = buf.next(buf.read('B')).hex()
+    path['dcid'] = buf.next(buf.read('B')).hex()
+    path['scid'] = buf.next(buf.read('B')).hex()
+    path['local_addr'] = read_address(buf)
+    path['peer_addr'] = read_address(buf)
+
+    for name in PATH_METRICS:
+        path[name] = buf.read('Q')
+    return path
+
+
+def read_flow(buf):
+    flow = {name: buf.read('Q') for name in QUIC_METRICS}
+    flow['unknown_tps'] = []
+    for _ in range(buf.read('i')):
+        tp_type = buf.read('H')
+        tp_length = buf.read('H')
+        flow['unknown_tps'].append((tp_type, buf.next(tp_length).hex()))
+    flow['flow_start_reason'] = buf.read('B')
+    flow['flow_end_reason'] = buf.read('B')
+    flow['path'] = read_path(buf)
+    return flow
+
+
+def read_batch(data):
+    """ Yields the type, the timestamp and the content of each record of a batch """
+    magic, version, nb_records, length, sequence = BATCH_HEADER.unpack_from(data)
+    if magic != BATCH_MAGIC or length > len(data):
+        raise ValueError('invalid batch')
+    offset = BATCH_HEADER.size
+    for _ in range(nb_records):
+        record_type, record_length, _, timestamp = RECORD_HEADER.unpack_from(data, offset)
+        offset += RECORD_HEADER.size
+        yield record_type, timestamp, data[offset:offset + record_length]
+        offset += (record_length + 7) & ~7
+
+
+def print_batch(data):
+    for record_type, timestamp, record in read_batch(data):
+        buf = StructReader(record, '=')
+        if record_type == RECORD_CONNECTION:
+            while buf:
+                print(timestamp, read_path(buf))
+        elif record_type == RECORD_PATH_FLOW:
+            print(timestamp, read_flow(buf))
+        else:
+            print(timestamp, 'unknown record type %d' % record_type)
+
+
+def follow_file(path, interval=0.1):
+    """ Yields the batches written in a memory-mapped file, in order """
+    with open(path, 'rb') as f:
+        header = f.read(FILE_HEADER.size)
+        magic, version, header_length, capacity, _ = FILE_HEADER.unpack(header)
+        if magic != FILE_MAGIC:
+            raise ValueError('%s is not a metrics file' % path)
+        m = mmap.mmap(f.fileno(), header_length + capacity, prot=mmap.PROT_READ)
+
+    read_offset = 0
+    while True:
+        write_offset = FILE_HEADER.unpack_from(m)[4]
+        if write_offset - read_offset > capacity:
+            # The exporter went around the area, restart from the oldest batch it did not overwrite
+            print('lost %d bytes of batches' % (write_offset - read_offset - capacity))
+            read_offset = write_offset - write_offset % capacity
+        if read_offset == write_offset:
+            time.sleep(interval)
+            continue
+        pos = read_offset % capacity
+        length = 0
+        if capacity - pos >= BATCH_HEADER.size:
+            length = BATCH_HEADER.unpack_from(m, header_length + pos)[3]
+        if length == 0:
+            # End of the area, the next batch is at its beginning
+            read_offset += capacity - pos
+            continue
+        yield m[header_length + pos:header_length + pos + length]
+        read_offset += length
+
+
+def receive_batches(destination):
+    if destination.startswith('unix:'):
+        path = destination[5:]
+        if os.path.exists(path):
+            os.unlink(path)
+        s = socket.socket(socket.AF_UNIX, socket.SOCK_DGRAM)
+        s.bind(path)
+    else:
+        host, port = destination[4:].rsplit(':', 1)
+        host = host.strip('[]')
+        s = socket.socket(socket.AF_INET6 if ':' in host else socket.AF_INET, socket.SOCK_DGRAM)
+        s.bind((host, int(port)))
 
     while True:
-        buf = StructReader(s.recv(4096), '<')
-
-        while buf:
-            path = {'time_elapsed': buf.read('Q')}
-
-            path['icid'] = buf.next(buf.read('B')).hex()
-            path['dcid'] = buf.next(buf.read('B')).hex()
-            path['scid'] = buf.next(buf.read('B')).hex()
-
-            local_addr_len = buf.read('I')
-            if local_addr_len:
-                family = buf.read('H', peek=True)
-                path['local_addr'] = sockaddr_in() if family == 2 else sockaddr_in6()
-                ctypes.memmove(ctypes.byref(path['local_addr']), buf.next(local_addr_len), local_addr_len)
-
-            peer_addr_len = buf.read('I')
-            if peer_addr_len:
-                family = buf.read('H', peek=True)
-                path['peer_addr'] = sockaddr_in() if family == 2 else sockaddr_in6()
-                ctypes.memmove(ctypes.byref(path['peer_addr']), buf.next(peer_addr_len), peer_addr_len)
-
-            path['data_sent'] = buf.read('Q')
-            path['data_recv'] = buf.read('Q')
-            path['data_lost'] = buf.read('Q')
-            path['data_ooo'] = buf.read('Q')
-            path['data_dupl'] = buf.read('Q')
-            path['pkt_sent'] = buf.read('Q')
-            path['pkt_recv'] = buf.read('Q')
-            path['pkt_lost'] = buf.read('Q')
-            path['pkt_ooo'] = buf.read('Q')
-            path['pkt_dupl'] = buf.read('Q')
-            path['frt_fired'] = buf.read('Q')
-            path['ert_fired'] = buf.read('Q')
-            path['rto_fired'] = buf.read('Q')
-            path['tlp_fired'] = buf.read('Q')
-            path['mean_rtt'] = buf.read('Q')
-            path['rtt_variance'] = buf.read('Q')
-
-            print(path)
+        yield s.recv(65536)
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description='Prints the metrics exported by the monitoring plugin')
+    parser.add_argument('--source', default='udp:127.0.0.1:55555',
+                        help='where the batches are read, as given to picoquic_set_metrics_exporter: '
+                             'udp:<address>:<port>, unix:<path> or file:<path>')
+    parser.add_argument('--legacy', action='store_true',
+                        help='reads the path records sent one per datagram by older versions of the plugin')
+    args = parser.parse_args()
+
+    if args.source.startswith('file:'):
+        batches = follow_file(args.source[5:])
+    else:
+        batches = receive_batches(args.source)
+
+    for batch in batches:
+        if args.legacy:
+            buf = StructReader(batch, '<')
+            while buf:
+                print(read_path(buf))
+        else:
+            print_batch(batch)
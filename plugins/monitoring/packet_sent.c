@@ -19,8 +19,15 @@ protoop_arg_t packet_sent(picoquic_cnx_t *cnx)
     picoquic_packet_t *packet = (picoquic_packet_t *) get_cnx(cnx, AK_CNX_INPUT, 2);
     size_t length = (size_t) get_cnx(cnx, AK_CNX_INPUT, 3);
 
-    uint64_t plen = get_pkt(packet, AK_PKT_LENGTH);
-    if (plen == 0 || plen <= get_pkt(packet, AK_PKT_OFFSET)) {
+    access_key_t pkt_keys[3];
+    protoop_arg_t pkt_fields[3];
+    pkt_keys[0] = AK_PKT_LENGTH;
+    pkt_keys[1] = AK_PKT_OFFSET;
+    pkt_keys[2] = AK_PKT_IS_PURE_ACK;
+    get_pkt_fields(packet, pkt_keys, 3, pkt_fields);
+
+    uint64_t plen = pkt_fields[0];
+    if (plen == 0 || plen <= pkt_fields[1]) {
         return 0; // This packet is empty
     }
 
@@ -32,14 +39,21 @@ protoop_arg_t packet_sent(picoquic_cnx_t *cnx)
     }
     path_metrics->metrics.data_sent += length;
     path_metrics->metrics.pkt_sent++;
-    if (get_pkt(packet, AK_PKT_IS_PURE_ACK)) {
+    if (pkt_fields[2]) {
         path_metrics->metrics.pkt_pure_ack_sent++;
     }
     if (path_metrics == &metrics->handshake_metrics) {
         complete_path(path_metrics, cnx, path);
     }
-    uint64_t recv_buf = get_cnx(cnx, AK_CNX_MAXDATA_LOCAL, 0) - get_cnx(cnx, AK_CNX_DATA_RECEIVED, 0);
-    uint64_t peer_recv_buf = get_cnx(cnx, AK_CNX_MAXDATA_REMOTE, 0) - get_cnx(cnx, AK_CNX_DATA_SENT, 0);
+    access_key_t cnx_keys[4];
+    protoop_arg_t cnx_fields[4];
+    cnx_keys[0] = AK_CNX_MAXDATA_LOCAL;
+    cnx_keys[1] = AK_CNX_DATA_RECEIVED;
+    cnx_keys[2] = AK_CNX_MAXDATA_REMOTE;
+    cnx_keys[3] = AK_CNX_DATA_SENT;
+    get_cnx_fields(cnx, cnx_keys, 4, cnx_fields);
+    uint64_t recv_buf = cnx_fields[0] - cnx_fields[1];
+    uint64_t peer_recv_buf = cnx_fields[2] - cnx_fields[3];
     metrics->quic_metrics.max_recv_buf = recv_buf > metrics->quic_metrics.max_recv_buf ? recv_buf : metrics->quic_metrics.max_recv_buf;
     metrics->quic_metrics.peer_max_recv_buf = peer_recv_buf > metrics->quic_metrics.peer_max_recv_buf ? peer_recv_buf : metrics->quic_metrics.peer_max_recv_buf;
     return 0;
@@ -19,9 +19,16 @@ protoop_arg_t rtt_updated(picoquic_cnx_t *cnx)
         path_metrics = find_metrics_for_path(cnx, metrics, path_x);
     }
 
-    path_metrics->metrics.smoothed_rtt = (uint64_t) get_path(path_x, AK_PATH_SMOOTHED_RTT, 0);
-    path_metrics->metrics.rtt_variance = (uint64_t) get_path(path_x, AK_PATH_RTT_VARIANT, 0);
+    access_key_t keys[3];
+    protoop_arg_t fields[3];
+    keys[0] = AK_PATH_SMOOTHED_RTT;
+    keys[1] = AK_PATH_RTT_VARIANT;
+    keys[2] = AK_PATH_MAX_ACK_DELAY;
+    get_path_fields(path_x, keys, 3, fields);
+
+    path_metrics->metrics.smoothed_rtt = (uint64_t) fields[0];
+    path_metrics->metrics.rtt_variance = (uint64_t) fields[1];
     path_metrics->metrics.ack_delay = (uint64_t) get_pkt_ctx(pkt_ctx, AK_PKTCTX_ACK_DELAY_LOCAL);
-    path_metrics->metrics.max_ack_delay = (uint64_t) get_path(path_x, AK_PATH_MAX_ACK_DELAY, 0);
+    path_metrics->metrics.max_ack_delay = (uint64_t) fields[2];
     return 0;
 }
\ No newline at end of file
@@ -9,12 +9,23 @@
 #ifndef N_PATHS
 #define N_PATHS 3
 #endif
+/* Number of unused path IDs proposed to the peer. One more is proposed each
+ * time the peer starts using one, until MAX_PATHS path IDs were proposed. */
+#ifndef N_PROPOSED_PATHS
+#define N_PROPOSED_PATHS 6
+#endif
+/* The path tables grow on demand up to this size. Sets of paths are stored as 64-bit masks. */
 #ifndef MAX_PATHS
-#define MAX_PATHS 6
+#define MAX_PATHS 64
+#endif
+#if MAX_PATHS > 64
+#error "MAX_PATHS cannot exceed 64"
 #endif
 #ifndef MAX_ADDRS
-#define MAX_ADDRS 6
+#define MAX_ADDRS 16
 #endif
+/* Initial size of the path and address tables */
+#define MP_INITIAL_CAPACITY 4
 
 #define PREPARE_NEW_CONNECTION_ID_FRAME (PROTOOPID_SENDER + 0x48)
 #define PREPARE_MP_ACK_FRAME (PROTOOPID_SENDER + 0x49)
@@ -67,6 +78,7 @@ typedef struct {
     uint8_t rtt_probe_tries;
     bool rtt_probe_ready;
     bool proposed_cid;
+    bool used_by_peer; /* For receive paths, set by the first packet received on its CID */
     // bool doing_ack;
 
     uint64_t failure_count;
@@ -80,38 +92,62 @@ typedef struct {
     bool is_v6;
 } addr_data_t;
 
-typedef struct {
-    uint64_t max_ack_delay;
-    uint64_t smoothed_rtt;
-    uint64_t rtt_variant;
-    uint64_t rtt_min;
-    uint64_t nb_updates;
-} stats_t;
-
 typedef struct {
     uint8_t nb_sending_active;
     uint8_t nb_sending_proposed;
     uint8_t nb_receive_proposed;
     uint8_t nb_loc_addrs;
     uint8_t nb_rem_addrs;
+    uint8_t nb_receive_cid_issued; /* Path IDs proposed through MP_NEW_CONNECTION_ID, at most MAX_PATHS - 1 */
 
     /* Just for simple rr scheduling */
     uint8_t last_path_index_sent;
 
-    path_data_t *sending_paths[MAX_PATHS];
-    path_data_t *receive_paths[MAX_PATHS];
-    addr_data_t loc_addrs[MAX_ADDRS];
-    addr_data_t rem_addrs[MAX_ADDRS];
+    /* Allocated sizes of the tables below */
+    uint8_t sending_capacity;
+    uint8_t receive_capacity;
+    uint8_t loc_addrs_capacity;
+    uint8_t rem_addrs_capacity;
+
+    path_data_t **sending_paths;
+    path_data_t **receive_paths;
+    addr_data_t *loc_addrs;
+    addr_data_t *rem_addrs;
+
+    /* Per sending path, in the order of sending_paths, the RTT over all the
+     * receive paths: sum of the smoothed RTT of each tuple weighted by its
+     * number of samples, and total number of samples. Kept up to date when
+     * the RTT is updated, so that schedulers get it in constant time. */
+    uint64_t *sending_srtt_sum;
+    uint64_t *sending_nb_updates;
+    /* Sending path indexes by increasing smoothed RTT, paths without samples first */
+    uint8_t *sending_rank;
 
     // uint8_t pkt_seen_non_ack;
 } bpf_data;
 
+/* RTT statistics of the (receive path, sending path) tuples that carried an
+ * acknowledged packet, one array per field. */
 typedef struct {
-    stats_t tuple_stats[MAX_PATHS][MAX_PATHS]; /* [receive index][sending index] */
+    uint16_t nb_tuples;
+    uint16_t capacity;
+    uint16_t *keys; /* receive index << 8 | sending index */
+    uint64_t *smoothed_rtt;
+    uint64_t *rtt_variant;
+    uint64_t *rtt_min;
+    uint64_t *max_ack_delay;
+    uint64_t *nb_updates;
 } bpf_tuple_data;
 
+/* Stream frames copied for duplication are limited so that they fit in any packet */
+#define MP_DUPLICATE_STREAM_MAX 1000
+/* Type, stream ID, offset and length of a re-encoded stream frame */
+#define MP_DUPLICATE_STREAM_OVERHEAD 21
+
 typedef struct {
     uint8_t requires_duplication;
+    /* Set by the path scheduler when the stream frames of the packet must be sent again on another path */
+    uint8_t duplicate_stream_tail;
     uint16_t data_length;
     uint8_t data[1250];
 } bpf_duplicate_data;
@@ -193,6 +229,172 @@ static bpf_duplicate_data *get_bpf_duplicate_data(picoquic_cnx_t *cnx)
     return bpfdd_ptr;
 }
 
+/* Replaces *array by a zeroed copy holding new_count elements, of which the first count are kept */
+static int mp_grow_array(picoquic_cnx_t *cnx, void **array, size_t count, size_t new_count, size_t element_size)
+{
+    void *new_array = my_malloc_ex(cnx, (unsigned int) (new_count * element_size));
+    if (!new_array) {
+        return -1;
+    }
+    my_memset(new_array, 0, new_count * element_size);
+    if (*array) {
+        my_memcpy(new_array, *array, count * element_size);
+        my_free(cnx, *array);
+    }
+    *array = new_array;
+    return 0;
+}
+
+/* Capacity of a table that must hold one more element than its current capacity, 0 if it cannot grow */
+static uint8_t mp_next_capacity(uint8_t capacity, uint8_t max_capacity)
+{
+    if (capacity >= max_capacity) {
+        return 0;
+    }
+    if (capacity == 0) {
+        return (MP_INITIAL_CAPACITY < max_capacity) ? MP_INITIAL_CAPACITY : max_capacity;
+    }
+    return (capacity > max_capacity / 2) ? max_capacity : 2 * capacity;
+}
+
+/* Makes room for one more address in loc_addrs or rem_addrs */
+static int mp_reserve_addr(picoquic_cnx_t *cnx, bpf_data *bpfd, bool local)
+{
+    uint8_t *capacity = local ? &bpfd->loc_addrs_capacity : &bpfd->rem_addrs_capacity;
+    uint8_t count = local ? bpfd->nb_loc_addrs : bpfd->nb_rem_addrs;
+    addr_data_t **addrs = local ? &bpfd->loc_addrs : &bpfd->rem_addrs;
+    uint8_t new_capacity;
+
+    if (count < *capacity) {
+        return 0;
+    }
+    new_capacity = mp_next_capacity(*capacity, MAX_ADDRS);
+    if (new_capacity == 0 || mp_grow_array(cnx, (void **) addrs, count, new_capacity, sizeof(addr_data_t)) != 0) {
+        return -1;
+    }
+    *capacity = new_capacity;
+    return 0;
+}
+
+/* Makes room for one more path in sending_paths, and in the tables indexed like it, or in receive_paths */
+static int mp_reserve_path(picoquic_cnx_t *cnx, bpf_data *bpfd, bool for_sending_path)
+{
+    uint8_t *capacity = for_sending_path ? &bpfd->sending_capacity : &bpfd->receive_capacity;
+    uint8_t count = for_sending_path ? bpfd->nb_sending_proposed : bpfd->nb_receive_proposed;
+    uint8_t new_capacity;
+
+    if (count < *capacity) {
+        return 0;
+    }
+    new_capacity = mp_next_capacity(*capacity, MAX_PATHS);
+    if (new_capacity == 0) {
+        return -1;
+    }
+    if (for_sending_path) {
+        if (mp_grow_array(cnx, (void **) &bpfd->sending_paths, count, new_capacity, sizeof(path_data_t *)) != 0 ||
+            mp_grow_array(cnx, (void **) &bpfd->sending_srtt_sum, count, new_capacity, sizeof(uint64_t)) != 0 ||
+            mp_grow_array(cnx, (void **) &bpfd->sending_nb_updates, count, new_capacity, sizeof(uint64_t)) != 0 ||
+            mp_grow_array(cnx, (void **) &bpfd->sending_rank, count, new_capacity, sizeof(uint8_t)) != 0) {
+            /* The tables that did grow are still valid, keep the old capacity */
+            return -1;
+        }
+    } else if (mp_grow_array(cnx, (void **) &bpfd->receive_paths, count, new_capacity, sizeof(path_data_t *)) != 0) {
+        return -1;
+    }
+    *capacity = new_capacity;
+    return 0;
+}
+
+/* Indexes of the path fields read by the path schedulers, see mp_get_sched_path_fields */
+#define MP_SCHED_CHALLENGE_VERIFIED 0
+#define MP_SCHED_CHALLENGE_TIME 1
+#define MP_SCHED_RETRANSMIT_TIMER 2
+#define MP_SCHED_CHALLENGE_REPEAT_COUNT 3
+#define MP_SCHED_CWIN 4
+#define MP_SCHED_BYTES_IN_TRANSIT 5
+#define MP_SCHED_PING_RECEIVED 6
+#define MP_SCHED_NB_PKT_SENT 7
+#define MP_SCHED_SEND_MTU 8
+#define MP_SCHED_BANDWIDTH_ESTIMATE 9
+#define MP_SCHED_NB_FIELDS 10
+
+/* Reads all the fields a scheduler needs about a path in a single helper call */
+static __attribute__((always_inline)) void mp_get_sched_path_fields(picoquic_path_t *path, protoop_arg_t *fields)
+{
+    access_key_t keys[MP_SCHED_NB_FIELDS];
+    keys[MP_SCHED_CHALLENGE_VERIFIED] = AK_PATH_CHALLENGE_VERIFIED;
+    keys[MP_SCHED_CHALLENGE_TIME] = AK_PATH_CHALLENGE_TIME;
+    keys[MP_SCHED_RETRANSMIT_TIMER] = AK_PATH_RETRANSMIT_TIMER;
+    keys[MP_SCHED_CHALLENGE_REPEAT_COUNT] = AK_PATH_CHALLENGE_REPEAT_COUNT;
+    keys[MP_SCHED_CWIN] = AK_PATH_CWIN;
+    keys[MP_SCHED_BYTES_IN_TRANSIT] = AK_PATH_BYTES_IN_TRANSIT;
+    keys[MP_SCHED_PING_RECEIVED] = AK_PATH_PING_RECEIVED;
+    keys[MP_SCHED_NB_PKT_SENT] = AK_PATH_NB_PKT_SENT;
+    keys[MP_SCHED_SEND_MTU] = AK_PATH_SEND_MTU;
+    keys[MP_SCHED_BANDWIDTH_ESTIMATE] = AK_PATH_BANDWIDTH_ESTIMATE;
+    get_path_fields(path, keys, MP_SCHED_NB_FIELDS, fields);
+}
+
+/* Smoothed RTT of the sending path over all the receive paths, 1 if not measured yet to give it a chance to be used */
+static __attribute__((always_inline)) uint64_t mp_get_smoothed_rtt(bpf_data *bpfd, int sending_index)
+{
+    uint64_t nb_updates = bpfd->sending_nb_updates[sending_index];
+    return (nb_updates == 0) ? 1 : bpfd->sending_srtt_sum[sending_index] / nb_updates;
+}
+
+/* Moves the sending path to its place in sending_rank after its RTT changed */
+static void mp_update_rank(bpf_data *bpfd, int sending_index)
+{
+    int pos = 0;
+    uint64_t srtt = mp_get_smoothed_rtt(bpfd, sending_index);
+
+    while (pos < bpfd->nb_sending_proposed && bpfd->sending_rank[pos] != sending_index) {
+        pos++;
+    }
+    if (pos == bpfd->nb_sending_proposed) {
+        return;
+    }
+    while (pos > 0 && mp_get_smoothed_rtt(bpfd, bpfd->sending_rank[pos - 1]) > srtt) {
+        bpfd->sending_rank[pos] = bpfd->sending_rank[pos - 1];
+        bpfd->sending_rank[--pos] = (uint8_t) sending_index;
+    }
+    while (pos + 1 < bpfd->nb_sending_proposed && mp_get_smoothed_rtt(bpfd, bpfd->sending_rank[pos + 1]) < srtt) {
+        bpfd->sending_rank[pos] = bpfd->sending_rank[pos + 1];
+        bpfd->sending_rank[++pos] = (uint8_t) sending_index;
+    }
+}
+
+/* Returns the statistics index of the tuple, creating it if needed, or -1 */
+static int mp_get_tuple_index(picoquic_cnx_t *cnx, bpf_tuple_data *bpftd, int receive_index, int sending_index)
+{
+    uint16_t key = (uint16_t) ((receive_index << 8) | sending_index);
+    int tuple_index;
+
+    for (tuple_index = 0; tuple_index < bpftd->nb_tuples; tuple_index++) {
+        if (bpftd->keys[tuple_index] == key) {
+            return tuple_index;
+        }
+    }
+
+    if (bpftd->nb_tuples == bpftd->capacity) {
+        uint16_t new_capacity = (bpftd->capacity == 0) ? MP_INITIAL_CAPACITY : 2 * bpftd->capacity;
+        if (new_capacity > MAX_PATHS * MAX_PATHS ||
+            mp_grow_array(cnx, (void **) &bpftd->keys, bpftd->nb_tuples, new_capacity, sizeof(uint16_t)) != 0 ||
+            mp_grow_array(cnx, (void **) &bpftd->smoothed_rtt, bpftd->nb_tuples, new_capacity, sizeof(uint64_t)) != 0 ||
+            mp_grow_array(cnx, (void **) &bpftd->rtt_variant, bpftd->nb_tuples, new_capacity, sizeof(uint64_t)) != 0 ||
+            mp_grow_array(cnx, (void **) &bpftd->rtt_min, bpftd->nb_tuples, new_capacity, sizeof(uint64_t)) != 0 ||
+            mp_grow_array(cnx, (void **) &bpftd->max_ack_delay, bpftd->nb_tuples, new_capacity, sizeof(uint64_t)) != 0 ||
+            mp_grow_array(cnx, (void **) &bpftd->nb_updates, bpftd->nb_tuples, new_capacity, sizeof(uint64_t)) != 0) {
+            return -1;
+        }
+        bpftd->capacity = new_capacity;
+    }
+
+    bpftd->keys[tuple_index] = key;
+    bpftd->nb_tuples++;
+    return tuple_index;
+}
+
 /* Returns -1 if not found */
 static int mp_find_path_index_internal(picoquic_cnx_t *cnx, uint8_t max_count, path_data_t **paths, uint64_t path_id) {
     int path_index;
@@ -217,7 +419,9 @@ static int mp_get_path_index(picoquic_cnx_t *cnx, bpf_data *bpfd, bool for_sendi
         *new_path_index = false;
     }
 
-    if (path_index < 0 && max_count < MAX_PATHS) {
+    if (path_index < 0 && mp_reserve_path(cnx, bpfd, for_sending_path) == 0) {
+        /* The tables may have moved */
+        paths = for_sending_path ? bpfd->sending_paths : bpfd->receive_paths;
         path_index = max_count;
         paths[path_index] = my_malloc(cnx, sizeof(path_data_t));
         if (!paths[path_index]) {
@@ -227,7 +431,8 @@ static int mp_get_path_index(picoquic_cnx_t *cnx, bpf_data *bpfd, bool for_sendi
         my_memset(paths[path_index], 0, sizeof(path_data_t));
         paths[path_index]->path_id = path_id;
         if (for_sending_path) {
-            bpfd->nb_sending_proposed++;
+            bpfd->sending_rank[bpfd->nb_sending_proposed++] = (uint8_t) path_index;
+            mp_update_rank(bpfd, path_index);
         } else {
             bpfd->nb_receive_proposed++;
         }
@@ -342,6 +547,15 @@ static void reserve_mp_new_connection_id_frame(picoquic_cnx_t *cnx, uint64_t pat
     reserve_frames(cnx, 1, rfs);
 }
 
+/* Proposes the next path ID to the peer, unless MAX_PATHS path IDs were already proposed */
+static void mp_propose_receive_path(picoquic_cnx_t *cnx, bpf_data *bpfd)
+{
+    if (bpfd->nb_receive_cid_issued < MAX_PATHS - 1) {
+        bpfd->nb_receive_cid_issued++;
+        reserve_mp_new_connection_id_frame(cnx, bpfd->nb_receive_cid_issued);
+    }
+}
+
 static bool accept_addr(picoquic_cnx_t *cnx, struct sockaddr_storage *sa, uint32_t if_index) {
     protoop_id_t pid;
     pid.id = "accept_addr";
@@ -384,7 +598,7 @@ static void reserve_add_address_frame(picoquic_cnx_t *cnx)
     if (!aac) {
         return;
     }
-    aac->nb_addrs = (size_t) picoquic_getaddrs(aac->sas, aac->if_indexes, MAX_ADDRS);
+    aac->nb_addrs = (size_t) picoquic_get_local_addresses(cnx, aac->sas, aac->if_indexes, MAX_ADDRS);
     if (aac->nb_addrs == 0) {
         my_free(cnx, aac);
         return;
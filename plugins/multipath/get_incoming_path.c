@@ -23,6 +23,12 @@ protoop_arg_t get_incoming_path(picoquic_cnx_t* cnx)
             if (pd && pd->state == path_active && picoquic_compare_connection_id(destination_cnxid, &pd->cnxid) == 0) {
                 path_from = pd->path;
 
+                if (!pd->used_by_peer) {
+                    /* Keep N_PROPOSED_PATHS unused path IDs at the peer */
+                    pd->used_by_peer = true;
+                    mp_propose_receive_path(cnx, bpfd);
+                }
+
                 struct sockaddr_storage *peer_addr = (struct sockaddr_storage *) get_path(path_from, AK_PATH_PEER_ADDR, 0);
                 struct sockaddr_storage *loc_addr = (struct sockaddr_storage *) get_path(path_from, AK_PATH_LOCAL_ADDR, 0);
 
@@ -1,5 +1,33 @@
 #include "../bpf.h"
 
+/* Copies a stream frame for duplication, with an explicit length as other frames may follow the copy */
+static int duplicate_stream_frame(bpf_duplicate_data *bpfdd, uint8_t *frame, size_t frame_length) {
+    uint64_t stream_id = 0;
+    uint64_t offset = 0;
+    size_t data_length = 0;
+    int fin = 0;
+    size_t consumed = 0;
+    size_t byte_index = bpfdd->data_length + 1;
+    uint8_t first_byte = picoquic_frame_type_stream_range_min | 0x04 | 0x02;
+
+    if (helper_parse_stream_header(frame, frame_length, (protoop_arg_t*[]){&stream_id, &offset, &data_length, (protoop_arg_t *) &fin, &consumed}) != 0 ||
+        bpfdd->data_length + MP_DUPLICATE_STREAM_OVERHEAD + data_length > MP_DUPLICATE_STREAM_MAX) {
+        return -1;
+    }
+
+    if (fin) {
+        first_byte |= 0x01;
+    }
+    my_memcpy(&bpfdd->data[bpfdd->data_length], &first_byte, 1);
+    byte_index += picoquic_varint_encode(&bpfdd->data[byte_index], MP_DUPLICATE_STREAM_MAX - byte_index, stream_id);
+    byte_index += picoquic_varint_encode(&bpfdd->data[byte_index], MP_DUPLICATE_STREAM_MAX - byte_index, offset);
+    byte_index += picoquic_varint_encode(&bpfdd->data[byte_index], MP_DUPLICATE_STREAM_MAX - byte_index, data_length);
+    my_memcpy(&bpfdd->data[byte_index], frame + consumed, data_length);
+    bpfdd->data_length = (uint16_t) (byte_index + data_length);
+
+    return 0;
+}
+
 protoop_arg_t schedule_frames(picoquic_cnx_t *cnx) {
     picoquic_packet_t* packet = (picoquic_packet_t*) get_cnx(cnx, AK_CNX_INPUT, 0);
     size_t send_buffer_max = (size_t) get_cnx(cnx, AK_CNX_INPUT, 1);
@@ -66,13 +94,15 @@ protoop_arg_t schedule_frames(picoquic_cnx_t *cnx) {
         set_pkt(packet, AK_PKT_CHECKSUM_OVERHEAD, checksum_overhead);
     }
     else if (ret == 0) {
-        uint64_t cwin = get_path(sending_path, AK_PATH_CWIN, 0);
-        uint64_t bytes_in_transit = get_path(sending_path, AK_PATH_BYTES_IN_TRANSIT, 0);
+        protoop_arg_t sending_fields[MP_SCHED_NB_FIELDS];
+        mp_get_sched_path_fields(sending_path, sending_fields);
+        uint64_t cwin = (uint64_t) sending_fields[MP_SCHED_CWIN];
+        uint64_t bytes_in_transit = (uint64_t) sending_fields[MP_SCHED_BYTES_IN_TRANSIT];
         picoquic_packet_context_t *pkt_ctx = (picoquic_packet_context_t *) get_path(sending_path, AK_PATH_PKT_CTX, pc);
         void *first_misc_frame = (void *) get_cnx(cnx, AK_CNX_FIRST_MISC_FRAME, 0);
-        int challenge_verified = (int) get_path(sending_path, AK_PATH_CHALLENGE_VERIFIED, 0);
-        uint64_t challenge_time = (uint64_t) get_path(sending_path, AK_PATH_CHALLENGE_TIME, 0);
-        uint64_t retransmit_timer = (uint64_t) get_path(sending_path, AK_PATH_RETRANSMIT_TIMER, 0);
+        int challenge_verified = (int) sending_fields[MP_SCHED_CHALLENGE_VERIFIED];
+        uint64_t challenge_time = (uint64_t) sending_fields[MP_SCHED_CHALLENGE_TIME];
+        uint64_t retransmit_timer = (uint64_t) sending_fields[MP_SCHED_RETRANSMIT_TIMER];
         queue_t *retry_frames = (queue_t *) get_cnx(cnx, AK_CNX_RETRY_FRAMES, 0);
         queue_t *rtx_frames = (queue_t *) get_cnx(cnx, AK_CNX_RTX_FRAMES, pc);
 
@@ -92,18 +122,22 @@ protoop_arg_t schedule_frames(picoquic_cnx_t *cnx) {
 
         /* We first need to check if there is ANY receive path that requires acknowledgement, and also no path response to send */
         int any_receive_require_ack = 0;
-        int receive_require_ack[MAX_PATHS];
         int any_path_challenge_response_to_send = 0;
-        int path_challenge_response_to_send[MAX_PATHS];
+        /* Bit i is set if receive path i has a path response to send */
+        uint64_t path_challenge_response_to_send = 0;
+        access_key_t receive_keys[2] = { AK_PATH_PING_RECEIVED, AK_PATH_CHALLENGE_RESPONSE_TO_SEND };
         for (int i = 0; i < bpfd->nb_receive_proposed; i++) {
             picoquic_path_t *receive_path = bpfd->receive_paths[i]->path;
             if (receive_path != NULL) {
-                receive_require_ack[i] = helper_is_ack_needed(cnx, current_time, pc, receive_path);
+                any_receive_require_ack |= helper_is_ack_needed(cnx, current_time, pc, receive_path);
                 /* Handle here the reception of the ping */
-                receive_require_ack[i] |= get_path(receive_path, AK_PATH_PING_RECEIVED, 0);
-                any_receive_require_ack |= receive_require_ack[i];
-                path_challenge_response_to_send[i] = get_path(receive_path, AK_PATH_CHALLENGE_RESPONSE_TO_SEND, 0);
-                any_path_challenge_response_to_send |= path_challenge_response_to_send[i];
+                protoop_arg_t receive_fields[2];
+                get_path_fields(receive_path, receive_keys, 2, receive_fields);
+                any_receive_require_ack |= (receive_fields[0] != 0);
+                if (receive_fields[1]) {
+                    path_challenge_response_to_send |= ((uint64_t) 1) << i;
+                    any_path_challenge_response_to_send = 1;
+                }
             }
         }
 
@@ -144,7 +178,7 @@ protoop_arg_t schedule_frames(picoquic_cnx_t *cnx) {
                     set_path(sending_path, AK_PATH_CHALLENGE_REPEAT_COUNT, 0, challenge_repeat_count);
                     set_pkt(packet, AK_PKT_IS_CONGESTION_CONTROLLED, 1);
                     PROTOOP_PRINTF(cnx, "Sending path %p CWIN %" PRIu64 " BIF %" PRIu64 "\n", (protoop_arg_t) sending_path, cwin, bytes_in_transit);
-                    if (challenge_repeat_count > MAX_PATHS * PICOQUIC_CHALLENGE_REPEAT_MAX) {
+                    if (challenge_repeat_count > N_PROPOSED_PATHS * PICOQUIC_CHALLENGE_REPEAT_MAX) {
                         PROTOOP_PRINTF(cnx, "%s\n", (protoop_arg_t) "Too many challenge retransmits, disconnect");
                         picoquic_set_cnx_state(cnx, picoquic_state_disconnected);
                         helper_callback_function(cnx, 0, NULL, 0, picoquic_callback_close);
@@ -160,8 +194,13 @@ protoop_arg_t schedule_frames(picoquic_cnx_t *cnx) {
 
                 /* Before going further, let's duplicate all required frames first */
                 if (bpfdd->requires_duplication) {
-                    my_memcpy(&bytes[length], bpfdd->data, bpfdd->data_length);
-                    length += (uint32_t) bpfdd->data_length;
+                    /* The frames were already sent once, drop them if they do not fit */
+                    if (length + bpfdd->data_length <= send_buffer_min_max - checksum_overhead) {
+                        my_memcpy(&bytes[length], bpfdd->data, bpfdd->data_length);
+                        length += (uint32_t) bpfdd->data_length;
+                        set_pkt(packet, AK_PKT_IS_PURE_ACK, 0);
+                        set_pkt(packet, AK_PKT_IS_CONGESTION_CONTROLLED, 1);
+                    }
                     /* And of course, don't retry again later */
                     bpfdd->data_length = 0;
                     bpfdd->requires_duplication = 0;
@@ -213,7 +252,7 @@ protoop_arg_t schedule_frames(picoquic_cnx_t *cnx) {
                     if (any_path_challenge_response_to_send) {
 #define PICOQUIC_CHALLENGE_LENGTH 8
                         for (int i = 0; i < bpfd->nb_receive_proposed; i++) {
-                            if (path_challenge_response_to_send[i] && send_buffer_min_max - checksum_overhead - length >= PICOQUIC_CHALLENGE_LENGTH + 1) {
+                            if ((path_challenge_response_to_send & (((uint64_t) 1) << i)) != 0 && send_buffer_min_max - checksum_overhead - length >= PICOQUIC_CHALLENGE_LENGTH + 1) {
                                 picoquic_path_t *receive_path = bpfd->receive_paths[i]->path;
                                 /* This is not really clean, but it will work */
                                 my_memset(&bytes[length], picoquic_frame_type_path_response, 1);
@@ -378,14 +417,29 @@ protoop_arg_t schedule_frames(picoquic_cnx_t *cnx) {
 
                         /* Encode the stream frame, or frames */
                         while (stream != NULL) {
+                            size_t frame_bytes_max = stream_bytes_max;
+                            if (bpfdd->duplicate_stream_tail) {
+                                /* Keep the frame small enough to be copied for duplication */
+                                if (bpfdd->data_length + MP_DUPLICATE_STREAM_OVERHEAD + 1 > MP_DUPLICATE_STREAM_MAX) {
+                                    break;
+                                }
+                                if (frame_bytes_max > MP_DUPLICATE_STREAM_MAX - MP_DUPLICATE_STREAM_OVERHEAD - bpfdd->data_length) {
+                                    frame_bytes_max = MP_DUPLICATE_STREAM_MAX - MP_DUPLICATE_STREAM_OVERHEAD - bpfdd->data_length;
+                                }
+                            }
                             ret = helper_prepare_stream_frame(cnx, stream, &bytes[length],
-                                                              stream_bytes_max, &data_bytes);
+                                                              frame_bytes_max, &data_bytes);
                             if (ret == 0) {
                                 length += (uint32_t)data_bytes;
                                 if (data_bytes > 0)
                                 {
                                     set_pkt(packet, AK_PKT_IS_PURE_ACK, 0);
                                     set_pkt(packet, AK_PKT_IS_CONGESTION_CONTROLLED, 1);
+                                    if (bpfdd->duplicate_stream_tail && duplicate_stream_frame(bpfdd, &bytes[length - data_bytes], data_bytes) == 0) {
+                                        /* Send the copy on another path right away */
+                                        bpfdd->requires_duplication = 1;
+                                        set_cnx(cnx, AK_CNX_WAKE_NOW, 0, 1);
+                                    }
                                 }
 
                                 if (stream_bytes_max > checksum_overhead + length + 8) {
@@ -0,0 +1,175 @@
+#include "picoquic_internal.h"
+#include "../bpf.h"
+
+/* Earliest completion first scheduler, after ECF and BLEST.
+ *
+ * Instead of picking the lowest RTT path, the scheduler estimates for each path
+ * when a packet scheduled now would reach the peer, given the data already in
+ * flight on the path, its congestion window and its delivery rate. When the
+ * fastest path is congestion window limited, this is the time it takes for its
+ * window to open again. If this is still sooner than the delivery over a slower
+ * path, the scheduler waits for the fast path instead of committing data to the
+ * slow one, which would be delivered late and block the stream.
+ *
+ * When compiled with ECF_TAIL_REDUNDANCY, the last segments of a stream are
+ * also sent again on another path, so that the completion of the stream does
+ * not depend on the slowest path nor on a single loss.
+ */
+
+/* The stream tail that is duplicated, in packets */
+#define ECF_TAIL_PACKETS 4
+
+/* Time in microseconds for a full packet scheduled now on the path to reach the peer, given its scheduler fields */
+static uint64_t estimate_completion_time(protoop_arg_t *fields, uint64_t smoothed_rtt) {
+    uint64_t cwin = (uint64_t) fields[MP_SCHED_CWIN];
+    uint64_t bytes_in_transit = (uint64_t) fields[MP_SCHED_BYTES_IN_TRANSIT];
+    uint64_t bandwidth = (uint64_t) fields[MP_SCHED_BANDWIDTH_ESTIMATE];
+    uint64_t send_mtu = (uint64_t) fields[MP_SCHED_SEND_MTU];
+    uint64_t completion_time;
+
+    if (bandwidth == 0) {
+        /* No delivery rate sample yet, assume that the path delivers a window per RTT */
+        bandwidth = (cwin * 1000000) / smoothed_rtt;
+        if (bandwidth == 0) {
+            bandwidth = 1;
+        }
+    }
+
+    completion_time = smoothed_rtt / 2 + (send_mtu * 1000000) / bandwidth;
+    if (bytes_in_transit + send_mtu > cwin) {
+        /* Wait until enough data in flight is acknowledged for the packet to fit in the window */
+        completion_time += ((bytes_in_transit + send_mtu - cwin) * 1000000) / bandwidth;
+    }
+
+    return completion_time;
+}
+
+protoop_arg_t schedule_path_ecf(picoquic_cnx_t *cnx) {
+    picoquic_packet_t *retransmit_p  = (picoquic_packet_t *) get_cnx(cnx, AK_CNX_INPUT, 0);
+    picoquic_path_t *from_path = (picoquic_path_t *) get_cnx(cnx, AK_CNX_INPUT, 1);
+    char *reason = (char *) get_cnx(cnx, AK_CNX_INPUT, 2);
+    int change_path = (int) get_cnx(cnx, AK_CNX_INPUT, 3);
+    char *path_reason = "";
+
+    if (retransmit_p && from_path && reason) {
+        if (strncmp(PROTOOPID_NOPARAM_RETRANSMISSION_TIMEOUT, reason, 23) != 0) {
+            /* Fast retransmit or TLP, stay on the same path! */
+            return (protoop_arg_t) from_path;
+        }
+    }
+
+    picoquic_path_t *sending_path = (picoquic_path_t *) get_cnx(cnx, AK_CNX_PATH, 0); /* We should NEVER return NULL */
+    picoquic_path_t *path_0 = sending_path;
+    picoquic_path_t *path_c = NULL;
+    bpf_data *bpfd = get_bpf_data(cnx);
+    bpf_duplicate_data *bpfdd = get_bpf_duplicate_data(cnx);
+    path_data_t *pd = NULL;
+    uint8_t selected_path_index = 255;
+    manage_paths(cnx);
+    uint64_t completion_time_x = 0;
+    protoop_arg_t fields[MP_SCHED_NB_FIELDS];
+    uint64_t now = picoquic_current_time();
+    int valid = 0;
+    int nb_valid_paths = 0;
+    picoquic_stream_head *stream = helper_find_ready_stream(cnx);
+    int tls_ready = helper_is_tls_stream_ready(cnx);
+
+    bpfdd->duplicate_stream_tail = 0;
+
+    for (uint8_t r = 0; r < bpfd->nb_sending_proposed; r++) {
+        uint8_t i = bpfd->sending_rank[r];
+        pd = bpfd->sending_paths[i];
+        if (pd->state == path_active) {
+            path_c = pd->path;
+            mp_get_sched_path_fields(path_c, fields);
+            int challenge_verified_c = (int) fields[MP_SCHED_CHALLENGE_VERIFIED];
+            uint64_t challenge_time_c = (uint64_t) fields[MP_SCHED_CHALLENGE_TIME];
+            uint64_t retransmit_timer_c = (uint64_t) fields[MP_SCHED_RETRANSMIT_TIMER];
+            uint8_t challenge_repeat_count_c = (uint8_t) fields[MP_SCHED_CHALLENGE_REPEAT_COUNT];
+
+            if (!challenge_verified_c && challenge_time_c + retransmit_timer_c < now && challenge_repeat_count_c < PICOQUIC_CHALLENGE_REPEAT_MAX) {
+                /* Start the challenge! */
+                sending_path = path_c;
+                selected_path_index = i;
+                valid = 0;
+                path_reason = "CHALLENGE_REQUEST";
+                break;
+            }
+
+            /* Don't consider invalid paths */
+            if (!challenge_verified_c) {
+                continue;
+            }
+
+            uint64_t completion_time_c = estimate_completion_time(fields, mp_get_smoothed_rtt(bpfd, i));
+            nb_valid_paths++;
+
+            /* At this point, this means path 0 should NEVER be reused anymore! */
+            if (sending_path == path_0) {
+                sending_path = path_c;
+                selected_path_index = i;
+                completion_time_x = completion_time_c;
+                valid = 0;
+                path_reason = "AVOID_PATH_0";
+            }
+
+            /* Frames to duplicate must go on another path than the previous packet */
+            if (change_path && i == bpfd->last_path_index_sent) {
+                continue;
+            }
+
+            uint64_t cwin_c = (uint64_t) fields[MP_SCHED_CWIN];
+            uint64_t bytes_in_transit_c = (uint64_t) fields[MP_SCHED_BYTES_IN_TRANSIT];
+            int ping_received_c = (int) fields[MP_SCHED_PING_RECEIVED];
+            if (ping_received_c && cwin_c > bytes_in_transit_c) {
+                /* We need some action from the path! */
+                sending_path = path_c;
+                selected_path_index = i;
+                valid = 0;
+                path_reason = "PONG";
+                break;
+            }
+
+            int mtu_needed = (int) helper_is_mtu_probe_needed(cnx, path_c);
+            if (stream == NULL && tls_ready == 0 && mtu_needed && cwin_c > bytes_in_transit_c) {
+                sending_path = path_c;
+                selected_path_index = i;
+                valid = 0;
+                path_reason = "MTU_DISCOVERY";
+                break;
+            }
+
+            /* Cwin limited paths are kept, waiting for the fastest path can be the best choice */
+            if (valid && completion_time_x <= completion_time_c) {
+                continue;
+            }
+            sending_path = path_c;
+            selected_path_index = i;
+            completion_time_x = completion_time_c;
+            valid = 1;
+            path_reason = "EARLIEST_COMPLETION";
+        }
+    }
+
+#ifdef ECF_TAIL_REDUNDANCY
+    if (valid && nb_valid_paths > 1 && stream != NULL && PSTREAM_FIN_NOTIFIED(stream)) {
+        uint64_t sending_offset = (uint64_t) get_stream_head(stream, AK_STREAMHEAD_SENDING_OFFSET);
+        uint64_t sent_offset = (uint64_t) get_stream_head(stream, AK_STREAMHEAD_SENT_OFFSET);
+        uint64_t send_mtu = (uint64_t) get_path(sending_path, AK_PATH_SEND_MTU, 0);
+        if (sending_offset - sent_offset <= ECF_TAIL_PACKETS * send_mtu) {
+            bpfdd->duplicate_stream_tail = 1;
+            path_reason = "EARLIEST_COMPLETION_REDUNDANT";
+        }
+    }
+#endif
+
+    bpfd->last_path_index_sent = selected_path_index;
+    LOG {
+        size_t path_reason_len = strlen(path_reason) + 1;
+        char *p_path_reason = my_malloc(cnx, path_reason_len);
+        my_memcpy(p_path_reason, path_reason, path_reason_len);
+        LOG_EVENT(cnx, "multipath", "schedule_path", p_path_reason, "{\"sending path\": \"%p\"}", (protoop_arg_t) sending_path);
+        my_free(cnx, p_path_reason);
+    }
+    return (protoop_arg_t) sending_path;
+}
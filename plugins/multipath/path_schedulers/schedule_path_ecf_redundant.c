@@ -0,0 +1,3 @@
+/* The earliest completion first scheduler, also duplicating the tail of the streams on another path */
+#define ECF_TAIL_REDUNDANCY
+#include "schedule_path_ecf.c"
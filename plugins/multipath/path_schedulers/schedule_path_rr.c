@@ -13,6 +13,7 @@ protoop_arg_t schedule_path_rr(picoquic_cnx_t *cnx) {
     uint64_t selected_sent_pkt = 0;
     int selected_cwin_limited = 0;
     char *path_reason = "";
+    protoop_arg_t fields[MP_SCHED_NB_FIELDS];
 
     for (int i = 0; i < bpfd->nb_sending_proposed; i++) {
         pd = bpfd->sending_paths[i];
@@ -20,10 +21,11 @@ protoop_arg_t schedule_path_rr(picoquic_cnx_t *cnx) {
         /* A (very) simple round-robin */
         if (pd->state == path_active) {
             path_c = pd->path;
-            int challenge_verified_c = (int) get_path(path_c, AK_PATH_CHALLENGE_VERIFIED, 0);
-            uint64_t challenge_time_c = (uint64_t) get_path(path_c, AK_PATH_CHALLENGE_TIME, 0);
-            uint64_t retransmit_timer_c = (uint64_t) get_path(path_c, AK_PATH_RETRANSMIT_TIMER, 0);
-            uint8_t challenge_repeat_count_c = (uint8_t) get_path(path_c, AK_PATH_CHALLENGE_REPEAT_COUNT, 0);
+            mp_get_sched_path_fields(path_c, fields);
+            int challenge_verified_c = (int) fields[MP_SCHED_CHALLENGE_VERIFIED];
+            uint64_t challenge_time_c = (uint64_t) fields[MP_SCHED_CHALLENGE_TIME];
+            uint64_t retransmit_timer_c = (uint64_t) fields[MP_SCHED_RETRANSMIT_TIMER];
+            uint8_t challenge_repeat_count_c = (uint8_t) fields[MP_SCHED_CHALLENGE_REPEAT_COUNT];
 
             if (!challenge_verified_c && challenge_time_c + retransmit_timer_c < now && challenge_repeat_count_c < PICOQUIC_CHALLENGE_REPEAT_MAX) {
                 /* Start the challenge! */
@@ -37,7 +39,7 @@ protoop_arg_t schedule_path_rr(picoquic_cnx_t *cnx) {
             /* Because of asymmetry, no more need to decide the path on which the response should be sent */
 
             /* At this point, this means path 0 should NEVER be reused anymore! */
-            uint64_t pkt_sent_c = (uint64_t) get_path(path_c, AK_PATH_NB_PKT_SENT, 0);
+            uint64_t pkt_sent_c = (uint64_t) fields[MP_SCHED_NB_PKT_SENT];
             if (challenge_verified_c && sending_path == path_0) {
                 sending_path = path_c;
                 selected_path_index = i;
@@ -47,8 +49,8 @@ protoop_arg_t schedule_path_rr(picoquic_cnx_t *cnx) {
             }
 
             /* Very important: don't go further if the cwin is exceeded! */
-            uint64_t cwin_c = (uint64_t) get_path(path_c, AK_PATH_CWIN, 0);
-            uint64_t bytes_in_transit_c = (uint64_t) get_path(path_c, AK_PATH_BYTES_IN_TRANSIT, 0);
+            uint64_t cwin_c = (uint64_t) fields[MP_SCHED_CWIN];
+            uint64_t bytes_in_transit_c = (uint64_t) fields[MP_SCHED_BYTES_IN_TRANSIT];
             if (cwin_c <= bytes_in_transit_c) {
                 if (sending_path == path_c)
                     selected_cwin_limited = 1;
@@ -1,17 +1,5 @@
 #include "../bpf.h"
 
-static uint64_t find_smooth_rtt(bpf_data *bpfd, bpf_tuple_data *bpftd, int sending_index) {
-    /* Instead of finding the smallest RTT, just weight them by the number of packets */
-    uint64_t srtt = 0;
-    uint64_t nb_updates = 0;
-    for (int i = 0; i < bpfd->nb_receive_proposed; i++) {
-        srtt += bpftd->tuple_stats[i][sending_index].smoothed_rtt * bpftd->tuple_stats[i][sending_index].nb_updates;
-        nb_updates += bpftd->tuple_stats[i][sending_index].nb_updates;
-    }
-    if (nb_updates == 0) return 1; /* Give a chance to be used */
-    return srtt / nb_updates;
-}
-
 protoop_arg_t schedule_path_rtt(picoquic_cnx_t *cnx) {
     picoquic_packet_t *retransmit_p  = (picoquic_packet_t *) get_cnx(cnx, AK_CNX_INPUT, 0);
     picoquic_path_t *from_path = (picoquic_path_t *) get_cnx(cnx, AK_CNX_INPUT, 1);
@@ -30,24 +18,27 @@ protoop_arg_t schedule_path_rtt(picoquic_cnx_t *cnx) {
     picoquic_path_t *path_0 = sending_path;
     picoquic_path_t *path_c = NULL;
     bpf_data *bpfd = get_bpf_data(cnx);
-    bpf_tuple_data *bpftd = get_bpf_tuple_data(cnx);
     path_data_t *pd = NULL;
     uint8_t selected_path_index = 255;
     manage_paths(cnx);
     uint64_t smoothed_rtt_x = 0;
+    protoop_arg_t fields[MP_SCHED_NB_FIELDS];
     uint64_t now = picoquic_current_time();
     int valid = 0;
     picoquic_stream_head *stream = helper_find_ready_stream(cnx);
     int tls_ready = helper_is_tls_stream_ready(cnx);
-    for (uint8_t i = 0; i < bpfd->nb_sending_proposed; i++) {
+    /* Visit the paths from the lowest RTT, so that the first valid one is kept */
+    for (uint8_t r = 0; r < bpfd->nb_sending_proposed; r++) {
+        uint8_t i = bpfd->sending_rank[r];
         pd = bpfd->sending_paths[i];
         /* Lowest RTT-based scheduler */
         if (pd->state == path_active) {
             path_c = pd->path;
-            int challenge_verified_c = (int) get_path(path_c, AK_PATH_CHALLENGE_VERIFIED, 0);
-            uint64_t challenge_time_c = (uint64_t) get_path(path_c, AK_PATH_CHALLENGE_TIME, 0);
-            uint64_t retransmit_timer_c = (uint64_t) get_path(path_c, AK_PATH_RETRANSMIT_TIMER, 0);
-            uint8_t challenge_repeat_count_c = (uint8_t) get_path(path_c, AK_PATH_CHALLENGE_REPEAT_COUNT, 0);
+            mp_get_sched_path_fields(path_c, fields);
+            int challenge_verified_c = (int) fields[MP_SCHED_CHALLENGE_VERIFIED];
+            uint64_t challenge_time_c = (uint64_t) fields[MP_SCHED_CHALLENGE_TIME];
+            uint64_t retransmit_timer_c = (uint64_t) fields[MP_SCHED_RETRANSMIT_TIMER];
+            uint8_t challenge_repeat_count_c = (uint8_t) fields[MP_SCHED_CHALLENGE_REPEAT_COUNT];
 
             if (!challenge_verified_c && challenge_time_c + retransmit_timer_c < now && challenge_repeat_count_c < PICOQUIC_CHALLENGE_REPEAT_MAX) {
                 /* Start the challenge! */
@@ -64,7 +55,7 @@ protoop_arg_t schedule_path_rtt(picoquic_cnx_t *cnx) {
             if (challenge_verified_c && sending_path == path_0) {
                 sending_path = path_c;
                 selected_path_index = i;
-                smoothed_rtt_x = find_smooth_rtt(bpfd, bpftd, i);
+                smoothed_rtt_x = mp_get_smoothed_rtt(bpfd, i);
                 valid = 0;
                 path_reason = "AVOID_PATH_0";
             }
@@ -73,20 +64,20 @@ protoop_arg_t schedule_path_rtt(picoquic_cnx_t *cnx) {
             if (change_path && i != bpfd->last_path_index_sent) {
                 sending_path = path_c;
                 selected_path_index = i;
-                smoothed_rtt_x = find_smooth_rtt(bpfd, bpftd, i);
+                smoothed_rtt_x = mp_get_smoothed_rtt(bpfd, i);
                 valid = 0;
                 path_reason = "PATH_CHANGE";
                 break;
             }
 
             /* Very important: don't go further if the cwin is exceeded! */
-            uint64_t cwin_c = (uint64_t) get_path(path_c, AK_PATH_CWIN, 0);
-            uint64_t bytes_in_transit_c = (uint64_t) get_path(path_c, AK_PATH_BYTES_IN_TRANSIT, 0);
+            uint64_t cwin_c = (uint64_t) fields[MP_SCHED_CWIN];
+            uint64_t bytes_in_transit_c = (uint64_t) fields[MP_SCHED_BYTES_IN_TRANSIT];
             if (cwin_c <= bytes_in_transit_c) {
                 continue;
             }
 
-            int ping_received_c = (int) get_path(path_c, AK_PATH_PING_RECEIVED, 0);
+            int ping_received_c = (int) fields[MP_SCHED_PING_RECEIVED];
             if (ping_received_c) {
                 /* We need some action from the path! */
                 sending_path = path_c;
@@ -122,12 +113,12 @@ protoop_arg_t schedule_path_rtt(picoquic_cnx_t *cnx) {
 
             /* As ACKs are related to receive paths, no more logic here! */
 
-            uint64_t smoothed_rtt_c = find_smooth_rtt(bpfd, bpftd, i);
+            uint64_t smoothed_rtt_c = mp_get_smoothed_rtt(bpfd, i);
             if (path_c != path_0) {
 // TODO: Fix RTT probes
 #ifdef ENABLE_RTT_PROBE
                 uint64_t current_time = picoquic_current_time();
-                uint32_t send_mtu = (uint32_t) get_path(path_c, AK_PATH_SEND_MTU, 0);
+                uint32_t send_mtu = (uint32_t) fields[MP_SCHED_SEND_MTU];
                 /* ALWAYS AVOID PROBING A PATH IF ITS CWIN IS NEARLY FULL!!! */
                 if (bytes_in_transit_c * 2 <= cwin_c && pd->last_rtt_probe + smoothed_rtt_c + RTT_PROBE_INTERVAL < current_time && !pd->rtt_probe_ready) {  // Prepares a RTT probe
                     pd->last_rtt_probe = current_time;
@@ -156,12 +147,12 @@ protoop_arg_t schedule_path_rtt(picoquic_cnx_t *cnx) {
                 if (sending_path == path_0) {
                     sending_path = path_c;
                     selected_path_index = i;
-                    smoothed_rtt_x = (uint64_t) get_path(path_c, AK_PATH_SMOOTHED_RTT, 0);
+                    smoothed_rtt_x = smoothed_rtt_c;
                     valid = 0;
                     continue;
                 }
             }
-            if (sending_path && valid && smoothed_rtt_x < smoothed_rtt_c) {
+            if (sending_path && valid && smoothed_rtt_x <= smoothed_rtt_c) {
                 continue;
             }
             sending_path = path_c;
@@ -18,6 +18,10 @@ protoop_arg_t process_add_address_frame(picoquic_cnx_t *cnx)
         }
     }
 
+    if (mp_reserve_addr(cnx, bpfd, false) != 0) {
+        return 1;
+    }
+
     /* Create a copy of the sockaddr for the rem_addrs array, as the frame will be freed */
     bpfd->rem_addrs[addr_index].id = frame->address_id;
     if (frame->ip_vers == 4) {
@@ -71,46 +71,66 @@ protoop_arg_t update_rtt(picoquic_cnx_t *cnx)
                     }
 
                     /* First compute for the tuples */
+                    int tuple_index = -1;
                     if (receive_path_index >= 0 && old_sending_path_index >= 0) {
-                        stats_t *stats = &bpftd->tuple_stats[receive_path_index][old_sending_path_index];
-                        stats->nb_updates++;
-                        if (stats->smoothed_rtt == 0 && stats->rtt_variant == 0) {
-                            stats->smoothed_rtt = rtt_estimate;
-                            stats->rtt_variant = rtt_estimate / 2;
-                            stats->rtt_min = rtt_estimate;
-                            stats->max_ack_delay = rtt_estimate / 4;
-                            if (stats->max_ack_delay < 1000) {
-                                stats->max_ack_delay = 1000;
+                        tuple_index = mp_get_tuple_index(cnx, bpftd, receive_path_index, old_sending_path_index);
+                    }
+                    if (tuple_index >= 0) {
+                        uint64_t smoothed_rtt = bpftd->smoothed_rtt[tuple_index];
+                        uint64_t rtt_variant = bpftd->rtt_variant[tuple_index];
+                        uint64_t rtt_min = bpftd->rtt_min[tuple_index];
+                        uint64_t nb_updates = bpftd->nb_updates[tuple_index];
+
+                        /* Remove the previous contribution of the tuple from the RTT of the sending path */
+                        bpfd->sending_srtt_sum[old_sending_path_index] -= smoothed_rtt * nb_updates;
+
+                        nb_updates++;
+                        if (smoothed_rtt == 0 && rtt_variant == 0) {
+                            smoothed_rtt = rtt_estimate;
+                            rtt_variant = rtt_estimate / 2;
+                            rtt_min = rtt_estimate;
+                            bpftd->max_ack_delay[tuple_index] = rtt_estimate / 4;
+                            if (bpftd->max_ack_delay[tuple_index] < 1000) {
+                                bpftd->max_ack_delay[tuple_index] = 1000;
                             }
                         }
                         else {
                             /* Computation per RFC 6298 */
-                            int64_t delta_rtt = rtt_estimate - stats->smoothed_rtt;
+                            int64_t delta_rtt = rtt_estimate - smoothed_rtt;
                             int64_t delta_rtt_average = 0;
-                            stats->smoothed_rtt = (uint64_t) ((int64_t) stats->smoothed_rtt + delta_rtt / 8);
+                            smoothed_rtt = (uint64_t) ((int64_t) smoothed_rtt + delta_rtt / 8);
 
                             if (delta_rtt < 0) {
-                                delta_rtt_average = (-delta_rtt) - stats->rtt_variant;
+                                delta_rtt_average = (-delta_rtt) - rtt_variant;
                             } else {
-                                delta_rtt_average = delta_rtt - stats->rtt_variant;
+                                delta_rtt_average = delta_rtt - rtt_variant;
                             }
-                            stats->rtt_variant += delta_rtt_average / 4;
+                            rtt_variant += delta_rtt_average / 4;
 
-                            if (rtt_estimate < stats->rtt_min) {
-                                stats->rtt_min = rtt_estimate;
+                            if (rtt_estimate < rtt_min) {
+                                rtt_min = rtt_estimate;
                                 uint64_t new_ack_delay_local = rtt_estimate / 4;
                                 if (new_ack_delay_local < 1000) {
                                     new_ack_delay_local = 1000;
                                 } else if (new_ack_delay_local > 10000) {
                                     new_ack_delay_local = 10000;
                                 }
-                                stats->max_ack_delay = new_ack_delay_local;
+                                bpftd->max_ack_delay[tuple_index] = new_ack_delay_local;
                             }
 
-                            if (4 * stats->rtt_variant < stats->rtt_min) {
-                                stats->rtt_variant = stats->rtt_min / 4;
+                            if (4 * rtt_variant < rtt_min) {
+                                rtt_variant = rtt_min / 4;
                             }
                         }
+
+                        bpftd->smoothed_rtt[tuple_index] = smoothed_rtt;
+                        bpftd->rtt_variant[tuple_index] = rtt_variant;
+                        bpftd->rtt_min[tuple_index] = rtt_min;
+                        bpftd->nb_updates[tuple_index] = nb_updates;
+
+                        bpfd->sending_srtt_sum[old_sending_path_index] += smoothed_rtt * nb_updates;
+                        bpfd->sending_nb_updates[old_sending_path_index]++;
+                        mp_update_rank(bpfd, old_sending_path_index);
                     }
 
                     /* And still keep the old code */
@@ -45,6 +45,10 @@ protoop_arg_t write_add_address_frame(picoquic_cnx_t* cnx)
             /* First record the address */
 
             if (!aac->is_rtx) {
+                if (mp_reserve_addr(cnx, bpfd, true) != 0) {
+                    ret = PICOQUIC_ERROR_MEMORY;
+                    break;
+                }
                 addr_index = bpfd->nb_loc_addrs;
                 addr_id = addr_index + 1;
                 sa = (struct sockaddr_storage *) my_malloc_ex(cnx, sizeof(struct sockaddr_storage));
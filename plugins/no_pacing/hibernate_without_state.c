@@ -0,0 +1,10 @@
+#include "picoquic.h"
+#include "plugin.h"
+#include "../helpers.h"
+
+/* The plugin keeps nothing between its calls, its memory is released while the connection hibernates */
+protoop_arg_t hibernate_without_state(picoquic_cnx_t *cnx)
+{
+    plugin_save_hibernation_state(cnx, NULL, 0);
+    return 0;
+}
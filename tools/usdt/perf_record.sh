@@ -0,0 +1,33 @@
+#!/bin/sh
+# Records the picoquic tracepoints with perf, on hosts without bpftrace.
+#
+#   perf_record.sh <picoquic binary built with ENABLE_USDT=1> <seconds> [pid]
+#
+# Without pid, all the processes running the binary are recorded. The events
+# are written to perf.data, "perf script" lists them with their arguments.
+
+set -e
+
+if [ $# -lt 2 ]; then
+    echo "Usage: $0 <binary> <seconds> [pid]" >&2
+    exit 1
+fi
+
+BINARY=$1
+DURATION=$2
+PROBES="protoop_entry protoop_exit pluglet_entry pluglet_exit segment_entry segment_exit \
+prepare_packet_entry prepare_packet_exit congestion_notify packet_lost"
+
+perf buildid-cache --add "$BINARY"
+for PROBE in $PROBES; do
+    perf probe -q -x "$BINARY" -d "sdt_picoquic:$PROBE" 2>/dev/null || true
+    perf probe -q -x "$BINARY" -a "%sdt_picoquic:$PROBE"
+done
+
+if [ -n "$3" ]; then
+    perf record -e 'sdt_picoquic:*' -p "$3" -- sleep "$DURATION"
+else
+    perf record -e 'sdt_picoquic:*' -a -- sleep "$DURATION"
+fi
+
+perf probe -q -d 'sdt_picoquic:*'